@@ -47,6 +47,8 @@ int main(int argc, char *argv[]) {
     std::string word_syms_filename;
     std::string const_arpa_filename;
     std::string sub_language_models;
+    bool mmap_lm = false;
+    std::string biasing_phrases_rspecifier;
     po.Register("binary", &binary, "Write output in binary mode");
     po.Register("search", &search, "search function(beam|greedy)");
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
@@ -56,6 +58,14 @@ int main(int argc, char *argv[]) {
     		"scale blank acoustic posterior by a constant value(e.g. 0.01), other label posteriors are directly used in decoding.");
     po.Register("const-arpa", &const_arpa_filename, "Fusion using const ngram arpa language model (optional).");
     po.Register("sub-language-models", &sub_language_models, "Sub language models(model1:model2:...)");
+    po.Register("mmap-lm", &mmap_lm, "Memory-map the const arpa language models written with "
+    		"arpa-to-const-arpa --mappable=true, so that processes share them.");
+    po.Register("biasing-phrases", &biasing_phrases_rspecifier, "Rspecifier of "
+    		"per-utterance phrases (vectors of word-ids) to boost, e.g. "
+    		"ark:phrases.ark; only used with --use-mode=easy.");
+
+    ContextBiasingOptions biasing_opts;
+    biasing_opts.Register(&po);
 
     KaldiLstmlmWrapperOpts lstmlm_opts;
     CTCDecoderOptions decoder_opts;
@@ -90,6 +100,7 @@ int main(int argc, char *argv[]) {
     }
 
     SequentialBaseFloatMatrixReader loglikes_reader(loglikes_rspecifier);
+    RandomAccessInt32VectorVectorReader biasing_reader(biasing_phrases_rspecifier);
 
     // Reads the language model.
 	KaldiLstmlmWrapper *lstmlm = NULL;
@@ -113,11 +124,13 @@ int main(int argc, char *argv[]) {
 	CTCDecoder *decoder;
 	if (const_arpa_filename != "" && decoder_opts.rnnlm_scale < 1.0 && !decoder_opts.use_kenlm) {
         const_arpa = new ConstArpaLm;
-		ReadKaldiObject(const_arpa_filename, const_arpa);
+		if (mmap_lm) const_arpa->ReadMapped(const_arpa_filename);
+		else ReadKaldiObject(const_arpa_filename, const_arpa);
         sub_const_arpa.resize(num_sub);
 		for (int i = 0; i < num_sub; i++) {
 			sub_const_arpa[i] = new ConstArpaLm;
-			ReadKaldiObject(sub_lm_filenames[i], sub_const_arpa[i]);
+			if (mmap_lm) sub_const_arpa[i]->ReadMapped(sub_lm_filenames[i]);
+			else ReadKaldiObject(sub_lm_filenames[i], sub_const_arpa[i]);
 		}
 		decoder = new CTCDecoder(decoder_opts, lstmlm, const_arpa, sub_const_arpa);
 	} else if (const_arpa_filename != "" && decoder_opts.rnnlm_scale < 1.0 && decoder_opts.use_kenlm) {
@@ -150,6 +163,11 @@ int main(int argc, char *argv[]) {
 			continue;
 		}
 
+		ContextBiasingFst *biasing = NULL;
+		if (biasing_reader.IsOpen() && biasing_reader.HasKey(key))
+			biasing = new ContextBiasingFst(biasing_opts, biasing_reader.Value(key));
+		decoder->SetBiasing(biasing);
+
 		// decoding
 		if (search == "beam" && decoder_opts.am_topk > 0)
 			decoder->BeamSearch(loglikes);
@@ -163,6 +181,8 @@ int main(int argc, char *argv[]) {
 			decoder->GreedySearch(loglikes);
 		else
 			KALDI_ERR << "UnSupported search function: " << search;
+		decoder->SetBiasing(NULL);
+		delete biasing;
 
 		if (decoder->GetBestPath(words, logp, logp_lm)) {
 			words_writer.Write(key, words);
@@ -44,6 +44,7 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     Timer timer;
     bool allow_partial = false;
+    bool mmap_fst = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
 
@@ -54,6 +55,7 @@ int main(int argc, char *argv[]) {
 
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("mmap-fst", &mmap_fst, "If true, memory-map the decoding graph if it is a const FST, so that processes share it.");
     
     po.Read(argc, argv);
 
@@ -99,7 +101,7 @@ int main(int argc, char *argv[]) {
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
-      decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
+      decode_fst = fst::ReadFstKaldiGeneric(fst_in_str, true, mmap_fst);
 
       {
           LatticeFasterDecoder *decoder = new LatticeFasterDecoder(*decode_fst, config);
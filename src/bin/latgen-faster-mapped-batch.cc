@@ -0,0 +1,175 @@
+// bin/latgen-faster-mapped-batch.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "decoder/batch-lattice-faster-decoder.h"
+#include "decoder/decodable-matrix.h"
+
+namespace kaldi {
+
+// Writes the outputs that are ready.
+void WriteOutputs(BatchLatticeFasterDecoder *decoder, bool determinize,
+                  const fst::SymbolTable *word_syms,
+                  CompactLatticeWriter *compact_lattice_writer,
+                  LatticeWriter *lattice_writer,
+                  Int32VectorWriter *words_writer,
+                  Int32VectorWriter *alignment_writer) {
+  std::string utt;
+  CompactLattice clat;
+  Lattice lat;
+  std::vector<int32> alignment, words;
+  while (determinize ?
+         decoder->GetOutput(&utt, &clat, &alignment, &words) :
+         decoder->GetOutput(&utt, &lat, &alignment, &words)) {
+    if (determinize)
+      compact_lattice_writer->Write(utt, clat);
+    else
+      lattice_writer->Write(utt, lat);
+    if (words_writer->IsOpen())
+      words_writer->Write(utt, words);
+    if (alignment_writer->IsOpen())
+      alignment_writer->Write(utt, alignment);
+    if (word_syms != NULL) {
+      std::cerr << utt << ' ';
+      for (size_t i = 0; i < words.size(); i++) {
+        std::string s = word_syms->Find(words[i]);
+        if (s == "")
+          KALDI_ERR << "Word-id " << words[i] << " not in symbol table.";
+        std::cerr << s << ' ';
+      }
+      std::cerr << '\n';
+    }
+  }
+}
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    using fst::SymbolTable;
+    using fst::Fst;
+    using fst::StdArc;
+
+    const char *usage =
+        "Generate lattices, reading log-likelihoods as matrices, with a pool of\n"
+        "decoder threads that decode the longest utterances of each batch first\n"
+        "(model is needed only for the integer mappings in its transition-model).\n"
+        "The output is in the order of the input.\n"
+        "Usage: latgen-faster-mapped-batch [options] trans-model-in fst-in "
+        "loglikes-rspecifier lattice-wspecifier [ words-wspecifier "
+        "[alignments-wspecifier] ]\n";
+    ParseOptions po(usage);
+    bool allow_partial = false;
+    bool mmap_fst = false;
+    BaseFloat acoustic_scale = 0.1;
+    LatticeFasterDecoderConfig config;
+    BatchLatticeFasterDecoderConfig batch_config;
+
+    std::string word_syms_filename;
+    config.Register(&po);
+    batch_config.Register(&po);
+
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
+
+    po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
+    po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("mmap-fst", &mmap_fst, "If true, memory-map the decoding graph if it is a const FST, so that processes share it.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 4 || po.NumArgs() > 6) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        fst_in_str = po.GetArg(2),
+        feature_rspecifier = po.GetArg(3),
+        lattice_wspecifier = po.GetArg(4),
+        words_wspecifier = po.GetOptArg(5),
+        alignment_wspecifier = po.GetOptArg(6);
+
+    if (ClassifyRspecifier(fst_in_str, NULL, NULL) != kNoRspecifier)
+      KALDI_ERR << "latgen-faster-mapped-batch decodes with a single graph; "
+                << "use latgen-faster-mapped-parallel for a table of FSTs.";
+
+    TransitionModel trans_model;
+    ReadKaldiObject(model_in_filename, &trans_model);
+
+    bool determinize = config.determinize_lattice;
+    CompactLatticeWriter compact_lattice_writer;
+    LatticeWriter lattice_writer;
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+           : lattice_writer.Open(lattice_wspecifier)))
+      KALDI_ERR << "Could not open table for writing lattices: "
+                 << lattice_wspecifier;
+
+    Int32VectorWriter words_writer(words_wspecifier);
+
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    fst::SymbolTable *word_syms = NULL;
+    if (word_syms_filename != "")
+      if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                   << word_syms_filename;
+
+    Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_str, true,
+                                                       mmap_fst);
+    int32 num_success;
+    {
+      BatchLatticeFasterDecoder decoder(batch_config, *decode_fst, config,
+                                        trans_model, acoustic_scale,
+                                        allow_partial);
+
+      SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
+      for (; !loglike_reader.Done(); loglike_reader.Next()) {
+        std::string utt = loglike_reader.Key();
+        Matrix<BaseFloat> *loglikes =
+          new Matrix<BaseFloat>(loglike_reader.Value());
+        loglike_reader.FreeCurrent();
+        if (loglikes->NumRows() == 0) {
+          KALDI_WARN << "Zero-length utterance: " << utt;
+          decoder.UtteranceFailed();
+          delete loglikes;
+          continue;
+        }
+        decoder.AcceptInput(utt, new DecodableMatrixScaledMapped(
+            trans_model, acoustic_scale, loglikes));
+        WriteOutputs(&decoder, determinize, word_syms, &compact_lattice_writer,
+                     &lattice_writer, &words_writer, &alignment_writer);
+      }
+      num_success = decoder.Finished();
+      WriteOutputs(&decoder, determinize, word_syms, &compact_lattice_writer,
+                   &lattice_writer, &words_writer, &alignment_writer);
+    }  // the decoder prints the statistics.
+
+    delete decode_fst;
+    delete word_syms;
+    if (num_success != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
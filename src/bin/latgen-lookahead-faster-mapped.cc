@@ -0,0 +1,285 @@
+// bin/latgen-lookahead-faster-mapped.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "decoder/lattice-biglm-faster-decoder.h"
+#include "decoder/lm-lookahead.h"
+#include "decoder/decodable-matrix.h"
+#include "lat/lattice-functions.h"
+#include "lm/const-arpa-lm.h"
+#include "base/timer.h"
+
+
+namespace kaldi {
+// Takes care of output.  Returns true on success.
+bool DecodeUtterance(LatticeBiglmFasterDecoder *decoder,
+                     DecodableInterface *decodable,
+                     const TransitionModel &trans_model,
+                     const fst::SymbolTable *word_syms,
+                     const std::string &utt,
+                     double acoustic_scale,
+                     bool determinize,
+                     bool allow_partial,
+                     Int32VectorWriter *alignment_writer,
+                     Int32VectorWriter *words_writer,
+                     CompactLatticeWriter *compact_lattice_writer,
+                     LatticeWriter *lattice_writer,
+                     double *like_ptr) {  // puts utterance's like in like_ptr on success.
+  if (!decoder->Decode(decodable)) {
+    KALDI_WARN << "Failed to decode file " << utt;
+    return false;
+  }
+  if (!decoder->ReachedFinal()) {
+    if (allow_partial) {
+      KALDI_WARN << "Outputting partial output for utterance " << utt
+                 << " since no final-state reached\n";
+    } else {
+      KALDI_WARN << "Not producing output for utterance " << utt
+                 << " since no final-state reached and "
+                 << "--allow-partial=false.\n";
+      return false;
+    }
+  }
+
+  // Get lattice, and the best path from it.
+  Lattice lat;
+  decoder->GetRawLattice(&lat);
+  fst::Connect(&lat);
+  if (lat.NumStates() == 0)
+    KALDI_ERR << "Unexpected problem getting lattice for utterance " << utt;
+
+  double likelihood;
+  LatticeWeight weight;
+  int32 num_frames;
+  {
+    Lattice decoded;
+    fst::ShortestPath(lat, &decoded);
+    std::vector<int32> alignment;
+    std::vector<int32> words;
+    GetLinearSymbolSequence(decoded, &alignment, &words, &weight);
+    num_frames = alignment.size();
+    if (words_writer->IsOpen())
+      words_writer->Write(utt, words);
+    if (alignment_writer->IsOpen())
+      alignment_writer->Write(utt, alignment);
+    if (word_syms != NULL) {
+      std::cerr << utt << ' ';
+      for (size_t i = 0; i < words.size(); i++) {
+        std::string s = word_syms->Find(words[i]);
+        if (s == "")
+          KALDI_ERR << "Word-id " << words[i] <<" not in symbol table.";
+        std::cerr << s << ' ';
+      }
+      std::cerr << '\n';
+    }
+    likelihood = -(weight.Value1() + weight.Value2());
+  }
+
+  if (determinize) {
+    CompactLattice clat;
+    if (!DeterminizeLatticePhonePrunedWrapper(
+            trans_model,
+            &lat,
+            decoder->GetOptions().lattice_beam,
+            &clat,
+            decoder->GetOptions().det_opts))
+      KALDI_WARN << "Determinization finished earlier than the beam for "
+                 << "utterance " << utt;
+    // We'll write the lattice without acoustic scaling.
+    if (acoustic_scale != 0.0)
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &clat);
+    compact_lattice_writer->Write(utt, clat);
+  } else {
+    if (acoustic_scale != 0.0) // We'll write the lattice without acoustic scaling
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &lat);
+    lattice_writer->Write(utt, lat);
+  }
+  KALDI_LOG << "Log-like per frame for utterance " << utt << " is "
+            << (likelihood / num_frames) << " over "
+            << num_frames << " frames.";
+  KALDI_VLOG(2) << "Cost for utterance " << utt << " is "
+                << weight.Value1() << " + " << weight.Value2();
+  *like_ptr = likelihood;
+  return true;
+}
+
+}  // namespace kaldi
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    using fst::SymbolTable;
+    using fst::VectorFst;
+    using fst::Fst;
+    using fst::StdArc;
+
+    const char *usage =
+        "Generate lattices, reading log-likelihoods as matrices, by composing\n"
+        "a graph without the grammar (HCL, with words as output labels) with\n"
+        "the language model on the fly, with LM lookahead (model is needed\n"
+        "only for the integer mappings in its transition-model).  The LM is in\n"
+        "ConstArpaLm format (see arpa-to-const-arpa), or an FST if --lm-fst=true.\n"
+        "Usage: latgen-lookahead-faster-mapped [options] trans-model-in hcl-fst-in "
+        "lm-in loglikes-rspecifier lattice-wspecifier [ words-wspecifier "
+        "[alignments-wspecifier] ]\n";
+    ParseOptions po(usage);
+    Timer timer;
+    bool allow_partial = false;
+    bool lm_fst = false, mmap_lm = false, mmap_fst = false;
+    bool use_lookahead = true;
+    BaseFloat acoustic_scale = 0.1;
+    int32 num_cached_arcs = 1000000;
+    LatticeBiglmFasterDecoderConfig config;
+    LmLookaheadConfig lookahead_config;
+
+    std::string word_syms_filename;
+    config.Register(&po);
+    lookahead_config.Register(&po);
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
+    po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
+    po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("lm-fst", &lm_fst, "If true, the LM is a backoff FST (G.fst) "
+                "rather than in ConstArpaLm format.");
+    po.Register("mmap-lm", &mmap_lm, "If true, memory-map the ConstArpaLm if it "
+                "was written with arpa-to-const-arpa --mappable=true, so that "
+                "processes share it.");
+    po.Register("mmap-fst", &mmap_fst, "If true, memory-map the graph if it is "
+                "a const FST, so that processes share it.");
+    po.Register("use-lookahead", &use_lookahead, "If false, compose with the "
+                "LM without lookahead.");
+    po.Register("num-cached-arcs", &num_cached_arcs, "Number of LM arcs to "
+                "cache.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 5 || po.NumArgs() > 7) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        fst_in_filename = po.GetArg(2),
+        lm_in_filename = po.GetArg(3),
+        feature_rspecifier = po.GetArg(4),
+        lattice_wspecifier = po.GetArg(5),
+        words_wspecifier = po.GetOptArg(6),
+        alignment_wspecifier = po.GetOptArg(7);
+
+    TransitionModel trans_model;
+    ReadKaldiObject(model_in_filename, &trans_model);
+
+    ConstArpaLm const_arpa;
+    VectorFst<StdArc> *lm_vector_fst = NULL;
+    fst::DeterministicOnDemandFst<StdArc> *lm_dfst;
+    if (lm_fst) {
+      lm_vector_fst = fst::CastOrConvertToVectorFst(
+          fst::ReadFstKaldiGeneric(lm_in_filename));
+      lm_dfst = new fst::BackoffDeterministicOnDemandFst<StdArc>(*lm_vector_fst);
+    } else {
+      if (mmap_lm)
+        const_arpa.ReadMapped(lm_in_filename);
+      else
+        ReadKaldiObject(lm_in_filename, &const_arpa);
+      lm_dfst = new ConstArpaLmDeterministicFst(const_arpa);
+    }
+    fst::CacheDeterministicOnDemandFst<StdArc> cache_dfst(lm_dfst,
+                                                          num_cached_arcs);
+
+    bool determinize = config.determinize_lattice;
+    CompactLatticeWriter compact_lattice_writer;
+    LatticeWriter lattice_writer;
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+           : lattice_writer.Open(lattice_wspecifier)))
+      KALDI_ERR << "Could not open table for writing lattices: "
+                 << lattice_wspecifier;
+
+    Int32VectorWriter words_writer(words_wspecifier);
+
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    fst::SymbolTable *word_syms = NULL;
+    if (word_syms_filename != "")
+      if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                   << word_syms_filename;
+
+    double tot_like = 0.0;
+    kaldi::int64 frame_count = 0;
+    int num_success = 0, num_fail = 0;
+
+    Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_filename, true,
+                                                       mmap_fst);
+    LmLookahead *lookahead = NULL;
+    if (use_lookahead)
+      lookahead = new LmLookahead(lookahead_config, *decode_fst, &cache_dfst);
+    {
+      LatticeBiglmFasterDecoder decoder(*decode_fst, config, &cache_dfst,
+                                        lookahead);
+
+      SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
+      for (; !loglike_reader.Done(); loglike_reader.Next()) {
+        std::string utt = loglike_reader.Key();
+        Matrix<BaseFloat> loglikes (loglike_reader.Value());
+        loglike_reader.FreeCurrent();
+        if (loglikes.NumRows() == 0) {
+          KALDI_WARN << "Zero-length utterance: " << utt;
+          num_fail++;
+          continue;
+        }
+
+        DecodableMatrixScaledMapped decodable(trans_model, loglikes,
+                                              acoustic_scale);
+        double like;
+        if (DecodeUtterance(&decoder, &decodable, trans_model, word_syms,
+                            utt, acoustic_scale, determinize, allow_partial,
+                            &alignment_writer, &words_writer,
+                            &compact_lattice_writer, &lattice_writer,
+                            &like)) {
+          tot_like += like;
+          frame_count += loglikes.NumRows();
+          num_success++;
+        } else num_fail++;
+      }
+    }
+    delete lookahead;  // these only after the decoder goes out of scope.
+    delete decode_fst;
+    delete lm_dfst;
+    delete lm_vector_fst;
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor assuming 100 frames/sec is "
+              << (elapsed*100.0/frame_count);
+    KALDI_LOG << "Done " << num_success << " utterances, failed for "
+              << num_fail;
+    KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count) << " over "
+              << frame_count<<" frames.";
+
+    delete word_syms;
+    if (num_success != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -338,6 +338,10 @@ void cudaD_copy_from_sp(dim3 Gr, dim3 Bl, const double* x, double* y,
                         MatrixDim d_out);
 void cudaF_copy_from_sp(dim3 Gr, dim3 Bl, const float* x, float* y,
                         MatrixDim d_out);
+void cudaD_copy_from_compressed(dim3 Gr, dim3 Bl, double* y, MatrixDim d,
+                                const void* src);
+void cudaF_copy_from_compressed(dim3 Gr, dim3 Bl, float* y, MatrixDim d,
+                                const void* src);
 void cudaD_copy_from_tp(dim3 Gr, dim3 Bl, double* A, const double* B,
                         MatrixDim dmat);
 void cudaDF_copy_from_tp(dim3 Gr, dim3 Bl, double* A, const float* B,
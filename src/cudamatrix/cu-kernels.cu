@@ -3114,6 +3114,61 @@ static void _copy_from_sp(const Real* x, Real* y, MatrixDim dim) {
   }
 }
 
+// Decompresses a CompressedMatrix (see ../matrix/compressed-matrix.h) whose
+// data, headers included, is at "src".  The arithmetic is that of
+// CompressedMatrix::CopyToMat(), with the roundings made explicit so that the
+// compiler cannot fuse multiplications and additions, which gives exactly the
+// same results.
+template<typename Real>
+__global__
+static void _copy_from_compressed(Real* y, MatrixDim d, const void* src) {
+  int i = blockIdx.x * blockDim.x + threadIdx.x;  // column index
+  int j = blockIdx.y * blockDim.y + threadIdx.y;  // row index
+  if (i >= d.cols || j >= d.rows)
+    return;
+  // The global header is: int32 format, float min_value, float range,
+  // int32 num_rows, int32 num_cols.
+  const int32_cuda* header = reinterpret_cast<const int32_cuda*>(src);
+  int format = header[0];
+  float min_value = __int_as_float(header[1]),
+      range = __int_as_float(header[2]);
+  const void* data = header + 5;
+  float f;
+  if (format == 1) {  // kOneByteWithColHeaders, stored by column.
+    const uint16_t* col_header =
+        reinterpret_cast<const uint16_t*>(data) + 4 * i;
+    float scale = __fmul_rn(range, 1.52590218966964e-05F),
+        p0 = __fadd_rn(min_value, __fmul_rn(scale, col_header[0])),
+        p25 = __fadd_rn(min_value, __fmul_rn(scale, col_header[1])),
+        p75 = __fadd_rn(min_value, __fmul_rn(scale, col_header[2])),
+        p100 = __fadd_rn(min_value, __fmul_rn(scale, col_header[3]));
+    int value = reinterpret_cast<const uint8_t*>(data)[
+        8 * d.cols + i * d.rows + j];
+    double g;
+    if (value <= 64)
+      g = __dadd_rn(p0, __dmul_rn(__fmul_rn(__fsub_rn(p25, p0), value),
+                                  1 / 64.0));
+    else if (value <= 192)
+      g = __dadd_rn(p25, __dmul_rn(__fmul_rn(__fsub_rn(p75, p25),
+                                             value - 64), 1 / 128.0));
+    else
+      g = __dadd_rn(p75, __dmul_rn(__fmul_rn(__fsub_rn(p100, p75),
+                                             value - 192), 1 / 63.0));
+    f = __double2float_rn(g);
+  } else {  // kTwoByte or kOneByte, stored by row.
+    float increment, code;
+    if (format == 2) {
+      increment = __double2float_rn(__dmul_rn(range, 1.0 / 65535.0));
+      code = reinterpret_cast<const uint16_t*>(data)[j * d.cols + i];
+    } else {
+      increment = __double2float_rn(__dmul_rn(range, 1.0 / 255.0));
+      code = reinterpret_cast<const uint8_t*>(data)[j * d.cols + i];
+    }
+    f = __fadd_rn(min_value, __fmul_rn(code, increment));
+  }
+  y[i + j * d.stride] = f;
+}
+
 template<typename Real>
 __global__
 static void _copy(Real* y, const Real* x, const int32_cuda* copy_from,
@@ -4660,6 +4715,11 @@ void cudaF_copy_from_sp(dim3 Gr, dim3 Bl, const float* x, float* y,
   _copy_from_sp<<<Gr,Bl>>>(x, y, dim);
 }
 
+void cudaF_copy_from_compressed(dim3 Gr, dim3 Bl, float* y, MatrixDim d,
+                                const void* src) {
+  _copy_from_compressed<<<Gr,Bl>>>(y, d, src);
+}
+
 void cudaF_copy(dim3 Gr, dim3 Bl, float* y, const float* x,
                 const int32_cuda* copy_from, MatrixDim d_out, MatrixDim d_in) {
   _copy<<<Gr,Bl>>>(y,x,copy_from,d_out,d_in);
@@ -5382,6 +5442,11 @@ void cudaD_copy_from_sp(dim3 Gr, dim3 Bl, const double* x, double* y,
   _copy_from_sp<<<Gr,Bl>>>(x,y,d_out);
 }
 
+void cudaD_copy_from_compressed(dim3 Gr, dim3 Bl, double* y, MatrixDim d,
+                                const void* src) {
+  _copy_from_compressed<<<Gr,Bl>>>(y, d, src);
+}
+
 void cudaD_copy(dim3 Gr, dim3 Bl, double* y, const double* x,
                 const int32_cuda* copy_from, MatrixDim d_out, MatrixDim d_in) {
   _copy<<<Gr,Bl>>>(y,x,copy_from,d_out,d_in);
@@ -643,6 +643,14 @@ inline void cuda_copy_from_sp(dim3 Gr, dim3 Bl, const float* x, float* y,
                               MatrixDim d_out) {
   cudaF_copy_from_sp(Gr, Bl, x, y, d_out);
 }
+inline void cuda_copy_from_compressed(dim3 Gr, dim3 Bl, double* y,
+                                      MatrixDim d, const void* src) {
+  cudaD_copy_from_compressed(Gr, Bl, y, d, src);
+}
+inline void cuda_copy_from_compressed(dim3 Gr, dim3 Bl, float* y,
+                                      MatrixDim d, const void* src) {
+  cudaF_copy_from_compressed(Gr, Bl, y, d, src);
+}
 inline void cuda_copy_from_tp(dim3 Gr, dim3 Bl, double* A, const double* B,
                               MatrixDim dmat) {
   cudaD_copy_from_tp(Gr, Bl, A, B, dmat);
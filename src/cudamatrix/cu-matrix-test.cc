@@ -1830,6 +1830,35 @@ static void UnitTestCuMatrixCopyFromMat() {
   }
 }
 
+// The decompression on the device must give exactly what the CPU code gives.
+template<typename Real>
+static void UnitTestCuMatrixCopyFromCompressed() {
+  CompressionMethod methods[] = { kSpeechFeature, kTwoByteAuto,
+                                  kTwoByteSignedInteger, kOneByteAuto,
+                                  kOneByteUnsignedInteger, kOneByteZeroOne };
+  for (int32 i = 0; i < 12; i++) {
+    int32 num_rows = RandInt(1, 100), num_cols = RandInt(1, 50);
+    Matrix<Real> A(num_rows, num_cols);
+    A.SetRandn();
+    CompressedMatrix cA(A, methods[i % 6]);
+    Matrix<Real> B(num_rows, num_cols);
+    cA.CopyToMat(&B);
+    CuMatrix<Real> C(num_rows, num_cols, kUndefined);
+    C.CopyFromMat(cA);
+    Matrix<Real> D(C);
+    for (int32 r = 0; r < num_rows; r++)
+      KALDI_ASSERT(memcmp(B.RowData(r), D.RowData(r),
+                          num_cols * sizeof(Real)) == 0);
+
+    GeneralMatrix gA;
+    gA = cA;
+    CuMatrix<Real> E(num_cols, num_rows, kUndefined);
+    E.CopyFromGeneralMat(gA, kTrans);
+    Matrix<Real> BT(B, kTrans);
+    AssertEqual(BT, Matrix<Real>(E));
+  }
+}
+
 template<typename Real>
 static void UnitTestCuMatrixCopyFromTp() {
   for (int32 i = 1; i < 10; i++) {
@@ -2971,6 +3000,7 @@ template<typename Real> void CudaMatrixUnitTest() {
   UnitTestCuMatrixAddMatMatBatched<Real>();
   UnitTestCuMatrixSymInvertPosDef<Real>();
   UnitTestCuMatrixCopyFromMat<Real>();
+  UnitTestCuMatrixCopyFromCompressed<Real>();
   UnitTestCuMatrixCopyFromTp<Real>();
   UnitTestCuMatrixAddMatTp<Real>();
   UnitTestCuMatrixCopyCols<Real>();
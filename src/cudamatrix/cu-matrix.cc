@@ -31,6 +31,7 @@
 #endif
 
 #include "base/timer.h"
+#include "matrix/host-allocator.h"
 #include "cudamatrix/cu-common.h"
 #include "cudamatrix/cu-vector.h"
 #include "cudamatrix/cu-device.h"
@@ -106,7 +107,7 @@ void CuMatrix<Real>::Destroy() {
   } else
 #endif
   {
-    if (this->data_ != NULL) KALDI_MEMALIGN_FREE(this->data_);
+    HostMemoryAllocator::Instance().Free(this->data_);
   }
   this->data_ = NULL;
   this->num_rows_ = 0;
@@ -347,6 +348,31 @@ void CuMatrixBase<Real>::CopyFromMat(const MatrixBase<OtherReal> &src,
   this->CopyFromMat(temp, trans);
 }
 
+template<typename Real>
+void CuMatrixBase<Real>::CopyFromMat(const CompressedMatrix &src) {
+  KALDI_ASSERT(src.NumRows() == num_rows_ && src.NumCols() == num_cols_);
+  if (num_rows_ == 0)
+    return;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    CuTimer tim;
+    MatrixIndexT size = src.DataSizeInBytes();
+    void *data = CuDevice::Instantiate().Malloc(size);
+    CU_SAFE_CALL(cudaMemcpy(data, src.Data(), size, cudaMemcpyHostToDevice));
+    dim3 dimGrid, dimBlock;
+    GetBlockSizesForSimpleMatrixOperation(NumRows(), NumCols(),
+                                          &dimGrid, &dimBlock);
+    cuda_copy_from_compressed(dimGrid, dimBlock, data_, Dim(), data);
+    CU_SAFE_CALL(cudaGetLastError());
+    CuDevice::Instantiate().Free(data);
+    CuDevice::Instantiate().AccuProfile(__func__, tim);
+  } else
+#endif
+  {
+    src.CopyToMat(&(Mat()));
+  }
+}
+
 // instantiate the template above.
 template
 void CuMatrixBase<float>::CopyFromMat(const MatrixBase<double> &src,
@@ -4548,6 +4574,10 @@ void CuMatrixBase<Real>::CopyFromGeneralMat(const GeneralMatrix &src,
       return;
     }
     case kCompressedMatrix: {
+      if (trans == kNoTrans) {
+        this->CopyFromMat(src.GetCompressedMatrix());
+        return;
+      }
       Matrix<BaseFloat> mat;
       src.GetMatrix(&mat);
       this->CopyFromMat(mat, trans);
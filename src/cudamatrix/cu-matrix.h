@@ -316,6 +316,12 @@ class CuMatrixBase {
   void CopyFromGeneralMat(const GeneralMatrix &src,
                           MatrixTransposeType trans = kNoTrans);
 
+  /// Copies from a CompressedMatrix of the same size.  With a GPU, the
+  /// compressed data (2 to 4 times smaller than the matrix) is copied to the
+  /// device and decompressed there; the results are exactly the same as those
+  /// of CompressedMatrix::CopyToMat().
+  void CopyFromMat(const CompressedMatrix &src);
+
   void CopyFromMat(const MatrixBase<Real> &src,
                    MatrixTransposeType trans = kNoTrans);
 
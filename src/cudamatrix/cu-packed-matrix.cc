@@ -26,6 +26,7 @@
 #endif
 
 #include "base/timer.h"
+#include "matrix/host-allocator.h"
 #include "cudamatrix/cu-common.h"
 #include "cudamatrix/cu-vector.h"
 #include "cudamatrix/cu-device.h"
@@ -96,7 +97,7 @@ void CuPackedMatrix<Real>::Destroy() {
   } else
 #endif
   {
-    if (this->data_ != NULL) KALDI_MEMALIGN_FREE(this->data_);
+    HostMemoryAllocator::Instance().Free(this->data_);
   }
   this->data_ = NULL;
   this->num_rows_ = 0;
@@ -594,13 +594,13 @@ void GeneralMatrix::CopyToMat(CuMatrixBase<BaseFloat> *cu_mat,
         break;
       }
       case kCompressedMatrix: {
-        Matrix<BaseFloat> mat(cmat_);
         if (trans == kNoTrans) {
-          cu_mat->CopyFromMat(mat);
+          cu_mat->CopyFromMat(cmat_);
           break;
         } else {
-          CuMatrix<BaseFloat> temp_cu;
-          temp_cu.Swap(&mat);
+          CuMatrix<BaseFloat> temp_cu(cmat_.NumRows(), cmat_.NumCols(),
+                                      kUndefined);
+          temp_cu.CopyFromMat(cmat_);
           cu_mat->CopyFromMat(temp_cu, kTrans);
           break;
         }
@@ -703,14 +703,16 @@ void GeneralMatrix::AddToMat(BaseFloat alpha,
       break;
     }
     case kCompressedMatrix: {
-      Matrix<BaseFloat> mat(cmat_);
 #if HAVE_CUDA == 1
       if (CuDevice::Instantiate().Enabled()) {
-        CuMatrix<BaseFloat> cu_mat_copy(mat);
+        CuMatrix<BaseFloat> cu_mat_copy(cmat_.NumRows(), cmat_.NumCols(),
+                                        kUndefined);
+        cu_mat_copy.CopyFromMat(cmat_);
         cu_mat->AddMat(alpha, cu_mat_copy, trans);
         break;
       }
 #endif
+      Matrix<BaseFloat> mat(cmat_);
       cu_mat->Mat().AddMat(alpha, mat, trans);
       break;
     }
@@ -0,0 +1,107 @@
+// cudamatrix/cu-staging-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "cudamatrix/cu-device.h"
+#include "cudamatrix/cu-staging.h"
+
+using namespace kaldi;
+
+
+namespace kaldi {
+
+template<typename Real>
+static void UnitTestCuMatrixStagerDoubleBuffer() {
+  int32 num_batches = 10, num_cols = 10 + Rand() % 20;
+  std::vector<Matrix<Real> > batches(num_batches);
+  for (int32 i = 0; i < num_batches; i++) {
+    // varying row counts exercise the grow-only device slots.
+    batches[i].Resize(1 + Rand() % 50, num_cols);
+    batches[i].SetRandn();
+  }
+
+  CuMatrixStager<Real> stager;
+  stager.Stage(batches[0]);
+  for (int32 i = 0; i < num_batches; i++) {
+    CuSubMatrix<Real> cur(stager.Acquire());
+    if (i + 1 < num_batches)
+      stager.Stage(batches[i + 1]);
+    KALDI_ASSERT(stager.NumPending() == (i + 1 < num_batches ? 1 : 0));
+    // staging the next batch must not disturb the acquired one.
+    Matrix<Real> host(cur);
+    KALDI_ASSERT(host.ApproxEqual(batches[i], 0.0));
+  }
+}
+
+template<typename Real>
+static void UnitTestCuMatrixStagerSlots() {
+  int32 num_slots = 2 + Rand() % 3;
+  CuMatrixStager<Real> stager(num_slots);
+  std::vector<Matrix<Real> > batches(num_slots - 1);
+  for (int32 i = 0; i < num_slots - 1; i++) {
+    batches[i].Resize(5 + Rand() % 10, 7);
+    batches[i].SetRandn();
+    stager.Stage(batches[i]);
+  }
+  for (int32 i = 0; i < num_slots - 1; i++) {
+    CuSubMatrix<Real> cur(stager.Acquire());
+    Matrix<Real> host(cur);
+    KALDI_ASSERT(host.ApproxEqual(batches[i], 0.0));
+  }
+  KALDI_ASSERT(stager.NumPending() == 0);
+
+  // an empty matrix passes through as an empty view.
+  Matrix<Real> empty;
+  stager.Stage(empty);
+  CuSubMatrix<Real> cur(stager.Acquire());
+  KALDI_ASSERT(cur.NumRows() == 0 && cur.NumCols() == 0);
+}
+
+}  // namespace kaldi
+
+
+int main() {
+  SetVerboseLevel(1);
+  int32 loop = 0;
+#if HAVE_CUDA == 1
+  for (; loop < 2; loop++) {
+    if (loop == 0)
+      CuDevice::Instantiate().SelectGpuId("no");
+    else
+      CuDevice::Instantiate().SelectGpuId("yes");
+#endif
+    for (int32 i = 0; i < 5; i++) {
+      UnitTestCuMatrixStagerDoubleBuffer<float>();
+      UnitTestCuMatrixStagerDoubleBuffer<double>();
+      UnitTestCuMatrixStagerSlots<float>();
+      UnitTestCuMatrixStagerSlots<double>();
+    }
+
+    if (loop == 0)
+      KALDI_LOG << "Tests without GPU use succeeded.";
+    else
+      KALDI_LOG << "Tests with GPU use (if available) succeeded.";
+#if HAVE_CUDA == 1
+  }
+  CuDevice::Instantiate().PrintProfile();
+#endif
+  return 0;
+}
@@ -0,0 +1,170 @@
+// cudamatrix/cu-staging.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#if HAVE_CUDA == 1
+#include <cuda_runtime_api.h>
+#endif
+
+#include "base/timer.h"
+#include "cudamatrix/cu-common.h"
+#include "cudamatrix/cu-device.h"
+#include "cudamatrix/cu-staging.h"
+
+namespace kaldi {
+
+template<typename Real>
+CuMatrixStager<Real>::CuMatrixStager(int32 num_slots):
+    slots_(num_slots), next_acquire_(0), num_pending_(0), acquired_(-1) {
+  KALDI_ASSERT(num_slots >= 2);
+#if HAVE_CUDA == 1
+  copy_stream_ = NULL;
+  gpu_initialized_ = false;
+#endif
+}
+
+template<typename Real>
+CuMatrixStager<Real>::~CuMatrixStager() {
+#if HAVE_CUDA == 1
+  if (gpu_initialized_) {
+    // make sure no copy is still reading from a pinned buffer or writing to a
+    // device matrix we are about to free.
+    CU_SAFE_CALL(cudaStreamSynchronize(copy_stream_));
+    for (size_t i = 0; i < slots_.size(); i++) {
+      Slot &slot = slots_[i];
+      CU_SAFE_CALL(cudaEventSynchronize(slot.released));
+      if (slot.pinned != NULL)
+        CU_SAFE_CALL(cudaFreeHost(slot.pinned));
+      CU_SAFE_CALL(cudaEventDestroy(slot.copied));
+      CU_SAFE_CALL(cudaEventDestroy(slot.released));
+    }
+    CU_SAFE_CALL(cudaStreamDestroy(copy_stream_));
+  }
+#endif
+}
+
+#if HAVE_CUDA == 1
+template<typename Real>
+void CuMatrixStager<Real>::InitGpu() {
+  // A non-blocking stream, so the uploads don't serialize against the
+  // per-thread default stream the computation runs on.
+  CU_SAFE_CALL(cudaStreamCreateWithFlags(&copy_stream_,
+                                         cudaStreamNonBlocking));
+  for (size_t i = 0; i < slots_.size(); i++) {
+    CU_SAFE_CALL(cudaEventCreateWithFlags(&slots_[i].copied,
+                                          cudaEventDisableTiming));
+    CU_SAFE_CALL(cudaEventCreateWithFlags(&slots_[i].released,
+                                          cudaEventDisableTiming));
+  }
+  gpu_initialized_ = true;
+}
+
+template<typename Real>
+void CuMatrixStager<Real>::StageGpu(Slot *slot, const MatrixBase<Real> &src) {
+  if (!gpu_initialized_)
+    InitGpu();
+  CuTimer tim;
+  MatrixIndexT num_rows = src.NumRows(), num_cols = src.NumCols();
+  size_t size = static_cast<size_t>(num_rows) * num_cols;
+
+  // The previous upload from this slot must be finished before we overwrite
+  // the pinned buffer.  This only blocks if the caller runs more than
+  // NumSlots() minibatches ahead of the device.
+  CU_SAFE_CALL(cudaEventSynchronize(slot->copied));
+
+  if (slot->mat.NumRows() < num_rows || slot->mat.NumCols() != num_cols) {
+    // the device matrix may still be read by queued kernels.
+    CU_SAFE_CALL(cudaEventSynchronize(slot->released));
+    slot->mat.Resize(num_rows, num_cols, kUndefined);
+  }
+  if (slot->pinned_size < size) {
+    if (slot->pinned != NULL)
+      CU_SAFE_CALL(cudaFreeHost(slot->pinned));
+    CU_SAFE_CALL(cudaMallocHost(reinterpret_cast<void**>(&slot->pinned),
+                                size * sizeof(Real)));
+    slot->pinned_size = size;
+  }
+
+  SubMatrix<Real> pinned(slot->pinned, num_rows, num_cols, num_cols);
+  pinned.CopyFromMat(src);
+
+  // the copy stream may not overwrite the device matrix before the
+  // computation that last used it has finished.
+  CU_SAFE_CALL(cudaStreamWaitEvent(copy_stream_, slot->released, 0));
+  CU_SAFE_CALL(cudaMemcpy2DAsync(slot->mat.Data(),
+                                 slot->mat.Stride() * sizeof(Real),
+                                 slot->pinned, num_cols * sizeof(Real),
+                                 num_cols * sizeof(Real), num_rows,
+                                 cudaMemcpyHostToDevice, copy_stream_));
+  CU_SAFE_CALL(cudaEventRecord(slot->copied, copy_stream_));
+  CuDevice::Instantiate().AccuProfile("CuMatrixStager::Stage", tim);
+}
+#endif
+
+template<typename Real>
+void CuMatrixStager<Real>::Stage(const MatrixBase<Real> &src) {
+  int32 num_slots = slots_.size(),
+      num_busy = num_pending_ + (acquired_ >= 0 ? 1 : 0);
+  if (num_busy >= num_slots)
+    KALDI_ERR << "CuMatrixStager: all " << num_slots << " slots are in use; "
+              << "call Acquire() before staging more matrices.";
+  int32 s = (next_acquire_ + num_pending_) % num_slots;
+  Slot &slot = slots_[s];
+  slot.num_rows = src.NumRows();
+  num_pending_++;
+  if (src.NumRows() == 0)
+    return;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    StageGpu(&slot, src);
+    return;
+  }
+#endif
+  if (slot.mat.NumRows() < src.NumRows() ||
+      slot.mat.NumCols() != src.NumCols())
+    slot.mat.Resize(src.NumRows(), src.NumCols(), kUndefined);
+  slot.mat.RowRange(0, src.NumRows()).CopyFromMat(src);
+}
+
+template<typename Real>
+CuSubMatrix<Real> CuMatrixStager<Real>::Acquire() {
+  KALDI_ASSERT(num_pending_ > 0);
+  int32 s = next_acquire_;
+  Slot &slot = slots_[s];
+#if HAVE_CUDA == 1
+  if (gpu_initialized_ && CuDevice::Instantiate().Enabled()) {
+    // everything queued so far on this thread's stream covers the last use of
+    // the previously acquired slot.
+    if (acquired_ >= 0)
+      CU_SAFE_CALL(cudaEventRecord(slots_[acquired_].released,
+                                   cudaStreamPerThread));
+    CU_SAFE_CALL(cudaStreamWaitEvent(cudaStreamPerThread, slot.copied, 0));
+  }
+#endif
+  acquired_ = s;
+  next_acquire_ = (s + 1) % slots_.size();
+  num_pending_--;
+  if (slot.num_rows == 0)
+    return CuSubMatrix<Real>(NULL, 0, 0, 0);
+  return CuSubMatrix<Real>(slot.mat.Data(), slot.num_rows,
+                           slot.mat.NumCols(), slot.mat.Stride());
+}
+
+template class CuMatrixStager<float>;
+template class CuMatrixStager<double>;
+
+}  // namespace kaldi
@@ -0,0 +1,113 @@
+// cudamatrix/cu-staging.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#ifndef KALDI_CUDAMATRIX_CU_STAGING_H_
+#define KALDI_CUDAMATRIX_CU_STAGING_H_
+
+#include <vector>
+#include "cudamatrix/cu-matrix.h"
+
+namespace kaldi {
+
+/**
+   Class CuMatrixStager uploads host matrices (typically training minibatches)
+   to the device through a small ring of reusable slots, so that the upload of
+   minibatch k+1 can overlap with the computation on minibatch k.
+
+   When a GPU is in use, each slot owns a page-locked (pinned) host buffer and
+   a device matrix.  Stage() copies the rows into the pinned buffer and issues
+   an asynchronous copy on a stream owned by this object; Acquire() makes the
+   calling thread's default stream wait for that copy (without blocking the
+   host) and returns a view of the device data.  The device matrices only ever
+   grow, so there is no allocation per minibatch once the largest one has been
+   seen.
+
+   Without a GPU (or when CUDA was not compiled in) Stage() is a plain copy
+   into the slot and Acquire() just returns it, so code using this class
+   behaves identically on CPU builds.
+
+   Typical double-buffered use:
+   \code
+     stager.Stage(first_batch);
+     while (have_batch) {
+       CuSubMatrix<BaseFloat> in(stager.Acquire());
+       if (have_next_batch) stager.Stage(next_batch);  // overlaps with below
+       nnet.Propagate(in, &out);
+       ...
+     }
+   \endcode
+
+   The view returned by Acquire() remains valid until the slot is staged into
+   again, i.e. at least until the next Acquire() call.  At most
+   NumSlots() - 1 matrices may be pending while one is acquired.
+ */
+template<typename Real>
+class CuMatrixStager {
+ public:
+  explicit CuMatrixStager(int32 num_slots = 2);
+
+  ~CuMatrixStager();
+
+  /// Starts copying 'src' to the device.  Returns before the copy has finished
+  /// when a GPU is used.  It is an error to stage more matrices than there are
+  /// free slots.
+  void Stage(const MatrixBase<Real> &src);
+
+  /// Returns the device copy of the oldest staged matrix that has not yet
+  /// been acquired.  Work queued afterwards on this thread's stream is ordered
+  /// after the copy.  Requires NumPending() > 0.
+  CuSubMatrix<Real> Acquire();
+
+  /// Number of matrices staged but not yet acquired.
+  int32 NumPending() const { return num_pending_; }
+
+  int32 NumSlots() const { return slots_.size(); }
+
+ private:
+  struct Slot {
+    CuMatrix<Real> mat;    // device copy; only grows.
+    MatrixIndexT num_rows; // rows of the currently staged matrix.
+    Real *pinned;          // page-locked host buffer (GPU only).
+    size_t pinned_size;    // in elements.
+#if HAVE_CUDA == 1
+    cudaEvent_t copied;    // recorded on copy_stream_ after the upload.
+    cudaEvent_t released;  // recorded on the compute stream when done with it.
+#endif
+    Slot(): num_rows(0), pinned(NULL), pinned_size(0) { }
+  };
+
+#if HAVE_CUDA == 1
+  void StageGpu(Slot *slot, const MatrixBase<Real> &src);
+  void InitGpu();
+  cudaStream_t copy_stream_;
+  bool gpu_initialized_;
+#endif
+
+  std::vector<Slot> slots_;
+  int32 next_acquire_;  // slot to be returned by the next Acquire().
+  int32 num_pending_;
+  int32 acquired_;      // slot returned by the last Acquire(), or -1.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(CuMatrixStager);
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_CUDAMATRIX_CU_STAGING_H_
@@ -26,6 +26,7 @@
 #endif
 
 #include "base/timer.h"
+#include "matrix/host-allocator.h"
 #include "cudamatrix/cu-common.h"
 #include "cudamatrix/cu-vector.h"
 #include "cudamatrix/cu-device.h"
@@ -1345,7 +1346,7 @@ void CuVector<Real>::Destroy() {
   } else
 #endif
   {
-    if (this->data_ != NULL) KALDI_MEMALIGN_FREE(this->data_);
+    HostMemoryAllocator::Instance().Free(this->data_);
   }
   this->data_ = NULL;
   this->dim_ = 0;
@@ -0,0 +1,136 @@
+// decoder/batch-lattice-faster-decoder-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include "decoder/batch-lattice-faster-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "fstext/fstext-utils.h"
+
+namespace kaldi {
+
+// A random graph with 'num_pdfs' input labels, as in
+// lattice-faster-decoder-test.cc.
+static fst::VectorFst<fst::StdArc> *RandomGraph(int32 num_states,
+                                                int32 num_pdfs) {
+  typedef fst::StdArc Arc;
+  fst::VectorFst<Arc> *fst = new fst::VectorFst<Arc>();
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    int32 num_arcs = RandInt(2, 10);
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 olabel = (Rand() % 5 == 0 ? RandInt(1, 1000) : 0);
+      fst->AddArc(s, Arc(RandInt(1, num_pdfs), olabel, 5.0 * RandUniform(),
+                         RandInt(0, num_states - 1)));
+    }
+    if (s + 1 < num_states && Rand() % 4 == 0)
+      fst->AddArc(s, Arc(0, RandInt(1, 1000), 2.0 * RandUniform(),
+                         RandInt(s + 1, num_states - 1)));
+    if (Rand() % 10 == 0)
+      fst->SetFinal(s, RandUniform());
+  }
+  return fst;
+}
+
+// The batch decoder has to give the best paths of the sequential
+// LatticeFasterDecoder, in input order, while it keeps at most
+// 2 * --batch-size utterances (plus the one being accepted) not yet output.
+void UnitTestBatchLatticeFasterDecoder() {
+  int32 num_pdfs = 100, num_utts = RandInt(1, 30);
+  fst::VectorFst<fst::StdArc> *fst = RandomGraph(5000, num_pdfs);
+  std::vector<Matrix<BaseFloat> > loglikes(num_utts);
+  std::vector<std::string> utt_ids(num_utts);
+  for (int32 i = 0; i < num_utts; i++) {
+    // some short utterances late in a batch, so they finish first.
+    loglikes[i].Resize(RandInt(10, 150), num_pdfs);
+    loglikes[i].SetRandn();
+    loglikes[i].Scale(3.0);
+    std::ostringstream os;
+    os << "utt" << i;
+    utt_ids[i] = os.str();
+  }
+
+  LatticeFasterDecoderConfig decoder_opts;
+  decoder_opts.beam = 12.0;
+  decoder_opts.max_active = 2000;
+  decoder_opts.lattice_beam = 6.0;
+  decoder_opts.determinize_lattice = false;
+
+  std::vector<std::vector<int32> > ref_ali(num_utts), ref_words(num_utts);
+  std::vector<BaseFloat> ref_cost(num_utts);
+  {
+    LatticeFasterDecoder decoder(*fst, decoder_opts);
+    for (int32 i = 0; i < num_utts; i++) {
+      DecodableMatrixScaled decodable(loglikes[i], 1.0);
+      KALDI_ASSERT(decoder.Decode(&decodable));
+      Lattice best_path;
+      decoder.GetBestPath(&best_path);
+      LatticeWeight weight;
+      fst::GetLinearSymbolSequence(best_path, &ref_ali[i], &ref_words[i],
+                                   &weight);
+      ref_cost[i] = weight.Value1() + weight.Value2();
+    }
+  }
+
+  BatchLatticeFasterDecoderConfig config;
+  config.num_threads = RandInt(1, 4);
+  config.batch_size = RandInt(1, 5);
+  TransitionModel trans_model;  // only used to determinize.
+  int32 num_output = 0;
+  {
+    BatchLatticeFasterDecoder decoder(config, *fst, decoder_opts, trans_model,
+                                      1.0, false);
+    std::string utt_id;
+    Lattice lat;
+    std::vector<int32> ali, words;
+    for (int32 i = 0; i <= num_utts; i++) {
+      if (i < num_utts) {
+        decoder.AcceptInput(utt_ids[i],
+                            new DecodableMatrixScaled(loglikes[i], 1.0));
+        KALDI_ASSERT(i + 1 - num_output <= 2 * config.batch_size + 1);
+      } else {
+        KALDI_ASSERT(decoder.Finished() == num_utts);
+      }
+      while (decoder.GetOutput(&utt_id, &lat, &ali, &words)) {
+        KALDI_ASSERT(utt_id == utt_ids[num_output]);
+        KALDI_ASSERT(ali == ref_ali[num_output] &&
+                     words == ref_words[num_output]);
+        Lattice best_path;
+        fst::ShortestPath(lat, &best_path);
+        LatticeWeight weight;
+        fst::GetLinearSymbolSequence(best_path, &ali, &words, &weight);
+        KALDI_ASSERT(ApproxEqual(weight.Value1() + weight.Value2(),
+                                 ref_cost[num_output]));
+        num_output++;
+      }
+    }
+  }
+  KALDI_ASSERT(num_output == num_utts);
+  delete fst;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 5; i++)
+    UnitTestBatchLatticeFasterDecoder();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,262 @@
+// decoder/batch-lattice-faster-decoder.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/batch-lattice-faster-decoder.h"
+#include "lat/lattice-functions.h"
+
+namespace kaldi {
+
+BatchLatticeFasterDecoder::BatchLatticeFasterDecoder(
+    const BatchLatticeFasterDecoderConfig &config,
+    const fst::Fst<fst::StdArc> &fst,
+    const LatticeFasterDecoderConfig &decoder_opts,
+    const TransitionModel &trans_model,
+    BaseFloat acoustic_scale,
+    bool allow_partial):
+    config_(config), decoder_opts_(decoder_opts), trans_model_(trans_model),
+    acoustic_scale_(acoustic_scale), allow_partial_(allow_partial),
+    is_finished_(false), num_accepted_(0), tot_like_(0.0), frame_count_(0),
+    num_success_(0), num_fail_(0), num_partial_(0) {
+  config_.Check();
+  for (int32 i = 0; i < config_.num_threads; i++)
+    decoders_.push_back(new PooledLatticeFasterDecoder(fst, decoder_opts_));
+  for (int32 i = 0; i < config_.num_threads; i++)
+    threads_.push_back(std::thread(DecodeLoopFunc, this, i));
+}
+
+void BatchLatticeFasterDecoder::AcceptInput(const std::string &utterance_id,
+                                            DecodableInterface *decodable) {
+  Utterance *utt = new Utterance();
+  utt->utterance_id = utterance_id;
+  utt->decodable = decodable;
+  utt->num_frames = decodable->NumFramesReady();
+  utt->batch = num_accepted_++ / config_.batch_size;
+  utt->finished = false;
+
+  // the decoded utterances wait in outputs_ for the ones before them, so they
+  // count against the read-ahead too; once the first one is decoded, the
+  // caller can take it (and those after it) and make room.
+  size_t max_queued = config_.batch_size, max_outputs = 2 * max_queued;
+  std::unique_lock<std::mutex> lock(mutex_);
+  KALDI_ASSERT(!is_finished_);
+  while (queue_.size() >= max_queued ||
+         (outputs_.size() >= max_outputs && !outputs_.front()->finished))
+    space_ready_.wait(lock);
+  queue_.push(utt);
+  outputs_.push_back(utt);
+  lock.unlock();
+  utterance_ready_.notify_one();
+}
+
+void BatchLatticeFasterDecoder::UtteranceFailed() {
+  std::unique_lock<std::mutex> lock(stats_mutex_);
+  num_fail_++;
+}
+
+int32 BatchLatticeFasterDecoder::Finished() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (is_finished_)
+      return num_success_;
+    is_finished_ = true;
+  }
+  utterance_ready_.notify_all();
+  for (size_t i = 0; i < threads_.size(); i++)
+    threads_[i].join();
+  return num_success_;
+}
+
+void BatchLatticeFasterDecoder::DecodeLoop(int32 thread_index) {
+  PooledLatticeFasterDecoder *decoder = decoders_[thread_index];
+  while (true) {
+    Utterance *utt;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (queue_.empty() && !is_finished_)
+        utterance_ready_.wait(lock);
+      if (queue_.empty())
+        return;  // is_finished_ and nothing left to do.
+      utt = queue_.top();
+      queue_.pop();
+    }
+    space_ready_.notify_one();
+
+    DecodeUtterance(decoder, utt);
+    delete utt->decodable;  // free the input as soon as possible.
+    utt->decodable = NULL;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      utt->finished = true;
+    }
+    space_ready_.notify_one();
+  }
+}
+
+void BatchLatticeFasterDecoder::DecodeUtterance(
+    PooledLatticeFasterDecoder *decoder, Utterance *utt) {
+  const std::string &utterance_id = utt->utterance_id;
+  if (!decoder->Decode(utt->decodable)) {
+    KALDI_WARN << "Failed to decode file " << utterance_id;
+    std::unique_lock<std::mutex> lock(stats_mutex_);
+    num_fail_++;
+    return;
+  }
+  bool partial = false;
+  if (!decoder->ReachedFinal()) {
+    if (allow_partial_) {
+      KALDI_WARN << "Outputting partial output for utterance " << utterance_id
+                 << " since no final-state reached\n";
+      partial = true;
+    } else {
+      KALDI_WARN << "Not producing output for utterance " << utterance_id
+                 << " since no final-state reached and "
+                 << "--allow-partial=false.\n";
+      std::unique_lock<std::mutex> lock(stats_mutex_);
+      num_fail_++;
+      return;
+    }
+  }
+
+  Lattice &lat = utt->lat;
+  decoder->GetRawLattice(&lat);
+  fst::Connect(&lat);
+  if (lat.NumStates() == 0) {
+    KALDI_WARN << "Unexpected problem getting lattice for utterance "
+               << utterance_id;
+    std::unique_lock<std::mutex> lock(stats_mutex_);
+    num_fail_++;
+    return;
+  }
+
+  LatticeWeight weight;
+  {
+    Lattice best_path;
+    ShortestPath(lat, &best_path);
+    GetLinearSymbolSequence(best_path, &(utt->alignment), &(utt->words),
+                            &weight);
+  }
+  int32 num_frames = utt->alignment.size();
+  double likelihood = -(weight.Value1() + weight.Value2());
+  KALDI_LOG << "Log-like per frame for utterance " << utterance_id << " is "
+            << (likelihood / num_frames) << " over " << num_frames
+            << " frames.";
+  KALDI_VLOG(2) << "Cost for utterance " << utterance_id << " is "
+                << weight.Value1() << " + " << weight.Value2();
+
+  if (decoder_opts_.determinize_lattice) {
+    if (!DeterminizeLatticePhonePrunedWrapper(
+            trans_model_, &lat, decoder_opts_.lattice_beam, &(utt->clat),
+            decoder_opts_.det_opts))
+      KALDI_WARN << "Determinization finished earlier than the beam for "
+                 << "utterance " << utterance_id;
+    lat.DeleteStates();
+  }
+  // We'll write the lattice without acoustic scaling.
+  if (acoustic_scale_ != 0.0) {
+    if (decoder_opts_.determinize_lattice)
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_),
+                        &(utt->clat));
+    else
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_),
+                        &lat);
+  }
+
+  std::unique_lock<std::mutex> lock(stats_mutex_);
+  tot_like_ += likelihood;
+  frame_count_ += num_frames;
+  num_success_++;
+  if (partial)
+    num_partial_++;
+}
+
+BatchLatticeFasterDecoder::Utterance *BatchLatticeFasterDecoder::NextOutput() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!outputs_.empty() && outputs_.front()->finished) {
+    Utterance *utt = outputs_.front();
+    outputs_.pop_front();
+    if (utt->lat.NumStates() != 0 || utt->clat.NumStates() != 0)
+      return utt;
+    delete utt;  // it failed; there was a warning.
+  }
+  return NULL;
+}
+
+bool BatchLatticeFasterDecoder::GetOutput(std::string *utterance_id,
+                                          CompactLattice *clat,
+                                          std::vector<int32> *alignment,
+                                          std::vector<int32> *words) {
+  if (!decoder_opts_.determinize_lattice)
+    KALDI_ERR << "Don't call this version of GetOutput if you are "
+        "not determinizing.";
+  Utterance *utt = NextOutput();
+  if (utt == NULL)
+    return false;
+  utterance_id->swap(utt->utterance_id);
+  *clat = utt->clat;
+  if (alignment != NULL) alignment->swap(utt->alignment);
+  if (words != NULL) words->swap(utt->words);
+  delete utt;
+  return true;
+}
+
+bool BatchLatticeFasterDecoder::GetOutput(std::string *utterance_id,
+                                          Lattice *lat,
+                                          std::vector<int32> *alignment,
+                                          std::vector<int32> *words) {
+  if (decoder_opts_.determinize_lattice)
+    KALDI_ERR << "Don't call this version of GetOutput if you are "
+        "determinizing.";
+  Utterance *utt = NextOutput();
+  if (utt == NULL)
+    return false;
+  utterance_id->swap(utt->utterance_id);
+  *lat = utt->lat;
+  if (alignment != NULL) alignment->swap(utt->alignment);
+  if (words != NULL) words->swap(utt->words);
+  delete utt;
+  return true;
+}
+
+BatchLatticeFasterDecoder::~BatchLatticeFasterDecoder() {
+  Finished();
+  if (!outputs_.empty()) {
+    KALDI_WARN << "Destroying BatchLatticeFasterDecoder with "
+               << outputs_.size() << " outputs that were not consumed.";
+    for (std::list<Utterance*>::iterator iter = outputs_.begin();
+         iter != outputs_.end(); ++iter) {
+      delete (*iter)->decodable;
+      delete *iter;
+    }
+  }
+  for (size_t i = 0; i < decoders_.size(); i++)
+    delete decoders_[i];
+
+  double elapsed = timer_.Elapsed();
+  KALDI_LOG << "Decoded with " << config_.num_threads << " threads.";
+  KALDI_LOG << "Time taken " << elapsed
+            << "s: real-time factor per thread assuming 100 frames/sec is "
+            << (config_.num_threads * elapsed * 100.0 /
+                std::max<int64>(frame_count_, 1));
+  KALDI_LOG << "Done " << num_success_ << " utterances ("
+            << num_partial_ << " partial), failed for " << num_fail_;
+  KALDI_LOG << "Overall log-likelihood per frame is "
+            << (tot_like_ / std::max<int64>(frame_count_, 1)) << " over "
+            << frame_count_ << " frames.";
+}
+
+}  // namespace kaldi
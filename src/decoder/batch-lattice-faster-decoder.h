@@ -0,0 +1,190 @@
+// decoder/batch-lattice-faster-decoder.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_BATCH_LATTICE_FASTER_DECODER_H_
+#define KALDI_DECODER_BATCH_LATTICE_FASTER_DECODER_H_
+
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/timer.h"
+#include "decoder/lattice-faster-decoder.h"
+#include "hmm/transition-model.h"
+#include "itf/options-itf.h"
+
+namespace kaldi {
+
+struct BatchLatticeFasterDecoderConfig {
+  int32 num_threads;
+  int32 batch_size;
+
+  BatchLatticeFasterDecoderConfig(): num_threads(1), batch_size(64) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("num-threads", &num_threads, "Number of decoder threads.");
+    opts->Register("batch-size", &batch_size, "Utterances are scheduled in "
+                   "batches of this many, in input order; within a batch the "
+                   "longest utterances are decoded first.  Also the number of "
+                   "utterances that may be read ahead; at most twice this "
+                   "many are held until they are output.");
+  }
+  void Check() const {
+    KALDI_ASSERT(num_threads > 0 && batch_size > 0);
+  }
+};
+
+
+/**
+   BatchLatticeFasterDecoder decodes a stream of utterances with one graph in
+   several threads.  Unlike running a DecodeUtteranceLatticeFasterClass per
+   utterance through a TaskSequencer, it keeps one decoder per thread for the
+   whole run (a PooledLatticeFasterDecoder, so the tokens and links of an
+   utterance reuse the memory of the previous ones), and it does not decode the
+   utterances in input order: the input is cut into batches of --batch-size
+   utterances, and a thread that becomes free takes the longest remaining
+   utterance of the earliest batch.  Decoding the long utterances first means
+   that the threads finish a batch at about the same time, instead of one
+   thread being left with a long utterance at the end.
+
+   The outputs come out of GetOutput() in input order; like
+   NnetBatchDecoder, the usage is
+
+     for each utterance:
+       AcceptInput(utt, decodable);
+       while (GetOutput(...)) write the output;
+     Finished();
+     while (GetOutput(...)) write the output;
+*/
+class BatchLatticeFasterDecoder {
+ public:
+  /// 'fst' is shared by the threads.  Lattices are output without acoustic
+  /// scaling, i.e. their acoustic costs are divided by 'acoustic_scale' (which
+  /// is expected to have been applied by the decodable objects).
+  BatchLatticeFasterDecoder(const BatchLatticeFasterDecoderConfig &config,
+                            const fst::Fst<fst::StdArc> &fst,
+                            const LatticeFasterDecoderConfig &decoder_opts,
+                            const TransitionModel &trans_model,
+                            BaseFloat acoustic_scale,
+                            bool allow_partial);
+
+  /// Queues an utterance; takes ownership of 'decodable', which is deleted once
+  /// it has been decoded.  The length of the utterance is taken from
+  /// decodable->NumFramesReady(), so all of its frames should be ready.  Blocks
+  /// while --batch-size utterances are waiting to be decoded, or while
+  /// 2 * --batch-size utterances are not output yet and the first of them is
+  /// not decoded.
+  void AcceptInput(const std::string &utterance_id,
+                   DecodableInterface *decodable);
+
+  /// Call this for utterances that failed before they could be given to
+  /// AcceptInput() (e.g. missing input), to keep the statistics.
+  void UtteranceFailed();
+
+  /// Call this when all input has been given.  Waits for the decoding to
+  /// finish; GetOutput() then returns the remaining outputs.  Returns the
+  /// number of utterances that were decoded successfully.
+  int32 Finished();
+
+  /// Gets the next output in input order, if it is ready (it does not wait).
+  /// Utterances that failed are skipped (there was a warning).  For use if
+  /// decoder_opts.determinize_lattice == true; 'alignment' and 'words' are
+  /// those of the best path and may be NULL.
+  bool GetOutput(std::string *utterance_id, CompactLattice *clat,
+                 std::vector<int32> *alignment, std::vector<int32> *words);
+
+  /// As above, for decoder_opts.determinize_lattice == false.
+  bool GetOutput(std::string *utterance_id, Lattice *lat,
+                 std::vector<int32> *alignment, std::vector<int32> *words);
+
+  /// Prints statistics.
+  ~BatchLatticeFasterDecoder();
+
+ private:
+  struct Utterance {
+    std::string utterance_id;
+    DecodableInterface *decodable;  // owned here until decoded.
+    int32 num_frames;
+    int64 batch;  // index of the batch the utterance is in.
+    bool finished;  // protected by mutex_.
+    // the output; the lattice is empty if decoding failed.
+    CompactLattice clat;
+    Lattice lat;
+    std::vector<int32> alignment, words;
+  };
+
+  // Defines the order in which the queued utterances are decoded: earlier
+  // batches first, and longer utterances first within a batch.
+  struct UtteranceLess {
+    bool operator () (const Utterance *a, const Utterance *b) const {
+      if (a->batch != b->batch)
+        return a->batch > b->batch;
+      return a->num_frames < b->num_frames;
+    }
+  };
+
+  // The decoder threads run this.
+  void DecodeLoop(int32 thread_index);
+  static void DecodeLoopFunc(BatchLatticeFasterDecoder *object,
+                             int32 thread_index) {
+    object->DecodeLoop(thread_index);
+  }
+
+  // Decodes 'utt' with 'decoder' and sets up its output.
+  void DecodeUtterance(PooledLatticeFasterDecoder *decoder, Utterance *utt);
+
+  // Returns the next output, if ready, and removes it from outputs_.
+  Utterance *NextOutput();
+
+  BatchLatticeFasterDecoderConfig config_;
+  const LatticeFasterDecoderConfig &decoder_opts_;
+  const TransitionModel &trans_model_;
+  BaseFloat acoustic_scale_;
+  bool allow_partial_;
+
+  std::vector<PooledLatticeFasterDecoder*> decoders_;  // one per thread.
+  std::vector<std::thread> threads_;
+
+  std::mutex mutex_;  // protects the members below, down to is_finished_.
+  std::condition_variable utterance_ready_;  // signaled when queue_ gets an
+                                             // utterance or is_finished_ is
+                                             // set.
+  std::condition_variable space_ready_;  // signaled when an utterance is taken
+                                         // from queue_ or is finished.
+  std::priority_queue<Utterance*, std::vector<Utterance*>, UtteranceLess> queue_;
+  std::list<Utterance*> outputs_;  // all utterances not yet output, in input
+                                   // order.
+  bool is_finished_;
+
+  int64 num_accepted_;  // only used by the main thread.
+
+  std::mutex stats_mutex_;  // protects the statistics.
+  double tot_like_;
+  int64 frame_count_;
+  int32 num_success_, num_fail_, num_partial_;
+  Timer timer_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(BatchLatticeFasterDecoder);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_BATCH_LATTICE_FASTER_DECODER_H_
@@ -0,0 +1,122 @@
+// decoder/context-biasing-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+
+#include "decoder/context-biasing.h"
+
+namespace kaldi {
+
+// Returns the number of words in all occurrences of the phrases in 'words'
+// (overlapping occurrences count separately; a phrase given twice counts
+// once).
+static int32 CountPhraseWords(const std::vector<std::vector<int32> > &phrases,
+                              const std::vector<int32> &words) {
+  std::vector<std::vector<int32> > uniq_phrases(phrases);
+  SortAndUniq(&uniq_phrases);
+  int32 ans = 0;
+  for (size_t i = 0; i < uniq_phrases.size(); i++) {
+    const std::vector<int32> &phrase = uniq_phrases[i];
+    if (phrase.empty())
+      continue;
+    for (size_t start = 0; start + phrase.size() <= words.size(); start++)
+      if (std::equal(phrase.begin(), phrase.end(), words.begin() + start))
+        ans += phrase.size();
+  }
+  return ans;
+}
+
+// The cost of a word sequence, including the final cost, must be -boost times
+// the number of words in the phrases it contains; and it must never block.
+void UnitTestContextBiasing() {
+  int32 num_words = RandInt(2, 6);
+  std::vector<std::vector<int32> > phrases(RandInt(0, 5));
+  for (size_t i = 0; i < phrases.size(); i++) {
+    phrases[i].resize(RandInt(1, 4));
+    for (size_t j = 0; j < phrases[i].size(); j++)
+      phrases[i][j] = RandInt(1, num_words);
+  }
+  ContextBiasingOptions opts;
+  opts.boost = 0.5 + RandUniform();
+  ContextBiasingFst biasing(opts, phrases);
+
+  for (int32 n = 0; n < 20; n++) {
+    std::vector<int32> words(RandInt(0, 20));
+    for (size_t i = 0; i < words.size(); i++)
+      words[i] = RandInt(1, num_words);
+    fst::StdArc::StateId s = biasing.Start();
+    BaseFloat cost = 0.0;
+    for (size_t i = 0; i < words.size(); i++) {
+      fst::StdArc arc;
+      KALDI_ASSERT(biasing.GetArc(s, words[i], &arc));
+      KALDI_ASSERT(arc.olabel == words[i] && arc.nextstate >= 0 &&
+                   arc.nextstate < biasing.NumStates());
+      cost += arc.weight.Value();
+      s = arc.nextstate;
+    }
+    cost += biasing.Final(s).Value();
+    BaseFloat expected = -opts.boost * CountPhraseWords(phrases, words);
+    KALDI_ASSERT(ApproxEqual(cost, expected, 0.001) ||
+                 std::abs(cost - expected) < 0.001);
+  }
+}
+
+void UnitTestContextBiasingExample() {
+  // phrases "1 2 3" and "2 3 4"; the word sequence "1 2 3 4" contains both.
+  std::vector<std::vector<int32> > phrases(2);
+  phrases[0].push_back(1);
+  phrases[0].push_back(2);
+  phrases[0].push_back(3);
+  phrases[1].push_back(2);
+  phrases[1].push_back(3);
+  phrases[1].push_back(4);
+  ContextBiasingOptions opts;
+  opts.boost = 1.0;
+  ContextBiasingFst biasing(opts, phrases);
+  KALDI_ASSERT(biasing.NumStates() == 7);
+
+  fst::StdArc arc;
+  fst::StdArc::StateId s = biasing.Start();
+  biasing.GetArc(s, 1, &arc);
+  KALDI_ASSERT(arc.weight.Value() == -1.0);
+  s = arc.nextstate;
+  biasing.GetArc(s, 2, &arc);
+  KALDI_ASSERT(arc.weight.Value() == -1.0);
+  s = arc.nextstate;
+  biasing.GetArc(s, 3, &arc);  // completes "1 2 3": -1, then -3 for the phrase.
+  KALDI_ASSERT(arc.weight.Value() == -4.0);
+  s = arc.nextstate;
+  // fails to "2 3", giving back 1 boost, and completes "2 3 4".
+  biasing.GetArc(s, 4, &arc);
+  KALDI_ASSERT(arc.weight.Value() == 1.0 - 1.0 - 3.0);
+  s = arc.nextstate;
+  KALDI_ASSERT(biasing.Final(s).Value() == 3.0);
+  // a word that matches nothing goes back to the start.
+  biasing.GetArc(s, 5, &arc);
+  KALDI_ASSERT(arc.nextstate == biasing.Start() && arc.weight.Value() == 3.0);
+}
+
+}  // namespace kaldi
+
+int main() {
+  kaldi::UnitTestContextBiasingExample();
+  for (int32 i = 0; i < 100; i++)
+    kaldi::UnitTestContextBiasing();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,124 @@
+// decoder/context-biasing.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "decoder/context-biasing.h"
+
+namespace kaldi {
+
+ContextBiasingFst::ContextBiasingFst(
+    const ContextBiasingOptions &opts,
+    const std::vector<std::vector<int32> > &phrases): opts_(opts) {
+  State start;
+  start.depth = 0;
+  start.fail = 0;
+  start.phrase_cost = 0.0;
+  states_.push_back(start);
+
+  // Build the trie.
+  std::vector<std::vector<std::pair<Label, StateId> > > children(1);
+  std::vector<bool> is_end(1, false);
+  for (size_t i = 0; i < phrases.size(); i++) {
+    const std::vector<int32> &phrase = phrases[i];
+    if (phrase.empty() ||
+        std::find(phrase.begin(), phrase.end(), 0) != phrase.end())
+      continue;
+    StateId cur = 0;
+    for (size_t j = 0; j < phrase.size(); j++) {
+      std::pair<StateId, Label> key(cur, phrase[j]);
+      unordered_map<std::pair<StateId, Label>, StateId,
+                    PairHasher<StateId, Label> >::iterator iter =
+          arcs_.find(key);
+      if (iter != arcs_.end()) {
+        cur = iter->second;
+      } else {
+        State state;
+        state.depth = states_[cur].depth + 1;
+        state.fail = 0;
+        state.phrase_cost = 0.0;
+        StateId next = states_.size();
+        states_.push_back(state);
+        children.resize(next + 1);
+        is_end.push_back(false);
+        children[cur].push_back(std::make_pair(phrase[j], next));
+        arcs_[key] = next;
+        cur = next;
+      }
+    }
+    is_end[cur] = true;
+  }
+
+  // Work out the failure transitions and the phrase costs breadth-first, so
+  // those of the (shallower) failure states are known.
+  std::vector<StateId> queue(1, 0);
+  for (size_t q = 0; q < queue.size(); q++) {
+    StateId u = queue[q];
+    for (size_t i = 0; i < children[u].size(); i++) {
+      Label word = children[u][i].first;
+      StateId v = children[u][i].second;
+      StateId fail = 0;
+      if (u != 0) {
+        for (StateId f = states_[u].fail; ; f = states_[f].fail) {
+          unordered_map<std::pair<StateId, Label>, StateId,
+                        PairHasher<StateId, Label> >::const_iterator iter =
+              arcs_.find(std::make_pair(f, word));
+          if (iter != arcs_.end()) {
+            fail = iter->second;
+            break;
+          }
+          if (f == 0)
+            break;
+        }
+      }
+      State &state = states_[v];
+      state.fail = fail;
+      state.phrase_cost = states_[fail].phrase_cost;
+      if (is_end[v])
+        state.phrase_cost -= opts_.boost * state.depth;
+      queue.push_back(v);
+    }
+  }
+}
+
+bool ContextBiasingFst::GetArc(StateId s, Label ilabel, Arc *oarc) {
+  KALDI_ASSERT(static_cast<size_t>(s) < states_.size());
+  StateId t = s;
+  while (true) {
+    unordered_map<std::pair<StateId, Label>, StateId,
+                  PairHasher<StateId, Label> >::const_iterator iter =
+        arcs_.find(std::make_pair(t, ilabel));
+    if (iter != arcs_.end()) {
+      t = iter->second;
+      break;
+    }
+    if (t == 0)
+      break;
+    t = states_[t].fail;
+  }
+  // Boost the words of the partial match (taking back the boost of the words
+  // that the failure transitions dropped), plus the phrases completed.
+  BaseFloat cost = opts_.boost * (states_[s].depth - states_[t].depth) +
+      states_[t].phrase_cost;
+  oarc->ilabel = ilabel;
+  oarc->olabel = ilabel;
+  oarc->weight = Weight(cost);
+  oarc->nextstate = t;
+  return true;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,110 @@
+// decoder/context-biasing.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_CONTEXT_BIASING_H_
+#define KALDI_DECODER_CONTEXT_BIASING_H_
+
+#include <utility>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "fstext/deterministic-fst.h"
+#include "itf/options-itf.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+struct ContextBiasingOptions {
+  BaseFloat boost;
+
+  ContextBiasingOptions(): boost(2.0) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("biasing-boost", &boost, "Score boost per word of a "
+                   "biasing phrase (in the units of the graph or LM scores, "
+                   "i.e. natural-log probabilities).");
+  }
+};
+
+
+/**
+   ContextBiasingFst boosts the scores of a list of phrases (word sequences)
+   during decoding, without changing the decoding graph.  It is built per
+   request from the phrase list, which takes time linear in the total length
+   of the phrases, and used as a DeterministicOnDemandFst that the decoder
+   composes with its search space on the fly: LatticeBiglmFasterDecoder takes
+   it as its "lm_diff_fst" (combine it with a real difference LM using
+   ComposeDeterministicOnDemandFst), and CTCDecoder through SetBiasing().
+
+   The states are the nodes of a trie of the phrases, with failure transitions
+   as in the Aho-Corasick algorithm: a word that does not continue the current
+   partial match goes to the longest suffix of the words seen so far that is
+   a prefix of some phrase.  Each word that extends a partial match gets a
+   boost of --biasing-boost, and that boost is taken back when the match
+   fails or the utterance ends (through the final cost), so that only complete
+   phrases keep it; when a phrase is completed, including one that ends as a
+   suffix of the current match, its boost is made permanent.  So a path that
+   contains phrases at the end gets -boost times their total length added to
+   its cost, and the partial matches get it during the search, where it helps
+   the phrase survive pruning.
+
+   Every word has an arc from every state (to the start state if nothing
+   matches), so this FST never blocks a path.
+*/
+class ContextBiasingFst: public fst::DeterministicOnDemandFst<fst::StdArc> {
+ public:
+  typedef fst::StdArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+  typedef Arc::Label Label;
+
+  /// Phrases that are empty or contain the label zero are ignored.
+  ContextBiasingFst(const ContextBiasingOptions &opts,
+                    const std::vector<std::vector<int32> > &phrases);
+
+  virtual StateId Start() { return 0; }
+
+  /// Takes back the boost of the words of an incomplete match.
+  virtual Weight Final(StateId s) {
+    return Weight(opts_.boost * states_[s].depth);
+  }
+
+  virtual bool GetArc(StateId s, Label ilabel, Arc *oarc);
+
+  int32 NumStates() const { return states_.size(); }
+
+ private:
+  struct State {
+    int32 depth;  // number of words matched.
+    StateId fail;  // the state we go to if the next word does not match.
+    BaseFloat phrase_cost;  // the (negative) cost of the phrases that end
+                            // here, including those that end as a suffix.
+  };
+
+  ContextBiasingOptions opts_;
+  std::vector<State> states_;
+  // The arcs of the trie, from (state, word) to the next state.
+  unordered_map<std::pair<StateId, Label>, StateId,
+                PairHasher<StateId, Label> > arcs_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ContextBiasingFst);
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_CONTEXT_BIASING_H_
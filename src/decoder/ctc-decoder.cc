@@ -40,6 +40,7 @@ CTCDecoder::CTCDecoder(CTCDecoderOptions &config,
 						std::vector<ConstArpaLm *> &sub_const_arpa):
 		config_(config), lstmlm_(lstmlm), const_arpa_(const_arpa), sub_const_arpa_(sub_const_arpa) {
 	in_scene_ = false;
+	biasing_ = NULL;
 	Initialize();
 #if HAVE_KENLM == 1
     kenlm_arpa_ = NULL;
@@ -54,6 +55,7 @@ CTCDecoder::CTCDecoder(CTCDecoderOptions &config,
 						std::vector<KenModel *> &sub_kenlm_apra):
 		config_(config), lstmlm_(lstmlm), kenlm_arpa_(kenlm_arpa), sub_kenlm_apra_(sub_kenlm_apra) {
 	in_scene_ = false;
+	biasing_ = NULL;
 	if (scene_trie_.LoadDict(config.scene_syms_filename))
     	in_scene_ = true;
 
@@ -1404,11 +1406,11 @@ void CTCDecoder::BeamSearchEasyTopk(const Matrix<BaseFloat> &loglikes) {
 	PrefixSeq *preseq, *n_preseq;
 	std::vector<int> prefix, n_prefix;
 	std::vector<float> next_words(vocab_size);
-	float logp = 0, logp_b = 0, logp_lm = 0, n_p_b, n_p_nb;
+	float logp = 0, logp_b = 0, logp_lm = 0, bias_logp = 0, n_p_b, n_p_nb;
 	float ngram_logp = kLogZeroFloat, rnnlm_logp = kLogZeroFloat, sub_ngram_logp = kLogZeroFloat,
 			rscale = config_.rnnlm_scale,
             blank_penalty = log(config_.blank_penalty);
-	int end_t, index, topk = likes_size/2, key, cur_his = 0, start = 0;
+	int end_t, index, topk = likes_size/2, key, cur_his = 0, start = 0, bias_state = 0;
     bool skip_blank = false, uselm;
 
     // rnnlm
@@ -1559,6 +1561,16 @@ void CTCDecoder::BeamSearchEasyTopk(const Matrix<BaseFloat> &loglikes) {
 					n_p_nb = preseq->logp_blank+logp;
 				}
 
+				// contextual biasing score
+				bias_logp = 0;
+				bias_state = preseq->bias_state;
+				if (biasing_ != NULL) {
+					fst::StdArc arc;
+					biasing_->GetArc(preseq->bias_state, key, &arc);
+					bias_state = arc.nextstate;
+					bias_logp = -arc.weight.Value();
+				}
+
 				// *NB* this would be a good place to include an LM score.
 				if (config_.lm_scale > 0.0) {
                     // rnn lm score
@@ -1605,7 +1617,8 @@ void CTCDecoder::BeamSearchEasyTopk(const Matrix<BaseFloat> &loglikes) {
 				n_preseq->logp_blank = n_p_b;
 				n_preseq->logp_nblank = n_p_nb;
 				//n_preseq->logp_nblank = n_p_nb + logp_lm;
-				n_preseq->logp_lm += logp_lm;
+				n_preseq->logp_lm += logp_lm + bias_logp;
+				n_preseq->bias_state = bias_state;
 				n_preseq->logp = n_preseq->logp_lm +  LogAdd(n_p_b, n_p_nb);
 				//n_preseq->logp = LogAdd(n_p_b, n_p_nb);
 			}
@@ -1626,6 +1639,9 @@ void CTCDecoder::BeamSearchEasyTopk(const Matrix<BaseFloat> &loglikes) {
         }
         cur_his = (cur_his+1)%2;
 	}
+
+	if (biasing_ != NULL)
+		FinalizeBiasing();
 }
 
 void CTCDecoder::DeleteSceneBeam(std::vector<PrefixSeq> &beam, int size) {
@@ -1665,11 +1681,11 @@ void CTCDecoder::BeamSearchEasySceneTopk(const Matrix<BaseFloat> &loglikes) {
 	std::vector<int> prefix, n_prefix;
 	std::vector<float> next_words(vocab_size);
 	std::vector<int> next_scene_bpes(vocab_size);
-	float logp = 0, logp_b = 0, logp_lm = 0, sence_logp = 0, n_p_b, n_p_nb;
+	float logp = 0, logp_b = 0, logp_lm = 0, sence_logp = 0, bias_logp = 0, n_p_b, n_p_nb;
 	float ngram_logp = kLogZeroFloat, rnnlm_logp = kLogZeroFloat, sub_ngram_logp = kLogZeroFloat,
 			rscale = config_.rnnlm_scale,
             blank_penalty = log(config_.blank_penalty);
-	int end_t, index, topk = likes_size/2, key, cur_his = 0, start = 0;
+	int end_t, index, topk = likes_size/2, key, cur_his = 0, start = 0, bias_state = 0;
     bool skip_blank = false, uselm;
     TrieNode *node, *next_node;
 
@@ -1851,6 +1867,16 @@ void CTCDecoder::BeamSearchEasySceneTopk(const Matrix<BaseFloat> &loglikes) {
 					n_p_nb = preseq->logp_blank+logp;
 				}
 
+				// contextual biasing score
+				bias_logp = 0;
+				bias_state = preseq->bias_state;
+				if (biasing_ != NULL) {
+					fst::StdArc arc;
+					biasing_->GetArc(preseq->bias_state, key, &arc);
+					bias_state = arc.nextstate;
+					bias_logp = -arc.weight.Value();
+				}
+
 				// normal asr
 				if (preseq->scene_node == NULL) {
 					n_preseq = &next_beam_easy_[next_beam_size_];
@@ -1903,7 +1929,8 @@ void CTCDecoder::BeamSearchEasySceneTopk(const Matrix<BaseFloat> &loglikes) {
 					n_preseq->logp_blank = n_p_b;
 					n_preseq->logp_nblank = n_p_nb;
 					//n_preseq->logp_nblank = n_p_nb + logp_lm;
-					n_preseq->logp_lm += logp_lm;
+					n_preseq->logp_lm += logp_lm + bias_logp;
+					n_preseq->bias_state = bias_state;
 					n_preseq->logp = n_preseq->logp_lm +  LogAdd(n_p_b, n_p_nb);
 					//n_preseq->logp = LogAdd(n_p_b, n_p_nb);
 				}
@@ -1945,7 +1972,8 @@ void CTCDecoder::BeamSearchEasySceneTopk(const Matrix<BaseFloat> &loglikes) {
 					n_preseq->PrefixAppend(key);
 					n_preseq->logp_blank = n_p_b;
 					n_preseq->logp_nblank = n_p_nb;
-					n_preseq->logp_lm += logp_lm;
+					n_preseq->logp_lm += logp_lm + bias_logp;
+					n_preseq->bias_state = bias_state;
 					n_preseq->logp = n_preseq->logp_lm +  LogAdd(n_p_b, n_p_nb);
 
 					n_preseq->scene_node = NULL;
@@ -1965,7 +1993,8 @@ void CTCDecoder::BeamSearchEasySceneTopk(const Matrix<BaseFloat> &loglikes) {
 						n_preseq->PrefixAppend(key);
 						n_preseq->logp_blank = n_p_b;
 						n_preseq->logp_nblank = n_p_nb;
-						n_preseq->logp_lm += logp_lm;
+						n_preseq->logp_lm += logp_lm + bias_logp;
+						n_preseq->bias_state = bias_state;
 						n_preseq->logp = n_preseq->logp_lm +  LogAdd(n_p_b, n_p_nb);
 
 						n_preseq->scene_node = next_node;
@@ -1980,7 +2009,8 @@ void CTCDecoder::BeamSearchEasySceneTopk(const Matrix<BaseFloat> &loglikes) {
 					n_preseq->PrefixAppend(key);
 					n_preseq->logp_blank = n_p_b;
 					n_preseq->logp_nblank = n_p_nb;
-					n_preseq->logp_lm += logp_lm;
+					n_preseq->logp_lm += logp_lm + bias_logp;
+					n_preseq->bias_state = bias_state;
 					n_preseq->logp = n_preseq->logp_lm +  LogAdd(n_p_b, n_p_nb);
 
 					n_preseq->scene_node = next_node;
@@ -2020,10 +2050,26 @@ void CTCDecoder::BeamSearchEasySceneTopk(const Matrix<BaseFloat> &loglikes) {
         cur_his = (cur_his+1)%2;
 	}
 
+	if (biasing_ != NULL)
+		FinalizeBiasing();
+
     if (in_scene_) {
         DeleteSceneBeam(beam_easy_, cur_beam_size_+cur_scene_beam_size_);
     }
 }
 
+void CTCDecoder::FinalizeBiasing() {
+	for (int i = 0; i < cur_beam_size_+cur_scene_beam_size_; i++) {
+		PrefixSeq &seq = beam_easy_[i];
+		BaseFloat refund = biasing_->Final(seq.bias_state).Value();
+		seq.logp_lm -= refund;
+		seq.logp -= refund;
+		seq.bias_state = biasing_->Start();
+	}
+	std::sort(beam_easy_.begin(), beam_easy_.begin()+cur_beam_size_);
+	std::sort(beam_easy_.begin()+cur_beam_size_,
+			beam_easy_.begin()+cur_beam_size_+cur_scene_beam_size_);
+}
+
 
 } // end namespace kaldi.
@@ -27,6 +27,7 @@
 #include "util/trie-tree.h"
 #include "lm/kaldi-lstmlm.h"
 #include "lm/const-arpa-lm.h"
+#include "decoder/context-biasing.h"
 
 #if HAVE_KENLM == 1
 #include "lm/model.hh"
@@ -50,6 +51,7 @@ struct PrefixSeq {
         logp = 0;
         scene_node = NULL;
         is_sence = false;
+        bias_state = 0;
 	}
 
 	PrefixSeq(LstmlmHistroy *h, const std::vector<int> &words) {
@@ -62,6 +64,7 @@ struct PrefixSeq {
         logp = 0;
         scene_node = NULL;
         is_sence = false;
+        bias_state = 0;
 	}
 
 	PrefixSeq(const std::vector<int> &words) {
@@ -74,6 +77,7 @@ struct PrefixSeq {
         logp = 0;
         scene_node = NULL;
         is_sence = false;
+        bias_state = 0;
 	}
 
 	PrefixSeq() {
@@ -90,6 +94,7 @@ struct PrefixSeq {
 		logp = 0;
 		scene_node = NULL;
         is_sence = false;
+        bias_state = 0;
 	}
 
 	void PrefixAppend(int word) {
@@ -127,6 +132,7 @@ struct PrefixSeq {
 		sub_ken_state = sub_state;
 		scene_node = NULL;
         is_sence = false;
+        bias_state = 0;
 	}
 
 	KenState	ken_state;
@@ -142,6 +148,8 @@ struct PrefixSeq {
 	Vector<BaseFloat> *lmlogp;
 	TrieNode *scene_node;
     bool is_sence;
+    // state in the contextual biasing FST, if any.
+    int bias_state;
 
 	// log probabilities for the prefix given that
 	// it ends in a blank and dose not end in a blank at this time step.
@@ -257,6 +265,12 @@ class CTCDecoder {
 
 		void BeamSearchEasySceneTopk(const Matrix<BaseFloat> &loglikes);
 
+		// Boosts the phrases of 'biasing' in the following utterances (NULL to
+		// stop); only the "easy" beam searches (BeamSearchEasyTopk and
+		// BeamSearchEasySceneTopk) use it.  The biasing scores are included in
+		// logp_lm.  Not owned; it may be changed between utterances.
+		void SetBiasing(ContextBiasingFst *biasing) { biasing_ = biasing; }
+
 	protected:
         void DeleteSceneBeam(std::vector<PrefixSeq> &beam, int size);
 
@@ -284,6 +298,10 @@ class CTCDecoder {
         void BeamMerge(std::vector<PrefixSeq*> &merge_beam,
         		std::vector<PrefixSeq*> *scene_beam, bool skip_blank = false);
 
+        // Takes back the biasing boost of incomplete phrases at the end of the
+        // utterance, and re-sorts the beam.
+        void FinalizeBiasing();
+
 
 		CTCDecoderOptions &config_;
 		KaldiLstmlmWrapper *lstmlm_;
@@ -320,6 +338,7 @@ class CTCDecoder {
 		std::vector<int> keyword_;
 		Trie scene_trie_;
 		bool in_scene_;
+		ContextBiasingFst *biasing_;
 
 #if HAVE_KENLM == 1
 		const KenVocab *kenlm_vocab_;
@@ -327,9 +327,12 @@ template bool DecodeUtteranceLatticeFaster(
     double *like_ptr);
 
 
-// Takes care of output.  Returns true on success.
-bool DecodeUtteranceLatticeSimple(
-    LatticeSimpleDecoder &decoder, // not const but is really an input.
+// Takes care of output for the decoders whose GetRawLattice() returns false
+// on failure (LatticeSimpleDecoder, LatticeBiglmFasterDecoder).  Returns true
+// on success.
+template <typename Decoder>
+static bool DecodeUtteranceLatticeTpl(
+    Decoder &decoder, // not const but is really an input.
     DecodableInterface &decodable, // not const but is really an input.
     const TransitionModel &trans_model,
     const fst::SymbolTable *word_syms,
@@ -424,6 +427,48 @@ bool DecodeUtteranceLatticeSimple(
   return true;
 }
 
+bool DecodeUtteranceLatticeSimple(
+    LatticeSimpleDecoder &decoder, // not const but is really an input.
+    DecodableInterface &decodable, // not const but is really an input.
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr) {
+  return DecodeUtteranceLatticeTpl(decoder, decodable, trans_model, word_syms,
+                                   utt, acoustic_scale, determinize,
+                                   allow_partial, alignment_writer,
+                                   words_writer, compact_lattice_writer,
+                                   lattice_writer, like_ptr);
+}
+
+bool DecodeUtteranceLatticeBiglmFaster(
+    LatticeBiglmFasterDecoder &decoder, // not const but is really an input.
+    DecodableInterface &decodable, // not const but is really an input.
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr) {
+  return DecodeUtteranceLatticeTpl(decoder, decodable, trans_model, word_syms,
+                                   utt, acoustic_scale, determinize,
+                                   allow_partial, alignment_writer,
+                                   words_writer, compact_lattice_writer,
+                                   lattice_writer, like_ptr);
+}
+
 
 // see comment in header.
 void ModifyGraphForCarefulAlignment(
@@ -29,6 +29,7 @@
 #include "fstext/fstext-lib.h"
 #include "lat/kaldi-lattice.h"
 #include "decoder/lattice-faster-decoder.h" // for options.
+#include "decoder/lm-lookahead.h"
 
 
 namespace kaldi {
@@ -43,6 +44,14 @@ typedef LatticeFasterDecoderConfig LatticeBiglmFasterDecoderConfig;
     DeterministicOnDemandFst follows through the epsilons in G for you
     (assuming G is a standard backoff language model) and makes it look
     like a determinized FST.
+
+    It can also decode with an HCL graph (no grammar) and the full language
+    model as "lm_diff_fst", i.e. do the whole composition with G on the fly;
+    for that, give it an LmLookahead object built from the same graph and LM,
+    which pushes the LM costs of the words that can be reached from each state
+    towards the start of the words, so the beams can be as narrow as with a
+    static HCLG.  The lookahead changes where on a path the costs are, not
+    their total, so the lattice arcs carry costs shifted by the lookahead.
 */
 
 class LatticeBiglmFasterDecoder {
@@ -57,9 +66,10 @@ class LatticeBiglmFasterDecoder {
   LatticeBiglmFasterDecoder(
       const fst::Fst<fst::StdArc> &fst,      
       const LatticeBiglmFasterDecoderConfig &config,
-      fst::DeterministicOnDemandFst<fst::StdArc> *lm_diff_fst):
-      fst_(fst), lm_diff_fst_(lm_diff_fst), config_(config),
-      warned_noarc_(false), num_toks_(0) {
+      fst::DeterministicOnDemandFst<fst::StdArc> *lm_diff_fst,
+      LmLookahead *lookahead = NULL):
+      fst_(fst), lm_diff_fst_(lm_diff_fst), lookahead_(lookahead),
+      config_(config), warned_noarc_(false), num_toks_(0) {
     config.Check();
     KALDI_ASSERT(fst.Start() != fst::kNoStateId &&
                  lm_diff_fst->Start() != fst::kNoStateId);
@@ -83,6 +93,8 @@ class LatticeBiglmFasterDecoder {
     final_costs_.clear();
     num_toks_ = 0;
     PairId start_pair = ConstructPair(fst_.Start(), lm_diff_fst_->Start());
+    start_lookahead_cost_ = LookaheadCost(fst_.Start(),
+                                          lm_diff_fst_->Start());
     active_toks_.resize(1);
     Token *start_tok = new Token(0.0, 0.0, NULL, NULL);
     active_toks_[0].toks = start_tok;
@@ -448,6 +460,8 @@ class LatticeBiglmFasterDecoder {
       Token *tok = e->val;
       BaseFloat final_cost = fst_.Final(state).Value() +
           lm_diff_fst_->Final(lm_state).Value();
+      if (lookahead_ != NULL && final_cost != infinity)  // undo the lookahead.
+        final_cost += start_lookahead_cost_ - LookaheadCost(state, lm_state);
       tok_to_final_cost[tok] = final_cost;
       best_cost_final = std::min(best_cost_final, tok->tot_cost + final_cost);
       best_cost_nofinal = std::min(best_cost_nofinal, tok->tot_cost);
@@ -660,6 +674,28 @@ class LatticeBiglmFasterDecoder {
     }
   }
 
+  // Returns the lookahead cost of a state pair, or zero if we are not doing
+  // lookahead.
+  inline BaseFloat LookaheadCost(StateId state, StateId lm_state) {
+    return (lookahead_ == NULL ? 0.0 : lookahead_->Cost(state, lm_state));
+  }
+
+  // "cur_lookahead" is LookaheadCost(arc's source state, lm_state); the
+  // difference between it and the lookahead cost of the destination is added
+  // to the arc's weight.
+  inline StateId PropagateLm(StateId lm_state, BaseFloat cur_lookahead,
+                             Arc *arc) { // returns new LM state.
+    if (lookahead_ != NULL) {
+      StateId next_lm_state = PropagateLm(lm_state, arc);
+      if (arc->weight != Weight::Zero())
+        arc->weight = Times(arc->weight,
+                            Weight(LookaheadCost(arc->nextstate, next_lm_state)
+                                   - cur_lookahead));
+      return next_lm_state;
+    }
+    return PropagateLm(lm_state, arc);
+  }
+
   inline StateId PropagateLm(StateId lm_state,
                              Arc *arc) { // returns new LM state.
     if (arc->olabel == 0) {
@@ -703,12 +739,13 @@ class LatticeBiglmFasterDecoder {
       StateId state = PairToState(state_pair), // state in "fst"
           lm_state = PairToLmState(state_pair);
       Token *tok = best_elem->val;
+      BaseFloat cur_lookahead = LookaheadCost(state, lm_state);
       for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
            !aiter.Done();
            aiter.Next()) {
         Arc arc = aiter.Value();
         if (arc.ilabel != 0) {  // propagate..
-          PropagateLm(lm_state, &arc); // may affect "arc.weight".
+          PropagateLm(lm_state, cur_lookahead, &arc); // may affect "arc.weight".
           // We don't need the return value (the new LM state).
           arc.weight = Times(arc.weight,
                              Weight(-decodable->LogLikelihood(frame-1, arc.ilabel)));
@@ -729,13 +766,14 @@ class LatticeBiglmFasterDecoder {
           lm_state = PairToLmState(state_pair);
       Token *tok = e->val;
       if (tok->tot_cost <=  cur_cutoff) {
+        BaseFloat cur_lookahead = LookaheadCost(state, lm_state);
         for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
              !aiter.Done();
              aiter.Next()) {
           const Arc &arc_ref = aiter.Value();
           if (arc_ref.ilabel != 0) {  // propagate..
             Arc arc(arc_ref);
-            StateId next_lm_state = PropagateLm(lm_state, &arc);
+            StateId next_lm_state = PropagateLm(lm_state, cur_lookahead, &arc);
             BaseFloat ac_cost = -decodable->LogLikelihood(frame-1, arc.ilabel),
                 graph_cost = arc.weight.Value(),
                 cur_cost = tok->tot_cost,
@@ -800,13 +838,14 @@ class LatticeBiglmFasterDecoder {
       // but since most states are emitting it's not a huge issue.
       tok->DeleteForwardLinks(); // necessary when re-visiting
       tok->links = NULL;
+      BaseFloat cur_lookahead = LookaheadCost(state, lm_state);
       for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
           !aiter.Done();
           aiter.Next()) {
         const Arc &arc_ref = aiter.Value();
         if (arc_ref.ilabel == 0) {  // propagate nonemitting only...
           Arc arc(arc_ref);
-          StateId next_lm_state = PropagateLm(lm_state, &arc);          
+          StateId next_lm_state = PropagateLm(lm_state, cur_lookahead, &arc);
           BaseFloat graph_cost = arc.weight.Value(),
               tot_cost = cur_cost + graph_cost;
           if (tot_cost < cutoff) {
@@ -840,6 +879,8 @@ class LatticeBiglmFasterDecoder {
   // make it class member to avoid internal new/delete.
   const fst::Fst<fst::StdArc> &fst_;
   fst::DeterministicOnDemandFst<fst::StdArc> *lm_diff_fst_;  
+  LmLookahead *lookahead_;  // not owned; may be NULL.
+  BaseFloat start_lookahead_cost_;  // lookahead cost of the start state.
   LatticeBiglmFasterDecoderConfig config_;
   bool warned_noarc_;  
   int32 num_toks_; // current total #toks allocated...
@@ -0,0 +1,160 @@
+// decoder/lattice-faster-decoder-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/timer.h"
+#include "decoder/decodable-matrix.h"
+#include "decoder/lattice-faster-decoder.h"
+#include "fstext/fstext-utils.h"
+
+namespace kaldi {
+
+// A random graph with 'num_pdfs' input labels, shaped a bit like HCLG: mostly
+// emitting arcs, and some epsilon arcs, which only go to higher-numbered
+// states so there are no epsilon cycles.
+static fst::VectorFst<fst::StdArc> *RandomGraph(int32 num_states,
+                                                int32 num_pdfs) {
+  typedef fst::StdArc Arc;
+  fst::VectorFst<Arc> *fst = new fst::VectorFst<Arc>();
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    int32 num_arcs = RandInt(2, 10);
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 olabel = (Rand() % 5 == 0 ? RandInt(1, 1000) : 0);
+      fst->AddArc(s, Arc(RandInt(1, num_pdfs), olabel, 5.0 * RandUniform(),
+                         RandInt(0, num_states - 1)));
+    }
+    if (s + 1 < num_states && Rand() % 4 == 0)
+      fst->AddArc(s, Arc(0, RandInt(1, 1000), 2.0 * RandUniform(),
+                         RandInt(s + 1, num_states - 1)));
+    if (Rand() % 10 == 0)
+      fst->SetFinal(s, RandUniform());
+  }
+  return fst;
+}
+
+template <typename Decoder>
+void DecodeAll(const fst::StdFst &fst, const LatticeFasterDecoderConfig &config,
+               const std::vector<Matrix<BaseFloat> > &loglikes,
+               std::vector<Lattice> *best_paths, double *elapsed) {
+  Decoder decoder(fst, config);
+  Timer timer;
+  best_paths->resize(loglikes.size());
+  for (size_t i = 0; i < loglikes.size(); i++) {
+    DecodableMatrixScaled decodable(loglikes[i], 1.0);
+    KALDI_ASSERT(decoder.Decode(&decodable));
+    decoder.GetBestPath(&(*best_paths)[i]);
+  }
+  *elapsed = timer.Elapsed();
+}
+
+// Decodes the same utterances with the default and the pooled decoder: the
+// best paths have to be the same (the pruning may differ a little, since the
+// tokens are visited in a different order).
+void UnitTestPooledLatticeFasterDecoder() {
+  int32 num_pdfs = 200, num_utts = 5;
+  fst::VectorFst<fst::StdArc> *fst = RandomGraph(20000, num_pdfs);
+  std::vector<Matrix<BaseFloat> > loglikes(num_utts);
+  for (int32 i = 0; i < num_utts; i++) {
+    loglikes[i].Resize(RandInt(50, 200), num_pdfs);
+    loglikes[i].SetRandn();
+    loglikes[i].Scale(3.0);
+  }
+
+  LatticeFasterDecoderConfig config;
+  config.beam = 12.0;
+  config.max_active = 5000;
+  config.lattice_beam = 6.0;
+
+  std::vector<Lattice> std_paths, pooled_paths;
+  double std_time, pooled_time;
+  DecodeAll<LatticeFasterDecoder>(*fst, config, loglikes, &std_paths,
+                                  &std_time);
+  DecodeAll<PooledLatticeFasterDecoder>(*fst, config, loglikes, &pooled_paths,
+                                        &pooled_time);
+  KALDI_LOG << "Decoding took " << std_time << " seconds with the default "
+            << "decoder and " << pooled_time << " with the pooled one.";
+
+  for (int32 i = 0; i < num_utts; i++) {
+    std::vector<int32> std_ali, std_words, pooled_ali, pooled_words;
+    LatticeWeight std_weight, pooled_weight;
+    fst::GetLinearSymbolSequence(std_paths[i], &std_ali, &std_words,
+                                 &std_weight);
+    fst::GetLinearSymbolSequence(pooled_paths[i], &pooled_ali, &pooled_words,
+                                 &pooled_weight);
+    KALDI_ASSERT(std_ali == pooled_ali && std_words == pooled_words);
+    KALDI_ASSERT(ApproxEqual(std_weight.Value1() + std_weight.Value2(),
+                             pooled_weight.Value1() + pooled_weight.Value2()));
+  }
+  delete fst;
+}
+
+// Online decoding goes through AdvanceDecoding(), which casts the decoder to
+// the type of the actual FST (ConstFst or VectorFst); the pooled decoder has
+// to give the same best path in a few chunks as with Decode().
+void UnitTestPooledLatticeFasterDecoderOnline() {
+  int32 num_pdfs = 100;
+  fst::VectorFst<fst::StdArc> *vector_fst = RandomGraph(5000, num_pdfs);
+  fst::ConstFst<fst::StdArc> const_fst(*vector_fst);
+  Matrix<BaseFloat> loglikes(RandInt(50, 150), num_pdfs);
+  loglikes.SetRandn();
+  loglikes.Scale(3.0);
+
+  LatticeFasterDecoderConfig config;
+  config.beam = 12.0;
+  config.max_active = 2000;
+  config.lattice_beam = 6.0;
+
+  const fst::StdFst *fsts[] = { vector_fst, &const_fst };
+  for (int32 f = 0; f < 2; f++) {
+    Lattice ref_path, path;
+    {
+      PooledLatticeFasterDecoder decoder(*fsts[f], config);
+      DecodableMatrixScaled decodable(loglikes, 1.0);
+      KALDI_ASSERT(decoder.Decode(&decodable));
+      decoder.GetBestPath(&ref_path);
+    }
+    PooledLatticeFasterDecoder decoder(*fsts[f], config);
+    DecodableMatrixScaled decodable(loglikes, 1.0);
+    decoder.InitDecoding();
+    while (decoder.NumFramesDecoded() < loglikes.NumRows())
+      decoder.AdvanceDecoding(&decodable, RandInt(1, 20));
+    decoder.FinalizeDecoding();
+    KALDI_ASSERT(decoder.GetBestPath(&path));
+
+    std::vector<int32> ref_ali, ref_words, ali, words;
+    LatticeWeight ref_weight, weight;
+    fst::GetLinearSymbolSequence(ref_path, &ref_ali, &ref_words, &ref_weight);
+    fst::GetLinearSymbolSequence(path, &ali, &words, &weight);
+    KALDI_ASSERT(ref_ali == ali && ref_words == words);
+    KALDI_ASSERT(ApproxEqual(ref_weight.Value1() + ref_weight.Value2(),
+                             weight.Value1() + weight.Value2()));
+  }
+  delete vector_fst;
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 3; i++) {
+    kaldi::UnitTestPooledLatticeFasterDecoder();
+    kaldi::UnitTestPooledLatticeFasterDecoderOnline();
+  }
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -26,8 +26,8 @@
 namespace kaldi {
 
 // instantiate this class once for each thing you have to decode.
-template <typename FST, typename Token>
-LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
+template <typename FST, typename Token, typename Policy>
+LatticeFasterDecoderTpl<FST, Token, Policy>::LatticeFasterDecoderTpl(
     const FST &fst,
     const LatticeFasterDecoderConfig &config):
     fst_(&fst), delete_fst_(false), config_(config), num_toks_(0) {
@@ -36,8 +36,8 @@ LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
 }
 
 
-template <typename FST, typename Token>
-LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
+template <typename FST, typename Token, typename Policy>
+LatticeFasterDecoderTpl<FST, Token, Policy>::LatticeFasterDecoderTpl(
     const LatticeFasterDecoderConfig &config, FST *fst):
     fst_(fst), delete_fst_(true), config_(config), num_toks_(0) {
   config.Check();
@@ -45,15 +45,15 @@ LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
 }
 
 
-template <typename FST, typename Token>
-LatticeFasterDecoderTpl<FST, Token>::~LatticeFasterDecoderTpl() {
+template <typename FST, typename Token, typename Policy>
+LatticeFasterDecoderTpl<FST, Token, Policy>::~LatticeFasterDecoderTpl() {
   DeleteElems(toks_.Clear());
   ClearActiveTokens();
   if (delete_fst_) delete fst_;
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::InitDecoding() {
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::InitDecoding() {
   // clean up from last time:
   DeleteElems(toks_.Clear());
   cost_offsets_.clear();
@@ -65,15 +65,16 @@ void LatticeFasterDecoderTpl<FST, Token>::InitDecoding() {
   StateId start_state = fst_->Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL, NULL);
+  Token *start_tok = new (token_allocator_.Allocate())
+      Token(0.0, 0.0, NULL, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
   ProcessNonemitting(config_.beam);
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::InitDecodingCtc() {
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::InitDecodingCtc() {
   // clean up from last time:
   DeleteElems(toks_.Clear());
   cost_offsets_.clear();
@@ -85,7 +86,8 @@ void LatticeFasterDecoderTpl<FST, Token>::InitDecodingCtc() {
   StateId start_state = fst_->Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL, NULL);
+  Token *start_tok = new (token_allocator_.Allocate())
+      Token(0.0, 0.0, NULL, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
@@ -95,8 +97,8 @@ void LatticeFasterDecoderTpl<FST, Token>::InitDecodingCtc() {
 // Returns true if any kind of traceback is available (not necessarily from
 // a final state).  It should only very rarely return false; this indicates
 // an unusual search error.
-template <typename FST, typename Token>
-bool LatticeFasterDecoderTpl<FST, Token>::Decode(DecodableInterface *decodable) {
+template <typename FST, typename Token, typename Policy>
+bool LatticeFasterDecoderTpl<FST, Token, Policy>::Decode(DecodableInterface *decodable) {
   InitDecoding();
 
   // We use 1-based indexing for frames in this decoder (if you view it in
@@ -116,8 +118,8 @@ bool LatticeFasterDecoderTpl<FST, Token>::Decode(DecodableInterface *decodable)
   return !active_toks_.empty() && active_toks_.back().toks != NULL;
 }
 
-template <typename FST, typename Token>
-bool LatticeFasterDecoderTpl<FST, Token>::DecodeCtc(DecodableInterface *decodable) {
+template <typename FST, typename Token, typename Policy>
+bool LatticeFasterDecoderTpl<FST, Token, Policy>::DecodeCtc(DecodableInterface *decodable) {
   InitDecodingCtc();
 
   // We use 1-based indexing for frames in this decoder (if you view it in
@@ -138,8 +140,8 @@ bool LatticeFasterDecoderTpl<FST, Token>::DecodeCtc(DecodableInterface *decodabl
 }
 
 // Outputs an FST corresponding to the single best path through the lattice.
-template <typename FST, typename Token>
-bool LatticeFasterDecoderTpl<FST, Token>::GetBestPath(Lattice *olat,
+template <typename FST, typename Token, typename Policy>
+bool LatticeFasterDecoderTpl<FST, Token, Policy>::GetBestPath(Lattice *olat,
                                        bool use_final_probs) const {
   Lattice raw_lat;
   GetRawLattice(&raw_lat, use_final_probs);
@@ -149,8 +151,8 @@ bool LatticeFasterDecoderTpl<FST, Token>::GetBestPath(Lattice *olat,
 
 
 // Outputs an FST corresponding to the raw, state-level lattice
-template <typename FST, typename Token>
-bool LatticeFasterDecoderTpl<FST, Token>::GetRawLattice(
+template <typename FST, typename Token, typename Policy>
+bool LatticeFasterDecoderTpl<FST, Token, Policy>::GetRawLattice(
     Lattice *ofst,
     bool use_final_probs) const {
   typedef LatticeArc Arc;
@@ -239,8 +241,8 @@ bool LatticeFasterDecoderTpl<FST, Token>::GetRawLattice(
 // This function is now deprecated, since now we do determinization from outside
 // the LatticeFasterDecoder class.  Outputs an FST corresponding to the
 // lattice-determinized lattice (one path per word sequence).
-template <typename FST, typename Token>
-bool LatticeFasterDecoderTpl<FST, Token>::GetLattice(CompactLattice *ofst,
+template <typename FST, typename Token, typename Policy>
+bool LatticeFasterDecoderTpl<FST, Token, Policy>::GetLattice(CompactLattice *ofst,
                                            bool use_final_probs) const {
   Lattice raw_fst;
   GetRawLattice(&raw_fst, use_final_probs);
@@ -262,8 +264,8 @@ bool LatticeFasterDecoderTpl<FST, Token>::GetLattice(CompactLattice *ofst,
   return (ofst->NumStates() != 0);
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::PossiblyResizeHash(size_t num_toks) {
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::PossiblyResizeHash(size_t num_toks) {
   size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
                                       * config_.hash_ratio);
   if (new_sz > toks_.Size()) {
@@ -302,8 +304,8 @@ void LatticeFasterDecoderTpl<FST, Token>::PossiblyResizeHash(size_t num_toks) {
 // for the current frame.  [note: it's inserted if necessary into hash toks_
 // and also into the singly linked list of tokens active on this frame
 // (whose head is at active_toks_[frame]).
-template <typename FST, typename Token>
-inline Token* LatticeFasterDecoderTpl<FST, Token>::FindOrAddToken(
+template <typename FST, typename Token, typename Policy>
+inline Token* LatticeFasterDecoderTpl<FST, Token, Policy>::FindOrAddToken(
       StateId state, int32 frame_plus_one, BaseFloat tot_cost,
       Token *backpointer, bool *changed) {
   // Returns the Token pointer.  Sets "changed" (if non-NULL) to true
@@ -316,7 +318,8 @@ inline Token* LatticeFasterDecoderTpl<FST, Token>::FindOrAddToken(
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks, backpointer);
+    Token *new_tok = new (token_allocator_.Allocate())
+        Token(tot_cost, extra_cost, NULL, toks, backpointer);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -348,8 +351,8 @@ inline Token* LatticeFasterDecoderTpl<FST, Token>::FindOrAddToken(
 // prunes outgoing links for all tokens in active_toks_[frame]
 // it's called by PruneActiveTokens
 // all links, that have link_extra_cost > lattice_beam are pruned
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinks(
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::PruneForwardLinks(
     int32 frame_plus_one, bool *extra_costs_changed,
     bool *links_pruned, BaseFloat delta) {
   // delta is the amount by which the extra_costs must change
@@ -393,7 +396,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinks(
           ForwardLinkT *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_allocator_.Delete(link);
           link = next_link;  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {   // keep the link and update the tok_extra_cost if needed.
@@ -425,8 +428,8 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinks(
 // PruneForwardLinksFinal is a version of PruneForwardLinks that we call
 // on the final frame.  If there are final tokens active, it uses
 // the final-probs for pruning, otherwise it treats all tokens as final.
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinksFinal() {
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::PruneForwardLinksFinal() {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame_plus_one = active_toks_.size() - 1;
 
@@ -481,7 +484,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinksFinal() {
           ForwardLinkT *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_allocator_.Delete(link);
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -510,8 +513,8 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinksFinal() {
   } // while changed
 }
 
-template <typename FST, typename Token>
-BaseFloat LatticeFasterDecoderTpl<FST, Token>::FinalRelativeCost() const {
+template <typename FST, typename Token, typename Policy>
+BaseFloat LatticeFasterDecoderTpl<FST, Token, Policy>::FinalRelativeCost() const {
   if (!decoding_finalized_) {
     BaseFloat relative_cost;
     ComputeFinalCosts(NULL, &relative_cost, NULL);
@@ -528,8 +531,8 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::FinalRelativeCost() const {
 // [we don't do this in PruneForwardLinks because it would give us
 // a problem with dangling pointers].
 // It's called by PruneActiveTokens if any forward links have been pruned
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::PruneTokensForFrame(int32 frame_plus_one) {
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::PruneTokensForFrame(int32 frame_plus_one) {
   KALDI_ASSERT(frame_plus_one >= 0 && frame_plus_one < active_toks_.size());
   Token *&toks = active_toks_[frame_plus_one].toks;
   if (toks == NULL)
@@ -542,7 +545,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneTokensForFrame(int32 frame_plus_o
       // excise tok from list and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      token_allocator_.Delete(tok);
       num_toks_--;
     } else {  // fetch next Token
       prev_tok = tok;
@@ -555,8 +558,8 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneTokensForFrame(int32 frame_plus_o
 // that.  We go backwards through the frames and stop when we reach a point
 // where the delta-costs are not changing (and the delta controls when we consider
 // a cost to have "not changed").
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::PruneActiveTokens(BaseFloat delta) {
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::PruneActiveTokens(BaseFloat delta) {
   int32 cur_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // The index "f" below represents a "frame plus one", i.e. you'd have to subtract
@@ -585,8 +588,8 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneActiveTokens(BaseFloat delta) {
                 << " to " << num_toks_;
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::ComputeFinalCosts(
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::ComputeFinalCosts(
     unordered_map<Token*, BaseFloat> *final_costs,
     BaseFloat *final_relative_cost,
     BaseFloat *final_best_cost) const {
@@ -629,21 +632,21 @@ void LatticeFasterDecoderTpl<FST, Token>::ComputeFinalCosts(
   }
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::AdvanceDecoding(DecodableInterface *decodable,
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::AdvanceDecoding(DecodableInterface *decodable,
                                                 int32 max_num_frames) {
   if (std::is_same<FST, fst::Fst<fst::StdArc> >::value) {
     // if the type 'FST' is the FST base-class, then see if the FST type of fst_
     // is actually VectorFst or ConstFst.  If so, call the AdvanceDecoding()
     // function after casting *this to the more specific type.
     if (fst_->Type() == "const") {
-      LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token> *this_cast =
-          reinterpret_cast<LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token>* >(this);
+      LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token, Policy> *this_cast =
+          reinterpret_cast<LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token, Policy>* >(this);
       this_cast->AdvanceDecoding(decodable, max_num_frames);
       return;
     } else if (fst_->Type() == "vector") {
-      LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, Token> *this_cast =
-          reinterpret_cast<LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, Token>* >(this);
+      LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, Token, Policy> *this_cast =
+          reinterpret_cast<LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, Token, Policy>* >(this);
       this_cast->AdvanceDecoding(decodable, max_num_frames);
       return;
     }
@@ -671,21 +674,21 @@ void LatticeFasterDecoderTpl<FST, Token>::AdvanceDecoding(DecodableInterface *de
   }
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::AdvanceDecodingCtc(DecodableInterface *decodable,
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::AdvanceDecodingCtc(DecodableInterface *decodable,
                                              int32 max_num_frames) {
   if (std::is_same<FST, fst::Fst<fst::StdArc> >::value) {
     // if the type 'FST' is the FST base-class, then see if the FST type of fst_
     // is actually VectorFst or ConstFst.  If so, call the AdvanceDecoding()
     // function after casting *this to the more specific type.
     if (fst_->Type() == "const") {
-      LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token> *this_cast =
-          reinterpret_cast<LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token>* >(this);
+      LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token, Policy> *this_cast =
+          reinterpret_cast<LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token, Policy>* >(this);
       this_cast->AdvanceDecoding(decodable, max_num_frames);
       return;
     } else if (fst_->Type() == "vector") {
-      LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, Token> *this_cast =
-          reinterpret_cast<LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, Token>* >(this);
+      LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, Token, Policy> *this_cast =
+          reinterpret_cast<LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, Token, Policy>* >(this);
       this_cast->AdvanceDecoding(decodable, max_num_frames);
       return;
     }
@@ -717,8 +720,8 @@ void LatticeFasterDecoderTpl<FST, Token>::AdvanceDecodingCtc(DecodableInterface
 // FinalizeDecoding() is a version of PruneActiveTokens that we call
 // (optionally) on the final frame.  Takes into account the final-prob of
 // tokens.  This function used to be called PruneActiveTokensFinal().
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::FinalizeDecoding() {
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::FinalizeDecoding() {
   int32 final_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // PruneForwardLinksFinal() prunes final frame (with final-probs), and
@@ -736,8 +739,8 @@ void LatticeFasterDecoderTpl<FST, Token>::FinalizeDecoding() {
 }
 
 /// Gets the weight cutoff.  Also counts the active tokens.
-template <typename FST, typename Token>
-BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t *tok_count,
+template <typename FST, typename Token, typename Policy>
+BaseFloat LatticeFasterDecoderTpl<FST, Token, Policy>::GetCutoff(Elem *list_head, size_t *tok_count,
                                           BaseFloat *adaptive_beam, Elem **best_elem) {
   BaseFloat best_weight = std::numeric_limits<BaseFloat>::infinity();
   // positive == high cost == bad.
@@ -807,8 +810,8 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t
 }
 
 /// Gets the weight cutoff.  Also counts the active tokens.
-template <typename FST, typename Token>
-BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoffCtc(Elem *list_head, size_t *tok_count,
+template <typename FST, typename Token, typename Policy>
+BaseFloat LatticeFasterDecoderTpl<FST, Token, Policy>::GetCutoffCtc(Elem *list_head, size_t *tok_count,
                                           BaseFloat *adaptive_beam, Elem **best_elem) {
   BaseFloat best_weight = std::numeric_limits<BaseFloat>::infinity();
   // positive == high cost == bad.
@@ -874,8 +877,8 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoffCtc(Elem *list_head, siz
   }
 }
 
-template <typename FST, typename Token>
-BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
+template <typename FST, typename Token, typename Policy>
+BaseFloat LatticeFasterDecoderTpl<FST, Token, Policy>::ProcessEmitting(
     DecodableInterface *decodable) {
   KALDI_ASSERT(active_toks_.size() > 0);
   int32 frame = active_toks_.size() - 1; // frame is the frame-index
@@ -956,8 +959,9 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
           // NULL: no change indicator needed
 
           // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLinkT(next_tok, arc.ilabel, arc.olabel,
-                                        graph_cost, ac_cost, tok->links);
+          tok->links = new (link_allocator_.Allocate())
+              ForwardLinkT(next_tok, arc.ilabel, arc.olabel, graph_cost,
+                           ac_cost, tok->links);
         }
       } // for all arcs
     }
@@ -967,20 +971,20 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
   return next_cutoff;
 }
 
-// static inline
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::DeleteForwardLinks(Token *tok) {
+// inline
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::DeleteForwardLinks(Token *tok) {
   ForwardLinkT *l = tok->links, *m;
   while (l != NULL) {
     m = l->next;
-    delete l;
+    link_allocator_.Delete(l);
     l = m;
   }
   tok->links = NULL;
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::ProcessEmittingCtc(
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::ProcessEmittingCtc(
     DecodableInterface *decodable) {
   KALDI_ASSERT(active_toks_.size() > 0);
   int32 frame = active_toks_.size() - 1; // frame is the frame-index
@@ -1058,8 +1062,9 @@ void LatticeFasterDecoderTpl<FST, Token>::ProcessEmittingCtc(
           // NULL: no change indicator needed
 
           // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLinkT(next_tok, arc.ilabel, arc.olabel,
-                                       graph_cost, ac_cost, tok->links);
+          tok->links = new (link_allocator_.Allocate())
+              ForwardLinkT(next_tok, arc.ilabel, arc.olabel, graph_cost,
+                           ac_cost, tok->links);
         }
       } // for all arcs
     }
@@ -1069,8 +1074,8 @@ void LatticeFasterDecoderTpl<FST, Token>::ProcessEmittingCtc(
 }
 
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemitting(BaseFloat cutoff) {
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::ProcessNonemitting(BaseFloat cutoff) {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame = static_cast<int32>(active_toks_.size()) - 2;
   // Note: "frame" is the time-index we just processed, or -1 if
@@ -1125,8 +1130,8 @@ void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemitting(BaseFloat cutoff) {
           Token *new_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
                                           tok, &changed);
 
-          tok->links = new ForwardLinkT(new_tok, 0, arc.olabel,
-                                        graph_cost, 0, tok->links);
+          tok->links = new (link_allocator_.Allocate())
+              ForwardLinkT(new_tok, 0, arc.olabel, graph_cost, 0, tok->links);
 
           // "changed" tells us whether the new token has a different
           // cost from before, or is new [if so, add into queue].
@@ -1139,8 +1144,8 @@ void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemitting(BaseFloat cutoff) {
 }
 
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemittingCtc() {
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::ProcessNonemittingCtc() {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame = static_cast<int32>(active_toks_.size()) - 2;
   // Note: "frame" is the time-index we just processed, or -1 if
@@ -1195,8 +1200,8 @@ void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemittingCtc() {
           Token *new_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
                                           tok, &changed);
 
-          tok->links = new ForwardLinkT(new_tok, 0, arc.olabel,
-                                       graph_cost, 0, tok->links);
+          tok->links = new (link_allocator_.Allocate())
+              ForwardLinkT(new_tok, 0, arc.olabel, graph_cost, 0, tok->links);
 
           // "changed" tells us whether the new token has a different
           // cost from before, or is new [if so, add into queue].
@@ -1208,34 +1213,41 @@ void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemittingCtc() {
   } // while queue not empty
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::DeleteElems(Elem *list) {
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::DeleteElems(Elem *list) {
   for (Elem *e = list, *e_tail; e != NULL; e = e_tail) {
     e_tail = e->tail;
     toks_.Delete(e);
   }
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::ClearActiveTokens() { // a cleanup routine, at utt end/begin
-  for (size_t i = 0; i < active_toks_.size(); i++) {
-    // Delete all tokens alive on this frame, and any forward
-    // links they may have.
-    for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-      DeleteForwardLinks(tok);
-      Token *next_tok = tok->next;
-      delete tok;
-      num_toks_--;
-      tok = next_tok;
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::ClearActiveTokens() { // a cleanup routine, at utt end/begin
+  if (TokenAllocator::kFreesInBulk && LinkAllocator::kFreesInBulk) {
+    // no need to visit the tokens and links, FreeAll() frees them.
+    num_toks_ = 0;
+  } else {
+    for (size_t i = 0; i < active_toks_.size(); i++) {
+      // Delete all tokens alive on this frame, and any forward
+      // links they may have.
+      for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
+        DeleteForwardLinks(tok);
+        Token *next_tok = tok->next;
+        token_allocator_.Delete(tok);
+        num_toks_--;
+        tok = next_tok;
+      }
     }
   }
+  token_allocator_.FreeAll();
+  link_allocator_.FreeAll();
   active_toks_.clear();
   KALDI_ASSERT(num_toks_ == 0);
 }
 
 // static
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::TopSortTokens(
+template <typename FST, typename Token, typename Policy>
+void LatticeFasterDecoderTpl<FST, Token, Policy>::TopSortTokens(
     Token *tok_list, std::vector<Token*> *topsorted_list) {
   unordered_map<Token*, int32> token2pos;
   typedef typename unordered_map<Token*, int32>::iterator IterType;
@@ -1324,5 +1336,14 @@ template class LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, decoder::Bac
 template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, decoder::BackpointerToken >;
 template class LatticeFasterDecoderTpl<fst::GrammarFst, decoder::BackpointerToken>;
 
+template class LatticeFasterDecoderTpl<fst::Fst<fst::StdArc>, decoder::StdToken,
+                                       decoder::PooledDecoderPolicy>;
+template class LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, decoder::StdToken,
+                                       decoder::PooledDecoderPolicy>;
+template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, decoder::StdToken,
+                                       decoder::PooledDecoderPolicy>;
+template class LatticeFasterDecoderTpl<fst::GrammarFst, decoder::StdToken,
+                                       decoder::PooledDecoderPolicy>;
+
 
 } // end namespace kaldi.
@@ -24,8 +24,13 @@
 #define KALDI_DECODER_LATTICE_FASTER_DECODER_H_
 
 
+#include <new>
+#include <type_traits>
+#include <vector>
+
 #include "util/stl-utils.h"
 #include "util/hash-list.h"
+#include "util/open-hash-list.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -205,6 +210,110 @@ struct BackpointerToken {
       backpointer(backpointer) { }
 };
 
+
+// The allocators for Tokens and ForwardLinks.  Allocate() returns memory for
+// one object, which the caller constructs with placement new; Delete()
+// destroys and frees an object.  FreeAll() is called when none of the objects
+// are needed any more (at the start and end of each utterance); if
+// kFreesInBulk is true, it frees all the objects that were not deleted,
+// without destroying them, so the decoder does not have to visit them.
+
+// Uses operator new and delete.
+template <typename T>
+class HeapAllocator {
+ public:
+  static const bool kFreesInBulk = false;
+
+  inline void *Allocate() { return ::operator new(sizeof(T)); }
+  inline void Delete(T *t) {
+    t->~T();
+    ::operator delete(t);
+  }
+  void FreeAll() { }
+};
+
+// Allocates from blocks of kBlockSize objects that are kept for the life of
+// the allocator.  Deleted objects go on a free list and are reused first;
+// FreeAll() takes constant time and makes the next objects come from the
+// start of the first block again, so at the start of each utterance the
+// tokens of a frame tend to be adjacent in memory.  Only for types with
+// trivial destructors.
+template <typename T>
+class PoolAllocator {
+ public:
+  static const bool kFreesInBulk = true;
+
+  PoolAllocator(): free_head_(NULL), cur_block_(0), cur_offset_(0) { }
+
+  ~PoolAllocator() {
+    for (size_t i = 0; i < blocks_.size(); i++)
+      delete [] blocks_[i];
+  }
+
+  inline void *Allocate() {
+    Slot *slot = free_head_;
+    if (slot != NULL) {
+      free_head_ = slot->next;
+    } else {
+      if (cur_offset_ == kBlockSize) {
+        cur_block_++;
+        cur_offset_ = 0;
+      }
+      if (cur_block_ == blocks_.size())
+        blocks_.push_back(new Slot[kBlockSize]);
+      slot = blocks_[cur_block_] + cur_offset_++;
+    }
+    return slot;
+  }
+
+  inline void Delete(T *t) {
+    Slot *slot = reinterpret_cast<Slot*>(t);
+    slot->next = free_head_;
+    free_head_ = slot;
+  }
+
+  void FreeAll() {
+    free_head_ = NULL;
+    cur_block_ = 0;
+    cur_offset_ = 0;
+  }
+
+ private:
+  static_assert(std::is_trivially_destructible<T>::value,
+                "PoolAllocator does not call destructors");
+  static const size_t kBlockSize = 1024;
+
+  union Slot {
+    Slot *next;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  Slot *free_head_;  // deleted objects.
+  std::vector<Slot*> blocks_;
+  size_t cur_block_;   // the block that new objects are taken from ...
+  size_t cur_offset_;  // ... and the first unused slot in it.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(PoolAllocator);
+};
+
+// The Policy template argument of LatticeFasterDecoderTpl says how the decoder
+// allocates Tokens and ForwardLinks (Allocator) and what maps the active states
+// of the current frame to their Tokens (StateMap, which must have the
+// interface of HashList).
+
+// The original behaviour: new/delete and HashList.
+struct StdDecoderPolicy {
+  template <typename T> using Allocator = HeapAllocator<T>;
+  template <typename I, typename T> using StateMap = HashList<I, T>;
+};
+
+// Pooled Tokens and ForwardLinks, and an open-addressing state map; faster
+// with wide beams, where allocation and the hash lookups dominate.
+struct PooledDecoderPolicy {
+  template <typename T> using Allocator = PoolAllocator<T>;
+  template <typename I, typename T> using StateMap = OpenHashList<I, T>;
+};
+
 }  // namespace decoder
 
 
@@ -214,7 +323,9 @@ struct BackpointerToken {
 
    The decoder is templated on the FST type and the token type.  The token type
    will normally be StdToken, but also may be BackpointerToken which is to support
-   quick lookup of the current best path (see lattice-faster-online-decoder.h)
+   quick lookup of the current best path (see lattice-faster-online-decoder.h).
+   The Policy type selects the allocation of tokens and the state->token map;
+   see decoder::StdDecoderPolicy and decoder::PooledDecoderPolicy.
 
    The FST you invoke this decoder with is expected to equal
    Fst::Fst<fst::StdArc>, a.k.a. StdFst, or GrammarFst.  If you invoke it with
@@ -223,7 +334,8 @@ struct BackpointerToken {
    will internally cast itself to one that is templated on those more specific
    types; this is an optimization for speed.
  */
-template <typename FST, typename Token = decoder::StdToken>
+template <typename FST, typename Token = decoder::StdToken,
+          typename Policy = decoder::StdDecoderPolicy>
 class LatticeFasterDecoderTpl {
  public:
   using Arc = typename FST::Arc;
@@ -354,7 +466,7 @@ class LatticeFasterDecoderTpl {
   // internals.
 
   // Deletes the elements of the singly linked list tok->links.
-  inline static void DeleteForwardLinks(Token *tok);
+  inline void DeleteForwardLinks(Token *tok);
 
   // head of per-frame list of Tokens (list is in topological order),
   // and something saying whether we ever pruned it using PruneForwardLinks.
@@ -366,7 +478,8 @@ class LatticeFasterDecoderTpl {
                  must_prune_tokens(true) { }
   };
 
-  using Elem = typename HashList<StateId, Token*>::Elem;
+  using StateMap = typename Policy::template StateMap<StateId, Token*>;
+  using Elem = typename StateMap::Elem;
   // Equivalent to:
   //  struct Elem {
   //    StateId key;
@@ -466,14 +579,21 @@ class LatticeFasterDecoderTpl {
 
 
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
+  // HashList defined in ../util/hash-list.h (or OpenHashList, depending on
+  // Policy).  It actually allows us to maintain
   // more than one list (e.g. for current and previous frames), but only one of
   // them at a time can be indexed by StateId.  It is indexed by frame-index
   // plus one, where the frame-index is zero-based, as used in decodable object.
   // That is, the emitting probs of frame t are accounted for in tokens at
   // toks_[t+1].  The zeroth frame is for nonemitting transition at the start of
   // the graph.
-  HashList<StateId, Token*> toks_;
+  StateMap toks_;
+
+  // Tokens and ForwardLinks are created and deleted through these.
+  using TokenAllocator = typename Policy::template Allocator<Token>;
+  using LinkAllocator = typename Policy::template Allocator<ForwardLinkT>;
+  TokenAllocator token_allocator_;
+  LinkAllocator link_allocator_;
 
   std::vector<TokenList> active_toks_; // Lists of tokens, indexed by
   // frame (members of TokenList are toks, must_prune_forward_links,
@@ -537,6 +657,9 @@ class LatticeFasterDecoderTpl {
 };
 
 typedef LatticeFasterDecoderTpl<fst::StdFst, decoder::StdToken> LatticeFasterDecoder;
+typedef LatticeFasterDecoderTpl<fst::StdFst, decoder::StdToken,
+                                decoder::PooledDecoderPolicy>
+    PooledLatticeFasterDecoder;
 
 
 
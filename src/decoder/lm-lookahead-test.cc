@@ -0,0 +1,167 @@
+// decoder/lm-lookahead-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/decodable-matrix.h"
+#include "decoder/lattice-biglm-faster-decoder.h"
+#include "decoder/lm-lookahead.h"
+#include "fstext/fstext-utils.h"
+
+namespace kaldi {
+
+typedef fst::StdArc Arc;
+
+// A bigram LM over words 1..num_words with no backoff: state 0 is the start,
+// and state w is the history w.
+static fst::VectorFst<Arc> *RandomBigram(int32 num_words) {
+  fst::VectorFst<Arc> *lm = new fst::VectorFst<Arc>();
+  for (int32 s = 0; s <= num_words; s++)
+    lm->AddState();
+  lm->SetStart(0);
+  for (int32 s = 0; s <= num_words; s++) {
+    for (int32 w = 1; w <= num_words; w++)  // in order: must be sorted.
+      lm->AddArc(s, Arc(w, w, 1.0 + 3.0 * RandUniform(), w));
+    lm->SetFinal(s, 2.0 * RandUniform());
+  }
+  return lm;
+}
+
+// A random graph with words as output labels, as in
+// lattice-faster-decoder-test.cc.
+static fst::VectorFst<Arc> *RandomGraph(int32 num_states, int32 num_pdfs,
+                                        int32 num_words) {
+  fst::VectorFst<Arc> *fst = new fst::VectorFst<Arc>();
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    int32 num_arcs = RandInt(1, 4);
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 olabel = (Rand() % 4 == 0 ? RandInt(1, num_words) : 0);
+      fst->AddArc(s, Arc(RandInt(1, num_pdfs), olabel, RandUniform(),
+                         RandInt(0, num_states - 1)));
+    }
+    if (s + 1 < num_states && Rand() % 4 == 0)
+      fst->AddArc(s, Arc(0, RandInt(0, num_words), RandUniform(),
+                         RandInt(s + 1, num_states - 1)));
+    if (Rand() % 5 == 0)
+      fst->SetFinal(s, RandUniform());
+  }
+  return fst;
+}
+
+void UnitTestReachableWords() {
+  fst::VectorFst<Arc> fst;
+  for (int32 s = 0; s < 5; s++)
+    fst.AddState();
+  fst.SetStart(0);
+  fst.AddArc(0, Arc(1, 0, 0.0, 1));
+  fst.AddArc(1, Arc(2, 7, 0.0, 2));
+  fst.AddArc(1, Arc(3, 5, 0.0, 3));
+  fst.AddArc(1, Arc(3, 0, 0.0, 1));  // self-loop.
+  fst.AddArc(0, Arc(0, 0, 0.0, 3));
+  fst.AddArc(2, Arc(1, 0, 0.0, 4));
+  fst.SetFinal(3, 0.0);
+
+  fst::VectorFst<Arc> *lm_fst = RandomBigram(10);
+  fst::BackoffDeterministicOnDemandFst<Arc> lm(*lm_fst);
+  LmLookaheadConfig config;
+  LmLookahead lookahead(config, fst, &lm);
+
+  std::vector<int32> expected;
+  expected.push_back(5);
+  expected.push_back(7);
+  expected.push_back(fst::kNoLabel);
+  KALDI_ASSERT(*lookahead.ReachableWords(0) == expected);
+  KALDI_ASSERT(lookahead.ReachableWords(2) == NULL);  // nothing reachable.
+  KALDI_ASSERT(lookahead.ReachableWords(4) == NULL);
+  expected.erase(expected.begin(), expected.begin() + 2);
+  KALDI_ASSERT(*lookahead.ReachableWords(3) == expected);  // only final.
+
+  for (int32 h = 0; h <= 10; h++) {
+    Arc arc5, arc7;
+    KALDI_ASSERT(lm.GetArc(h, 5, &arc5) && lm.GetArc(h, 7, &arc7));
+    BaseFloat word_cost = std::min(arc5.weight.Value(), arc7.weight.Value());
+    KALDI_ASSERT(ApproxEqual(lookahead.Cost(0, h),
+                             std::min(word_cost, lm.Final(h).Value())));
+    KALDI_ASSERT(ApproxEqual(lookahead.Cost(1, h), word_cost));
+    KALDI_ASSERT(lookahead.Cost(2, h) == 0.0);
+  }
+
+  config.max_words = 1;
+  LmLookahead small_lookahead(config, fst, &lm);
+  KALDI_ASSERT(small_lookahead.ReachableWords(0) == NULL);
+  KALDI_ASSERT(small_lookahead.ReachableWords(2) == NULL);
+  delete lm_fst;
+}
+
+// The lookahead moves costs around but does not change the total cost of a
+// path, so with wide beams the best path has to be the same as without it.
+void UnitTestLookaheadDecoding() {
+  int32 num_pdfs = 30, num_words = 20;
+  fst::VectorFst<Arc> *fst = RandomGraph(300, num_pdfs, num_words);
+  fst::VectorFst<Arc> *lm_fst = RandomBigram(num_words);
+  fst::BackoffDeterministicOnDemandFst<Arc> lm(*lm_fst);
+
+  LatticeBiglmFasterDecoderConfig config;
+  config.beam = 50.0;
+  config.max_active = 1000000;
+  config.lattice_beam = 5.0;
+  LmLookaheadConfig lookahead_config;
+  lookahead_config.max_words = RandInt(1, num_words);
+  LmLookahead lookahead(lookahead_config, *fst, &lm);
+  LatticeBiglmFasterDecoder decoder(*fst, config, &lm),
+      lookahead_decoder(*fst, config, &lm, &lookahead);
+
+  for (int32 i = 0; i < 5; i++) {
+    Matrix<BaseFloat> loglikes(RandInt(5, 30), num_pdfs);
+    loglikes.SetRandn();
+    DecodableMatrixScaled decodable(loglikes, 1.0),
+        lookahead_decodable(loglikes, 1.0);
+    bool ans = decoder.Decode(&decodable),
+        lookahead_ans = lookahead_decoder.Decode(&lookahead_decodable);
+    KALDI_ASSERT(ans == lookahead_ans);
+    if (!ans || !decoder.ReachedFinal())
+      continue;
+    KALDI_ASSERT(lookahead_decoder.ReachedFinal());
+
+    Lattice path, lookahead_path;
+    decoder.GetBestPath(&path);
+    lookahead_decoder.GetBestPath(&lookahead_path);
+    std::vector<int32> ali, words, lookahead_ali, lookahead_words;
+    LatticeWeight weight, lookahead_weight;
+    fst::GetLinearSymbolSequence(path, &ali, &words, &weight);
+    fst::GetLinearSymbolSequence(lookahead_path, &lookahead_ali,
+                                 &lookahead_words, &lookahead_weight);
+    BaseFloat cost = weight.Value1() + weight.Value2(),
+        lookahead_cost = lookahead_weight.Value1() + lookahead_weight.Value2();
+    KALDI_ASSERT(ApproxEqual(cost, lookahead_cost, 0.001));
+    KALDI_ASSERT(ApproxEqual(weight.Value2(), lookahead_weight.Value2(),
+                             0.001));
+  }
+  delete fst;
+  delete lm_fst;
+}
+
+}  // namespace kaldi
+
+int main() {
+  kaldi::UnitTestReachableWords();
+  for (int32 i = 0; i < 5; i++)
+    kaldi::UnitTestLookaheadDecoding();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,126 @@
+// decoder/lm-lookahead.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+
+#include "decoder/lm-lookahead.h"
+
+namespace kaldi {
+
+LmLookahead::LmLookahead(const LmLookaheadConfig &config,
+                         const fst::Fst<Arc> &fst,
+                         fst::DeterministicOnDemandFst<Arc> *lm):
+    config_(config), fst_(fst), lm_(lm),
+    num_costs_computed_(0), num_lm_queries_(0) {
+  config_.Check();
+  KALDI_ASSERT(fst.Start() != fst::kNoStateId);
+}
+
+int32 LmLookahead::ComputeSetId(StateId state) {
+  if (static_cast<size_t>(state) >= state_to_set_.size())
+    state_to_set_.resize(std::max<size_t>(state + 1,
+                                          2 * state_to_set_.size()),
+                         kNotComputed);
+
+  // Depth-first search along the arcs without output label, collecting the
+  // labels of the arcs that have one.
+  std::vector<Label> words;
+  bool final_reachable = false, too_many = false;
+  queue_.clear();
+  visited_.clear();
+  queue_.push_back(state);
+  visited_.insert(state);
+  while (!queue_.empty() && !too_many) {
+    StateId s = queue_.back();
+    queue_.pop_back();
+    if (fst_.Final(s) != Weight::Zero())
+      final_reachable = true;
+    for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.olabel != 0) {
+        words.push_back(arc.olabel);
+        if (words.size() > static_cast<size_t>(2 * config_.max_words)) {
+          SortAndUniq(&words);
+          if (words.size() > static_cast<size_t>(config_.max_words)) {
+            too_many = true;
+            break;
+          }
+        }
+      } else if (visited_.insert(arc.nextstate).second) {
+        queue_.push_back(arc.nextstate);
+      }
+    }
+  }
+  SortAndUniq(&words);
+  int32 set_id;
+  if (too_many || words.size() > static_cast<size_t>(config_.max_words) ||
+      (words.empty() && !final_reachable)) {
+    set_id = -1;
+  } else {
+    if (final_reachable)
+      words.push_back(fst::kNoLabel);
+    unordered_map<std::vector<Label>, int32,
+                  VectorHasher<Label> >::iterator iter = set_to_id_.find(words);
+    if (iter != set_to_id_.end()) {
+      set_id = iter->second;
+    } else {
+      set_id = sets_.size();
+      set_to_id_[words] = set_id;
+      sets_.push_back(words);
+    }
+  }
+  state_to_set_[state] = set_id;
+  return set_id;
+}
+
+BaseFloat LmLookahead::ComputeCost(const std::pair<int32, StateId> &key) {
+  const std::vector<Label> &words = sets_[key.first];
+  StateId lm_state = key.second;
+  BaseFloat best_cost = std::numeric_limits<BaseFloat>::infinity();
+  for (size_t i = 0; i < words.size(); i++) {
+    BaseFloat cost;
+    if (words[i] == fst::kNoLabel) {
+      cost = lm_->Final(lm_state).Value();
+    } else {
+      Arc lm_arc;
+      if (!lm_->GetArc(lm_state, words[i], &lm_arc))
+        continue;
+      cost = lm_arc.weight.Value();
+    }
+    best_cost = std::min(best_cost, cost);
+  }
+  // If no word can be reached in the LM the path will be pruned anyway.
+  if (best_cost == std::numeric_limits<BaseFloat>::infinity())
+    best_cost = 0.0;
+  num_costs_computed_++;
+  num_lm_queries_ += words.size();
+  if (costs_.size() >= static_cast<size_t>(config_.max_cache_size))
+    costs_.clear();
+  costs_[key] = best_cost;
+  return best_cost;
+}
+
+LmLookahead::~LmLookahead() {
+  KALDI_VLOG(1) << "LM lookahead: " << sets_.size()
+                << " distinct sets of reachable words; computed "
+                << num_costs_computed_ << " lookahead costs with "
+                << num_lm_queries_ << " LM queries.";
+}
+
+}  // namespace kaldi
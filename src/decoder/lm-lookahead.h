@@ -0,0 +1,160 @@
+// decoder/lm-lookahead.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_LM_LOOKAHEAD_H_
+#define KALDI_DECODER_LM_LOOKAHEAD_H_
+
+#include <utility>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "fst/fstlib.h"
+#include "fstext/deterministic-fst.h"
+#include "itf/options-itf.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+struct LmLookaheadConfig {
+  int32 max_words;
+  int32 max_cache_size;
+
+  LmLookaheadConfig(): max_words(500), max_cache_size(5000000) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("lookahead-max-words", &max_words, "LM lookahead is done "
+                   "only in graph states from which at most this many words "
+                   "can be reached; larger values give sharper lookahead near "
+                   "word starts but cost more LM queries.");
+    opts->Register("lookahead-max-cache-size", &max_cache_size, "The cache "
+                   "of lookahead costs is cleared when it has more entries "
+                   "than this.");
+  }
+  void Check() const {
+    KALDI_ASSERT(max_words > 0 && max_cache_size > 0);
+  }
+};
+
+
+/**
+   LmLookahead computes LM lookahead costs for decoding with on-the-fly
+   composition of a graph without the grammar (e.g. HCL, whose output labels
+   are words) and a language model given as a DeterministicOnDemandFst (e.g.
+   ConstArpaLmDeterministicFst).
+
+   For a state s of the graph, the reachable words R(s) are the output labels
+   of the first word-bearing arcs on the paths out of s, i.e. the words that
+   the paths from s can output next; a final state reachable from s without
+   crossing a word counts as the end-of-sentence.  The lookahead cost of the
+   composed state (s, h), for LM state h, is the smallest LM cost of any word
+   in R(s) (or of the end-of-sentence) given h.  The decoder adds the
+   difference of the lookahead costs of the destination and source state to
+   each arc, which pushes the LM costs of the next word towards the start of
+   the word, where they help pruning; the differences telescope, so the total
+   cost of a complete path is unchanged.
+
+   Reachable sets are computed on demand, with a depth-first search that stops
+   when it has found more than --lookahead-max-words words; such states (and
+   states from which nothing is reachable) get a lookahead cost of zero.
+   Identical sets are stored once.  Both the sets and the lookahead costs of
+   (set, LM state) pairs are cached, so this object is meant to be kept for
+   many utterances; it is not thread-safe, and it queries the LM through the
+   same non-const interface as the decoder, so use one per decoder.
+*/
+class LmLookahead {
+ public:
+  typedef fst::StdArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Label Label;
+  typedef Arc::Weight Weight;
+
+  /// 'fst' is the graph that the decoder will use, and 'lm' the LM it will
+  /// compose it with; both have to outlive this object.
+  LmLookahead(const LmLookaheadConfig &config,
+              const fst::Fst<Arc> &fst,
+              fst::DeterministicOnDemandFst<Arc> *lm);
+
+  /// Returns the lookahead cost of graph state 'state' with LM state
+  /// 'lm_state'.
+  inline BaseFloat Cost(StateId state, StateId lm_state) {
+    int32 set_id = GetSetId(state);
+    if (set_id < 0)
+      return 0.0;
+    std::pair<int32, StateId> key(set_id, lm_state);
+    CostMap::const_iterator iter = costs_.find(key);
+    if (iter != costs_.end())
+      return iter->second;
+    return ComputeCost(key);
+  }
+
+  /// Returns the reachable words of 'state' (sorted), or NULL if there are
+  /// too many to do lookahead.  The end-of-sentence is represented by
+  /// kNoLabel at the end of the list.  Mostly for testing.
+  const std::vector<Label> *ReachableWords(StateId state) {
+    int32 set_id = GetSetId(state);
+    return (set_id < 0 ? NULL : &(sets_[set_id]));
+  }
+
+  ~LmLookahead();
+
+ private:
+  // Returns the index in sets_ of the reachable words of 'state', or -1 if
+  // there is no lookahead in this state.
+  inline int32 GetSetId(StateId state) {
+    if (static_cast<size_t>(state) < state_to_set_.size()) {
+      int32 set_id = state_to_set_[state];
+      if (set_id != kNotComputed)
+        return set_id;
+    }
+    return ComputeSetId(state);
+  }
+
+  int32 ComputeSetId(StateId state);
+
+  BaseFloat ComputeCost(const std::pair<int32, StateId> &key);
+
+  enum { kNotComputed = -2 };
+
+  LmLookaheadConfig config_;
+  const fst::Fst<Arc> &fst_;
+  fst::DeterministicOnDemandFst<Arc> *lm_;
+
+  // indexed by graph state; kNotComputed, -1 for no lookahead, or an index
+  // into sets_.
+  std::vector<int32> state_to_set_;
+  // The distinct reachable-word sets, sorted, with kNoLabel appended if a final
+  // state is reachable.
+  std::vector<std::vector<Label> > sets_;
+  unordered_map<std::vector<Label>, int32, VectorHasher<Label> > set_to_id_;
+
+  typedef unordered_map<std::pair<int32, StateId>, BaseFloat,
+                        PairHasher<int32> > CostMap;
+  CostMap costs_;
+
+  // Temporaries for ComputeSetId().
+  std::vector<StateId> queue_;
+  unordered_set<StateId> visited_;
+
+  int64 num_costs_computed_, num_lm_queries_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LmLookahead);
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_LM_LOOKAHEAD_H_
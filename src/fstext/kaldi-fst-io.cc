@@ -42,7 +42,8 @@ VectorFst<StdArc> *ReadFstKaldi(std::string rxfilename) {
   return fst;
 }
 
-Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename, bool throw_on_err) {
+Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename, bool throw_on_err,
+                                 bool memory_map) {
   if (rxfilename == "") rxfilename = "-"; // interpret "" as stdin,
   // for compatibility with OpenFst conventions.
   kaldi::Input ki(rxfilename);
@@ -73,8 +74,19 @@ Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename, bool throw_on_err) {
   FstReadOptions ropts("<unspecified>", &hdr);
   Fst<StdArc> *fst = NULL;
   if (hdr.FstType() == "const") {
+    if (memory_map &&
+        kaldi::ClassifyRxfilename(rxfilename) == kaldi::kFileInput) {
+      // OpenFst maps the arrays from the file at the stream position.
+      ropts.source = rxfilename;
+      ropts.mode = FstReadOptions::MAP;
+    }
     fst = ConstFst<StdArc>::Read(ki.Stream(), ropts);
   } else if (hdr.FstType() == "vector") {
+    if (memory_map) {
+      KALDI_WARN << "Only const FSTs can be memory-mapped, reading "
+                 << kaldi::PrintableRxfilename(rxfilename)
+                 << "; convert it with fstconvert --fst_type=const.";
+    }
     fst = VectorFst<StdArc>::Read(ki.Stream(), ropts);
   }
   if (!fst) {
@@ -47,8 +47,15 @@ VectorFst<StdArc> *ReadFstKaldi(std::string rxfilename);
 // doesn't support the text-mode option that we generally like to support.
 // This version currently supports ConstFst<StdArc> or VectorFst<StdArc>
 // (const-fst can give better performance for decoding).
+// If memory_map == true and rxfilename is a regular file containing a
+// ConstFst, its states and arcs are memory-mapped read-only instead of being
+// read into memory, so processes decoding with the same graph share it in the
+// page cache and it loads immediately.  Convert the graph with e.g.
+// "fstconvert --fst_type=const --fst_align HCLG.fst HCLG.const.fst" to get
+// aligned arrays.  Other FSTs are read as usual.
 Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename,
-                                 bool throw_on_err = true);
+                                 bool throw_on_err = true,
+                                 bool memory_map = false);
 
 // This function attempts to dynamic_cast the pointer 'fst' (which will likely
 // have been returned by ReadFstGeneric()), to the more derived
@@ -23,6 +23,88 @@
 #include "lat/kaldi-lattice.h"
 #include "lat/word-align-lattice.h"
 #include "lat/lattice-functions.h"
+#include "util/table-parallel-map.h"
+
+namespace kaldi {
+
+// Does the alignment for ParallelTableMap(); the TransitionModel and the
+// WordBoundaryInfo are shared by the threads.
+class WordAlignMapper {
+ public:
+  struct Item {
+    CompactLattice clat;
+    CompactLattice aligned_clat;
+    bool ok;
+  };
+
+  WordAlignMapper(const TransitionModel &tmodel, const WordBoundaryInfo &info,
+                  BaseFloat max_expand, bool output_if_error, bool do_test,
+                  CompactLatticeWriter *clat_writer):
+      tmodel_(tmodel), info_(info), max_expand_(max_expand),
+      output_if_error_(output_if_error), do_test_(do_test),
+      clat_writer_(clat_writer), num_done_(0), num_err_(0) { }
+
+  bool Read(const std::string &key, CompactLattice &clat, Item *item) {
+    item->clat = clat;
+    return true;
+  }
+
+  void Map(const std::string &key, Item *item) const {
+    const CompactLattice &clat = item->clat;
+    int32 max_states;
+    if (max_expand_ > 0) max_states = 1000 + max_expand_ * clat.NumStates();
+    else max_states = 0;
+
+    item->ok = WordAlignLattice(clat, tmodel_, info_, max_states,
+                                &item->aligned_clat);
+
+    if (do_test_ && item->ok)
+      TestWordAlignedLattice(clat, tmodel_, info_, item->aligned_clat);
+    if (item->aligned_clat.Start() != fst::kNoStateId)
+      TopSortCompactLatticeIfNeeded(&item->aligned_clat);
+  }
+
+  void Write(const std::string &key, Item *item) {
+    const CompactLattice &aligned_clat = item->aligned_clat;
+    if (!item->ok) {
+      num_err_++;
+      if (!output_if_error_)
+        KALDI_WARN << "Lattice for " << key
+                   << " did not align correctly, producing no output.";
+      else {
+        if (aligned_clat.Start() != fst::kNoStateId) {
+          KALDI_WARN << "Outputting partial lattice for " << key;
+          clat_writer_->Write(key, aligned_clat);
+        } else {
+          KALDI_WARN << "Empty aligned lattice for " << key
+                     << ", producing no output.";
+        }
+      }
+    } else {
+      if (aligned_clat.Start() == fst::kNoStateId) {
+        num_err_++;
+        KALDI_WARN << "Lattice was empty for key " << key;
+      } else {
+        num_done_++;
+        KALDI_VLOG(2) << "Aligned lattice for " << key;
+        clat_writer_->Write(key, aligned_clat);
+      }
+    }
+  }
+
+  int32 NumDone() const { return num_done_; }
+  int32 NumErr() const { return num_err_; }
+
+ private:
+  const TransitionModel &tmodel_;
+  const WordBoundaryInfo &info_;
+  BaseFloat max_expand_;
+  bool output_if_error_, do_test_;
+  CompactLatticeWriter *clat_writer_;
+  int32 num_done_, num_err_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -46,6 +128,7 @@ int main(int argc, char *argv[]) {
     BaseFloat max_expand = 0.0;
     bool output_if_error = true;
     bool do_test = false;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
     
     po.Register("output-error-lats", &output_if_error, "Output lattices that aligned "
                 "with errors (e.g. due to force-out");
@@ -57,6 +140,7 @@ int main(int argc, char *argv[]) {
     
     WordBoundaryInfoNewOpts opts;
     opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -79,49 +163,11 @@ int main(int argc, char *argv[]) {
 
     WordBoundaryInfo info(opts, word_boundary_rxfilename);
     
-    int32 num_done = 0, num_err = 0;
-    
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      const CompactLattice &clat = clat_reader.Value();
-
-      CompactLattice aligned_clat;
-      int32 max_states;
-      if (max_expand > 0) max_states = 1000 + max_expand * clat.NumStates();
-      else max_states = 0;
-      
-      bool ok = WordAlignLattice(clat, tmodel, info, max_states, &aligned_clat);
-      
-      if (do_test && ok)
-        TestWordAlignedLattice(clat, tmodel, info, aligned_clat);
-
-      if (!ok) {
-        num_err++;
-        if (!output_if_error)
-          KALDI_WARN << "Lattice for " << key
-                     << " did not align correctly, producing no output.";
-        else {
-          if (aligned_clat.Start() != fst::kNoStateId) {
-            KALDI_WARN << "Outputting partial lattice for " << key;
-            TopSortCompactLatticeIfNeeded(&aligned_clat);
-            clat_writer.Write(key, aligned_clat);
-          } else {
-            KALDI_WARN << "Empty aligned lattice for " << key
-                       << ", producing no output.";
-          }
-        }
-      } else {
-        if (aligned_clat.Start() == fst::kNoStateId) {
-          num_err++;
-          KALDI_WARN << "Lattice was empty for key " << key;
-        } else {
-          num_done++;
-          KALDI_VLOG(2) << "Aligned lattice for " << key;
-          TopSortCompactLatticeIfNeeded(&aligned_clat);
-          clat_writer.Write(key, aligned_clat);
-        }
-      }
-    }
+    WordAlignMapper mapper(tmodel, info, max_expand, output_if_error, do_test,
+                           &clat_writer);
+    ParallelTableMap(sequencer_config, &clat_reader, &mapper);
+    int32 num_done = mapper.NumDone(), num_err = mapper.NumErr();
+
     KALDI_LOG << "Successfully aligned " << num_done << " lattices; "
               << num_err << " had errors.";
     return (num_done > num_err ? 0 : 1); // We changed the error condition slightly here,
@@ -24,6 +24,90 @@
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
 #include "lat/confidence.h"
+#include "util/table-parallel-map.h"
+
+namespace kaldi {
+
+// Computes the confidences for ParallelTableMap(); LatType is Lattice or
+// CompactLattice.
+template<class LatType>
+class ConfidenceMapper {
+ public:
+  struct Item {
+    LatType lat;
+    int32 num_paths;
+    std::vector<int32> best_sentence, second_best_sentence;
+    BaseFloat confidence;
+  };
+
+  ConfidenceMapper(BaseFloat acoustic_scale, BaseFloat lm_scale,
+                   BaseFloatWriter *confidence_writer):
+      num_done(0), num_empty(0), num_one_sentence(0), num_same_sentence(0),
+      sum_neg_exp(0.0), acoustic_scale_(acoustic_scale), lm_scale_(lm_scale),
+      confidence_writer_(confidence_writer) { }
+
+  bool Read(const std::string &key, LatType &lat, Item *item) {
+    item->lat = lat;
+    return true;
+  }
+
+  void Map(const std::string &key, Item *item) const {
+    if (acoustic_scale_ != 1.0 || lm_scale_ != 1.0)
+      fst::ScaleLattice(fst::LatticeScale(lm_scale_, acoustic_scale_), &item->lat);
+    item->confidence = SentenceLevelConfidence(item->lat, &item->num_paths,
+                                               &item->best_sentence,
+                                               &item->second_best_sentence);
+    if (item->num_paths == 2 &&
+        item->best_sentence == item->second_best_sentence)
+      CheckSameSentence();
+  }
+
+  void Write(const std::string &key, Item *item) {
+    // Output this instead of infinity; I/O for infinity can be problematic.
+    const BaseFloat max_output = 1.0e+10;
+    if (item->num_paths == 0) {
+      KALDI_WARN << "Lattice for utterance " << key << " is equivalent to "
+                 << "the empty lattice.";
+      num_empty++;
+      return;
+    } else if (item->num_paths == 1) {
+      num_one_sentence++;
+    } else if (item->num_paths == 2 &&
+               item->best_sentence == item->second_best_sentence) {
+      KALDI_WARN << "Best and second-best sentences were identical: "
+                 << "confidence is meaningless.  You should call with "
+                 << "--read-compact-lattice=false.";
+      num_same_sentence++;
+    }
+    num_done++;
+    BaseFloat confidence = std::min(max_output, item->confidence); // disallow infinity.
+    sum_neg_exp += Exp(-confidence); // diagnostic.
+    confidence_writer_->Write(key, confidence);
+  }
+
+  int64 num_done, num_empty, num_one_sentence, num_same_sentence;
+  double sum_neg_exp;
+
+ private:
+  // Called from Map() when the two best paths have the same sentence.
+  void CheckSameSentence() const;
+
+  BaseFloat acoustic_scale_, lm_scale_;
+  BaseFloatWriter *confidence_writer_;
+};
+
+template<>
+void ConfidenceMapper<CompactLattice>::CheckSameSentence() const {
+  // Write() warns about it.
+}
+
+template<>
+void ConfidenceMapper<Lattice>::CheckSameSentence() const {
+  // This would be an error in some algorithm, in this case.
+  KALDI_ERR << "Best and second-best sentences were identical.";
+}
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -51,6 +135,7 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
 
     bool read_compact_lattice = true;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
     kaldi::BaseFloat acoustic_scale = 1.0, lm_scale = 1.0;
     po.Register("acoustic-scale", &acoustic_scale,
                 "Scaling factor for acoustic likelihoods");
@@ -60,6 +145,7 @@ int main(int argc, char *argv[]) {
                 "If true, read CompactLattice format; else, read Lattice format "
                 "(necessary for state-level lattices that were written in that "
                 "format).");
+    sequencer_config.Register(&po);
     
     po.Read(argc, argv);
 
@@ -73,85 +159,31 @@ int main(int argc, char *argv[]) {
     
     BaseFloatWriter confidence_writer(confidence_wspecifier);
     
-    // Output this instead of infinity; I/O for infinity can be problematic.
-    const BaseFloat max_output = 1.0e+10; 
-    
     int64 num_done = 0, num_empty = 0,
         num_one_sentence = 0, num_same_sentence = 0;
     double sum_neg_exp = 0.0;
-    
-    
+
     if (read_compact_lattice) {
       SequentialCompactLatticeReader clat_reader(lats_rspecifier);
-      
-      for (; !clat_reader.Done(); clat_reader.Next()) {
-        CompactLattice clat = clat_reader.Value();
-        std::string key = clat_reader.Key();
-        // FreeCurrent() is an optimization that prevents the lattice from being
-        // copied unnecessarily (OpenFst does copy-on-write).
-        clat_reader.FreeCurrent();
-        if (acoustic_scale != 1.0 || lm_scale != 1.0)
-          fst::ScaleLattice(fst::LatticeScale(lm_scale, acoustic_scale), &clat);
-
-        int32 num_paths;
-        std::vector<int32> best_sentence, second_best_sentence;
-        BaseFloat confidence;
-        confidence = SentenceLevelConfidence(clat, &num_paths,
-                                             &best_sentence,
-                                             &second_best_sentence);
-        if (num_paths == 0) {
-          KALDI_WARN << "Lattice for utterance " << key << " is equivalent to "
-                     << "the empty lattice.";
-          num_empty++;
-          continue;
-        } else if (num_paths == 1) {
-          num_one_sentence++;
-        } else if (num_paths == 2 && best_sentence == second_best_sentence) {
-          KALDI_WARN << "Best and second-best sentences were identical: "
-                     << "confidence is meaningless.  You should call with "
-                     << "--read-compact-lattice=false.";
-          num_same_sentence++;
-        }
-        num_done++;
-        confidence = std::min(max_output, confidence); // disallow infinity.
-        sum_neg_exp += Exp(-confidence); // diagnostic.
-        confidence_writer.Write(key, confidence);
-      }
+      ConfidenceMapper<CompactLattice> mapper(acoustic_scale, lm_scale,
+                                              &confidence_writer);
+      ParallelTableMap(sequencer_config, &clat_reader, &mapper);
+      num_done = mapper.num_done;
+      num_empty = mapper.num_empty;
+      num_one_sentence = mapper.num_one_sentence;
+      num_same_sentence = mapper.num_same_sentence;
+      sum_neg_exp = mapper.sum_neg_exp;
     } else {
       SequentialLatticeReader lat_reader(lats_rspecifier);
-      
-      for (; !lat_reader.Done(); lat_reader.Next()) {
-        Lattice lat = lat_reader.Value();
-        std::string key = lat_reader.Key();
-        // FreeCurrent() is an optimization that prevents the lattice from being
-        // copied unnecessarily (OpenFst does copy-on-write).
-        lat_reader.FreeCurrent();
-        if (acoustic_scale != 1.0 || lm_scale != 1.0)
-          fst::ScaleLattice(fst::LatticeScale(lm_scale, acoustic_scale), &lat);
-        int32 num_paths;
-        std::vector<int32> best_sentence, second_best_sentence;
-        BaseFloat confidence;
-        confidence = SentenceLevelConfidence(lat, &num_paths,
-                                             &best_sentence,
-                                             &second_best_sentence);
-        if (num_paths == 0) {
-          KALDI_WARN << "Lattice for utterance " << key << " is equivalent to "
-                     << "the empty lattice.";
-          num_empty++;
-          continue;
-        } else if (num_paths == 1) {
-          num_one_sentence++;
-        } else if (num_paths == 2 && best_sentence == second_best_sentence) {
-          // This would be an error in some algorithm, in this case.
-          KALDI_ERR << "Best and second-best sentences were identical.";
-        }
-        num_done++;
-        confidence = std::min(max_output, confidence); // disallow infinity.
-        sum_neg_exp += Exp(-confidence); // diagnostic.
-        confidence_writer.Write(key, confidence);
-      }
+      ConfidenceMapper<Lattice> mapper(acoustic_scale, lm_scale,
+                                       &confidence_writer);
+      ParallelTableMap(sequencer_config, &lat_reader, &mapper);
+      num_done = mapper.num_done;
+      num_empty = mapper.num_empty;
+      num_one_sentence = mapper.num_one_sentence;
+      sum_neg_exp = mapper.sum_neg_exp;
     }
-        
+
     KALDI_LOG << "Done " << num_done << " lattices, of which "
               << num_one_sentence << " contained only one sentence. "
               << num_empty << " were equivalent to the empty lattice.";
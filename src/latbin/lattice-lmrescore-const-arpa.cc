@@ -22,8 +22,84 @@
 #include "fstext/fstext-lib.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
+#include "lm/compact-arpa-lm.h"
 #include "lm/const-arpa-lm.h"
 #include "util/common-utils.h"
+#include "util/table-parallel-map.h"
+
+namespace kaldi {
+
+// Does the rescoring for ParallelTableMap(); the ConstArpaLm (or CompactArpaLm)
+// is shared by the threads, each lattice gets its own LmFst.
+template <class Lm, class LmFst>
+class ConstArpaRescoreMapper {
+ public:
+  struct Item {
+    CompactLattice clat;
+  };
+
+  ConstArpaRescoreMapper(const Lm &const_arpa, BaseFloat lm_scale,
+                         CompactLatticeWriter *writer):
+      const_arpa_(const_arpa), lm_scale_(lm_scale), writer_(writer),
+      num_done_(0), num_fail_(0) { }
+
+  bool Read(const std::string &key, CompactLattice &clat, Item *item) {
+    item->clat = clat;
+    return true;
+  }
+
+  void Map(const std::string &key, Item *item) const {
+    // Zero scale so nothing to do.
+    if (lm_scale_ == 0.0)
+      return;
+    CompactLattice &clat = item->clat;
+    // Before composing with the LM FST, we scale the lattice weights
+    // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
+    // We do it this way so we can determinize and it will give the
+    // right effect (taking the "best path" through the LM) regardless
+    // of the sign of lm_scale.
+    fst::ScaleLattice(fst::GraphLatticeScale(1.0/lm_scale_), &clat);
+    ArcSort(&clat, fst::OLabelCompare<CompactLatticeArc>());
+
+    // Wraps the ConstArpaLm format language model into FST. We re-create it
+    // for each lattice to prevent memory usage increasing with time.
+    LmFst const_arpa_fst(const_arpa_);
+
+    // Composes lattice with language model.
+    CompactLattice composed_clat;
+    ComposeCompactLatticeDeterministic(clat,
+                                       &const_arpa_fst, &composed_clat);
+
+    // Determinizes the composed lattice.
+    Lattice composed_lat;
+    ConvertLattice(composed_clat, &composed_lat);
+    Invert(&composed_lat);
+    DeterminizeLattice(composed_lat, &clat);
+    fst::ScaleLattice(fst::GraphLatticeScale(lm_scale_), &clat);
+  }
+
+  void Write(const std::string &key, Item *item) {
+    if (item->clat.Start() == fst::kNoStateId) {
+      KALDI_WARN << "Empty lattice for utterance " << key
+          << " (incompatible LM?)";
+      num_fail_++;
+    } else {
+      writer_->Write(key, item->clat);
+      num_done_++;
+    }
+  }
+
+  int32 NumDone() const { return num_done_; }
+  int32 NumFail() const { return num_fail_; }
+
+ private:
+  const Lm &const_arpa_;
+  BaseFloat lm_scale_;
+  CompactLatticeWriter *writer_;
+  int32 num_done_, num_fail_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -36,7 +112,8 @@ int main(int argc, char *argv[]) {
         "will be wrapped into the DeterministicOnDemandFst interface and the\n"
         "rescoring is done by composing with the wrapped LM using a special\n"
         "type of composition algorithm. Determinization will be applied on\n"
-        "the composed lattice.\n"
+        "the composed lattice.  With --compact-lm, the LM is in CompactArpaLm\n"
+        "format (see const-arpa-to-compact-arpa).\n"
         "\n"
         "Usage: lattice-lmrescore-const-arpa [options] lattice-rspecifier \\\n"
         "                                   const-arpa-in lattice-wspecifier\n"
@@ -45,9 +122,17 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     BaseFloat lm_scale = 1.0;
+    bool mmap_lm = false, compact_lm = false;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
 
     po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
                 "costs; frequently 1.0 or -1.0");
+    po.Register("mmap-lm", &mmap_lm, "If true, memory-map the language model "
+                "if it was written with arpa-to-const-arpa --mappable=true, "
+                "so that processes share it.");
+    po.Register("compact-lm", &compact_lm, "If true, the language model is "
+                "in CompactArpaLm format.");
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -60,58 +145,31 @@ int main(int argc, char *argv[]) {
         lm_rxfilename = po.GetArg(2),
         lats_wspecifier = po.GetArg(3);
 
-    // Reads the language model in ConstArpaLm format.
-    ConstArpaLm const_arpa;
-    ReadKaldiObject(lm_rxfilename, &const_arpa);
-
     // Reads and writes as compact lattice.
     SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
     CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
 
-    int32 n_done = 0, n_fail = 0;
-    for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
-      std::string key = compact_lattice_reader.Key();
-      CompactLattice clat = compact_lattice_reader.Value();
-      compact_lattice_reader.FreeCurrent();
-
-      if (lm_scale != 0.0) {
-        // Before composing with the LM FST, we scale the lattice weights
-        // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
-        // We do it this way so we can determinize and it will give the
-        // right effect (taking the "best path" through the LM) regardless
-        // of the sign of lm_scale.
-        fst::ScaleLattice(fst::GraphLatticeScale(1.0/lm_scale), &clat);
-        ArcSort(&clat, fst::OLabelCompare<CompactLatticeArc>());
-
-        // Wraps the ConstArpaLm format language model into FST. We re-create it
-        // for each lattice to prevent memory usage increasing with time.
-        ConstArpaLmDeterministicFst const_arpa_fst(const_arpa);
-
-        // Composes lattice with language model.
-        CompactLattice composed_clat;
-        ComposeCompactLatticeDeterministic(clat,
-                                           &const_arpa_fst, &composed_clat);
-
-        // Determinizes the composed lattice.
-        Lattice composed_lat;
-        ConvertLattice(composed_clat, &composed_lat);
-        Invert(&composed_lat);
-        CompactLattice determinized_clat;
-        DeterminizeLattice(composed_lat, &determinized_clat);
-        fst::ScaleLattice(fst::GraphLatticeScale(lm_scale), &determinized_clat);
-        if (determinized_clat.Start() == fst::kNoStateId) {
-          KALDI_WARN << "Empty lattice for utterance " << key
-              << " (incompatible LM?)";
-          n_fail++;
-        } else {
-          compact_lattice_writer.Write(key, determinized_clat);
-          n_done++;
-        }
-      } else {
-        // Zero scale so nothing to do.
-        n_done++;
-        compact_lattice_writer.Write(key, clat);
-      }
+    int32 n_done, n_fail;
+    if (compact_lm) {
+      CompactArpaLm compact_arpa;
+      ReadKaldiObject(lm_rxfilename, &compact_arpa);
+      ConstArpaRescoreMapper<CompactArpaLm, CompactArpaLmDeterministicFst>
+          mapper(compact_arpa, lm_scale, &compact_lattice_writer);
+      ParallelTableMap(sequencer_config, &compact_lattice_reader, &mapper);
+      n_done = mapper.NumDone();
+      n_fail = mapper.NumFail();
+    } else {
+      // Reads the language model in ConstArpaLm format.
+      ConstArpaLm const_arpa;
+      if (mmap_lm)
+        const_arpa.ReadMapped(lm_rxfilename);
+      else
+        ReadKaldiObject(lm_rxfilename, &const_arpa);
+      ConstArpaRescoreMapper<ConstArpaLm, ConstArpaLmDeterministicFst>
+          mapper(const_arpa, lm_scale, &compact_lattice_writer);
+      ParallelTableMap(sequencer_config, &compact_lattice_reader, &mapper);
+      n_done = mapper.NumDone();
+      n_fail = mapper.NumFail();
     }
 
     KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
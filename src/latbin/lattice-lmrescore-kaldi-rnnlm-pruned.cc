@@ -28,6 +28,103 @@
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
 #include "lat/compose-lattice-pruned.h"
+#include "util/table-parallel-map.h"
+
+namespace kaldi {
+
+// Does the rescoring for ParallelTableMap().  The old LM (as an FST or a
+// ConstArpaLm) and the RnnlmComputeStateInfo are shared by the threads; the
+// DeterministicOnDemandFsts keep state, so each lattice gets its own.
+class RnnlmPrunedRescoreMapper {
+ public:
+  struct Item {
+    CompactLattice clat;
+  };
+
+  // Exactly one of 'lm_to_subtract_fst' and 'const_arpa' is non-NULL.
+  RnnlmPrunedRescoreMapper(const ComposeLatticePrunedOptions &compose_opts,
+                           int32 max_ngram_order,
+                           BaseFloat lm_scale, BaseFloat acoustic_scale,
+                           const fst::VectorFst<fst::StdArc> *lm_to_subtract_fst,
+                           const ConstArpaLm *const_arpa,
+                           const rnnlm::RnnlmComputeStateInfo &info,
+                           CompactLatticeWriter *writer):
+      compose_opts_(compose_opts), max_ngram_order_(max_ngram_order),
+      lm_scale_(lm_scale), acoustic_scale_(acoustic_scale),
+      lm_to_subtract_fst_(lm_to_subtract_fst), const_arpa_(const_arpa),
+      info_(info), writer_(writer), num_done_(0), num_err_(0) { }
+
+  bool Read(const std::string &key, CompactLattice &clat, Item *item) {
+    item->clat = clat;
+    return true;
+  }
+
+  void Map(const std::string &key, Item *item) const {
+    using fst::StdArc;
+    CompactLattice &clat = item->clat;
+    fst::DeterministicOnDemandFst<StdArc> *lm_to_subtract = NULL;
+    if (const_arpa_ != NULL)
+      lm_to_subtract = new ConstArpaLmDeterministicFst(*const_arpa_);
+    else
+      lm_to_subtract =
+          new fst::BackoffDeterministicOnDemandFst<StdArc>(*lm_to_subtract_fst_);
+    fst::ScaleDeterministicOnDemandFst lm_to_subtract_det_scale(-lm_scale_,
+                                                               lm_to_subtract);
+
+    rnnlm::KaldiRnnlmDeterministicFst lm_to_add_orig(max_ngram_order_, info_);
+    fst::ScaleDeterministicOnDemandFst lm_to_add(lm_scale_, &lm_to_add_orig);
+
+    // Before composing with the LM FST, we scale the lattice weights
+    // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
+    // We do it this way so we can determinize and it will give the
+    // right effect (taking the "best path" through the LM) regardless
+    // of the sign of lm_scale.
+    if (acoustic_scale_ != 1.0) {
+      fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale_), &clat);
+    }
+    TopSortCompactLatticeIfNeeded(&clat);
+
+    fst::ComposeDeterministicOnDemandFst<StdArc> combined_lms(
+        &lm_to_subtract_det_scale, &lm_to_add);
+
+    // Composes lattice with language model.
+    CompactLattice composed_clat;
+    ComposeCompactLatticePruned(compose_opts_, clat,
+                                &combined_lms, &composed_clat);
+    delete lm_to_subtract;
+
+    if (composed_clat.NumStates() != 0 && acoustic_scale_ != 1.0) {
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_),
+                        &composed_clat);
+    }
+    clat = composed_clat;
+  }
+
+  void Write(const std::string &key, Item *item) {
+    if (item->clat.NumStates() == 0) {
+      // Something went wrong.  A warning will already have been printed.
+      num_err_++;
+    } else {
+      writer_->Write(key, item->clat);
+      num_done_++;
+    }
+  }
+
+  int32 NumDone() const { return num_done_; }
+  int32 NumErr() const { return num_err_; }
+
+ private:
+  const ComposeLatticePrunedOptions &compose_opts_;
+  int32 max_ngram_order_;
+  BaseFloat lm_scale_, acoustic_scale_;
+  const fst::VectorFst<fst::StdArc> *lm_to_subtract_fst_;
+  const ConstArpaLm *const_arpa_;
+  const rnnlm::RnnlmComputeStateInfo &info_;
+  CompactLatticeWriter *writer_;
+  int32 num_done_, num_err_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -65,6 +162,7 @@ int main(int argc, char *argv[]) {
     BaseFloat lm_scale = 0.5;
     BaseFloat acoustic_scale = 0.1;
     bool use_carpa = false;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
 
     po.Register("lm-scale", &lm_scale, "Scaling factor for <lm-to-add>; its negative "
                 "will be applied to <lm-to-subtract>.");
@@ -80,6 +178,7 @@ int main(int argc, char *argv[]) {
 
     opts.Register(&po);
     compose_opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -102,31 +201,21 @@ int main(int argc, char *argv[]) {
     lats_wspecifier = po.GetArg(5);
 
     // for G.fst
-    fst::ScaleDeterministicOnDemandFst *lm_to_subtract_det_scale = NULL;
-    fst::BackoffDeterministicOnDemandFst<StdArc> *lm_to_subtract_det_backoff = NULL;
     VectorFst<StdArc> *lm_to_subtract_fst = NULL;
 
     // for G.carpa
     ConstArpaLm* const_arpa = NULL;
-    fst::DeterministicOnDemandFst<StdArc> *carpa_lm_to_subtract_fst = NULL;
 
     KALDI_LOG << "Reading old LMs...";
     if (use_carpa) {
       const_arpa = new ConstArpaLm();
       ReadKaldiObject(lm_to_subtract_rxfilename, const_arpa);
-      carpa_lm_to_subtract_fst = new ConstArpaLmDeterministicFst(*const_arpa);
-      lm_to_subtract_det_scale
-        = new fst::ScaleDeterministicOnDemandFst(-lm_scale,
-                                                 carpa_lm_to_subtract_fst);
     } else {
       lm_to_subtract_fst = fst::ReadAndPrepareLmFst(
           lm_to_subtract_rxfilename);
-      lm_to_subtract_det_backoff =
-        new fst::BackoffDeterministicOnDemandFst<StdArc>(*lm_to_subtract_fst);
-      lm_to_subtract_det_scale =
-           new fst::ScaleDeterministicOnDemandFst(-lm_scale,
-                                                  lm_to_subtract_det_backoff);
     }
+    if (acoustic_scale == 0.0)
+      KALDI_ERR << "Acoustic scale cannot be zero.";
 
     kaldi::nnet3::Nnet rnnlm;
     ReadKaldiObject(rnnlm_rxfilename, &rnnlm);
@@ -142,62 +231,14 @@ int main(int argc, char *argv[]) {
     SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
     CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
 
-    int32 num_done = 0, num_err = 0;
-
-    rnnlm::KaldiRnnlmDeterministicFst* lm_to_add_orig = 
-         new rnnlm::KaldiRnnlmDeterministicFst(max_ngram_order, info);
-
-    for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
-      fst::DeterministicOnDemandFst<StdArc> *lm_to_add =
-         new fst::ScaleDeterministicOnDemandFst(lm_scale, lm_to_add_orig);
-
-      std::string key = compact_lattice_reader.Key();
-      CompactLattice clat = compact_lattice_reader.Value();
-      compact_lattice_reader.FreeCurrent();
-
-      // Before composing with the LM FST, we scale the lattice weights
-      // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
-      // We do it this way so we can determinize and it will give the
-      // right effect (taking the "best path" through the LM) regardless
-      // of the sign of lm_scale.
-      if (acoustic_scale != 1.0) {
-        fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale), &clat);
-      }
-      TopSortCompactLatticeIfNeeded(&clat);
-
-      fst::ComposeDeterministicOnDemandFst<StdArc> combined_lms(
-          lm_to_subtract_det_scale, lm_to_add);
-
-      // Composes lattice with language model.
-      CompactLattice composed_clat;
-      ComposeCompactLatticePruned(compose_opts, clat,
-                                  &combined_lms, &composed_clat);
-
-      lm_to_add_orig->Clear();
-
-      if (composed_clat.NumStates() == 0) {
-        // Something went wrong.  A warning will already have been printed.
-        num_err++;
-      } else {
-        if (acoustic_scale != 1.0) {
-          if (acoustic_scale == 0.0)
-            KALDI_ERR << "Acoustic scale cannot be zero.";
-          fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale),
-                            &composed_clat);
-        }
-        compact_lattice_writer.Write(key, composed_clat);
-        num_done++;
-      }
-      delete lm_to_add;
-    }
+    RnnlmPrunedRescoreMapper mapper(compose_opts, max_ngram_order, lm_scale,
+                                    acoustic_scale, lm_to_subtract_fst,
+                                    const_arpa, info, &compact_lattice_writer);
+    ParallelTableMap(sequencer_config, &compact_lattice_reader, &mapper);
+    int32 num_done = mapper.NumDone(), num_err = mapper.NumErr();
 
     delete lm_to_subtract_fst;
-    delete lm_to_add_orig;
-    delete lm_to_subtract_det_backoff;
-    delete lm_to_subtract_det_scale;
-
     delete const_arpa;
-    delete carpa_lm_to_subtract_fst;
 
     KALDI_LOG << "Overall, succeeded for " << num_done
               << " lattices, failed for " << num_err;
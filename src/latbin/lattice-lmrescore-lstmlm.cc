@@ -24,6 +24,7 @@
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
 #include "lm/kaldi-nnlm.h"
+#include "lm/nnlm-lattice-rescorer.h"
 #include "util/common-utils.h"
 
 int main(int argc, char *argv[]) {
@@ -33,10 +34,10 @@ int main(int argc, char *argv[]) {
     typedef kaldi::int64 int64;
 
     const char *usage =
-        "Rescores lattice with lstmlm. The LM will be wrapped into the\n"
-        "DeterministicOnDemandFst interface and the rescoring is done by\n"
-        "composing with the wrapped LM using a special type of composition\n"
-        "algorithm. Determinization will be applied on the composed lattice.\n"
+        "Rescores lattice with lstmlm. The lattices are composed with the LM\n"
+        "breadth first, --num-lattices at a time, and the word histories they\n"
+        "reach are forwarded through the LM in batches of --batch-size.\n"
+        "Determinization will be applied on the composed lattice.\n"
         "\n"
         "Usage: lattice-lmrescore-lstmlm [options] [unk_prob_rspecifier]  \\\n"
         "             <word-symbol-table-rxfilename> <lstmlm-word-symbol-table-rxfilename> \\\n"
@@ -45,19 +46,17 @@ int main(int argc, char *argv[]) {
         "                     ark:in.lats lstmlm ark:out.lats\n";
 
     ParseOptions po(usage);
-    int32 max_ngram_order = 3;
     BaseFloat lm_scale = 1.0;
     std::string use_gpu="no";
 
     po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
                 "costs; frequently 1.0 or -1.0");
-    po.Register("max-ngram-order", &max_ngram_order, "If positive, limit the "
-                "lstmlm context to the given number, -1 means we are not going "
-                "to limit it.");
     po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA"); 
 
     KaldiNNlmWrapperOpts opts;
     opts.Register(&po);
+    NNlmRescoreOptions rescore_opts;
+    rescore_opts.Register(&po);
 
     po.Read(argc, argv);
 
@@ -94,58 +93,73 @@ int main(int argc, char *argv[]) {
     KaldiNNlmWrapper lstmlm(opts, unk_prob_rspecifier, word_symbols_rxfilename,
                             lstmlm_word_symbols_rxfilename, lstmlm_rxfilename);
 
+    NNlmLatticeRescorer rescorer(rescore_opts, &lstmlm);
+
     // Reads and writes as compact lattice.
     SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
     CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
 
     Timer tm;
-    int32 n_done = 0, n_fail = 0;
-    for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
-      std::string key = compact_lattice_reader.Key();
-      CompactLattice clat = compact_lattice_reader.Value();
-      compact_lattice_reader.FreeCurrent();
+    int32 n_done = 0, n_fail = 0,
+        num_lattices = std::max(rescore_opts.num_lattices, 1);
+    std::vector<std::string> keys;
+    std::vector<CompactLattice> clats, composed_clats;
+    while (!compact_lattice_reader.Done()) {
+      if (lm_scale == 0.0) {
+        // Zero scale so nothing to do.
+        n_done++;
+        compact_lattice_writer.Write(compact_lattice_reader.Key(),
+                                     compact_lattice_reader.Value());
+        compact_lattice_reader.Next();
+        continue;
+      }
 
-      if (lm_scale != 0.0) {
+      keys.clear();
+      clats.clear();
+      for (; !compact_lattice_reader.Done() &&
+             static_cast<int32>(keys.size()) < num_lattices;
+           compact_lattice_reader.Next()) {
+        keys.push_back(compact_lattice_reader.Key());
+        clats.push_back(compact_lattice_reader.Value());
+        compact_lattice_reader.FreeCurrent();
         // Before composing with the LM FST, we scale the lattice weights
         // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
         // We do it this way so we can determinize and it will give the
         // right effect (taking the "best path" through the LM) regardless
         // of the sign of lm_scale.
-        fst::ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale), &clat);
-        ArcSort(&clat, fst::OLabelCompare<CompactLatticeArc>());
-
-        // Wraps the lstmlm into FST. We re-create it for each lattice to prevent
-        // memory usage increasing with time.
-        NNlmDeterministicFst lstmlm_fst(max_ngram_order, &lstmlm);
-
-        tm.Reset();
-        // Composes lattice with language model.
-        CompactLattice composed_clat;
-        ComposeCompactLatticeDeterministic(clat, &lstmlm_fst, &composed_clat);
-        KALDI_VLOG(1) << "Rescore lattice time for utterance " << key << " : " << tm.Elapsed() << " s.";
+        fst::ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale), &clats.back());
+      }
 
+      tm.Reset();
+      // Composes the lattices with the language model.
+      std::vector<const CompactLattice*> clat_ptrs(clats.size());
+      for (size_t i = 0; i < clats.size(); i++)
+        clat_ptrs[i] = &clats[i];
+      rescorer.Rescore(clat_ptrs, &composed_clats);
+      KALDI_VLOG(1) << "Rescore lattice time for " << keys.size()
+                    << " utterances from " << keys[0] << " : "
+                    << tm.Elapsed() << " s.";
+
+      for (size_t i = 0; i < keys.size(); i++) {
         // Determinizes the composed lattice.
         Lattice composed_lat;
-        ConvertLattice(composed_clat, &composed_lat);
+        ConvertLattice(composed_clats[i], &composed_lat);
         Invert(&composed_lat);
         CompactLattice determinized_clat;
         DeterminizeLattice(composed_lat, &determinized_clat);
         fst::ScaleLattice(fst::GraphLatticeScale(lm_scale), &determinized_clat);
         if (determinized_clat.Start() == fst::kNoStateId) {
-          KALDI_WARN << "Empty lattice for utterance " << key
+          KALDI_WARN << "Empty lattice for utterance " << keys[i]
               << " (incompatible LM?)";
           n_fail++;
         } else {
-          compact_lattice_writer.Write(key, determinized_clat);
+          compact_lattice_writer.Write(keys[i], determinized_clat);
           n_done++;
         }
-      } else {
-        // Zero scale so nothing to do.
-        n_done++;
-        compact_lattice_writer.Write(key, clat);
       }
     }
 
+    rescorer.PrintStats();
     KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
     return (n_done != 0 ? 0 : 1);
   } catch(const std::exception &e) {
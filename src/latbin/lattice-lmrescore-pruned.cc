@@ -26,6 +26,110 @@
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
 #include "lat/compose-lattice-pruned.h"
+#include "util/table-parallel-map.h"
+
+namespace kaldi {
+
+// Does the rescoring for ParallelTableMap().  The LM FSTs and the ConstArpaLm
+// are shared by the threads; the DeterministicOnDemandFst wrappers keep state,
+// so each lattice gets its own.
+class PrunedRescoreMapper {
+ public:
+  struct Item {
+    CompactLattice clat;
+  };
+
+  // 'lm_to_add_fst' is NULL if 'const_arpa' is to be added.
+  PrunedRescoreMapper(const ComposeLatticePrunedOptions &compose_opts,
+                      BaseFloat lm_scale, BaseFloat acoustic_scale,
+                      const fst::VectorFst<fst::StdArc> &lm_to_subtract_fst,
+                      const fst::VectorFst<fst::StdArc> *lm_to_add_fst,
+                      const ConstArpaLm &const_arpa,
+                      CompactLatticeWriter *writer):
+      compose_opts_(compose_opts), lm_scale_(lm_scale),
+      acoustic_scale_(acoustic_scale), lm_to_subtract_fst_(lm_to_subtract_fst),
+      lm_to_add_fst_(lm_to_add_fst), const_arpa_(const_arpa), writer_(writer),
+      num_done_(0), num_err_(0) { }
+
+  bool Read(const std::string &key, CompactLattice &clat, Item *item) {
+    item->clat = clat;
+    return true;
+  }
+
+  void Map(const std::string &key, Item *item) const {
+    using fst::StdArc;
+    CompactLattice &clat = item->clat;
+    if (acoustic_scale_ != 1.0) {
+      fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale_), &clat);
+    }
+    TopSortCompactLatticeIfNeeded(&clat);
+
+    fst::BackoffDeterministicOnDemandFst<StdArc> lm_to_subtract_det_backoff(
+        lm_to_subtract_fst_);
+    fst::ScaleDeterministicOnDemandFst lm_to_subtract_det_scale(
+        -lm_scale_, &lm_to_subtract_det_backoff);
+
+    fst::DeterministicOnDemandFst<StdArc> *lm_to_add_orig = NULL,
+        *lm_to_add = NULL;
+    if (lm_to_add_fst_ == NULL) {
+      lm_to_add = new ConstArpaLmDeterministicFst(const_arpa_);
+    } else {
+      lm_to_add = new fst::BackoffDeterministicOnDemandFst<StdArc>(
+          *lm_to_add_fst_);
+    }
+    if (lm_scale_ != 1.0) {
+      lm_to_add_orig = lm_to_add;
+      lm_to_add = new fst::ScaleDeterministicOnDemandFst(lm_scale_,
+                                                         lm_to_add_orig);
+    }
+
+    // To avoid memory gradually increasing with time, we reconstruct the
+    // composed-LM FST for each lattice we process.
+    //   It shouldn't make a difference in which order we provide the
+    // arguments to the composition; either way should work.  They are both
+    // acceptors so the result is the same either way.
+    fst::ComposeDeterministicOnDemandFst<StdArc> combined_lms(
+        &lm_to_subtract_det_scale, lm_to_add);
+
+    CompactLattice composed_clat;
+    ComposeCompactLatticePruned(compose_opts_,
+                                clat,
+                                &combined_lms,
+                                &composed_clat);
+    delete lm_to_add_orig;
+    delete lm_to_add;
+
+    if (composed_clat.NumStates() != 0 && acoustic_scale_ != 1.0) {
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_),
+                        &composed_clat);
+    }
+    clat = composed_clat;
+  }
+
+  void Write(const std::string &key, Item *item) {
+    if (item->clat.NumStates() == 0) {
+      // Something went wrong.  A warning will already have been printed.
+      num_err_++;
+    } else {
+      writer_->Write(key, item->clat);
+      num_done_++;
+    }
+  }
+
+  int32 NumDone() const { return num_done_; }
+  int32 NumErr() const { return num_err_; }
+
+ private:
+  const ComposeLatticePrunedOptions &compose_opts_;
+  BaseFloat lm_scale_, acoustic_scale_;
+  const fst::VectorFst<fst::StdArc> &lm_to_subtract_fst_;
+  const fst::VectorFst<fst::StdArc> *lm_to_add_fst_;
+  const ConstArpaLm &const_arpa_;
+  CompactLatticeWriter *writer_;
+  int32 num_done_, num_err_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -60,6 +164,8 @@ int main(int argc, char *argv[]) {
     BaseFloat lm_scale = 1.0;
     BaseFloat acoustic_scale = 1.0;
     bool add_const_arpa = false;
+    bool mmap_lm = false;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
 
     po.Register("lm-scale", &lm_scale, "Scaling factor for <lm-to-add>; its negative "
                 "will be applied to <lm-to-subtract>.");
@@ -69,6 +175,10 @@ int main(int argc, char *argv[]) {
     po.Register("add-const-arpa", &add_const_arpa, "If true, <lm-to-add> is expected"
                 "to be in const-arpa format; if false it's expected to be in FST"
                 "format.");
+    po.Register("mmap-lm", &mmap_lm, "If true, memory-map the const-arpa "
+                "<lm-to-add> if it was written with arpa-to-const-arpa "
+                "--mappable=true, so that processes share it.");
+    sequencer_config.Register(&po);
 
 
     po.Read(argc, argv);
@@ -89,29 +199,15 @@ int main(int argc, char *argv[]) {
     VectorFst<StdArc> *lm_to_add_fst = NULL;
     ConstArpaLm const_arpa;
     if (add_const_arpa) {
-      ReadKaldiObject(lm_to_add_rxfilename, &const_arpa);
+      if (mmap_lm)
+        const_arpa.ReadMapped(lm_to_add_rxfilename);
+      else
+        ReadKaldiObject(lm_to_add_rxfilename, &const_arpa);
     } else {
       lm_to_add_fst = fst::ReadAndPrepareLmFst(lm_to_add_rxfilename);
     }
-    fst::BackoffDeterministicOnDemandFst<StdArc> lm_to_subtract_det_backoff(
-        *lm_to_subtract_fst);
-    fst::ScaleDeterministicOnDemandFst lm_to_subtract_det_scale(
-        -lm_scale, &lm_to_subtract_det_backoff);
-
-
-    fst::DeterministicOnDemandFst<StdArc> *lm_to_add_orig = NULL,
-        *lm_to_add = NULL;
-    if (add_const_arpa) {
-      lm_to_add = new ConstArpaLmDeterministicFst(const_arpa);
-    } else {
-      lm_to_add = new fst::BackoffDeterministicOnDemandFst<StdArc>(
-          *lm_to_add_fst);
-    }
-    if (lm_scale != 1.0) {
-      lm_to_add_orig = lm_to_add;
-      lm_to_add = new fst::ScaleDeterministicOnDemandFst(lm_scale,
-                                                         lm_to_add_orig);
-    }
+    if (acoustic_scale == 0.0)
+      KALDI_ERR << "Acoustic scale cannot be zero.";
 
     KALDI_LOG << "Done.";
 
@@ -121,49 +217,14 @@ int main(int argc, char *argv[]) {
     // Write as compact lattice.
     CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
 
-    int32 num_done = 0, num_err = 0;
-
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      CompactLattice &clat = clat_reader.Value();
-
-      if (acoustic_scale != 1.0) {
-        fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale), &clat);
-      }
-      TopSortCompactLatticeIfNeeded(&clat);
-
-      // To avoid memory gradually increasing with time, we reconstruct the
-      // composed-LM FST for each lattice we process.
-      //   It shouldn't make a difference in which order we provide the
-      // arguments to the composition; either way should work.  They are both
-      // acceptors so the result is the same either way.
-      fst::ComposeDeterministicOnDemandFst<StdArc> combined_lms(
-          &lm_to_subtract_det_scale, lm_to_add);
-
-      CompactLattice composed_clat;
-      ComposeCompactLatticePruned(compose_opts,
-                                  clat,
-                                  &combined_lms,
-                                  &composed_clat);
-
-      if (composed_clat.NumStates() == 0) {
-        // Something went wrong.  A warning will already have been printed.
-        num_err++;
-      } else {
-        if (acoustic_scale != 1.0) {
-          if (acoustic_scale == 0.0)
-            KALDI_ERR << "Acoustic scale cannot be zero.";
-          fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale),
-                            &composed_clat);
-        }
-        compact_lattice_writer.Write(key, composed_clat);
-        num_done++;
-      }
-    }
+    PrunedRescoreMapper mapper(compose_opts, lm_scale, acoustic_scale,
+                               *lm_to_subtract_fst, lm_to_add_fst, const_arpa,
+                               &compact_lattice_writer);
+    ParallelTableMap(sequencer_config, &clat_reader, &mapper);
+    int32 num_done = mapper.NumDone(), num_err = mapper.NumErr();
+
     delete lm_to_subtract_fst;
     delete lm_to_add_fst;
-    delete lm_to_add_orig;
-    delete lm_to_add;
 
     KALDI_LOG << "Overall, succeeded for " << num_done
               << " lattices, failed for " << num_err;
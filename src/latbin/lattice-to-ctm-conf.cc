@@ -20,9 +20,111 @@
 
 #include "util/common-utils.h"
 #include "util/kaldi-table.h"
+#include "util/table-parallel-map.h"
 #include "lat/sausages.h"
 #include <numeric>
 
+namespace kaldi {
+
+// Does the MBR decoding for ParallelTableMap(); the 1-best and times readers
+// are only used from Read(), in the main thread.
+class CtmConfMapper {
+ public:
+  struct Item {
+    CompactLattice clat;
+    std::vector<int32> one_best;
+    std::vector<std::pair<BaseFloat, BaseFloat> > times;
+    // The outputs.
+    std::vector<int32> words;
+    std::vector<BaseFloat> conf;
+    std::vector<std::pair<BaseFloat, BaseFloat> > word_times;
+    BaseFloat bayes_risk;
+  };
+
+  CtmConfMapper(const MinimumBayesRiskOptions &mbr_opts,
+                BaseFloat lm_scale, BaseFloat acoustic_scale,
+                BaseFloat frame_shift,
+                RandomAccessInt32VectorReader *one_best_reader,
+                RandomAccessBaseFloatPairVectorReader *times_reader,
+                std::ostream &os):
+      mbr_opts_(mbr_opts), lm_scale_(lm_scale), acoustic_scale_(acoustic_scale),
+      frame_shift_(frame_shift), one_best_reader_(one_best_reader),
+      times_reader_(times_reader), os_(os), num_done_(0), num_words_(0),
+      tot_bayes_risk_(0.0) { }
+
+  bool Read(const std::string &key, CompactLattice &clat, Item *item) {
+    if (one_best_reader_->IsOpen()) {
+      // check,
+      if (!one_best_reader_->HasKey(key)) {
+        KALDI_WARN << "No 1-best present for utterance " << key;
+        return false;
+      }
+      if (times_reader_->IsOpen() && !times_reader_->HasKey(key)) {
+        KALDI_WARN << "No 'times' present for utterance " << key;
+        return false;
+      }
+      item->one_best = one_best_reader_->Value(key);
+      if (times_reader_->IsOpen())
+        item->times = times_reader_->Value(key);
+    }
+    item->clat = clat;
+    return true;
+  }
+
+  void Map(const std::string &key, Item *item) const {
+    fst::ScaleLattice(fst::LatticeScale(lm_scale_, acoustic_scale_), &item->clat);
+
+    MinimumBayesRisk *mbr = NULL;
+    if (!one_best_reader_->IsOpen()) {
+      mbr = new MinimumBayesRisk(item->clat, mbr_opts_);
+    } else if (!times_reader_->IsOpen()) {
+      mbr = new MinimumBayesRisk(item->clat, item->one_best, mbr_opts_); // no 'times',
+    } else {
+      // with initial 'times' of the bins,
+      mbr = new MinimumBayesRisk(item->clat, item->one_best, item->times, mbr_opts_);
+    }
+    item->conf = mbr->GetOneBestConfidences();
+    item->words = mbr->GetOneBest();
+    item->word_times = mbr->GetOneBestTimes();
+    item->bayes_risk = mbr->GetBayesRisk();
+    delete mbr;
+  }
+
+  void Write(const std::string &key, Item *item) {
+    const std::vector<BaseFloat> &conf = item->conf;
+    const std::vector<int32> &words = item->words;
+    const std::vector<std::pair<BaseFloat, BaseFloat> > &times = item->word_times;
+    KALDI_ASSERT(conf.size() == words.size() && words.size() == times.size());
+    for (size_t i = 0; i < words.size(); i++) {
+      KALDI_ASSERT(words[i] != 0 || mbr_opts_.print_silence); // Should not have epsilons.
+      os_ << key << " 1 " << (frame_shift_ * times[i].first) << ' '
+          << (frame_shift_ * (times[i].second-times[i].first)) << ' '
+          << words[i] << ' ' << conf[i] << '\n';
+    }
+    KALDI_LOG << "For utterance " << key << ", Bayes Risk "
+              << item->bayes_risk << ", avg. confidence per-word "
+              << std::accumulate(conf.begin(),conf.end(),0.0) / words.size();
+    num_done_++;
+    num_words_ += words.size();
+    tot_bayes_risk_ += item->bayes_risk;
+  }
+
+  int32 NumDone() const { return num_done_; }
+  int32 NumWords() const { return num_words_; }
+  BaseFloat TotBayesRisk() const { return tot_bayes_risk_; }
+
+ private:
+  const MinimumBayesRiskOptions &mbr_opts_;
+  BaseFloat lm_scale_, acoustic_scale_, frame_shift_;
+  RandomAccessInt32VectorReader *one_best_reader_;
+  RandomAccessBaseFloatPairVectorReader *times_reader_;
+  std::ostream &os_;
+  int32 num_done_, num_words_;
+  BaseFloat tot_bayes_risk_;
+};
+
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
@@ -61,6 +163,7 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 1.0, inv_acoustic_scale = 1.0, lm_scale = 1.0;
     BaseFloat frame_shift = 0.01;
     int32 confidence_digits = 2;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
 
     std::string word_syms_filename;
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for "
@@ -75,6 +178,7 @@ int main(int argc, char *argv[]) {
 
     MinimumBayesRiskOptions mbr_opts;
     mbr_opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -126,60 +230,11 @@ int main(int argc, char *argv[]) {
     // the #digits after the decimal point.
     ko.Stream().precision(confidence_digits);
 
-    int32 n_done = 0, n_words = 0;
-    BaseFloat tot_bayes_risk = 0.0;
-
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      CompactLattice clat = clat_reader.Value();
-      clat_reader.FreeCurrent();
-      fst::ScaleLattice(fst::LatticeScale(lm_scale, acoustic_scale), &clat);
-
-      MinimumBayesRisk *mbr = NULL;
-
-      if (one_best_rspecifier == "") {
-        mbr = new MinimumBayesRisk(clat, mbr_opts);
-      } else {
-        // check,
-        if (!one_best_reader.HasKey(key)) {
-          KALDI_WARN << "No 1-best present for utterance " << key;
-          continue;
-        }
-        if (times_rspecifier != "" && !times_reader.HasKey(key)) {
-          KALDI_WARN << "No 'times' present for utterance " << key;
-          continue;
-        }
-        // get the 'mbr' decoding object,
-        if (times_rspecifier == "") {
-          const std::vector<int32> &one_best = one_best_reader.Value(key);
-          mbr = new MinimumBayesRisk(clat, one_best, mbr_opts); // no 'times',
-        } else {
-          // with initial 'times' of the bins,
-          const std::vector<int32> &one_best = one_best_reader.Value(key);
-          const std::vector<std::pair<BaseFloat,BaseFloat> > &times = times_reader.Value(key);
-          mbr = new MinimumBayesRisk(clat, one_best, times, mbr_opts);
-        }
-      }
-
-      const std::vector<BaseFloat> &conf = mbr->GetOneBestConfidences();
-      const std::vector<int32> &words = mbr->GetOneBest();
-      const std::vector<std::pair<BaseFloat, BaseFloat> > &times =
-          mbr->GetOneBestTimes();
-      KALDI_ASSERT(conf.size() == words.size() && words.size() == times.size());
-      for (size_t i = 0; i < words.size(); i++) {
-        KALDI_ASSERT(words[i] != 0 || mbr_opts.print_silence); // Should not have epsilons.
-        ko.Stream() << key << " 1 " << (frame_shift * times[i].first) << ' '
-                    << (frame_shift * (times[i].second-times[i].first)) << ' '
-                    << words[i] << ' ' << conf[i] << '\n';
-      }
-      KALDI_LOG << "For utterance " << key << ", Bayes Risk "
-                << mbr->GetBayesRisk() << ", avg. confidence per-word "
-                << std::accumulate(conf.begin(),conf.end(),0.0) / words.size();
-      n_done++;
-      n_words += mbr->GetOneBest().size();
-      tot_bayes_risk += mbr->GetBayesRisk();
-      delete mbr;
-    }
+    CtmConfMapper mapper(mbr_opts, lm_scale, acoustic_scale, frame_shift,
+                         &one_best_reader, &times_reader, ko.Stream());
+    ParallelTableMap(sequencer_config, &clat_reader, &mapper);
+    int32 n_done = mapper.NumDone(), n_words = mapper.NumWords();
+    BaseFloat tot_bayes_risk = mapper.TotBayesRisk();
 
     KALDI_LOG << "Done " << n_done << " lattices.";
     KALDI_LOG << "Overall average Bayes Risk per sentence is "
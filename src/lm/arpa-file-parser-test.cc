@@ -29,6 +29,7 @@
 #include <vector>
 
 #include "base/kaldi-common.h"
+#include "base/timer.h"
 #include "fst/fstlib.h"
 #include "lm/arpa-file-parser.h"
 
@@ -37,6 +38,9 @@ namespace {
 
 const int kMaxOrder = 3;
 
+// The tests are run with options.num_threads set to this.
+int32 num_threads = 1;
+
 struct NGramTestData {
   int32 line_number;
   float logprob;
@@ -79,6 +83,7 @@ class TestableArpaFileParser : public ArpaFileParser {
         read_complete_(false),
         last_order_(0) { }
   void Validate(CountedArray<int32> counts, CountedArray<NGramTestData> ngrams);
+  const std::vector<NGramTestData> &NGrams() const { return ngrams_; }
 
  private:
   // ArpaFileParser overrides.
@@ -117,6 +122,8 @@ void TestableArpaFileParser::ConsumeNGram(const NGram& ngram) {
 void TestableArpaFileParser::ReadComplete() {
   KALDI_ASSERT(header_available_);
   KALDI_ASSERT(!read_complete_);
+  // valid with threads too, where the n-gram lines are gone by now.
+  KALDI_ASSERT(LineReference().find("\\end\\") != std::string::npos);
   read_complete_ = true;
 }
 
@@ -196,6 +203,7 @@ ngram 3=2\n\
   ArpaParseOptions options;
   options.bos_symbol = 1;
   options.eos_symbol = 2;
+  options.num_threads = num_threads;
 
   TestableArpaFileParser parser(options, NULL);
   std::istringstream stm(integer_lm, std::ios_base::in);
@@ -269,6 +277,7 @@ void ReadSymbolicLmNoOovImpl(ArpaParseOptions::OovHandling oov) {
   ArpaParseOptions options;
   options.bos_symbol = 1;
   options.eos_symbol = 2;
+  options.num_threads = num_threads;
   options.unk_symbol = 3;
   options.oov_handling = oov;
   TestableArpaFileParser parser(options, &symbols);
@@ -299,6 +308,7 @@ void ReadSymbolicLmWithOovImpl(
   ArpaParseOptions options;
   options.bos_symbol = 1;
   options.eos_symbol = 2;
+  options.num_threads = num_threads;
   options.unk_symbol = 3;
   options.oov_handling = oov;
   TestableArpaFileParser parser(options, symbols);
@@ -362,11 +372,58 @@ void ReadSymbolicLmWithOovTests() {
   ReadSymbolicLmWithOovSkipNGram();
 }
 
+// Reads an integer LM large enough to be parsed in several chunks with and
+// without threads, and compares the n-grams.
+void ReadLargeIntegerLmThreaded() {
+  KALDI_LOG << "ReadLargeIntegerLmThreaded()";
+  const int32 num_unigrams = 120000, num_bigrams = 60000;
+  std::ostringstream os;
+  os << "\\data\\\nngram 1=" << num_unigrams << "\nngram 2=" << num_bigrams
+     << "\n\n\\1-grams:\n";
+  for (int32 i = 1; i <= num_unigrams; i++)
+    os << -RandUniform() * 5 << "\t" << i << "\t" << -RandUniform() << "\n";
+  os << "\n\\2-grams:\n";
+  for (int32 i = 1; i <= num_bigrams; i++)
+    os << -RandUniform() << "\t" << i << " " << (i + 1) << "\n";
+  os << "\n\\end\\\n";
+
+  ArpaParseOptions options;
+  options.bos_symbol = 1;
+  options.eos_symbol = 2;
+  TestableArpaFileParser serial_parser(options, NULL);
+  std::istringstream serial_stm(os.str(), std::ios_base::in);
+  Timer timer;
+  serial_parser.Read(serial_stm);
+  double serial_time = timer.Elapsed();
+  options.num_threads = 4;
+  TestableArpaFileParser threaded_parser(options, NULL);
+  std::istringstream threaded_stm(os.str(), std::ios_base::in);
+  timer.Reset();
+  threaded_parser.Read(threaded_stm);
+  KALDI_LOG << "Read with 1 thread took " << serial_time << "s, with "
+            << options.num_threads << " threads " << timer.Elapsed() << "s";
+
+  const std::vector<NGramTestData> &serial = serial_parser.NGrams(),
+      &threaded = threaded_parser.NGrams();
+  KALDI_ASSERT(serial.size() == num_unigrams + num_bigrams &&
+               threaded.size() == serial.size());
+  for (size_t i = 0; i < serial.size(); i++)
+    KALDI_ASSERT(threaded[i].line_number == serial[i].line_number &&
+                 threaded[i].logprob == serial[i].logprob &&
+                 threaded[i].backoff == serial[i].backoff &&
+                 std::equal(serial[i].words, serial[i].words + kMaxOrder,
+                            threaded[i].words));
+}
+
 }  // namespace
 }  // namespace kaldi
 
 int main(int argc, char *argv[]) {
-  kaldi::ReadIntegerLmLogconvExpectSuccess();
-  kaldi::ReadSymbolicLmNoOovTests();
-  kaldi::ReadSymbolicLmWithOovTests();
+  for (int32 num_threads = 1; num_threads <= 3; num_threads += 2) {
+    kaldi::num_threads = num_threads;
+    kaldi::ReadIntegerLmLogconvExpectSuccess();
+    kaldi::ReadSymbolicLmNoOovTests();
+    kaldi::ReadSymbolicLmWithOovTests();
+  }
+  kaldi::ReadLargeIntegerLmThreaded();
 }
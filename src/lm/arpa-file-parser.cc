@@ -20,19 +20,86 @@
 
 #include <fst/fstlib.h>
 
+#include <memory>
 #include <sstream>
 
 #include "base/kaldi-error.h"
 #include "base/kaldi-math.h"
 #include "lm/arpa-file-parser.h"
+#include "util/kaldi-thread.h"
 #include "util/text-utils.h"
 
 namespace kaldi {
 
+// The number of n-gram lines parsed in a task with options.num_threads > 1.
+static const size_t kArpaChunkLines = 50000;
+
+// A chunk of n-gram lines of one order, for the TaskSequencer in
+// ArpaFileParser::Read(): operator () parses them, and the destructor, which
+// is called in the order of the chunks, passes them on to the parser.
+class ArpaNGramChunk {
+ public:
+  ArpaNGramChunk(ArpaFileParser *parser, int32 order, std::string *error):
+      parser_(parser), order_(order), error_(error), failed_(false) { }
+
+  void AddLine(int32 line_number, const std::string &line) {
+    line_numbers_.push_back(line_number);
+    lines_.push_back(line);
+  }
+
+  size_t NumLines() const { return lines_.size(); }
+
+  void operator () () {
+    ngrams_.resize(lines_.size());
+    keep_.resize(lines_.size());
+    oovs_.resize(lines_.size());
+    try {
+      for (size_t i = 0; i < lines_.size(); i++)
+        keep_[i] = parser_->ParseNGram(line_numbers_[i], lines_[i], order_,
+                                       &(ngrams_[i]), &(oovs_[i]));
+    } catch (const std::exception &e) {
+      failed_ = true;
+      what_ = e.what();
+    }
+  }
+
+  ~ArpaNGramChunk() {
+    // Once a chunk has failed, the later ones are dropped; so is a chunk that
+    // never ran, because Read() threw before handing it to the sequencer.
+    if (!error_->empty() || keep_.size() != lines_.size())
+      return;
+    if (failed_) {
+      *error_ = what_;
+      return;
+    }
+    try {
+      for (size_t i = 0; i < lines_.size(); i++)
+        parser_->ConsumeParsedNGram(line_numbers_[i], lines_[i],
+                                    keep_[i] ? &(ngrams_[i]) : NULL,
+                                    oovs_[i]);
+    } catch (const std::exception &e) {
+      *error_ = e.what();
+    }
+  }
+
+ private:
+  ArpaFileParser *parser_;
+  int32 order_;
+  std::string *error_;  // the first error, shared by the chunks.
+  bool failed_;
+  std::string what_;
+  std::vector<int32> line_numbers_;
+  std::vector<std::string> lines_;
+  std::vector<NGram> ngrams_;
+  std::vector<bool> keep_;
+  std::vector<std::string> oovs_;
+};
+
 ArpaFileParser::ArpaFileParser(ArpaParseOptions options,
                                fst::SymbolTable* symbols)
     : options_(options), symbols_(symbols),
-      line_number_(0), warning_count_(0) {
+      line_number_(0), ngram_line_number_(0), ngram_line_(&current_line_),
+      warning_count_(0) {
 }
 
 ArpaFileParser::~ArpaFileParser() {
@@ -74,7 +141,8 @@ void ArpaFileParser::Read(std::istream &is) {
   warning_count_ = 0;
   current_line_.clear();
 
-#define PARSE_ERR (KALDI_ERR << LineReference() << ": ")
+#define PARSE_ERR (KALDI_ERR << LineReference(line_number_, current_line_) \
+                   << ": ")
 
   // Give derived class an opportunity to prepare its state.
   ReadStarted();
@@ -118,7 +186,7 @@ void ArpaFileParser::Read(std::istream &is) {
       }
       ngram_counts_[order - 1] = ngram_count;
     } else {
-      KALDI_WARN << LineReference()
+      KALDI_WARN << LineReference(line_number_, current_line_)
                  << ": uninterpretable line in \\data\\ section";
     }
   }
@@ -131,6 +199,20 @@ void ArpaFileParser::Read(std::istream &is) {
 
   NGram ngram;
   ngram.words.reserve(ngram_counts_.size());
+  std::string oov;
+
+  // With more than one thread, the n-gram lines go to the sequencer in
+  // chunks, and <thread_error> gets the first error.
+  bool threaded = (options_.num_threads > 1 &&
+                   !(symbols_ != NULL &&
+                     options_.oov_handling == ArpaParseOptions::kAddToSymbols));
+  TaskSequencerConfig sequencer_config;
+  sequencer_config.num_threads = options_.num_threads;
+  TaskSequencer<ArpaNGramChunk> sequencer(sequencer_config);
+  // The chunk being filled is owned here until the sequencer takes it, so it
+  // is not leaked if PARSE_ERR throws.
+  std::unique_ptr<ArpaNGramChunk> chunk;
+  std::string thread_error;
 
   // Processes "\N-grams:" section.
   for (int32 cur_order = 1; cur_order <= ngram_counts_.size(); ++cur_order) {
@@ -176,73 +258,22 @@ void ArpaFileParser::Read(std::istream &is) {
         }
       }
 
-      std::vector<std::string> col;
-      SplitStringToVector(current_line_, " \t", true, &col);
-
-      if (col.size() < 1 + cur_order ||
-          col.size() > 2 + cur_order ||
-          (cur_order == ngram_counts_.size() && col.size() != 1 + cur_order)) {
-        PARSE_ERR << "Invalid n-gram data line";
-      }
       ++ngram_count;
-
-      // Parse out n-gram logprob and, if present, backoff weight.
-      if (!ConvertStringToReal(col[0], &ngram.logprob)) {
-        PARSE_ERR << "invalid n-gram logprob '" << col[0] << "'";
-      }
-      ngram.backoff = 0.0;
-      if (col.size() > cur_order + 1) {
-        if (!ConvertStringToReal(col[cur_order + 1], &ngram.backoff))
-          PARSE_ERR << "invalid backoff weight '" << col[cur_order + 1] << "'";
-      }
-      // Convert to natural log.
-      ngram.logprob *= M_LN10;
-      ngram.backoff *= M_LN10;
-
-      ngram.words.resize(cur_order);
-      bool skip_ngram = false;
-      for (int32 index = 0; !skip_ngram && index < cur_order; ++index) {
-        int32 word;
-        if (symbols_) {
-          // Symbol table provided, so symbol labels are expected.
-          if (options_.oov_handling == ArpaParseOptions::kAddToSymbols) {
-            word = symbols_->AddSymbol(col[1 + index]);
-          } else {
-            word = symbols_->Find(col[1 + index]);
-            if (word == -1) { // fst::kNoSymbol
-              switch (options_.oov_handling) {
-                case ArpaParseOptions::kReplaceWithUnk:
-                  word = options_.unk_symbol;
-                  break;
-                case ArpaParseOptions::kSkipNGram:
-                  if (ShouldWarn())
-                    KALDI_WARN << LineReference() << " skipped: word '"
-                               << col[1 + index] << "' not in symbol table";
-                  skip_ngram = true;
-                  break;
-                default:
-                  PARSE_ERR << "word '"  << col[1 + index]
-                            << "' not in symbol table";
-              }
-            }
-          }
-        } else {
-          // Symbols not provided, LM file should contain integers.
-          if (!ConvertStringToInteger(col[1 + index], &word) || word < 0) {
-            PARSE_ERR << "invalid symbol '" << col[1 + index] << "'";
-          }
-        }
-        // Whichever way we got it, an epsilon is invalid.
-        if (word == 0) {
-          PARSE_ERR << "epsilon symbol '" << col[1 + index]
-                    << "' is illegal in ARPA LM";
-        }
-        ngram.words[index] = word;
-      }
-      if (!skip_ngram) {
-        ConsumeNGram(ngram);
+      if (threaded) {
+        if (chunk == NULL)
+          chunk.reset(new ArpaNGramChunk(this, cur_order, &thread_error));
+        chunk->AddLine(line_number_, current_line_);
+        if (chunk->NumLines() == kArpaChunkLines)
+          sequencer.Run(chunk.release());
+        continue;
       }
+      bool keep = ParseNGram(line_number_, current_line_, cur_order, &ngram,
+                             &oov);
+      ConsumeParsedNGram(line_number_, current_line_, keep ? &ngram : NULL,
+                         oov);
     }
+    if (chunk != NULL)
+      sequencer.Run(chunk.release());
     if (ngram_count > ngram_counts_[cur_order - 1]) {
       PARSE_ERR << "header said there would be " << ngram_counts_[cur_order - 1]
                 << " n-grams of order " << cur_order
@@ -254,6 +285,12 @@ void ArpaFileParser::Read(std::istream &is) {
     PARSE_ERR << "invalid or unexpected directive line, expecting \\end\\";
   }
 
+  sequencer.Wait();
+  // ngram_line_ pointed into the lines of a chunk, which are gone now.
+  ngram_line_ = &current_line_;
+  if (!thread_error.empty())
+    KALDI_ERR << thread_error;
+
   if (warning_count_ > 0 &&
       warning_count_ > static_cast<uint32>(options_.max_warnings)) {
     KALDI_WARN << "Of " << warning_count_ << " parse warnings, "
@@ -267,12 +304,97 @@ void ArpaFileParser::Read(std::istream &is) {
 #undef PARSE_ERR
 }
 
-std::string ArpaFileParser::LineReference() const {
+bool ArpaFileParser::ParseNGram(int32 line_number, const std::string &line,
+                                int32 order, NGram *ngram,
+                                std::string *oov) const {
+#define PARSE_ERR (KALDI_ERR << LineReference(line_number, line) << ": ")
+  std::vector<std::string> col;
+  SplitStringToVector(line, " \t", true, &col);
+
+  if (col.size() < 1 + order ||
+      col.size() > 2 + order ||
+      (order == ngram_counts_.size() && col.size() != 1 + order)) {
+    PARSE_ERR << "Invalid n-gram data line";
+  }
+
+  // Parse out n-gram logprob and, if present, backoff weight.
+  if (!ConvertStringToReal(col[0], &ngram->logprob)) {
+    PARSE_ERR << "invalid n-gram logprob '" << col[0] << "'";
+  }
+  ngram->backoff = 0.0;
+  if (col.size() > order + 1) {
+    if (!ConvertStringToReal(col[order + 1], &ngram->backoff))
+      PARSE_ERR << "invalid backoff weight '" << col[order + 1] << "'";
+  }
+  // Convert to natural log.
+  ngram->logprob *= M_LN10;
+  ngram->backoff *= M_LN10;
+
+  ngram->words.resize(order);
+  for (int32 index = 0; index < order; ++index) {
+    int32 word;
+    if (symbols_) {
+      // Symbol table provided, so symbol labels are expected.
+      if (options_.oov_handling == ArpaParseOptions::kAddToSymbols) {
+        word = symbols_->AddSymbol(col[1 + index]);
+      } else {
+        word = symbols_->Find(col[1 + index]);
+        if (word == -1) { // fst::kNoSymbol
+          switch (options_.oov_handling) {
+            case ArpaParseOptions::kReplaceWithUnk:
+              word = options_.unk_symbol;
+              break;
+            case ArpaParseOptions::kSkipNGram:
+              *oov = col[1 + index];
+              return false;
+            default:
+              PARSE_ERR << "word '"  << col[1 + index]
+                        << "' not in symbol table";
+          }
+        }
+      }
+    } else {
+      // Symbols not provided, LM file should contain integers.
+      if (!ConvertStringToInteger(col[1 + index], &word) || word < 0) {
+        PARSE_ERR << "invalid symbol '" << col[1 + index] << "'";
+      }
+    }
+    // Whichever way we got it, an epsilon is invalid.
+    if (word == 0) {
+      PARSE_ERR << "epsilon symbol '" << col[1 + index]
+                << "' is illegal in ARPA LM";
+    }
+    ngram->words[index] = word;
+  }
+  return true;
+#undef PARSE_ERR
+}
+
+void ArpaFileParser::ConsumeParsedNGram(int32 line_number,
+                                        const std::string &line,
+                                        const NGram *ngram,
+                                        const std::string &oov) {
+  ngram_line_number_ = line_number;
+  ngram_line_ = &line;
+  if (ngram != NULL) {
+    ConsumeNGram(*ngram);
+  } else if (ShouldWarn()) {
+    KALDI_WARN << LineReference() << " skipped: word '" << oov
+               << "' not in symbol table";
+  }
+}
+
+std::string ArpaFileParser::LineReference(int32 line_number,
+                                          const std::string &line) {
   std::stringstream ss;
-  ss << "line " << line_number_ << " [" << current_line_ << "]";
+  ss << "line " << line_number << " [" << line << "]";
   return ss.str();
 }
 
+std::string ArpaFileParser::LineReference() const {
+  return LineReference(ngram_line_number_, *ngram_line_);
+}
+
 bool ArpaFileParser::ShouldWarn() {
   return ++warning_count_ <= static_cast<uint32>(options_.max_warnings);
 }
@@ -23,6 +23,7 @@
 
 #include <fst/fst-decl.h>
 
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -44,7 +45,7 @@ struct ArpaParseOptions {
 
   ArpaParseOptions():
       bos_symbol(-1), eos_symbol(-1), unk_symbol(-1),
-      oov_handling(kRaiseError), max_warnings(30) { }
+      oov_handling(kRaiseError), max_warnings(30), num_threads(1) { }
 
   void Register(OptionsItf *opts) {
     // Registering only the max_warnings count, since other options are
@@ -53,6 +54,9 @@ struct ArpaParseOptions {
     opts->Register("max-arpa-warnings", &max_warnings,
                    "Maximum warnings to report on ARPA parsing, "
                    "0 to disable, -1 to show all");
+    opts->Register("num-arpa-threads", &num_threads,
+                   "Number of threads to parse the n-gram lines with; the "
+                   "n-grams are still compiled in one thread, in file order.");
   }
 
   int32 bos_symbol;  ///< Symbol for <s>, Required non-epsilon.
@@ -60,6 +64,7 @@ struct ArpaParseOptions {
   int32 unk_symbol;  ///< Symbol for <unk>, Required for kReplaceWithUnk.
   OovHandling oov_handling;  ///< How to handle OOV words in the file.
   int32 max_warnings;  ///< Maximum warnings to report, <0 unlimited.
+  int32 num_threads;  ///< Threads to parse n-gram lines with, if > 1.
 };
 
 /**
@@ -73,10 +78,19 @@ struct NGram {
                              ///< Defaults to zero if not specified.
 };
 
+class ArpaNGramChunk;
+
 /**
     ArpaFileParser is an abstract base class for ARPA LM file conversion.
 
     See ConstArpaLmBuilder and ArpaLmCompiler for usage examples.
+
+    With options.num_threads > 1, the n-gram sections are read in chunks of
+    lines that are parsed (split, converted and looked up in the symbol
+    table, which is only read) in a TaskSequencer, while ConsumeNGram() is
+    called for the results one n-gram at a time, in file order, as before,
+    though not from the thread that called Read().  Reading with
+    kAddToSymbols, which changes the symbol table, is not threaded.
 */
 class ArpaFileParser {
  public:
@@ -119,7 +133,7 @@ class ArpaFileParser {
   const fst::SymbolTable* Symbols() const { return symbols_; }
 
   /// Inside ConsumeNGram(), provides the current line number.
-  int32 LineNumber() const { return line_number_; }
+  int32 LineNumber() const { return ngram_line_number_; }
 
   /// Inside ConsumeNGram(), returns a formatted reference to the line being
   /// compiled, to print out as part of diagnostics.
@@ -133,11 +147,33 @@ class ArpaFileParser {
   const std::vector<int32>& NgramCounts() const { return ngram_counts_; }
 
  private:
+  friend class ArpaNGramChunk;
+
+  static std::string LineReference(int32 line_number,
+                                   const std::string &line);
+
+  /// Parses the n-gram line <line> (at <line_number>, for the errors) of
+  /// order <order> into <ngram>.  Returns false if the n-gram is to be
+  /// skipped for the OOV word <oov>; throws on errors.  Does not change the
+  /// parser, so that threads can call it at once (but with kAddToSymbols).
+  bool ParseNGram(int32 line_number, const std::string &line, int32 order,
+                  NGram *ngram, std::string *oov) const;
+
+  /// Consumes the n-gram that ParseNGram() parsed from <line>, or warns that
+  /// it is skipped if <ngram> is NULL.
+  void ConsumeParsedNGram(int32 line_number, const std::string &line,
+                          const NGram *ngram, const std::string &oov);
+
   ArpaParseOptions options_;
   fst::SymbolTable* symbols_;  // the pointer is not owned here.
+  // The position of the reading.
   int32 line_number_;
-  uint32 warning_count_;
   std::string current_line_;
+  // The line of the n-gram being consumed, for LineNumber() and
+  // LineReference().
+  int32 ngram_line_number_;
+  const std::string *ngram_line_;
+  std::atomic<uint32> warning_count_;
   std::vector<int32> ngram_counts_;
 };
 
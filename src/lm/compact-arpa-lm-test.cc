@@ -0,0 +1,224 @@
+// lm/compact-arpa-lm-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <set>
+#include <sstream>
+
+#include "base/kaldi-math.h"
+#include "base/timer.h"
+#include "lm/compact-arpa-lm.h"
+#include "util/kaldi-io.h"
+
+namespace kaldi {
+
+// Word ids: <s> = 1, </s> = 2, <unk> = 3, other words from 4 on.
+static const int32 kBos = 1, kEos = 2, kUnk = 3;
+
+// Writes a random 4-gram ARPA file with integer words, in which every
+// n-gram's history is itself an n-gram.
+static void WriteRandomArpa(int32 num_words, const std::string &filename) {
+  std::vector<std::vector<std::vector<int32> > > ngrams(5);
+  std::set<std::vector<int32> > seen;
+  for (int32 n = 2; n <= 4; n++) {
+    for (int32 i = 0; i < 4 * num_words; i++) {
+      std::vector<int32> ngram;
+      if (n == 2)
+        ngram.push_back(i % 5 == 0 ? kBos : RandInt(kEos + 1, num_words - 1));
+      else
+        ngram = ngrams[n - 1][RandInt(0, ngrams[n - 1].size() - 1)];
+      if (ngram.back() == kEos) continue;
+      ngram.push_back(RandInt(kEos, num_words - 1));
+      if (seen.insert(ngram).second) ngrams[n].push_back(ngram);
+    }
+  }
+
+  Output ko(filename, false);
+  std::ostream &os = ko.Stream();
+  os << "\\data\\\nngram 1=" << num_words - 1;
+  for (int32 n = 2; n <= 4; n++)
+    os << "\nngram " << n << "=" << ngrams[n].size();
+  os << "\n\n\\1-grams:\n";
+  for (int32 w = 1; w < num_words; w++)
+    os << (w == kBos ? -99.0 : -RandUniform() * 5) << "\t" << w << "\t"
+       << -RandUniform() << "\n";
+  for (int32 n = 2; n <= 4; n++) {
+    os << "\n\\" << n << "-grams:\n";
+    for (size_t i = 0; i < ngrams[n].size(); i++) {
+      os << -RandUniform() * 3 << "\t";
+      for (int32 j = 0; j < n; j++)
+        os << ngrams[n][i][j] << (j + 1 < n ? " " : "");
+      // some histories have no backoff.
+      if (n < 4 && i % 3 != 0)
+        os << "\t" << -RandUniform();
+      os << "\n";
+    }
+  }
+  os << "\n\\end\\\n";
+}
+
+static void RandomQuery(int32 num_words, std::vector<int32> *hist,
+                        int32 *word) {
+  hist->resize(RandInt(0, 4));
+  for (size_t j = 0; j < hist->size(); j++)
+    (*hist)[j] = RandInt(kBos, num_words + 5);  // includes OOVs
+  *word = RandInt(kEos, num_words + 5);
+}
+
+void UnitTestCompactArpaLm() {
+  int32 num_words = RandInt(10, 300);
+  std::string arpa = "tmp-compact-arpa-lm-test.arpa",
+      const_arpa_file = "tmp-compact-arpa-lm-test.carpa",
+      compact_file = "tmp-compact-arpa-lm-test.compact";
+  WriteRandomArpa(num_words, arpa);
+
+  ArpaParseOptions options;
+  options.bos_symbol = kBos;
+  options.eos_symbol = kEos;
+  options.unk_symbol = (Rand() % 2 == 0 ? kUnk : -1);
+  BuildConstArpaLm(options, arpa, const_arpa_file, false);
+  ConstArpaLm const_arpa;
+  ReadKaldiObject(const_arpa_file, &const_arpa);
+
+  // With 16 bits every value of these small models gets its own bin.
+  CompactArpaLmOptions opts;
+  opts.prob_bits = 16;
+  opts.backoff_bits = 16;
+  CompactArpaLm exact(opts, const_arpa);
+  opts.prob_bits = 8;
+  opts.backoff_bits = RandInt(4, 8);
+  CompactArpaLm quantized(opts, const_arpa);
+  WriteKaldiObject(quantized, compact_file, (Rand() % 2 == 0));
+  CompactArpaLm quantized_read;
+  ReadKaldiObject(compact_file, &quantized_read);
+  KALDI_ASSERT(exact.MemorySize() > quantized.MemorySize());
+
+  // The empty history is the unigram state, even in a model not read yet.
+  std::vector<int32> empty_hist;
+  KALDI_ASSERT(const_arpa.HistoryStateExists(empty_hist) &&
+               exact.HistoryStateExists(empty_hist) &&
+               quantized_read.HistoryStateExists(empty_hist));
+  KALDI_ASSERT(CompactArpaLm().HistoryStateExists(empty_hist) ==
+               ConstArpaLm().HistoryStateExists(empty_hist));
+
+  double max_error = 0.0;
+  for (int32 i = 0; i < 2000; i++) {
+    std::vector<int32> hist;
+    int32 word;
+    RandomQuery(num_words, &hist, &word);
+    float logprob = const_arpa.GetNgramLogprob(word, hist),
+        exact_logprob = exact.GetNgramLogprob(word, hist),
+        quantized_logprob = quantized.GetNgramLogprob(word, hist);
+    if (const_arpa.GetNgramLogprob(word, std::vector<int32>()) ==
+        std::numeric_limits<float>::min()) {
+      // An OOV without <unk>.  (ConstArpaLm returns the backoffs plus that
+      // minimum, so compare with the unigram.)
+      KALDI_ASSERT(exact_logprob == std::numeric_limits<float>::min() &&
+                   quantized_logprob == exact_logprob);
+    } else {
+      KALDI_ASSERT(std::abs(exact_logprob - logprob) < 1.0e-04);
+      max_error = std::max<double>(max_error,
+                                   std::abs(quantized_logprob - logprob));
+    }
+    // (text mode does not keep all the digits.)
+    KALDI_ASSERT(std::abs(quantized_read.GetNgramLogprob(word, hist) -
+                          quantized_logprob) < 1.0e-04);
+    KALDI_ASSERT(exact.HistoryStateExists(hist) ==
+                 const_arpa.HistoryStateExists(hist));
+    KALDI_ASSERT(quantized_read.HistoryStateExists(hist) ==
+                 const_arpa.HistoryStateExists(hist));
+  }
+  // the errors of up to three backoffs and a probability.
+  KALDI_ASSERT(max_error < 0.2);
+
+  // The FST wrappers agree along a random sequence of words of the model.
+  ConstArpaLmDeterministicFst const_arpa_fst(const_arpa);
+  CompactArpaLmDeterministicFst compact_fst(exact);
+  fst::StdArc::StateId s = const_arpa_fst.Start(), t = compact_fst.Start();
+  for (int32 i = 0; i < 50; i++) {
+    int32 word = RandInt(kEos + 1, num_words - 1);
+    fst::StdArc arc, compact_arc;
+    bool ans = const_arpa_fst.GetArc(s, word, &arc);
+    KALDI_ASSERT(compact_fst.GetArc(t, word, &compact_arc) == ans);
+    if (!ans) continue;
+    KALDI_ASSERT(ApproxEqual(arc.weight.Value(), compact_arc.weight.Value(),
+                             1.0e-04));
+    s = arc.nextstate;
+    t = compact_arc.nextstate;
+    KALDI_ASSERT(ApproxEqual(const_arpa_fst.Final(s).Value(),
+                             compact_fst.Final(t).Value(), 1.0e-04));
+  }
+
+  std::remove(arpa.c_str());
+  std::remove(const_arpa_file.c_str());
+  std::remove(compact_file.c_str());
+}
+
+// Compares the memory and the lookup speed with ConstArpaLm on a larger model.
+void CompactArpaLmBenchmark() {
+  int32 num_words = 20000;
+  std::string arpa = "tmp-compact-arpa-lm-test.arpa",
+      const_arpa_file = "tmp-compact-arpa-lm-test.carpa";
+  WriteRandomArpa(num_words, arpa);
+  ArpaParseOptions options;
+  options.bos_symbol = kBos;
+  options.eos_symbol = kEos;
+  options.unk_symbol = kUnk;
+  BuildConstArpaLm(options, arpa, const_arpa_file, false);
+  ConstArpaLm const_arpa;
+  ReadKaldiObject(const_arpa_file, &const_arpa);
+  CompactArpaLmOptions opts;
+  CompactArpaLm compact(opts, const_arpa);
+
+  // Random queries, so most of them back off.
+  std::vector<std::vector<int32> > hists(100000);
+  std::vector<int32> words(hists.size());
+  for (size_t i = 0; i < hists.size(); i++)
+    RandomQuery(num_words, &(hists[i]), &(words[i]));
+
+  double sum = 0.0;
+  Timer timer;
+  for (size_t i = 0; i < hists.size(); i++)
+    sum += const_arpa.GetNgramLogprob(words[i], hists[i]);
+  double const_arpa_time = timer.Elapsed();
+  timer.Reset();
+  for (size_t i = 0; i < hists.size(); i++)
+    sum -= compact.GetNgramLogprob(words[i], hists[i]);
+  double compact_time = timer.Elapsed();
+
+  KALDI_LOG << "ConstArpaLm: " << const_arpa.MemorySize() << " bytes, "
+            << (const_arpa_time * 1.0e+09 / hists.size()) << " ns per lookup; "
+            << "CompactArpaLm: " << compact.MemorySize() << " bytes, "
+            << (compact_time * 1.0e+09 / hists.size()) << " ns per lookup "
+            << "(difference of the sums " << sum << ")";
+  KALDI_ASSERT(compact.MemorySize() < const_arpa.MemorySize());
+
+  std::remove(arpa.c_str());
+  std::remove(const_arpa_file.c_str());
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 10; i++)
+    kaldi::UnitTestCompactArpaLm();
+  kaldi::CompactArpaLmBenchmark();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,512 @@
+// lm/compact-arpa-lm.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+
+#include "lm/compact-arpa-lm.h"
+
+namespace kaldi {
+
+// The log-probability of the words that are not unigrams of the language
+// model; real log-probabilities are never positive.
+static const float kNoUnigram = 1.0;
+
+// Returns the number of bits needed to store the numbers 0 ... n.
+static int32 NumBits(uint64 n) {
+  int32 ans = 1;
+  while (ans < 64 && (n >> ans) != 0)
+    ans++;
+  return ans;
+}
+
+static inline uint64 ReadBits(const uint64 *data, uint64 bit,
+                              int32 num_bits) {
+  const uint64 *p = data + (bit >> 6);
+  int32 shift = bit & 63;
+  uint64 value = p[0] >> shift;
+  if (shift + num_bits > 64)
+    value |= p[1] << (64 - shift);
+  return value & ((static_cast<uint64>(1) << num_bits) - 1);
+}
+
+static void WriteBits(uint64 value, uint64 bit, int32 num_bits,
+                      std::vector<uint64> *data) {
+  KALDI_ASSERT(num_bits < 64 && (value >> num_bits) == 0);
+  uint64 *p = &((*data)[bit >> 6]);
+  int32 shift = bit & 63;
+  p[0] |= value << shift;
+  if (shift + num_bits > 64)
+    p[1] |= value >> (64 - shift);
+}
+
+// Makes a codebook of at most <num_bins> values for <values> (which it sorts):
+// the means of bins of sorted values of equal size.
+static void MakeCodebook(int32 num_bins, std::vector<float> *values,
+                         std::vector<float> *codebook) {
+  std::sort(values->begin(), values->end());
+  codebook->clear();
+  size_t n = values->size();
+  for (int32 b = 0; b < num_bins; b++) {
+    size_t begin = n * b / num_bins, end = n * (b + 1) / num_bins;
+    if (begin == end)
+      continue;
+    double sum = 0.0;
+    for (size_t i = begin; i < end; i++)
+      sum += (*values)[i];
+    codebook->push_back(sum / (end - begin));
+  }
+  SortAndUniq(codebook);
+}
+
+// Returns the index of the value in <codebook> (sorted) nearest to <value>.
+static uint64 Quantize(const std::vector<float> &codebook, float value) {
+  KALDI_ASSERT(!codebook.empty());
+  std::vector<float>::const_iterator iter =
+      std::lower_bound(codebook.begin(), codebook.end(), value);
+  if (iter == codebook.end())
+    return codebook.size() - 1;
+  if (iter != codebook.begin() && value - *(iter - 1) < *iter - value)
+    --iter;
+  return iter - codebook.begin();
+}
+
+// Builds a CompactArpaLm in two passes over the n-grams of a ConstArpaLm: the
+// first counts them and collects the values to quantize, the second writes the
+// records.  Because the n-grams come in lexicographic order, the n-grams of
+// each order come sorted, and the children of an n-gram are the next ones
+// written at the order above.
+class CompactArpaLmBuilder: public ConstArpaLmVisitor {
+ public:
+  CompactArpaLmBuilder(const CompactArpaLmOptions &opts, CompactArpaLm *lm):
+      opts_(opts), lm_(lm), second_pass_(false) { }
+
+  void Build(const ConstArpaLm &const_arpa) {
+    KALDI_ASSERT(opts_.prob_bits >= 1 && opts_.prob_bits <= 24 &&
+                 opts_.backoff_bits >= 1 && opts_.backoff_bits <= 24);
+    int32 order = const_arpa.NgramOrder();
+    lm_->bos_symbol_ = const_arpa.BosSymbol();
+    lm_->eos_symbol_ = const_arpa.EosSymbol();
+    lm_->unk_symbol_ = const_arpa.UnkSymbol();
+    lm_->ngram_order_ = order;
+    lm_->num_words_ = 0;
+    lm_->prob_bits_ = opts_.prob_bits;
+    lm_->backoff_bits_ = opts_.backoff_bits;
+    counts_.assign(order + 1, 0);
+    probs_.resize(order + 1);
+    backoffs_.resize(order + 1);
+
+    const_arpa.VisitNgrams(this);
+
+    lm_->word_bits_ = NumBits(lm_->num_words_);
+    lm_->unigram_logprob_.assign(lm_->num_words_, kNoUnigram);
+    lm_->unigram_backoff_logprob_.assign(lm_->num_words_, 0.0);
+    if (order > 1)
+      lm_->unigram_children_.assign(lm_->num_words_ + 1, -1);
+    else
+      lm_->unigram_children_.clear();
+    lm_->levels_.resize(order - 1);
+    for (int32 n = 2; n <= order; n++) {
+      CompactArpaLm::Level &level = lm_->levels_[n - 2];
+      level.num_ngrams = counts_[n];
+      level.pointer_bits = (n < order ? NumBits(counts_[n + 1]) : 0);
+      level.record_bits = lm_->word_bits_ + opts_.prob_bits +
+          (n < order ? opts_.backoff_bits + level.pointer_bits : 0);
+      MakeCodebook(1 << opts_.prob_bits, &probs_[n], &level.prob_codebook);
+      level.backoff_codebook.clear();
+      if (n < order) {
+        // the zero backoffs (of n-grams that are not histories) are kept exact.
+        std::vector<float> nonzero;
+        for (size_t i = 0; i < backoffs_[n].size(); i++)
+          if (backoffs_[n][i] != 0.0)
+            nonzero.push_back(backoffs_[n][i]);
+        MakeCodebook((1 << opts_.backoff_bits) - 1, &nonzero,
+                     &level.backoff_codebook);
+        level.backoff_codebook.push_back(0.0);
+        SortAndUniq(&level.backoff_codebook);
+      }
+      // one more record for the end of the children, and one more word so
+      // that ReadBits() can always read two.
+      uint64 num_records = level.num_ngrams + (n < order ? 1 : 0);
+      level.bits.assign((num_records * level.record_bits + 63) / 64 + 1, 0);
+      std::vector<float>().swap(probs_[n]);
+      std::vector<float>().swap(backoffs_[n]);
+    }
+
+    second_pass_ = true;
+    counts_.assign(order + 2, 0);
+    const_arpa.VisitNgrams(this);
+
+    for (int32 n = 2; n < order; n++)
+      WritePointer(n, counts_[n], counts_[n + 1]);
+    if (order > 1) {
+      // the words that are not in the language model have no children.
+      std::vector<int64> &children = lm_->unigram_children_;
+      children[lm_->num_words_] = counts_[2];
+      for (int32 w = lm_->num_words_ - 1; w >= 0; w--)
+        if (children[w] == -1)
+          children[w] = children[w + 1];
+    }
+    lm_->initialized_ = true;
+  }
+
+  virtual void Visit(const std::vector<int32> &words, float logprob,
+                     float backoff_logprob) {
+    int32 n = words.size(), word = words.back(), order = lm_->ngram_order_;
+    KALDI_ASSERT(n >= 1 && n <= order && word >= 0);
+    if (!second_pass_) {
+      counts_[n]++;
+      if (n == 1) {
+        lm_->num_words_ = std::max(lm_->num_words_, word + 1);
+      } else {
+        probs_[n].push_back(logprob);
+        if (n < order)
+          backoffs_[n].push_back(backoff_logprob);
+      }
+      return;
+    }
+    if (n == 1) {
+      lm_->unigram_logprob_[word] = logprob;
+      lm_->unigram_backoff_logprob_[word] = backoff_logprob;
+      if (order > 1)
+        lm_->unigram_children_[word] = counts_[2];
+    } else {
+      CompactArpaLm::Level &level = lm_->levels_[n - 2];
+      uint64 bit = counts_[n] * level.record_bits;
+      WriteBits(word, bit, lm_->word_bits_, &level.bits);
+      bit += lm_->word_bits_;
+      WriteBits(Quantize(level.prob_codebook, logprob), bit, opts_.prob_bits,
+                &level.bits);
+      if (n < order) {
+        bit += opts_.prob_bits;
+        WriteBits(Quantize(level.backoff_codebook, backoff_logprob), bit,
+                  opts_.backoff_bits, &level.bits);
+        WritePointer(n, counts_[n], counts_[n + 1]);
+      }
+    }
+    counts_[n]++;
+  }
+
+ private:
+  void WritePointer(int32 n, int64 index, int64 pointer) {
+    CompactArpaLm::Level &level = lm_->levels_[n - 2];
+    uint64 bit = index * level.record_bits + level.record_bits -
+        level.pointer_bits;
+    WriteBits(pointer, bit, level.pointer_bits, &level.bits);
+  }
+
+  const CompactArpaLmOptions &opts_;
+  CompactArpaLm *lm_;
+  bool second_pass_;
+  // The number of n-grams of each order seen so far.
+  std::vector<int64> counts_;
+  // The values of each order to make the codebooks from, in the first pass.
+  std::vector<std::vector<float> > probs_, backoffs_;
+};
+
+CompactArpaLm::CompactArpaLm(const CompactArpaLmOptions &opts,
+                             const ConstArpaLm &lm): initialized_(false) {
+  CompactArpaLmBuilder builder(opts, this);
+  builder.Build(lm);
+}
+
+static void WriteFloatVector(std::ostream &os, bool binary,
+                             const std::vector<float> &v) {
+  WriteBasicType(os, binary, static_cast<int32>(v.size()));
+  for (size_t i = 0; i < v.size(); i++)
+    WriteBasicType(os, binary, v[i]);
+}
+
+static void ReadFloatVector(std::istream &is, bool binary,
+                            std::vector<float> *v) {
+  int32 size;
+  ReadBasicType(is, binary, &size);
+  KALDI_ASSERT(size >= 0);
+  v->resize(size);
+  for (size_t i = 0; i < v->size(); i++)
+    ReadBasicType(is, binary, &((*v)[i]));
+}
+
+void CompactArpaLm::Write(std::ostream &os, bool binary) const {
+  KALDI_ASSERT(initialized_);
+  WriteToken(os, binary, "<CompactArpaLm>");
+  WriteToken(os, binary, "<LmInfo>");
+  WriteBasicType(os, binary, bos_symbol_);
+  WriteBasicType(os, binary, eos_symbol_);
+  WriteBasicType(os, binary, unk_symbol_);
+  WriteBasicType(os, binary, ngram_order_);
+  WriteBasicType(os, binary, num_words_);
+  WriteBasicType(os, binary, word_bits_);
+  WriteBasicType(os, binary, prob_bits_);
+  WriteBasicType(os, binary, backoff_bits_);
+  WriteToken(os, binary, "<Unigrams>");
+  WriteFloatVector(os, binary, unigram_logprob_);
+  WriteFloatVector(os, binary, unigram_backoff_logprob_);
+  WriteIntegerVector(os, binary, unigram_children_);
+  for (size_t i = 0; i < levels_.size(); i++) {
+    const Level &level = levels_[i];
+    WriteToken(os, binary, "<Level>");
+    WriteBasicType(os, binary, level.num_ngrams);
+    WriteBasicType(os, binary, level.pointer_bits);
+    WriteBasicType(os, binary, level.record_bits);
+    WriteFloatVector(os, binary, level.prob_codebook);
+    WriteFloatVector(os, binary, level.backoff_codebook);
+    WriteIntegerVector(os, binary, level.bits);
+  }
+  WriteToken(os, binary, "</CompactArpaLm>");
+}
+
+void CompactArpaLm::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<CompactArpaLm>");
+  ExpectToken(is, binary, "<LmInfo>");
+  ReadBasicType(is, binary, &bos_symbol_);
+  ReadBasicType(is, binary, &eos_symbol_);
+  ReadBasicType(is, binary, &unk_symbol_);
+  ReadBasicType(is, binary, &ngram_order_);
+  ReadBasicType(is, binary, &num_words_);
+  ReadBasicType(is, binary, &word_bits_);
+  ReadBasicType(is, binary, &prob_bits_);
+  ReadBasicType(is, binary, &backoff_bits_);
+  KALDI_ASSERT(ngram_order_ > 0);
+  ExpectToken(is, binary, "<Unigrams>");
+  ReadFloatVector(is, binary, &unigram_logprob_);
+  ReadFloatVector(is, binary, &unigram_backoff_logprob_);
+  ReadIntegerVector(is, binary, &unigram_children_);
+  KALDI_ASSERT(unigram_logprob_.size() == num_words_ &&
+               unigram_backoff_logprob_.size() == num_words_);
+  levels_.resize(ngram_order_ - 1);
+  for (size_t i = 0; i < levels_.size(); i++) {
+    Level &level = levels_[i];
+    ExpectToken(is, binary, "<Level>");
+    ReadBasicType(is, binary, &level.num_ngrams);
+    ReadBasicType(is, binary, &level.pointer_bits);
+    ReadBasicType(is, binary, &level.record_bits);
+    ReadFloatVector(is, binary, &level.prob_codebook);
+    ReadFloatVector(is, binary, &level.backoff_codebook);
+    ReadIntegerVector(is, binary, &level.bits);
+  }
+  ExpectToken(is, binary, "</CompactArpaLm>");
+  initialized_ = true;
+}
+
+int64 CompactArpaLm::MemorySize() const {
+  int64 ans = (unigram_logprob_.size() + unigram_backoff_logprob_.size()) *
+      sizeof(float) + unigram_children_.size() * sizeof(int64);
+  for (size_t i = 0; i < levels_.size(); i++)
+    ans += levels_[i].bits.size() * sizeof(uint64) +
+        (levels_[i].prob_codebook.size() +
+         levels_[i].backoff_codebook.size()) * sizeof(float);
+  return ans;
+}
+
+inline bool CompactArpaLm::HasUnigram(int32 word) const {
+  return word >= 0 && word < num_words_ &&
+      unigram_logprob_[word] != kNoUnigram;
+}
+
+inline int32 CompactArpaLm::MapWord(int32 word) const {
+  KALDI_ASSERT(word >= 0);
+  if (unk_symbol_ != -1 && !HasUnigram(word))
+    return unk_symbol_;
+  return word;
+}
+
+inline int32 CompactArpaLm::Word(const Level &level, int64 index) const {
+  return ReadBits(&(level.bits[0]), index * level.record_bits, word_bits_);
+}
+
+inline float CompactArpaLm::Logprob(int32 order, int64 index) const {
+  if (order == 1)
+    return unigram_logprob_[index];
+  const Level &level = GetLevel(order);
+  return level.prob_codebook[ReadBits(&(level.bits[0]),
+                                      index * level.record_bits + word_bits_,
+                                      prob_bits_)];
+}
+
+inline float CompactArpaLm::BackoffLogprob(int32 order, int64 index) const {
+  if (order == 1)
+    return unigram_backoff_logprob_[index];
+  const Level &level = GetLevel(order);
+  return level.backoff_codebook[ReadBits(
+      &(level.bits[0]), index * level.record_bits + word_bits_ + prob_bits_,
+      backoff_bits_)];
+}
+
+inline void CompactArpaLm::GetChildren(int32 order, int64 index,
+                                       int64 *begin, int64 *end) const {
+  if (order >= ngram_order_) {
+    *begin = *end = 0;
+  } else if (order == 1) {
+    *begin = unigram_children_[index];
+    *end = unigram_children_[index + 1];
+  } else {
+    const Level &level = GetLevel(order);
+    uint64 bit = index * level.record_bits + level.record_bits -
+        level.pointer_bits;
+    *begin = ReadBits(&(level.bits[0]), bit, level.pointer_bits);
+    *end = ReadBits(&(level.bits[0]), bit + level.record_bits,
+                    level.pointer_bits);
+  }
+}
+
+bool CompactArpaLm::FindWord(int32 order, int64 begin, int64 end, int32 word,
+                             int64 *index) const {
+  const Level &level = GetLevel(order);
+  while (begin < end) {
+    int32 first = Word(level, begin), last = Word(level, end - 1);
+    if (word <= first || word >= last) {
+      *index = (word == first ? begin : end - 1);
+      return (word == first || word == last);
+    }
+    // first < word < last: guess the position from the word-id.
+    begin++;
+    end--;
+    if (begin == end)
+      return false;
+    int64 pivot = begin + static_cast<int64>(
+        static_cast<double>(word - first) / (last - first) * (end - begin));
+    pivot = std::min(pivot, end - 1);
+    int32 pivot_word = Word(level, pivot);
+    if (pivot_word == word) {
+      *index = pivot;
+      return true;
+    } else if (pivot_word < word) {
+      begin = pivot + 1;
+    } else {
+      end = pivot;
+    }
+  }
+  return false;
+}
+
+bool CompactArpaLm::FindNgram(const int32 *words, int32 order,
+                              int64 *index) const {
+  if (!HasUnigram(words[0]))
+    return false;
+  int64 cur = words[0];
+  for (int32 n = 1; n < order; n++) {
+    int64 begin, end;
+    GetChildren(n, cur, &begin, &end);
+    if (!FindWord(n + 1, begin, end, words[n], &cur))
+      return false;
+  }
+  *index = cur;
+  return true;
+}
+
+float CompactArpaLm::GetNgramLogprob(const int32 word,
+                                     const std::vector<int32>& hist) const {
+  KALDI_ASSERT(initialized_);
+  // Only the last <ngram_order_> - 1 words of the history matter.
+  int32 hist_size = std::min<int32>(hist.size(), ngram_order_ - 1);
+  int32 mapped_word = MapWord(word);
+  // Avoids the allocation for the usual orders.
+  int32 hist_buffer[8];
+  std::vector<int32> hist_vector;
+  int32 *mapped_hist = hist_buffer;
+  if (hist_size > 8) {
+    hist_vector.resize(hist_size);
+    mapped_hist = &(hist_vector[0]);
+  }
+  for (int32 i = 0; i < hist_size; i++)
+    mapped_hist[i] = MapWord(hist[hist.size() - hist_size + i]);
+
+  // Backs off from the longest history to the shortest, as in
+  // ConstArpaLm::GetNgramLogprobRecurse().
+  float backoff_logprob = 0.0;
+  for (int32 start = 0; start < hist_size; start++) {
+    int32 order = hist_size - start;
+    int64 index;
+    if (!FindNgram(mapped_hist + start, order, &index))
+      continue;
+    int64 begin, end, child;
+    GetChildren(order, index, &begin, &end);
+    if (FindWord(order + 1, begin, end, mapped_word, &child))
+      return backoff_logprob + Logprob(order + 1, child);
+    backoff_logprob += BackoffLogprob(order, index);
+  }
+  if (!HasUnigram(mapped_word))
+    return std::numeric_limits<float>::min();
+  return backoff_logprob + unigram_logprob_[mapped_word];
+}
+
+bool CompactArpaLm::HistoryStateExists(const std::vector<int32>& hist) const {
+  // As in ConstArpaLm, the empty history is the state of the unigrams, and
+  // it exists before the model is read.
+  if (hist.empty())
+    return true;
+  KALDI_ASSERT(initialized_);
+  if (hist.size() >= ngram_order_)
+    return false;
+  int64 index, begin, end;
+  if (!FindNgram(&(hist[0]), hist.size(), &index))
+    return false;
+  GetChildren(hist.size(), index, &begin, &end);
+  return end > begin;
+}
+
+CompactArpaLmDeterministicFst::CompactArpaLmDeterministicFst(
+    const CompactArpaLm& lm) : lm_(lm) {
+  // Creates a history state for <s>.
+  std::vector<Label> bos_state(1, lm_.BosSymbol());
+  state_to_wseq_.push_back(bos_state);
+  wseq_to_state_[bos_state] = 0;
+  start_state_ = 0;
+}
+
+fst::StdArc::Weight CompactArpaLmDeterministicFst::Final(StateId s) {
+  // At this point, we should have created the state.
+  KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
+  const std::vector<Label>& wseq = state_to_wseq_[s];
+  float logprob = lm_.GetNgramLogprob(lm_.EosSymbol(), wseq);
+  return Weight(-logprob);
+}
+
+bool CompactArpaLmDeterministicFst::GetArc(StateId s,
+                                           Label ilabel, fst::StdArc *oarc) {
+  // At this point, we should have created the state.
+  KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
+  std::vector<Label> wseq = state_to_wseq_[s];
+
+  float logprob = lm_.GetNgramLogprob(ilabel, wseq);
+  if (logprob == std::numeric_limits<float>::min())
+    return false;
+
+  // The next state is the longest suffix of the history that is a history
+  // state of the language model.
+  wseq.push_back(ilabel);
+  while (wseq.size() >= lm_.NgramOrder())
+    wseq.erase(wseq.begin(), wseq.begin() + 1);
+  while (!lm_.HistoryStateExists(wseq)) {
+    KALDI_ASSERT(wseq.size() > 0);
+    wseq.erase(wseq.begin(), wseq.begin() + 1);
+  }
+
+  std::pair<MapType::iterator, bool> result = wseq_to_state_.insert(
+      std::make_pair(wseq, static_cast<StateId>(state_to_wseq_.size())));
+  if (result.second)
+    state_to_wseq_.push_back(wseq);
+
+  oarc->ilabel = ilabel;
+  oarc->olabel = ilabel;
+  oarc->nextstate = result.first->second;
+  oarc->weight = Weight(-logprob);
+  return true;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,193 @@
+// lm/compact-arpa-lm.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LM_COMPACT_ARPA_LM_H_
+#define KALDI_LM_COMPACT_ARPA_LM_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "fstext/deterministic-fst.h"
+#include "itf/options-itf.h"
+#include "lm/const-arpa-lm.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+struct CompactArpaLmOptions {
+  int32 prob_bits;
+  int32 backoff_bits;
+
+  CompactArpaLmOptions(): prob_bits(8), backoff_bits(8) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("prob-bits", &prob_bits, "Number of bits the log-"
+                   "probabilities of the n-grams above unigrams are quantized "
+                   "to (1 to 24).");
+    opts->Register("backoff-bits", &backoff_bits, "Number of bits the backoff "
+                   "log-probabilities of the n-grams above unigrams are "
+                   "quantized to (1 to 24).");
+  }
+};
+
+/**
+   CompactArpaLm holds the same language model as ConstArpaLm, with the same
+   lookup interface, in less memory.  It is converted from a ConstArpaLm (see
+   const-arpa-to-compact-arpa).
+
+   The n-grams of each order above unigrams are stored as fixed-size records
+   packed into an array of bits, sorted lexicographically, like in a trie:
+   record i of order n holds the last word of the n-gram (in as many bits as
+   the largest word-id needs), its log-probability and backoff log-probability
+   quantized to --prob-bits and --backoff-bits, and the index of its first
+   child among the records of order n + 1 (in as many bits as the number of
+   those records needs); its children end where those of record i + 1 start.
+   The highest order needs neither backoffs nor children.  Unigrams are kept
+   unquantized in arrays indexed by word-id.
+
+   The quantization is binned: the values of an order are sorted and split into
+   2^bits bins of equal size, and each value is replaced by the mean of its bin.
+   A backoff of zero is kept exact.  With the default 8 bits, a 5-gram n-gram
+   takes about 4 bytes in place of the 8 (or 20 for a history) of ConstArpaLm.
+
+   The children of a record are found by interpolation search, as word-ids are
+   spread fairly evenly; unlike in ConstArpaLm no pointers need to be decoded.
+*/
+class CompactArpaLm {
+ public:
+  CompactArpaLm(): initialized_(false) { }
+
+  // Builds the compact form of <lm>.
+  CompactArpaLm(const CompactArpaLmOptions &opts, const ConstArpaLm &lm);
+
+  void Read(std::istream &is, bool binary);
+
+  void Write(std::ostream &os, bool binary) const;
+
+  // As ConstArpaLm::GetNgramLogprob(); returns
+  // std::numeric_limits<float>::min() if <word> is not in the language model
+  // and there is no <unk>.
+  float GetNgramLogprob(const int32 word, const std::vector<int32>& hist) const;
+
+  // As ConstArpaLm::HistoryStateExists().
+  bool HistoryStateExists(const std::vector<int32>& hist) const;
+
+  int32 BosSymbol() const { return bos_symbol_; }
+  int32 EosSymbol() const { return eos_symbol_; }
+  int32 UnkSymbol() const { return unk_symbol_; }
+  int32 NgramOrder() const { return ngram_order_; }
+
+  // Returns the number of bytes the language model takes in memory.
+  int64 MemorySize() const;
+
+ private:
+  friend class CompactArpaLmBuilder;
+
+  // The n-grams of one order above unigrams.
+  struct Level {
+    int64 num_ngrams;
+    int32 pointer_bits;  // zero for the highest order.
+    int32 record_bits;
+    std::vector<float> prob_codebook;
+    std::vector<float> backoff_codebook;  // empty for the highest order.
+    // The records, followed (except for the highest order) by one more that
+    // only holds the end of the children of the last one.
+    std::vector<uint64> bits;
+  };
+
+  const Level &GetLevel(int32 order) const { return levels_[order - 2]; }
+
+  // Maps words that are not in the language model to <unk>, if it is defined.
+  int32 MapWord(int32 word) const;
+
+  bool HasUnigram(int32 word) const;
+
+  // Gets the word-sequence <words> (of size <order>) as an n-gram of that
+  // order: the word-id for unigrams, the index of the record otherwise.
+  bool FindNgram(const int32 *words, int32 order, int64 *index) const;
+
+  // Gets the range of records of order <order> + 1 that are the children of
+  // n-gram <index> of order <order>.
+  void GetChildren(int32 order, int64 index, int64 *begin, int64 *end) const;
+
+  // Finds <word> among the records [begin, end) of order <order>.
+  bool FindWord(int32 order, int64 begin, int64 end, int32 word,
+                int64 *index) const;
+
+  float Logprob(int32 order, int64 index) const;
+
+  float BackoffLogprob(int32 order, int64 index) const;
+
+  int32 Word(const Level &level, int64 index) const;
+
+  bool initialized_;
+  int32 bos_symbol_;
+  int32 eos_symbol_;
+  int32 unk_symbol_;
+  int32 ngram_order_;
+
+  // Index of largest word-id plus one.
+  int32 num_words_;
+
+  // Bits of the word field of the records.
+  int32 word_bits_;
+  int32 prob_bits_;
+  int32 backoff_bits_;
+
+  // The unigrams, indexed by word-id.
+  std::vector<float> unigram_logprob_;
+  std::vector<float> unigram_backoff_logprob_;
+  // The start of the children of each word among the bigrams, and the end
+  // of those of the last one (empty for a unigram language model).
+  std::vector<int64> unigram_children_;
+
+  // levels_[n - 2] holds the n-grams of order n.
+  std::vector<Level> levels_;
+};
+
+/**
+ This class wraps a CompactArpaLm format language model with the interface
+ defined in DeterministicOnDemandFst, like ConstArpaLmDeterministicFst.
+ */
+class CompactArpaLmDeterministicFst
+  : public fst::DeterministicOnDemandFst<fst::StdArc> {
+ public:
+  typedef fst::StdArc::Weight Weight;
+  typedef fst::StdArc::StateId StateId;
+  typedef fst::StdArc::Label Label;
+
+  explicit CompactArpaLmDeterministicFst(const CompactArpaLm& lm);
+
+  virtual StateId Start() { return start_state_; }
+
+  virtual Weight Final(StateId s);
+
+  virtual bool GetArc(StateId s, Label ilabel, fst::StdArc* oarc);
+
+ private:
+  typedef unordered_map<std::vector<Label>,
+                        StateId, VectorHasher<Label> > MapType;
+  StateId start_state_;
+  MapType wseq_to_state_;
+  std::vector<std::vector<Label> > state_to_wseq_;
+  const CompactArpaLm& lm_;
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_LM_COMPACT_ARPA_LM_H_
@@ -0,0 +1,125 @@
+// lm/const-arpa-lm-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <set>
+#include <sstream>
+
+#include "base/kaldi-math.h"
+#include "lm/const-arpa-lm.h"
+#include "util/kaldi-io.h"
+
+namespace kaldi {
+
+// Word ids: <s> = 1, </s> = 2, <unk> = 3, other words from 4 on.
+static const int32 kBos = 1, kEos = 2, kUnk = 3;
+
+// Writes a random trigram ARPA file with integer words. Every n-gram's
+// history is itself an n-gram, as the ARPA format requires.
+static void WriteRandomArpa(int32 num_words, const std::string &filename) {
+  std::vector<std::vector<int32> > bigrams, trigrams;
+  std::set<std::vector<int32> > seen;
+  for (int32 i = 0; i < 4 * num_words; i++) {
+    std::vector<int32> b(2);
+    b[0] = (i % 5 == 0 ? kBos : RandInt(kEos, num_words - 1));
+    b[1] = RandInt(kEos, num_words - 1);
+    if (b[0] != kEos && seen.insert(b).second) bigrams.push_back(b);
+  }
+  for (int32 i = 0; i < 4 * num_words; i++) {
+    std::vector<int32> t(bigrams[RandInt(0, bigrams.size() - 1)]);
+    if (t[1] == kEos) continue;
+    t.push_back(RandInt(kEos, num_words - 1));
+    if (seen.insert(t).second) trigrams.push_back(t);
+  }
+
+  Output ko(filename, false);
+  std::ostream &os = ko.Stream();
+  os << "\\data\\\nngram 1=" << num_words - 1 << "\nngram 2=" << bigrams.size()
+     << "\nngram 3=" << trigrams.size() << "\n\n\\1-grams:\n";
+  for (int32 w = 1; w < num_words; w++)
+    os << (w == kBos ? -99.0 : -RandUniform() * 5) << "\t" << w << "\t"
+       << -RandUniform() << "\n";
+  os << "\n\\2-grams:\n";
+  for (size_t i = 0; i < bigrams.size(); i++)
+    os << -RandUniform() * 3 << "\t" << bigrams[i][0] << " " << bigrams[i][1]
+       << "\t" << -RandUniform() << "\n";
+  os << "\n\\3-grams:\n";
+  for (size_t i = 0; i < trigrams.size(); i++)
+    os << -RandUniform() * 2 << "\t" << trigrams[i][0] << " " << trigrams[i][1]
+       << " " << trigrams[i][2] << "\n";
+  os << "\n\\end\\\n";
+}
+
+void UnitTestConstArpaLmMapped() {
+  int32 num_words = RandInt(10, 200);
+  std::string arpa = "tmp-const-arpa-lm-test.arpa",
+      plain = "tmp-const-arpa-lm-test.carpa",
+      mappable = "tmp-const-arpa-lm-test.mapped.carpa";
+  WriteRandomArpa(num_words, arpa);
+
+  ArpaParseOptions options;
+  options.bos_symbol = kBos;
+  options.eos_symbol = kEos;
+  options.unk_symbol = kUnk;
+  BuildConstArpaLm(options, arpa, plain, false);
+  BuildConstArpaLm(options, arpa, mappable, true);
+
+  ConstArpaLm lm, lm_mapped, lm_mapped2, lm_unmappable;
+  ReadKaldiObject(plain, &lm);
+  lm_mapped.ReadMapped(mappable);
+  lm_mapped2.ReadMapped(mappable);
+  lm_unmappable.ReadMapped(plain);
+  KALDI_ASSERT(!lm.IsMapped() && lm_mapped.IsMapped() &&
+               lm_mapped2.IsMapped() && !lm_unmappable.IsMapped());
+
+  // the mappable layout can also be read the usual way.
+  ConstArpaLm lm_read;
+  ReadKaldiObject(mappable, &lm_read);
+  KALDI_ASSERT(!lm_read.IsMapped());
+
+  for (int32 i = 0; i < 1000; i++) {
+    std::vector<int32> hist(RandInt(0, 2));
+    for (size_t j = 0; j < hist.size(); j++)
+      hist[j] = RandInt(kBos, num_words + 5);  // includes OOVs
+    int32 word = RandInt(kEos, num_words + 5);
+    float logprob = lm.GetNgramLogprob(word, hist);
+    KALDI_ASSERT(lm_mapped.GetNgramLogprob(word, hist) == logprob);
+    KALDI_ASSERT(lm_mapped2.GetNgramLogprob(word, hist) == logprob);
+    KALDI_ASSERT(lm_unmappable.GetNgramLogprob(word, hist) == logprob);
+    KALDI_ASSERT(lm_read.GetNgramLogprob(word, hist) == logprob);
+    KALDI_ASSERT(lm_mapped.HistoryStateExists(hist) ==
+                 lm.HistoryStateExists(hist));
+  }
+
+  std::ostringstream arpa1, arpa2;
+  lm.WriteArpa(arpa1);
+  lm_mapped.WriteArpa(arpa2);
+  KALDI_ASSERT(arpa1.str() == arpa2.str());
+
+  std::remove(arpa.c_str());
+  std::remove(plain.c_str());
+  std::remove(mappable.c_str());
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 5; i++)
+    kaldi::UnitTestConstArpaLmMapped();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
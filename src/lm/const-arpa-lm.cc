@@ -18,10 +18,20 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
 #include <limits>
 #include <sstream>
 #include <utility>
 
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "base/kaldi-math.h"
 #include "lm/arpa-file-parser.h"
 #include "lm/const-arpa-lm.h"
@@ -31,6 +41,10 @@
 
 namespace kaldi {
 
+// Alignment in bytes of the <lm_states_> array in the files written with
+// mappable == true.
+static const int32 kLmStatesAlignment = 64;
+
 // Auxiliary struct for converting ConstArpaLm format langugae model to Arpa
 // format.
 struct ArpaLine {
@@ -187,6 +201,7 @@ class ConstArpaLmBuilder : public ArpaFileParser {
     lm_states_ = NULL;
     unigram_states_ = NULL;
     overflow_buffer_ = NULL;
+    mappable_ = false;
   }
 
   ~ConstArpaLmBuilder() {
@@ -205,6 +220,9 @@ class ConstArpaLmBuilder : public ArpaFileParser {
   // Writes ConstArpaLm.
   void Write(std::ostream &os, bool binary) const;
 
+  // Writes the memory-mappable layout, see ConstArpaLm::ReadMapped().
+  void SetMappable(bool mappable) { mappable_ = mappable; }
+
   void SetMaxAddressOffset(const int32 max_address_offset) {
     KALDI_WARN << "You are changing <max_address_offset_>; the default should "
         << "not be changed unless you are in testing mode.";
@@ -230,6 +248,9 @@ class ConstArpaLmBuilder : public ArpaFileParser {
   // Indicating if ConstArpaLm has been built or not.
   bool is_built_;
 
+  // Whether Write() produces the memory-mappable layout.
+  bool mappable_;
+
   // Maximum relative address for the child. We put it here just for testing.
   // The default value is 30-bits and should not be changed except for testing.
   int32 max_address_offset_;
@@ -491,10 +512,10 @@ void ConstArpaLmBuilder::Write(std::ostream &os, bool binary) const {
       Options().bos_symbol, Options().eos_symbol, Options().unk_symbol,
       ngram_order_, num_words_, overflow_buffer_size_, lm_states_size_,
       unigram_states_, overflow_buffer_, lm_states_);
-  const_arpa_lm.Write(os, binary);
+  const_arpa_lm.Write(os, binary, mappable_);
 }
 
-void ConstArpaLm::Write(std::ostream &os, bool binary) const {
+void ConstArpaLm::Write(std::ostream &os, bool binary, bool mappable) const {
   KALDI_ASSERT(initialized_);
   if (!binary) {
     KALDI_ERR << "text-mode writing is not implemented for ConstArpaLm.";
@@ -510,9 +531,28 @@ void ConstArpaLm::Write(std::ostream &os, bool binary) const {
   WriteBasicType(os, binary, ngram_order_);
   WriteToken(os, binary, "</LmInfo>");
 
-  // LmStates section.
-  WriteToken(os, binary, "<LmStates>");
-  WriteBasicType(os, binary, lm_states_size_);
+  // LmStates section. In the mappable layout the array is preceded by padding
+  // that aligns it in the file; the padding is computed from the stream
+  // position, so it only works when writing to a file from its beginning.
+  if (mappable) {
+    WriteToken(os, binary, "<LmStatesAligned>");
+    WriteBasicType(os, binary, lm_states_size_);
+    int32 pad = 0;
+    std::streamoff pos = os.tellp();
+    if (pos >= 0) {
+      // the padding size itself takes one byte for the size plus four.
+      pos += 1 + sizeof(int32);
+      pad = (kLmStatesAlignment - pos % kLmStatesAlignment) % kLmStatesAlignment;
+    } else {
+      KALDI_WARN << "Cannot align ConstArpaLm <LmStates> on a stream that is "
+                 << "not seekable; the output will not be memory-mappable.";
+    }
+    WriteBasicType(os, binary, pad);
+    for (int32 i = 0; i < pad; i++) os.put('\0');
+  } else {
+    WriteToken(os, binary, "<LmStates>");
+    WriteBasicType(os, binary, lm_states_size_);
+  }
   os.write(reinterpret_cast<char *>(lm_states_),
            sizeof(int32) * lm_states_size_);
   if (!os.good()) {
@@ -584,7 +624,8 @@ void ConstArpaLm::Read(std::istream &is, bool binary) {
   }
 }
 
-void ConstArpaLm::ReadInternal(std::istream &is, bool binary) {
+void ConstArpaLm::ReadInternal(std::istream &is, bool binary,
+                               const char *mapped_file) {
   KALDI_ASSERT(!initialized_);
   if (!binary) {
     KALDI_ERR << "text-mode reading is not implemented for ConstArpaLm.";
@@ -600,16 +641,37 @@ void ConstArpaLm::ReadInternal(std::istream &is, bool binary) {
   ReadBasicType(is, binary, &ngram_order_);
   ExpectToken(is, binary, "</LmInfo>");
 
-  // LmStates section.
-  ExpectToken(is, binary, "<LmStates>");
+  // LmStates section, either plain or aligned (see Write()).
+  std::string token;
+  ReadToken(is, binary, &token);
+  if (token != "<LmStates>" && token != "<LmStatesAligned>") {
+    KALDI_ERR << "Expected token <LmStates> or <LmStatesAligned>, got "
+              << token;
+  }
   ReadBasicType(is, binary, &lm_states_size_);
-  lm_states_ = new int32[lm_states_size_];
-  is.read(reinterpret_cast<char *>(lm_states_),
-          sizeof(int32) * lm_states_size_);
+  if (token == "<LmStatesAligned>") {
+    int32 pad;
+    ReadBasicType(is, binary, &pad);
+    is.ignore(pad);
+  }
+  std::streamoff pos = (mapped_file != NULL ?
+                        static_cast<std::streamoff>(is.tellg()) : -1);
+  if (pos >= 0 && pos % sizeof(int32) == 0 &&
+      pos + sizeof(int32) * lm_states_size_ <= mapped_size_) {
+    lm_states_ = reinterpret_cast<int32*>(const_cast<char*>(mapped_file + pos));
+    is.seekg(sizeof(int32) * lm_states_size_, std::ios::cur);
+  } else {
+    mapped_file = NULL;
+    lm_states_ = new int32[lm_states_size_];
+    is.read(reinterpret_cast<char *>(lm_states_),
+            sizeof(int32) * lm_states_size_);
+  }
   if (!is.good()) {
     KALDI_ERR << "ConstArpaLm <LmStates> section reading failed.";
   }
   ExpectToken(is, binary, "</LmStates>");
+  // The file is only kept mapped if <lm_states_> points into it.
+  if (mapped_file == NULL) Unmap();
 
   // Unigram section. We write memory offset to disk instead of the absolute
   // pointers.
@@ -662,6 +724,58 @@ void ConstArpaLm::ReadInternal(std::istream &is, bool binary) {
   initialized_ = true;
 }
 
+void ConstArpaLm::ReadMapped(const std::string &rxfilename) {
+  KALDI_ASSERT(!initialized_);
+#ifndef _MSC_VER
+  if (ClassifyRxfilename(rxfilename) == kFileInput) {
+    int fd = open(rxfilename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd == -1)
+      KALDI_ERR << "Failed to open " << rxfilename << ": " << strerror(errno);
+    if (fstat(fd, &st) != 0) {
+      int err = errno;
+      close(fd);
+      KALDI_ERR << "Failed to stat " << rxfilename << ": " << strerror(err);
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data != MAP_FAILED) {
+      mapped_data_ = data;
+      mapped_size_ = st.st_size;
+      std::ifstream is(rxfilename.c_str(), std::ios::in | std::ios::binary);
+      bool binary;
+      if (!is.good() || !InitKaldiInputStream(is, &binary)) {
+        KALDI_ERR << "Failed to read ConstArpaLm from " << rxfilename;
+      }
+      if (binary && is.peek() != 4) {
+        ReadInternal(is, binary, static_cast<const char*>(mapped_data_));
+      } else {
+        Unmap();
+        Read(is, binary);
+      }
+      if (!IsMapped()) {
+        KALDI_LOG << "ConstArpaLm " << rxfilename << " was read into memory; "
+                  << "convert it with arpa-to-const-arpa --mappable=true to "
+                  << "memory-map it.";
+      }
+      return;
+    }
+    KALDI_WARN << "Failed to memory-map " << rxfilename << ": "
+               << strerror(errno);
+  }
+#endif
+  ReadKaldiObject(rxfilename, this);
+}
+
+void ConstArpaLm::Unmap() {
+  if (mapped_data_ == NULL) return;
+#ifndef _MSC_VER
+  munmap(mapped_data_, mapped_size_);
+#endif
+  mapped_data_ = NULL;
+  mapped_size_ = 0;
+}
+
 void ConstArpaLm::ReadInternalOldFormat(std::istream &is, bool binary) {
   KALDI_ASSERT(!initialized_);
   if (!binary) {
@@ -1010,6 +1124,44 @@ void ConstArpaLm::WriteArpa(std::ostream &os) const {
   os << std::endl << "\\end\\" << std::endl;
 }
 
+void ConstArpaLm::VisitNgramsRecurse(int32* lm_state,
+                                     std::vector<int32> *seq,
+                                     ConstArpaLmVisitor *visitor) const {
+  KALDI_ASSERT(lm_state >= lm_states_);
+  KALDI_ASSERT(lm_state + 2 <= lm_states_end_);
+
+  Int32AndFloat logprob_i(*lm_state);
+  Int32AndFloat backoff_logprob_i(*(lm_state + 1));
+  visitor->Visit(*seq, logprob_i.f, backoff_logprob_i.f);
+
+  int32 num_children = *(lm_state + 2);
+  KALDI_ASSERT(lm_state + 2 + 2 * num_children <= lm_states_end_);
+  for (int32 i = 0; i < num_children; ++i) {
+    seq->push_back(*(lm_state + 3 + 2 * i));
+    int32 child_info = *(lm_state + 4 + 2 * i);
+    float logprob;
+    int32* child_lm_state = NULL;
+    DecodeChildInfo(child_info, lm_state, &child_lm_state, &logprob);
+    if (child_lm_state == NULL)
+      visitor->Visit(*seq, logprob, 0.0);  // leaf case.
+    else
+      VisitNgramsRecurse(child_lm_state, seq, visitor);
+    seq->pop_back();
+  }
+}
+
+void ConstArpaLm::VisitNgrams(ConstArpaLmVisitor *visitor) const {
+  KALDI_ASSERT(initialized_);
+
+  std::vector<int32> seq(1);
+  for (int32 i = 0; i < num_words_; ++i) {
+    if (unigram_states_[i] != NULL) {
+      seq[0] = i;
+      VisitNgramsRecurse(unigram_states_[i], &seq, visitor);
+    }
+  }
+}
+
 ConstArpaLmDeterministicFst::ConstArpaLmDeterministicFst(
     const ConstArpaLm& lm) : lm_(lm) {
   // Creates a history state for <s>.
@@ -1073,8 +1225,10 @@ bool ConstArpaLmDeterministicFst::GetArc(StateId s,
 
 bool BuildConstArpaLm(const ArpaParseOptions& options,
                       const std::string& arpa_rxfilename,
-                      const std::string& const_arpa_wxfilename) {
+                      const std::string& const_arpa_wxfilename,
+                      bool mappable) {
   ConstArpaLmBuilder lm_builder(options);
+  lm_builder.SetMappable(mappable);
   KALDI_LOG << "Reading " << arpa_rxfilename;
   Input ki(arpa_rxfilename);
   lm_builder.Read(ki.Stream());
@@ -208,6 +208,15 @@ union Int32AndFloat {
   Int32AndFloat(float input_f) : f(input_f) {}
 };
 
+// Receives the n-grams of a ConstArpaLm from ConstArpaLm::VisitNgrams().
+class ConstArpaLmVisitor {
+ public:
+  // <backoff_logprob> is zero for the n-grams that are not histories.
+  virtual void Visit(const std::vector<int32> &words, float logprob,
+                     float backoff_logprob) = 0;
+  virtual ~ConstArpaLmVisitor() { }
+};
+
 class ConstArpaLm {
  public:
 
@@ -219,6 +228,8 @@ class ConstArpaLm {
     overflow_buffer_ = NULL;
     memory_assigned_ = false;
     initialized_ = false;
+    mapped_data_ = NULL;
+    mapped_size_ = 0;
   }
 
   // Special constructor, will be used when you initialize ConstArpaLm from
@@ -244,22 +255,40 @@ class ConstArpaLm {
     lm_states_end_ = lm_states_ + lm_states_size_ - 1;
     memory_assigned_ = false;
     initialized_ = true;
+    mapped_data_ = NULL;
+    mapped_size_ = 0;
   }
 
   ~ConstArpaLm() {
     if (memory_assigned_) {
-      delete[] lm_states_;
+      if (mapped_data_ == NULL) delete[] lm_states_;
       delete[] unigram_states_;
       delete[] overflow_buffer_;
     }
+    Unmap();
   }
 
   // Reads the ConstArpaLm format language model. It calls ReadInternal() or
   // ReadInternalOldFormat() to do the actual reading.
   void Read(std::istream &is, bool binary);
 
+  // Reads the language model from <rxfilename> like ReadKaldiObject() does,
+  // but if it is a regular file written with Write(os, binary, true), the
+  // <lm_states_> array is memory-mapped read-only instead of being copied, so
+  // the processes that load the same file share its pages in the page cache
+  // and loading takes no time. Other files are read into memory as usual.
+  void ReadMapped(const std::string &rxfilename);
+
+  // Returns true if <lm_states_> is memory-mapped.
+  bool IsMapped() const { return mapped_data_ != NULL; }
+
   // Writes the language model in ConstArpaLm format.
-  void Write(std::ostream &os, bool binary) const;
+  void Write(std::ostream &os, bool binary) const { Write(os, binary, false); }
+
+  // If <mappable> is true, the <lm_states_> array is aligned in the file so
+  // that ReadMapped() can map it. Older versions of the code cannot read such
+  // files.
+  void Write(std::ostream &os, bool binary, bool mappable) const;
 
   // Creates Arpa format language model from ConstArpaLm format, and writes it
   // to output stream. This will be useful in testing.
@@ -273,14 +302,32 @@ class ConstArpaLm {
   // <hist> will be a state in the FST format language model.
   bool HistoryStateExists(const std::vector<int32>& hist) const;
 
+  // Calls <visitor> for every n-gram, in lexicographic order of the word
+  // sequences, so each n-gram comes right before the n-grams it is the history
+  // of.
+  void VisitNgrams(ConstArpaLmVisitor *visitor) const;
+
   int32 BosSymbol() const { return bos_symbol_; }
   int32 EosSymbol() const { return eos_symbol_; }
   int32 UnkSymbol() const { return unk_symbol_; }
   int32 NgramOrder() const { return ngram_order_; }
 
+  // Returns the number of bytes the language model takes in memory (or in the
+  // mapping).
+  int64 MemorySize() const {
+    return lm_states_size_ * sizeof(int32) +
+        (num_words_ + overflow_buffer_size_) * sizeof(int32*);
+  }
+
  private:
-  // Function that loads data from stream to the class.
-  void ReadInternal(std::istream &is, bool binary);
+  // Function that loads data from stream to the class. If <mapped_file> is
+  // not NULL it is the mapping of the whole file <is> reads from, and aligned
+  // <lm_states_> point into it.
+  void ReadInternal(std::istream &is, bool binary,
+                    const char *mapped_file = NULL);
+
+  // Releases the file mapping, if any.
+  void Unmap();
 
   // Function that loads data from stream to the class. This is a deprecated one
   // that handles the old on-disk format. We keep this for back-compatibility
@@ -321,6 +368,9 @@ class ConstArpaLm {
                         const std::vector<int32>& seq,
                         std::vector<ArpaLine> *output) const;
 
+  void VisitNgramsRecurse(int32* lm_state, std::vector<int32> *seq,
+                          ConstArpaLmVisitor *visitor) const;
+
   // We assign memory in Read(). If it is called, we have to release memory in
   // the destructor.
   bool memory_assigned_;
@@ -382,6 +432,11 @@ class ConstArpaLm {
   //
   // x = 1 + 1 + 1 + 2 * children.size() = 3 + 2 * children.size()
   int32* lm_states_;
+
+  // The mapping of the file when <lm_states_> is memory-mapped by
+  // ReadMapped(), NULL otherwise.
+  void* mapped_data_;
+  size_t mapped_size_;
 };
 
 /**
@@ -419,9 +474,12 @@ class ConstArpaLmDeterministicFst
 // Reads in an Arpa format language model and converts it into ConstArpaLm
 // format. We assume that the words in the input Arpa format language model have
 // been converted into integers.
+// If <mappable> is true, the output can be memory-mapped by
+// ConstArpaLm::ReadMapped().
 bool BuildConstArpaLm(const ArpaParseOptions& options,
                       const std::string& arpa_rxfilename,
-                      const std::string& const_arpa_wxfilename);
+                      const std::string& const_arpa_wxfilename,
+                      bool mappable = false);
 
 }  // namespace kaldi
 
@@ -478,42 +478,18 @@ bool SeqLabelExample::PrepareData(std::vector<Example*> &examples) {
     return true;
 }
 
-void ExamplesRepository::AcceptExample(
-		Example *example) {
-  empty_semaphore_.Wait();
-  examples_mutex_.Lock();
-  examples_.push_back(example);
-  examples_mutex_.Unlock();
-  full_semaphore_.Signal();
+void ExamplesRepository::AcceptExample(Example *example) {
+  if (!examples_.Push(example))
+    KALDI_ERR << "AcceptExample() called after ExamplesDone().";
 }
 
 void ExamplesRepository::ExamplesDone() {
-  for (int32 i = 0; i < buffer_size_; i++)
-    empty_semaphore_.Wait();
-  examples_mutex_.Lock();
-  KALDI_ASSERT(examples_.empty());
-  examples_mutex_.Unlock();
-  done_ = true;
-  full_semaphore_.Signal();
+  examples_.Close();
 }
 
-Example*
-ExamplesRepository::ProvideExample() {
-  full_semaphore_.Wait();
-  if (done_) {
-    KALDI_ASSERT(examples_.empty());
-    full_semaphore_.Signal(); // Increment the semaphore so
-    // the call by the next thread will not block.
-    return NULL; // no examples to return-- all finished.
-  } else {
-    examples_mutex_.Lock();
-    KALDI_ASSERT(!examples_.empty());
-    Example *ans = examples_.front();
-    examples_.pop_front();
-    examples_mutex_.Unlock();
-    empty_semaphore_.Signal();
-    return ans;
-  }
+Example* ExamplesRepository::ProvideExample() {
+  Example *ans;
+  return examples_.Pop(&ans) ? ans : NULL;
 }
 
 
@@ -21,6 +21,7 @@
 #define LM_LM_EXAMPLE_H_
 
 #include <deque>
+#include "util/mpmc-queue.h"
 #include "util/table-types.h"
 
 #include "lm/am-compute-parallel.h"
@@ -208,17 +209,9 @@ class ExamplesRepository {
   /// ExamplesDone() has been called.
   Example *ProvideExample();
 
-  ExamplesRepository(int32 buffer_size = 128): buffer_size_(buffer_size),
-                                      empty_semaphore_(buffer_size_),
-                                      done_(false) {}
+  ExamplesRepository(int32 buffer_size = 128): examples_(buffer_size) {}
  private:
-  int32 buffer_size_;
-  Semaphore full_semaphore_;
-  Semaphore empty_semaphore_;
-  Mutex examples_mutex_; // mutex we lock to modify examples_.
-
-  std::deque<Example*> examples_;
-  bool done_;
+  MpmcQueue<Example*> examples_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(ExamplesRepository);
 };
 
@@ -151,7 +151,8 @@ void KaldiNNlmWrapper::GetLogProbParallel(const std::vector<int> &curt_words,
 										 std::vector<BaseFloat> &logprob) {
 	// get current words log probility (CPU done)
 	LstmLmHistroy *his;
-	int i, j, wid, cid;
+	int i, j, wid, cid, num_stream = num_stream_;
+	ResetStreams(curt_words.size());
 	logprob.resize(num_stream_);
 	for (i = 0; i < num_stream_; i++) {
 		wid = curt_words[i];
@@ -194,6 +195,7 @@ void KaldiNNlmWrapper::GetLogProbParallel(const std::vector<int> &curt_words,
 			context_out[j]->his_cell[i] = his_cell_[i].Row(j);
 		}
 	}
+	ResetStreams(num_stream);
 }
 
 BaseFloat KaldiNNlmWrapper::GetLogProb(int32 curt_word,
@@ -238,6 +240,63 @@ BaseFloat KaldiNNlmWrapper::GetLogProb(int32 curt_word,
 	return logprob;
 }
 
+void KaldiNNlmWrapper::ResetStreams(int32 cur_stream) {
+	if (cur_stream == num_stream_)
+		return;
+
+	num_stream_ = cur_stream;
+	KALDI_VLOG(2) << "Reset lstm lm with " << num_stream_ << " streams.";
+
+	for (int i = 0; i < recurrent_dim_.size(); i++)
+		his_recurrent_[i].Resize(num_stream_, recurrent_dim_[i], kUndefined);
+	for (int i = 0; i < cell_dim_.size(); i++)
+		his_cell_[i].Resize(num_stream_, cell_dim_[i], kUndefined);
+
+	in_words_.Resize(num_stream_, kUndefined);
+	in_words_mat_.Resize(num_stream_, 1, kUndefined);
+	words_.Resize(num_stream_, kUndefined);
+	hidden_out_.Resize(num_stream_, nnlm_.OutputDim(), kUndefined);
+	std::vector<int> new_utt_flags(num_stream_, 0);
+	nnlm_.ResetLstmStreams(new_utt_flags);
+}
+
+void KaldiNNlmWrapper::ForwardMseq(const std::vector<int32> &in_words,
+				const std::vector<LstmLmHistroy*> &context_in,
+				const std::vector<LstmLmHistroy*> &context_out) {
+	int i, j, num_layers = recurrent_dim_.size(), num_stream = num_stream_;
+	KALDI_ASSERT(in_words.size() > 0 && context_in.size() == in_words.size() &&
+				 context_out.size() == in_words.size());
+	ResetStreams(in_words.size());
+
+	// restore history
+	for (i = 0; i < num_layers; i++) {
+		for (j = 0; j < num_stream_; j++) {
+			his_recurrent_[i].Row(j).CopyFromVec(context_in[j]->his_recurrent[i]);
+			his_cell_[i].Row(j).CopyFromVec(context_in[j]->his_cell[i]);
+		}
+	}
+	nnlm_.RestoreContext(his_recurrent_, his_cell_);
+
+	for (j = 0; j < num_stream_; j++)
+		in_words_(j) = in_words[j];
+	in_words_mat_.CopyColFromVec(in_words_, 0);
+	words_.CopyFromMat(in_words_mat_);
+
+	// forward propagate
+	nnlm_.Propagate(words_, &hidden_out_);
+
+	// save current words history
+	nnlm_.SaveContext(his_recurrent_, his_cell_);
+	for (i = 0; i < num_layers; i++) {
+		for (j = 0; j < num_stream_; j++) {
+			context_out[j]->his_recurrent[i] = his_recurrent_[i].Row(j);
+			context_out[j]->his_cell[i] = his_cell_[i].Row(j);
+		}
+	}
+	// back to --num-stream for the other callers
+	ResetStreams(num_stream);
+}
+
 
 
 NNlmDeterministicFst::NNlmDeterministicFst(int32 max_ngram_order,
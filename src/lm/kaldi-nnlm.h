@@ -40,6 +40,7 @@ struct LstmLmHistroy {
         for (int i = 0; i < cdim.size(); i++)
             his_cell[i].Resize(cdim[i], resize_type);
     }
+    LstmLmHistroy() {}
 
 	std::vector<Vector<BaseFloat> > his_recurrent; //  each hidden lstm layer recurrent history
 	std::vector<Vector<BaseFloat> > his_cell; //  each hidden lstm layer cell history
@@ -92,10 +93,20 @@ class KaldiNNlmWrapper {
 
   BaseFloat GetLogProb(int32 curt_words, LstmLmHistroy* context_in, LstmLmHistroy* context_out);
 
+  // Forwards in_words[i] (lm word ids) from context_in[i] into context_out[i]
+  // with a single propagation of in_words.size() streams; the log-probs of
+  // the next words are then given by GetLogProb() on context_out[i].
+  void ForwardMseq(const std::vector<int32> &in_words,
+                   const std::vector<LstmLmHistroy*> &context_in,
+                   const std::vector<LstmLmHistroy*> &context_out);
+
   inline int32 GetWordId(int32 wid) { return label_to_lmwordid_[wid];}
   inline int32 GetWordId(std::string word) { return word_to_lmwordid_[word];}
 
  private:
+  // Resizes the buffers and the lstm streams to cur_stream streams.
+  void ResetStreams(int32 cur_stream);
+
   nnet0::Nnet nnlm_;
   std::vector<int> word2class_;
   std::vector<int> class_boundary_;
@@ -131,6 +131,7 @@ int LmModelSync::GetDim(Nnet *nnet)
 					dim += stlstm_t->peephole_o_c_.Dim();
 					break;
 				case nnet0::Component::kAffineTransform:
+				case nnet0::Component::kSparseAffineTransform:
 					aff_t = (nnet0::AffineTransform*)(nnet->components_[n]);
 					dim += aff_t->linearity_.SizeInBytes()/sizeof(BaseFloat);
 					dim += aff_t->bias_.Dim();
@@ -272,6 +273,7 @@ void LmModelSync::GetWeight(Nnet *nnet, int32 thread_idx, int32 buffer_idx)
 				break;
 
 			case nnet0::Component::kAffineTransform:
+			case nnet0::Component::kSparseAffineTransform:
                 aff_t = (nnet0::AffineTransform*)(nnet->components_[n]);
 				dim = aff_t->linearity_.Dim();
 				src_pitch = dim.stride*sizeof(BaseFloat);
@@ -453,6 +455,7 @@ void LmModelSync::SetWeight(Nnet *nnet, int32 thread_idx, int32 buffer_idx)
 
 				break;
 			case nnet0::Component::kAffineTransform:
+			case nnet0::Component::kSparseAffineTransform:
 				// get the component
 				aff_t = (nnet0::AffineTransform*)(nnet->components_[n]);
 				dim = aff_t->linearity_.Dim();
@@ -0,0 +1,174 @@
+// lm/nnlm-lattice-rescorer-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdio>
+
+#include "base/kaldi-math.h"
+#include "lat/lattice-functions.h"
+#include "lm/nnlm-lattice-rescorer.h"
+#include "nnet0/nnet-nnet.h"
+#include "util/kaldi-io.h"
+
+namespace kaldi {
+
+// lstmlm words: <s> <unk> and </s>, then 7 words in 3 classes; the lattices
+// use the labels 1..9, labels 8 and 9 are not in the lstmlm.
+static const int32 kNumLabels = 9;
+
+static void WriteTextFile(const std::string &filename, const std::string &text) {
+  Output ko(filename, false);
+  ko.Stream() << text;
+}
+
+static KaldiNNlmWrapper *CreateRandomLstmLm() {
+  WriteTextFile("tmp-nnlm.proto",
+                "<NnetProto>\n"
+                "<WordVectorTransform> <InputDim> 1 <OutputDim> 8 <VocabSize> 10\n"
+                "<LstmProjectedStreamsFast> <InputDim> 8 <OutputDim> 6 <CellDim> 12 <ParamScale> 0.5\n"
+                "<ClassAffineTransform> <InputDim> 6 <OutputDim> 13 <Class> 3\n"
+                "</NnetProto>\n");
+  nnet0::Nnet nnet;
+  nnet.Init("tmp-nnlm.proto");
+  nnet.Write("tmp-nnlm.nnet", true);
+
+  WriteTextFile("tmp-nnlm.class-boundary", "[ 0 4 8 10 ]\n");
+  WriteTextFile("tmp-nnlm.class-constant", "[ 1.5 0.5 -0.5 2.0 ]\n");
+  WriteTextFile("tmp-nnlm.lm-words",
+                "<s> 0\n<unk> 1\n</s> 2\na 3\nb 4\nc 5\nd 6\ne 7\nf 8\ng 9\n");
+  WriteTextFile("tmp-nnlm.words",
+                "<eps> 0\na 1\nb 2\nc 3\nd 4\ne 5\nf 6\ng 7\nx 8\ny 9\n");
+
+  KaldiNNlmWrapperOpts opts;
+  opts.class_boundary = "tmp-nnlm.class-boundary";
+  opts.class_constant = "tmp-nnlm.class-constant";
+  return new KaldiNNlmWrapper(opts, "", "tmp-nnlm.words", "tmp-nnlm.lm-words",
+                              "tmp-nnlm.nnet");
+}
+
+static void RemoveLstmLmFiles() {
+  const char *files[] = { "tmp-nnlm.proto", "tmp-nnlm.nnet",
+                          "tmp-nnlm.class-boundary", "tmp-nnlm.class-constant",
+                          "tmp-nnlm.lm-words", "tmp-nnlm.words" };
+  for (int32 i = 0; i < 6; i++)
+    std::remove(files[i]);
+}
+
+// A random acyclic lattice in which many paths share word histories.
+static void RandomCompactLattice(CompactLattice *clat) {
+  typedef CompactLatticeArc::Weight Weight;
+  clat->DeleteStates();
+  int32 num_states = RandInt(2, 8);
+  for (int32 s = 0; s < num_states; s++)
+    clat->AddState();
+  clat->SetStart(0);
+  for (int32 s = 0; s + 1 < num_states; s++) {
+    int32 num_arcs = RandInt(1, 3);
+    for (int32 a = 0; a < num_arcs; a++) {
+      int32 label = (RandInt(0, 4) == 0 ? 0 : RandInt(1, kNumLabels));
+      std::vector<int32> alignment(RandInt(1, 3), s + 1);
+      Weight weight(LatticeWeight(RandUniform(), RandUniform()), alignment);
+      clat->AddArc(s, CompactLatticeArc(label, label, weight,
+                                        RandInt(s + 1, num_states - 1)));
+    }
+  }
+  clat->SetFinal(num_states - 1, Weight(LatticeWeight(RandUniform(), 0.0),
+                                        std::vector<int32>()));
+  if (num_states > 2 && RandInt(0, 1) == 0)
+    clat->SetFinal(num_states - 2, Weight::One());
+  fst::ArcSort(clat, fst::OLabelCompare<CompactLatticeArc>());
+}
+
+void UnitTestNNlmHistoryCache() {
+  std::vector<int32> rdim(1, 3), cdim(1, 4);
+  NNlmHistoryCache cache(2);
+  LstmLmHistroy context(rdim, cdim);
+  std::vector<int32> k1(1, 1), k2(2, 2), k3(3, 3);
+  KALDI_ASSERT(!cache.Find(k1, &context));
+
+  for (int32 k = 1; k <= 3; k++) {
+    LstmLmHistroy c(rdim, cdim);
+    c.his_recurrent[0].Set(k);
+    cache.Insert(std::vector<int32>(k, k), &c);
+    if (k == 2)  // k1 becomes the most recently used, k2 is evicted next.
+      KALDI_ASSERT(cache.Find(k1, &context) && context.his_recurrent[0](0) == 1);
+  }
+  KALDI_ASSERT(cache.Size() == 2);
+  KALDI_ASSERT(cache.Find(k1, &context) && context.his_recurrent[0](2) == 1);
+  KALDI_ASSERT(cache.Find(k3, &context) && context.his_recurrent[0](0) == 3);
+  KALDI_ASSERT(!cache.Find(k2, &context));
+  KALDI_ASSERT(cache.Hits() == 3 && cache.Misses() == 2);
+
+  NNlmHistoryCache disabled(0);
+  disabled.Insert(k1, &context);
+  KALDI_ASSERT(disabled.Size() == 0 && !disabled.Find(k1, &context));
+}
+
+// The batched rescoring must give what composing each lattice on its own
+// with a NNlmDeterministicFst gives, whatever the lattices are batched with.
+void UnitTestNNlmLatticeRescorer(KaldiNNlmWrapper *lstmlm) {
+  int32 num_lats = 12;
+  std::vector<CompactLattice> clats(num_lats);
+  for (int32 n = 0; n < num_lats; n++)
+    RandomCompactLattice(&clats[n]);
+
+  for (int32 order = 0; order <= 3; order += 3) {
+    std::vector<CompactLattice> ref(num_lats);
+    for (int32 n = 0; n < num_lats; n++) {
+      NNlmDeterministicFst lstmlm_fst(order, lstmlm);
+      ComposeCompactLatticeDeterministic(clats[n], &lstmlm_fst, &ref[n]);
+    }
+
+    NNlmRescoreOptions opts;
+    opts.max_ngram_order = order;
+    opts.batch_size = RandInt(1, 7);
+    opts.cache_size = RandInt(0, 1) * 50;
+    NNlmLatticeRescorer rescorer(opts, lstmlm);
+    // twice over, the second time in reverse and with the cache filled.
+    for (int32 pass = 0; pass < 2; pass++) {
+      for (int32 start = 0; start < num_lats; ) {
+        int32 size = std::min(RandInt(1, 5), num_lats - start);
+        std::vector<const CompactLattice*> batch;
+        std::vector<int32> index;
+        for (int32 i = start; i < start + size; i++) {
+          index.push_back(pass == 0 ? i : num_lats - 1 - i);
+          batch.push_back(&clats[index.back()]);
+        }
+        std::vector<CompactLattice> composed;
+        rescorer.Rescore(batch, &composed);
+        KALDI_ASSERT(composed.size() == batch.size());
+        for (int32 i = 0; i < size; i++)
+          KALDI_ASSERT(fst::Equal(composed[i], ref[index[i]], 1.0e-03));
+        start += size;
+      }
+    }
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestNNlmHistoryCache();
+  KaldiNNlmWrapper *lstmlm = CreateRandomLstmLm();
+  for (int32 i = 0; i < 5; i++)
+    UnitTestNNlmLatticeRescorer(lstmlm);
+  delete lstmlm;
+  RemoveLstmLmFiles();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,258 @@
+// lm/nnlm-lattice-rescorer.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+
+#include "lm/nnlm-lattice-rescorer.h"
+
+namespace kaldi {
+
+bool NNlmHistoryCache::Find(const Key &key, LstmLmHistroy *context) {
+  MapType::iterator iter = map_.find(key);
+  if (iter == map_.end()) {
+    misses_++;
+    return false;
+  }
+  hits_++;
+  list_.splice(list_.begin(), list_, iter->second);
+  *context = iter->second->second;
+  return true;
+}
+
+void NNlmHistoryCache::Insert(const Key &key, LstmLmHistroy *context) {
+  if (capacity_ <= 0)
+    return;
+  MapType::iterator iter = map_.find(key);
+  if (iter != map_.end()) {
+    list_.splice(list_.begin(), list_, iter->second);
+  } else {
+    list_.push_front(std::make_pair(key, LstmLmHistroy()));
+    map_[key] = list_.begin();
+    if (map_.size() > static_cast<size_t>(capacity_)) {
+      map_.erase(list_.back().first);
+      list_.pop_back();
+    }
+  }
+  LstmLmHistroy &entry = list_.front().second;
+  entry.his_recurrent.swap(context->his_recurrent);
+  entry.his_cell.swap(context->his_cell);
+}
+
+NNlmLatticeRescorer::NNlmLatticeRescorer(const NNlmRescoreOptions &opts,
+                                         KaldiNNlmWrapper *nnlm):
+    opts_(opts), nnlm_(nnlm), cache_(opts.cache_size),
+    zero_context_(nnlm->GetRDim(), nnlm->GetCDim(), kSetZero),
+    num_lattices_(0), num_forwards_(0), num_forwarded_(0) {
+  KALDI_ASSERT(opts_.batch_size > 0);
+}
+
+NNlmLatticeRescorer::~NNlmLatticeRescorer() {
+  ClearLmStates();
+}
+
+int32 NNlmLatticeRescorer::FindOrAddLmState(int32 lat, int32 parent,
+                                             int32 label) {
+  std::vector<int32> wseq;
+  if (parent >= 0) {
+    wseq = lm_states_[parent].wseq;
+    wseq.push_back(label);
+    if (opts_.max_ngram_order > 0) {
+      // History state has at most <max_ngram_order> - 1 words in the state.
+      while (wseq.size() >= opts_.max_ngram_order)
+        wseq.erase(wseq.begin(), wseq.begin() + 1);
+    }
+  }
+
+  std::pair<MapType::iterator, bool> result =
+      wseq_to_state_[lat].insert(std::make_pair(wseq, lm_states_.size()));
+  if (!result.second)
+    return result.first->second;
+
+  LmState state;
+  state.wseq = wseq;
+  state.context = FindOrAddContext(
+      parent >= 0 ? lm_states_[parent].context : -1, label);
+  lm_states_.push_back(state);
+  return result.first->second;
+}
+
+int32 NNlmLatticeRescorer::FindOrAddContext(int32 parent, int32 label) {
+  std::vector<int32> history;
+  if (parent >= 0) {
+    history = contexts_[parent].history;
+    history.push_back(label);
+  }
+
+  std::pair<MapType::iterator, bool> result =
+      history_to_context_.insert(std::make_pair(history, contexts_.size()));
+  if (!result.second)
+    return result.first->second;
+
+  LmContext context;
+  context.history = history;
+  context.context = new LstmLmHistroy(nnlm_->GetRDim(), nnlm_->GetCDim(),
+                                      kUndefined);
+  context.parent = parent;
+  context.word = (parent >= 0 ? nnlm_->GetWordId(label) : nnlm_->GetSos());
+  if (!cache_.Find(history, context.context))
+    pending_.push_back(contexts_.size());
+  contexts_.push_back(context);
+  return result.first->second;
+}
+
+void NNlmLatticeRescorer::ForwardPending() {
+  std::vector<int32> words;
+  std::vector<LstmLmHistroy*> context_in, context_out;
+  for (size_t start = 0; start < pending_.size(); start += opts_.batch_size) {
+    size_t end = std::min(pending_.size(), start + opts_.batch_size);
+    words.clear();
+    context_in.clear();
+    context_out.clear();
+    for (size_t i = start; i < end; i++) {
+      const LmContext &context = contexts_[pending_[i]];
+      words.push_back(context.word);
+      context_in.push_back(context.parent >= 0 ?
+                           contexts_[context.parent].context : &zero_context_);
+      context_out.push_back(context.context);
+    }
+    nnlm_->ForwardMseq(words, context_in, context_out);
+    num_forwards_++;
+    num_forwarded_ += words.size();
+  }
+  pending_.clear();
+}
+
+void NNlmLatticeRescorer::ClearLmStates() {
+  // the contexts are all forwarded by now, the cache may have them.
+  for (size_t i = 0; i < contexts_.size(); i++) {
+    cache_.Insert(contexts_[i].history, contexts_[i].context);
+    delete contexts_[i].context;
+  }
+  contexts_.clear();
+  history_to_context_.clear();
+  lm_states_.clear();
+  wseq_to_state_.clear();
+  pending_.clear();
+}
+
+void NNlmLatticeRescorer::Rescore(
+    const std::vector<const CompactLattice*> &clats,
+    std::vector<CompactLattice> *composed_clats) {
+  typedef CompactLatticeArc::StateId StateId;
+  typedef CompactLatticeArc::Weight Weight;
+  // (lattice state, lm state)
+  typedef std::pair<StateId, int32> StatePair;
+  typedef unordered_map<StatePair, StateId, PairHasher<StateId, int32> > StateMap;
+
+  int32 num_lats = clats.size();
+  KALDI_ASSERT(composed_clats != NULL);
+  composed_clats->clear();
+  composed_clats->resize(num_lats);
+  std::vector<StateMap> state_maps(num_lats);
+  std::vector<std::vector<StatePair> > queues(num_lats);
+  std::vector<StatePair> next_queue;
+
+  wseq_to_state_.resize(num_lats);
+  for (int32 n = 0; n < num_lats; n++) {
+    const CompactLattice &clat = *clats[n];
+    CompactLattice &composed = (*composed_clats)[n];
+    if (clat.Start() == fst::kNoStateId)
+      continue;
+    StatePair start_pair(clat.Start(), FindOrAddLmState(n, -1, 0));
+    StateId start_state = composed.AddState();
+    composed.SetStart(start_state);
+    state_maps[n][start_pair] = start_state;
+    queues[n].push_back(start_pair);
+  }
+
+  const BaseFloat inf = std::numeric_limits<BaseFloat>::infinity();
+  bool active = true;
+  while (active) {
+    // the histories created by the previous round.
+    ForwardPending();
+
+    active = false;
+    for (int32 n = 0; n < num_lats; n++) {
+      const CompactLattice &clat = *clats[n];
+      CompactLattice &composed = (*composed_clats)[n];
+      StateMap &state_map = state_maps[n];
+      std::vector<StatePair> &queue = queues[n];
+      next_queue.clear();
+
+      for (size_t q = 0; q < queue.size(); q++) {
+        StateId s1 = queue[q].first;
+        int32 s2 = queue[q].second;
+        StateId s = state_map[queue[q]];
+        LstmLmHistroy *context = contexts_[lm_states_[s2].context].context;
+
+        Weight clat_final = clat.Final(s1);
+        if (clat_final.Weight().Value1() != inf) {
+          BaseFloat logprob = nnlm_->GetLogProb(nnlm_->GetEos(), context, NULL);
+          composed.SetFinal(s, Weight(LatticeWeight(
+              clat_final.Weight().Value1() - logprob,
+              clat_final.Weight().Value2()), clat_final.String()));
+        }
+
+        for (fst::ArcIterator<CompactLattice> aiter(clat, s1);
+             !aiter.Done(); aiter.Next()) {
+          const CompactLatticeArc &arc1 = aiter.Value();
+          CompactLatticeArc arc(arc1);
+          int32 next_state2 = s2;
+          if (arc1.olabel != 0) {
+            next_state2 = FindOrAddLmState(n, s2, arc1.olabel);
+            BaseFloat logprob = nnlm_->GetLogProb(
+                nnlm_->GetWordId(arc1.olabel), context, NULL);
+            arc.weight = Weight(LatticeWeight(
+                arc1.weight.Weight().Value1() - logprob,
+                arc1.weight.Weight().Value2()), arc1.weight.String());
+          }
+
+          StatePair next_pair(arc1.nextstate, next_state2);
+          StateMap::iterator siter = state_map.find(next_pair);
+          if (siter == state_map.end()) {
+            arc.nextstate = composed.AddState();
+            state_map[next_pair] = arc.nextstate;
+            next_queue.push_back(next_pair);
+          } else {
+            arc.nextstate = siter->second;
+          }
+          composed.AddArc(s, arc);
+        }
+      }
+      queue.swap(next_queue);
+      if (!queue.empty())
+        active = true;
+    }
+  }
+
+  for (int32 n = 0; n < num_lats; n++)
+    fst::Connect(&(*composed_clats)[n]);
+  num_lattices_ += num_lats;
+  ClearLmStates();
+}
+
+void NNlmLatticeRescorer::PrintStats() const {
+  KALDI_LOG << "Rescored " << num_lattices_ << " lattices with "
+            << num_forwarded_ << " lstmlm forwards in " << num_forwards_
+            << " batches (" << (num_forwards_ > 0 ? num_forwarded_ /
+                static_cast<double>(num_forwards_) : 0.0)
+            << " on average); history cache hits " << cache_.Hits()
+            << ", misses " << cache_.Misses() << ", size " << cache_.Size();
+}
+
+}  // namespace kaldi
@@ -0,0 +1,161 @@
+// lm/nnlm-lattice-rescorer.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LM_NNLM_LATTICE_RESCORER_H_
+#define KALDI_LM_NNLM_LATTICE_RESCORER_H_
+
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "lat/kaldi-lattice.h"
+#include "lm/kaldi-nnlm.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+struct NNlmRescoreOptions {
+  int32 max_ngram_order;
+  int32 batch_size;
+  int32 cache_size;
+  int32 num_lattices;
+
+  NNlmRescoreOptions(): max_ngram_order(3), batch_size(256),
+                        cache_size(1000), num_lattices(8) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("max-ngram-order", &max_ngram_order, "If positive, limit the "
+                   "lstmlm context to the given number, -1 means we are not going "
+                   "to limit it.");
+    opts->Register("batch-size", &batch_size, "Maximum number of word histories "
+                   "forwarded through the lstmlm in one call.");
+    opts->Register("cache-size", &cache_size, "Number of lstmlm hidden states "
+                   "kept across lattices, keyed by the full word history, least "
+                   "recently used first out; 0 disables the cache.");
+    opts->Register("num-lattices", &num_lattices, "Number of lattices rescored "
+                   "together; their lstmlm queries share the forward batches.");
+  }
+};
+
+/// LRU cache of lstmlm hidden states, keyed by the word history that leads
+/// to them.
+class NNlmHistoryCache {
+ public:
+  typedef std::vector<int32> Key;
+
+  explicit NNlmHistoryCache(int32 capacity):
+    capacity_(capacity), hits_(0), misses_(0) { }
+
+  /// Copies the state of 'key' into 'context' and makes it the most recently
+  /// used one; returns false if it is not cached.
+  bool Find(const Key &key, LstmLmHistroy *context);
+
+  /// Caches the state of 'key', taking the contents of 'context' (which is
+  /// left with whatever was cached for 'key' before, if anything).
+  void Insert(const Key &key, LstmLmHistroy *context);
+
+  size_t Size() const { return map_.size(); }
+  int64 Hits() const { return hits_; }
+  int64 Misses() const { return misses_; }
+
+ private:
+  typedef std::list<std::pair<Key, LstmLmHistroy> > ListType;
+  typedef unordered_map<Key, ListType::iterator, VectorHasher<int32> > MapType;
+
+  int32 capacity_;
+  ListType list_;  // most recently used first
+  MapType map_;
+  int64 hits_, misses_;
+};
+
+/**
+ * NNlmLatticeRescorer composes compact lattices with an lstmlm, like
+ * ComposeCompactLatticeDeterministic() does with an NNlmDeterministicFst, but
+ * breadth first over a batch of lattices.  Each round expands all queued
+ * states of all lattices; the word histories that this creates and that are
+ * not cached are then forwarded together with KaldiNNlmWrapper::ForwardMseq(),
+ * in chunks of --batch-size.  A history reached from several lattice states,
+ * or from several lattices of the batch, is forwarded only once.
+ *
+ * The lm states of each lattice are keyed by the history truncated to
+ * --max-ngram-order - 1 words, and the hidden state of the first full history
+ * reached for a key is used for all the paths that share it, as with a
+ * NNlmDeterministicFst per lattice.  The hidden states themselves are shared
+ * and cached by the full history, so a lattice gets the same result whatever
+ * it is rescored with.
+ */
+class NNlmLatticeRescorer {
+ public:
+  // Does not take ownership of 'nnlm'.
+  NNlmLatticeRescorer(const NNlmRescoreOptions &opts, KaldiNNlmWrapper *nnlm);
+  ~NNlmLatticeRescorer();
+
+  /// Composes each of 'clats' with the lstmlm, adding the negated lm log-probs
+  /// to the graph costs.  The outputs are connected but not determinized.
+  void Rescore(const std::vector<const CompactLattice*> &clats,
+               std::vector<CompactLattice> *composed_clats);
+
+  void PrintStats() const;
+
+ private:
+  // The hidden state after the full word history 'history'.
+  struct LmContext {
+    std::vector<int32> history;
+    LstmLmHistroy *context;
+    int32 parent;  // the context 'word' is forwarded from, -1 for <s>
+    int32 word;    // lm word id
+  };
+
+  // An lm state of one lattice, with the context it got when it was created.
+  struct LmState {
+    std::vector<int32> wseq;
+    int32 context;
+  };
+
+  // Returns the state of lattice 'lat' for the history of 'parent' followed
+  // by 'label', adds it if it is new.
+  int32 FindOrAddLmState(int32 lat, int32 parent, int32 label);
+  // Returns the context of the history of context 'parent' followed by
+  // 'label', adds it (and queues its forward if it is not cached) if it is new.
+  int32 FindOrAddContext(int32 parent, int32 label);
+  // Forwards the queued histories.
+  void ForwardPending();
+  // Moves the hidden states of this batch into the cache and clears them.
+  void ClearLmStates();
+
+  typedef unordered_map<std::vector<int32>, int32, VectorHasher<int32> > MapType;
+
+  NNlmRescoreOptions opts_;
+  KaldiNNlmWrapper *nnlm_;
+  NNlmHistoryCache cache_;
+  LstmLmHistroy zero_context_;
+
+  std::vector<LmContext> contexts_;
+  MapType history_to_context_;
+  std::vector<LmState> lm_states_;
+  std::vector<MapType> wseq_to_state_;  // one per lattice
+  std::vector<int32> pending_;          // contexts to forward
+
+  int64 num_lattices_, num_forwards_, num_forwarded_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NNlmLatticeRescorer);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_LM_NNLM_LATTICE_RESCORER_H_
@@ -59,6 +59,11 @@ int main(int argc, char *argv[]) {
     po.Register("eos-symbol", &options.eos_symbol,
                 "Integer corresponds to </s>. You must set this to your actual "
                 "EOS integer.");
+    bool mappable = false;
+    po.Register("mappable", &mappable,
+                "If true, write a layout that programs can memory-map "
+                "(see --mmap-lm), sharing the memory between processes. "
+                "Older programs cannot read it.");
 
     po.Read(argc, argv);
 
@@ -76,7 +81,7 @@ int main(int argc, char *argv[]) {
         const_arpa_wxfilename = po.GetOptArg(2);
 
     bool ans = BuildConstArpaLm(options, arpa_rxfilename,
-                                const_arpa_wxfilename);
+                                const_arpa_wxfilename, mappable);
     if (ans)
       return 0;
     else
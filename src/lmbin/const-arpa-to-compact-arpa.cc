@@ -0,0 +1,65 @@
+// lmbin/const-arpa-to-compact-arpa.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABILITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "lm/compact-arpa-lm.h"
+#include "util/common-utils.h"
+
+int main(int argc, char *argv[]) {
+  using namespace kaldi;
+  typedef kaldi::int32 int32;
+  try {
+    const char *usage  =
+        "Converts a ConstArpaLm format language model (see arpa-to-const-arpa)\n"
+        "into the CompactArpaLm format, which quantizes the probabilities and\n"
+        "packs the n-grams into fewer bits.  Programs that take --compact-lm\n"
+        "can use it in place of the ConstArpaLm.\n"
+        "\n"
+        "Usage: const-arpa-to-compact-arpa [opts] <const-arpa> <compact-arpa>\n"
+        " e.g.: const-arpa-to-compact-arpa --prob-bits=8 G.carpa G.compact\n";
+
+    ParseOptions po(usage);
+    bool binary = true;
+    CompactArpaLmOptions opts;
+    po.Register("binary", &binary, "Write output in binary mode");
+    opts.Register(&po);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string const_arpa_rxfilename = po.GetArg(1),
+        compact_arpa_wxfilename = po.GetArg(2);
+
+    ConstArpaLm const_arpa;
+    ReadKaldiObject(const_arpa_rxfilename, &const_arpa);
+    CompactArpaLm compact_arpa(opts, const_arpa);
+    WriteKaldiObject(compact_arpa, compact_arpa_wxfilename, binary);
+
+    KALDI_LOG << "Converted " << const_arpa.NgramOrder() << "-gram language "
+              << "model of " << const_arpa.MemorySize() << " bytes into "
+              << compact_arpa.MemorySize() << " bytes.";
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
@@ -0,0 +1,307 @@
+// matrix/block-sparse-matrix.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+
+#include "matrix/block-sparse-matrix.h"
+#include "matrix/simd-math.h"
+
+// The kernels are compiled with a function-level target attribute, as in
+// simd-math.cc.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KALDI_BLOCK_SPARSE_X86 1
+#include <immintrin.h>
+#define KALDI_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace kaldi {
+
+template<typename Real>
+void BlockSparseMatrix<Real>::CopyFromMat(const MatrixBase<Real> &mat,
+                                          int32 block_rows,
+                                          int32 block_cols) {
+  KALDI_ASSERT(block_rows > 0 && block_cols > 0);
+  num_rows_ = mat.NumRows();
+  num_cols_ = mat.NumCols();
+  block_rows_ = block_rows;
+  block_cols_ = block_cols;
+  row_start_.clear();
+  block_col_.clear();
+  values_.clear();
+  size_t block_size = static_cast<size_t>(block_rows) * block_cols;
+  for (MatrixIndexT r = 0; r < num_rows_; r += block_rows) {
+    row_start_.push_back(block_col_.size());
+    MatrixIndexT height = std::min<MatrixIndexT>(block_rows, num_rows_ - r);
+    for (MatrixIndexT c = 0; c < num_cols_; c += block_cols) {
+      MatrixIndexT width = std::min<MatrixIndexT>(block_cols, num_cols_ - c);
+      bool nonzero = false;
+      for (MatrixIndexT i = 0; i < height && !nonzero; i++) {
+        const Real *row = mat.RowData(r + i) + c;
+        for (MatrixIndexT j = 0; j < width; j++)
+          if (row[j] != 0) { nonzero = true; break; }
+      }
+      if (!nonzero) continue;
+      block_col_.push_back(c);
+      values_.resize(values_.size() + block_size, 0);
+      Real *block = &(values_[values_.size() - block_size]);
+      for (MatrixIndexT i = 0; i < height; i++)
+        for (MatrixIndexT j = 0; j < width; j++)
+          block[j * block_rows + i] = mat(r + i, c + j);
+    }
+  }
+  row_start_.push_back(block_col_.size());
+}
+
+template<typename Real>
+void BlockSparseMatrix<Real>::CopyToMat(MatrixBase<Real> *mat) const {
+  KALDI_ASSERT(mat->NumRows() == num_rows_ && mat->NumCols() == num_cols_);
+  mat->SetZero();
+  size_t block_size = static_cast<size_t>(block_rows_) * block_cols_;
+  for (size_t b = 0; b + 1 < row_start_.size(); b++) {
+    MatrixIndexT r = b * block_rows_,
+        height = std::min<MatrixIndexT>(block_rows_, num_rows_ - r);
+    for (int32 n = row_start_[b]; n < row_start_[b + 1]; n++) {
+      MatrixIndexT c = block_col_[n],
+          width = std::min<MatrixIndexT>(block_cols_, num_cols_ - c);
+      const Real *block = &(values_[n * block_size]);
+      for (MatrixIndexT i = 0; i < height; i++)
+        for (MatrixIndexT j = 0; j < width; j++)
+          (*mat)(r + i, c + j) = block[j * block_rows_ + i];
+    }
+  }
+}
+
+template<typename Real>
+void BlockSparseMatrix<Real>::Clear() {
+  num_rows_ = 0;
+  num_cols_ = 0;
+  std::vector<int32>().swap(row_start_);
+  std::vector<MatrixIndexT>().swap(block_col_);
+  std::vector<Real>().swap(values_);
+}
+
+namespace {
+
+// Writes the block of C given by "acc" (num_frames by "width" elements, with
+// stride "acc_stride"): C = alpha acc + beta C.
+template<typename Real>
+void WriteBlock(MatrixIndexT num_frames, MatrixIndexT width, const Real *acc,
+                MatrixIndexT acc_stride, Real alpha, Real beta, Real *c,
+                MatrixIndexT c_stride) {
+  for (MatrixIndexT f = 0; f < num_frames; f++, acc += acc_stride,
+           c += c_stride) {
+    if (beta == 0) {
+      for (MatrixIndexT i = 0; i < width; i++)
+        c[i] = alpha * acc[i];
+    } else {
+      for (MatrixIndexT i = 0; i < width; i++)
+        c[i] = alpha * acc[i] + beta * c[i];
+    }
+  }
+}
+
+// The frames of A are processed this many at a time, so that each block of B
+// is read once per group.
+const MatrixIndexT kFrameBlock = 8;
+
+#ifdef KALDI_BLOCK_SPARSE_X86
+// Sums the products of NumFrames rows of A (from "a", with stride "a_stride")
+// and the blocks of one block row of B, 8 rows high, into acc (NumFrames by 8);
+// one 8-float accumulator per frame.
+template<int NumFrames>
+KALDI_AVX2 void KernelRows8(const float *a, MatrixIndexT a_stride,
+                            const MatrixIndexT *block_col, int32 num_blocks,
+                            const float *values, int32 block_cols,
+                            MatrixIndexT num_cols, float *acc) {
+  __m256 sum[NumFrames];
+  for (int f = 0; f < NumFrames; f++)
+    sum[f] = _mm256_setzero_ps();
+  for (int32 n = 0; n < num_blocks; n++, values += 8 * block_cols) {
+    MatrixIndexT c = block_col[n],
+        width = std::min<MatrixIndexT>(block_cols, num_cols - c);
+    for (MatrixIndexT j = 0; j < width; j++) {
+      __m256 w = _mm256_loadu_ps(values + 8 * j);
+      for (int f = 0; f < NumFrames; f++)
+        sum[f] = _mm256_fmadd_ps(_mm256_broadcast_ss(a + f * a_stride + c + j),
+                                 w, sum[f]);
+    }
+  }
+  for (int f = 0; f < NumFrames; f++)
+    _mm256_storeu_ps(acc + 8 * f, sum[f]);
+  _mm256_zeroupper();
+}
+
+// As KernelRows8(), for blocks 4 rows high.
+template<int NumFrames>
+KALDI_AVX2 void KernelRows4(const float *a, MatrixIndexT a_stride,
+                            const MatrixIndexT *block_col, int32 num_blocks,
+                            const float *values, int32 block_cols,
+                            MatrixIndexT num_cols, float *acc) {
+  __m128 sum[NumFrames];
+  for (int f = 0; f < NumFrames; f++)
+    sum[f] = _mm_setzero_ps();
+  for (int32 n = 0; n < num_blocks; n++, values += 4 * block_cols) {
+    MatrixIndexT c = block_col[n],
+        width = std::min<MatrixIndexT>(block_cols, num_cols - c);
+    for (MatrixIndexT j = 0; j < width; j++) {
+      __m128 w = _mm_loadu_ps(values + 4 * j);
+      for (int f = 0; f < NumFrames; f++)
+        sum[f] = _mm_fmadd_ps(_mm_broadcast_ss(a + f * a_stride + c + j),
+                              w, sum[f]);
+    }
+  }
+  for (int f = 0; f < NumFrames; f++)
+    _mm_storeu_ps(acc + 8 * f, sum[f]);
+}
+
+typedef void (*KernelFn)(const float *a, MatrixIndexT a_stride,
+                         const MatrixIndexT *block_col, int32 num_blocks,
+                         const float *values, int32 block_cols,
+                         MatrixIndexT num_cols, float *acc);
+
+KernelFn GetKernel(int32 block_rows, MatrixIndexT num_frames) {
+  static const KernelFn rows8[kFrameBlock] = {
+    KernelRows8<1>, KernelRows8<2>, KernelRows8<3>, KernelRows8<4>,
+    KernelRows8<5>, KernelRows8<6>, KernelRows8<7>, KernelRows8<8> };
+  static const KernelFn rows4[kFrameBlock] = {
+    KernelRows4<1>, KernelRows4<2>, KernelRows4<3>, KernelRows4<4>,
+    KernelRows4<5>, KernelRows4<6>, KernelRows4<7>, KernelRows4<8> };
+  return (block_rows == 8 ? rows8 : rows4)[num_frames - 1];
+}
+#endif  // KALDI_BLOCK_SPARSE_X86
+
+// Whether there is a kernel for these blocks.
+template<typename Real> bool HaveKernel(int32 block_rows) { return false; }
+
+#ifdef KALDI_BLOCK_SPARSE_X86
+template<> bool HaveKernel<float>(int32 block_rows) {
+  return (block_rows == 8 || block_rows == 4) &&
+      GetSimdMathLevel() >= kSimdMathAvx2;
+}
+#endif
+
+}  // namespace
+
+template<typename Real>
+void AddMatBlockSparseMatTrans(Real alpha, const MatrixBase<Real> &A,
+                               const BlockSparseMatrix<Real> &B, Real beta,
+                               MatrixBase<Real> *C) {
+  KALDI_ASSERT(A.NumCols() == B.NumCols() && C->NumCols() == B.NumRows() &&
+               C->NumRows() == A.NumRows());
+  KALDI_ASSERT(A.Data() != C->Data());
+  MatrixIndexT num_frames = A.NumRows(), num_rows = B.NumRows(),
+      num_cols = B.NumCols();
+  int32 block_rows = B.BlockRows(), block_cols = B.BlockCols();
+  size_t block_size = static_cast<size_t>(block_rows) * block_cols;
+  bool use_kernel = HaveKernel<Real>(block_rows);
+  // acc holds the sums for up to kFrameBlock frames; the kernels use a stride
+  // of 8.
+  MatrixIndexT acc_stride = use_kernel ? 8 : block_rows;
+  std::vector<Real> acc(kFrameBlock * acc_stride);
+  for (MatrixIndexT f = 0; f < num_frames; f += kFrameBlock) {
+    MatrixIndexT frames = std::min(kFrameBlock, num_frames - f);
+    const Real *a = A.RowData(f);
+    for (size_t b = 0; b + 1 < B.row_start_.size(); b++) {
+      MatrixIndexT r = b * block_rows,
+          height = std::min<MatrixIndexT>(block_rows, num_rows - r);
+      int32 begin = B.row_start_[b], num_blocks = B.row_start_[b + 1] - begin;
+      const MatrixIndexT *block_col = B.block_col_.data() + begin;
+      const Real *values = B.values_.data() + begin * block_size;
+#ifdef KALDI_BLOCK_SPARSE_X86
+      if (use_kernel) {
+        GetKernel(block_rows, frames)(
+            reinterpret_cast<const float*>(a), A.Stride(), block_col,
+            num_blocks, reinterpret_cast<const float*>(values), block_cols,
+            num_cols, reinterpret_cast<float*>(acc.data()));
+        WriteBlock(frames, height, acc.data(), acc_stride, alpha, beta,
+                   C->RowData(f) + r, C->Stride());
+        continue;
+      }
+#endif
+      std::fill(acc.begin(), acc.end(), Real(0));
+      for (MatrixIndexT g = 0; g < frames; g++) {
+        const Real *a_g = a + g * A.Stride();
+        Real *acc_g = acc.data() + g * acc_stride;
+        const Real *block = values;
+        for (int32 n = 0; n < num_blocks; n++, block += block_size) {
+          MatrixIndexT c = block_col[n],
+              width = std::min<MatrixIndexT>(block_cols, num_cols - c);
+          for (MatrixIndexT j = 0; j < width; j++) {
+            Real a_gj = a_g[c + j];
+            const Real *column = block + j * block_rows;
+            for (MatrixIndexT i = 0; i < block_rows; i++)
+              acc_g[i] += a_gj * column[i];
+          }
+        }
+      }
+      WriteBlock(frames, height, acc.data(), acc_stride, alpha, beta,
+                 C->RowData(f) + r, C->Stride());
+    }
+  }
+}
+
+template<typename Real>
+size_t PruneBlocks(BaseFloat sparsity, int32 block_rows, int32 block_cols,
+                   MatrixBase<Real> *mat) {
+  KALDI_ASSERT(sparsity >= 0.0 && sparsity <= 1.0 && block_rows > 0 &&
+               block_cols > 0);
+  MatrixIndexT num_rows = mat->NumRows(), num_cols = mat->NumCols(),
+      num_block_cols = (num_cols + block_cols - 1) / block_cols;
+  std::vector<std::pair<double, size_t> > norms;
+  for (MatrixIndexT r = 0; r < num_rows; r += block_rows) {
+    for (MatrixIndexT c = 0; c < num_cols; c += block_cols) {
+      SubMatrix<Real> block(*mat, r, std::min(block_rows, num_rows - r),
+                            c, std::min(block_cols, num_cols - c));
+      norms.push_back(std::make_pair(block.FrobeniusNorm(), norms.size()));
+    }
+  }
+  size_t num_pruned = static_cast<size_t>(sparsity * norms.size() + 0.5);
+  std::sort(norms.begin(), norms.end());
+  size_t num_zero = 0;
+  for (size_t n = 0; n < norms.size(); n++) {
+    if (n >= num_pruned && norms[n].first != 0.0) break;
+    num_zero++;
+    if (norms[n].first == 0.0) continue;
+    MatrixIndexT r = (norms[n].second / num_block_cols) * block_rows,
+        c = (norms[n].second % num_block_cols) * block_cols;
+    SubMatrix<Real>(*mat, r, std::min(block_rows, num_rows - r),
+                    c, std::min(block_cols, num_cols - c)).SetZero();
+  }
+  return num_zero;
+}
+
+template class BlockSparseMatrix<float>;
+template class BlockSparseMatrix<double>;
+
+template
+void AddMatBlockSparseMatTrans(float alpha, const MatrixBase<float> &A,
+                               const BlockSparseMatrix<float> &B, float beta,
+                               MatrixBase<float> *C);
+template
+void AddMatBlockSparseMatTrans(double alpha, const MatrixBase<double> &A,
+                               const BlockSparseMatrix<double> &B, double beta,
+                               MatrixBase<double> *C);
+
+template
+size_t PruneBlocks(BaseFloat sparsity, int32 block_rows, int32 block_cols,
+                   MatrixBase<float> *mat);
+template
+size_t PruneBlocks(BaseFloat sparsity, int32 block_rows, int32 block_cols,
+                   MatrixBase<double> *mat);
+
+}  // namespace kaldi
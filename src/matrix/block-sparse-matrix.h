@@ -0,0 +1,111 @@
+// matrix/block-sparse-matrix.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_BLOCK_SPARSE_MATRIX_H_
+#define KALDI_MATRIX_BLOCK_SPARSE_MATRIX_H_
+
+#include <vector>
+
+#include "matrix/kaldi-matrix.h"
+
+namespace kaldi {
+
+/// \addtogroup matrix_group
+/// @{
+
+/**
+   A matrix stored as its nonzero blocks, in "block compressed sparse row"
+   form: the matrix is divided into blocks of BlockRows() by BlockCols()
+   elements (those at the bottom and right edges may be partial), and only
+   the blocks with a nonzero element are kept, block row by block row.  With
+   1 by 1 blocks this is the usual CSR format.
+
+   This is for pruned weight matrices, which are multiplied by dense matrices
+   of inputs; see AddMatBlockSparseMatTrans().  Blocks of 8 by 1 or 4 by 4
+   give the vectorized kernel contiguous rows of the output to work on, and
+   pruning whole blocks loses little more accuracy than pruning single
+   weights (see PruneBlocks()).
+ */
+template<typename Real>
+class BlockSparseMatrix {
+ public:
+  BlockSparseMatrix(): num_rows_(0), num_cols_(0), block_rows_(1),
+                       block_cols_(1) { }
+
+  /// Keeps the blocks of "mat" that are not all zero.
+  void CopyFromMat(const MatrixBase<Real> &mat, int32 block_rows,
+                   int32 block_cols);
+
+  /// "mat" must have the right dimensions.
+  void CopyToMat(MatrixBase<Real> *mat) const;
+
+  MatrixIndexT NumRows() const { return num_rows_; }
+  MatrixIndexT NumCols() const { return num_cols_; }
+  int32 BlockRows() const { return block_rows_; }
+  int32 BlockCols() const { return block_cols_; }
+
+  /// The number of nonzero blocks.
+  size_t NumBlocks() const { return block_col_.size(); }
+
+  /// Frees the data; NumRows() is then zero.
+  void Clear();
+
+ private:
+  template<typename R>
+  friend void AddMatBlockSparseMatTrans(R alpha, const MatrixBase<R> &A,
+                                        const BlockSparseMatrix<R> &B, R beta,
+                                        MatrixBase<R> *C);
+
+  MatrixIndexT num_rows_;
+  MatrixIndexT num_cols_;
+  int32 block_rows_;
+  int32 block_cols_;
+  // The nonzero blocks of block row i are those from row_start_[i] to
+  // row_start_[i+1] - 1.
+  std::vector<int32> row_start_;
+  // The first column of each block.
+  std::vector<MatrixIndexT> block_col_;
+  // The elements of each block, column by column (block_rows_ * block_cols_
+  // per block, padded with zeros at the edges of the matrix).
+  std::vector<Real> values_;
+};
+
+/// Does C = alpha A B^T + beta C, as C->AddMatMat(alpha, A, kNoTrans, B,
+/// kTrans, beta) would with B dense; B is typically a weight matrix and the
+/// rows of A and C are frames.  The time is proportional to the number of
+/// nonzero blocks of B.  For float, if GetSimdMathLevel() (see simd-math.h)
+/// allows AVX2, blocks of 8 or 4 rows use a vectorized kernel.  As with
+/// BLAS, C is not read if beta is zero.
+template<typename Real>
+void AddMatBlockSparseMatTrans(Real alpha, const MatrixBase<Real> &A,
+                               const BlockSparseMatrix<Real> &B, Real beta,
+                               MatrixBase<Real> *C);
+
+/// Zeroes the blocks (block_rows by block_cols, partial at the edges) of
+/// "mat" with the smallest L2 norms, so that a fraction "sparsity" of all its
+/// blocks are zero; blocks that are already zero count.  This is the
+/// magnitude pruning used to get matrices for BlockSparseMatrix.  Returns the
+/// number of blocks that are zero.
+template<typename Real>
+size_t PruneBlocks(BaseFloat sparsity, int32 block_rows, int32 block_cols,
+                   MatrixBase<Real> *mat);
+
+/// @} end of \addtogroup matrix_group
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_BLOCK_SPARSE_MATRIX_H_
@@ -20,10 +20,396 @@
 // limitations under the License.
 
 #include "matrix/compressed-matrix.h"
+#include "matrix/simd-math.h"
 #include <algorithm>
 
+// The AVX2 versions of the compression and decompression loops, which are used
+// if GetSimdMathLevel() allows it, give exactly the same results as the scalar
+// code: they do the same float and double operations in the same order.  They
+// are compiled with function-level target attributes as in simd-math.cc; FMA
+// is deliberately not enabled, so that the compiler cannot fuse the
+// multiplications and additions, which would change the rounding.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KALDI_COMPRESSED_MATRIX_X86 1
+#include <immintrin.h>
+#define KALDI_AVX2 __attribute__((target("avx2")))
+#endif
+
 namespace kaldi {
 
+namespace {
+
+#ifdef KALDI_COMPRESSED_MATRIX_X86
+
+KALDI_AVX2 inline __m256 Combine(__m128 lo, __m128 hi) {
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+KALDI_AVX2 inline __m256 LoadAsFloat(const float *in) {
+  return _mm256_loadu_ps(in);
+}
+
+KALDI_AVX2 inline __m256 LoadAsFloat(const double *in) {
+  return Combine(_mm256_cvtpd_ps(_mm256_loadu_pd(in)),
+                 _mm256_cvtpd_ps(_mm256_loadu_pd(in + 4)));
+}
+
+KALDI_AVX2 inline void StoreFloat(__m256 f, float *out) {
+  _mm256_storeu_ps(out, f);
+}
+
+KALDI_AVX2 inline void StoreFloat(__m256 f, double *out) {
+  _mm256_storeu_pd(out, _mm256_cvtps_pd(_mm256_castps256_ps128(f)));
+  _mm256_storeu_pd(out + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)));
+}
+
+KALDI_AVX2 inline __m256i LoadCodes(const uint8 *in) {
+  return _mm256_cvtepu8_epi32(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in)));
+}
+
+KALDI_AVX2 inline __m256i LoadCodes(const uint16 *in) {
+  return _mm256_cvtepu16_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+}
+
+// Stores 8 codes in [0, 65535] (or INT_MIN, which becomes 0, as it does when
+// the scalar code casts it).
+KALDI_AVX2 inline void StoreCodes(__m256i codes, uint16 *out) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                   _mm_packus_epi32(_mm256_castsi256_si128(codes),
+                                    _mm256_extracti128_si256(codes, 1)));
+}
+
+// The same for codes in [0, 255].
+KALDI_AVX2 inline void StoreCodes(__m256i codes, uint8 *out) {
+  __m128i codes16 = _mm_packus_epi32(_mm256_castsi256_si128(codes),
+                                     _mm256_extracti128_si256(codes, 1));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(out),
+                   _mm_packus_epi16(codes16, codes16));
+}
+
+// Returns static_cast<int>(f + offset) for 8 floats f, the addition being done
+// in double as in expressions like "static_cast<int>(f * 255 + 0.499)".
+KALDI_AVX2 inline __m256i AddAndTruncate(__m256 f, double offset) {
+  __m256d d_offset = _mm256_set1_pd(offset);
+  __m128i lo = _mm256_cvttpd_epi32(_mm256_add_pd(
+      _mm256_cvtps_pd(_mm256_castps256_ps128(f)), d_offset)),
+      hi = _mm256_cvttpd_epi32(_mm256_add_pd(
+          _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)), d_offset));
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+// Transposes the 8 x 8 bytes in the lower halves of a[0] ... a[7].
+KALDI_AVX2 inline void Transpose8x8(__m128i a[8]) {
+  __m128i t0 = _mm_unpacklo_epi8(a[0], a[1]), t1 = _mm_unpacklo_epi8(a[2], a[3]),
+      t2 = _mm_unpacklo_epi8(a[4], a[5]), t3 = _mm_unpacklo_epi8(a[6], a[7]);
+  __m128i u0 = _mm_unpacklo_epi16(t0, t1), u1 = _mm_unpackhi_epi16(t0, t1),
+      u2 = _mm_unpacklo_epi16(t2, t3), u3 = _mm_unpackhi_epi16(t2, t3);
+  __m128i v0 = _mm_unpacklo_epi32(u0, u2), v1 = _mm_unpackhi_epi32(u0, u2),
+      v2 = _mm_unpacklo_epi32(u1, u3), v3 = _mm_unpackhi_epi32(u1, u3);
+  a[0] = v0;
+  a[1] = _mm_srli_si128(v0, 8);
+  a[2] = v1;
+  a[3] = _mm_srli_si128(v1, 8);
+  a[4] = v2;
+  a[5] = _mm_srli_si128(v2, 8);
+  a[6] = v3;
+  a[7] = _mm_srli_si128(v3, 8);
+}
+
+// Sets out[i] = min_value + in[i] * increment for the first dim - dim % 8
+// elements, and returns their number.
+template<typename Int, typename Real>
+KALDI_AVX2 MatrixIndexT DecodeUniformAvx2(const Int *in, MatrixIndexT dim,
+                                          float min_value, float increment,
+                                          Real *out) {
+  __m256 m = _mm256_set1_ps(min_value), inc = _mm256_set1_ps(increment);
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8)
+    StoreFloat(_mm256_add_ps(m, _mm256_mul_ps(
+        _mm256_cvtepi32_ps(LoadCodes(in + i)), inc)), out + i);
+  _mm256_zeroupper();
+  return i;
+}
+
+// Computes the codes FloatToUint16() (if max_code is 65535) or FloatToUint8()
+// (if it is 255) would give, for the first dim - dim % 8 elements, and returns
+// their number.
+template<typename Real, typename Int>
+KALDI_AVX2 MatrixIndexT EncodeUniformAvx2(const Real *in, MatrixIndexT dim,
+                                          float min_value, float range,
+                                          float max_code, Int *out) {
+  __m256 m = _mm256_set1_ps(min_value), r = _mm256_set1_ps(range),
+      zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f),
+      scale = _mm256_set1_ps(max_code);
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    __m256 f = _mm256_div_ps(_mm256_sub_ps(LoadAsFloat(in + i), m), r);
+    // In this order NaNs get through, as in the scalar code.
+    f = _mm256_max_ps(zero, _mm256_min_ps(one, f));
+    StoreCodes(AddAndTruncate(_mm256_mul_ps(f, scale), 0.499), out + i);
+  }
+  _mm256_zeroupper();
+  return i;
+}
+
+// Decompresses 8 columns in the kOneByteWithColHeaders format, whose
+// percentiles (as floats) are p0[c] ... p100[c]: sets out[r * out_stride + c]
+// to the value of byte_data[c * col_stride + r], as CharToFloat() gives it, for
+// the first num_rows - num_rows % 8 rows, and returns their number.
+template<typename Real>
+KALDI_AVX2 MatrixIndexT DecodeColumnsAvx2(
+    const float *p0, const float *p25, const float *p75, const float *p100,
+    const uint8 *byte_data, MatrixIndexT col_stride, MatrixIndexT num_rows,
+    Real *out, MatrixIndexT out_stride) {
+  __m256 f0 = _mm256_loadu_ps(p0), f25 = _mm256_loadu_ps(p25),
+      f75 = _mm256_loadu_ps(p75), f100 = _mm256_loadu_ps(p100);
+  // The slopes of the three ranges.
+  __m256 s1 = _mm256_sub_ps(f25, f0), s2 = _mm256_sub_ps(f75, f25),
+      s3 = _mm256_sub_ps(f100, f75);
+  // The starts of the ranges as doubles, for columns 0-3 and 4-7.
+  __m256d d0[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(f0)),
+                    _mm256_cvtps_pd(_mm256_extractf128_ps(f0, 1)) },
+      d25[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(f25)),
+                 _mm256_cvtps_pd(_mm256_extractf128_ps(f25, 1)) },
+      d75[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(f75)),
+                 _mm256_cvtps_pd(_mm256_extractf128_ps(f75, 1)) };
+  const __m256d scale1 = _mm256_set1_pd(1/64.0),
+      scale2 = _mm256_set1_pd(1/128.0), scale3 = _mm256_set1_pd(1/63.0);
+  const __m256i c64 = _mm256_set1_epi32(64), c192 = _mm256_set1_epi32(192);
+  MatrixIndexT r = 0;
+  for (; r + 8 <= num_rows; r += 8) {
+    __m128i bytes[8];
+    for (int32 c = 0; c < 8; c++)
+      bytes[c] = _mm_loadl_epi64(
+          reinterpret_cast<const __m128i*>(byte_data + c * col_stride + r));
+    Transpose8x8(bytes);
+    for (int32 k = 0; k < 8; k++) {
+      __m256i v = _mm256_cvtepu8_epi32(bytes[k]);
+      __m256i in2 = _mm256_cmpgt_epi32(v, c64),  // in range 2 or 3.
+          in3 = _mm256_cmpgt_epi32(v, c192);
+      __m256i offset = _mm256_blendv_epi8(_mm256_and_si256(in2, c64), c192,
+                                          in3);
+      __m256 slope = _mm256_blendv_ps(
+          _mm256_blendv_ps(s1, s2, _mm256_castsi256_ps(in2)), s3,
+          _mm256_castsi256_ps(in3));
+      // e.g. (p25 - p0) * value in float ...
+      __m256 b = _mm256_mul_ps(slope,
+                               _mm256_cvtepi32_ps(_mm256_sub_epi32(v, offset)));
+      __m128 half[2];
+      for (int32 h = 0; h < 2; h++) {
+        __m128i in2_h = h == 0 ? _mm256_castsi256_si128(in2) :
+            _mm256_extracti128_si256(in2, 1),
+            in3_h = h == 0 ? _mm256_castsi256_si128(in3) :
+            _mm256_extracti128_si256(in3, 1);
+        __m256d mask2 = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(in2_h)),
+            mask3 = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(in3_h));
+        __m256d start = _mm256_blendv_pd(_mm256_blendv_pd(d0[h], d25[h], mask2),
+                                         d75[h], mask3),
+            scale = _mm256_blendv_pd(_mm256_blendv_pd(scale1, scale2, mask2),
+                                     scale3, mask3);
+        __m256d b_h = _mm256_cvtps_pd(h == 0 ? _mm256_castps256_ps128(b) :
+                                      _mm256_extractf128_ps(b, 1));
+        // ... and p0 + that * (1/64.0) in double.
+        half[h] = _mm256_cvtpd_ps(_mm256_add_pd(start,
+                                                _mm256_mul_pd(b_h, scale)));
+      }
+      StoreFloat(Combine(half[0], half[1]), out + (r + k) * out_stride);
+    }
+  }
+  _mm256_zeroupper();
+  return r;
+}
+
+// Computes the codes FloatToChar() gives for the first dim - dim % 8 elements
+// of a column, and returns their number.
+template<typename Real>
+KALDI_AVX2 MatrixIndexT EncodeColumnAvx2(const Real *in, MatrixIndexT dim,
+                                         float p0, float p25, float p75,
+                                         float p100, uint8 *out) {
+  __m256 f0 = _mm256_set1_ps(p0), f25 = _mm256_set1_ps(p25),
+      f75 = _mm256_set1_ps(p75),
+      w1 = _mm256_set1_ps(p25 - p0), w2 = _mm256_set1_ps(p75 - p25),
+      w3 = _mm256_set1_ps(p100 - p75),
+      m1 = _mm256_set1_ps(64), m2 = _mm256_set1_ps(128),
+      m3 = _mm256_set1_ps(63);
+  const __m256i c64 = _mm256_set1_epi32(64), c192 = _mm256_set1_epi32(192),
+      c255 = _mm256_set1_epi32(255);
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    __m256 value = LoadAsFloat(in + i);
+    __m256 in1 = _mm256_cmp_ps(value, f25, _CMP_LT_OQ),
+        in12 = _mm256_cmp_ps(value, f75, _CMP_LT_OQ);
+    __m256 start = _mm256_blendv_ps(_mm256_blendv_ps(f75, f25, in12), f0, in1),
+        width = _mm256_blendv_ps(_mm256_blendv_ps(w3, w2, in12), w1, in1),
+        mult = _mm256_blendv_ps(_mm256_blendv_ps(m3, m2, in12), m1, in1);
+    __m256i in1_i = _mm256_castps_si256(in1),
+        in12_i = _mm256_castps_si256(in12);
+    // The codes of the range are lo ... hi.
+    __m256i lo = _mm256_blendv_epi8(_mm256_blendv_epi8(c192, c64, in12_i),
+                                    _mm256_setzero_si256(), in1_i),
+        hi = _mm256_blendv_epi8(_mm256_blendv_epi8(c255, c192, in12_i),
+                                c64, in1_i);
+    __m256 f = _mm256_div_ps(_mm256_sub_ps(value, start), width);
+    __m256i ans = _mm256_add_epi32(lo, AddAndTruncate(_mm256_mul_ps(f, mult),
+                                                      0.5));
+    ans = _mm256_min_epi32(_mm256_max_epi32(ans, lo), hi);
+    StoreCodes(ans, out + i);
+  }
+  _mm256_zeroupper();
+  return i;
+}
+
+// Sets *min_value and *max_value to what mat.Min() and mat.Max() would return,
+// converted to float.  We compare the same way as they do, so NaN's are
+// ignored unless the first element is NaN; but the order differs, so if there
+// are zeros of both signs we might return the other one, and in that case
+// (min or max zero) we return false.
+template<typename Real>
+KALDI_AVX2 bool MinAndMaxAvx2(const MatrixBase<Real> &mat, float *min_value,
+                              float *max_value) {
+  float first = mat.Data()[0], min_tail = first, max_tail = first;
+  __m256 min_ans = _mm256_set1_ps(first), max_ans = min_ans;
+  for (MatrixIndexT r = 0; r < mat.NumRows(); r++) {
+    const Real *row_data = mat.RowData(r);
+    MatrixIndexT c = 0, num_cols = mat.NumCols();
+    for (; c + 8 <= num_cols; c += 8) {
+      __m256 f = LoadAsFloat(row_data + c);
+      // _mm256_min_ps(a, b) is (a < b ? a : b).
+      min_ans = _mm256_min_ps(f, min_ans);
+      max_ans = _mm256_max_ps(f, max_ans);
+    }
+    for (; c < num_cols; c++) {
+      float f = row_data[c];
+      if (f < min_tail) min_tail = f;
+      if (f > max_tail) max_tail = f;
+    }
+  }
+  float mins[8], maxes[8];
+  _mm256_storeu_ps(mins, min_ans);
+  _mm256_storeu_ps(maxes, max_ans);
+  _mm256_zeroupper();
+  for (int32 i = 0; i < 8; i++) {
+    if (mins[i] < min_tail) min_tail = mins[i];
+    if (maxes[i] > max_tail) max_tail = maxes[i];
+  }
+  *min_value = min_tail;
+  *max_value = max_tail;
+  return min_tail != 0.0 && max_tail != 0.0;
+}
+
+inline bool UseAvx2() { return GetSimdMathLevel() >= kSimdMathAvx2; }
+
+#endif  // KALDI_COMPRESSED_MATRIX_X86
+
+// The functions used by CompressedMatrix: these do the first part of the work
+// with AVX2 if allowed and return the number of elements (or rows) done, or
+// return zero.
+
+template<typename Int, typename Real>
+inline MatrixIndexT DecodeUniform(const Int *in, MatrixIndexT dim,
+                                  float min_value, float increment, Real *out) {
+#ifdef KALDI_COMPRESSED_MATRIX_X86
+  if (UseAvx2())
+    return DecodeUniformAvx2(in, dim, min_value, increment, out);
+#endif
+  return 0;
+}
+
+template<typename Real, typename Int>
+inline MatrixIndexT EncodeUniform(const Real *in, MatrixIndexT dim,
+                                  float min_value, float range,
+                                  float max_code, Int *out) {
+#ifdef KALDI_COMPRESSED_MATRIX_X86
+  if (UseAvx2())
+    return EncodeUniformAvx2(in, dim, min_value, range, max_code, out);
+#endif
+  return 0;
+}
+
+template<typename Real>
+inline MatrixIndexT DecodeColumns(
+    const float *p0, const float *p25, const float *p75, const float *p100,
+    const uint8 *byte_data, MatrixIndexT col_stride, MatrixIndexT num_rows,
+    Real *out, MatrixIndexT out_stride) {
+#ifdef KALDI_COMPRESSED_MATRIX_X86
+  if (UseAvx2())
+    return DecodeColumnsAvx2(p0, p25, p75, p100, byte_data, col_stride,
+                             num_rows, out, out_stride);
+#endif
+  return 0;
+}
+
+template<typename Real>
+inline MatrixIndexT EncodeColumn(const Real *in, MatrixIndexT dim,
+                                 float p0, float p25, float p75, float p100,
+                                 uint8 *out) {
+#ifdef KALDI_COMPRESSED_MATRIX_X86
+  if (UseAvx2())
+    return EncodeColumnAvx2(in, dim, p0, p25, p75, p100, out);
+#endif
+  return 0;
+}
+
+// Sets *min_value and *max_value to mat.Min() and mat.Max(), as floats.
+template<typename Real>
+inline void MinAndMax(const MatrixBase<Real> &mat, float *min_value,
+                      float *max_value) {
+#ifdef KALDI_COMPRESSED_MATRIX_X86
+  if (UseAvx2() && MinAndMaxAvx2(mat, min_value, max_value))
+    return;
+#endif
+  *min_value = mat.Min();
+  *max_value = mat.Max();
+}
+
+// Sets sorted_codes[0] ... sorted_codes[3] to the elements at positions 0,
+// quarter, 3 * quarter and codes.size() - 1 of the sorted codes.  We count the
+// codes with each value of the high byte to find the one that the element at a
+// position has, and then only have to select among the codes with that high
+// byte, which are few.
+void FindQuartileCodes(const std::vector<uint16> &codes, int32 quarter,
+                       uint16 *sorted_codes) {
+  int32 n = codes.size();
+  KALDI_ASSERT(3 * quarter < n);
+  int32 high_counts[256] = { 0 };
+  uint16 min_code = 65535, max_code = 0;
+  for (int32 i = 0; i < n; i++) {
+    uint16 c = codes[i];
+    high_counts[c >> 8]++;
+    min_code = std::min(min_code, c);
+    max_code = std::max(max_code, c);
+  }
+  sorted_codes[0] = min_code;
+  sorted_codes[3] = max_code;
+  std::vector<uint16> bucket(n + 1);
+  for (int32 k = 1; k <= 2; k++) {
+    int32 position = (k == 1 ? quarter : 3 * quarter), high = 0;
+    while (position >= high_counts[high])
+      position -= high_counts[high++];
+    // now "position" is the position among the codes with this high byte.
+    int32 bucket_size = 0;
+    for (int32 i = 0; i < n; i++) {
+      bucket[bucket_size] = codes[i];
+      bucket_size += ((codes[i] >> 8) == high);
+    }
+    std::nth_element(bucket.begin(), bucket.begin() + position,
+                     bucket.begin() + bucket_size);
+    sorted_codes[k] = bucket[position];
+  }
+}
+
+inline bool UseBlockedCompression() {
+#ifdef KALDI_COMPRESSED_MATRIX_X86
+  return UseAvx2();
+#else
+  return false;
+#endif
+}
+
+}  // namespace
+
 //static
 MatrixIndexT CompressedMatrix::DataSize(const GlobalHeader &header) {
   // Returns size in bytes of the data.
@@ -83,7 +469,8 @@ void CompressedMatrix::ComputeGlobalHeader(
   // Now compute 'min_value' and 'range'.
   switch (method) {
     case kSpeechFeature: case kTwoByteAuto: case kOneByteAuto: {
-      float min_value = mat.Min(), max_value = mat.Max();
+      float min_value, max_value;
+      MinAndMax(mat, &min_value, &max_value);
       // ensure that max_value is strictly greater than min_value, even if matrix is
       // constant; this avoids crashes in ComputeColHeader when compressing speech
       // featupres.
@@ -154,6 +541,30 @@ void CompressedMatrix::CopyFromMat(
 
     const Real *matrix_data = mat.Data();
 
+    if (UseBlockedCompression()) {
+      // Copy the columns to a buffer 8 at a time, reading the rows in order,
+      // and compress them from there, with the vectorized code.  The values
+      // are converted to float first, which does not change the results.
+      int32 num_rows = global_header.num_rows,
+          num_cols = global_header.num_cols;
+      std::vector<float> block(8 * num_rows);
+      for (int32 col = 0; col < num_cols; col += 8) {
+        int32 block_cols = std::min<int32>(8, num_cols - col);
+        for (int32 r = 0; r < num_rows; r++) {
+          const Real *row_data = mat.RowData(r) + col;
+          for (int32 c = 0; c < block_cols; c++)
+            block[c * num_rows + r] = row_data[c];
+        }
+        for (int32 c = 0; c < block_cols; c++) {
+          CompressColumn(global_header, &(block[c * num_rows]), 1,
+                         num_rows, header_data, byte_data);
+          header_data++;
+          byte_data += num_rows;
+        }
+      }
+      return;
+    }
+
     for (int32 col = 0; col < global_header.num_cols; col++) {
       CompressColumn(global_header,
                      matrix_data + col, mat.Stride(),
@@ -168,7 +579,9 @@ void CompressedMatrix::CopyFromMat(
     int32 num_rows = mat.NumRows(), num_cols = mat.NumCols();
     for (int32 r = 0; r < num_rows; r++) {
       const Real *row_data = mat.RowData(r);
-      for (int32 c = 0; c < num_cols; c++)
+      int32 c = EncodeUniform(row_data, num_cols, global_header.min_value,
+                              global_header.range, 65535, data);
+      for (; c < num_cols; c++)
         data[c] = FloatToUint16(global_header, row_data[c]);
       data += num_cols;
     }
@@ -179,7 +592,9 @@ void CompressedMatrix::CopyFromMat(
     int32 num_rows = mat.NumRows(), num_cols = mat.NumCols();
     for (int32 r = 0; r < num_rows; r++) {
       const Real *row_data = mat.RowData(r);
-      for (int32 c = 0; c < num_cols; c++)
+      int32 c = EncodeUniform(row_data, num_cols, global_header.min_value,
+                              global_header.range, 255, data);
+      for (; c < num_cols; c++)
         data[c] = FloatToUint8(global_header, row_data[c]);
       data += num_cols;
     }
@@ -382,49 +797,42 @@ void CompressedMatrix::ComputeColHeader(
     const Real *data, MatrixIndexT stride,
     int32 num_rows, CompressedMatrix::PerColHeader *header) {
   KALDI_ASSERT(num_rows > 0);
-  std::vector<Real> sdata(num_rows); // the sorted data.
-  for (size_t i = 0, size = sdata.size(); i < size; i++)
-    sdata[i] = data[i*stride];
-
   if (num_rows >= 5) {
     int quarter_nr = num_rows/4;
-    // std::sort(sdata.begin(), sdata.end());
-    // The elements at positions 0, quarter_nr,
-    // 3*quarter_nr, and num_rows-1 need to be in sorted order.
-    std::nth_element(sdata.begin(), sdata.begin() + quarter_nr, sdata.end());
-    // Now, sdata.begin() + quarter_nr contains the element that would appear
-    // in sorted order, in that position.
-    std::nth_element(sdata.begin(), sdata.begin(), sdata.begin() + quarter_nr);
-    // Now, sdata.begin() and sdata.begin() + quarter_nr contain the elements
-    // that would appear at those positions in sorted order.
-    std::nth_element(sdata.begin() + quarter_nr + 1,
-                     sdata.begin() + (3*quarter_nr), sdata.end());
-    // Now, sdata.begin(), sdata.begin() + quarter_nr, and sdata.begin() +
-    // 3*quarter_nr, contain the elements that would appear at those positions
-    // in sorted order.
-    std::nth_element(sdata.begin() + (3*quarter_nr) + 1, sdata.end() - 1,
-                     sdata.end());
-    // Now, sdata.begin(), sdata.begin() + quarter_nr, and sdata.begin() +
-    // 3*quarter_nr, and sdata.end() - 1, contain the elements that would appear
-    // at those positions in sorted order.
-
-    header->percentile_0 =
-        std::min<uint16>(FloatToUint16(global_header, sdata[0]), 65532);
+    // We need the elements at positions 0, quarter_nr, 3*quarter_nr and
+    // num_rows-1 in sorted order, converted with FloatToUint16().  Because
+    // that function never decreases as its argument increases, we can convert
+    // all the elements and find the codes at those positions in the sorted
+    // codes, which is done by counting, not sorting.
+    std::vector<uint16> codes(num_rows);
+    int32 i = 0;
+    if (stride == 1)
+      i = EncodeUniform(data, num_rows, global_header.min_value,
+                        global_header.range, 65535, &(codes[0]));
+    for (; i < num_rows; i++)
+      codes[i] = FloatToUint16(global_header, data[i * stride]);
+    uint16 sorted_codes[4];
+    FindQuartileCodes(codes, quarter_nr, sorted_codes);
+
+    header->percentile_0 = std::min<uint16>(sorted_codes[0], 65532);
     header->percentile_25 =
         std::min<uint16>(
             std::max<uint16>(
-                FloatToUint16(global_header, sdata[quarter_nr]),
+                sorted_codes[1],
                 header->percentile_0 + static_cast<uint16>(1)), 65533);
     header->percentile_75 =
         std::min<uint16>(
             std::max<uint16>(
-                FloatToUint16(global_header, sdata[3*quarter_nr]),
+                sorted_codes[2],
                 header->percentile_25 + static_cast<uint16>(1)), 65534);
     header->percentile_100 = std::max<uint16>(
-        FloatToUint16(global_header, sdata[num_rows-1]),
+        sorted_codes[3],
         header->percentile_75 + static_cast<uint16>(1));
 
   } else {  // handle this pathological case.
+    std::vector<Real> sdata(num_rows); // the sorted data.
+    for (size_t i = 0, size = sdata.size(); i < size; i++)
+      sdata[i] = data[i*stride];
     std::sort(sdata.begin(), sdata.end());
     // Note: we know num_rows is at least 1.
     header->percentile_0 =
@@ -514,7 +922,10 @@ void CompressedMatrix::CompressColumn(
       p75 = Uint16ToFloat(global_header, header->percentile_75),
       p100 = Uint16ToFloat(global_header, header->percentile_100);
 
-  for (int32 i = 0; i < num_rows; i++) {
+  int32 i = 0;
+  if (stride == 1)
+    i = EncodeColumn(data, num_rows, p0, p25, p75, p100, byte_data);
+  for (; i < num_rows; i++) {
     Real this_data = data[i * stride];
     byte_data[i] = FloatToChar(p0, p25, p75, p100, this_data);
   }
@@ -625,48 +1036,9 @@ void CompressedMatrix::CopyToMat(MatrixBase<Real> *mat,
     KALDI_ASSERT(mat->NumCols() == 0);
     return;
   }
-  GlobalHeader *h = reinterpret_cast<GlobalHeader*>(data_);
-  int32 num_cols = h->num_cols, num_rows = h->num_rows;
-  KALDI_ASSERT(mat->NumRows() == num_rows);
-  KALDI_ASSERT(mat->NumCols() == num_cols);
-
-  DataFormat format = static_cast<DataFormat>(h->format);
-  if (format == kOneByteWithColHeaders) {
-    PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
-    uint8 *byte_data = reinterpret_cast<uint8*>(per_col_header +
-                                                h->num_cols);
-    for (int32 i = 0; i < num_cols; i++, per_col_header++) {
-      float p0 = Uint16ToFloat(*h, per_col_header->percentile_0),
-          p25 = Uint16ToFloat(*h, per_col_header->percentile_25),
-          p75 = Uint16ToFloat(*h, per_col_header->percentile_75),
-          p100 = Uint16ToFloat(*h, per_col_header->percentile_100);
-      for (int32 j = 0; j < num_rows; j++, byte_data++) {
-        float f = CharToFloat(p0, p25, p75, p100, *byte_data);
-        (*mat)(j, i) = f;
-      }
-    }
-  } else if (format == kTwoByte) {
-    const uint16 *data = reinterpret_cast<const uint16*>(h + 1);
-    float min_value = h->min_value,
-        increment = h->range * (1.0 / 65535.0);
-    for (int32 i = 0; i < num_rows; i++) {
-      Real *row_data = mat->RowData(i);
-      for (int32 j = 0; j < num_cols; j++)
-        row_data[j] = min_value + data[j] * increment;
-      data += num_cols;
-    }
-  } else {
-    KALDI_ASSERT(format == kOneByte);
-    float min_value = h->min_value, increment = h->range * (1.0 / 255.0);
-
-    const uint8 *data = reinterpret_cast<const uint8*>(h + 1);
-    for (int32 i = 0; i < num_rows; i++) {
-      Real *row_data = mat->RowData(i);
-      for (int32 j = 0; j < num_cols; j++)
-        row_data[j] = min_value + data[j] * increment;
-      data += num_cols;
-    }
-  }
+  KALDI_ASSERT(mat->NumRows() == NumRows());
+  KALDI_ASSERT(mat->NumCols() == NumCols());
+  CopyToMat(0, 0, mat);  // that does the same computation.
 }
 
 // Instantiate the template for float and double.
@@ -706,7 +1078,8 @@ void CompressedMatrix::CopyRowToVec(MatrixIndexT row,
         increment = h->range * (1.0 / 65535.0);
     const uint16 *row_data = reinterpret_cast<uint16*>(h + 1) + (num_cols * row);
     Real *v_data = v->Data();
-    for (int32 c = 0; c < num_cols; c++)
+    int32 c = DecodeUniform(row_data, num_cols, min_value, increment, v_data);
+    for (; c < num_cols; c++)
       v_data[c] = min_value + row_data[c] * increment;
   } else {
     KALDI_ASSERT(format == kOneByte);
@@ -715,7 +1088,8 @@ void CompressedMatrix::CopyRowToVec(MatrixIndexT row,
         increment = h->range * (1.0 / 255.0);
     const uint8 *row_data = reinterpret_cast<uint8*>(h + 1) + (num_cols * row);
     Real *v_data = v->Data();
-    for (int32 c = 0; c < num_cols; c++)
+    int32 c = DecodeUniform(row_data, num_cols, min_value, increment, v_data);
+    for (; c < num_cols; c++)
       v_data[c] = min_value + row_data[c] * increment;
   }
 }
@@ -801,7 +1175,28 @@ void CompressedMatrix::CopyToMat(int32 row_offset,
 
     per_col_header += col_offset;  // skip the appropriate number of headers
 
-    for (int32 i = 0;
+    int32 i = 0;
+    // Blocks of 8 columns, with the vectorized code if allowed; the rows it
+    // does not do, if any, are done here.
+    for (; i + 8 <= tgt_cols && UseBlockedCompression();
+         i += 8, per_col_header += 8, start_of_subcol += 8 * num_rows) {
+      float p0[8], p25[8], p75[8], p100[8];
+      for (int32 c = 0; c < 8; c++) {
+        p0[c] = Uint16ToFloat(*h, per_col_header[c].percentile_0);
+        p25[c] = Uint16ToFloat(*h, per_col_header[c].percentile_25);
+        p75[c] = Uint16ToFloat(*h, per_col_header[c].percentile_75);
+        p100[c] = Uint16ToFloat(*h, per_col_header[c].percentile_100);
+      }
+      int32 j = DecodeColumns(p0, p25, p75, p100, start_of_subcol, num_rows,
+                              tgt_rows, dest->RowData(0) + i, dest->Stride());
+      for (; j < tgt_rows; j++) {
+        Real *dest_row = dest->RowData(j) + i;
+        for (int32 c = 0; c < 8; c++)
+          dest_row[c] = CharToFloat(p0[c], p25[c], p75[c], p100[c],
+                                    start_of_subcol[c * num_rows + j]);
+      }
+    }
+    for (;
          i < tgt_cols;
          i++, per_col_header++, start_of_subcol+=num_rows) {
       byte_data = start_of_subcol;
@@ -822,7 +1217,8 @@ void CompressedMatrix::CopyToMat(int32 row_offset,
 
     for (int32 row = 0; row < tgt_rows; row++) {
       Real *dest_row = dest->RowData(row);
-      for (int32 col = 0; col < tgt_cols; col++)
+      int32 col = DecodeUniform(data, tgt_cols, min_value, increment, dest_row);
+      for (; col < tgt_cols; col++)
         dest_row[col] = min_value + increment * data[col];
       data += num_cols;
     }
@@ -834,7 +1230,8 @@ void CompressedMatrix::CopyToMat(int32 row_offset,
         increment = h->range * (1.0 / 255.0);
     for (int32 row = 0; row < tgt_rows; row++) {
       Real *dest_row = dest->RowData(row);
-      for (int32 col = 0; col < tgt_cols; col++)
+      int32 col = DecodeUniform(data, tgt_cols, min_value, increment, dest_row);
+      for (; col < tgt_cols; col++)
         dest_row[col] = min_value + increment * data[col];
       data += num_cols;
     }
@@ -86,6 +86,10 @@ enum CompressionMethod {
 /*
   This class does lossy compression of a matrix.  It supports various compression
   methods, see enum CompressionMethod.
+
+  Compression and decompression use AVX2 if the CPU supports it and
+  GetSimdMathLevel() (see simd-math.h) allows it; the results are exactly the
+  same as those of the scalar code.
 */
 
 class CompressedMatrix {
@@ -120,6 +124,13 @@ class CompressedMatrix {
 
   void *Data() const { return this->data_; }
 
+  /// Returns the size in bytes of the data that Data() points to (the
+  /// headers and the compressed elements), or zero for an empty matrix.
+  MatrixIndexT DataSizeInBytes() const {
+    return (data_ == NULL) ? 0 :
+        DataSize(*reinterpret_cast<GlobalHeader*>(data_));
+  }
+
   /// This will resize *this and copy the contents of mat to *this.
   template<typename Real>
   void CopyFromMat(const MatrixBase<Real> &mat,
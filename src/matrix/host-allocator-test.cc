@@ -0,0 +1,182 @@
+// matrix/host-allocator-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <thread>
+
+#include "base/timer.h"
+#include "matrix/matrix-lib.h"
+
+namespace kaldi {
+
+void UnitTestSizeClass() {
+  size_t prev_size = 0;
+  int32 prev_class = -1;
+  for (size_t size = 1; size < (1 << 20); size += 1 + size / 64) {
+    size_t class_size;
+    int32 c = HostMemoryAllocator::SizeClass(size, &class_size);
+    KALDI_ASSERT(c >= 0 && c < HostMemoryAllocator::kNumSizeClasses);
+    KALDI_ASSERT(class_size >= size && class_size % 16 == 0);
+    KALDI_ASSERT(size <= 64 || class_size <= size + size / 4 + 16);
+    // classes increase with the size, and the size decides the class.
+    KALDI_ASSERT(c >= prev_class && (c == prev_class) == (class_size ==
+                                                          prev_size));
+    prev_class = c;
+    prev_size = class_size;
+  }
+  size_t class_size;
+  KALDI_ASSERT(HostMemoryAllocator::SizeClass(static_cast<size_t>(1) << 32,
+                                              &class_size) ==
+               HostMemoryAllocator::kNumSizeClasses - 1);
+  if (sizeof(size_t) == 8)
+    KALDI_ASSERT(HostMemoryAllocator::SizeClass(
+        (static_cast<size_t>(1) << 32) + 1, &class_size) == -1);
+}
+
+// Resizes matrices and vectors at random, and checks that their memory is
+// aligned and not shared.
+static void ResizeRandomly(int32 num_iters) {
+  std::vector<Matrix<float> > mats(10);
+  std::vector<Vector<double> > vecs(10);
+  for (int32 i = 0; i < num_iters; i++) {
+    int32 j = RandInt(0, 9);
+    int32 rows = RandInt(0, 50);
+    mats[j].Resize(rows, rows == 0 ? 0 : RandInt(1, 50));
+    mats[j].Set(j);
+    vecs[j].Resize(RandInt(0, 300));
+    vecs[j].Set(j);
+    KALDI_ASSERT(reinterpret_cast<size_t>(mats[j].Data()) % 16 == 0 &&
+                 reinterpret_cast<size_t>(vecs[j].Data()) % 16 == 0);
+    for (int32 k = 0; k < 10; k++)
+      KALDI_ASSERT(mats[k].Sum() == k * mats[k].NumRows() * mats[k].NumCols()
+                   && vecs[k].Sum() == k * vecs[k].Dim());
+  }
+}
+
+void UnitTestHostAllocatorThreads() {
+  HostMemoryAllocator &allocator = HostMemoryAllocator::Instance();
+  int64 bytes_in_use = allocator.GetStats().bytes_in_use;
+  std::vector<std::thread> threads;
+  for (int32 i = 0; i < 4; i++)
+    threads.push_back(std::thread(ResizeRandomly, 200));
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+  HostAllocatorStats stats = allocator.GetStats();
+  KALDI_ASSERT(stats.bytes_in_use == bytes_in_use);
+  // Without caching the blocks come from the system and are not counted.
+  if (allocator.GetOptions().cache_memory)
+    KALDI_ASSERT(stats.peak_bytes_in_use > bytes_in_use &&
+                 stats.num_cache_hits > 0 && stats.bytes_cached > 0);
+
+  // Memory freed by another thread than the one that allocated it.
+  Matrix<float> *mat = new Matrix<float>(30, 40);
+  std::thread t([mat]() { delete mat; });
+  t.join();
+  KALDI_ASSERT(allocator.GetStats().bytes_in_use == bytes_in_use);
+}
+
+void UnitTestHostAllocatorOptions() {
+  HostMemoryAllocator &allocator = HostMemoryAllocator::Instance();
+  HostAllocatorOptions opts;
+  KALDI_ASSERT(!opts.cache_memory);  // binaries turn it on.
+  opts.cache_memory = true;
+  allocator.SetOptions(opts);
+  Vector<float> cached(1000), uncached;
+
+  // Blocks allocated with caching on or off may be freed with it off or on.
+  opts.cache_memory = false;
+  allocator.SetOptions(opts);
+  KALDI_ASSERT(allocator.GetStats().bytes_cached == 0);
+  int64 num_hits = allocator.GetStats().num_cache_hits,
+      num_allocations = allocator.GetStats().num_allocations;
+  uncached.Resize(1000);
+  cached.Resize(0);
+  ResizeRandomly(50);
+  KALDI_ASSERT(allocator.GetStats().num_cache_hits == num_hits &&
+               allocator.GetStats().num_allocations == num_allocations &&
+               allocator.GetStats().bytes_cached == 0);
+
+  opts.cache_memory = true;
+  allocator.SetOptions(opts);
+  uncached.Resize(0);
+  cached.Resize(1000);
+  KALDI_ASSERT(allocator.GetStats().num_cache_hits == num_hits);
+  cached.Resize(0);
+  cached.Resize(990);  // same size class.
+  KALDI_ASSERT(allocator.GetStats().num_cache_hits == num_hits + 1);
+
+  // Without room in the caches the blocks are freed.
+  opts.thread_cache_mb = 0;
+  opts.shared_cache_mb = 0;
+  allocator.SetOptions(opts);
+  allocator.ReleaseCachedMemory();
+  ResizeRandomly(50);
+  KALDI_ASSERT(allocator.GetStats().bytes_cached == 0);
+  allocator.SetOptions(HostAllocatorOptions());
+}
+
+// Simulates a streaming forward pass, which resizes its temporaries for each
+// chunk of frames, and compares the time with and without caching.
+void HostAllocatorBenchmark() {
+  HostMemoryAllocator &allocator = HostMemoryAllocator::Instance();
+  HostAllocatorOptions opts;
+  double time[2];
+  for (int32 cache = 0; cache < 2; cache++) {
+    opts.cache_memory = (cache == 1);
+    allocator.SetOptions(opts);
+    HostAllocatorStats start = allocator.GetStats();
+    Timer timer;
+    for (int32 chunk = 0; chunk < 2000; chunk++) {
+      int32 num_frames = 8 + chunk % 32;
+      Matrix<float> feats(num_frames, 440, kUndefined);
+      for (int32 layer = 0; layer < 6; layer++) {
+        Matrix<float> hidden(num_frames, 2048, kUndefined);
+        Vector<float> row_sums(num_frames, kUndefined);
+        // touch each page, as the computation would.
+        for (int32 r = 0; r < num_frames; r += 2)
+          hidden(r, 0) = layer;
+        row_sums(0) = feats(0, 0) = hidden(0, 0);
+      }
+    }
+    time[cache] = timer.Elapsed();
+    HostAllocatorStats stats = allocator.GetStats();
+    stats.num_allocations -= start.num_allocations;
+    stats.num_cache_hits -= start.num_cache_hits;
+    KALDI_LOG << "With caching " << (cache == 1 ? "on" : "off") << ": "
+              << time[cache] << " seconds, cache hit rate "
+              << stats.HitRate();
+  }
+  allocator.PrintMemoryUsage();
+  allocator.SetOptions(HostAllocatorOptions());
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestSizeClass();
+  for (int32 i = 0; i < 4; i++) {
+    HostAllocatorOptions opts;
+    opts.cache_memory = (i % 2 == 1);
+    HostMemoryAllocator::Instance().SetOptions(opts);
+    UnitTestHostAllocatorThreads();
+  }
+  HostMemoryAllocator::Instance().SetOptions(HostAllocatorOptions());
+  UnitTestHostAllocatorOptions();
+  HostAllocatorBenchmark();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,280 @@
+// matrix/host-allocator.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <new>
+
+#include "matrix/host-allocator.h"
+
+namespace kaldi {
+
+HostAllocatorOptions g_host_allocator_options;
+
+namespace {
+
+// Precedes each block given to the user while caching is on.  The blocks are
+// allocated aligned to kSystemAlign, so the user's part is at an odd multiple
+// of kHeaderSize; the blocks allocated while caching is off have no header and
+// are at a multiple of kSystemAlign, which is how Free() tells them apart.
+struct BlockHeader {
+  int32 size_class;  // -1 if the block is not to be cached.
+  int32 padding;
+  size_t size;  // the size of the user's part of the block.
+};
+
+const size_t kHeaderSize = 16;
+const size_t kSystemAlign = 2 * kHeaderSize;
+
+inline bool HasHeader(void *ptr) {
+  return (reinterpret_cast<size_t>(ptr) & kHeaderSize) != 0;
+}
+
+inline BlockHeader *GetHeader(void *block) {
+  return reinterpret_cast<BlockHeader*>(block);
+}
+
+}  // namespace
+
+// The blocks cached by one thread, accessed without locking.
+struct HostMemoryAllocator::ThreadCache {
+  std::vector<void*> blocks[kNumSizeClasses];
+  int64 bytes;
+
+  ThreadCache(): bytes(0) { }
+
+  // Moves the blocks to the shared pool (or frees them if it is full).
+  void Flush(HostMemoryAllocator *allocator) {
+    for (int32 c = 0; c < kNumSizeClasses; c++) {
+      for (size_t i = 0; i < blocks[c].size(); i++)
+        allocator->FreeToSharedPool(c, blocks[c][i]);
+      blocks[c].clear();
+    }
+    bytes = 0;
+  }
+};
+
+HostMemoryAllocator &HostMemoryAllocator::Instance() {
+  // Never deleted: matrices destroyed at exit still need it.
+  static HostMemoryAllocator *allocator = new HostMemoryAllocator();
+  return *allocator;
+}
+
+HostMemoryAllocator::HostMemoryAllocator():
+    num_allocations_(0), num_cache_hits_(0), bytes_in_use_(0),
+    peak_bytes_in_use_(0), bytes_cached_(0), shared_bytes_(0) {
+  HostAllocatorOptions opts;
+  cache_memory_ = opts.cache_memory;
+  thread_cache_bytes_ = static_cast<int64>(opts.thread_cache_mb) << 20;
+  shared_cache_bytes_ = static_cast<int64>(opts.shared_cache_mb) << 20;
+}
+
+int32 HostMemoryAllocator::SizeClass(size_t size, size_t *class_size) {
+  if (size <= 64) {
+    *class_size = 64;
+    return 0;
+  }
+  // Find e such that 2^e < size <= 2^(e+1); the classes between those are
+  // 2^e times 1.25, 1.5, 1.75 and 2.
+  int32 e = 6;
+  while (e < 32 && (static_cast<uint64>(2) << e) < size)
+    e++;
+  if (e == 32) return -1;
+  size_t base = static_cast<size_t>(1) << e, step = base >> 2,
+      k = (size - base + step - 1) / step;
+  *class_size = base + k * step;
+  return 4 * (e - 6) + static_cast<int32>(k);
+}
+
+HostMemoryAllocator::ThreadCache *HostMemoryAllocator::GetThreadCache() {
+  // "cache" and "exited" are plain thread-local variables, so they stay
+  // usable while the thread exits, after "owner" has freed the cache (e.g. for
+  // the matrices destroyed by the destructors of static objects).
+  static thread_local ThreadCache *cache = NULL;
+  static thread_local bool exited = false;
+  if (cache == NULL && !exited) {
+    struct Owner {
+      ~Owner() {
+        if (cache != NULL) {
+          cache->Flush(&Instance());
+          delete cache;
+          cache = NULL;
+        }
+        exited = true;
+      }
+    };
+    static thread_local Owner owner;
+    cache = new ThreadCache();
+  }
+  return cache;
+}
+
+void HostMemoryAllocator::AddBytesInUse(int64 bytes) {
+  int64 in_use = bytes_in_use_.fetch_add(bytes, std::memory_order_relaxed) +
+      bytes, peak = peak_bytes_in_use_.load(std::memory_order_relaxed);
+  while (in_use > peak && !peak_bytes_in_use_.compare_exchange_weak(
+             peak, in_use, std::memory_order_relaxed)) { }
+}
+
+void *HostMemoryAllocator::Malloc(size_t size) {
+  KALDI_ASSERT(size > 0);
+  void *block, *temp;
+  if (!cache_memory_.load(std::memory_order_relaxed)) {
+    // Straight from the system, without a header or statistics.
+    if ((block = KALDI_MEMALIGN(kSystemAlign, size, &temp)) == NULL)
+      throw std::bad_alloc();
+    return block;
+  }
+  num_allocations_.fetch_add(1, std::memory_order_relaxed);
+  size_t class_size = size;
+  int32 size_class = SizeClass(size, &class_size);
+  if (size_class < 0) {
+    class_size = size;
+  } else {
+    block = NULL;
+    ThreadCache *cache = GetThreadCache();
+    if (cache != NULL && !cache->blocks[size_class].empty()) {
+      block = cache->blocks[size_class].back();
+      cache->blocks[size_class].pop_back();
+      cache->bytes -= class_size;
+    } else {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!shared_blocks_[size_class].empty()) {
+        block = shared_blocks_[size_class].back();
+        shared_blocks_[size_class].pop_back();
+        shared_bytes_ -= class_size;
+      }
+    }
+    if (block != NULL) {
+      num_cache_hits_.fetch_add(1, std::memory_order_relaxed);
+      bytes_cached_.fetch_sub(class_size, std::memory_order_relaxed);
+      AddBytesInUse(class_size);
+      return static_cast<char*>(block) + kHeaderSize;
+    }
+  }
+  if ((block = KALDI_MEMALIGN(kSystemAlign, class_size + kHeaderSize,
+                              &temp)) == NULL)
+    throw std::bad_alloc();
+  GetHeader(block)->size_class = size_class;
+  GetHeader(block)->size = class_size;
+  AddBytesInUse(class_size);
+  return static_cast<char*>(block) + kHeaderSize;
+}
+
+void HostMemoryAllocator::Free(void *ptr) {
+  if (ptr == NULL) return;
+  if (!HasHeader(ptr)) {
+    KALDI_MEMALIGN_FREE(ptr);
+    return;
+  }
+  void *block = static_cast<char*>(ptr) - kHeaderSize;
+  const BlockHeader &header = *GetHeader(block);
+  bytes_in_use_.fetch_sub(header.size, std::memory_order_relaxed);
+  if (header.size_class < 0 || !cache_memory_.load(std::memory_order_relaxed)) {
+    KALDI_MEMALIGN_FREE(block);
+    return;
+  }
+  bytes_cached_.fetch_add(header.size, std::memory_order_relaxed);
+  ThreadCache *cache = GetThreadCache();
+  if (cache != NULL && cache->bytes + static_cast<int64>(header.size) <=
+      thread_cache_bytes_.load(std::memory_order_relaxed)) {
+    cache->blocks[header.size_class].push_back(block);
+    cache->bytes += header.size;
+  } else {
+    FreeToSharedPool(header.size_class, block);
+  }
+}
+
+void HostMemoryAllocator::FreeToSharedPool(int32 size_class, void *block) {
+  size_t size = GetHeader(block)->size;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cache_memory_.load(std::memory_order_relaxed) &&
+        shared_bytes_ + static_cast<int64>(size) <=
+        shared_cache_bytes_.load(std::memory_order_relaxed)) {
+      shared_blocks_[size_class].push_back(block);
+      shared_bytes_ += size;
+      return;
+    }
+  }
+  bytes_cached_.fetch_sub(size, std::memory_order_relaxed);
+  KALDI_MEMALIGN_FREE(block);
+}
+
+void HostMemoryAllocator::ReleaseCachedMemory() {
+  std::vector<void*> blocks;
+  ThreadCache *cache = GetThreadCache();
+  if (cache != NULL) {
+    for (int32 c = 0; c < kNumSizeClasses; c++) {
+      blocks.insert(blocks.end(), cache->blocks[c].begin(),
+                    cache->blocks[c].end());
+      cache->blocks[c].clear();
+    }
+    cache->bytes = 0;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int32 c = 0; c < kNumSizeClasses; c++) {
+      blocks.insert(blocks.end(), shared_blocks_[c].begin(),
+                    shared_blocks_[c].end());
+      std::vector<void*>().swap(shared_blocks_[c]);
+    }
+    shared_bytes_ = 0;
+  }
+  for (size_t i = 0; i < blocks.size(); i++) {
+    bytes_cached_.fetch_sub(GetHeader(blocks[i])->size,
+                            std::memory_order_relaxed);
+    KALDI_MEMALIGN_FREE(blocks[i]);
+  }
+}
+
+void HostMemoryAllocator::SetOptions(const HostAllocatorOptions &opts) {
+  opts.Check();
+  cache_memory_ = opts.cache_memory;
+  thread_cache_bytes_ = static_cast<int64>(opts.thread_cache_mb) << 20;
+  shared_cache_bytes_ = static_cast<int64>(opts.shared_cache_mb) << 20;
+  // The caches of other threads are freed as those threads exit.
+  if (!opts.cache_memory)
+    ReleaseCachedMemory();
+}
+
+HostAllocatorOptions HostMemoryAllocator::GetOptions() const {
+  HostAllocatorOptions opts;
+  opts.cache_memory = cache_memory_;
+  opts.thread_cache_mb = static_cast<int32>(thread_cache_bytes_ >> 20);
+  opts.shared_cache_mb = static_cast<int32>(shared_cache_bytes_ >> 20);
+  return opts;
+}
+
+HostAllocatorStats HostMemoryAllocator::GetStats() const {
+  HostAllocatorStats stats;
+  stats.num_allocations = num_allocations_;
+  stats.num_cache_hits = num_cache_hits_;
+  stats.bytes_in_use = bytes_in_use_;
+  stats.peak_bytes_in_use = peak_bytes_in_use_;
+  stats.bytes_cached = bytes_cached_;
+  return stats;
+}
+
+void HostMemoryAllocator::PrintMemoryUsage() const {
+  HostAllocatorStats stats = GetStats();
+  KALDI_LOG << "Host memory allocator: " << stats.num_allocations
+            << " allocations, cache hit rate " << stats.HitRate()
+            << ", memory in use " << (stats.bytes_in_use / 1.0e+06)
+            << " MB (peak " << (stats.peak_bytes_in_use / 1.0e+06)
+            << " MB), cached " << (stats.bytes_cached / 1.0e+06) << " MB.";
+}
+
+}  // namespace kaldi
@@ -0,0 +1,189 @@
+// matrix/host-allocator.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_HOST_ALLOCATOR_H_
+#define KALDI_MATRIX_HOST_ALLOCATOR_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+
+namespace kaldi {
+
+struct HostAllocatorOptions {
+  // True if we cache the memory of freed Matrix and Vector objects, to give it
+  // to the next ones of about the same size.  Off by default, since it rounds
+  // up the sizes and keeps memory; binaries that resize their temporaries for
+  // each chunk of data (nnet-forward, online-nnet-ipc-forward) turn it on.
+  bool cache_memory;
+
+  // The maximum memory, in megabytes, each thread keeps for itself.
+  int32 thread_cache_mb;
+
+  // The maximum memory, in megabytes, kept in the pool shared by the threads
+  // (which receives what the threads' caches do not have room for, and the
+  // caches of threads that exit).
+  int32 shared_cache_mb;
+
+  HostAllocatorOptions():
+      cache_memory(false), thread_cache_mb(32), shared_cache_mb(256) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("host-cache-memory", &cache_memory, "True if you want to "
+                 "cache the CPU memory of matrices and vectors, to avoid "
+                 "calling malloc and free each time they are resized.");
+    po->Register("host-thread-cache-mb", &thread_cache_mb, "Maximum memory "
+                 "in megabytes each thread keeps cached for matrices and "
+                 "vectors (if --host-cache-memory=true).");
+    po->Register("host-shared-cache-mb", &shared_cache_mb, "Maximum memory "
+                 "in megabytes cached for matrices and vectors in the pool "
+                 "shared by the threads (if --host-cache-memory=true).");
+  }
+
+  void Check() const {
+    KALDI_ASSERT(thread_cache_mb >= 0 && shared_cache_mb >= 0);
+  }
+};
+
+// The statistics only count the blocks allocated while caching was on.
+struct HostAllocatorStats {
+  int64 num_allocations;   // calls to Malloc().
+  int64 num_cache_hits;    // calls to Malloc() that reused cached memory.
+  int64 bytes_in_use;      // memory currently given to the user.
+  int64 peak_bytes_in_use;  // maximum of bytes_in_use so far.
+  int64 bytes_cached;      // memory currently cached, by all the threads.
+
+  double HitRate() const {
+    return (num_allocations == 0 ? 0.0 :
+            static_cast<double>(num_cache_hits) / num_allocations);
+  }
+};
+
+/**
+   This class allocates the CPU memory of Matrix, Vector and PackedMatrix (but
+   not of their sub-matrices and sub-vectors, which own no memory).  When
+   caching is enabled, it keeps the blocks the user frees, so that code that
+   resizes its temporaries for each chunk of data (e.g. the nnet0 components,
+   or OnlineNnetForward) does not call malloc and free, and touch new pages of
+   memory, each time.  It is the CPU counterpart of CuMemoryAllocator, although
+   much simpler.
+
+   Requested sizes are rounded up to one of four size classes per power of
+   two, so at most 25% of memory is wasted.  Each thread caches blocks of
+   each size class, up to --host-thread-cache-mb in total, without locking;
+   what does not fit there goes to a pool shared by the threads, guarded by a
+   mutex, up to --host-shared-cache-mb.  Blocks freed by a thread other than
+   the one that allocated them simply move to that thread's cache.
+
+   When caching is off, Malloc() and Free() go straight to the system
+   allocator.  When it is on, each block starts with a header that records its
+   size class, and the user's memory is at an odd multiple of 16 bytes, which
+   tells Free() which kind of block it has; so caching can be turned on or off
+   (SetOptions()) at any time.  The statistics are kept with atomics, and only
+   for the blocks allocated while caching is on; see GetStats() and
+   PrintMemoryUsage().
+*/
+class HostMemoryAllocator {
+ public:
+  /// Returns the allocator used by Matrix and Vector.
+  static HostMemoryAllocator &Instance();
+
+  /// Returns a block of at least "size" bytes (size > 0), aligned to 16
+  /// bytes; throws std::bad_alloc if it cannot.
+  void *Malloc(size_t size);
+
+  /// Frees a block returned by Malloc(); "ptr" may be NULL.
+  void Free(void *ptr);
+
+  /// Sets the options; may be called at any time (e.g. after reading the
+  /// command line; see RegisterHostAllocatorOptions()).  If caching is turned
+  /// off, the memory cached so far is freed as soon as possible.
+  void SetOptions(const HostAllocatorOptions &opts);
+
+  HostAllocatorOptions GetOptions() const;
+
+  /// Frees the memory in the shared pool and in the calling thread's cache.
+  void ReleaseCachedMemory();
+
+  HostAllocatorStats GetStats() const;
+
+  /// Logs the statistics.
+  void PrintMemoryUsage() const;
+
+  /// Number of size classes; larger blocks are never cached.
+  static const int32 kNumSizeClasses = 105;
+
+  // Returns the size class of a block of "size" bytes and sets "class_size" to
+  // the size of the blocks of that class, or returns -1 if it is too large to
+  // be cached.  Public for testing.
+  static int32 SizeClass(size_t size, size_t *class_size);
+
+ private:
+  struct ThreadCache;
+  friend struct ThreadCache;
+
+  HostMemoryAllocator();
+
+  // Returns the calling thread's cache, or NULL if the thread is exiting.
+  ThreadCache *GetThreadCache();
+
+  // Called by ThreadCache when it has no room for a block: puts it in the
+  // shared pool or frees it.
+  void FreeToSharedPool(int32 size_class, void *block);
+
+  // Frees "block", the start of the memory allocated from the system.
+  void FreeToSystem(void *block, size_t size);
+
+  void AddBytesInUse(int64 bytes);
+
+  std::atomic<bool> cache_memory_;
+  std::atomic<int64> thread_cache_bytes_;
+  std::atomic<int64> shared_cache_bytes_;
+
+  std::atomic<int64> num_allocations_;
+  std::atomic<int64> num_cache_hits_;
+  std::atomic<int64> bytes_in_use_;
+  std::atomic<int64> peak_bytes_in_use_;
+  std::atomic<int64> bytes_cached_;
+
+  // The shared pool: the free blocks of each size class.
+  std::mutex mutex_;
+  std::vector<void*> shared_blocks_[kNumSizeClasses];
+  int64 shared_bytes_;  // guarded by mutex_.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(HostMemoryAllocator);
+};
+
+extern HostAllocatorOptions g_host_allocator_options;
+
+/// Registers the options of the host allocator; after reading the command
+/// line, call ApplyHostAllocatorOptions() for them to take effect.
+inline void RegisterHostAllocatorOptions(OptionsItf *po) {
+  g_host_allocator_options.Register(po);
+}
+
+inline void ApplyHostAllocatorOptions() {
+  g_host_allocator_options.Check();
+  HostMemoryAllocator::Instance().SetOptions(g_host_allocator_options);
+}
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_HOST_ALLOCATOR_H_
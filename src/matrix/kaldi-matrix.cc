@@ -26,6 +26,7 @@
 #include "matrix/jama-svd.h"
 #include "matrix/jama-eig.h"
 #include "matrix/compressed-matrix.h"
+#include "matrix/host-allocator.h"
 #include "matrix/sparse-matrix.h"
 
 static_assert(int(kaldi::kNoTrans) == int(CblasNoTrans) && int(kaldi::kTrans) == int(CblasTrans), 
@@ -830,8 +831,6 @@ inline void Matrix<Real>::Init(const MatrixIndexT rows,
   KALDI_ASSERT(rows > 0 && cols > 0);
   MatrixIndexT skip, stride;
   size_t size;
-  void *data;  // aligned memory block
-  void *temp;  // memory block to be really freed
 
   // compute the size of skip and real cols
   skip = ((16 / sizeof(Real)) - cols % (16 / sizeof(Real)))
@@ -841,14 +840,11 @@ inline void Matrix<Real>::Init(const MatrixIndexT rows,
       * sizeof(Real);
 
   // allocate the memory and set the right dimensions and parameters
-  if (NULL != (data = KALDI_MEMALIGN(16, size, &temp))) {
-    MatrixBase<Real>::data_        = static_cast<Real *> (data);
-    MatrixBase<Real>::num_rows_      = rows;
-    MatrixBase<Real>::num_cols_      = cols;
-    MatrixBase<Real>::stride_  = (stride_type == kDefaultStride ? stride : cols);
-  } else {
-    throw std::bad_alloc();
-  }
+  MatrixBase<Real>::data_ = static_cast<Real *>(
+      HostMemoryAllocator::Instance().Malloc(size));
+  MatrixBase<Real>::num_rows_      = rows;
+  MatrixBase<Real>::num_cols_      = cols;
+  MatrixBase<Real>::stride_  = (stride_type == kDefaultStride ? stride : cols);
 }
 
 template<typename Real>
@@ -1163,8 +1159,7 @@ void Matrix<Real>::RemoveRow(MatrixIndexT i) {
 template<typename Real>
 void Matrix<Real>::Destroy() {
   // we need to free the data block if it was defined
-  if (NULL != MatrixBase<Real>::data_)
-    KALDI_MEMALIGN_FREE( MatrixBase<Real>::data_);
+  HostMemoryAllocator::Instance().Free(MatrixBase<Real>::data_);
   MatrixBase<Real>::data_ = NULL;
   MatrixBase<Real>::num_rows_ = MatrixBase<Real>::num_cols_
       = MatrixBase<Real>::stride_ = 0;
@@ -2238,8 +2233,13 @@ void MatrixBase<Real>::ApplyLog() {
 
 template<typename Real>
 void MatrixBase<Real>::ApplyExp() {
-  for (MatrixIndexT i = 0; i < num_rows_; i++) {
-    Row(i).ApplyExp();
+  if (num_cols_ == stride_) {
+    SubVector<Real> vec(data_, num_rows_ * num_cols_);
+    vec.ApplyExp();
+  } else {
+    for (MatrixIndexT i = 0; i < num_rows_; i++) {
+      Row(i).ApplyExp();
+    }
   }
 }
 
@@ -2825,9 +2825,10 @@ template<typename Real>
 Real MatrixBase<Real>::ApplySoftMax() {
   Real max = this->Max(), sum = 0.0;
   // the 'max' helps to get in good numeric range.
+  this->Add(-max);
+  this->ApplyExp();
   for (MatrixIndexT i = 0; i < num_rows_; i++)
-    for (MatrixIndexT j = 0; j < num_cols_; j++)
-      sum += ((*this)(i, j) = Exp((*this)(i, j) - max));
+    sum += Row(i).Sum();
   this->Scale(1.0 / sum);
   return max + Log(sum);
 }
@@ -26,8 +26,10 @@
 #include <algorithm>
 #include <string>
 #include "matrix/cblas-wrappers.h"
+#include "matrix/host-allocator.h"
 #include "matrix/kaldi-vector.h"
 #include "matrix/kaldi-matrix.h"
+#include "matrix/simd-math.h"
 #include "matrix/sp-matrix.h"
 #include "matrix/sparse-matrix.h"
 
@@ -171,18 +173,9 @@ inline void Vector<Real>::Init(const MatrixIndexT dim) {
     this->data_ = NULL;
     return;
   }
-  MatrixIndexT size;
-  void *data;
-  void *free_data;
-
-  size = dim * sizeof(Real);
-
-  if ((data = KALDI_MEMALIGN(16, size, &free_data)) != NULL) {
-    this->data_ = static_cast<Real*> (data);
-    this->dim_ = dim;
-  } else {
-    throw std::bad_alloc();
-  }
+  this->data_ = static_cast<Real*>(HostMemoryAllocator::Instance().Malloc(
+      static_cast<size_t>(dim) * sizeof(Real)));
+  this->dim_ = dim;
 }
 
 
@@ -278,8 +271,7 @@ void Vector<Real>::RemoveElement(MatrixIndexT i) {
 template<typename Real>
 void Vector<Real>::Destroy() {
   /// we need to free the data block if it was defined
-  if (this->data_ != NULL)
-    KALDI_MEMALIGN_FREE(this->data_);
+  HostMemoryAllocator::Instance().Free(this->data_);
   this->data_ = NULL;
   this->dim_ = 0;
 }
@@ -802,26 +794,23 @@ void VectorBase<Real>::InvertElements() {
 
 template<typename Real>
 void VectorBase<Real>::ApplyLog() {
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    if (data_[i] < 0.0)
-      KALDI_ERR << "Trying to take log of a negative number.";
-    data_[i] = Log(data_[i]);
-  }
+  bool negative = false;
+  for (MatrixIndexT i = 0; i < dim_; i++)
+    negative |= (data_[i] < 0.0);
+  if (negative)
+    KALDI_ERR << "Trying to take log of a negative number.";
+  SimdLog(data_, data_, dim_);
 }
 
 template<typename Real>
 void VectorBase<Real>::ApplyLogAndCopy(const VectorBase<Real> &v) {
   KALDI_ASSERT(dim_ == v.Dim());
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    data_[i] = Log(v(i));
-  }
+  SimdLog(v.data_, data_, dim_);
 }
 
 template<typename Real>
 void VectorBase<Real>::ApplyExp() {
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    data_[i] = Exp(data_[i]);
-  }
+  SimdExp(data_, data_, dim_);
 }
 
 template<typename Real>
@@ -888,9 +877,10 @@ MatrixIndexT VectorBase<Real>::ApplyFloor(const VectorBase<Real> &floor_vec) {
 template<typename Real>
 Real VectorBase<Real>::ApplySoftMax() {
   Real max = this->Max(), sum = 0.0;
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    sum += (data_[i] = Exp(data_[i] - max));
-  }
+  this->Add(-max);
+  SimdExp(data_, data_, dim_);
+  for (MatrixIndexT i = 0; i < dim_; i++)
+    sum += data_[i];
   this->Scale(1.0 / sum);
   return max + Log(sum);
 }
@@ -898,8 +888,15 @@ Real VectorBase<Real>::ApplySoftMax() {
 template<typename Real>
 Real VectorBase<Real>::ApplyLogSoftMax() {
   Real max = this->Max(), sum = 0.0;
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    sum += Exp((data_[i] -= max));
+  this->Add(-max);
+  // the exponentials go through a buffer, a block at a time.
+  const MatrixIndexT block_size = 256;
+  Real exp_data[block_size];
+  for (MatrixIndexT i = 0; i < dim_; i += block_size) {
+    MatrixIndexT n = std::min(block_size, dim_ - i);
+    SimdExp(data_ + i, exp_data, n);
+    for (MatrixIndexT j = 0; j < n; j++)
+      sum += exp_data[j];
   }
   sum = Log(sum);
   this->Add(-1.0 * sum);
@@ -947,17 +944,7 @@ void VectorBase<double>::Tanh(const VectorBase<double> &src) {
 template<typename Real>
 void VectorBase<Real>::Tanh(const VectorBase<Real> &src) {
   KALDI_ASSERT(dim_ == src.dim_);
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    Real x = src.data_[i];
-    if (x > 0.0) {
-      Real inv_expx = Exp(-x);
-      x = -1.0 + 2.0 / (1.0 + inv_expx * inv_expx);
-    } else {
-      Real expx = Exp(x);
-      x = 1.0 - 2.0 / (1.0 + expx * expx);
-    }
-    data_[i] = x;
-  }
+  SimdTanh(src.data_, data_, dim_);
 }
 #endif
 
@@ -985,17 +972,7 @@ void VectorBase<double>::Sigmoid(const VectorBase<double> &src) {
 template<typename Real>
 void VectorBase<Real>::Sigmoid(const VectorBase<Real> &src) {
   KALDI_ASSERT(dim_ == src.dim_);
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    Real x = src.data_[i];
-    // We aim to avoid floating-point overflow here.
-    if (x > 0.0) {
-      x = 1.0 / (1.0 + Exp(-x));
-    } else {
-      Real ex = Exp(x);
-      x = ex / (ex + 1.0);
-    }
-    data_[i] = x;
-  }
+  SimdSigmoid(src.data_, data_, dim_);
 }
 #endif
 
@@ -254,6 +254,223 @@ static void UnitTestAddVecToColsSpeed() {
   CsvResult<Real>(__func__, sizes.size(), t.Elapsed(), "seconds");
 }
 
+// Times the elementwise functions of simd-math.h with the scalar code and
+// with the best instruction set the CPU supports.
+template<typename Real> static void UnitTestSimdMathSpeed() {
+  Timer t;
+  SimdMathLevel cpu_level = GetSimdMathLevel();
+  MatrixIndexT size = 1024;
+  Vector<Real> x(size), y(size);
+  x.SetRandn();
+  x.ApplyAbs();
+  x.Add(0.1);  // log() needs positive input.
+  const char *names[] = { "Exp", "Log", "Tanh", "Sigmoid" };
+  for (int32 level = kSimdMathScalar; level <= cpu_level;
+       level += (cpu_level == kSimdMathScalar ? 1 : cpu_level)) {
+    SetSimdMathLevel(static_cast<SimdMathLevel>(level));
+    for (int32 f = 0; f < 4; f++) {
+      int32 iter = 0;
+      BaseFloat time_in_secs = 0.02;
+      Timer t1;
+      for (; t1.Elapsed() < time_in_secs; iter++) {
+        switch (f) {
+          case 0: SimdExp(x.Data(), y.Data(), size); break;
+          case 1: SimdLog(x.Data(), y.Data(), size); break;
+          case 2: SimdTanh(x.Data(), y.Data(), size); break;
+          default: SimdSigmoid(x.Data(), y.Data(), size);
+        }
+      }
+      BaseFloat gelems = (static_cast<BaseFloat>(size) * iter) /
+          (t1.Elapsed() * 1.0e+09);
+      CsvResult<Real>(std::string(names[f]) +
+                      (level == kSimdMathScalar ? " scalar" : " simd"),
+                      size, gelems, "gigaelements per second");
+    }
+  }
+  SetSimdMathLevel(cpu_level);
+  CsvResult<Real>(__func__, size, t.Elapsed(), "seconds");
+}
+
+// Times compression and decompression of a feature-sized matrix, with the
+// scalar code and with the vectorized code, for the three data formats.
+template<typename Real> static void UnitTestCompressedMatrixSpeed() {
+  Timer t;
+  SimdMathLevel cpu_level = GetSimdMathLevel();
+  MatrixIndexT num_rows = 1000, num_cols = 40;
+  Matrix<Real> mat(num_rows, num_cols), mat2(num_rows, num_cols);
+  mat.SetRandn();
+  CompressionMethod methods[] = { kSpeechFeature, kTwoByteAuto, kOneByteAuto };
+  const char *names[] = { "SpeechFeature", "TwoByteAuto", "OneByteAuto" };
+  for (int32 level = kSimdMathScalar; level <= cpu_level;
+       level += (cpu_level == kSimdMathScalar ? 1 : cpu_level)) {
+    SetSimdMathLevel(static_cast<SimdMathLevel>(level));
+    std::string suffix = (level == kSimdMathScalar ? " scalar" : " simd");
+    for (int32 m = 0; m < 3; m++) {
+      CompressedMatrix cmat;
+      int32 iter = 0;
+      BaseFloat time_in_secs = 0.05;
+      Timer t1;
+      for (; t1.Elapsed() < time_in_secs; iter++)
+        cmat.CopyFromMat(mat, methods[m]);
+      BaseFloat compress_gelems = (static_cast<BaseFloat>(mat.NumRows()) *
+                                   mat.NumCols() * iter) /
+          (t1.Elapsed() * 1.0e+09);
+      iter = 0;
+      Timer t2;
+      for (; t2.Elapsed() < time_in_secs; iter++)
+        cmat.CopyToMat(&mat2);
+      BaseFloat decompress_gelems = (static_cast<BaseFloat>(mat.NumRows()) *
+                                     mat.NumCols() * iter) /
+          (t2.Elapsed() * 1.0e+09);
+      CsvResult<Real>(std::string("Compress ") + names[m] + suffix,
+                      num_rows, compress_gelems, "gigaelements per second");
+      CsvResult<Real>(std::string("Decompress ") + names[m] + suffix,
+                      num_rows, decompress_gelems, "gigaelements per second");
+    }
+  }
+  SetSimdMathLevel(cpu_level);
+  CsvResult<Real>(__func__, num_rows, t.Elapsed(), "seconds");
+}
+
+// Times the recurrent product of an LSTM (1024 cells, 512 recurrent units) for
+// a few streams, done with AddMatMat() and with SmallGemm(), with the scalar
+// kernel and with the best one the CPU supports.
+template<typename Real> static void UnitTestSmallGemmSpeed() {
+  Timer t;
+  SimdMathLevel cpu_level = GetSimdMathLevel();
+  MatrixIndexT num_cols = 4 * 1024, K = 512;
+  Matrix<Real> W(num_cols, K);
+  W.SetRandn();
+  SmallGemmWeights<Real> packed(W);
+  for (MatrixIndexT num_rows = 1; num_rows <= 32; num_rows *= 2) {
+    Matrix<Real> A(num_rows, K), C(num_rows, num_cols);
+    A.SetRandn();
+    BaseFloat time_in_secs = 0.05;
+    int32 iter = 0;
+    Timer t1;
+    for (; t1.Elapsed() < time_in_secs; iter++)
+      C.AddMatMat(1.0, A, kNoTrans, W, kTrans, 1.0);
+    CsvResult<Real>("AddMatMat with few rows", num_rows,
+                    t1.Elapsed() * 1.0e+06 / iter, "microseconds");
+    for (int32 level = kSimdMathScalar; level <= cpu_level;
+         level += (cpu_level == kSimdMathScalar ? 1 : cpu_level)) {
+      SetSimdMathLevel(static_cast<SimdMathLevel>(level));
+      iter = 0;
+      Timer t2;
+      for (; t2.Elapsed() < time_in_secs; iter++)
+        SmallGemm(Real(1), A, packed, Real(1), &C);
+      CsvResult<Real>(std::string("SmallGemm") +
+                      (level == kSimdMathScalar ? " scalar" : " simd"),
+                      num_rows, t2.Elapsed() * 1.0e+06 / iter,
+                      "microseconds");
+    }
+    SetSimdMathLevel(cpu_level);
+  }
+  CsvResult<Real>(__func__, num_cols, t.Elapsed(), "seconds");
+}
+
+// Times a time step of a projected LSTM (as LstmProjectedStreamsFast, with
+// 1024 cells and 512 recurrent units) for a few streams, done with the
+// functions of MatrixBase and with LstmProjectedStep().
+template<typename Real> static void UnitTestLstmProjectedStepSpeed() {
+  Timer t;
+  MatrixIndexT C = 1024, R = 512;
+  Matrix<Real> w_gifo_r(4 * C, R), w_r_m(R, C);
+  Vector<Real> p_i(C), p_f(C), p_o(C);
+  w_gifo_r.SetRandn();
+  w_gifo_r.Scale(0.05);
+  w_r_m.SetRandn();
+  w_r_m.Scale(0.05);
+  p_i.SetRandn();
+  p_f.SetRandn();
+  p_o.SetRandn();
+  SmallGemmWeights<Real> packed_gifo_r(w_gifo_r), packed_r_m(w_r_m);
+  for (MatrixIndexT S = 1; S <= 32; S *= 2) {
+    Matrix<Real> prev(S, 7 * C + R), cur(S, 7 * C + R);
+    prev.SetRandn();
+    SubMatrix<Real> y_g(cur, 0, S, 0, C), y_i(cur, 0, S, C, C),
+        y_f(cur, 0, S, 2 * C, C), y_o(cur, 0, S, 3 * C, C),
+        y_c(cur, 0, S, 4 * C, C), y_h(cur, 0, S, 5 * C, C),
+        y_m(cur, 0, S, 6 * C, C), y_r(cur, 0, S, 7 * C, R),
+        y_gifo(cur, 0, S, 0, 4 * C), prev_c(prev, 0, S, 4 * C, C),
+        prev_r(prev, 0, S, 7 * C, R);
+    BaseFloat time_in_secs = 0.05;
+    int32 iter = 0;
+    Timer t1;
+    for (; t1.Elapsed() < time_in_secs; iter++) {
+      y_gifo.AddMatMat(1.0, prev_r, kNoTrans, w_gifo_r, kTrans, 0.0);
+      y_i.AddMatDiagVec(1.0, prev_c, kNoTrans, p_i, 1.0);
+      y_f.AddMatDiagVec(1.0, prev_c, kNoTrans, p_f, 1.0);
+      y_i.Sigmoid(y_i);
+      y_f.Sigmoid(y_f);
+      y_g.Tanh(y_g);
+      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
+      y_c.AddMatMatElements(1.0, prev_c, y_f, 1.0);
+      y_c.ApplyFloor(-50.0);
+      y_c.ApplyCeiling(50.0);
+      y_h.Tanh(y_c);
+      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, p_o, 1.0);
+      y_o.Sigmoid(y_o);
+      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+      y_r.AddMatMat(1.0, y_m, kNoTrans, w_r_m, kTrans, 0.0);
+    }
+    CsvResult<Real>("LSTM step with MatrixBase functions", S,
+                    t1.Elapsed() * 1.0e+06 / iter, "microseconds");
+    iter = 0;
+    Timer t2;
+    for (; t2.Elapsed() < time_in_secs; iter++) {
+      y_gifo.SetZero();
+      LstmProjectedStep(packed_gifo_r, packed_r_m, p_i, p_f, p_o, Real(50),
+                        prev, &cur);
+    }
+    CsvResult<Real>("LSTM step with LstmProjectedStep()", S,
+                    t2.Elapsed() * 1.0e+06 / iter, "microseconds");
+  }
+  CsvResult<Real>(__func__, C, t.Elapsed(), "seconds");
+}
+
+// Times an output layer (4096 by 1024) pruned to 80% and 90% sparsity with
+// blocks of 8 by 1 and 4 by 4, done with AddMatBlockSparseMatTrans(), against
+// the dense product, for 1 frame (online decoding) to 64 frames.
+template<typename Real> static void UnitTestBlockSparseMatrixSpeed() {
+  Timer t;
+  MatrixIndexT num_rows = 4096, num_cols = 1024;
+  Matrix<Real> W(num_rows, num_cols);
+  W.SetRandn();
+  int32 block_dims[][2] = { {8, 1}, {4, 4} };
+  BaseFloat sparsities[] = { 0.8, 0.9 };
+  for (MatrixIndexT num_frames = 1; num_frames <= 128; num_frames *= 8) {
+    Matrix<Real> A(num_frames, num_cols), C(num_frames, num_rows);
+    A.SetRandn();
+    BaseFloat time_in_secs = 0.05;
+    int32 iter = 0;
+    Timer t1;
+    for (; t1.Elapsed() < time_in_secs; iter++)
+      C.AddMatMat(1.0, A, kNoTrans, W, kTrans, 0.0);
+    CsvResult<Real>("AddMatMat dense", num_frames,
+                    t1.Elapsed() * 1.0e+06 / iter, "microseconds");
+    for (int32 b = 0; b < 2; b++) {
+      for (int32 s = 0; s < 2; s++) {
+        Matrix<Real> W_pruned(W);
+        PruneBlocks(sparsities[s], block_dims[b][0], block_dims[b][1],
+                    &W_pruned);
+        BlockSparseMatrix<Real> sparse;
+        sparse.CopyFromMat(W_pruned, block_dims[b][0], block_dims[b][1]);
+        iter = 0;
+        Timer t2;
+        for (; t2.Elapsed() < time_in_secs; iter++)
+          AddMatBlockSparseMatTrans(Real(1), A, sparse, Real(0), &C);
+        std::ostringstream name;
+        name << "AddMatBlockSparseMatTrans " << block_dims[b][0] << "x"
+             << block_dims[b][1] << " blocks, sparsity " << sparsities[s];
+        CsvResult<Real>(name.str(), num_frames, t2.Elapsed() * 1.0e+06 / iter,
+                        "microseconds");
+      }
+    }
+  }
+  CsvResult<Real>(__func__, num_rows, t.Elapsed(), "seconds");
+}
+
 template<typename Real> static void MatrixUnitSpeedTest() {
   UnitTestRealFftSpeed<Real>();
   UnitTestSplitRadixRealFftSpeed<Real>();
@@ -263,6 +480,11 @@ template<typename Real> static void MatrixUnitSpeedTest() {
   UnitTestAddColSumMatSpeed<Real>();
   UnitTestAddVecToRowsSpeed<Real>();
   UnitTestAddVecToColsSpeed<Real>();
+  UnitTestSimdMathSpeed<Real>();
+  UnitTestCompressedMatrixSpeed<Real>();
+  UnitTestSmallGemmSpeed<Real>();
+  UnitTestLstmProjectedStepSpeed<Real>();
+  UnitTestBlockSparseMatrixSpeed<Real>();
 }
 
 } // namespace kaldi
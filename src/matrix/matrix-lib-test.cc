@@ -2403,6 +2403,165 @@ template<typename Real> static void  UnitTestSigmoid() {
   }
 }
 
+// Returns the error of "y" in units in the last place of the float nearest
+// to "ref".
+static double UlpError(float y, double ref) {
+  float r = static_cast<float>(std::abs(ref));
+  double ulp = (r < std::numeric_limits<float>::min() ?
+                std::numeric_limits<float>::denorm_min() :
+                std::nextafter(r, std::numeric_limits<float>::infinity()) - r);
+  return std::abs(y - ref) / ulp;
+}
+
+// Checks the float functions of simd-math.h, at each instruction set the CPU
+// supports, against the double-precision results, to the bounds documented
+// in simd-math.h.
+static void UnitTestSimdMath() {
+  SimdMathLevel cpu_level = GetSimdMathLevel();
+  int32 dim = 100000 + Rand() % 100;
+  Vector<float> x(dim), y(dim);
+  for (int32 level = kSimdMathScalar; level <= cpu_level; level++) {
+    SetSimdMathLevel(static_cast<SimdMathLevel>(level));
+    double exp_error = 0.0, log_error = 0.0, tanh_error = 0.0,
+        sigmoid_error = 0.0;
+    // exp() over its whole range.
+    for (int32 i = 0; i < dim; i++)
+      x(i) = -87.3f + 176.0f * RandUniform();
+    SimdExp(x.Data(), y.Data(), dim);
+    for (int32 i = 0; i < dim; i++)
+      exp_error = std::max(exp_error, UlpError(y(i), std::exp(double(x(i)))));
+    // log() of numbers spread over all exponents, and near 1.
+    for (int32 i = 0; i < dim; i++)
+      x(i) = (i % 2 == 0 ? std::exp(-100.0 + 188.0 * RandUniform()) :
+              0.9 + 0.2 * RandUniform());
+    SimdLog(x.Data(), y.Data(), dim);
+    for (int32 i = 0; i < dim; i++) {
+      double ref = std::log(double(x(i)));
+      if (std::abs(y(i) - ref) > 1.0e-07)
+        log_error = std::max(log_error, UlpError(y(i), ref));
+    }
+    for (int32 i = 0; i < dim; i++)
+      x(i) = (i % 2 == 0 ? 10.0 : 1.0) * (2.0 * RandUniform() - 1.0);
+    SimdTanh(x.Data(), y.Data(), dim);
+    for (int32 i = 0; i < dim; i++)
+      tanh_error = std::max(tanh_error,
+                            UlpError(y(i), std::tanh(double(x(i)))));
+    for (int32 i = 0; i < dim; i++)
+      x(i) = 40.0 * (2.0 * RandUniform() - 1.0);
+    SimdSigmoid(x.Data(), y.Data(), dim);
+    for (int32 i = 0; i < dim; i++)
+      sigmoid_error = std::max(sigmoid_error, UlpError(
+          y(i), 1.0 / (1.0 + std::exp(-double(x(i))))));
+    KALDI_LOG << "SIMD math level " << level << ": maximum errors in ulp: exp "
+              << exp_error << ", log " << log_error << ", tanh " << tanh_error
+              << ", sigmoid " << sigmoid_error;
+    // (the scalar tanh, computed from exp(), loses precision near zero.)
+    KALDI_ASSERT(level == kSimdMathScalar ||
+                 (exp_error <= 2.0 && log_error <= 1.0 && tanh_error <= 2.0 &&
+                  sigmoid_error <= 3.0));
+
+    // The special values, and a length that is not a multiple of 16.
+    float in[] = { 0.0f, -0.0f, 1.0f, -1.0f, 100.0f, -200.0f,
+                   std::numeric_limits<float>::infinity(),
+                   -std::numeric_limits<float>::infinity(),
+                   std::numeric_limits<float>::quiet_NaN(),
+                   std::numeric_limits<float>::denorm_min() },
+        out[10];
+    SimdExp(in, out, 10);
+    KALDI_ASSERT(out[0] == 1.0f && out[1] == 1.0f && out[4] == HUGE_VALF &&
+                 out[5] == 0.0f && out[6] == HUGE_VALF && out[7] == 0.0f &&
+                 KALDI_ISNAN(out[8]) && out[9] == 1.0f);
+    SimdLog(in, out, 10);
+    KALDI_ASSERT(out[0] == -HUGE_VALF && out[1] == -HUGE_VALF &&
+                 out[2] == 0.0f && KALDI_ISNAN(out[3]) && KALDI_ISNAN(out[7]) &&
+                 out[6] == HUGE_VALF && KALDI_ISNAN(out[8]) &&
+                 ApproxEqual(out[9], std::log(double(in[9]))));
+    SimdTanh(in, out, 10);
+    KALDI_ASSERT(out[0] == 0.0f && out[4] == 1.0f && out[5] == -1.0f &&
+                 out[6] == 1.0f && out[7] == -1.0f && KALDI_ISNAN(out[8]));
+    SimdSigmoid(in, out, 10);
+    KALDI_ASSERT(out[0] == 0.5f && out[4] == 1.0f && out[5] == 0.0f &&
+                 out[6] == 1.0f && out[7] == 0.0f && KALDI_ISNAN(out[8]));
+  }
+  SetSimdMathLevel(cpu_level);
+}
+
+// Checks SmallGemm() against AddMatMat(), with and without the SIMD kernel.
+template<typename Real> static void UnitTestSmallGemm() {
+  SimdMathLevel cpu_level = GetSimdMathLevel();
+  for (int32 level = kSimdMathScalar; level <= cpu_level; level++) {
+    SetSimdMathLevel(static_cast<SimdMathLevel>(level));
+    for (int32 i = 0; i < 10; i++) {
+      MatrixIndexT M = 1 + Rand() % 10, N = 1 + Rand() % 50,
+          K = 1 + Rand() % 40;
+      Matrix<Real> A(M, K + 1 + Rand() % 5), W(N, K), C(M, N);
+      A.SetRandn();
+      W.SetRandn();
+      C.SetRandn();
+      // the first K columns, so that the stride is not the number of columns.
+      SubMatrix<Real> A2(A, 0, M, 0, K);
+      Matrix<Real> C2(C);
+      Real alpha = RandGauss(), beta = (i % 3 == 0 ? 0.0 : RandGauss());
+      if (beta == 0.0)
+        C2.Set(std::numeric_limits<Real>::quiet_NaN());  // must not be read.
+      SmallGemmWeights<Real> packed(W);
+      KALDI_ASSERT(packed.NumRows() == N && packed.NumCols() == K);
+      SmallGemm(alpha, A2, packed, beta, &C2);
+      C.AddMatMat(alpha, A2, kNoTrans, W, kTrans, beta);
+      AssertEqual(C, C2);
+    }
+  }
+  SetSimdMathLevel(cpu_level);
+  SmallGemmWeights<Real> packed;
+  KALDI_ASSERT(packed.IsEmpty());
+}
+
+// Checks LstmProjectedStep() against the same computation done with the
+// functions of MatrixBase, as LstmProjectedStreamsFast does.
+template<typename Real> static void UnitTestLstmProjectedStep() {
+  for (int32 n = 0; n < 5; n++) {
+    MatrixIndexT S = 1 + Rand() % 9, C = 1 + Rand() % 30, R = 1 + Rand() % 20;
+    Real clip = 1.0 + RandUniform();
+    Matrix<Real> w_gifo_r(4 * C, R), w_r_m(R, C), prev(S, 7 * C + R),
+        cur(S, 7 * C + R);
+    Vector<Real> p_i(C), p_f(C), p_o(C);
+    w_gifo_r.SetRandn();
+    w_r_m.SetRandn();
+    prev.SetRandn();
+    cur.SetRandn();
+    p_i.SetRandn();
+    p_f.SetRandn();
+    p_o.SetRandn();
+    Matrix<Real> ref(cur);
+    SmallGemmWeights<Real> packed_gifo_r(w_gifo_r), packed_r_m(w_r_m);
+    LstmProjectedStep(packed_gifo_r, packed_r_m, p_i, p_f, p_o, clip,
+                      prev, &cur);
+
+    SubMatrix<Real> y_g(ref, 0, S, 0, C), y_i(ref, 0, S, C, C),
+        y_f(ref, 0, S, 2 * C, C), y_o(ref, 0, S, 3 * C, C),
+        y_c(ref, 0, S, 4 * C, C), y_h(ref, 0, S, 5 * C, C),
+        y_m(ref, 0, S, 6 * C, C), y_r(ref, 0, S, 7 * C, R),
+        y_gifo(ref, 0, S, 0, 4 * C), prev_c(prev, 0, S, 4 * C, C),
+        prev_r(prev, 0, S, 7 * C, R);
+    y_gifo.AddMatMat(1.0, prev_r, kNoTrans, w_gifo_r, kTrans, 1.0);
+    y_i.AddMatDiagVec(1.0, prev_c, kNoTrans, p_i, 1.0);
+    y_f.AddMatDiagVec(1.0, prev_c, kNoTrans, p_f, 1.0);
+    y_i.Sigmoid(y_i);
+    y_f.Sigmoid(y_f);
+    y_g.Tanh(y_g);
+    y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
+    y_c.AddMatMatElements(1.0, prev_c, y_f, 1.0);
+    y_c.ApplyFloor(-clip);
+    y_c.ApplyCeiling(clip);
+    y_h.Tanh(y_c);
+    y_o.AddMatDiagVec(1.0, y_c, kNoTrans, p_o, 1.0);
+    y_o.Sigmoid(y_o);
+    y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+    y_r.AddMatMat(1.0, y_m, kNoTrans, w_r_m, kTrans, 0.0);
+    AssertEqual(ref, cur);
+  }
+}
+
 template<typename Real> static void  UnitTestSoftHinge() {
   for (MatrixIndexT i = 0; i < 10; i++) {
     MatrixIndexT dimM = 5 + Rand() % 10, dimN = 5 + Rand() % 10;
@@ -4054,6 +4213,275 @@ template<typename Real> static void UnitTestCompressedMatrix2() {
 }
 
 
+// The compression and decompression code as it was before it was vectorized
+// (with std::nth_element to find the column percentiles), which the current
+// code must match bit for bit.  CompressedMatrixRef() outputs the data of the
+// compressed matrix, as in CompressedMatrix::Data().
+namespace compressed_matrix_ref {
+
+struct GlobalHeader { int32 format; float min_value, range;
+                      int32 num_rows, num_cols; };
+struct PerColHeader { uint16 percentile_0, percentile_25, percentile_75,
+                      percentile_100; };
+
+static uint16 FloatToUint16(const GlobalHeader &h, float value) {
+  float f = (value - h.min_value) / h.range;
+  if (f > 1.0) f = 1.0;
+  if (f < 0.0) f = 0.0;
+  return static_cast<int>(f * 65535 + 0.499);
+}
+
+static uint8 FloatToUint8(const GlobalHeader &h, float value) {
+  float f = (value - h.min_value) / h.range;
+  if (f > 1.0) f = 1.0;
+  if (f < 0.0) f = 0.0;
+  return static_cast<int>(f * 255 + 0.499);
+}
+
+static float Uint16ToFloat(const GlobalHeader &h, uint16 value) {
+  return h.min_value + h.range * 1.52590218966964e-05F * value;
+}
+
+static uint8 FloatToChar(float p0, float p25, float p75, float p100,
+                         float value) {
+  int ans;
+  if (value < p25) {
+    float f = (value - p0) / (p25 - p0);
+    ans = static_cast<int>(f * 64 + 0.5);
+    if (ans < 0) ans = 0;
+    if (ans > 64) ans = 64;
+  } else if (value < p75) {
+    float f = (value - p25) / (p75 - p25);
+    ans = 64 + static_cast<int>(f * 128 + 0.5);
+    if (ans < 64) ans = 64;
+    if (ans > 192) ans = 192;
+  } else {
+    float f = (value - p75) / (p100 - p75);
+    ans = 192 + static_cast<int>(f * 63 + 0.5);
+    if (ans < 192) ans = 192;
+    if (ans > 255) ans = 255;
+  }
+  return static_cast<uint8>(ans);
+}
+
+static float CharToFloat(float p0, float p25, float p75, float p100,
+                         uint8 value) {
+  if (value <= 64)
+    return p0 + (p25 - p0) * value * (1/64.0);
+  else if (value <= 192)
+    return p25 + (p75 - p25) * (value - 64) * (1/128.0);
+  else
+    return p75 + (p100 - p75) * (value - 192) * (1/63.0);
+}
+
+template<typename Real>
+static void ComputeColHeader(const GlobalHeader &h, const Real *data,
+                             MatrixIndexT stride, int32 num_rows,
+                             PerColHeader *header) {
+  std::vector<Real> sdata(num_rows);
+  for (int32 i = 0; i < num_rows; i++)
+    sdata[i] = data[i * stride];
+  if (num_rows >= 5) {
+    int quarter_nr = num_rows / 4;
+    std::nth_element(sdata.begin(), sdata.begin() + quarter_nr, sdata.end());
+    std::nth_element(sdata.begin(), sdata.begin(), sdata.begin() + quarter_nr);
+    std::nth_element(sdata.begin() + quarter_nr + 1,
+                     sdata.begin() + (3 * quarter_nr), sdata.end());
+    std::nth_element(sdata.begin() + (3 * quarter_nr) + 1, sdata.end() - 1,
+                     sdata.end());
+    header->percentile_0 =
+        std::min<uint16>(FloatToUint16(h, sdata[0]), 65532);
+    header->percentile_25 = std::min<uint16>(std::max<uint16>(
+        FloatToUint16(h, sdata[quarter_nr]),
+        header->percentile_0 + static_cast<uint16>(1)), 65533);
+    header->percentile_75 = std::min<uint16>(std::max<uint16>(
+        FloatToUint16(h, sdata[3 * quarter_nr]),
+        header->percentile_25 + static_cast<uint16>(1)), 65534);
+    header->percentile_100 = std::max<uint16>(
+        FloatToUint16(h, sdata[num_rows - 1]),
+        header->percentile_75 + static_cast<uint16>(1));
+  } else {
+    std::sort(sdata.begin(), sdata.end());
+    header->percentile_0 = std::min<uint16>(FloatToUint16(h, sdata[0]), 65532);
+    if (num_rows > 1)
+      header->percentile_25 = std::min<uint16>(std::max<uint16>(
+          FloatToUint16(h, sdata[1]), header->percentile_0 + 1), 65533);
+    else
+      header->percentile_25 = header->percentile_0 + 1;
+    if (num_rows > 2)
+      header->percentile_75 = std::min<uint16>(std::max<uint16>(
+          FloatToUint16(h, sdata[2]), header->percentile_25 + 1), 65534);
+    else
+      header->percentile_75 = header->percentile_25 + 1;
+    if (num_rows > 3)
+      header->percentile_100 = std::max<uint16>(
+          FloatToUint16(h, sdata[3]), header->percentile_75 + 1);
+    else
+      header->percentile_100 = header->percentile_75 + 1;
+  }
+}
+
+template<typename Real>
+static void CompressedMatrixRef(const MatrixBase<Real> &mat,
+                                CompressionMethod method,
+                                std::vector<char> *data) {
+  if (method == kAutomaticMethod)
+    method = (mat.NumRows() > 8 ? kSpeechFeature : kTwoByteAuto);
+  GlobalHeader h;
+  h.format = (method == kSpeechFeature ? 1 :
+              method == kTwoByteAuto || method == kTwoByteSignedInteger ? 2 : 3);
+  h.num_rows = mat.NumRows();
+  h.num_cols = mat.NumCols();
+  if (method == kSpeechFeature || method == kTwoByteAuto ||
+      method == kOneByteAuto) {
+    float min_value = mat.Min(), max_value = mat.Max();
+    if (max_value == min_value)
+      max_value = min_value + (1.0 + fabs(min_value));
+    h.min_value = min_value;
+    h.range = max_value - min_value;
+  } else if (method == kTwoByteSignedInteger) {
+    h.min_value = -32768.0;
+    h.range = 65535.0;
+  } else {
+    h.min_value = 0.0;
+    h.range = (method == kOneByteUnsignedInteger ? 255.0 : 1.0);
+  }
+  int32 num_rows = h.num_rows, num_cols = h.num_cols,
+      elem_size = (h.format == 2 ? 2 : 1);
+  data->resize(sizeof(h) + num_rows * num_cols * elem_size +
+               (h.format == 1 ? num_cols * sizeof(PerColHeader) : 0));
+  memcpy(&((*data)[0]), &h, sizeof(h));
+  char *out = &((*data)[0]) + sizeof(h);
+  if (h.format == 1) {
+    PerColHeader *header = reinterpret_cast<PerColHeader*>(out);
+    uint8 *byte_data = reinterpret_cast<uint8*>(header + num_cols);
+    for (int32 c = 0; c < num_cols; c++, header++, byte_data += num_rows) {
+      ComputeColHeader(h, mat.Data() + c, mat.Stride(), num_rows, header);
+      float p0 = Uint16ToFloat(h, header->percentile_0),
+          p25 = Uint16ToFloat(h, header->percentile_25),
+          p75 = Uint16ToFloat(h, header->percentile_75),
+          p100 = Uint16ToFloat(h, header->percentile_100);
+      for (int32 r = 0; r < num_rows; r++)
+        byte_data[r] = FloatToChar(p0, p25, p75, p100, mat(r, c));
+    }
+  } else {
+    for (int32 r = 0; r < num_rows; r++) {
+      for (int32 c = 0; c < num_cols; c++, out += elem_size) {
+        if (h.format == 2) {
+          uint16 code = FloatToUint16(h, mat(r, c));
+          memcpy(out, &code, 2);
+        } else {
+          *reinterpret_cast<uint8*>(out) = FloatToUint8(h, mat(r, c));
+        }
+      }
+    }
+  }
+}
+
+// Decompresses the output of CompressedMatrixRef() as CopyToMat() did.
+template<typename Real>
+static void CopyToMatRef(const std::vector<char> &data, MatrixBase<Real> *mat) {
+  GlobalHeader h;
+  memcpy(&h, &(data[0]), sizeof(h));
+  const char *in = &(data[0]) + sizeof(h);
+  if (h.format == 1) {
+    const PerColHeader *header = reinterpret_cast<const PerColHeader*>(in);
+    const uint8 *byte_data = reinterpret_cast<const uint8*>(header + h.num_cols);
+    for (int32 c = 0; c < h.num_cols; c++, header++) {
+      float p0 = Uint16ToFloat(h, header->percentile_0),
+          p25 = Uint16ToFloat(h, header->percentile_25),
+          p75 = Uint16ToFloat(h, header->percentile_75),
+          p100 = Uint16ToFloat(h, header->percentile_100);
+      for (int32 r = 0; r < h.num_rows; r++, byte_data++)
+        (*mat)(r, c) = CharToFloat(p0, p25, p75, p100, *byte_data);
+    }
+  } else {
+    float min_value = h.min_value,
+        increment = h.range * (h.format == 2 ? 1.0 / 65535.0 : 1.0 / 255.0);
+    for (int32 r = 0; r < h.num_rows; r++) {
+      for (int32 c = 0; c < h.num_cols; c++) {
+        if (h.format == 2) {
+          uint16 code;
+          memcpy(&code, in, 2);
+          in += 2;
+          (*mat)(r, c) = min_value + code * increment;
+        } else {
+          (*mat)(r, c) = min_value + *reinterpret_cast<const uint8*>(in++) *
+              increment;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace compressed_matrix_ref
+
+// Checks that compression and decompression give exactly the same results with
+// the vectorized code as with the scalar code, for all compression methods, and
+// as the code before it was vectorized.
+template<typename Real> static void UnitTestCompressedMatrixSimd() {
+  SimdMathLevel cpu_level = GetSimdMathLevel();
+  CompressionMethod methods[] = { kAutomaticMethod, kSpeechFeature,
+                                  kTwoByteAuto, kTwoByteSignedInteger,
+                                  kOneByteAuto, kOneByteUnsignedInteger,
+                                  kOneByteZeroOne };
+  for (int32 i = 0; i < 70; i++) {
+    CompressionMethod method = methods[i % 7];
+    int32 num_rows = RandInt(1, 70), num_cols = RandInt(1, 30);
+    Matrix<Real> mat(num_rows, num_cols);
+    mat.SetRandn();
+    if (i % 3 == 1) {
+      mat.Scale(300.0);  // outside the range of some methods.
+    } else if (i % 3 == 2) {
+      // columns that are constant or have few distinct values, which give
+      // percentiles close together.
+      for (int32 c = 0; c < num_cols; c += 2)
+        for (int32 r = 0; r < num_rows; r++)
+          mat(r, c) = (c % 4 == 0 ? 1.5 : RandInt(0, 2) * 1.0e-03);
+    }
+    std::vector<char> old_data;
+    compressed_matrix_ref::CompressedMatrixRef(mat, method, &old_data);
+    SetSimdMathLevel(kSimdMathScalar);
+    CompressedMatrix ref_cmat(mat, method);
+    KALDI_ASSERT(ref_cmat.DataSizeInBytes() ==
+                 static_cast<MatrixIndexT>(old_data.size()) &&
+                 memcmp(ref_cmat.Data(), &(old_data[0]), old_data.size()) == 0);
+    Matrix<Real> ref_mat(num_rows, num_cols), old_mat(num_rows, num_cols);
+    ref_cmat.CopyToMat(&ref_mat);
+    compressed_matrix_ref::CopyToMatRef(old_data, &old_mat);
+    for (int32 r = 0; r < num_rows; r++)
+      KALDI_ASSERT(memcmp(old_mat.RowData(r), ref_mat.RowData(r),
+                          num_cols * sizeof(Real)) == 0);
+    SetSimdMathLevel(cpu_level);
+    CompressedMatrix cmat(mat, method);
+    MatrixIndexT size = cmat.DataSizeInBytes();
+    KALDI_ASSERT(size == ref_cmat.DataSizeInBytes() &&
+                 memcmp(cmat.Data(), ref_cmat.Data(), size) == 0);
+    Matrix<Real> mat2(num_rows, num_cols);
+    cmat.CopyToMat(&mat2);
+    for (int32 r = 0; r < num_rows; r++)
+      KALDI_ASSERT(memcmp(mat2.RowData(r), ref_mat.RowData(r),
+                          num_cols * sizeof(Real)) == 0);
+
+    int32 row_offset = RandInt(0, num_rows - 1),
+        col_offset = RandInt(0, num_cols - 1);
+    Matrix<Real> sub(RandInt(1, num_rows - row_offset),
+                     RandInt(1, num_cols - col_offset)), ref_sub(sub);
+    Vector<Real> row(num_cols), ref_row(num_cols);
+    SetSimdMathLevel(kSimdMathScalar);
+    cmat.CopyToMat(row_offset, col_offset, &ref_sub);
+    cmat.CopyRowToVec(row_offset, &ref_row);
+    SetSimdMathLevel(cpu_level);
+    cmat.CopyToMat(row_offset, col_offset, &sub);
+    cmat.CopyRowToVec(row_offset, &row);
+    for (int32 r = 0; r < sub.NumRows(); r++)
+      KALDI_ASSERT(memcmp(sub.RowData(r), ref_sub.RowData(r),
+                          sub.NumCols() * sizeof(Real)) == 0);
+    KALDI_ASSERT(memcmp(row.Data(), ref_row.Data(),
+                        num_cols * sizeof(Real)) == 0);
+  }
+}
+
 template<typename Real> static void UnitTestCompressedMatrix() {
   // This is the basic test.
 
@@ -4602,6 +5030,7 @@ template<typename Real> static void MatrixUnitTest(bool full_test) {
   // UnitTestSvdBad<Real>(); // test bug in Jama SVD code.
   UnitTestCompressedMatrix<Real>();
   UnitTestCompressedMatrix2<Real>();
+  UnitTestCompressedMatrixSimd<Real>();
   UnitTestExtractCompressedMatrix<Real>();
   UnitTestResize<Real>();
   UnitTestResizeCopyDataDifferentStrideType<Real>();
@@ -4683,6 +5112,9 @@ template<typename Real> static void MatrixUnitTest(bool full_test) {
   UnitTestSimpleForMat<Real>();
   UnitTestTanh<Real>();
   UnitTestSigmoid<Real>();
+  UnitTestSimdMath();
+  UnitTestSmallGemm<Real>();
+  UnitTestLstmProjectedStep<Real>();
   UnitTestSoftHinge<Real>();
   UnitTestNorm<Real>();
   UnitTestCopyCols<Real>();
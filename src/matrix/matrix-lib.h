@@ -32,6 +32,10 @@
 #include "matrix/compressed-matrix.h"
 #include "matrix/sparse-matrix.h"
 #include "matrix/optimization.h"
+#include "matrix/simd-math.h"
+#include "matrix/small-gemm.h"
+#include "matrix/block-sparse-matrix.h"
+#include "matrix/host-allocator.h"
 
 #endif
 
@@ -24,6 +24,7 @@
  * Implementation of specialized PackedMatrix template methods
  */
 #include "matrix/cblas-wrappers.h"
+#include "matrix/host-allocator.h"
 #include "matrix/packed-matrix.h"
 #include "matrix/kaldi-vector.h"
 
@@ -66,15 +67,9 @@ inline void PackedMatrix<Real>::Init(MatrixIndexT r) {
                << "in MatrixIndexT: not all code is tested for this case.";
   }
 
-  void *data;  // aligned memory block
-  void *temp;
-
-  if ((data = KALDI_MEMALIGN(16, size * sizeof(Real), &temp)) != NULL) {
-    this->data_ = static_cast<Real *> (data);
-    this->num_rows_ = r;
-  } else {
-    throw std::bad_alloc();
-  }
+  this->data_ = static_cast<Real *>(
+      HostMemoryAllocator::Instance().Malloc(size * sizeof(Real)));
+  this->num_rows_ = r;
 }
 
 template<typename Real>
@@ -226,7 +221,7 @@ Real PackedMatrix<Real>::Trace() const {
 template<typename Real>
 void PackedMatrix<Real>::Destroy() {
   // we need to free the data block if it was defined
-  if (data_ != NULL) KALDI_MEMALIGN_FREE(data_);
+  HostMemoryAllocator::Instance().Free(data_);
   data_ = NULL;
   num_rows_ = 0;
 }
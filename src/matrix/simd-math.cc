@@ -0,0 +1,430 @@
+// matrix/simd-math.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cfloat>
+#include <limits>
+
+#include "base/kaldi-math.h"
+#include "matrix/simd-math.h"
+
+// The AVX code is compiled with function-level target attributes, so that the
+// rest of the library needs no special compiler flags and runs on any CPU.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KALDI_SIMD_MATH_X86 1
+#include <immintrin.h>
+#define KALDI_AVX2 __attribute__((target("avx2,fma")))
+#define KALDI_AVX512 __attribute__((target("avx512f")))
+#endif
+
+namespace kaldi {
+
+namespace {
+
+// The scalar versions.
+
+template<typename Real>
+void ScalarExp(const Real *in, Real *out, MatrixIndexT dim) {
+  for (MatrixIndexT i = 0; i < dim; i++)
+    out[i] = Exp(in[i]);
+}
+
+template<typename Real>
+void ScalarLog(const Real *in, Real *out, MatrixIndexT dim) {
+  for (MatrixIndexT i = 0; i < dim; i++)
+    out[i] = Log(in[i]);
+}
+
+template<typename Real>
+void ScalarTanh(const Real *in, Real *out, MatrixIndexT dim) {
+  for (MatrixIndexT i = 0; i < dim; i++) {
+    Real x = in[i];
+    if (x > 0.0) {
+      Real inv_expx = Exp(-x);
+      x = -1.0 + 2.0 / (1.0 + inv_expx * inv_expx);
+    } else {
+      Real expx = Exp(x);
+      x = 1.0 - 2.0 / (1.0 + expx * expx);
+    }
+    out[i] = x;
+  }
+}
+
+template<typename Real>
+void ScalarSigmoid(const Real *in, Real *out, MatrixIndexT dim) {
+  for (MatrixIndexT i = 0; i < dim; i++) {
+    Real x = in[i];
+    // We aim to avoid floating-point overflow here.
+    if (x > 0.0) {
+      x = 1.0 / (1.0 + Exp(-x));
+    } else {
+      Real ex = Exp(x);
+      x = ex / (ex + 1.0);
+    }
+    out[i] = x;
+  }
+}
+
+#ifdef KALDI_SIMD_MATH_X86
+
+// The constants of the Cephes single-precision expf(), logf() and tanhf().
+const float kExpHi = 88.7228394f;   // log(FLT_MAX)
+const float kExpLo = -87.3365448f;  // log(FLT_MIN)
+const float kLog2e = 1.44269504088896341f;
+const float kLn2Hi = 0.693359375f;  // ln(2) = kLn2Hi + kLn2Lo
+const float kLn2Lo = -2.12194440e-4f;
+const float kExpP0 = 1.9875691500e-4f, kExpP1 = 1.3981999507e-3f,
+    kExpP2 = 8.3334519073e-3f, kExpP3 = 4.1665795894e-2f,
+    kExpP4 = 1.6666665459e-1f, kExpP5 = 5.0000001201e-1f;
+const float kSqrtHalf = 0.707106781186547524f;
+const float kLogP0 = 7.0376836292e-2f, kLogP1 = -1.1514610310e-1f,
+    kLogP2 = 1.1676998740e-1f, kLogP3 = -1.2420140846e-1f,
+    kLogP4 = 1.4249322787e-1f, kLogP5 = -1.6668057665e-1f,
+    kLogP6 = 2.0000714765e-1f, kLogP7 = -2.4999993993e-1f,
+    kLogP8 = 3.3333331174e-1f;
+const float kTanhSmall = 0.625f;  // below this tanh() is a polynomial.
+const float kTanhP0 = -5.70498872745e-3f, kTanhP1 = 2.06390887954e-2f,
+    kTanhP2 = -5.37397155531e-2f, kTanhP3 = 1.33314422036e-1f,
+    kTanhP4 = -3.33332819422e-1f;
+
+// AVX2, 8 floats at a time.  Note: the max and min instructions return their
+// second operand if either is NaN, which is how NaNs get through the clamping.
+
+KALDI_AVX2 inline __m256 Exp8(__m256 x) {
+  const __m256 hi = _mm256_set1_ps(kExpHi), lo = _mm256_set1_ps(kExpLo);
+  __m256 overflow = _mm256_cmp_ps(x, hi, _CMP_GT_OQ),
+      underflow = _mm256_cmp_ps(x, lo, _CMP_LT_OQ);
+  x = _mm256_min_ps(hi, _mm256_max_ps(lo, x));
+  // exp(x) = 2^n exp(r), with n = round(x / ln(2)) and |r| <= ln(2) / 2.
+  __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(kLog2e)),
+                             _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(kLn2Hi), x);
+  r = _mm256_fnmadd_ps(n, _mm256_set1_ps(kLn2Lo), r);
+  __m256 y = _mm256_set1_ps(kExpP0);
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP1));
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP2));
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP3));
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP4));
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP5));
+  y = _mm256_fmadd_ps(y, _mm256_mul_ps(r, r), r);
+  y = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+  // n is in [-126, 128], so 2^n is applied in two halves, each of which is a
+  // normal float.
+  __m256i ni = _mm256_cvtps_epi32(n),
+      n1 = _mm256_srai_epi32(ni, 1),
+      n2 = _mm256_sub_epi32(ni, n1);
+  const __m256i bias = _mm256_set1_epi32(127);
+  y = _mm256_mul_ps(y, _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_add_epi32(n1, bias), 23)));
+  y = _mm256_mul_ps(y, _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_add_epi32(n2, bias), 23)));
+  y = _mm256_blendv_ps(y, _mm256_set1_ps(HUGE_VALF), overflow);
+  return _mm256_blendv_ps(y, _mm256_setzero_ps(), underflow);
+}
+
+KALDI_AVX2 inline __m256 Log8(__m256 x) {
+  const __m256 zero = _mm256_setzero_ps();
+  __m256 is_nan = _mm256_cmp_ps(x, x, _CMP_UNORD_Q),
+      is_negative = _mm256_cmp_ps(x, zero, _CMP_LT_OQ),
+      is_zero = _mm256_cmp_ps(x, zero, _CMP_EQ_OQ),
+      is_inf = _mm256_cmp_ps(x, _mm256_set1_ps(HUGE_VALF), _CMP_EQ_OQ),
+      is_denormal = _mm256_and_ps(
+          _mm256_cmp_ps(x, zero, _CMP_GT_OQ),
+          _mm256_cmp_ps(x, _mm256_set1_ps(FLT_MIN), _CMP_LT_OQ));
+  // Denormals are scaled by 2^23 first.
+  x = _mm256_blendv_ps(x, _mm256_mul_ps(x, _mm256_set1_ps(8388608.0f)),
+                       is_denormal);
+  __m256i xi = _mm256_castps_si256(x);
+  // x = m 2^e with m in [0.5, 1).
+  __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(
+      _mm256_srli_epi32(xi, 23), _mm256_set1_epi32(126)));
+  e = _mm256_sub_ps(e, _mm256_and_ps(is_denormal, _mm256_set1_ps(23.0f)));
+  __m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+      _mm256_and_si256(xi, _mm256_set1_epi32(0x007fffff)),
+      _mm256_set1_epi32(0x3f000000)));
+  // If m < sqrt(1/2), use 2m and e - 1; then take m - 1.
+  __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(kSqrtHalf), _CMP_LT_OQ);
+  e = _mm256_sub_ps(e, _mm256_and_ps(small, _mm256_set1_ps(1.0f)));
+  m = _mm256_add_ps(_mm256_sub_ps(m, _mm256_set1_ps(1.0f)),
+                    _mm256_and_ps(small, m));
+  __m256 z = _mm256_mul_ps(m, m);
+  __m256 y = _mm256_set1_ps(kLogP0);
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP1));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP2));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP3));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP4));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP5));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP6));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP7));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP8));
+  y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+  y = _mm256_fmadd_ps(e, _mm256_set1_ps(kLn2Lo), y);
+  y = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), y);
+  y = _mm256_add_ps(m, y);
+  y = _mm256_fmadd_ps(e, _mm256_set1_ps(kLn2Hi), y);
+  y = _mm256_blendv_ps(y, _mm256_set1_ps(-HUGE_VALF), is_zero);
+  y = _mm256_blendv_ps(y, _mm256_set1_ps(HUGE_VALF), is_inf);
+  y = _mm256_blendv_ps(y, _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN()),
+                       is_negative);
+  return _mm256_blendv_ps(y, x, is_nan);
+}
+
+KALDI_AVX2 inline __m256 Tanh8(__m256 x) {
+  const __m256 sign_bit = _mm256_set1_ps(-0.0f);
+  __m256 ax = _mm256_andnot_ps(sign_bit, x);
+  // Small |x|: x + x^3 P(x^2).
+  __m256 z = _mm256_mul_ps(x, x);
+  __m256 p = _mm256_set1_ps(kTanhP0);
+  p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(kTanhP1));
+  p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(kTanhP2));
+  p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(kTanhP3));
+  p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(kTanhP4));
+  __m256 small_result = _mm256_fmadd_ps(_mm256_mul_ps(p, z), x, x);
+  // Otherwise: sign(x) (1 - t) / (1 + t), with t = exp(-2|x|).
+  const __m256 one = _mm256_set1_ps(1.0f);
+  __m256 t = Exp8(_mm256_mul_ps(ax, _mm256_set1_ps(-2.0f)));
+  __m256 large_result = _mm256_div_ps(_mm256_sub_ps(one, t),
+                                      _mm256_add_ps(one, t));
+  large_result = _mm256_or_ps(large_result, _mm256_and_ps(sign_bit, x));
+  return _mm256_blendv_ps(large_result, small_result,
+      _mm256_cmp_ps(ax, _mm256_set1_ps(kTanhSmall), _CMP_LT_OQ));
+}
+
+KALDI_AVX2 inline __m256 Sigmoid8(__m256 x) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  __m256 t = Exp8(_mm256_sub_ps(_mm256_setzero_ps(), x));
+  return _mm256_div_ps(one, _mm256_add_ps(one, t));
+}
+
+// Applies "Func" to 8 floats at a time, and to the rest with masked loads
+// and stores.  The upper halves of the registers are cleared at the end, as
+// GCC does not always do it in functions with a target attribute, and the SSE
+// code that follows would be slowed down.
+#define KALDI_AVX2_LOOP(Name, Func)                                          \
+  KALDI_AVX2 void Name(const float *in, float *out, MatrixIndexT dim) {      \
+    MatrixIndexT i = 0;                                                      \
+    for (; i + 8 <= dim; i += 8)                                             \
+      _mm256_storeu_ps(out + i, Func(_mm256_loadu_ps(in + i)));              \
+    if (i < dim) {                                                           \
+      __m256i mask = _mm256_cmpgt_epi32(                                     \
+          _mm256_set1_epi32(dim - i),                                        \
+          _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));                        \
+      _mm256_maskstore_ps(out + i, mask,                                     \
+                          Func(_mm256_maskload_ps(in + i, mask)));           \
+    }                                                                        \
+    _mm256_zeroupper();                                                      \
+  }
+
+KALDI_AVX2_LOOP(ExpAvx2, Exp8)
+KALDI_AVX2_LOOP(LogAvx2, Log8)
+KALDI_AVX2_LOOP(TanhAvx2, Tanh8)
+KALDI_AVX2_LOOP(SigmoidAvx2, Sigmoid8)
+
+// AVX-512, 16 floats at a time; the same as the AVX2 code, with mask
+// registers.  (The float logical instructions need AVX-512DQ, so the bits are
+// handled as integers.)
+
+// GCC reports -Wmaybe-uninitialized in the AVX-512 intrinsics headers when
+// they are inlined here; it is a false positive.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+KALDI_AVX512 inline __m512 Exp16(__m512 x) {
+  const __m512 hi = _mm512_set1_ps(kExpHi), lo = _mm512_set1_ps(kExpLo);
+  __mmask16 overflow = _mm512_cmp_ps_mask(x, hi, _CMP_GT_OQ),
+      underflow = _mm512_cmp_ps_mask(x, lo, _CMP_LT_OQ);
+  x = _mm512_min_ps(hi, _mm512_max_ps(lo, x));
+  __m512 n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(kLog2e)),
+                                  _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(kLn2Hi), x);
+  r = _mm512_fnmadd_ps(n, _mm512_set1_ps(kLn2Lo), r);
+  __m512 y = _mm512_set1_ps(kExpP0);
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP1));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP2));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP3));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP4));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP5));
+  y = _mm512_fmadd_ps(y, _mm512_mul_ps(r, r), r);
+  y = _mm512_add_ps(y, _mm512_set1_ps(1.0f));
+  __m512i ni = _mm512_cvtps_epi32(n),
+      n1 = _mm512_srai_epi32(ni, 1),
+      n2 = _mm512_sub_epi32(ni, n1);
+  const __m512i bias = _mm512_set1_epi32(127);
+  y = _mm512_mul_ps(y, _mm512_castsi512_ps(
+      _mm512_slli_epi32(_mm512_add_epi32(n1, bias), 23)));
+  y = _mm512_mul_ps(y, _mm512_castsi512_ps(
+      _mm512_slli_epi32(_mm512_add_epi32(n2, bias), 23)));
+  y = _mm512_mask_blend_ps(overflow, y, _mm512_set1_ps(HUGE_VALF));
+  return _mm512_mask_blend_ps(underflow, y, _mm512_setzero_ps());
+}
+
+KALDI_AVX512 inline __m512 Log16(__m512 x) {
+  const __m512 zero = _mm512_setzero_ps();
+  __mmask16 is_nan = _mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q),
+      is_negative = _mm512_cmp_ps_mask(x, zero, _CMP_LT_OQ),
+      is_zero = _mm512_cmp_ps_mask(x, zero, _CMP_EQ_OQ),
+      is_inf = _mm512_cmp_ps_mask(x, _mm512_set1_ps(HUGE_VALF), _CMP_EQ_OQ),
+      is_denormal = _mm512_cmp_ps_mask(x, zero, _CMP_GT_OQ) &
+                    _mm512_cmp_ps_mask(x, _mm512_set1_ps(FLT_MIN), _CMP_LT_OQ);
+  __m512 input = x;
+  x = _mm512_mask_mul_ps(x, is_denormal, x, _mm512_set1_ps(8388608.0f));
+  __m512i xi = _mm512_castps_si512(x);
+  __m512 e = _mm512_cvtepi32_ps(_mm512_sub_epi32(
+      _mm512_srli_epi32(xi, 23), _mm512_set1_epi32(126)));
+  e = _mm512_mask_sub_ps(e, is_denormal, e, _mm512_set1_ps(23.0f));
+  __m512 m = _mm512_castsi512_ps(_mm512_or_si512(
+      _mm512_and_si512(xi, _mm512_set1_epi32(0x007fffff)),
+      _mm512_set1_epi32(0x3f000000)));
+  __mmask16 small = _mm512_cmp_ps_mask(m, _mm512_set1_ps(kSqrtHalf),
+                                       _CMP_LT_OQ);
+  e = _mm512_mask_sub_ps(e, small, e, _mm512_set1_ps(1.0f));
+  m = _mm512_mask_add_ps(m, small, m, m);
+  m = _mm512_sub_ps(m, _mm512_set1_ps(1.0f));
+  __m512 z = _mm512_mul_ps(m, m);
+  __m512 y = _mm512_set1_ps(kLogP0);
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP1));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP2));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP3));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP4));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP5));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP6));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP7));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP8));
+  y = _mm512_mul_ps(_mm512_mul_ps(y, m), z);
+  y = _mm512_fmadd_ps(e, _mm512_set1_ps(kLn2Lo), y);
+  y = _mm512_fnmadd_ps(z, _mm512_set1_ps(0.5f), y);
+  y = _mm512_add_ps(m, y);
+  y = _mm512_fmadd_ps(e, _mm512_set1_ps(kLn2Hi), y);
+  y = _mm512_mask_blend_ps(is_zero, y, _mm512_set1_ps(-HUGE_VALF));
+  y = _mm512_mask_blend_ps(is_inf, y, _mm512_set1_ps(HUGE_VALF));
+  y = _mm512_mask_blend_ps(is_negative, y,
+      _mm512_set1_ps(std::numeric_limits<float>::quiet_NaN()));
+  return _mm512_mask_blend_ps(is_nan, y, input);
+}
+
+KALDI_AVX512 inline __m512 Tanh16(__m512 x) {
+  const __m512i sign_bit = _mm512_set1_epi32(0x80000000);
+  __m512i xi = _mm512_castps_si512(x);
+  __m512 ax = _mm512_castsi512_ps(_mm512_andnot_si512(sign_bit, xi));
+  __m512 z = _mm512_mul_ps(x, x);
+  __m512 p = _mm512_set1_ps(kTanhP0);
+  p = _mm512_fmadd_ps(p, z, _mm512_set1_ps(kTanhP1));
+  p = _mm512_fmadd_ps(p, z, _mm512_set1_ps(kTanhP2));
+  p = _mm512_fmadd_ps(p, z, _mm512_set1_ps(kTanhP3));
+  p = _mm512_fmadd_ps(p, z, _mm512_set1_ps(kTanhP4));
+  __m512 small_result = _mm512_fmadd_ps(_mm512_mul_ps(p, z), x, x);
+  const __m512 one = _mm512_set1_ps(1.0f);
+  __m512 t = Exp16(_mm512_mul_ps(ax, _mm512_set1_ps(-2.0f)));
+  __m512 large_result = _mm512_div_ps(_mm512_sub_ps(one, t),
+                                      _mm512_add_ps(one, t));
+  large_result = _mm512_castsi512_ps(_mm512_or_si512(
+      _mm512_castps_si512(large_result), _mm512_and_si512(sign_bit, xi)));
+  return _mm512_mask_blend_ps(
+      _mm512_cmp_ps_mask(ax, _mm512_set1_ps(kTanhSmall), _CMP_LT_OQ),
+      large_result, small_result);
+}
+
+KALDI_AVX512 inline __m512 Sigmoid16(__m512 x) {
+  const __m512 one = _mm512_set1_ps(1.0f);
+  __m512 t = Exp16(_mm512_sub_ps(_mm512_setzero_ps(), x));
+  return _mm512_div_ps(one, _mm512_add_ps(one, t));
+}
+
+#define KALDI_AVX512_LOOP(Name, Func)                                        \
+  KALDI_AVX512 void Name(const float *in, float *out, MatrixIndexT dim) {    \
+    MatrixIndexT i = 0;                                                      \
+    for (; i + 16 <= dim; i += 16)                                           \
+      _mm512_storeu_ps(out + i, Func(_mm512_loadu_ps(in + i)));              \
+    if (i < dim) {                                                           \
+      __mmask16 mask = (1u << (dim - i)) - 1;                                \
+      _mm512_mask_storeu_ps(out + i, mask,                                   \
+                            Func(_mm512_maskz_loadu_ps(mask, in + i)));      \
+    }                                                                        \
+    _mm256_zeroupper();                                                      \
+  }
+
+KALDI_AVX512_LOOP(ExpAvx512, Exp16)
+KALDI_AVX512_LOOP(LogAvx512, Log16)
+KALDI_AVX512_LOOP(TanhAvx512, Tanh16)
+KALDI_AVX512_LOOP(SigmoidAvx512, Sigmoid16)
+
+#pragma GCC diagnostic pop
+
+SimdMathLevel CpuSimdMathLevel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return kSimdMathAvx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return kSimdMathAvx2;
+  return kSimdMathScalar;
+}
+
+#else
+
+SimdMathLevel CpuSimdMathLevel() { return kSimdMathScalar; }
+
+#endif  // KALDI_SIMD_MATH_X86
+
+const SimdMathLevel cpu_simd_math_level = CpuSimdMathLevel();
+SimdMathLevel simd_math_level = cpu_simd_math_level;
+
+}  // namespace
+
+SimdMathLevel GetSimdMathLevel() { return simd_math_level; }
+
+void SetSimdMathLevel(SimdMathLevel level) {
+  simd_math_level = std::min(level, cpu_simd_math_level);
+}
+
+#ifdef KALDI_SIMD_MATH_X86
+#define KALDI_SIMD_MATH_DISPATCH(Name)                                       \
+  void Simd##Name(const float *in, float *out, MatrixIndexT dim) {           \
+    switch (simd_math_level) {                                               \
+      case kSimdMathAvx512: Name##Avx512(in, out, dim); break;               \
+      case kSimdMathAvx2: Name##Avx2(in, out, dim); break;                   \
+      default: Scalar##Name(in, out, dim);                                   \
+    }                                                                        \
+  }
+#else
+#define KALDI_SIMD_MATH_DISPATCH(Name)                                       \
+  void Simd##Name(const float *in, float *out, MatrixIndexT dim) {           \
+    Scalar##Name(in, out, dim);                                              \
+  }
+#endif
+
+KALDI_SIMD_MATH_DISPATCH(Exp)
+KALDI_SIMD_MATH_DISPATCH(Log)
+KALDI_SIMD_MATH_DISPATCH(Tanh)
+KALDI_SIMD_MATH_DISPATCH(Sigmoid)
+
+void SimdExp(const double *in, double *out, MatrixIndexT dim) {
+  ScalarExp(in, out, dim);
+}
+
+void SimdLog(const double *in, double *out, MatrixIndexT dim) {
+  ScalarLog(in, out, dim);
+}
+
+void SimdTanh(const double *in, double *out, MatrixIndexT dim) {
+  ScalarTanh(in, out, dim);
+}
+
+void SimdSigmoid(const double *in, double *out, MatrixIndexT dim) {
+  ScalarSigmoid(in, out, dim);
+}
+
+}  // namespace kaldi
@@ -0,0 +1,79 @@
+// matrix/simd-math.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_SIMD_MATH_H_
+#define KALDI_MATRIX_SIMD_MATH_H_
+
+#include "matrix/matrix-common.h"
+
+namespace kaldi {
+
+/// @addtogroup matrix_funcs_misc
+/// @{
+
+/**
+   Elementwise exp, log, tanh and sigmoid of arrays, used by the CPU code of
+   VectorBase and MatrixBase (ApplyExp(), ApplyLog(), Tanh(), Sigmoid(),
+   ApplySoftMax() and ApplyLogSoftMax(), and so the CuMatrix functions in CPU
+   builds).  "out" may be the same as "in".
+
+   For float, if the CPU supports AVX-512 (or else AVX2 and FMA), which is
+   checked at runtime, these evaluate the polynomial approximations of the
+   Cephes library 16 (or 8) elements at a time; otherwise, and for double,
+   they call the scalar functions of kaldi-math.h.  The errors of the
+   vectorized versions, relative to the exact results, are at most (see
+   UnitTestSimdMath() in matrix-lib-test.cc):
+     exp:      2 ulp (1.2e-7 relative); results below FLT_MIN are flushed to
+               zero, those above FLT_MAX are +inf.
+     log:      1 ulp, or 1e-7 absolute near 1; log(0) is -inf, log of a
+               negative number is NaN.
+     tanh:     2 ulp.
+     sigmoid:  3 ulp; results below FLT_MIN are flushed to zero.
+   NaNs are propagated.
+ */
+void SimdExp(const float *in, float *out, MatrixIndexT dim);
+void SimdExp(const double *in, double *out, MatrixIndexT dim);
+
+void SimdLog(const float *in, float *out, MatrixIndexT dim);
+void SimdLog(const double *in, double *out, MatrixIndexT dim);
+
+void SimdTanh(const float *in, float *out, MatrixIndexT dim);
+void SimdTanh(const double *in, double *out, MatrixIndexT dim);
+
+void SimdSigmoid(const float *in, float *out, MatrixIndexT dim);
+void SimdSigmoid(const double *in, double *out, MatrixIndexT dim);
+
+/// The instruction sets the functions above may use.
+enum SimdMathLevel {
+  kSimdMathScalar = 0,
+  kSimdMathAvx2 = 1,
+  kSimdMathAvx512 = 2
+};
+
+/// Returns the instruction set the functions above currently use; this is
+/// the best one the CPU supports, unless SetSimdMathLevel() was called.
+SimdMathLevel GetSimdMathLevel();
+
+/// Makes the functions above, and the compression code of CompressedMatrix,
+/// use at most "level" (for testing and benchmarking).  Not thread-safe.
+void SetSimdMathLevel(SimdMathLevel level);
+
+/// @} end of "addtogroup matrix_funcs_misc"
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_SIMD_MATH_H_
@@ -0,0 +1,250 @@
+// matrix/small-gemm.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "matrix/simd-math.h"
+#include "matrix/small-gemm.h"
+
+// The kernel is compiled with a function-level target attribute, as in
+// simd-math.cc.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KALDI_SMALL_GEMM_X86 1
+#include <immintrin.h>
+#define KALDI_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace kaldi {
+
+template<typename Real>
+const MatrixIndexT SmallGemmWeights<Real>::kPanelWidth;
+
+namespace {
+
+// The row blocks of A: W is read once per block.
+const MatrixIndexT kRowBlock = 4;
+const MatrixIndexT kWidth = SmallGemmWeights<float>::kPanelWidth;
+
+// Whether SmallGemmWeights<Real>::Pack() should pack W, i.e. whether there is
+// a kernel for it.
+template<typename Real> bool HaveKernel() { return false; }
+
+#ifdef KALDI_SMALL_GEMM_X86
+template<> bool HaveKernel<float>() {
+  return GetSimdMathLevel() >= kSimdMathAvx2;
+}
+
+// Sets acc (NumRows by kWidth) to the product of NumRows rows of A (with
+// stride "stride") and a panel (K by kWidth), with 2 * NumRows accumulators
+// of 8 floats.
+template<int NumRows>
+KALDI_AVX2 void KernelAvx2(MatrixIndexT K, const float *a, MatrixIndexT stride,
+                           const float *panel, float *acc) {
+  __m256 sum0[NumRows], sum1[NumRows];
+  for (int r = 0; r < NumRows; r++)
+    sum0[r] = sum1[r] = _mm256_setzero_ps();
+  for (MatrixIndexT k = 0; k < K; k++, panel += kWidth) {
+    __m256 w0 = _mm256_loadu_ps(panel), w1 = _mm256_loadu_ps(panel + 8);
+    for (int r = 0; r < NumRows; r++) {
+      __m256 a_rk = _mm256_broadcast_ss(a + r * stride + k);
+      sum0[r] = _mm256_fmadd_ps(a_rk, w0, sum0[r]);
+      sum1[r] = _mm256_fmadd_ps(a_rk, w1, sum1[r]);
+    }
+  }
+  for (int r = 0; r < NumRows; r++) {
+    _mm256_storeu_ps(acc + r * kWidth, sum0[r]);
+    _mm256_storeu_ps(acc + r * kWidth + 8, sum1[r]);
+  }
+  _mm256_zeroupper();
+}
+
+void RunKernel(MatrixIndexT num_rows, MatrixIndexT K, const float *a,
+               MatrixIndexT stride, const float *panel, float *acc) {
+  switch (num_rows) {
+    case 1: KernelAvx2<1>(K, a, stride, panel, acc); break;
+    case 2: KernelAvx2<2>(K, a, stride, panel, acc); break;
+    case 3: KernelAvx2<3>(K, a, stride, panel, acc); break;
+    default: KernelAvx2<4>(K, a, stride, panel, acc);
+  }
+}
+#else
+void RunKernel(MatrixIndexT num_rows, MatrixIndexT K, const float *a,
+               MatrixIndexT stride, const float *panel, float *acc) {
+  KALDI_ERR << "No SmallGemm() kernel for this CPU.";  // not reached.
+}
+#endif  // KALDI_SMALL_GEMM_X86
+
+void RunKernel(MatrixIndexT num_rows, MatrixIndexT K, const double *a,
+               MatrixIndexT stride, const double *panel, double *acc) {
+  KALDI_ERR << "No SmallGemm() kernel for double.";  // not reached.
+}
+
+}  // namespace
+
+template<typename Real>
+void SmallGemmWeights<Real>::Pack(const MatrixBase<Real> &w) {
+  num_rows_ = w.NumRows();
+  num_cols_ = w.NumCols();
+  if (!HaveKernel<Real>() && num_cols_ > 0) {
+    std::vector<Real>().swap(panels_);
+    w_ = w;
+    return;
+  }
+  w_.Resize(0, 0);
+  panels_.assign(static_cast<size_t>(NumPanels()) * kPanelWidth * num_cols_,
+                 0);
+  for (MatrixIndexT r = 0; r < num_rows_; r++) {
+    Real *panel = panels_.data() +
+        static_cast<size_t>(r / kPanelWidth) * kPanelWidth * num_cols_;
+    const Real *w_row = w.RowData(r);
+    for (MatrixIndexT k = 0; k < num_cols_; k++)
+      panel[k * kPanelWidth + r % kPanelWidth] = w_row[k];
+  }
+}
+
+template<typename Real>
+void SmallGemmWeights<Real>::Clear() {
+  num_rows_ = 0;
+  num_cols_ = 0;
+  std::vector<Real>().swap(panels_);
+  w_.Resize(0, 0);
+}
+
+template<typename Real>
+void SmallGemm(Real alpha, const MatrixBase<Real> &A,
+               const SmallGemmWeights<Real> &W, Real beta,
+               MatrixBase<Real> *C) {
+  KALDI_ASSERT(A.NumCols() == W.NumCols() && C->NumCols() == W.NumRows() &&
+               C->NumRows() == A.NumRows());
+  MatrixIndexT num_rows = A.NumRows(), num_cols = C->NumCols(),
+      K = A.NumCols(), num_panels = W.NumPanels();
+  if (K == 0) {
+    if (beta == 0) C->SetZero();
+    else C->Scale(beta);
+    return;
+  }
+  if (W.panels_.empty()) {
+    C->AddMatMat(alpha, A, kNoTrans, W.w_, kTrans, beta);
+    return;
+  }
+  Real acc[kRowBlock * kWidth];
+  for (MatrixIndexT i = 0; i < num_rows; i += kRowBlock) {
+    MatrixIndexT block_rows = std::min(kRowBlock, num_rows - i);
+    for (MatrixIndexT p = 0; p < num_panels; p++) {
+      RunKernel(block_rows, K, A.RowData(i), A.Stride(), W.Panel(p), acc);
+      MatrixIndexT col = p * kWidth,
+          block_cols = std::min(kWidth, num_cols - col);
+      for (MatrixIndexT r = 0; r < block_rows; r++) {
+        Real *c = C->RowData(i + r) + col;
+        const Real *acc_r = acc + r * kWidth;
+        if (beta == 0) {
+          for (MatrixIndexT j = 0; j < block_cols; j++)
+            c[j] = alpha * acc_r[j];
+        } else {
+          for (MatrixIndexT j = 0; j < block_cols; j++)
+            c[j] = alpha * acc_r[j] + beta * c[j];
+        }
+      }
+    }
+  }
+}
+
+template<typename Real>
+void LstmProjectedStep(const SmallGemmWeights<Real> &w_gifo_r,
+                       const SmallGemmWeights<Real> &w_r_m,
+                       const VectorBase<Real> &peephole_i_c,
+                       const VectorBase<Real> &peephole_f_c,
+                       const VectorBase<Real> &peephole_o_c,
+                       Real clip_cell,
+                       const MatrixBase<Real> &prev,
+                       MatrixBase<Real> *cur) {
+  MatrixIndexT ncell = peephole_i_c.Dim(), nrecur = w_r_m.NumRows(),
+      num_rows = cur->NumRows();
+  KALDI_ASSERT(peephole_f_c.Dim() == ncell && peephole_o_c.Dim() == ncell &&
+               w_gifo_r.NumRows() == 4 * ncell &&
+               w_gifo_r.NumCols() == nrecur && w_r_m.NumCols() == ncell &&
+               cur->NumCols() == 7 * ncell + nrecur &&
+               prev.NumCols() == cur->NumCols() && prev.NumRows() == num_rows);
+  const Real *p_i = peephole_i_c.Data(), *p_f = peephole_f_c.Data(),
+      *p_o = peephole_o_c.Data();
+  // r(t-1) -> g, i, f, o
+  SubMatrix<Real> y_gifo(*cur, 0, num_rows, 0, 4 * ncell);
+  SmallGemm(Real(1), SubMatrix<Real>(prev, 0, num_rows, 7 * ncell, nrecur),
+            w_gifo_r, Real(1), &y_gifo);
+  for (MatrixIndexT r = 0; r < num_rows; r++) {
+    Real *y_g = cur->RowData(r), *y_i = y_g + ncell, *y_f = y_i + ncell,
+        *y_o = y_f + ncell, *y_c = y_o + ncell, *y_h = y_c + ncell,
+        *y_m = y_h + ncell;
+    const Real *prev_c = prev.RowData(r) + 4 * ncell;
+    // peepholes c(t-1) -> i(t), f(t); i and f are adjacent, so both are
+    // squashed at once.
+    for (MatrixIndexT j = 0; j < ncell; j++) {
+      y_i[j] += p_i[j] * prev_c[j];
+      y_f[j] += p_f[j] * prev_c[j];
+    }
+    SimdSigmoid(y_i, y_i, 2 * ncell);
+    SimdTanh(y_g, y_g, ncell);
+    for (MatrixIndexT j = 0; j < ncell; j++) {
+      Real c = y_g[j] * y_i[j] + prev_c[j] * y_f[j];
+      y_c[j] = std::min(std::max(c, -clip_cell), clip_cell);
+    }
+    SimdTanh(y_c, y_h, ncell);
+    // peephole c(t) -> o(t)
+    for (MatrixIndexT j = 0; j < ncell; j++)
+      y_o[j] += p_o[j] * y_c[j];
+    SimdSigmoid(y_o, y_o, ncell);
+    for (MatrixIndexT j = 0; j < ncell; j++)
+      y_m[j] = y_h[j] * y_o[j];
+  }
+  // m -> r
+  SubMatrix<Real> y_r(*cur, 0, num_rows, 7 * ncell, nrecur);
+  SmallGemm(Real(1), SubMatrix<Real>(*cur, 0, num_rows, 6 * ncell, ncell),
+            w_r_m, Real(0), &y_r);
+}
+
+template class SmallGemmWeights<float>;
+template class SmallGemmWeights<double>;
+
+template
+void SmallGemm(float alpha, const MatrixBase<float> &A,
+               const SmallGemmWeights<float> &W, float beta,
+               MatrixBase<float> *C);
+template
+void SmallGemm(double alpha, const MatrixBase<double> &A,
+               const SmallGemmWeights<double> &W, double beta,
+               MatrixBase<double> *C);
+
+template
+void LstmProjectedStep(const SmallGemmWeights<float> &w_gifo_r,
+                       const SmallGemmWeights<float> &w_r_m,
+                       const VectorBase<float> &peephole_i_c,
+                       const VectorBase<float> &peephole_f_c,
+                       const VectorBase<float> &peephole_o_c,
+                       float clip_cell,
+                       const MatrixBase<float> &prev,
+                       MatrixBase<float> *cur);
+template
+void LstmProjectedStep(const SmallGemmWeights<double> &w_gifo_r,
+                       const SmallGemmWeights<double> &w_r_m,
+                       const VectorBase<double> &peephole_i_c,
+                       const VectorBase<double> &peephole_f_c,
+                       const VectorBase<double> &peephole_o_c,
+                       double clip_cell,
+                       const MatrixBase<double> &prev,
+                       MatrixBase<double> *cur);
+
+}  // namespace kaldi
@@ -0,0 +1,130 @@
+// matrix/small-gemm.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_SMALL_GEMM_H_
+#define KALDI_MATRIX_SMALL_GEMM_H_
+
+#include <vector>
+
+#include "matrix/kaldi-matrix.h"
+#include "matrix/kaldi-vector.h"
+
+namespace kaldi {
+
+/// @addtogroup matrix_funcs_misc
+/// @{
+
+/**
+   A weight matrix W, copied into the layout used by SmallGemm(): panels of
+   kPanelWidth rows of W (the last one padded with zeros), each stored
+   column by column, so that the kernel reads each panel contiguously.
+
+   This is for products A W^T where A has only a few rows, e.g. the recurrent
+   products of LSTMs and GRUs run on a few streams at a time, which are done
+   once per time step with the same W.  For those, BLAS spends much of its time
+   on call overhead and on packing W again at every call; here W is packed
+   once, by the caller, and the packed copy is reused until W changes.
+
+   There is only a kernel for float with AVX2 and FMA; for double, or if
+   GetSimdMathLevel() (see simd-math.h) is below kSimdMathAvx2 when Pack() is
+   called, W is kept as it is and SmallGemm() calls BLAS.
+ */
+template<typename Real>
+class SmallGemmWeights {
+ public:
+  /// The number of rows of W per panel.
+  static const MatrixIndexT kPanelWidth = 16;
+
+  SmallGemmWeights(): num_rows_(0), num_cols_(0) { }
+
+  explicit SmallGemmWeights(const MatrixBase<Real> &w) { Pack(w); }
+
+  /// Copies "w" into the packed layout, replacing what was there.
+  void Pack(const MatrixBase<Real> &w);
+
+  /// Frees the packed copy; IsEmpty() is then true.  Owners call this when
+  /// they change W, so that they pack it again before the next use.
+  void Clear();
+
+  bool IsEmpty() const { return num_rows_ == 0; }
+
+  /// The dimensions of W.
+  MatrixIndexT NumRows() const { return num_rows_; }
+  MatrixIndexT NumCols() const { return num_cols_; }
+
+ private:
+  template<typename R>
+  friend void SmallGemm(R alpha, const MatrixBase<R> &A,
+                        const SmallGemmWeights<R> &W, R beta,
+                        MatrixBase<R> *C);
+
+  MatrixIndexT NumPanels() const {
+    return (num_rows_ + kPanelWidth - 1) / kPanelWidth;
+  }
+
+  // Panel p has kPanelWidth * num_cols_ elements, starting here; element
+  // (j, k) of the panel is W(p * kPanelWidth + j, k).
+  const Real *Panel(MatrixIndexT p) const {
+    return panels_.data() + static_cast<size_t>(p) * kPanelWidth * num_cols_;
+  }
+
+  MatrixIndexT num_rows_;
+  MatrixIndexT num_cols_;
+  std::vector<Real> panels_;  // empty if W is kept in "w_".
+  Matrix<Real> w_;
+};
+
+/// Does C = alpha A W^T + beta C, where W is given packed; this is the same as
+/// C->AddMatMat(alpha, A, kNoTrans, W, kTrans, beta), but faster when A has
+/// few rows (see UnitTestSmallGemmSpeed() in matrix-lib-speed-test.cc; with
+/// AVX2, 1 to 8 rows take 2 to 3.5 times less time than with OpenBLAS).  W is
+/// read once per 4 rows of A.  As with BLAS, C is not read if beta is zero.
+/// C must not overlap A.
+template<typename Real>
+void SmallGemm(Real alpha, const MatrixBase<Real> &A,
+               const SmallGemmWeights<Real> &W, Real beta,
+               MatrixBase<Real> *C);
+
+/**
+   One time step of a projected LSTM with peephole connections (as in nnet0's
+   LstmProjectedStreamsFast), for the rows of "cur", which are typically one
+   per stream.  The rows of "prev" and "cur" are laid out as that component's
+   propagation buffer, with ncell = peephole_i_c.Dim() and nrecur =
+   w_r_m.NumRows():
+     [ g | i | f | o | c | h | m | r ], each ncell wide except r (nrecur).
+   On input the g, i, f and o parts of "cur" contain the contributions of the
+   input and the bias; this adds that of r(t-1) (w_gifo_r times the r part of
+   "prev"), applies the peepholes (from the c part of "prev") and the
+   nonlinearities, and computes c (clipped to [-clip_cell, clip_cell]), h, m
+   and r = w_r_m m, each row in one pass while it is in the cache; the
+   nonlinearities use SimdSigmoid() and SimdTanh().
+ */
+template<typename Real>
+void LstmProjectedStep(const SmallGemmWeights<Real> &w_gifo_r,
+                       const SmallGemmWeights<Real> &w_r_m,
+                       const VectorBase<Real> &peephole_i_c,
+                       const VectorBase<Real> &peephole_f_c,
+                       const VectorBase<Real> &peephole_o_c,
+                       Real clip_cell,
+                       const MatrixBase<Real> &prev,
+                       MatrixBase<Real> *cur);
+
+/// @} end of "addtogroup matrix_funcs_misc"
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_SMALL_GEMM_H_
@@ -310,6 +310,46 @@ void UnitTestMatrixAddSmatMat() {
 }
 
 
+template <typename Real>
+void UnitTestBlockSparseMatrix() {
+  int32 block_dims[][2] = { {8, 1}, {4, 4}, {1, 1}, {3, 2}, {4, 1} };
+  SimdMathLevel cpu_level = GetSimdMathLevel();
+  for (int32 i = 0; i < 40; i++) {
+    int32 block_rows = block_dims[i % 5][0], block_cols = block_dims[i % 5][1];
+    MatrixIndexT num_rows = RandInt(1, 50), num_cols = RandInt(1, 50),
+        num_frames = RandInt(1, 20);
+    Matrix<Real> B(num_rows, num_cols);
+    B.SetRandn();
+    BaseFloat sparsity = RandInt(0, 10) / 10.0;
+    size_t num_zero = PruneBlocks(sparsity, block_rows, block_cols, &B);
+    BlockSparseMatrix<Real> sparse;
+    sparse.CopyFromMat(B, block_rows, block_cols);
+    size_t num_blocks = ((num_rows + block_rows - 1) / block_rows) *
+        ((num_cols + block_cols - 1) / block_cols);
+    KALDI_ASSERT(sparse.NumBlocks() + num_zero == num_blocks);
+    KALDI_ASSERT(std::abs(static_cast<BaseFloat>(num_zero) -
+                          sparsity * num_blocks) <= 0.5);
+    Matrix<Real> B2(num_rows, num_cols, kUndefined);
+    sparse.CopyToMat(&B2);
+    AssertEqual(B, B2, 0.0);
+
+    Matrix<Real> A(num_frames, num_cols), C(num_frames, num_rows);
+    A.SetRandn();
+    C.SetRandn();
+    Matrix<Real> C2(C);
+    // also with a kernel, where there is one.
+    SetSimdMathLevel(i % 2 == 0 ? kSimdMathScalar : cpu_level);
+    Real alpha = 0.5, beta = (i % 3 == 0 ? 0.0 : 0.7);
+    if (beta == 0.0)
+      C.Set(std::numeric_limits<Real>::quiet_NaN());
+    AddMatBlockSparseMatTrans(alpha, A, sparse, beta, &C);
+    C2.AddMatMat(alpha, A, kNoTrans, B, kTrans, beta);
+    AssertEqual(C, C2, 0.0001);
+  }
+  SetSimdMathLevel(cpu_level);
+}
+
+
 template <typename Real>
 void SparseMatrixUnitTest() {
   // SparseVector
@@ -330,6 +370,9 @@ void SparseMatrixUnitTest() {
   // Matrix functions involving sparse matrices.
   UnitTestMatrixAddMatSmat<Real>();
   UnitTestMatrixAddSmatMat<Real>();
+
+  // BlockSparseMatrix
+  UnitTestBlockSparseMatrix<Real>();
 }
 
 }  // namespace kaldi
@@ -349,7 +349,7 @@ class AffineTransform : public UpdatableComponent {
     return linearity_;
   }
 
-  void SetLinearity(const CuMatrixBase<BaseFloat>& linearity) {
+  virtual void SetLinearity(const CuMatrixBase<BaseFloat>& linearity) {
     KALDI_ASSERT(linearity.NumRows() == linearity_.NumRows());
     KALDI_ASSERT(linearity.NumCols() == linearity_.NumCols());
     linearity_.CopyFromMat(linearity);
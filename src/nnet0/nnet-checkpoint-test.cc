@@ -0,0 +1,146 @@
+// nnet0/nnet-checkpoint-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "nnet0/nnet-affine-transform.h"
+#include "nnet0/nnet-checkpoint.h"
+
+using namespace kaldi;
+using namespace kaldi::nnet0;
+
+// stands in for a SequentialTableReader.
+struct CountingReader {
+	int32 pos, size;
+	CountingReader(int32 size): pos(0), size(size) { }
+	bool Done() const { return pos >= size; }
+	void Next() { pos++; }
+};
+
+void UnitTestCheckpointState() {
+	NnetCheckpointState state, state2;
+	state.version = 42;
+	state.num_utts_done = 12345678901LL;
+	state.merge_state = std::string("\0<LeftMerge> \n\x01", 16);
+	for (int32 binary = 0; binary < 2; binary++) {
+		std::ostringstream os;
+		state.Write(os, binary);
+		std::istringstream is(os.str());
+		state2.Read(is, binary);
+		KALDI_ASSERT(state2.version == state.version &&
+					 state2.num_utts_done == state.num_utts_done &&
+					 state2.merge_state == state.merge_state);
+	}
+}
+
+void UnitTestCheckpointResume() {
+	Nnet nnet;
+	AffineTransform *affine = new AffineTransform(5, 3);
+	Matrix<BaseFloat> linearity(3, 5);
+	Vector<BaseFloat> bias(3);
+	linearity.SetRandn();
+	bias.SetRandn();
+	affine->SetLinearity(CuMatrix<BaseFloat>(linearity));
+	affine->SetBias(CuVector<BaseFloat>(bias));
+	nnet.AppendComponent(affine);
+	Vector<BaseFloat> params;
+	nnet.GetParams(&params);
+
+	NnetCheckpointOptions opts;
+	opts.checkpoint_prefix = "tmp-checkpoint";
+	opts.checkpoint_interval = 0.0;
+	{
+		NnetCheckpointer checkpointer(opts);
+		NnetCheckpointState state;
+		KALDI_ASSERT(!checkpointer.Resume(&state));  // --resume is not set
+		KALDI_ASSERT(checkpointer.Due());
+		for (int32 i = 0; i < 7; i++)
+			KALDI_ASSERT(checkpointer.UtteranceRead() == i);
+		checkpointer.Save(nnet, NULL);
+		// utterances 0..9 read, 0..5 taken, 3 and 5 still being trained.
+		for (int32 i = 7; i < 10; i++)
+			checkpointer.UtteranceRead();
+		for (int32 i = 0; i < 6; i++)
+			checkpointer.ExampleTaken(i);
+		checkpointer.ExampleTaken(5);  // a second example of utterance 5
+		for (int32 i = 0; i < 6; i++)
+			if (i != 3)
+				checkpointer.ExampleTrained(i);
+		KALDI_ASSERT(checkpointer.NumUttsDone() == 3);
+		checkpointer.ExampleTrained(3);
+		KALDI_ASSERT(checkpointer.NumUttsDone() == 5);
+		checkpointer.ExampleTrained(5);
+		KALDI_ASSERT(checkpointer.NumUttsDone() == 5);  // more of 5 may be queued
+		checkpointer.Save(nnet, NULL);
+	}  // the destructor writes what is still pending.
+
+	opts.resume = true;
+	NnetCheckpointer checkpointer(opts);
+	NnetCheckpointState state;
+	KALDI_ASSERT(checkpointer.Resume(&state));
+	KALDI_ASSERT(state.num_utts_done == 5);
+	KALDI_ASSERT(checkpointer.NumUttsDone() == 5 &&
+				 checkpointer.UtteranceRead() == 5);
+
+	Nnet nnet2;
+	nnet2.Read(checkpointer.ModelFilename());
+	Vector<BaseFloat> params2;
+	nnet2.GetParams(&params2);
+	KALDI_ASSERT(params2.ApproxEqual(params, 0.0));
+
+	CountingReader reader(15);
+	KALDI_ASSERT(checkpointer.SkipRead(state.num_utts_done, &reader) == 5);
+	KALDI_ASSERT(reader.pos == 5);
+	CountingReader short_reader(4);
+	KALDI_ASSERT(checkpointer.SkipRead(state.num_utts_done, &short_reader) == 4);
+
+	// a newer checkpoint replaces the model of the one resumed from.
+	std::string old_model = checkpointer.ModelFilename();
+	checkpointer.Save(nnet, NULL);
+	while (checkpointer.NumWritten() == 0)
+		Sleep(0.01);
+	KALDI_ASSERT(checkpointer.ModelFilename() != old_model);
+	KALDI_ASSERT(!std::ifstream(old_model.c_str()).good());
+	NnetCheckpointState state2;
+	NnetCheckpointer checkpointer2(opts);
+	KALDI_ASSERT(checkpointer2.Resume(&state2));
+	KALDI_ASSERT(checkpointer2.ModelFilename() == checkpointer.ModelFilename());
+
+	std::remove(checkpointer.ModelFilename().c_str());
+	std::remove(checkpointer.StateFilename().c_str());
+}
+
+void UnitTestCheckpointRankNames() {
+	NnetCheckpointOptions opts;
+	opts.checkpoint_prefix = "exp/ckpt";
+	NnetCheckpointer single(opts), multi(opts, 3, 8);
+	KALDI_ASSERT(single.ModelFilename() == "exp/ckpt.0.nnet");
+	KALDI_ASSERT(multi.StateFilename() == "exp/ckpt.3.state");
+	NnetCheckpointer disabled((NnetCheckpointOptions()));
+	KALDI_ASSERT(!disabled.Enabled() && !disabled.Due());
+}
+
+int main() {
+	UnitTestCheckpointState();
+	UnitTestCheckpointResume();
+	UnitTestCheckpointRankNames();
+
+	std::cout << "Tests succeeded.\n";
+	return 0;
+}
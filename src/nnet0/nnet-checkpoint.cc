@@ -0,0 +1,229 @@
+// nnet0/nnet-checkpoint.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "base/io-funcs.h"
+#include "util/kaldi-io.h"
+#include "nnet0/nnet-model-merge-function.h"
+#include "nnet0/nnet-checkpoint.h"
+
+namespace kaldi {
+namespace nnet0 {
+
+void NnetCheckpointState::Write(std::ostream &os, bool binary) const {
+	WriteToken(os, binary, "<NnetCheckpoint>");
+	WriteToken(os, binary, "<Version>");
+	WriteBasicType(os, binary, version);
+	WriteToken(os, binary, "<NumUttsDone>");
+	WriteBasicType(os, binary, num_utts_done);
+	// the merge state is binary data of its own, stored with its length.
+	WriteToken(os, binary, "<MergeState>");
+	int64 size = merge_state.size();
+	WriteBasicType(os, binary, size);
+	os.write(merge_state.data(), size);
+	WriteToken(os, binary, "</NnetCheckpoint>");
+}
+
+void NnetCheckpointState::Read(std::istream &is, bool binary) {
+	ExpectToken(is, binary, "<NnetCheckpoint>");
+	ExpectToken(is, binary, "<Version>");
+	ReadBasicType(is, binary, &version);
+	ExpectToken(is, binary, "<NumUttsDone>");
+	ReadBasicType(is, binary, &num_utts_done);
+	ExpectToken(is, binary, "<MergeState>");
+	int64 size;
+	ReadBasicType(is, binary, &size);
+	if (!binary)
+		is.get();  // the space after the length
+	merge_state.resize(size);
+	if (size > 0)
+		is.read(&merge_state[0], size);
+	ExpectToken(is, binary, "</NnetCheckpoint>");
+}
+
+NnetCheckpointer::NnetCheckpointer(const NnetCheckpointOptions &opts,
+		int32 rank, int32 num_procs):
+	opts_(opts), num_utts_read_(0), last_taken_(0), version_(0), written_version_(0),
+	stop_(false), num_written_(0) {
+	if (!Enabled())
+		return;
+	KALDI_ASSERT(opts_.checkpoint_interval >= 0.0);
+	std::ostringstream oss;
+	oss << opts_.checkpoint_prefix;
+	if (num_procs > 1)
+		oss << "." << rank;
+	prefix_ = oss.str();
+	writer_ = std::thread(&NnetCheckpointer::WriterLoop, this);
+}
+
+NnetCheckpointer::~NnetCheckpointer() {
+	if (!writer_.joinable())
+		return;
+	pending_mutex_.Lock();
+	stop_ = true;
+	pending_mutex_.Unlock();
+	writer_sem_.Signal();
+	writer_.join();
+}
+
+bool NnetCheckpointer::Resume(NnetCheckpointState *state) {
+	if (!Enabled() || !opts_.resume)
+		return false;
+	std::ifstream test(StateFilename().c_str());
+	if (!test.good()) {
+		KALDI_LOG << "No checkpoint " << StateFilename() << ", starting from the beginning.";
+		return false;
+	}
+	test.close();
+
+	bool binary;
+	Input ki(StateFilename(), &binary);
+	state->Read(ki.Stream(), binary);
+	num_utts_read_ = state->num_utts_done;
+	last_taken_ = state->num_utts_done;
+	version_ = state->version;
+	written_version_ = state->version;
+	KALDI_LOG << "Resuming from " << ModelFilename() << " after "
+			  << state->num_utts_done << " utterances.";
+	return true;
+}
+
+void NnetCheckpointer::ExampleTaken(int64 utt_index) {
+	if (!Enabled())
+		return;
+	in_flight_mutex_.Lock();
+	in_flight_.insert(utt_index);
+	if (utt_index > last_taken_)
+		last_taken_ = utt_index;
+	in_flight_mutex_.Unlock();
+}
+
+void NnetCheckpointer::ExampleTrained(int64 utt_index) {
+	if (!Enabled())
+		return;
+	in_flight_mutex_.Lock();
+	std::multiset<int64>::iterator it = in_flight_.find(utt_index);
+	KALDI_ASSERT(it != in_flight_.end());
+	in_flight_.erase(it);
+	in_flight_mutex_.Unlock();
+}
+
+int64 NnetCheckpointer::NumUttsDone() {
+	// more examples of the last utterance taken may still be queued, so it
+	// does not count as done.
+	in_flight_mutex_.Lock();
+	int64 num_done = in_flight_.empty() ? last_taken_ : *in_flight_.begin();
+	in_flight_mutex_.Unlock();
+	return num_done;
+}
+
+bool NnetCheckpointer::Due() const {
+	return Enabled() && timer_.Elapsed() >= 60.0 * opts_.checkpoint_interval;
+}
+
+void NnetCheckpointer::Save(const Nnet &nnet, const ModelMergeFunction *merge_func) {
+	if (!Enabled())
+		return;
+	Timer tim;
+	std::ostringstream model_os;
+	InitKaldiOutputStream(model_os, true);
+	nnet.Write(model_os, true);
+
+	std::ostringstream merge_os;
+	if (merge_func != NULL)
+		merge_func->WriteState(merge_os, true);
+
+	pending_mutex_.Lock();
+	if (pending_.valid)
+		KALDI_VLOG(1) << "The checkpoint writer is behind, dropping the older checkpoint.";
+	pending_.valid = true;
+	pending_.model = model_os.str();
+	pending_.state.version = ++version_;
+	pending_.state.num_utts_done = NumUttsDone();
+	pending_.state.merge_state = merge_os.str();
+	pending_mutex_.Unlock();
+	writer_sem_.Signal();
+
+	timer_.Reset();
+	KALDI_VLOG(1) << "Checkpoint queued in " << tim.Elapsed() << " sec.";
+}
+
+std::string NnetCheckpointer::ModelFilename(int32 version) const {
+	std::ostringstream oss;
+	oss << prefix_ << "." << version << ".nnet";
+	return oss.str();
+}
+
+void NnetCheckpointer::WriteFile(const std::string &filename, const std::string &data) {
+	std::string tmp = filename + ".tmp";
+	{
+		std::ofstream os(tmp.c_str(), std::ios::out | std::ios::binary);
+		os.write(data.data(), data.size());
+		os.close();
+		if (!os)
+			KALDI_ERR << "Failed to write " << tmp;
+	}
+	if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+		KALDI_ERR << "Failed to rename " << tmp << " to " << filename;
+}
+
+void NnetCheckpointer::WriterLoop() {
+	while (true) {
+		writer_sem_.Wait();
+		Pending job;
+		pending_mutex_.Lock();
+		if (pending_.valid) {
+			job.valid = true;
+			job.model.swap(pending_.model);
+			job.state = pending_.state;
+			pending_.valid = false;
+		}
+		bool stop = stop_;
+		pending_mutex_.Unlock();
+
+		if (job.valid) {
+			std::string model_filename = ModelFilename(job.state.version);
+			try {
+				std::ostringstream state_os;
+				InitKaldiOutputStream(state_os, true);
+				job.state.Write(state_os, true);
+				// the model goes first, renaming the state commits the pair.
+				WriteFile(model_filename, job.model);
+				WriteFile(StateFilename(), state_os.str());
+				std::string old_model = ModelFilename();
+				written_version_ = job.state.version;
+				std::remove(old_model.c_str());
+				num_written_++;
+				KALDI_LOG << "Wrote checkpoint " << prefix_ << " after "
+						  << job.state.num_utts_done << " utterances.";
+			} catch (const std::exception &e) {
+				// a failed checkpoint should not take the training down.
+				KALDI_WARN << "Checkpoint not written: " << e.what();
+				if (written_version_ != job.state.version)
+					std::remove(model_filename.c_str());
+			}
+		}
+		if (stop)
+			break;
+	}
+}
+
+} // namespace nnet0
+} // namespace kaldi
@@ -0,0 +1,176 @@
+// nnet0/nnet-checkpoint.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET_NNET_CHECKPOINT_H_
+#define KALDI_NNET_NNET_CHECKPOINT_H_
+
+#include <atomic>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "base/timer.h"
+#include "itf/options-itf.h"
+#include "util/kaldi-mutex.h"
+#include "util/kaldi-semaphore.h"
+#include "nnet0/nnet-nnet.h"
+
+namespace kaldi {
+namespace nnet0 {
+
+class ModelMergeFunction;
+
+struct NnetCheckpointOptions {
+	std::string checkpoint_prefix;
+	BaseFloat checkpoint_interval;
+	bool resume;
+
+	NnetCheckpointOptions(): checkpoint_prefix(""),
+							 checkpoint_interval(30.0),
+							 resume(false) { }
+
+	void Register(OptionsItf *po) {
+		po->Register("checkpoint-prefix", &checkpoint_prefix, "Periodically write the training state to "
+				"<prefix>.<n>.nnet and <prefix>.state (<prefix>.<rank>.* with several processes); use a new prefix "
+				"for every epoch [ empty == disabled ]");
+		po->Register("checkpoint-interval", &checkpoint_interval, "Minutes between two checkpoints");
+		po->Register("resume", &resume, "Continue from the checkpoint at --checkpoint-prefix if there is one: "
+				"the model and merge state are restored and the utterances already trained are skipped");
+	}
+};
+
+/// What is needed besides the model to continue an interrupted epoch.
+struct NnetCheckpointState {
+	int32 version;            // the model is <prefix>.<version>.nnet
+	int64 num_utts_done;      // leading utterances of the feature rspecifier that are trained
+	std::string merge_state;  // ModelMergeFunction::WriteState() output, binary
+
+	NnetCheckpointState(): version(0), num_utts_done(0) { }
+
+	void Write(std::ostream &os, bool binary) const;
+	void Read(std::istream &is, bool binary);
+};
+
+/**
+ * NnetCheckpointer writes checkpoints of a parallel training run from a
+ * background thread.  The training thread that calls Save() only serializes
+ * the model and the merge-function state into memory; the slow file writes
+ * happen in the writer thread, into temporary files that are renamed when
+ * complete.  Every checkpoint has its own model file, and the state file,
+ * which names that model, is renamed last: it is what commits the
+ * checkpoint, so an interrupted write leaves the previous model and state
+ * together.  If a new checkpoint comes while the previous one is still being
+ * written, only the newest one is kept.
+ *
+ * The reader position is that of the oldest utterance not yet trained.  The
+ * data-reading loop numbers the utterances with UtteranceRead(), and the
+ * training threads report each example with ExampleTaken() when they take it
+ * from the repository and ExampleTrained() once its update is done.  Examples
+ * still queued or in flight are read again on resume; an utterance may then
+ * be trained twice, but none is skipped.
+ */
+class NnetCheckpointer {
+ public:
+	/// 'rank' and 'num_procs' are those of the MPI job (num_procs <= 1 for a
+	/// single process), each process keeps its own checkpoint.
+	NnetCheckpointer(const NnetCheckpointOptions &opts, int32 rank = 0,
+					 int32 num_procs = 1);
+
+	/// Finishes the pending write, if any, and stops the writer thread.
+	~NnetCheckpointer();
+
+	bool Enabled() const { return opts_.checkpoint_prefix != ""; }
+
+	/// Loads the state of the latest checkpoint if --resume is set and one
+	/// exists; the model is then in ModelFilename().  The reader position
+	/// continues from the checkpoint.
+	bool Resume(NnetCheckpointState *state);
+
+	/// Called by the data-reading loop for every utterance it reads; returns
+	/// the position of the utterance in the rspecifier.
+	int64 UtteranceRead() { return num_utts_read_++; }
+
+	/// Called by a training thread when it takes an example of utterance
+	/// 'utt_index' (as returned by UtteranceRead()), and when the update with
+	/// that example is done.  Examples are taken in reader order.
+	void ExampleTaken(int64 utt_index);
+	void ExampleTrained(int64 utt_index);
+
+	/// The reader position a checkpoint taken now would resume from.
+	int64 NumUttsDone();
+
+	/// Skips the utterances a resumed run has already seen; returns the
+	/// number skipped.
+	template<class Reader>
+	int64 SkipRead(int64 num_utts, Reader *reader) {
+		int64 n = 0;
+		for (; n < num_utts && !reader->Done(); n++)
+			reader->Next();
+		return n;
+	}
+
+	/// True once --checkpoint-interval minutes have passed since the last
+	/// checkpoint (or the start).
+	bool Due() const;
+
+	/// Queues a checkpoint of 'nnet' and 'merge_func' (may be NULL) for the
+	/// writer thread and restarts the interval.  The caller must make sure
+	/// 'merge_func' is not merging concurrently.
+	void Save(const Nnet &nnet, const ModelMergeFunction *merge_func);
+
+	/// The model of the latest checkpoint written (or resumed from).
+	std::string ModelFilename() const { return ModelFilename(written_version_); }
+	std::string StateFilename() const { return prefix_ + ".state"; }
+
+	int32 NumWritten() const { return num_written_; }
+
+ private:
+	struct Pending {
+		bool valid;
+		std::string model;  // binary Nnet
+		NnetCheckpointState state;
+		Pending(): valid(false) { }
+	};
+
+	std::string ModelFilename(int32 version) const;
+	void WriterLoop();
+	static void WriteFile(const std::string &filename, const std::string &data);
+
+	NnetCheckpointOptions opts_;
+	std::string prefix_;
+	std::atomic<int64> num_utts_read_;
+	Timer timer_;
+
+	Mutex in_flight_mutex_;
+	std::multiset<int64> in_flight_;  // utterances of the examples being trained
+	int64 last_taken_;
+
+	int32 version_;  // of the last checkpoint queued
+	std::atomic<int32> written_version_;
+
+	Mutex pending_mutex_;
+	Pending pending_;
+	Semaphore writer_sem_;
+	bool stop_;
+	std::atomic<int32> num_written_;
+	std::thread writer_;
+};
+
+} // namespace nnet0
+} // namespace kaldi
+
+#endif // KALDI_NNET_NNET_CHECKPOINT_H_
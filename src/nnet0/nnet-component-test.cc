@@ -25,6 +25,10 @@
 #include "nnet0/nnet-max-pooling-component.h"
 #include "nnet0/nnet-max-pooling-2d-component.h"
 #include "nnet0/nnet-average-pooling-2d-component.h"
+#include "nnet0/nnet-sparse-affine-transform.h"
+#include "nnet0/nnet-lstm-projected-streams-fast.h"
+#include "nnet0/nnet-gru-projected-streams-fast.h"
+#include "matrix/simd-math.h"
 #include "util/common-utils.h"
 
 #include <sstream>
@@ -340,6 +344,124 @@ namespace nnet0 {
     delete c;
   }
 
+  void UnitTestSparseAffineTransform() {
+    Component* c = Component::Init("<SparseAffineTransform> <InputDim> 30 <OutputDim> 22 "
+                                   "<ParamStddev> 0.1 <BlockRows> 4 <BlockCols> 4 <Sparsity> 0.75");
+    SparseAffineTransform* sparse = dynamic_cast<SparseAffineTransform*>(c);
+    KALDI_ASSERT(sparse != NULL);
+    // 6x8 blocks, of which 36 are zero,
+    Matrix<BaseFloat> linearity(sparse->GetLinearity());
+    int32 num_zero = 0;
+    for (int32 r = 0; r < 22; r += 4)
+      for (int32 col = 0; col < 30; col += 4)
+        if (SubMatrix<BaseFloat>(linearity, r, std::min(4, 22 - r), col,
+                                 std::min(4, 30 - col)).FrobeniusNorm() == 0.0)
+          num_zero++;
+    KALDI_ASSERT(num_zero == 36);
+
+    // propagate, compare with AffineTransform,
+    AffineTransform dense(30, 22);
+    dense.SetLinearity(sparse->GetLinearity());
+    dense.SetBias(sparse->GetBias());
+    CuMatrix<BaseFloat> mat_in(10, 30), mat_out, mat_out_ref;
+    mat_in.SetRandn();
+    c->Propagate(mat_in, &mat_out);
+    dense.Propagate(mat_in, &mat_out_ref);
+    AssertEqual(mat_out, mat_out_ref);
+
+    // the pruned weights stay zero after an update,
+    NnetTrainOptions opts;
+    opts.learn_rate = 0.1;
+    sparse->SetTrainOptions(opts);
+    CuMatrix<BaseFloat> mat_out_diff(10, 22), mat_in_diff;
+    mat_out_diff.SetRandn();
+    c->Backpropagate(mat_in, mat_out, mat_out_diff, &mat_in_diff);
+    sparse->Update(mat_in, mat_out_diff);
+    Matrix<BaseFloat> updated(sparse->GetLinearity());
+    for (int32 r = 0; r < 22; r++)
+      for (int32 col = 0; col < 30; col++)
+        KALDI_ASSERT((linearity(r, col) == 0.0) == (updated(r, col) == 0.0));
+    KALDI_ASSERT(!updated.ApproxEqual(linearity));
+
+    // write and read back,
+    std::ostringstream os;
+    c->Write(os, false);
+    Component* c2 = ReadComponentFromString(os.str());
+    KALDI_ASSERT(c2->GetType() == Component::kSparseAffineTransform);
+    CuMatrix<BaseFloat> mat_out2;
+    c->Propagate(mat_in, &mat_out);
+    c2->Propagate(mat_in, &mat_out2);
+    AssertEqual(mat_out, mat_out2);
+
+    // convert a dense layer,
+    SparseAffineTransform converted(dense, 8, 1, 0.5);
+    KALDI_ASSERT(converted.BlockRows() == 8 && converted.BlockCols() == 1);
+
+    // split off as the output layer of an lstm lm,
+    Nnet nnet;
+    nnet.AppendComponent(c->Copy());
+    Matrix<BaseFloat> out_linearity;
+    Vector<BaseFloat> out_bias;
+    nnet.SplitLstmLm(out_linearity, out_bias, true);
+    KALDI_ASSERT(out_linearity.ApproxEqual(updated) && nnet.NumComponents() == 0);
+
+    delete c;
+    delete c2;
+  }
+
+  // Propagates, updates and propagates again a recurrent component that packs
+  // its recurrent weights for the CPU forward pass; the second output must
+  // match that of a copy read from disk after the update, run with the
+  // unpacked (BLAS) path.  "reset" resets the streams of a component.
+  template<class C, class R>
+  void TestPackedWeightsAfterUpdate(const std::string &config, R reset) {
+    int32 S = 2, T = 3;
+    std::vector<int32> flags(S, 1);
+    Component* c = Component::Init(config);
+    C* rnn = dynamic_cast<C*>(c);
+    NnetTrainOptions opts;
+    opts.learn_rate = 0.1;
+    rnn->SetTrainOptions(opts);
+
+    CuMatrix<BaseFloat> mat_in(T * S, c->InputDim()), mat_out, mat_in_diff;
+    mat_in.SetRandn();
+    CuMatrix<BaseFloat> mat_out_diff(T * S, c->OutputDim());
+    mat_out_diff.SetRandn();
+    reset(rnn, flags);
+    c->Propagate(mat_in, &mat_out);
+    c->Backpropagate(mat_in, mat_out, mat_out_diff, &mat_in_diff);
+    rnn->Update(mat_in, mat_out_diff);
+    reset(rnn, flags);
+    c->Propagate(mat_in, &mat_out);
+
+    std::ostringstream os;
+    c->Write(os, false);
+    Component* c2 = ReadComponentFromString(os.str());
+    reset(dynamic_cast<C*>(c2), flags);
+    SimdMathLevel cpu_level = GetSimdMathLevel();
+    SetSimdMathLevel(kSimdMathScalar);
+    CuMatrix<BaseFloat> mat_out_ref;
+    c2->Propagate(mat_in, &mat_out_ref);
+    SetSimdMathLevel(cpu_level);
+    AssertEqual(mat_out, mat_out_ref);
+
+    delete c;
+    delete c2;
+  }
+
+  void UnitTestRecurrentPackedWeights() {
+    TestPackedWeightsAfterUpdate<LstmProjectedStreamsFast>(
+        "<LstmProjectedStreamsFast> <InputDim> 10 <OutputDim> 6 <CellDim> 8 <ParamScale> 0.5",
+        [](LstmProjectedStreamsFast *c, const std::vector<int32> &flags) {
+          c->ResetLstmStreams(flags, 0);
+        });
+    TestPackedWeightsAfterUpdate<GruProjectedStreamsFast>(
+        "<GruProjectedStreamsFast> <InputDim> 10 <OutputDim> 6 <CellDim> 8 <ParamScale> 0.5",
+        [](GruProjectedStreamsFast *c, const std::vector<int32> &flags) {
+          c->ResetGRUProjectedStreamsFast(flags, 0);
+        });
+  }
+
 } // namespace nnet0
 } // namespace kaldi
 
@@ -363,6 +485,8 @@ int main() {
     UnitTestConvolutional2DComponent();
     UnitTestMaxPooling2DComponent();
     UnitTestAveragePooling2DComponent();
+    UnitTestSparseAffineTransform();
+    UnitTestRecurrentPackedWeights();
     // end of unit-tests,
     if (loop == 0)
         KALDI_LOG << "Tests without GPU use succeeded.";
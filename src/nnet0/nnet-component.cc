@@ -24,6 +24,7 @@
 #include "nnet0/nnet-activation.h"
 #include "nnet0/nnet-kl-hmm.h"
 #include "nnet0/nnet-affine-transform.h"
+#include "nnet0/nnet-sparse-affine-transform.h"
 #include "nnet0/nnet-time-delay-transform.h"
 #include "nnet0/nnet-c-time-delay-transform.h"
 #include "nnet0/nnet-batch-normalization-transform.h"
@@ -114,6 +115,7 @@ const struct Component::key_value Component::kMarkerMap[] = {
   { Component::kGruStreams,"<GruStreams>"},
   { Component::kGruProjectedStreams, "<GruProjectedStreams>"},
   { Component::kGruProjectedStreamsFast, "<GruProjectedStreamsFast>"},
+  { Component::kSparseAffineTransform, "<SparseAffineTransform>"},
   { Component::kSoftmax,"<Softmax>" },
   { Component::kSoftmaxB,"<SoftmaxB>" },
   { Component::kSoftmaxT,"<SoftmaxT>" },
@@ -268,6 +270,9 @@ Component* Component::NewComponentOfType(ComponentType comp_type,
     case Component::kGruProjectedStreamsFast:
       ans = new GruProjectedStreamsFast(input_dim, output_dim);
       break;
+    case Component::kSparseAffineTransform:
+      ans = new SparseAffineTransform(input_dim, output_dim);
+      break;
     case Component::kSoftmax :
       ans = new Softmax(input_dim, output_dim);
       break;
@@ -75,6 +75,7 @@ class Component {
 	kGruStreams,
     kGruProjectedStreams,
     kGruProjectedStreamsFast,
+    kSparseAffineTransform,
 
     kActivationFunction = 0x0200, 
     kSoftmax,
@@ -27,6 +27,7 @@
 #include "lat/kaldi-lattice.h"
 
 #include "cudamatrix/cu-device.h"
+#include "cudamatrix/cu-staging.h"
 #include "base/kaldi-types.h"
 
 
@@ -56,6 +57,7 @@ private:
 	ExamplesRepository *repository_;
 	Nnet *host_nnet_;
     NnetStats *stats_;
+    NnetCheckpointer *checkpointer_;
 
     const NnetTrainOptions *trn_opts;
     const NnetDataRandomizerOptions *rnd_opts;
@@ -80,7 +82,8 @@ private:
 			std::string targets_rspecifier,
 			ExamplesRepository *repository,
 			Nnet *nnet,
-			NnetStats *stats):
+			NnetStats *stats,
+			NnetCheckpointer *checkpointer = NULL):
 				opts(opts),
 				model_sync(model_sync),
 				model_filename(model_filename),
@@ -88,7 +91,8 @@ private:
 				targets_rspecifier(targets_rspecifier),
 				repository_(repository),
                 host_nnet_(nnet),
-				stats_(stats)
+				stats_(stats),
+				checkpointer_(checkpointer)
  	 		{
 				trn_opts = opts->trn_opts;
 				rnd_opts = opts->rnd_opts;
@@ -128,6 +132,183 @@ private:
         }
 	}
 
+	// The host side of a minibatch: the features of all the streams, as
+	// uploaded, and what the loss and the nnet need to know about them.  There
+	// are two, so that the next minibatch is read and uploaded while the
+	// current one is computed.
+	struct Minibatch {
+		std::vector< Matrix<BaseFloat> > feats_utt;  // Feature matrix of every utterance
+		std::vector< std::vector<int> > labels_utt;  // Label vector of every utterance
+		std::vector<Posterior> targets_utt;
+		std::vector<int> num_utt_frame_in, num_utt_frame_out;
+		std::vector<int> new_utt_flags;
+		Vector<BaseFloat> utt_flags;
+		std::vector<int> idx, reidx;
+		Matrix<BaseFloat> feat_mat_host;
+		Vector<BaseFloat> frame_mask_host;
+		Posterior target;
+		int32 num_frames, out_frames, out_frames_pad;
+		std::vector<int64> utt_index;  // of the examples, for the checkpointer
+	};
+
+	// Takes the next example from the repository, NULL if there are no more.
+	NnetExample *ProvideExample()
+	{
+		NnetExample *example = repository_->ProvideExample();
+		if (example != NULL && checkpointer_ != NULL)
+			checkpointer_->ExampleTaken(example->utt_index);
+		return example;
+	}
+
+	// Reads the next minibatch from the repository into 'mb'; 'example' is
+	// the first example that did not fit into the previous one.  Returns false
+	// when there are no more examples.
+	bool ReadMinibatch(Nnet &nnet_transf, int32 feat_dim, NnetExample **example,
+			int32 *num_done, Minibatch *mb)
+	{
+		int32 num_stream = opts->num_stream;
+		int32 targets_delay = opts->targets_delay;
+		int32 num_skip = opts->skip_inner ? opts->skip_frames : 1;
+		int32 frame_limit = opts->max_frames * num_skip;
+
+		CuMatrix<BaseFloat> feats_transf;
+		std::vector< Matrix<BaseFloat> > &feats_utt = mb->feats_utt;
+		std::vector< std::vector<int> > &labels_utt = mb->labels_utt;
+		std::vector<Posterior> &targets_utt = mb->targets_utt;
+		std::vector<int> &num_utt_frame_in = mb->num_utt_frame_in,
+			&num_utt_frame_out = mb->num_utt_frame_out;
+		feats_utt.resize(num_stream);
+		labels_utt.resize(num_stream);
+		targets_utt.resize(num_stream);
+
+		int32 s = 0, max_frame_num = 0, cur_frames = 0, cur_stream_num,
+			in_rows, out_rows, in_frames, in_frames_pad, out_frames_pad;
+		mb->num_frames = 0;
+		num_utt_frame_in.clear();
+		num_utt_frame_out.clear();
+		mb->utt_index.clear();
+
+		if (NULL == *example)
+			*example = ProvideExample();
+
+		if (NULL == *example)
+			return false;
+
+		while (s < num_stream && cur_frames < frame_limit && NULL != *example) {
+
+			Matrix<BaseFloat> &mat = (*example)->input_frames;
+
+			if (objective_function == "xent"){
+				DNNNnetExample *dnn_example = dynamic_cast<DNNNnetExample*>(*example);
+				targets_utt[s] = dnn_example->targets;
+			} else if (objective_function == "ctc"){
+				CTCNnetExample *ctc_example = dynamic_cast<CTCNnetExample*>(*example);
+				labels_utt[s] = ctc_example->targets;
+			}
+
+			if ((s+1)*mat.NumRows() > frame_limit || (s+1)*max_frame_num > frame_limit) break;
+			if (max_frame_num < mat.NumRows()) max_frame_num = mat.NumRows();
+
+			// forward the features through a feature-transform,
+			nnet_transf.Feedforward(CuMatrix<BaseFloat>(mat), &feats_transf);
+
+			feats_utt[s].Resize(feats_transf.NumRows(), feats_transf.NumCols(), kUndefined);
+			feats_transf.CopyToMat(&feats_utt[s]);
+
+			in_rows = mat.NumRows();
+			num_utt_frame_in.push_back(in_rows);
+			mb->num_frames += in_rows;
+
+			// inner skip frames
+			out_rows = in_rows/num_skip;
+			out_rows += in_rows%num_skip > 0 ? 1:0;
+			num_utt_frame_out.push_back(out_rows);
+
+			s++;
+			(*num_done)++;
+			cur_frames = max_frame_num * s;
+
+			mb->utt_index.push_back((*example)->utt_index);
+			delete *example;
+			*example = ProvideExample();
+		}
+
+		cur_stream_num = s;
+		in_frames_pad = cur_stream_num * max_frame_num;
+		out_frames_pad = cur_stream_num * ((max_frame_num+num_skip-1)/num_skip);
+		mb->out_frames_pad = out_frames_pad;
+		mb->new_utt_flags.resize(cur_stream_num, 1);
+
+		Matrix<BaseFloat> &feat_mat_host = mb->feat_mat_host;
+		Vector<BaseFloat> &frame_mask_host = mb->frame_mask_host;
+		Posterior &target = mb->target;
+		if (this->objective_function == "xent") {
+			target.resize(out_frames_pad);
+			frame_mask_host.Resize(out_frames_pad, kSetZero);
+		}
+
+		if (opts->network_type == "lstm") {
+			// Create the final feature matrix. Every utterance is padded to the max length within this group of utterances
+			feat_mat_host.Resize(in_frames_pad, feat_dim, kSetZero);
+
+			for (int s = 0; s < cur_stream_num; s++) {
+			  for (int r = 0; r < num_utt_frame_in[s]; r++) {
+				  feat_mat_host.Row(r*cur_stream_num + s).CopyFromVec(feats_utt[s].Row(r));
+			  }
+
+			  //ce label
+			  if (this->objective_function == "xent") {
+				  for (int r = 0; r < num_utt_frame_out[s]; r++) {
+					  if (r < targets_delay) {
+						  frame_mask_host(r*cur_stream_num + s) = 0;
+						  target[r*cur_stream_num + s] = targets_utt[s][r];
+					  } else if (r < num_utt_frame_out[s] + targets_delay) {
+						  frame_mask_host(r*cur_stream_num + s) = 1;
+						  target[r*cur_stream_num + s] = targets_utt[s][r-targets_delay];
+					  } else {
+						  frame_mask_host(r*cur_stream_num + s) = 0;
+						  int last = targets_utt[s].size()-1;
+						  target[r*cur_stream_num + s] = targets_utt[s][last];
+					  }
+				  }
+			  }
+			}
+		} else if (opts->network_type == "fsmn") {
+			in_frames = 0, mb->out_frames = 0;
+			for (int s = 0; s < cur_stream_num; s++) {
+				in_frames += num_utt_frame_in[s];
+				mb->out_frames += num_utt_frame_out[s];
+			}
+
+			feat_mat_host.Resize(in_frames, feat_dim, kUndefined);
+
+			int k = 0, offset = 0;
+			mb->utt_flags.Resize(in_frames);
+			for (int s = 0; s < cur_stream_num; s++) {
+				for (int r = 0; r < num_utt_frame_in[s]; r++) {
+					mb->utt_flags(k++) = *num_done-(cur_stream_num-s);
+				}
+			}
+
+			std::vector<int> &idx = mb->idx, &reidx = mb->reidx;
+			k = 0, offset = 0;
+			idx.resize(0);
+			idx.resize(out_frames_pad, -1);
+			reidx.resize(mb->out_frames);
+			for (int s = 0; s < cur_stream_num; s++) {
+				for (int r = 0; r < num_utt_frame_out[s]; r++) {
+					idx[r*cur_stream_num + s] = k;
+					reidx[k] = r*cur_stream_num + s;
+					k++;
+				}
+
+				feat_mat_host.RowRange(offset, num_utt_frame_in[s]).CopyFromMat(feats_utt[s]);
+				offset += num_utt_frame_in[s];
+			}
+		}
+		return true;
+	}
+
 	  // This does the main function of the class.
 	void operator ()()
 	{
@@ -169,6 +350,10 @@ private:
 
 	    nnet.SetTrainOptions(*trn_opts);
 
+	    NnetProfiler profiler;
+	    if (opts->profile_opts.Enabled())
+	    	nnet.SetProfiler(&profiler);
+
         /*
 	    int32 rank_in = 20, rank_out = 80, update_period = 4;
 	   	    BaseFloat num_samples_history = 2000.0;
@@ -213,7 +398,7 @@ private:
 	    CtcItf *ctc;
 	    // Initialize CTC optimizer
 	    if (opts->ctc_imp == "eesen")
-	    	ctc = new Ctc;
+	    	ctc = new Ctc(opts->ctc_num_threads);
 	    else if (opts->ctc_imp == "warp") {
 			ctc = new WarpCtc(opts->blank_label);
             // using activations directly: remove softmax, if present
@@ -234,9 +419,9 @@ private:
 	        softmax.AppendComponent(new Softmax(nnet.OutputDim(),nnet.OutputDim()));
         }
 
-		CuMatrix<BaseFloat> feats_transf, nnet_in, nnet_out, nnet_diff, frozen_nnet_out,
+		CuMatrix<BaseFloat> nnet_out, nnet_diff, frozen_nnet_out,
 							nnet_out_rearrange, nnet_diff_rearrange,
-							*p_nnet_in, *p_nnet_out, *p_nnet_diff;
+							*p_nnet_out, *p_nnet_diff;
 		CuMatrix<BaseFloat> si_nnet_out, soft_nnet_out;
 
 		Matrix<BaseFloat> nnet_out_h, nnet_diff_h;
@@ -248,177 +433,48 @@ private:
 		int32 update_frames = 0, num_frames = 0, num_done = 0, num_dump = 0;
 		kaldi::int64 total_frames = 0;
 
-		int32 num_stream = opts->num_stream;
-		int32 frame_limit = opts->max_frames;
-		int32 targets_delay = opts->targets_delay;
 		int32 batch_size = opts->batch_size;
-        int32 skip_frames = opts->skip_frames;
-
-	    std::vector< Matrix<BaseFloat> > feats_utt(num_stream);  // Feature matrix of every utterance
-	    std::vector< std::vector<int> > labels_utt(num_stream);  // Label vector of every utterance
-	    std::vector<int> num_utt_frame_in, num_utt_frame_out;
-        std::vector<int> new_utt_flags;
-		Vector<BaseFloat> utt_flags;
-		std::vector<int> idx, reidx;
 		CuArray<MatrixIndexT> indexes;
 
-	    Matrix<BaseFloat> feat_mat_host;
-	    Vector<BaseFloat> frame_mask_host;
-	    Posterior target;
-	    std::vector<Posterior> targets_utt(num_stream);
-        std::string utt;
+	    // double-buffered upload: minibatch k+1 is read and copied to the
+	    // device while minibatch k computes.
+	    Minibatch minibatch[2];
+	    int32 cur = 0;
+	    CuMatrixStager<BaseFloat> feat_stager;
 
-	    CTCNnetExample *ctc_example = NULL;
-	    DNNNnetExample *dnn_example = NULL;
 	    NnetExample		*example = NULL;
 	    Timer time;
 	    double time_now = 0;
 
-		int32 cur_stream_num = 0, num_skip, in_rows, out_rows, 
-              in_frames, out_frames, in_frames_pad, out_frames_pad;
 		int32 feat_dim = use_frozen ? frozen_nnet.InputDim() : nnet.InputDim();
 		//BaseFloat l2_term;
-	    num_skip = opts->skip_inner ? skip_frames : 1;
-        frame_limit *= num_skip;
-
-	    while (num_stream) {
-
-			int32 s = 0, max_frame_num = 0, cur_frames = 0;
-			cur_stream_num = 0; num_frames = 0;
-			num_utt_frame_in.clear();
-			num_utt_frame_out.clear();
 
-			if (NULL == example)
-				example = repository_->ProvideExample();
+		bool have_minibatch = opts->num_stream > 0 &&
+				ReadMinibatch(nnet_transf, feat_dim, &example, &num_done,
+							  &minibatch[cur]);
+		if (have_minibatch)
+			feat_stager.Stage(minibatch[cur].feat_mat_host);
 
-			if (NULL == example)
-				break;
+	    while (have_minibatch) {
 
-			while (s < num_stream && cur_frames < frame_limit && NULL != example) {
-
-				utt = example->utt;
-				Matrix<BaseFloat> &mat = example->input_frames;
-
-				if (objective_function == "xent"){
-					dnn_example = dynamic_cast<DNNNnetExample*>(example);
-					targets_utt[s] = dnn_example->targets;
-				} else if (objective_function == "ctc"){
-					ctc_example = dynamic_cast<CTCNnetExample*>(example);
-					labels_utt[s] = ctc_example->targets;
-				}
-
-				if ((s+1)*mat.NumRows() > frame_limit || (s+1)*max_frame_num > frame_limit) break;
-				if (max_frame_num < mat.NumRows()) max_frame_num = mat.NumRows();
-
-				// forward the features through a feature-transform,
-				nnet_transf.Feedforward(CuMatrix<BaseFloat>(mat), &feats_transf);
-
-				feats_utt[s].Resize(feats_transf.NumRows(), feats_transf.NumCols(), kUndefined);
-				feats_transf.CopyToMat(&feats_utt[s]);
-
-		        	//feats_utt[s] = mat;
-				in_rows = mat.NumRows();
-				num_utt_frame_in.push_back(in_rows);
-				num_frames += in_rows;
-
-		        // inner skip frames
-		        out_rows = in_rows/num_skip;
-		        out_rows += in_rows%num_skip > 0 ? 1:0;
-		        num_utt_frame_out.push_back(out_rows);
-
-				s++;
-				num_done++;
-				cur_frames = max_frame_num * s;
-
-				delete example;
-				example = repository_->ProvideExample();
-			}
-
-			cur_stream_num = s;
-            in_frames_pad = cur_stream_num * max_frame_num;
-            out_frames_pad = cur_stream_num * ((max_frame_num+num_skip-1)/num_skip);
-			new_utt_flags.resize(cur_stream_num, 1);
-
-			if (this->objective_function == "xent") {
-				target.resize(out_frames_pad);
-				frame_mask_host.Resize(out_frames_pad, kSetZero);
-			}
-
-			if (opts->network_type == "lstm") {
-				// Create the final feature matrix. Every utterance is padded to the max length within this group of utterances
-				feat_mat_host.Resize(in_frames_pad, feat_dim, kSetZero);
-
-				for (int s = 0; s < cur_stream_num; s++) {
-				  for (int r = 0; r < num_utt_frame_in[s]; r++) {
-					  feat_mat_host.Row(r*cur_stream_num + s).CopyFromVec(feats_utt[s].Row(r));
-				  }
-
-				  //ce label
-				  if (this->objective_function == "xent") {
-					  for (int r = 0; r < num_utt_frame_out[s]; r++) {
-						  if (r < targets_delay) {
-							  frame_mask_host(r*cur_stream_num + s) = 0;
-							  target[r*cur_stream_num + s] = targets_utt[s][r];
-						  } else if (r < num_utt_frame_out[s] + targets_delay) {
-							  frame_mask_host(r*cur_stream_num + s) = 1;
-							  target[r*cur_stream_num + s] = targets_utt[s][r-targets_delay];
-						  } else {
-							  frame_mask_host(r*cur_stream_num + s) = 0;
-							  int last = targets_utt[s].size()-1;
-							  target[r*cur_stream_num + s] = targets_utt[s][last];
-						  }
-					  }
-				  }
-				}
-			} else if (opts->network_type == "fsmn") {
-				in_frames = 0, out_frames = 0;
-				for (int s = 0; s < cur_stream_num; s++) {
-					in_frames += num_utt_frame_in[s];
-					out_frames += num_utt_frame_out[s];
-				}
-
-				feat_mat_host.Resize(in_frames, feat_dim, kUndefined);
-
-				int k = 0, offset = 0;
-				utt_flags.Resize(in_frames);
-				for (int s = 0; s < cur_stream_num; s++) {
-					for (int r = 0; r < num_utt_frame_in[s]; r++) {
-                        utt_flags(k++) = num_done-(cur_stream_num-s);
-                    }
-                }
-
-                k = 0, offset = 0;
-                idx.resize(0);
-				idx.resize(out_frames_pad, -1);
-				reidx.resize(out_frames);
-				for (int s = 0; s < cur_stream_num; s++) {
-					for (int r = 0; r < num_utt_frame_out[s]; r++) {
-						//utt_flags(k) = num_done-(cur_stream_num-s);
-						idx[r*cur_stream_num + s] = k;
-						reidx[k] = r*cur_stream_num + s;
-						k++;
-					}
-
-					feat_mat_host.RowRange(offset, num_utt_frame_in[s]).CopyFromMat(feats_utt[s]);
-					offset += num_utt_frame_in[s];
-				}
-			}
+			Minibatch &mb = minibatch[cur];
+			num_frames = mb.num_frames;
 
 			// Set the original lengths of utterances before padding
 	        if (opts->network_type == "lstm") {
 			    // lstm
-			    nnet.ResetLstmStreams(new_utt_flags, batch_size);
+			    nnet.ResetLstmStreams(mb.new_utt_flags, batch_size);
 			    // bilstm
-			    nnet.SetSeqLengths(num_utt_frame_out, batch_size);
+			    nnet.SetSeqLengths(mb.num_utt_frame_out, batch_size);
 			    if (use_frozen) {
-			    	frozen_nnet.ResetLstmStreams(new_utt_flags, batch_size);
-			    	frozen_nnet.SetSeqLengths(num_utt_frame_out, batch_size);
+			    	frozen_nnet.ResetLstmStreams(mb.new_utt_flags, batch_size);
+			    	frozen_nnet.SetSeqLengths(mb.num_utt_frame_out, batch_size);
 			    }
             } else if (opts->network_type == "fsmn") {
 			    // fsmn
-			    nnet.SetFlags(utt_flags);
+			    nnet.SetFlags(mb.utt_flags);
 			    if (use_frozen) {
-			    	frozen_nnet.SetFlags(utt_flags);
+			    	frozen_nnet.SetFlags(mb.utt_flags);
 			    }
             }
 
@@ -430,8 +486,8 @@ private:
 							<< " frames per second.";
 	        }
 
-	        nnet_in = feat_mat_host;
-	        p_nnet_in = &nnet_in;
+	        CuSubMatrix<BaseFloat> nnet_in(feat_stager.Acquire());
+	        const CuMatrixBase<BaseFloat> *p_nnet_in = &nnet_in;
 	        if (use_frozen) {
 				frozen_nnet.Propagate(nnet_in, &frozen_nnet_out);
 				p_nnet_in = &frozen_nnet_out;
@@ -441,12 +497,19 @@ private:
 	        nnet.Propagate(*p_nnet_in, &nnet_out);
 	        p_nnet_out = &nnet_out;
 
+	        // the forward pass is queued on the device; read the next minibatch
+	        // and start its upload in the meantime.
+	        have_minibatch = ReadMinibatch(nnet_transf, feat_dim, &example,
+	        							   &num_done, &minibatch[1 - cur]);
+	        if (have_minibatch)
+	        	feat_stager.Stage(minibatch[1 - cur].feat_mat_host);
+
 			if (use_kld) {
 				// for streams with new utterance, history states need to be reset
 			    if (opts->network_type == "lstm")
-				    si_nnet.ResetLstmStreams(new_utt_flags, batch_size);
+				    si_nnet.ResetLstmStreams(mb.new_utt_flags, batch_size);
                 else if (opts->network_type == "fsmn")
-				    si_nnet.SetFlags(utt_flags);
+				    si_nnet.SetFlags(mb.utt_flags);
 				si_nnet.Propagate(*p_nnet_in, &si_nnet_out);
 				CuMatrix<BaseFloat> *p_soft_nnet_out = &soft_nnet_out;
 				if (opts->ctc_imp == "warp")
@@ -469,19 +532,19 @@ private:
             */
 
 	        if (opts->network_type == "fsmn") {
-				indexes = idx;
-				nnet_out_rearrange.Resize(out_frames_pad, nnet.OutputDim(), kSetZero, kStrideEqualNumCols);
+				indexes = mb.idx;
+				nnet_out_rearrange.Resize(mb.out_frames_pad, nnet.OutputDim(), kSetZero, kStrideEqualNumCols);
 				nnet_out_rearrange.CopyRows(nnet_out, indexes);
 				p_nnet_out = &nnet_out_rearrange;
 	        }
 
 	        if (objective_function == "xent") {
-	        	xent.Eval(frame_mask_host, *p_nnet_out, target, &nnet_diff);
+	        	xent.Eval(mb.frame_mask_host, *p_nnet_out, mb.target, &nnet_diff);
 	        } else if (objective_function == "ctc") {
 				//ctc error
-				ctc->EvalParallel(num_utt_frame_out, *p_nnet_out, labels_utt, &nnet_diff);
+				ctc->EvalParallel(mb.num_utt_frame_out, *p_nnet_out, mb.labels_utt, &nnet_diff);
 				// Error rates
-				ctc->ErrorRateMSeq(num_utt_frame_out, *p_nnet_out, labels_utt);
+				ctc->ErrorRateMSeq(mb.num_utt_frame_out, *p_nnet_out, mb.labels_utt);
 	        } else
 	        	KALDI_ERR<< "Unknown objective function code : " << objective_function;
 
@@ -497,8 +560,8 @@ private:
 
 	        p_nnet_diff = &nnet_diff;
 	        if (opts->network_type == "fsmn") {
-				indexes = reidx;
-				nnet_diff_rearrange.Resize(out_frames, nnet.OutputDim(), kUndefined);
+				indexes = mb.reidx;
+				nnet_diff_rearrange.Resize(mb.out_frames, nnet.OutputDim(), kUndefined);
 				nnet_diff_rearrange.CopyRows(nnet_diff, indexes);
 				p_nnet_diff = &nnet_diff_rearrange;
 
@@ -570,7 +633,10 @@ private:
 						{
 							model_sync->GetWeight(&nnet);
 
+							Timer merge_timer;
 							p_merge_func->Merge(0);
+							if (opts->profile_opts.Enabled())
+								profiler.AddMerge(merge_timer.Elapsed(), model_sync->Dim() * sizeof(BaseFloat));
 							KALDI_VLOG(1) << "Model merge NO." << parallel_opts->num_merge - p_merge_func->leftMerge()
 											<< " Current mergesize = " << p_merge_func->CurrentMergeCache() << " frames.";
 							p_merge_func->MergeCacheReset();
@@ -606,8 +672,22 @@ private:
 				}
 			}
 
+			if (checkpointer_ != NULL) {
+				for (int i = 0; i < mb.utt_index.size(); i++)
+					checkpointer_->ExampleTrained(mb.utt_index[i]);
+			}
+
+			// periodic checkpoint of this process, written in the background
+			if (!crossvalidate && this->thread_id_ == 0 && checkpointer_ != NULL && checkpointer_->Due())
+			{
+				model_sync->LockModel();
+				checkpointer_->Save(nnet, p_merge_func);
+				model_sync->UnlockModel();
+			}
+
 			fflush(stderr);
 			fsync(fileno(stderr));
+			cur = 1 - cur;
 		}
 
 		model_sync->LockStates();
@@ -645,7 +725,10 @@ private:
 
 					model_sync->GetWeight(&nnet);
 
+					Timer merge_timer;
 					p_merge_func->Merge(0);
+					if (opts->profile_opts.Enabled())
+						profiler.AddMerge(merge_timer.Elapsed(), model_sync->Dim() * sizeof(BaseFloat));
 						KALDI_VLOG(1) << "Model merge NO." << parallel_opts->num_merge-p_merge_func->leftMerge()
 									   << " Current mergesize = " << p_merge_func->CurrentMergeCache() << " frames.";
 				    model_sync->SetWeight(&nnet);
@@ -673,6 +756,12 @@ private:
 			model_sync->isfinished_[thread_idx] = true;
 			model_sync->UnlockModel();
 		}
+
+		if (opts->profile_opts.Enabled()) {
+			model_sync->LockStates();
+			stats_->profiler.Add(profiler);
+			model_sync->UnlockStates();
+		}
 	}
 
 };
@@ -689,9 +778,17 @@ void NnetCtcUpdateParallel(const NnetCtcUpdateOptions *opts,
 		ExamplesRepository repository;
 		NnetModelSync model_sync(nnet, opts->parallel_opts);
 
+		NnetCheckpointer checkpointer(opts->checkpoint_opts, opts->parallel_opts->myid,
+									  opts->parallel_opts->num_procs);
+		NnetCheckpointState resume_state;
+		if (checkpointer.Resume(&resume_state)) {
+			model_filename = checkpointer.ModelFilename();
+			model_sync.SetMergeState(resume_state.merge_state);
+		}
+
 		TrainCtcParallelClass c(opts, &model_sync,
 								model_filename, target_model_filename, targets_rspecifier,
-								&repository, nnet, stats);
+								&repository, nnet, stats, &checkpointer);
 
 
 	  {
@@ -707,6 +804,7 @@ void NnetCtcUpdateParallel(const NnetCtcUpdateOptions *opts,
     			spec_aug_rspecifier = ss.str();
 				spec_aug_reader = new RandomAccessTokenReader(spec_aug_rspecifier);
     		}
+    		SpecAugmenter spec_augmenter(*opts->spec_opts);
 
 	    // The initialization of the following class spawns the threads that
 	    // process the examples.  They get re-joined in its destructor.
@@ -726,8 +824,10 @@ void NnetCtcUpdateParallel(const NnetCtcUpdateOptions *opts,
 		int nframes = sweep_frames.size();
 		int idx = 0;
 		loop_frames = sweep_frames;
+		checkpointer.SkipRead(resume_state.num_utts_done, &feature_reader);
 		// loop sweep skip frames
 	    for (; !feature_reader.Done(); feature_reader.Next()) {
+	    	int64 utt_index = checkpointer.UtteranceRead();
 	    	if (!opts->sweep_loop) {
 	    		loop_frames.resize(1);
 	    		loop_frames[0] = sweep_frames[idx];
@@ -736,9 +836,11 @@ void NnetCtcUpdateParallel(const NnetCtcUpdateOptions *opts,
 
 	    	example = new CTCNnetExample(&feature_reader, &si_feature_reader, spec_aug_reader, 
 					&targets_reader, &model_sync, stats, opts);
+	    	example->SetSpecAugmenter(&spec_augmenter);
             example->SetSweepFrames(loop_frames, opts->skip_inner);
 	    	if (example->PrepareData(examples)) {
 	    		for (int i = 0; i < examples.size(); i++) {
+	    			examples[i]->utt_index = utt_index;
 	    			repository.AcceptExample(examples[i]);
 	    		}
 	    		if (examples[0] != example)
@@ -763,9 +865,17 @@ void NnetCEUpdateParallel(const NnetCtcUpdateOptions *opts,
 		ExamplesRepository repository;
 		NnetModelSync model_sync(nnet, opts->parallel_opts);
 
+		NnetCheckpointer checkpointer(opts->checkpoint_opts, opts->parallel_opts->myid,
+									  opts->parallel_opts->num_procs);
+		NnetCheckpointState resume_state;
+		if (checkpointer.Resume(&resume_state)) {
+			model_filename = checkpointer.ModelFilename();
+			model_sync.SetMergeState(resume_state.merge_state);
+		}
+
 		TrainCtcParallelClass c(opts, &model_sync,
 								model_filename, target_model_filename, targets_rspecifier,
-								&repository, nnet, stats);
+								&repository, nnet, stats, &checkpointer);
 
 
 	  {
@@ -782,6 +892,7 @@ void NnetCEUpdateParallel(const NnetCtcUpdateOptions *opts,
     			spec_aug_rspecifier = ss.str();
 				spec_aug_reader = new RandomAccessTokenReader(spec_aug_rspecifier);
     		}
+    		SpecAugmenter spec_augmenter(*opts->spec_opts);
 
 	    // The initialization of the following class spawns the threads that
 	    // process the examples.  They get re-joined in its destructor.
@@ -802,8 +913,10 @@ void NnetCEUpdateParallel(const NnetCtcUpdateOptions *opts,
 		int nframes = sweep_frames.size();
 		int idx = 0;
 		loop_frames = sweep_frames;
+		checkpointer.SkipRead(resume_state.num_utts_done, &feature_reader);
 		// loop sweep skip frames
 	    for (; !feature_reader.Done(); feature_reader.Next()) {
+	    	int64 utt_index = checkpointer.UtteranceRead();
 	    	if (!opts->sweep_loop) {
 	    		loop_frames.resize(1);
 	    		loop_frames[0] = sweep_frames[idx];
@@ -812,9 +925,11 @@ void NnetCEUpdateParallel(const NnetCtcUpdateOptions *opts,
 
 	    	example = new DNNNnetExample(&feature_reader, &si_feature_reader, spec_aug_reader,
 					&targets_reader, &weights_reader, &model_sync, stats, opts);
+	    	example->SetSpecAugmenter(&spec_augmenter);
             example->SetSweepFrames(loop_frames, opts->skip_inner);
 	    	if (example->PrepareData(examples)) {
 	    		for (int i = 0; i < examples.size(); i++) {
+	    			examples[i]->utt_index = utt_index;
 	    			repository.AcceptExample(examples[i]);
 	    		}
 	    		if (examples[0] != example)
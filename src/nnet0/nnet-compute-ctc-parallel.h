@@ -54,13 +54,14 @@ struct NnetCtcUpdateOptions : public NnetUpdateOptions {
     BaseFloat l2_regularize;
     BaseFloat clip_loss;
     std::string ctc_imp;
+    int32 ctc_num_threads;
 
 
     NnetCtcUpdateOptions(const NnetTrainOptions *trn_opts, const NnetDataRandomizerOptions *rnd_opts, const SpecAugOptions *spec_opts,
                         LossOptions *loss_opts, const NnetParallelOptions *parallel_opts, const CuAllocatorOptions *cuallocator_opts = NULL)
     	: NnetUpdateOptions(trn_opts, rnd_opts, spec_opts, loss_opts, parallel_opts, cuallocator_opts),
         num_stream(4), max_frames(25000), batch_size(0), blank_label(0), l2_regularize(0.0),
-          clip_loss(1.0), ctc_imp("warp") { }
+          clip_loss(1.0), ctc_imp("warp"), ctc_num_threads(1) { }
 
   	  void Register(OptionsItf *po) {
   		  	NnetUpdateOptions::Register(po);
@@ -75,6 +76,10 @@ struct NnetCtcUpdateOptions : public NnetUpdateOptions {
 	        po->Register("clip-loss", &clip_loss, "clip ctc loss, applied to the diff of the output "
 	                       "of the neural net.");
 	        po->Register("ctc-imp", &ctc_imp, "CTC objective function implementation, (eesen|warp)");
+	        po->Register("ctc-num-threads", &ctc_num_threads, "Number of threads of the eesen CTC objective "
+	                       "on the CPU, the sequences of a minibatch are shared among them");
+	        checkpoint_opts.Register(po);
+	        profile_opts.Register(po);
   	  }
 };
 
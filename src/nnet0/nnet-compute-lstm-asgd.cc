@@ -55,6 +55,7 @@ private:
 
 	ExamplesRepository *repository_;
     NnetStats *stats_;
+    NnetCheckpointer *checkpointer_;
 
     const NnetTrainOptions *trn_opts;
     const NnetDataRandomizerOptions *rnd_opts;
@@ -79,14 +80,16 @@ private:
 			std::string targets_rspecifier,
 			ExamplesRepository *repository,
 			Nnet *nnet,
-			NnetStats *stats):
+			NnetStats *stats,
+			NnetCheckpointer *checkpointer = NULL):
 				opts(opts),
 				model_sync(model_sync),
 				model_filename(model_filename),
 				target_model_filename(target_model_filename),
 				targets_rspecifier(targets_rspecifier),
 				repository_(repository),
-				stats_(stats)
+				stats_(stats),
+				checkpointer_(checkpointer)
  	 		{
 				trn_opts = opts->trn_opts;
 				rnd_opts = opts->rnd_opts;
@@ -166,6 +169,10 @@ private:
 
 	    nnet.SetTrainOptions(*trn_opts);
 
+	    NnetProfiler profiler;
+	    if (opts->profile_opts.Enabled())
+	    	nnet.SetProfiler(&profiler);
+
         /*
 	    int32 rank_in = 20, rank_out = 80, update_period = 4;
 	   	    BaseFloat num_samples_history = 2000.0;
@@ -231,6 +238,7 @@ private:
 	    std::vector<int> lent(num_stream, 0);
 	    std::vector<int> new_utt_flags(num_stream, 0);
 	    std::vector<int> valid_lengths(num_stream, 0);
+	    std::vector<int64> utt_index(num_stream, -1);  // for the checkpointer
 
 	    // bptt batch buffer
 	    //int32 feat_dim = nnet.InputDim();
@@ -252,7 +260,12 @@ private:
 	                continue;
 	            }
 			
-	            // else, this stream exhausted, need new utterance
+	            // else, this stream exhausted, its utterance is trained
+	            if (utt_index[s] >= 0 && checkpointer_ != NULL)
+	                checkpointer_->ExampleTrained(utt_index[s]);
+	            utt_index[s] = -1;
+
+	            // need new utterance
 	            while ((example = dynamic_cast<DNNNnetExample*>(repository_->ProvideExample())) != NULL)
 	            {
 	                const std::string& key = example->utt;
@@ -275,6 +288,9 @@ private:
 	                curt[s] = 0;
 	                lent[s] = target.size();
 	                new_utt_flags[s] = 1;  // a new utterance feeded to this stream
+	                utt_index[s] = example->utt_index;
+	                if (checkpointer_ != NULL)
+	                    checkpointer_->ExampleTaken(utt_index[s]);
 	                delete example;
 	                break;
 	            }
@@ -472,7 +488,10 @@ private:
 							{
 								model_sync->GetWeight(&nnet);
 
+							    Timer merge_timer;
 							    p_merge_func->Merge(0);
+							    if (opts->profile_opts.Enabled())
+							    	profiler.AddMerge(merge_timer.Elapsed(), model_sync->Dim() * sizeof(BaseFloat));
 							    KALDI_VLOG(1) << "Model " << parallel_opts->merge_func << " merge NO." 
 										<< parallel_opts->num_merge - p_merge_func->leftMerge()
 							    			<< " Current mergesize = " << p_merge_func->CurrentMergeCache() << " frames.";
@@ -507,6 +526,13 @@ private:
 					}
 				}
 
+			    // periodic checkpoint of this process, written in the background
+			    if (!crossvalidate && this->thread_id_ == 0 && checkpointer_ != NULL && checkpointer_->Due()) {
+					model_sync->LockModel();
+					checkpointer_->Save(nnet, p_merge_func);
+					model_sync->UnlockModel();
+				}
+
 		        fflush(stderr);
 		        fsync(fileno(stderr));
 		}
@@ -552,7 +578,10 @@ private:
 
 					model_sync->GetWeight(&nnet);
 
+					Timer merge_timer;
 					p_merge_func->Merge(0);
+					if (opts->profile_opts.Enabled())
+						profiler.AddMerge(merge_timer.Elapsed(), model_sync->Dim() * sizeof(BaseFloat));
 						KALDI_VLOG(1) << "Model merge NO." << parallel_opts->num_merge-p_merge_func->leftMerge()
 									   << " Current mergesize = " << p_merge_func->CurrentMergeCache() << " frames.";
 						model_sync->SetWeight(&nnet);
@@ -572,6 +601,12 @@ private:
 			model_sync->isfinished_[thread_idx] = true;
 			model_sync->UnlockModel();
 		}
+
+		if (opts->profile_opts.Enabled()) {
+			model_sync->LockStates();
+			stats_->profiler.Add(profiler);
+			model_sync->UnlockStates();
+		}
 	}
 
 };
@@ -588,9 +623,17 @@ void NnetLstmUpdateAsgd(const NnetLstmUpdateOptions *opts,
 		ExamplesRepository repository;
 		NnetModelSync model_sync(nnet, opts->parallel_opts);
 
+		NnetCheckpointer checkpointer(opts->checkpoint_opts, opts->parallel_opts->myid,
+									  opts->parallel_opts->num_procs);
+		NnetCheckpointState resume_state;
+		if (checkpointer.Resume(&resume_state)) {
+			model_filename = checkpointer.ModelFilename();
+			model_sync.SetMergeState(resume_state.merge_state);
+		}
+
 		TrainLstmAsgdClass c(opts, &model_sync,
 								model_filename, target_model_filename, targets_rspecifier,
-								&repository, nnet, stats);
+								&repository, nnet, stats, &checkpointer);
 
 
 	  {
@@ -610,6 +653,7 @@ void NnetLstmUpdateAsgd(const NnetLstmUpdateOptions *opts,
     			spec_aug_rspecifier = ss.str();
 				spec_aug_reader = new RandomAccessTokenReader(spec_aug_rspecifier);
     		}
+    		SpecAugmenter spec_augmenter(*opts->spec_opts);
 
             if (opts->objective_function.compare(0, 9, "multitask") == 0)
                 stats->multitask.InitFromString(opts->objective_function);
@@ -632,8 +676,10 @@ void NnetLstmUpdateAsgd(const NnetLstmUpdateOptions *opts,
 		int nframes = sweep_frames.size();
 		int idx = 0;
 		loop_frames = sweep_frames;
+		checkpointer.SkipRead(resume_state.num_utts_done, &feature_reader);
 		// loop sweep skip frames
 	    for (; !feature_reader.Done(); feature_reader.Next()) {
+	    	int64 utt_index = checkpointer.UtteranceRead();
 	    	if (!opts->sweep_loop) {
 	    		loop_frames.resize(1);
 	    		loop_frames[0] = sweep_frames[idx];
@@ -642,9 +688,11 @@ void NnetLstmUpdateAsgd(const NnetLstmUpdateOptions *opts,
 
 	    	example = new DNNNnetExample(&feature_reader, &si_feature_reader, spec_aug_reader,
 					&targets_reader, &weights_reader, &model_sync, stats, opts);
+	    	example->SetSpecAugmenter(&spec_augmenter);
             example->SetSweepFrames(loop_frames, opts->skip_inner);
 	    	if (example->PrepareData(examples)) {
 	    		for (int i = 0; i < examples.size(); i++) {
+	    			examples[i]->utt_index = utt_index;
 	    			repository.AcceptExample(examples[i]);
 	    		}
 	    		if (examples[0] != example)
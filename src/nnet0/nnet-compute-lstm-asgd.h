@@ -62,6 +62,9 @@ struct NnetLstmUpdateOptions : public NnetUpdateOptions {
 	      po->Register("dump-interval", &dump_interval, "---LSTM--- num utts between model dumping [ 0 == disabled ]");
 	      //</jiayu>
 
+	      checkpoint_opts.Register(po);
+	      profile_opts.Register(po);
+
   	  }
 };
 
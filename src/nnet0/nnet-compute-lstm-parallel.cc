@@ -27,6 +27,7 @@
 #include "lat/kaldi-lattice.h"
 
 #include "cudamatrix/cu-device.h"
+#include "cudamatrix/cu-staging.h"
 #include "base/kaldi-types.h"
 
 
@@ -54,6 +55,7 @@ private:
 
 	ExamplesRepository *batch_repo_;
     NnetStats *stats_;
+    NnetCheckpointer *checkpointer_;
 
     const NnetTrainOptions *trn_opts;
     const NnetDataRandomizerOptions *rnd_opts;
@@ -77,13 +79,15 @@ private:
 			std::string targets_rspecifier,
 			ExamplesRepository *batch_repo,
 			Nnet *nnet,
-			NnetStats *stats):
+			NnetStats *stats,
+			NnetCheckpointer *checkpointer = NULL):
 				opts(opts),
 				model_sync(model_sync),
 				model_filename(model_filename),
 				targets_rspecifier(targets_rspecifier),
 				batch_repo_(batch_repo),
-				stats_(stats)
+				stats_(stats),
+				checkpointer_(checkpointer)
  	 		{
 				trn_opts = opts->trn_opts;
 				rnd_opts = opts->rnd_opts;
@@ -165,6 +169,10 @@ private:
 
 	    nnet.SetTrainOptions(*trn_opts);
 
+	    NnetProfiler profiler;
+	    if (opts->profile_opts.Enabled())
+	    	nnet.SetProfiler(&profiler);
+
         /*
 	    int32 rank_in = 20, rank_out = 80, update_period = 4;
 	   	    BaseFloat num_samples_history = 2000.0;
@@ -204,7 +212,9 @@ private:
 		//CuMatrix<BaseFloat> si_nnet_out, soft_nnet_out, *p_si_nnet_out=NULL, *p_soft_nnet_out;
 		Matrix<BaseFloat> nnet_out_h, nnet_diff_h;
 
-		LstmNnetExample *example;
+		LstmNnetExample *example, *next_example;
+		// double-buffered upload: batch k+1 is copied while batch k computes
+		CuMatrixStager<BaseFloat> feat_stager;
 
 		ModelMergeFunction *p_merge_func = model_sync->GetModelMergeFunction();
 
@@ -212,7 +222,11 @@ private:
 		int32 update_frames = 0, num_frames = 0, num_done = 0;
 		kaldi::int64 total_frames = 0;
 
-		while ((example = dynamic_cast<LstmNnetExample*>(repository_->ProvideExample())) != NULL)
+		example = dynamic_cast<LstmNnetExample*>(repository_->ProvideExample());
+		if (example != NULL)
+			feat_stager.Stage(example->feat);
+
+		for (; example != NULL; example = next_example)
 		{
 			//time.Reset();
 		    Vector<BaseFloat> &frame_mask = example->frame_mask;
@@ -223,8 +237,10 @@ private:
 			//t1 = time.Elapsed();
 			//time.Reset();
 
+		    CuSubMatrix<BaseFloat> feat_dev(feat_stager.Acquire());
+
 	        // apply optional feature transform
-	        nnet_transf.Feedforward(CuMatrix<BaseFloat>(feat), &feats_transf);
+	        nnet_transf.Feedforward(feat_dev, &feats_transf);
 
 	        // for streams with new utterance, history states need to be reset
 	        nnet.ResetLstmStreams(new_utt_flags);
@@ -232,6 +248,12 @@ private:
 	        // forward pass
 	        nnet.Propagate(feats_transf, &nnet_out);
 
+		    // the forward pass is queued on the device; wait for the reader
+		    // and start the upload of the next minibatch in the meantime.
+		    next_example = dynamic_cast<LstmNnetExample*>(repository_->ProvideExample());
+		    if (next_example != NULL)
+		    	feat_stager.Stage(next_example->feat);
+
 	        // evaluate objective function we've chosen
 	        if (objective_function == "xent") {
 	            xent.Eval(frame_mask, nnet_out, target, &nnet_diff);
@@ -284,7 +306,10 @@ private:
 						{
 							model_sync->GetWeight(&nnet);
 
+							Timer merge_timer;
 							p_merge_func->Merge(0);
+							if (opts->profile_opts.Enabled())
+								profiler.AddMerge(merge_timer.Elapsed(), model_sync->Dim() * sizeof(BaseFloat));
 							KALDI_VLOG(1) << "Model merge NO." << parallel_opts->num_merge - p_merge_func->leftMerge()
 											<< " Current mergesize = " << p_merge_func->CurrentMergeCache() << " frames.";
 							p_merge_func->MergeCacheReset();
@@ -304,6 +329,19 @@ private:
 				// increase time counter
 		        update_frames += num_frames;
 		        total_frames += num_frames;
+
+		        // the utterances that ended in an earlier batch are trained now
+		        if (checkpointer_ != NULL) {
+		        	for (int i = 0; i < example->done_utts.size(); i++)
+		        		checkpointer_->ExampleTrained(example->done_utts[i]);
+		        }
+
+		        // periodic checkpoint of this process, written in the background
+		        if (!crossvalidate && this->thread_id_ == 0 && checkpointer_ != NULL && checkpointer_->Due()) {
+		        	model_sync->LockModel();
+		        	checkpointer_->Save(nnet, p_merge_func);
+		        	model_sync->UnlockModel();
+		        }
 		        fflush(stderr);
 		        fsync(fileno(stderr));
 		}
@@ -335,7 +373,10 @@ private:
 			{
 				model_sync->GetWeight(&nnet);
 
+				Timer merge_timer;
 				p_merge_func->Merge(0);
+				if (opts->profile_opts.Enabled())
+					profiler.AddMerge(merge_timer.Elapsed(), model_sync->Dim() * sizeof(BaseFloat));
 	    		KALDI_VLOG(1) << "Model merge NO." << parallel_opts->num_merge-p_merge_func->leftMerge()
 	    						   << " Current mergesize = " << p_merge_func->CurrentMergeCache();
 	    		model_sync->SetWeight(&nnet);
@@ -346,6 +387,12 @@ private:
 
 		model_sync->UnlockModel();
 		}
+
+		if (opts->profile_opts.Enabled()) {
+			model_sync->LockStates();
+			stats_->profiler.Add(profiler);
+			model_sync->UnlockStates();
+		}
 	}
 
 };
@@ -364,6 +411,7 @@ private:
 
     std::string use_gpu;
     NnetStats *stats_;
+    NnetCheckpointer *checkpointer_;
 
 
 
@@ -374,12 +422,14 @@ public:
 			NnetModelSync *model_sync,
 			ExamplesRepository *repository,
 			ExamplesRepository *batch_repo,
-			NnetStats *stats):
+			NnetStats *stats,
+			NnetCheckpointer *checkpointer = NULL):
 				opts(opts),
 				model_sync(model_sync),
 				repository_(repository),
 				batch_repo_(batch_repo),
-				stats_(stats)
+				stats_(stats),
+				checkpointer_(checkpointer)
 	 		{
 				use_gpu = opts->use_gpu;
 				feature_transform = opts->feature_transform;
@@ -404,6 +454,9 @@ public:
 	    std::vector<int> curt(num_stream, 0);
 	    std::vector<int> lent(num_stream, 0);
 	    std::vector<int> new_utt_flags(num_stream, 0);
+	    // for the checkpointer: the utterance of every stream, and those that
+	    // ended since the last batch
+	    std::vector<int64> utt_index(num_stream, -1), done_utts;
 
 	    // bptt batch buffer
 	    //int32 feat_dim = nnet.InputDim();
@@ -428,7 +481,12 @@ public:
 	                new_utt_flags[s] = 0;
 	                continue;
 	            }
-	            // else, this stream exhausted, need new utterance
+	            // else, this stream exhausted, its last frames are queued
+	            if (utt_index[s] >= 0)
+	                done_utts.push_back(utt_index[s]);
+	            utt_index[s] = -1;
+
+	            // need new utterance
 	            while ((example = dynamic_cast<DNNNnetExample*>(repository_->ProvideExample())) != NULL)
 	            {
 	                const std::string& key = example->utt;
@@ -459,6 +517,9 @@ public:
 	                curt[s] = 0;
 	                lent[s] = feats[s].NumRows();
 	                new_utt_flags[s] = 1;  // a new utterance feeded to this stream
+	                utt_index[s] = example->utt_index;
+	                if (checkpointer_ != NULL)
+	                    checkpointer_->ExampleTaken(utt_index[s]);
 	                delete example;
 	                break;
 	            }
@@ -510,6 +571,7 @@ public:
 	        }
 
 	        lstm_example = new LstmNnetExample(frame_mask, target, feat, new_utt_flags);
+	        lstm_example->done_utts.swap(done_utts);
 	        repo.AcceptExample(lstm_example);
 	    }
 	}
@@ -526,10 +588,18 @@ void NnetLstmUpdateParallel(const NnetLstmUpdateOptions *opts,
 		ExamplesRepository batch_repo[opts->parallel_opts->num_threads];
 		NnetModelSync model_sync(nnet, opts->parallel_opts);
 
+		NnetCheckpointer checkpointer(opts->checkpoint_opts, opts->parallel_opts->myid,
+									  opts->parallel_opts->num_procs);
+		NnetCheckpointState resume_state;
+		if (checkpointer.Resume(&resume_state)) {
+			model_filename = checkpointer.ModelFilename();
+			model_sync.SetMergeState(resume_state.merge_state);
+		}
+
 		TrainLstmParallelClass c(opts, &model_sync,
 								model_filename, targets_rspecifier,
-								batch_repo, nnet, stats);
-		DataLstmParallelClass  d(opts, &model_sync, &repository, batch_repo, stats);
+								batch_repo, nnet, stats, &checkpointer);
+		DataLstmParallelClass  d(opts, &model_sync, &repository, batch_repo, stats, &checkpointer);
 
 
 	  {
@@ -546,6 +616,7 @@ void NnetLstmUpdateParallel(const NnetLstmUpdateOptions *opts,
     			spec_aug_rspecifier = ss.str();
 				spec_aug_reader = new RandomAccessTokenReader(spec_aug_rspecifier);
     		}
+    		SpecAugmenter spec_augmenter(*opts->spec_opts);
 		    if (opts->frame_weights != "") {
 		      weights_reader.Open(opts->frame_weights);
 		    }
@@ -557,13 +628,18 @@ void NnetLstmUpdateParallel(const NnetLstmUpdateOptions *opts,
 
 	    NnetExample *example;
 	    std::vector<NnetExample*> examples;
+	    checkpointer.SkipRead(resume_state.num_utts_done, &feature_reader);
 	    for (; !feature_reader.Done(); feature_reader.Next()) {
+	    	int64 utt_index = checkpointer.UtteranceRead();
 	    	example = new DNNNnetExample(&feature_reader, &si_feature_reader, spec_aug_reader,
                             &targets_reader, &weights_reader, &model_sync, stats, opts);
+	    	example->SetSpecAugmenter(&spec_augmenter);
 	    	if (example->PrepareData(examples))
 	    	{
-	    		for (int i = 0; i < examples.size(); i++)
+	    		for (int i = 0; i < examples.size(); i++) {
+	    			examples[i]->utt_index = utt_index;
 	    			repository.AcceptExample(examples[i]);
+	    		}
 	    		if (examples[0] != example)
 	    			delete example;
 	    	}
@@ -575,6 +575,7 @@ void NnetUpdateParallel(const NnetUpdateOptions *opts,
     			spec_aug_rspecifier = ss.str();
 				spec_aug_reader = new RandomAccessTokenReader(spec_aug_rspecifier);
     		}
+    		SpecAugmenter spec_augmenter(*opts->spec_opts);
 
 		    if (opts->frame_weights != "") 
 		        weights_reader.Open(opts->frame_weights);
@@ -610,6 +611,7 @@ void NnetUpdateParallel(const NnetUpdateOptions *opts,
 
 			example = new DNNNnetExample(&feature_reader, &si_feature_reader, spec_aug_reader, 
 					&targets_reader, &weights_reader, &model_sync, stats, opts);
+			example->SetSpecAugmenter(&spec_augmenter);
 			example->SetSweepFrames(loop_frames, opts->skip_inner);
 			if (example->PrepareData(examples)) {
 				for (int i = 0; i < examples.size(); i++) {
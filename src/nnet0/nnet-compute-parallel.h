@@ -32,37 +32,15 @@
 #include "nnet0/nnet-loss.h"
 #include "nnet0/nnet-nnet.h"
 #include "nnet0/nnet-model-sync.h"
+#include "nnet0/nnet-spec-augment.h"
+#include "nnet0/nnet-checkpoint.h"
+#include "nnet0/nnet-profiler.h"
 
 #include "cudamatrix/cu-device.h"
 
 namespace kaldi {
 namespace nnet0 {
 
-struct SpecAugOptions {
-	int32 num_time_mask;
-	int32 max_time_mask;
-	BaseFloat time_mask_ratio;
-	int32 num_freq_mask;
-	int32 max_freq_mask;
-
-	// default values
-	SpecAugOptions() : num_time_mask(2),
-					   max_time_mask(20),
-					   time_mask_ratio(0.2),
-					   num_freq_mask(2),
-					   max_freq_mask(7) { }
-
-	void Register(OptionsItf *po) {
-	  po->Register("num-time-mask", &num_time_mask, "Number of mask in time domain.");
-	  po->Register("max-time-mask", &max_time_mask, "Maximum mask frames in time domain.");
-	  po->Register("time-mask-ratio", &time_mask_ratio, "Maximum mask frames ration of utterance in time domain.");
-	  po->Register("num-freq-mask", &num_freq_mask, "Number of mask in frequency domain.");
-	  po->Register("max-freq-mask", &max_freq_mask, "Maximum mask frames in frequency domain.");
-	}
-
-};
-
-
 struct NnetUpdateOptions {
     bool binary,
          crossvalidate,
@@ -95,6 +73,9 @@ struct NnetUpdateOptions {
     int32 update_frames;
     double dropout_retention;
 
+    NnetCheckpointOptions checkpoint_opts;  // registered by the trainers that support it
+    NnetProfileOptions profile_opts;        // likewise
+
     const NnetTrainOptions *trn_opts;
     const NnetDataRandomizerOptions *rnd_opts;
     const SpecAugOptions *spec_opts;
@@ -148,6 +129,7 @@ struct NnetStats {
     Xent xent;
     Mse mse;
     MultiTaskLoss multitask;
+    NnetProfiler profiler;  // summed over the training threads of this process
 
     NnetStats(LossOptions &loss_opts):
     	num_done(0),num_no_tgt_mat(0),num_other_error(0),total_frames(0),
@@ -183,6 +165,15 @@ struct NnetStats {
 
     }
 
+    /// Reports the profile of this process if --profile or --profile-json is set.
+    void PrintProfile(const NnetUpdateOptions *opts) {
+        if (!opts->profile_opts.Enabled() || profiler.Empty())
+            return;
+        KALDI_LOG << profiler.Report();
+        if (opts->profile_opts.profile_json != "")
+            profiler.WriteJson(opts->profile_opts.profile_json);
+    }
+
     virtual void  Print(NnetUpdateOptions *opts, double time_now) {
         KALDI_LOG << "Done " << num_done << " files, " << num_no_tgt_mat
                   << " with no tgt_mats, " << num_other_error
@@ -1201,6 +1201,7 @@ void NnetSequentialUpdateParallel(const NnetSequentialUpdateOptions *opts,
 				spec_aug_rspecifier = ss.str();
 				spec_aug_reader = new RandomAccessTokenReader(spec_aug_rspecifier);
 			}
+			SpecAugmenter spec_augmenter(*opts->spec_opts);
 
 	    // The initialization of the following class spawns the threads that
 	    // process the examples.  They get re-joined in its destructor.
@@ -1230,6 +1231,7 @@ void NnetSequentialUpdateParallel(const NnetSequentialUpdateOptions *opts,
 
 			example = new SequentialNnetExample(&feature_reader, &si_feature_reader, spec_aug_reader,
 					&den_lat_reader, &num_ali_reader, &sweep_frames_reader, &model_sync, stats, opts);
+			example->SetSpecAugmenter(&spec_augmenter);
 			example->SetSweepFrames(loop_frames, opts->skip_inner);
 			if (example->PrepareData(examples)) {
 				for (int i = 0; i < examples.size(); i++) {
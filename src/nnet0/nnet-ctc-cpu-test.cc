@@ -0,0 +1,277 @@
+// nnet0/nnet-ctc-cpu-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <limits>
+
+#include "base/timer.h"
+#include "nnet0/nnet-ctc-cpu.h"
+#include "nnet0/nnet-loss.h"
+
+using namespace kaldi;
+using namespace kaldi::nnet0;
+
+// Random softmax outputs in the multi-stream layout, with random lengths and
+// labels that always fit their sequences.
+static void InitBatch(int32 num_sequence, int32 max_frames, int32 num_classes,
+		std::vector<int32> *frame_num_utt, std::vector<std::vector<int32> > *labels,
+		Matrix<BaseFloat> *net_out) {
+	frame_num_utt->resize(num_sequence);
+	labels->resize(num_sequence);
+	for (int32 s = 0; s < num_sequence; s++) {
+		int32 frames = RandInt(max_frames / 2, max_frames);
+		(*frame_num_utt)[s] = frames;
+		(*labels)[s].resize(RandInt(0, frames / 3));
+		for (size_t l = 0; l < (*labels)[s].size(); l++)
+			(*labels)[s][l] = RandInt(1, num_classes - 1);
+	}
+	net_out->Resize(max_frames * num_sequence, num_classes);
+	net_out->SetRandn();
+	net_out->Scale(3.0);
+	for (int32 r = 0; r < net_out->NumRows(); r++)
+		net_out->Row(r).ApplySoftMax();
+}
+
+// Straightforward log-domain forward-backward of one sequence, returns
+// log p(z|x) and the occupancies gamma(t, k).
+static double ReferenceCtc(const Matrix<BaseFloat> &net_out, int32 s,
+		int32 num_sequence, int32 T, const std::vector<int32> &label,
+		Matrix<double> *gamma) {
+	int32 S = 2 * label.size() + 1;
+	std::vector<int32> ext(S, 0);
+	for (size_t l = 0; l < label.size(); l++)
+		ext[2 * l + 1] = label[l];
+	const double kLogZero = -std::numeric_limits<double>::infinity();
+	Matrix<double> alpha(T, S), beta(T, S), logy(T, S);
+	alpha.Set(kLogZero);
+	beta.Set(kLogZero);
+	for (int32 t = 0; t < T; t++)
+		for (int32 j = 0; j < S; j++)
+			logy(t, j) = Log(static_cast<double>(net_out(t * num_sequence + s, ext[j])));
+
+	for (int32 t = 0; t < T; t++) {
+		for (int32 j = 0; j < S; j++) {
+			double a = kLogZero;
+			if (t == 0) {
+				if (j < 2) a = 0.0;
+			} else {
+				a = alpha(t - 1, j);
+				if (j > 0) a = LogAdd(a, alpha(t - 1, j - 1));
+				if (j > 1 && j % 2 == 1 && ext[j] != ext[j - 2])
+					a = LogAdd(a, alpha(t - 1, j - 2));
+			}
+			alpha(t, j) = (a == kLogZero ? kLogZero : a + logy(t, j));
+		}
+	}
+	for (int32 t = T - 1; t >= 0; t--) {
+		for (int32 j = 0; j < S; j++) {
+			double b = kLogZero;
+			if (t == T - 1) {
+				if (j >= S - 2) b = logy(t, j);
+			} else {
+				b = beta(t + 1, j);
+				if (j + 1 < S) b = LogAdd(b, beta(t + 1, j + 1));
+				if (j + 2 < S && (j + 2) % 2 == 1 && ext[j + 2] != ext[j])
+					b = LogAdd(b, beta(t + 1, j + 2));
+				if (b != kLogZero) b += logy(t, j);
+			}
+			beta(t, j) = b;
+		}
+	}
+	double pzx = alpha(T - 1, S - 1);
+	if (S > 1) pzx = LogAdd(pzx, alpha(T - 1, S - 2));
+
+	gamma->Resize(T, net_out.NumCols());
+	for (int32 t = 0; t < T; t++)
+		for (int32 j = 0; j < S; j++)
+			if (alpha(t, j) != kLogZero && beta(t, j) != kLogZero)
+				(*gamma)(t, ext[j]) += Exp(alpha(t, j) + beta(t, j) - logy(t, j) - pzx);
+	return pzx;
+}
+
+void UnitTestCtcCpuReference() {
+	int32 num_sequence = RandInt(1, 6), max_frames = RandInt(5, 60),
+		num_classes = RandInt(3, 20);
+	std::vector<int32> frame_num_utt;
+	std::vector<std::vector<int32> > labels;
+	Matrix<BaseFloat> net_out;
+	InitBatch(num_sequence, max_frames, num_classes, &frame_num_utt, &labels, &net_out);
+	// repeated labels need a blank in between.
+	labels[0].push_back(1);
+	labels[0].push_back(1);
+	frame_num_utt[0] = max_frames;
+
+	CtcCpuComputer ctc(1 + Rand() % 4);
+	Matrix<BaseFloat> diff(net_out.NumRows(), net_out.NumCols(), kUndefined);
+	Vector<BaseFloat> pzx;
+	ctc.Compute(frame_num_utt, net_out, labels, &diff, &pzx);
+
+	for (int32 s = 0; s < num_sequence; s++) {
+		Matrix<double> gamma;
+		double ref = ReferenceCtc(net_out, s, num_sequence, frame_num_utt[s],
+								  labels[s], &gamma);
+		KALDI_ASSERT(ApproxEqual(pzx(s), ref, 1.0e-03));
+		for (int32 t = 0; t < max_frames; t++) {
+			int32 row = t * num_sequence + s;
+			for (int32 k = 0; k < num_classes; k++) {
+				double expected = (t < frame_num_utt[s] ?
+						net_out(row, k) - gamma(t, k) : 0.0);
+				KALDI_ASSERT(fabs(diff(row, k) - expected) < 1.0e-04);
+			}
+		}
+	}
+}
+
+void UnitTestCtcCpuInfeasible() {
+	// three distinct labels need at least three frames.
+	std::vector<int32> frame_num_utt(2);
+	frame_num_utt[0] = 2;
+	frame_num_utt[1] = 4;
+	std::vector<std::vector<int32> > labels(2);
+	labels[0].push_back(1); labels[0].push_back(2); labels[0].push_back(3);
+	labels[1] = labels[0];
+	Matrix<BaseFloat> net_out(8, 5);
+	net_out.Set(0.2);
+	Matrix<BaseFloat> diff(8, 5);
+	diff.Set(1.0);
+	Vector<BaseFloat> pzx;
+	CtcCpuComputer ctc;
+	ctc.Compute(frame_num_utt, net_out, labels, &diff, &pzx);
+	KALDI_ASSERT(pzx(0) == -std::numeric_limits<BaseFloat>::infinity());
+	KALDI_ASSERT(pzx(1) > -std::numeric_limits<BaseFloat>::infinity());
+	for (int32 t = 0; t < 4; t++)
+		KALDI_ASSERT(diff.Row(2 * t).Max() == 0.0 && diff.Row(2 * t).Min() == 0.0);
+}
+
+void UnitTestCtcCpuNearInfeasible() {
+	// three distinct labels in three frames allow one alignment only; as its
+	// outputs get smaller the occupancies underflow, but the gradient must
+	// stay finite (or be zero, with pzx = -infinity).
+	std::vector<int32> frame_num_utt(1, 3);
+	std::vector<std::vector<int32> > labels(1);
+	labels[0].push_back(1); labels[0].push_back(2); labels[0].push_back(3);
+	for (int32 e = 5; e <= 45; e++) {
+		BaseFloat eps = pow(10.0, -e);
+		Matrix<BaseFloat> net_out(3, 4);
+		net_out.Set(1.0);
+		net_out(0, 1) = eps;
+		net_out(2, 3) = eps;
+		Matrix<BaseFloat> diff(3, 4);
+		Vector<BaseFloat> pzx;
+		CtcCpuComputer ctc;
+		ctc.Compute(frame_num_utt, net_out, labels, &diff, &pzx);
+		KALDI_ASSERT(KALDI_ISFINITE(diff.Sum()));
+		if (pzx(0) == -std::numeric_limits<BaseFloat>::infinity()) {
+			KALDI_ASSERT(diff.Max() == 0.0 && diff.Min() == 0.0);
+		} else {
+			for (int32 t = 0; t < 3; t++)
+				KALDI_ASSERT(fabs(diff(t, t + 1) - (net_out(t, t + 1) - 1.0)) < 1.0e-04);
+		}
+	}
+}
+
+void UnitTestCtcCpuThreads() {
+	std::vector<int32> frame_num_utt;
+	std::vector<std::vector<int32> > labels;
+	Matrix<BaseFloat> net_out;
+	InitBatch(16, 100, 30, &frame_num_utt, &labels, &net_out);
+	Matrix<BaseFloat> diff1(net_out.NumRows(), net_out.NumCols()),
+		diff4(net_out.NumRows(), net_out.NumCols());
+	Vector<BaseFloat> pzx1, pzx4;
+	CtcCpuComputer(1).Compute(frame_num_utt, net_out, labels, &diff1, &pzx1);
+	CtcCpuComputer(4).Compute(frame_num_utt, net_out, labels, &diff4, &pzx4);
+	// each sequence is computed the same way whichever thread gets it.
+	KALDI_ASSERT(pzx1.ApproxEqual(pzx4, 0.0) && diff1.ApproxEqual(diff4, 0.0));
+}
+
+// Times the CPU engine against the plain log-domain forward-backward above,
+// and against Ctc::EvalParallel when it runs on a GPU (without one it would
+// run this engine again).
+void BenchmarkCtc() {
+	int32 num_sequence = 32, max_frames = 300, num_classes = 200;
+	std::vector<int32> frame_num_utt;
+	std::vector<std::vector<int32> > labels;
+	Matrix<BaseFloat> net_out;
+	InitBatch(num_sequence, max_frames, num_classes, &frame_num_utt, &labels, &net_out);
+	for (int32 s = 0; s < num_sequence; s++)
+		labels[s].resize(std::min<size_t>(std::max<size_t>(labels[s].size(), 1), 60), 1);
+
+	Vector<BaseFloat> ref_pzx(num_sequence);
+	{
+		Timer timer;
+		for (int32 s = 0; s < num_sequence; s++) {
+			Matrix<double> gamma;
+			ref_pzx(s) = ReferenceCtc(net_out, s, num_sequence, frame_num_utt[s],
+									  labels[s], &gamma);
+		}
+		KALDI_LOG << "Log-domain reference: " << timer.Elapsed()
+				  << " sec per minibatch";
+	}
+
+	int32 num_iter = 5;
+	Matrix<BaseFloat> diff(net_out.NumRows(), net_out.NumCols());
+	Vector<BaseFloat> pzx;
+	for (int32 num_threads = 1; num_threads <= 8; num_threads *= 2) {
+		CtcCpuComputer ctc(num_threads);
+		Timer timer;
+		for (int32 i = 0; i < num_iter; i++)
+			ctc.Compute(frame_num_utt, net_out, labels, &diff, &pzx);
+		KALDI_LOG << "CtcCpuComputer with " << num_threads << " threads: "
+				  << timer.Elapsed() / num_iter << " sec per minibatch";
+		KALDI_ASSERT(pzx.ApproxEqual(ref_pzx, 1.0e-03));
+	}
+
+#if HAVE_CUDA == 1
+	if (CuDevice::Instantiate().Enabled()) {
+		Ctc ctc;
+		CuMatrix<BaseFloat> cu_net_out(net_out), cu_diff;
+		Vector<BaseFloat> eval_pzx;
+		Timer timer;
+		for (int32 i = 0; i < num_iter; i++)
+			ctc.EvalParallel(frame_num_utt, cu_net_out, labels, &cu_diff, &eval_pzx);
+		KALDI_LOG << "Ctc::EvalParallel on the GPU: " << timer.Elapsed() / num_iter
+				  << " sec per minibatch";
+		KALDI_ASSERT(eval_pzx.ApproxEqual(ref_pzx, 1.0e-03));
+	}
+#endif
+}
+
+int main() {
+	for (int32 loop = 0; loop < 2; loop++) {
+#if HAVE_CUDA == 1
+		if (loop == 0)
+			CuDevice::Instantiate().SelectGpuId("no"); // use no GPU
+		else
+			CuDevice::Instantiate().SelectGpuId("optional"); // use GPU when available
+#endif
+		if (loop == 0) {
+			for (int32 i = 0; i < 20; i++)
+				UnitTestCtcCpuReference();
+			UnitTestCtcCpuInfeasible();
+			UnitTestCtcCpuNearInfeasible();
+			UnitTestCtcCpuThreads();
+		}
+		BenchmarkCtc();
+		if (loop == 0)
+			KALDI_LOG << "Tests without GPU use succeeded.";
+		else
+			KALDI_LOG << "Tests with GPU use (if available) succeeded.";
+	}
+#if HAVE_CUDA == 1
+	CuDevice::Instantiate().PrintProfile();
+#endif
+	return 0;
+}
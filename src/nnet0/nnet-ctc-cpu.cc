@@ -0,0 +1,260 @@
+// nnet0/nnet-ctc-cpu.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#include "util/kaldi-thread.h"
+#include "nnet0/nnet-ctc-cpu.h"
+
+namespace kaldi {
+namespace nnet0 {
+
+namespace {
+
+// Per-thread scratch space, grown on demand and reused across sequences.
+struct CtcWorkspace {
+	std::vector<int32> ext;       // expanded labels: blank, l1, blank, l2, ...
+	std::vector<BaseFloat> skip;  // 1 if state j may be entered from j-2
+	std::vector<BaseFloat> ylab;  // output probabilities gathered by state
+	std::vector<BaseFloat> beta, beta_prev, gamma;
+	Matrix<BaseFloat> alpha;      // rescaled forward variables, frames x states
+};
+
+inline double Sum(const BaseFloat *v, int32 n) {
+	double sum = 0.0;
+	for (int32 j = 0; j < n; j++)
+		sum += v[j];
+	return sum;
+}
+
+inline void Scale(BaseFloat scale, BaseFloat *v, int32 n) {
+	for (int32 j = 0; j < n; j++)
+		v[j] *= scale;
+}
+
+inline void Gather(const BaseFloat *y, const int32 *ext, int32 n, BaseFloat *ylab) {
+	for (int32 j = 0; j < n; j++)
+		ylab[j] = y[ext[j]];
+}
+
+// Runs the forward-backward for sequence 's' and writes its rows of 'diff'.
+// Returns log p(z|x), or -infinity if the labels do not fit the frames.
+double ComputeSequence(const MatrixBase<BaseFloat> &net_out,
+		int32 s, int32 num_sequence, int32 num_frames,
+		const std::vector<int32> &label, int32 blank,
+		CtcWorkspace *ws, MatrixBase<BaseFloat> *diff) {
+	const double kLogZero = -std::numeric_limits<double>::infinity();
+	int32 num_states = 2 * label.size() + 1, T = num_frames,
+		num_classes = net_out.NumCols();
+
+	ws->ext.resize(num_states);
+	ws->skip.resize(num_states);
+	ws->ylab.resize(num_states);
+	ws->beta.resize(num_states);
+	ws->beta_prev.resize(num_states);
+	ws->gamma.resize(num_states);
+	for (int32 j = 0; j < num_states; j++) {
+		int32 k = (j % 2 == 0 ? blank : label[j / 2]);
+		KALDI_ASSERT(k >= 0 && k < num_classes);
+		ws->ext[j] = k;
+		ws->skip[j] = (j % 2 == 1 && j > 1 && k != ws->ext[j - 2]) ? 1.0 : 0.0;
+	}
+	if (ws->alpha.NumRows() < T || ws->alpha.NumCols() < num_states)
+		ws->alpha.Resize(std::max(ws->alpha.NumRows(), T),
+						 std::max(ws->alpha.NumCols(), num_states), kUndefined);
+
+	const int32 *ext = &ws->ext[0];
+	const BaseFloat *skip = &ws->skip[0];
+	BaseFloat *ylab = &ws->ylab[0];
+	int32 S = num_states;
+
+	// forward pass; every row of alpha is normalized to sum to one and the
+	// normalizers are accumulated in log_scale.
+	double log_scale = 0.0;
+	bool ok = (T > 0);
+	for (int32 t = 0; t < T && ok; t++) {
+		Gather(net_out.RowData(t * num_sequence + s), ext, S, ylab);
+		BaseFloat *cur = ws->alpha.RowData(t);
+		if (t == 0) {
+			for (int32 j = 0; j < S; j++)
+				cur[j] = (j < 2 ? ylab[j] : 0.0);
+		} else {
+			const BaseFloat *prev = ws->alpha.RowData(t - 1);
+			cur[0] = ylab[0] * prev[0];
+			if (S > 1)
+				cur[1] = ylab[1] * (prev[1] + prev[0]);
+			for (int32 j = 2; j < S; j++)
+				cur[j] = ylab[j] * (prev[j] + prev[j - 1] + skip[j] * prev[j - 2]);
+		}
+		BaseFloat c = Sum(cur, S);
+		if (!(c > 0.0)) {
+			ok = false;
+			break;
+		}
+		Scale(1.0 / c, cur, S);
+		log_scale += Log(static_cast<double>(c));
+	}
+	BaseFloat final = 0.0;
+	if (ok) {
+		const BaseFloat *last = ws->alpha.RowData(T - 1);
+		final = last[S - 1] + (S > 1 ? last[S - 2] : 0.0);
+		ok = (final > 0.0);
+	}
+	if (!ok) {
+		for (int32 t = 0; t < T; t++)
+			diff->Row(t * num_sequence + s).SetZero();
+		return kLogZero;
+	}
+
+	// backward pass.  beta(t, j) excludes the output at t, so alpha(t, j) *
+	// beta(t, j) is the occupancy of state j at t up to a per-frame constant.
+	BaseFloat *beta = &ws->beta[0], *beta_prev = &ws->beta_prev[0],
+		*gamma = &ws->gamma[0];
+	for (int32 j = 0; j < S; j++)
+		beta[j] = (j >= S - 2 ? 1.0 : 0.0);
+	for (int32 t = T - 1; t >= 0; t--) {
+		int32 row = t * num_sequence + s;
+		const BaseFloat *a = ws->alpha.RowData(t), *y = net_out.RowData(row);
+		for (int32 j = 0; j < S; j++)
+			gamma[j] = a[j] * beta[j];
+		// when the labels barely fit the frames, the products can underflow
+		// although the forward pass reached the end.
+		double z = Sum(gamma, S);
+		if (!(z > 0.0 && KALDI_ISFINITE(z))) {
+			for (int32 t = 0; t < T; t++)
+				diff->Row(t * num_sequence + s).SetZero();
+			return kLogZero;
+		}
+		double inv_z = 1.0 / z;
+
+		// fused softmax backprop: diff = y - gamma.
+		BaseFloat *d = diff->RowData(row);
+		std::copy(y, y + num_classes, d);
+		for (int32 j = 0; j < S; j++)
+			d[ext[j]] -= gamma[j] * inv_z;
+
+		if (t == 0)
+			break;
+		// beta(t-1, j) = sum of y(t, j') beta(t, j') over the successors j'
+		// in {j, j+1, j+2}; gamma is reused as scratch.
+		Gather(y, ext, S, ylab);
+		for (int32 j = 0; j < S; j++)
+			gamma[j] = ylab[j] * beta[j];
+		for (int32 j = 0; j + 2 < S; j++)
+			beta_prev[j] = gamma[j] + gamma[j + 1] + skip[j + 2] * gamma[j + 2];
+		if (S > 1)
+			beta_prev[S - 2] = gamma[S - 2] + gamma[S - 1];
+		beta_prev[S - 1] = gamma[S - 1];
+		BaseFloat c = Sum(beta_prev, S);
+		// c > 0 because the forward pass reached the end.
+		Scale(1.0 / c, beta_prev, S);
+		std::swap(beta, beta_prev);
+	}
+
+	return log_scale + Log(static_cast<double>(final));
+}
+
+class CtcSequenceTask: public MultiThreadable {
+ public:
+	CtcSequenceTask(const std::vector<int32> &order,
+			const std::vector<int32> &frame_num_utt,
+			const MatrixBase<BaseFloat> &net_out,
+			const std::vector<std::vector<int32> > &labels, int32 blank,
+			std::atomic<int32> *next, MatrixBase<BaseFloat> *diff,
+			Vector<BaseFloat> *pzx):
+		order_(order), frame_num_utt_(frame_num_utt), net_out_(net_out),
+		labels_(labels), blank_(blank), next_(next), diff_(diff), pzx_(pzx) { }
+
+	// the workspace is per thread, so it is not copied.
+	CtcSequenceTask(const CtcSequenceTask &other):
+		MultiThreadable(other), order_(other.order_),
+		frame_num_utt_(other.frame_num_utt_), net_out_(other.net_out_),
+		labels_(other.labels_), blank_(other.blank_), next_(other.next_),
+		diff_(other.diff_), pzx_(other.pzx_) { }
+
+	void operator() () {
+		int32 num_sequence = frame_num_utt_.size();
+		for (int32 i = (*next_)++; i < num_sequence; i = (*next_)++) {
+			int32 s = order_[i];
+			(*pzx_)(s) = ComputeSequence(net_out_, s, num_sequence,
+							frame_num_utt_[s], labels_[s], blank_, &ws_, diff_);
+		}
+	}
+
+ private:
+	const std::vector<int32> &order_;
+	const std::vector<int32> &frame_num_utt_;
+	const MatrixBase<BaseFloat> &net_out_;
+	const std::vector<std::vector<int32> > &labels_;
+	int32 blank_;
+	std::atomic<int32> *next_;
+	MatrixBase<BaseFloat> *diff_;
+	Vector<BaseFloat> *pzx_;
+	CtcWorkspace ws_;
+};
+
+struct LongerSequence {
+	const std::vector<int32> &frame_num_utt;
+	explicit LongerSequence(const std::vector<int32> &f): frame_num_utt(f) { }
+	bool operator() (int32 a, int32 b) const {
+		return frame_num_utt[a] > frame_num_utt[b];
+	}
+};
+
+} // namespace
+
+CtcCpuComputer::CtcCpuComputer(int32 num_threads, int32 blank_label):
+	num_threads_(num_threads), blank_label_(blank_label) {
+	KALDI_ASSERT(num_threads_ >= 1 && blank_label_ >= 0);
+}
+
+void CtcCpuComputer::Compute(const std::vector<int32> &frame_num_utt,
+		const MatrixBase<BaseFloat> &net_out,
+		const std::vector<std::vector<int32> > &labels,
+		MatrixBase<BaseFloat> *diff, Vector<BaseFloat> *pzx) const {
+	int32 num_sequence = frame_num_utt.size();
+	KALDI_ASSERT(num_sequence > 0 && labels.size() == num_sequence);
+	KALDI_ASSERT(net_out.NumRows() % num_sequence == 0);
+	KALDI_ASSERT(diff->NumRows() == net_out.NumRows() &&
+				 diff->NumCols() == net_out.NumCols());
+	int32 num_frames_per_sequence = net_out.NumRows() / num_sequence;
+
+	// padding rows carry no gradient.
+	for (int32 s = 0; s < num_sequence; s++) {
+		KALDI_ASSERT(frame_num_utt[s] <= num_frames_per_sequence);
+		for (int32 t = frame_num_utt[s]; t < num_frames_per_sequence; t++)
+			diff->Row(t * num_sequence + s).SetZero();
+	}
+
+	std::vector<int32> order(num_sequence);
+	for (int32 s = 0; s < num_sequence; s++)
+		order[s] = s;
+	std::stable_sort(order.begin(), order.end(), LongerSequence(frame_num_utt));
+
+	pzx->Resize(num_sequence, kUndefined);
+	std::atomic<int32> next(0);
+	CtcSequenceTask task(order, frame_num_utt, net_out, labels, blank_label_,
+						 &next, diff, pzx);
+	// num_threads == 0 runs the task in this thread.
+	int32 num_threads = std::min(num_threads_, num_sequence);
+	MultiThreader<CtcSequenceTask> m(num_threads == 1 ? 0 : num_threads, task);
+}
+
+} // namespace nnet0
+} // namespace kaldi
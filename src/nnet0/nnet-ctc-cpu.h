@@ -0,0 +1,74 @@
+// nnet0/nnet-ctc-cpu.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET_NNET_CTC_CPU_H_
+#define KALDI_NNET_NNET_CTC_CPU_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-matrix.h"
+#include "matrix/kaldi-vector.h"
+
+namespace kaldi {
+namespace nnet0 {
+
+/**
+ * CtcCpuComputer evaluates the CTC objective and its gradient on the CPU for
+ * a minibatch of sequences in the multi-stream layout of the CTC trainers:
+ * frame t of sequence s is row t * num_sequence + s of the network output,
+ * and rows past the end of a sequence are padding.
+ *
+ * The sequences are independent, so they are distributed over the threads
+ * (longest first, each thread taking the next one when it is done).  Within a
+ * sequence the forward-backward runs in the probability domain with per-frame
+ * rescaling, which is the log-domain recursion with the log-sum-exp over the
+ * label positions reduced to one log() per frame; the inner loops over label
+ * positions are branch-free and vectorize.  The backward pass does not store
+ * beta, it writes the gradient of each frame as soon as its beta is known.
+ *
+ * The gradient is taken w.r.t. the softmax input, i.e. the softmax
+ * backpropagation is fused in: diff(t, k) = y(t, k) - gamma(t, k), where
+ * gamma(t, k) is the posterior occupancy of class k at frame t.
+ */
+class CtcCpuComputer {
+ public:
+  explicit CtcCpuComputer(int32 num_threads = 1, int32 blank_label = 0);
+
+  /// 'net_out' holds the softmax outputs, 'frame_num_utt[s]' the number of
+  /// frames of sequence s, and 'labels[s]' its label sequence (without
+  /// blanks).  On output 'diff' (same size as net_out) holds the gradient,
+  /// zero on padding rows, and 'pzx(s)' is log p(labels[s] | x).  Sequences
+  /// whose labels cannot be aligned to their frames get
+  /// pzx(s) = -infinity and a zero gradient.
+  void Compute(const std::vector<int32> &frame_num_utt,
+               const MatrixBase<BaseFloat> &net_out,
+               const std::vector<std::vector<int32> > &labels,
+               MatrixBase<BaseFloat> *diff,
+               Vector<BaseFloat> *pzx) const;
+
+  int32 NumThreads() const { return num_threads_; }
+
+ private:
+  int32 num_threads_;
+  int32 blank_label_;
+};
+
+} // namespace nnet0
+} // namespace kaldi
+
+#endif // KALDI_NNET_NNET_CTC_CPU_H_
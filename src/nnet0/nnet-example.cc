@@ -97,6 +97,11 @@ bool DNNNnetExample::PrepareData(std::vector<NnetExample*> &examples) {
 
 	if (skip_frames <= 1) {
 		examples.push_back(this);
+		if (opts->use_specaug && SelectSpecAugment()) {
+			DNNNnetExample *spec_example = new DNNNnetExample(*this);
+			spec_augmenter->Apply(&spec_example->input_frames, false);
+			examples.push_back(spec_example);
+		}
 		return true;
 	}
 
@@ -141,15 +146,12 @@ bool DNNNnetExample::PrepareData(std::vector<NnetExample*> &examples) {
 		examples.push_back(example);
 
     	// spectrum augmentation
-    	if (opts->use_specaug) {
-    		if (this->spec_aug_reader == NULL || (this->spec_aug_reader != NULL && this->spec_aug_reader->HasKey(utt))) {
-				DNNNnetExample *spec_example = new DNNNnetExample(feature_reader, si_feature_reader, spec_aug_reader, 
-                                                                    targets_reader, weights_reader, model_sync, stats, opts);
-				*spec_example = *example;
-				spec_example->input_frames.SpecAugment(opts->spec_opts->num_time_mask, opts->spec_opts->max_time_mask,
-						opts->spec_opts->time_mask_ratio, opts->spec_opts->num_freq_mask, opts->spec_opts->max_freq_mask);
-				examples.push_back(spec_example);
-    		}
+    	if (opts->use_specaug && SelectSpecAugment()) {
+			DNNNnetExample *spec_example = new DNNNnetExample(feature_reader, si_feature_reader, spec_aug_reader, 
+                                                                targets_reader, weights_reader, model_sync, stats, opts);
+			*spec_example = *example;
+			spec_augmenter->Apply(&spec_example->input_frames, false);
+			examples.push_back(spec_example);
     	}
 	}
 
@@ -186,6 +188,11 @@ bool CTCNnetExample::PrepareData(std::vector<NnetExample*> &examples) {
 
     if (skip_frames <= 1) {
     	examples.push_back(this);
+    	if (opts->use_specaug && SelectSpecAugment()) {
+    		CTCNnetExample *spec_example = new CTCNnetExample(*this);
+    		spec_augmenter->Apply(&spec_example->input_frames, !use_kld);
+    		examples.push_back(spec_example);
+    	}
     	return true;
     }
 
@@ -221,15 +228,12 @@ bool CTCNnetExample::PrepareData(std::vector<NnetExample*> &examples) {
     	examples.push_back(example);
 
     	// spectrum augmentation
-    	if (opts->use_specaug) {
-    		if (this->spec_aug_reader == NULL || (this->spec_aug_reader != NULL && this->spec_aug_reader->HasKey(utt))) {
-				CTCNnetExample *spec_example = new CTCNnetExample(feature_reader, si_feature_reader, spec_aug_reader,
-                                                                    targets_reader, model_sync, stats, opts);
-				*spec_example = *example;
-				spec_example->input_frames.SpecAugment(opts->spec_opts->num_time_mask, opts->spec_opts->max_time_mask,
-								opts->spec_opts->time_mask_ratio, opts->spec_opts->num_freq_mask, opts->spec_opts->max_freq_mask);
-				examples.push_back(spec_example);
-    		}
+    	if (opts->use_specaug && SelectSpecAugment()) {
+			CTCNnetExample *spec_example = new CTCNnetExample(feature_reader, si_feature_reader, spec_aug_reader,
+                                                                targets_reader, model_sync, stats, opts);
+			*spec_example = *example;
+			spec_augmenter->Apply(&spec_example->input_frames, !use_kld);
+			examples.push_back(spec_example);
     	}
     }
 
@@ -340,6 +344,11 @@ bool SequentialNnetExample::PrepareData(std::vector<NnetExample*> &examples) {
 
 	if (skip_frames <= 1) {
 		examples.push_back(this);
+		if (opts->use_specaug && SelectSpecAugment()) {
+			SequentialNnetExample *spec_example = new SequentialNnetExample(*this);
+			spec_augmenter->Apply(&spec_example->input_frames, false);
+			examples.push_back(spec_example);
+		}
 		return true;
 	}
 
@@ -372,15 +381,12 @@ bool SequentialNnetExample::PrepareData(std::vector<NnetExample*> &examples) {
 		examples.push_back(example);
 
     	// spectrum augmentation
-    	if (opts->use_specaug) {
-    		if (this->spec_aug_reader == NULL || (this->spec_aug_reader != NULL && this->spec_aug_reader->HasKey(utt))) {
-    			SequentialNnetExample *spec_example = new SequentialNnetExample(feature_reader, si_feature_reader, spec_aug_reader,
-    											den_lat_reader, num_ali_reader, sweep_frames_reader, model_sync, stats, opts);
-				*spec_example = *example;
-				spec_example->input_frames.SpecAugment(opts->spec_opts->num_time_mask, opts->spec_opts->max_time_mask,
-								opts->spec_opts->time_mask_ratio, opts->spec_opts->num_freq_mask, opts->spec_opts->max_freq_mask);
-				examples.push_back(spec_example);
-    		}
+    	if (opts->use_specaug && SelectSpecAugment()) {
+			SequentialNnetExample *spec_example = new SequentialNnetExample(feature_reader, si_feature_reader, spec_aug_reader,
+											den_lat_reader, num_ali_reader, sweep_frames_reader, model_sync, stats, opts);
+			*spec_example = *example;
+			spec_augmenter->Apply(&spec_example->input_frames, false);
+			examples.push_back(spec_example);
     	}
 	}
 
@@ -460,6 +466,11 @@ bool RNNTNnetExample::PrepareData(std::vector<NnetExample*> &examples) {
 
     if (skip_frames <= 1) {
     	examples.push_back(this);
+    	if (opts->use_specaug && SelectSpecAugment()) {
+    		RNNTNnetExample *spec_example = new RNNTNnetExample(*this);
+    		spec_augmenter->Apply(&spec_example->input_frames, !use_kld);
+    		examples.push_back(spec_example);
+    	}
     	return true;
     }
 
@@ -496,15 +507,12 @@ bool RNNTNnetExample::PrepareData(std::vector<NnetExample*> &examples) {
     	examples.push_back(example);
 
     	// spectrum augmentation
-    	if (opts->use_specaug) {
-    		if (this->spec_aug_reader == NULL || (this->spec_aug_reader != NULL && this->spec_aug_reader->HasKey(utt))) {
-    	        RNNTNnetExample *spec_example = new RNNTNnetExample(feature_reader,
-    			                                si_feature_reader, spec_aug_reader, wordid_reader, stats, opts);
-				*spec_example = *example;
-				spec_example->input_frames.SpecAugment(opts->spec_opts->num_time_mask, opts->spec_opts->max_time_mask,
-								opts->spec_opts->time_mask_ratio, opts->spec_opts->num_freq_mask, opts->spec_opts->max_freq_mask);
-				examples.push_back(spec_example);
-    		}
+    	if (opts->use_specaug && SelectSpecAugment()) {
+	        RNNTNnetExample *spec_example = new RNNTNnetExample(feature_reader,
+			                                si_feature_reader, spec_aug_reader, wordid_reader, stats, opts);
+			*spec_example = *example;
+			spec_augmenter->Apply(&spec_example->input_frames, !use_kld);
+			examples.push_back(spec_example);
     	}
     }
 
@@ -693,42 +701,18 @@ bool LstmNnetExample::PrepareData(std::vector<NnetExample*> &examples) {
 	return true;
 }
 
-void ExamplesRepository::AcceptExample(
-		NnetExample *example) {
-  empty_semaphore_.Wait();
-  examples_mutex_.Lock();
-  examples_.push_back(example);
-  examples_mutex_.Unlock();
-  full_semaphore_.Signal();
+void ExamplesRepository::AcceptExample(NnetExample *example) {
+  if (!examples_.Push(example))
+    KALDI_ERR << "AcceptExample() called after ExamplesDone().";
 }
 
 void ExamplesRepository::ExamplesDone() {
-  for (int32 i = 0; i < buffer_size_; i++)
-    empty_semaphore_.Wait();
-  examples_mutex_.Lock();
-  KALDI_ASSERT(examples_.empty());
-  examples_mutex_.Unlock();
-  done_ = true;
-  full_semaphore_.Signal();
+  examples_.Close();
 }
 
-NnetExample*
-ExamplesRepository::ProvideExample() {
-  full_semaphore_.Wait();
-  if (done_) {
-    KALDI_ASSERT(examples_.empty());
-    full_semaphore_.Signal(); // Increment the semaphore so
-    // the call by the next thread will not block.
-    return NULL; // no examples to return-- all finished.
-  } else {
-    examples_mutex_.Lock();
-    KALDI_ASSERT(!examples_.empty());
-    NnetExample *ans = examples_.front();
-    examples_.pop_front();
-    examples_mutex_.Unlock();
-    empty_semaphore_.Signal();
-    return ans;
-  }
+NnetExample* ExamplesRepository::ProvideExample() {
+  NnetExample *ans;
+  return examples_.Pop(&ans) ? ans : NULL;
 }
 
 
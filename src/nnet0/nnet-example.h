@@ -20,6 +20,7 @@
 #ifndef NNET_NNET_EXAMPLE_H_
 #define NNET_NNET_EXAMPLE_H_
 
+#include "util/mpmc-queue.h"
 #include "nnet0/nnet-compute-parallel.h"
 #include "nnet0/nnet-compute-sequential-parallel.h"
 #include "nnet0/nnet-compute-ctc-parallel.h"
@@ -35,6 +36,7 @@ struct NnetExample {
 	SequentialBaseFloatMatrixReader *feature_reader;
 	RandomAccessBaseFloatMatrixReader *si_feature_reader;
 	RandomAccessTokenReader *spec_aug_reader;
+	SpecAugmenter *spec_augmenter;
 
 	std::string utt;
 	Matrix<BaseFloat> input_frames;
@@ -44,17 +46,37 @@ struct NnetExample {
 	Matrix<BaseFloat> si_input_frames;
 	bool use_kld;
 
+	int64 utt_index;  // position of the utterance in the rspecifier, for checkpoints
+
 	NnetExample(SequentialBaseFloatMatrixReader *feature_reader,
 			RandomAccessBaseFloatMatrixReader *si_feature_reader, 
 			RandomAccessTokenReader *spec_aug_reader):
 		feature_reader(feature_reader), si_feature_reader(si_feature_reader),
-		spec_aug_reader(spec_aug_reader), inner_skipframes(false), use_kld(false) {}
+		spec_aug_reader(spec_aug_reader), spec_augmenter(NULL),
+		inner_skipframes(false), use_kld(false), utt_index(-1) {}
 
     void SetSweepFrames(const std::vector<int32> &frames, bool inner = false) {
         sweep_frames = frames;
         inner_skipframes = inner;
     }
 
+    /// The augmenter is owned by the data-reading thread, which calls
+    /// PrepareData(); without one no augmented copies are produced.
+    void SetSpecAugmenter(SpecAugmenter *augmenter) {
+        spec_augmenter = augmenter;
+    }
+
+    /// True if an augmented copy of the current utterance should be added:
+    /// it must be listed in --spec-aug-filename (if given) and is then kept
+    /// with probability --spec-aug-prob.
+    bool SelectSpecAugment() {
+        if (spec_augmenter == NULL)
+            return false;
+        if (spec_aug_reader != NULL && !spec_aug_reader->HasKey(utt))
+            return false;
+        return spec_augmenter->Select();
+    }
+
 	virtual ~NnetExample() {}
 	virtual bool PrepareData(std::vector<NnetExample*> &examples) = 0;
 };
@@ -268,6 +290,7 @@ struct LstmNnetExample: NnetExample {
     Posterior target;
     Matrix<BaseFloat> feat;
     std::vector<int> new_utt_flags;
+    std::vector<int64> done_utts;  // utterances whose last frames are in an earlier batch
 
     LstmNnetExample(Vector<BaseFloat> &mask, Posterior &tgt, Matrix<BaseFloat> &ft, std::vector<int> &flags)
     :NnetExample(NULL, NULL, NULL) {
@@ -299,17 +322,9 @@ class ExamplesRepository {
   /// ExamplesDone() has been called.
   NnetExample *ProvideExample();
 
-  ExamplesRepository(int32 buffer_size = 128): buffer_size_(buffer_size),
-                                      empty_semaphore_(buffer_size_),
-                                      done_(false) {}
+  ExamplesRepository(int32 buffer_size = 128): examples_(buffer_size) {}
  private:
-  int32 buffer_size_;
-  Semaphore full_semaphore_;
-  Semaphore empty_semaphore_;
-  Mutex examples_mutex_; // mutex we lock to modify examples_.
-
-  std::deque<NnetExample*> examples_;
-  bool done_;
+  MpmcQueue<NnetExample*> examples_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(ExamplesRepository);
 };
 
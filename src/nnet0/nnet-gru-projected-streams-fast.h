@@ -25,6 +25,7 @@
 #include "nnet0/nnet-component.h"
 #include "nnet0/nnet-utils.h"
 #include "cudamatrix/cu-math.h"
+#include "matrix/small-gemm.h"
 
 /*************************************
  * x: input neuron
@@ -143,6 +144,7 @@ class GruProjectedStreamsFast : public UpdatableComponent {
     w_p_m_.Read(is, binary);
     bias_r_.Read(is, binary);
     bias_zc_.Read(is, binary);
+    ClearPackedWeights();
 
     // init delta buffers
     w_r_x_corr_.Resize(nrecur_, input_dim_, kSetZero);
@@ -320,6 +322,21 @@ class GruProjectedStreamsFast : public UpdatableComponent {
     YR.RowRange(1*S,T*S).AddVecToRows(1.0, bias_r_);
     YZC.RowRange(1*S,T*S).AddVecToRows(1.0, bias_zc_);
 
+    // On the CPU, with few streams, the recurrent products are done by
+    // SmallGemm(), with the weights packed once; BLAS is slow for products
+    // with so few rows (see UnitTestSmallGemmSpeed() in
+    // matrix-lib-speed-test.cc; past 16 rows the gain is within the noise).
+    bool small_gemm = (S <= 16);
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled()) small_gemm = false;
+#endif
+    if (small_gemm && packed_w_r_r_.IsEmpty()) {
+      packed_w_r_r_.Pack(w_r_r_.Mat());
+      packed_w_z_r_.Pack(w_z_r_.Mat());
+      packed_w_c_r_.Pack(w_c_r_.Mat());
+      packed_w_p_m_.Pack(w_p_m_.Mat());
+    }
+
     for (int t = 1; t <= T; t++) {
       // multistream buffers for current time-step
       CuSubMatrix<BaseFloat> y_r(YR.RowRange(t*S,S));
@@ -330,22 +347,36 @@ class GruProjectedStreamsFast : public UpdatableComponent {
 
       CuSubMatrix<BaseFloat> y_rp(YRP_.RowRange(t*S,S));
       // p(t-1) -> r(t)
-      y_r.AddMatMat(1.0, YP.RowRange((t-1)*S,S), kNoTrans, w_r_r_, kTrans,  1.0);
+      if (small_gemm)
+        SmallGemm<BaseFloat>(1.0, YP.RowRange((t-1)*S,S).Mat(), packed_w_r_r_,
+                             1.0, &y_r.Mat());
+      else
+        y_r.AddMatMat(1.0, YP.RowRange((t-1)*S,S), kNoTrans, w_r_r_, kTrans,  1.0);
       y_r.Sigmoid(y_r);
       // p(t-1) -> z(t)
-      y_z.AddMatMat(1.0, YP.RowRange((t-1)*S,S), kNoTrans, w_z_r_, kTrans,  1.0);
+      if (small_gemm)
+        SmallGemm<BaseFloat>(1.0, YP.RowRange((t-1)*S,S).Mat(), packed_w_z_r_,
+                             1.0, &y_z.Mat());
+      else
+        y_z.AddMatMat(1.0, YP.RowRange((t-1)*S,S), kNoTrans, w_z_r_, kTrans,  1.0);
       y_z.Sigmoid(y_z);
       // r(t),p(t-1) -> rp(t)
       y_rp.AddMatMatElements(1.0, y_r, YP.RowRange((t-1)*S, S), 0.0);
       //rp -> c
-      y_c.AddMatMat(1.0, y_rp, kNoTrans, w_c_r_, kTrans, 1.0);
+      if (small_gemm)
+        SmallGemm<BaseFloat>(1.0, y_rp.Mat(), packed_w_c_r_, 1.0, &y_c.Mat());
+      else
+        y_c.AddMatMat(1.0, y_rp, kNoTrans, w_c_r_, kTrans, 1.0);
       y_c.Tanh(y_c);
 
       y_h.AddMatMatElements(1.0, y_z, YH.RowRange((t-1)*S, S), 0.0);
       y_h.AddMatMatElements( -1.0, y_z, y_c, 1.0 );
       y_h.AddMat(1.0, y_c) ;
       //h->p
-      y_p.AddMatMat(1.0, y_h, kNoTrans, w_p_m_, kTrans, 0.0);
+      if (small_gemm)
+        SmallGemm<BaseFloat>(1.0, y_h.Mat(), packed_w_p_m_, 0.0, &y_p.Mat());
+      else
+        y_p.AddMatMat(1.0, y_h, kNoTrans, w_p_m_, kTrans, 0.0);
       if (DEBUG) {
         std::cerr << "forward-pass frame " << t << "\n";
         std::cerr << "activation of r: " << y_r;
@@ -545,6 +576,7 @@ class GruProjectedStreamsFast : public UpdatableComponent {
              w_p_m_.AddMat(-lr*l2*num_frames, w_p_m_);
 		 	//bias_.AddVec(-lr*l2*num_frames, bias_);
 		 }
+		 ClearPackedWeights();
 
   }
 
@@ -561,6 +593,7 @@ class GruProjectedStreamsFast : public UpdatableComponent {
         w_p_m_.AddMat(-lr, w_p_m_corr_);
         bias_r_.AddVec(-lr_bias, bias_r_corr_, 1.0);
         bias_zc_.AddVec(-lr_bias, bias_zc_corr_, 1.0);
+        ClearPackedWeights();
   }
 
   void Update(const CuMatrixBase<BaseFloat> &input, const CuMatrixBase<BaseFloat> &diff) {
@@ -574,10 +607,18 @@ class GruProjectedStreamsFast : public UpdatableComponent {
     w_p_m_.AddMat(-lr, w_p_m_corr_);
     bias_r_.AddVec(-lr, bias_r_corr_, 1.0);
     bias_zc_.AddVec(-lr, bias_zc_corr_, 1.0);
+    ClearPackedWeights();
 
   }
 
  private:
+  void ClearPackedWeights() {
+    packed_w_r_r_.Clear();
+    packed_w_z_r_.Clear();
+    packed_w_c_r_.Clear();
+    packed_w_p_m_.Clear();
+  }
+
   // dims
   int32 ncell_;
   int32 nrecur_;  ///< recurrent projection layer dim
@@ -615,6 +656,13 @@ class GruProjectedStreamsFast : public UpdatableComponent {
   CuMatrix<BaseFloat> w_p_m_;
   CuMatrix<BaseFloat> w_p_m_corr_;
 
+  // The recurrent weights packed for SmallGemm(), for the forward pass on the
+  // CPU; packed when first needed, and cleared when the weights change.
+  SmallGemmWeights<BaseFloat> packed_w_r_r_;
+  SmallGemmWeights<BaseFloat> packed_w_z_r_;
+  SmallGemmWeights<BaseFloat> packed_w_c_r_;
+  SmallGemmWeights<BaseFloat> packed_w_p_m_;
+
   // biases of [g, i, f, o]
   CuVector<BaseFloat> bias_r_;
   CuVector<BaseFloat> bias_r_corr_;
@@ -29,6 +29,7 @@
 #include <sstream>
 #include <iterator>
 #include <algorithm>
+#include <limits>
 #include <iomanip>
 
 #include <mpi.h>
@@ -1269,10 +1270,40 @@ void Ctc::Eval(const CuMatrixBase<BaseFloat> &net_out, const std::vector<int32>
 
   }else
 #endif
-	{
-		// not implemented for CPU yet
-		// return 0;
-	}
+  {
+    std::vector<int32> frame_num_utt(1, net_out.NumRows());
+    std::vector< std::vector<int32> > labels(1, label);
+    Vector<BaseFloat> pzx;
+    diff->Resize(net_out.NumRows(), net_out.NumCols(), kUndefined);
+    cpu_ctc_.Compute(frame_num_utt, net_out.Mat(), labels, &diff->Mat(), &pzx);
+
+    // update registries, a sequence that cannot be aligned has no gradient
+    // and is left out of the objective.
+    if (pzx(0) == -std::numeric_limits<BaseFloat>::infinity()) {
+      num_dropped_++;
+    } else {
+      obj_progress_ += pzx(0);
+      obj_total_ += pzx(0);
+      sequences_progress_ += 1;
+      sequences_num_ += 1;
+      frames_progress_ += net_out.NumRows();
+      frames_ += net_out.NumRows();
+    }
+
+    // progressive reporting
+    if (sequences_progress_ > report_step_) {
+      KALDI_VLOG(1) << "After " << sequences_num_ << " sequences (" << frames_/(100.0 * 3600) << "Hr): "
+                    << "Obj(log[Pzx]) = " << obj_progress_/sequences_progress_
+                    << "   TokenAcc = " << 100.0*(1.0 - error_num_progress_/ref_num_progress_) << "%"
+                    << "  Dropped = " << num_dropped_;
+      // reset
+      sequences_progress_ = 0;
+      frames_progress_ = 0;
+      obj_progress_ = 0.0;
+      error_num_progress_ = 0;
+      ref_num_progress_ = 0;
+    }
+  }
 
 }
 
@@ -1387,8 +1418,46 @@ void Ctc::EvalParallel(const std::vector<int32> &frame_num_utt, const CuMatrixBa
   }else
 #endif
   {
-     // not implemented for CPU yet
-     // return 0;
+    int32 num_sequence = frame_num_utt.size();
+    Vector<BaseFloat> pzx;
+    diff->Resize(net_out.NumRows(), net_out.NumCols(), kUndefined);
+    // the softmax backprop is fused in, diff already is y - gamma.
+    cpu_ctc_.Compute(frame_num_utt, net_out.Mat(), label, &diff->Mat(), &pzx);
+
+    // Clip gradient
+    diff->ApplyFloor(-1.0);
+    diff->ApplyCeiling(1.0);
+
+    // update registries, sequences that cannot be aligned have no gradient
+    // and are left out of the objective.
+    for (int32 s = 0; s < num_sequence; s++) {
+      if (pzx(s) == -std::numeric_limits<BaseFloat>::infinity()) {
+        num_dropped_++;
+        continue;
+      }
+      obj_progress_ += pzx(s);
+      obj_total_ += pzx(s);
+      sequences_progress_ += 1;
+      sequences_num_ += 1;
+      frames_progress_ += frame_num_utt[s];
+      frames_ += frame_num_utt[s];
+    }
+    if (ppzx != NULL)
+      ppzx->Swap(&pzx);
+
+    // progressive reporting
+    if (sequences_progress_ > report_step_) {
+      KALDI_VLOG(1) << "After " << sequences_num_ << " sequences (" << frames_/(100.0 * 3600) << "Hr): "
+                    << "Obj(log[Pzx]) = " << obj_progress_/sequences_progress_
+                    << "  TokenAcc = " << 100.0*(1.0 - error_num_progress_/ref_num_progress_) << "%"
+                    << "  Dropped = " << num_dropped_;
+      // reset
+      sequences_progress_ = 0;
+      frames_progress_ = 0;
+      obj_progress_ = 0.0;
+      error_num_progress_ = 0;
+      ref_num_progress_ = 0;
+    }
   }
 
 }
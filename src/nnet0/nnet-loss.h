@@ -31,6 +31,7 @@
 //#include "warp-transducer/include/rnnt.h"
 #include "add_network/include/rnnt.h"
 #include "nnet0/nnet-kernels-ansi.h"
+#include "nnet0/nnet-ctc-cpu.h"
 
 namespace kaldi {
 namespace nnet0 {
@@ -449,6 +450,9 @@ protected:
 
 class Ctc : public CtcItf {
  public:
+  /// 'num_threads' is the number of threads of the CPU implementation,
+  /// which is used when no GPU is selected.
+  explicit Ctc(int32 num_threads = 1) : cpu_ctc_(num_threads) { }
 
   /// CTC training over a single sequence from the labels. The errors are returned to [diff]
   void Eval(const CuMatrixBase<BaseFloat> &net_out, const std::vector<int32> &label, CuMatrix<BaseFloat> *diff);
@@ -462,6 +466,7 @@ class Ctc : public CtcItf {
   CuMatrix<BaseFloat> alpha_;        // alpha values
   CuMatrix<BaseFloat> beta_;         // beta values
   CuMatrix<BaseFloat> ctc_err_;      // ctc errors
+  CtcCpuComputer cpu_ctc_;           // CPU implementation
 };
 
 
@@ -26,6 +26,7 @@
 #include "nnet0/nnet-component.h"
 #include "nnet0/nnet-utils.h"
 #include "cudamatrix/cu-math.h"
+#include "matrix/small-gemm.h"
 
 /*************************************
  * x: input neuron
@@ -184,6 +185,7 @@ class LstmProjectedStreamsFast : public UpdatableComponent {
     peephole_o_c_.Read(is, binary);
 
     w_r_m_.Read(is, binary);
+    ClearPackedWeights();
 
     // init delta buffers
     w_gifo_x_corr_.Resize(4*ncell_, input_dim_, kSetZero);
@@ -477,7 +479,29 @@ class LstmProjectedStreamsFast : public UpdatableComponent {
     // bias -> g, i, f, o
     YGIFO->RowRange(1*S,T*S).AddVecToRows(1.0, bias_);
 
+    // On the CPU, with few streams, each time step is done by
+    // LstmProjectedStep(), with the recurrent weights packed once; BLAS is
+    // slow for products with so few rows.  UnitTestLstmProjectedStepSpeed()
+    // in matrix-lib-speed-test.cc shows the gain up to 16 streams; past that
+    // it is within the noise.
+    bool small_gemm = (S <= 16);
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled()) small_gemm = false;
+#endif
+    if (small_gemm && packed_w_gifo_r_.IsEmpty()) {
+      packed_w_gifo_r_.Pack(w_gifo_r_.Mat());
+      packed_w_r_m_.Pack(w_r_m_.Mat());
+    }
+
     for (int t = 1; t <= T; t++) {
+      if (small_gemm) {
+        CuSubMatrix<BaseFloat> cur(propagate_buf_.RowRange(t*S, S));
+        LstmProjectedStep(packed_w_gifo_r_, packed_w_r_m_, peephole_i_c_.Vec(),
+                          peephole_f_c_.Vec(), peephole_o_c_.Vec(), clip_cell_,
+                          propagate_buf_.RowRange((t-1)*S, S).Mat(),
+                          &cur.Mat());
+        continue;
+      }
 
       // r(t-1) -> g, i, f, o
       y_gifo[t]->AddMatMat(1.0, *y_r[t-1], kNoTrans, w_gifo_r_, kTrans,  1.0);
@@ -781,6 +805,8 @@ class LstmProjectedStreamsFast : public UpdatableComponent {
 
 	    w_r_m_.AddMat(-lr, w_r_m_corr_);
 
+	    ClearPackedWeights();
+
         /*
         if (clip_cell_ > 0.0) {
           w_gifo_x_.ApplyFloor(-clip_cell_);
@@ -981,6 +1007,7 @@ class LstmProjectedStreamsFast : public UpdatableComponent {
     peephole_o_c_.AddVec(-lr, peephole_o_c_corr_, 1.0);
 
     w_r_m_.AddMat(-lr, w_r_m_corr_);
+    ClearPackedWeights();
 
 //    /*
 //      Here we deal with the famous "vanishing & exploding difficulties" in RNN learning.
@@ -1079,6 +1106,12 @@ class LstmProjectedStreamsFast : public UpdatableComponent {
 		*/
   }
 
+ private:
+  void ClearPackedWeights() {
+    packed_w_gifo_r_.Clear();
+    packed_w_r_m_.Clear();
+  }
+
  protected:
   // dims
   int32 ncell_;
@@ -1125,6 +1158,11 @@ class LstmProjectedStreamsFast : public UpdatableComponent {
   CuMatrix<BaseFloat> w_r_m_fix_;
   CuMatrix<BaseFloat> w_r_m_corr_;
 
+  // w_gifo_r_ and w_r_m_ packed for SmallGemm(), for the forward pass on the
+  // CPU; packed when first needed, and cleared when the weights change.
+  SmallGemmWeights<BaseFloat> packed_w_gifo_r_;
+  SmallGemmWeights<BaseFloat> packed_w_r_m_;
+
   // propagate buffer: output of [g, i, f, o, c, h, m, r]
   CuMatrix<BaseFloat> propagate_buf_;
 
@@ -63,6 +63,48 @@ int ModelMergeFunction:: MergeStatus(int status)
 	return	total_status;
 }
 
+// The global buffers are page-locked host memory, and are only allocated when
+// training on GPUs; an empty vector stands for a missing buffer.
+static void WriteGlobalBuffer(std::ostream &os, bool binary, const BaseFloat *data, int32 dim)
+{
+	if (data == NULL)
+		Vector<BaseFloat>().Write(os, binary);
+	else
+		SubVector<BaseFloat>(const_cast<BaseFloat*>(data), dim).Write(os, binary);
+}
+
+static void ReadGlobalBuffer(std::istream &is, bool binary, BaseFloat *data, int32 dim)
+{
+	Vector<BaseFloat> buffer;
+	buffer.Read(is, binary);
+	if (buffer.Dim() == 0)
+		return;
+	if (data == NULL || buffer.Dim() != dim)
+		KALDI_ERR << "Merge state of dimension " << buffer.Dim()
+				  << " does not match the model dimension " << dim;
+	std::memcpy(data, buffer.Data(), dim * sizeof(BaseFloat));
+}
+
+void ModelMergeFunction::WriteState(std::ostream &os, bool binary) const
+{
+	WriteToken(os, binary, "<LeftMerge>");
+	WriteBasicType(os, binary, mLeftMerge);
+	WriteToken(os, binary, "<CurrentSamples>");
+	WriteBasicType(os, binary, mCurrentSamples);
+	WriteToken(os, binary, "<IsLastMerge>");
+	WriteBasicType(os, binary, misLastMerge);
+}
+
+void ModelMergeFunction::ReadState(std::istream &is, bool binary)
+{
+	ExpectToken(is, binary, "<LeftMerge>");
+	ReadBasicType(is, binary, &mLeftMerge);
+	ExpectToken(is, binary, "<CurrentSamples>");
+	ReadBasicType(is, binary, &mCurrentSamples);
+	ExpectToken(is, binary, "<IsLastMerge>");
+	ReadBasicType(is, binary, &misLastMerge);
+}
+
 /**
  * Model average.
  */
@@ -189,6 +231,24 @@ void ModelGlobalSumMerge::Merge(int root)
 
 }
 
+void ModelGlobalSumMerge::WriteState(std::ostream &os, bool binary) const
+{
+	ModelMergeFunction::WriteState(os, binary);
+	WriteToken(os, binary, "<LearningRate>");
+	WriteBasicType(os, binary, mLearningRate);
+	WriteToken(os, binary, "<GlobalModel>");
+	WriteGlobalBuffer(os, binary, nnet_data_, dim_);
+}
+
+void ModelGlobalSumMerge::ReadState(std::istream &is, bool binary)
+{
+	ModelMergeFunction::ReadState(is, binary);
+	ExpectToken(is, binary, "<LearningRate>");
+	ReadBasicType(is, binary, &mLearningRate);
+	ExpectToken(is, binary, "<GlobalModel>");
+	ReadGlobalBuffer(is, binary, nnet_data_, dim_);
+}
+
 /**
  * Model global gradient sum merge.
  */
@@ -305,6 +365,33 @@ void ModelGlobalGradientMerge::Merge(int root)
 }
 
 
+void ModelGlobalGradientMerge::WriteState(std::ostream &os, bool binary) const
+{
+	ModelMergeFunction::WriteState(os, binary);
+	WriteToken(os, binary, "<LearningRate>");
+	WriteBasicType(os, binary, mLearningRate);
+	WriteToken(os, binary, "<Momentum>");
+	WriteBasicType(os, binary, mmt);
+	WriteToken(os, binary, "<GlobalModel>");
+	WriteGlobalBuffer(os, binary, nnet_data_, dim_);
+	// delta(t-1), only meaningful on the root.
+	WriteToken(os, binary, "<GlobalDelta>");
+	WriteGlobalBuffer(os, binary, gradient_data_, dim_);
+}
+
+void ModelGlobalGradientMerge::ReadState(std::istream &is, bool binary)
+{
+	ModelMergeFunction::ReadState(is, binary);
+	ExpectToken(is, binary, "<LearningRate>");
+	ReadBasicType(is, binary, &mLearningRate);
+	ExpectToken(is, binary, "<Momentum>");
+	ReadBasicType(is, binary, &mmt);
+	ExpectToken(is, binary, "<GlobalModel>");
+	ReadGlobalBuffer(is, binary, nnet_data_, dim_);
+	ExpectToken(is, binary, "<GlobalDelta>");
+	ReadGlobalBuffer(is, binary, gradient_data_, dim_);
+}
+
 /**
  * Model global adagrad merge.
  */
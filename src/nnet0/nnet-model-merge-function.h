@@ -86,6 +86,12 @@ public:
 		 return misLastMerge;
 	 }
 
+	 /// Write/read the state needed to continue merging after a restart
+	 /// from a checkpoint, i.e. the merge counters and any global model or
+	 /// momentum kept by the merge function.
+	 virtual void WriteState(std::ostream &os, bool binary) const;
+	 virtual void ReadState(std::istream &is, bool binary);
+
 protected:
 	 int mLeftMerge;
 	 int mCurrentSamples;
@@ -150,6 +156,9 @@ public:
 		 	mLearningRate = lrate;
 		 }
 
+		 virtual void WriteState(std::ostream &os, bool binary) const;
+		 virtual void ReadState(std::istream &is, bool binary);
+
 protected:
 		 void Init();
 
@@ -191,6 +200,9 @@ public:
 		 	mLearningRate = lrate;
 		 }
 
+		 virtual void WriteState(std::ostream &os, bool binary) const;
+		 virtual void ReadState(std::istream &is, bool binary);
+
 protected:
 		 void Init();
 
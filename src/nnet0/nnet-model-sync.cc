@@ -71,8 +71,14 @@ void NnetModelSync::MultiMachineInit() {
 }
 
 void NnetModelSync::InitMergeFunction() {
-	if (opts_->num_procs > 1 && NULL == p_merge_func_)
+	if (opts_->num_procs > 1 && NULL == p_merge_func_) {
 		p_merge_func_ = ModelMergeFunction::Factory(opts_, this);
+		if (merge_state_ != "") {
+			std::istringstream is(merge_state_);
+			p_merge_func_->ReadState(is, true);
+			merge_state_ = "";
+		}
+	}
 }
 
 void NnetModelSync::Destory() {
@@ -134,6 +134,12 @@ public:
 		return p_merge_func_;
 	}
 
+	/// Merge-function state from a checkpoint, restored when the merge
+	/// function is created in Initialize().
+	void SetMergeState(const std::string &merge_state) {
+		merge_state_ = merge_state;
+	}
+
 	void MultiMachineInit();
 
     void ResetGradient() {
@@ -181,6 +187,7 @@ private:
 	Nnet *nnet;
 	const NnetParallelOptions *opts_;
 	ModelMergeFunction *p_merge_func_;
+	std::string merge_state_;
 
 public:
 
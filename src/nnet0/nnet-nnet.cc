@@ -54,7 +54,7 @@ namespace kaldi {
 namespace nnet0 {
 
 
-Nnet::Nnet(const Nnet& other) {
+Nnet::Nnet(const Nnet& other): profiler_(NULL) {
   // copy the components
   for(int32 i = 0; i < other.NumComponents(); i++) {
     components_.push_back(other.GetComponent(i).Copy());
@@ -107,7 +107,10 @@ void Nnet::Propagate(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat>
   propagate_buf_[0].CopyFromMat(in);
 
   for(int32 i=0; i<(int32)components_.size(); i++) {
+    if (profiler_ != NULL) profiler_->Begin();
     components_[i]->Propagate(propagate_buf_[i], &propagate_buf_[i+1]);
+    if (profiler_ != NULL)
+      profiler_->End(i, *components_[i], NnetProfiler::kPropagate, propagate_buf_[i].NumRows());
   }
   
   // (*out) = propagate_buf_[components_.size()];
@@ -173,13 +176,24 @@ void Nnet::Backpropagate(const CuMatrixBase<BaseFloat> &out_diff, CuMatrixBase<B
   backpropagate_buf_[NumComponents()].CopyFromMat(out_diff);
   // backpropagate using buffers
   for (int32 i = NumComponents()-1; i >= 0; i--) {
+    int32 num_rows = propagate_buf_[i].NumRows();
+    if (profiler_ != NULL) profiler_->Begin();
     components_[i]->Backpropagate(propagate_buf_[i], propagate_buf_[i+1],
                             backpropagate_buf_[i+1], &backpropagate_buf_[i]);
+    if (profiler_ != NULL)
+      profiler_->End(i, *components_[i], NnetProfiler::kBackpropagate, num_rows);
 
     if (components_[i]->IsUpdatable() && update) {
         UpdatableComponent *uc = dynamic_cast<UpdatableComponent*>(components_[i]);
+        if (profiler_ != NULL) profiler_->Begin();
         uc->Gradient(propagate_buf_[i], backpropagate_buf_[i+1]);
+        if (profiler_ != NULL) {
+          profiler_->End(i, *uc, NnetProfiler::kGradient, num_rows);
+          profiler_->Begin();
+        }
         uc->UpdateGradient();
+        if (profiler_ != NULL)
+          profiler_->End(i, *uc, NnetProfiler::kUpdate, num_rows);
         //uc->Update(propagate_buf_[i], backpropagate_buf_[i+1]);
     }
   }
@@ -211,7 +225,10 @@ void Nnet::Gradient() {
 	for (int32 i = NumComponents()-1; i >= 0; i--) {
 		if (components_[i]->IsUpdatable()) {
 			UpdatableComponent *uc = dynamic_cast<UpdatableComponent*>(components_[i]);
+			if (profiler_ != NULL) profiler_->Begin();
 			uc->Gradient(propagate_buf_[i], backpropagate_buf_[i+1]);
+			if (profiler_ != NULL)
+				profiler_->End(i, *uc, NnetProfiler::kGradient, propagate_buf_[i].NumRows());
 		}
 	}
 }
@@ -220,7 +237,10 @@ void Nnet::UpdateGradient() {
 	for (int32 i = NumComponents()-1; i >= 0; i--) {
 		if (components_[i]->IsUpdatable()) {
 			UpdatableComponent *uc = dynamic_cast<UpdatableComponent*>(components_[i]);
+			if (profiler_ != NULL) profiler_->Begin();
 			uc->UpdateGradient();
+			if (profiler_ != NULL)
+				profiler_->End(i, *uc, NnetProfiler::kUpdate, propagate_buf_[i].NumRows());
 		}
 	}
 }
@@ -235,7 +255,10 @@ void Nnet::Update() {
 	  for (int32 i = NumComponents()-1; i >= 0; i--) {
 	    if (components_[i]->IsUpdatable()) {
 	      UpdatableComponent *uc = dynamic_cast<UpdatableComponent*>(components_[i]);
+	      if (profiler_ != NULL) profiler_->Begin();
 	      uc->Update(propagate_buf_[i], backpropagate_buf_[i+1]);
+	      if (profiler_ != NULL)
+	        profiler_->End(i, *uc, NnetProfiler::kUpdate, propagate_buf_[i].NumRows());
 	    }
 	  }
 
@@ -379,7 +402,8 @@ void Nnet::GetWeights(Vector<BaseFloat>* wei_copy) const {
   for(int32 n=0; n<components_.size(); n++) {
     if(components_[n]->IsUpdatable()) {
       switch(components_[n]->GetType()) {
-        case Component::kAffineTransform : {
+        case Component::kAffineTransform :
+        case Component::kSparseAffineTransform : {
           // copy weight matrix row-by-row to the vector
           Matrix<BaseFloat> mat(dynamic_cast<AffineTransform*>(components_[n])->GetLinearity());
           int32 mat_size = mat.NumRows()*mat.NumCols();
@@ -407,7 +431,8 @@ void Nnet::SetWeights(const Vector<BaseFloat>& wei_src) {
   for(int32 n=0; n<components_.size(); n++) {
     if(components_[n]->IsUpdatable()) {
       switch(components_[n]->GetType()) {
-        case Component::kAffineTransform : {
+        case Component::kAffineTransform :
+        case Component::kSparseAffineTransform : {
           // get the component
           AffineTransform* aff_t = dynamic_cast<AffineTransform*>(components_[n]);
           // we need weight matrix with original dimensions
@@ -441,7 +466,8 @@ void Nnet::GetGradient(Vector<BaseFloat>* grad_copy) const {
   for(int32 n=0; n<components_.size(); n++) {
     if(components_[n]->IsUpdatable()) {
       switch(components_[n]->GetType()) {
-        case Component::kAffineTransform : {
+        case Component::kAffineTransform :
+        case Component::kSparseAffineTransform : {
           // get the weights from CuMatrix to Matrix
           const CuMatrixBase<BaseFloat>& cu_mat = 
             dynamic_cast<AffineTransform*>(components_[n])->GetLinearityCorr();
@@ -685,8 +711,10 @@ void Nnet::SplitLstmLm(Matrix<BaseFloat> &out_linearity, Vector<BaseFloat> &out_
 	int32 c, tag;
 	AffineTransform  *affine = NULL;
 	for (c = this->NumComponents()-1; c>=0; c--) {
-		if (this->GetComponent(c).GetType() == Component::kAffineTransform) {
-			// output class affine layer
+		Component::ComponentType type = this->GetComponent(c).GetType();
+		if (type == Component::kAffineTransform ||
+			type == Component::kSparseAffineTransform) {
+			// output affine layer, pruned or not
 			affine = &(dynamic_cast<AffineTransform&>(this->GetComponent(c)));
             tag = c;
 			break;
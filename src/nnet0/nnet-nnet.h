@@ -29,6 +29,7 @@
 #include "matrix/matrix-lib.h"
 #include "nnet0/nnet-trnopts.h"
 #include "nnet0/nnet-component.h"
+#include "nnet0/nnet-profiler.h"
 
 namespace kaldi {
 
@@ -44,7 +45,7 @@ class Nnet {
     friend class lm::LmModelSync;
 
  public:
-  Nnet() {}
+  Nnet(): profiler_(NULL) {}
   Nnet(const Nnet& other);  // Copy constructor.
   Nnet &operator = (const Nnet& other); // Assignment operator.
 
@@ -187,6 +188,11 @@ class Nnet {
   /// For FSMN component
   void SetFlags(const Vector<BaseFloat> &flags);
 
+  /// Time every component with 'profiler' (not owned, NULL disables it),
+  /// it is not copied with the network.
+  void SetProfiler(NnetProfiler *profiler) { profiler_ = profiler; }
+  NnetProfiler *GetProfiler() const { return profiler_; }
+
  private:
   /// Vector which contains all the components composing the neural network,
   /// the components are for example: AffineTransform, Sigmoid, Softmax
@@ -197,6 +203,8 @@ class Nnet {
 
   /// Option class with hyper-parameters passed to UpdatableComponent(s)
   NnetTrainOptions opts_;
+
+  NnetProfiler *profiler_;
 };
 
 }  // namespace nnet0
@@ -0,0 +1,111 @@
+// nnet0/nnet-profiler-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include "nnet0/nnet-nnet.h"
+#include "nnet0/nnet-affine-transform.h"
+#include "nnet0/nnet-activation.h"
+#include "nnet0/nnet-profiler.h"
+
+using namespace kaldi;
+using namespace kaldi::nnet0;
+
+// affine 10 -> 8, sigmoid, affine 8 -> 4
+static void InitNnet(Nnet *nnet) {
+	nnet->AppendComponent(new AffineTransform(10, 8));
+	nnet->AppendComponent(new Sigmoid(8, 8));
+	nnet->AppendComponent(new AffineTransform(8, 4));
+	for (int32 c = 0; c < nnet->NumComponents(); c += 2) {
+		AffineTransform &affine = dynamic_cast<AffineTransform&>(nnet->GetComponent(c));
+		Matrix<BaseFloat> linearity(affine.OutputDim(), affine.InputDim());
+		linearity.SetRandn();
+		affine.SetLinearity(CuMatrix<BaseFloat>(linearity));
+	}
+	NnetTrainOptions opts;
+	opts.learn_rate = 0.01;
+	nnet->SetTrainOptions(opts);
+}
+
+void UnitTestNnetProfiler() {
+	Nnet nnet;
+	InitNnet(&nnet);
+	NnetProfiler profiler;
+	KALDI_ASSERT(profiler.Empty());
+	nnet.SetProfiler(&profiler);
+
+	int32 num_rows = 16, num_iter = 3;
+	CuMatrix<BaseFloat> in(num_rows, 10), out, out_diff(num_rows, 4), in_diff;
+	in.SetRandn();
+	out_diff.SetRandn();
+	for (int32 i = 0; i < num_iter; i++) {
+		nnet.Propagate(in, &out);
+		nnet.Backpropagate(out_diff, &in_diff, true);
+	}
+
+	for (int32 c = 0; c < 3; c++) {
+		KALDI_ASSERT(profiler.NumCalls(c, NnetProfiler::kPropagate) == num_iter);
+		KALDI_ASSERT(profiler.NumCalls(c, NnetProfiler::kBackpropagate) == num_iter);
+	}
+	// the sigmoid has nothing to update.
+	KALDI_ASSERT(profiler.NumCalls(0, NnetProfiler::kGradient) == num_iter);
+	KALDI_ASSERT(profiler.NumCalls(2, NnetProfiler::kUpdate) == num_iter);
+	KALDI_ASSERT(profiler.NumCalls(1, NnetProfiler::kGradient) == 0);
+	// a GEMM over the weights and the bias per frame.
+	KALDI_ASSERT(profiler.Flops(0, NnetProfiler::kPropagate) ==
+				 num_iter * 2.0 * num_rows * (10 * 8 + 8));
+
+	// copies of the network are not profiled.
+	Nnet copy(nnet);
+	KALDI_ASSERT(copy.GetProfiler() == NULL);
+
+	profiler.AddMerge(0.5, 1000.0);
+	NnetProfiler sum;
+	sum.Add(profiler);
+	sum.Add(profiler);
+	KALDI_ASSERT(sum.NumCalls(1, NnetProfiler::kBackpropagate) == 2 * num_iter);
+	KALDI_ASSERT(ApproxEqual(sum.TotalSeconds(), 2.0 * profiler.TotalSeconds()));
+
+	std::string report = sum.Report();
+	KALDI_LOG << report;
+	KALDI_ASSERT(report.find("<Sigmoid> propagate") != std::string::npos);
+	KALDI_ASSERT(report.find("model merge") != std::string::npos);
+	// the merge is the most expensive entry, it comes first.
+	KALDI_ASSERT(report.find("model merge") < report.find("component"));
+
+	std::ostringstream json;
+	sum.WriteJson(json);
+	KALDI_ASSERT(json.str().find("\"phase\": \"gradient\"") != std::string::npos);
+	KALDI_ASSERT(json.str().find("\"merge\": {\"calls\": 2") != std::string::npos);
+}
+
+int main() {
+	for (int32 loop = 0; loop < 2; loop++) {
+#if HAVE_CUDA == 1
+		if (loop == 0)
+			CuDevice::Instantiate().SelectGpuId("no"); // use no GPU
+		else
+			CuDevice::Instantiate().SelectGpuId("optional"); // use GPU when available
+#endif
+		UnitTestNnetProfiler();
+		if (loop == 0)
+			KALDI_LOG << "Tests without GPU use succeeded.";
+		else
+			KALDI_LOG << "Tests with GPU use (if available) succeeded.";
+	}
+	return 0;
+}
@@ -0,0 +1,213 @@
+// nnet0/nnet-profiler.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include "cudamatrix/cu-device.h"
+#include "util/kaldi-io.h"
+#include "nnet0/nnet-profiler.h"
+
+namespace kaldi {
+namespace nnet0 {
+
+const char *NnetProfiler::PhaseName(Phase phase) {
+	switch (phase) {
+		case kPropagate: return "propagate";
+		case kBackpropagate: return "backprop";
+		case kGradient: return "gradient";
+		case kUpdate: return "update";
+		default: KALDI_ERR << "Unknown phase " << phase;
+	}
+	return "";
+}
+
+void NnetProfiler::Begin() {
+	// don't charge this component for kernels that are still running.
+	SynchronizeGpu();
+	timer_.Reset();
+}
+
+void NnetProfiler::End(int32 c, const Component &comp, Phase phase, int32 num_rows) {
+	SynchronizeGpu();
+	double seconds = timer_.Elapsed();
+
+	KALDI_ASSERT(c >= 0);
+	size_t size = (c + 1) * kNumPhases;
+	if (entries_.size() < size)
+		entries_.resize(size);
+	Entry &e = entries_[c * kNumPhases + phase];
+	if (e.type == "")
+		e.type = Component::TypeToMarker(comp.GetType());
+
+	double rows = num_rows, in = rows * comp.InputDim(), out = rows * comp.OutputDim(),
+		params = 0.0, flops = 0.0, values = 0.0;
+	if (comp.IsUpdatable())
+		params = dynamic_cast<const UpdatableComponent&>(comp).NumParams();
+
+	switch (phase) {
+		case kPropagate:
+			flops = (params > 0.0 ? 2.0 * rows * params : std::max(in, out));
+			values = in + out + params;
+			break;
+		case kBackpropagate:
+			// in, out, out_diff -> in_diff
+			flops = (params > 0.0 ? 2.0 * rows * params : in + out);
+			values = 2.0 * (in + out) + params;
+			break;
+		case kGradient:
+			flops = 2.0 * rows * params;
+			values = in + out + params;
+			break;
+		case kUpdate:
+			// gradient, momentum and weights
+			flops = 2.0 * params;
+			values = 3.0 * params;
+			break;
+		default:
+			KALDI_ERR << "Unknown phase " << phase;
+	}
+
+	e.calls++;
+	e.seconds += seconds;
+	e.flops += flops;
+	e.bytes += values * sizeof(BaseFloat);
+}
+
+void NnetProfiler::AddMerge(double seconds, double bytes) {
+	merge_calls_++;
+	merge_seconds_ += seconds;
+	merge_bytes_ += bytes;
+}
+
+void NnetProfiler::Add(const NnetProfiler &other) {
+	if (entries_.size() < other.entries_.size())
+		entries_.resize(other.entries_.size());
+	for (size_t i = 0; i < other.entries_.size(); i++) {
+		const Entry &o = other.entries_[i];
+		Entry &e = entries_[i];
+		if (e.type == "")
+			e.type = o.type;
+		e.calls += o.calls;
+		e.seconds += o.seconds;
+		e.flops += o.flops;
+		e.bytes += o.bytes;
+	}
+	merge_calls_ += other.merge_calls_;
+	merge_seconds_ += other.merge_seconds_;
+	merge_bytes_ += other.merge_bytes_;
+}
+
+int64 NnetProfiler::NumCalls(int32 c, Phase phase) const {
+	size_t i = c * kNumPhases + phase;
+	return (i < entries_.size() ? entries_[i].calls : 0);
+}
+
+double NnetProfiler::Flops(int32 c, Phase phase) const {
+	size_t i = c * kNumPhases + phase;
+	return (i < entries_.size() ? entries_[i].flops : 0.0);
+}
+
+double NnetProfiler::TotalSeconds() const {
+	double total = merge_seconds_;
+	for (size_t i = 0; i < entries_.size(); i++)
+		total += entries_[i].seconds;
+	return total;
+}
+
+namespace {
+
+struct ProfileLine {
+	std::string name;
+	int64 calls;
+	double seconds, flops, bytes;
+	bool operator < (const ProfileLine &other) const {
+		return seconds > other.seconds;
+	}
+};
+
+} // namespace
+
+std::string NnetProfiler::Report() const {
+	std::vector<ProfileLine> lines;
+	for (size_t i = 0; i < entries_.size(); i++) {
+		const Entry &e = entries_[i];
+		if (e.calls == 0)
+			continue;
+		std::ostringstream name;
+		name << "component " << i / kNumPhases + 1 << " " << e.type << " "
+			 << PhaseName(static_cast<Phase>(i % kNumPhases));
+		ProfileLine line = { name.str(), e.calls, e.seconds, e.flops, e.bytes };
+		lines.push_back(line);
+	}
+	if (merge_calls_ > 0) {
+		ProfileLine line = { "model merge", merge_calls_, merge_seconds_, 0.0, merge_bytes_ };
+		lines.push_back(line);
+	}
+	std::sort(lines.begin(), lines.end());
+
+	double total = TotalSeconds();
+	std::ostringstream os;
+	os << "Nnet profile, " << total << " sec in total:\n";
+	os << std::left << std::setw(50) << "#" << std::right
+	   << std::setw(10) << "calls" << std::setw(12) << "sec"
+	   << std::setw(8) << "%" << std::setw(12) << "GFLOP/s" << std::setw(10) << "GB/s" << "\n";
+	os << std::fixed;
+	for (size_t i = 0; i < lines.size(); i++) {
+		const ProfileLine &l = lines[i];
+		// no rates for entries below the timer resolution.
+		double sec = (l.seconds > 0.0 ? l.seconds : std::numeric_limits<double>::infinity());
+		os << std::left << std::setw(50) << l.name << std::right
+		   << std::setw(10) << l.calls
+		   << std::setw(12) << std::setprecision(3) << l.seconds
+		   << std::setw(8) << std::setprecision(1) << 100.0 * l.seconds / std::max(total, 1.0e-09)
+		   << std::setw(12) << std::setprecision(2) << l.flops / sec * 1.0e-09
+		   << std::setw(10) << std::setprecision(2) << l.bytes / sec * 1.0e-09 << "\n";
+	}
+	return os.str();
+}
+
+void NnetProfiler::WriteJson(std::ostream &os) const {
+	os << "{\n  \"total_seconds\": " << TotalSeconds() << ",\n";
+	os << "  \"components\": [";
+	bool first = true;
+	for (size_t i = 0; i < entries_.size(); i++) {
+		const Entry &e = entries_[i];
+		if (e.calls == 0)
+			continue;
+		os << (first ? "\n" : ",\n");
+		first = false;
+		os << "    {\"component\": " << i / kNumPhases + 1
+		   << ", \"type\": \"" << e.type << "\""
+		   << ", \"phase\": \"" << PhaseName(static_cast<Phase>(i % kNumPhases)) << "\""
+		   << ", \"calls\": " << e.calls << ", \"seconds\": " << e.seconds
+		   << ", \"flops\": " << e.flops << ", \"bytes\": " << e.bytes << "}";
+	}
+	os << "\n  ],\n";
+	os << "  \"merge\": {\"calls\": " << merge_calls_ << ", \"seconds\": " << merge_seconds_
+	   << ", \"bytes\": " << merge_bytes_ << "}\n}\n";
+}
+
+void NnetProfiler::WriteJson(const std::string &filename) const {
+	Output ko(filename, false, false);
+	WriteJson(ko.Stream());
+}
+
+} // namespace nnet0
+} // namespace kaldi
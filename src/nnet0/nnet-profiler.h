@@ -0,0 +1,119 @@
+// nnet0/nnet-profiler.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET_NNET_PROFILER_H_
+#define KALDI_NNET_NNET_PROFILER_H_
+
+#include <string>
+#include <vector>
+
+#include "base/timer.h"
+#include "itf/options-itf.h"
+#include "nnet0/nnet-component.h"
+
+namespace kaldi {
+namespace nnet0 {
+
+struct NnetProfileOptions {
+	bool profile;
+	std::string profile_json;
+
+	NnetProfileOptions(): profile(false), profile_json("") { }
+
+	void Register(OptionsItf *po) {
+		po->Register("profile", &profile, "Time every component in propagate, backprop, gradient and "
+				"update, and the model merges, and print a report at the end (slows the training "
+				"down, the GPU is synchronized around every component)");
+		po->Register("profile-json", &profile_json, "Also write the profile to this file in JSON "
+				"(implies --profile)");
+	}
+
+	bool Enabled() const { return profile || profile_json != ""; }
+};
+
+/**
+ * NnetProfiler accumulates wall time, floating point operations and bytes
+ * moved per component and phase of an Nnet, and per model merge.  The Nnet
+ * calls Begin()/End() around every component once a profiler is set with
+ * Nnet::SetProfiler().  The GPU is synchronized in both, so the time of a
+ * component covers its kernels and not only their launch.
+ *
+ * FLOPs and bytes are estimates from the dimensions: a component with
+ * parameters is counted as GEMMs over all of them (2 * rows * params per
+ * phase), one without as a few elementwise operations per value.  That is
+ * right for affine and recurrent layers and an underestimate for components
+ * that share weights across positions, e.g. convolutions.
+ *
+ * A profiler is not thread-safe, each training thread uses its own and the
+ * results are summed with Add().
+ */
+class NnetProfiler {
+ public:
+	enum Phase {
+		kPropagate = 0,
+		kBackpropagate,
+		kGradient,
+		kUpdate,
+		kNumPhases
+	};
+
+	NnetProfiler(): merge_calls_(0), merge_seconds_(0.0), merge_bytes_(0.0) { }
+
+	/// Starts timing a component.
+	void Begin();
+	/// Stops timing and books the time on component 'c' ('comp') in 'phase',
+	/// 'num_rows' is the number of frames of the minibatch.
+	void End(int32 c, const Component &comp, Phase phase, int32 num_rows);
+
+	/// Books a model merge that exchanged 'bytes' bytes.
+	void AddMerge(double seconds, double bytes);
+
+	/// Adds the statistics of 'other', e.g. of another thread.
+	void Add(const NnetProfiler &other);
+
+	bool Empty() const { return entries_.empty() && merge_calls_ == 0; }
+	int64 NumCalls(int32 c, Phase phase) const;
+	double Flops(int32 c, Phase phase) const;
+	double TotalSeconds() const;
+
+	/// Entries sorted by decreasing time, with their share of the total.
+	std::string Report() const;
+	void WriteJson(std::ostream &os) const;
+	void WriteJson(const std::string &filename) const;
+
+	static const char *PhaseName(Phase phase);
+
+ private:
+	struct Entry {
+		std::string type;  // component marker, empty if not used yet
+		int64 calls;
+		double seconds, flops, bytes;
+		Entry(): calls(0), seconds(0.0), flops(0.0), bytes(0.0) { }
+	};
+
+	// entries_[c * kNumPhases + phase]
+	std::vector<Entry> entries_;
+	Timer timer_;
+
+	int64 merge_calls_;
+	double merge_seconds_, merge_bytes_;
+};
+
+} // namespace nnet0
+} // namespace kaldi
+
+#endif // KALDI_NNET_NNET_PROFILER_H_
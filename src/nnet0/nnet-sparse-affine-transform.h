@@ -0,0 +1,227 @@
+// nnet0/nnet-sparse-affine-transform.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_NNET_NNET_SPARSE_AFFINE_TRANSFORM_H_
+#define KALDI_NNET_NNET_SPARSE_AFFINE_TRANSFORM_H_
+
+
+#include "matrix/block-sparse-matrix.h"
+#include "nnet0/nnet-affine-transform.h"
+
+
+namespace kaldi {
+namespace nnet0 {
+
+/**
+ * An AffineTransform whose weight matrix is pruned by magnitude: it is divided
+ * into blocks of <BlockRows> by <BlockCols> weights, and the fraction
+ * <Sparsity> of the blocks with the smallest L2 norms are zero.
+ *
+ * The weights are stored dense, with a mask of the blocks that are kept, so
+ * training (fine-tuning after pruning), the GPU and the model averaging of
+ * parallel training work as for AffineTransform; the weights of the pruned
+ * blocks stay zero after each update.  On the CPU, the forward pass only
+ * multiplies by the nonzero blocks (see AddMatBlockSparseMatTrans()); blocks
+ * of 8x1 or 4x4 use the vectorized kernels.
+ *
+ * It is initialized from a config line as AffineTransform, with the 3 options
+ * above, or converted from AffineTransform by nnet-sparsify.
+ */
+class SparseAffineTransform : public AffineTransform {
+ public:
+  SparseAffineTransform(int32 dim_in, int32 dim_out)
+    : AffineTransform(dim_in, dim_out),
+      block_rows_(8), block_cols_(1), sparsity_(0.0),
+      num_blocks_(0), num_zero_blocks_(0)
+  { }
+
+  /// Converts a trained AffineTransform, pruning it to "sparsity".
+  SparseAffineTransform(const AffineTransform &orig, int32 block_rows,
+                        int32 block_cols, BaseFloat sparsity)
+    : AffineTransform(orig),
+      block_rows_(block_rows), block_cols_(block_cols), sparsity_(0.0),
+      num_blocks_(0), num_zero_blocks_(0) {
+    if (fix_)
+      KALDI_ERR << "Can't convert a fixed-point AffineTransform to "
+                << "SparseAffineTransform";
+    Prune(sparsity);
+  }
+
+  ~SparseAffineTransform()
+  { }
+
+  Component* Copy() const { return new SparseAffineTransform(*this); }
+  ComponentType GetType() const { return kSparseAffineTransform; }
+
+  void InitData(std::istream &is) {
+    // take out our options, pass the rest to AffineTransform,
+    BaseFloat sparsity = 0.0;
+    std::ostringstream affine_config;
+    std::string token, value;
+    while (!is.eof()) {
+      ReadToken(is, false, &token);
+      /**/ if (token == "<BlockRows>") ReadBasicType(is, false, &block_rows_);
+      else if (token == "<BlockCols>") ReadBasicType(is, false, &block_cols_);
+      else if (token == "<Sparsity>") ReadBasicType(is, false, &sparsity);
+      else {
+        ReadToken(is, false, &value);
+        affine_config << token << " " << value << " ";
+      }
+      is >> std::ws; // eat-up whitespace
+    }
+    std::istringstream affine_is(affine_config.str());
+    affine_is >> std::ws;
+    AffineTransform::InitData(affine_is);
+    // prune the random initialization (the mask is then fixed),
+    Prune(sparsity);
+  }
+
+  void ReadData(std::istream &is, bool binary) {
+    ExpectToken(is, binary, "<BlockRows>");
+    ReadBasicType(is, binary, &block_rows_);
+    ExpectToken(is, binary, "<BlockCols>");
+    ReadBasicType(is, binary, &block_cols_);
+    ExpectToken(is, binary, "<Sparsity>");
+    ReadBasicType(is, binary, &sparsity_);
+    AffineTransform::ReadData(is, binary);
+    if (fix_)
+      KALDI_ERR << "<FixPoint> is not supported by SparseAffineTransform";
+    ComputeMask();
+  }
+
+  void WriteData(std::ostream &os, bool binary) const {
+    WriteToken(os, binary, "<BlockRows>");
+    WriteBasicType(os, binary, block_rows_);
+    WriteToken(os, binary, "<BlockCols>");
+    WriteBasicType(os, binary, block_cols_);
+    WriteToken(os, binary, "<Sparsity>");
+    WriteBasicType(os, binary, sparsity_);
+    AffineTransform::WriteData(os, binary);
+  }
+
+  std::string Info() const {
+    return AffineTransform::Info() +
+           "\n  blocks " + ToString(block_rows_) + "x" + ToString(block_cols_) +
+           ", zero " + ToString(num_zero_blocks_) + " of " +
+           ToString(num_blocks_) + ", target sparsity " + ToString(sparsity_);
+  }
+
+  void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
+    // On the CPU, if at least half of the blocks are zero, only the nonzero
+    // ones are multiplied; they are copied out of linearity_ after each
+    // change of the weights.
+    bool sparse = (2 * num_zero_blocks_ >= num_blocks_);
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled()) sparse = false;
+#endif
+    if (!sparse) {
+      AffineTransform::PropagateFnc(in, out);
+      return;
+    }
+    if (sparse_linearity_.NumRows() == 0)
+      sparse_linearity_.CopyFromMat(linearity_.Mat(), block_rows_, block_cols_);
+    out->AddVecToRows(1.0, bias_, 0.0);
+    AddMatBlockSparseMatTrans<BaseFloat>(1.0, in.Mat(), sparse_linearity_, 1.0,
+                                         &out->Mat());
+    p_input_ = &in;
+  }
+
+  void UpdateGradient() {
+    AffineTransform::UpdateGradient();
+    ApplyMask();
+  }
+
+  void Update(const CuMatrixBase<BaseFloat> &input, const CuMatrixBase<BaseFloat> &diff) {
+    AffineTransform::Update(input, diff);
+    ApplyMask();
+  }
+
+  void SetLinearity(const CuMatrixBase<BaseFloat>& linearity) {
+    AffineTransform::SetLinearity(linearity);
+    ApplyMask();
+  }
+
+  int WeightCopy(void *host, int direction, int copykind) {
+    int ans = AffineTransform::WeightCopy(host, direction, copykind);
+    if (direction != 0) sparse_linearity_.Clear();
+    return ans;
+  }
+
+  /// Zeroes more blocks (those with the smallest L2 norms), so that the
+  /// fraction "sparsity" of them is zero, and fixes the mask to the blocks
+  /// that remain.  Pruning in a few steps, with fine-tuning in between, loses
+  /// less accuracy than pruning at once.
+  void Prune(BaseFloat sparsity) {
+    KALDI_ASSERT(sparsity >= 0.0 && sparsity < 1.0);
+    Matrix<BaseFloat> mat(linearity_);
+    PruneBlocks(sparsity, block_rows_, block_cols_, &mat);
+    linearity_.CopyFromMat(mat);
+    sparsity_ = sparsity;
+    ComputeMask();
+  }
+
+  int32 BlockRows() const { return block_rows_; }
+  int32 BlockCols() const { return block_cols_; }
+
+ private:
+  // Sets mask_ to 1 on the blocks of linearity_ that are not all zero, and 0
+  // elsewhere.
+  void ComputeMask() {
+    KALDI_ASSERT(block_rows_ > 0 && block_cols_ > 0);
+    Matrix<BaseFloat> mat(linearity_), mask(mat.NumRows(), mat.NumCols());
+    int32 rows = mat.NumRows(), cols = mat.NumCols();
+    num_blocks_ = 0;
+    num_zero_blocks_ = 0;
+    for (int32 r = 0; r < rows; r += block_rows_) {
+      for (int32 c = 0; c < cols; c += block_cols_) {
+        int32 h = std::min(block_rows_, rows - r),
+            w = std::min(block_cols_, cols - c);
+        num_blocks_++;
+        if (SubMatrix<BaseFloat>(mat, r, h, c, w).FrobeniusNorm() == 0.0)
+          num_zero_blocks_++;
+        else
+          SubMatrix<BaseFloat>(mask, r, h, c, w).Set(1.0);
+      }
+    }
+    mask_ = mask;
+    sparse_linearity_.Clear();
+  }
+
+  // Zeroes the pruned weights again after they changed.
+  void ApplyMask() {
+    linearity_.MulElements(mask_);
+    sparse_linearity_.Clear();
+  }
+
+  int32 block_rows_;
+  int32 block_cols_;
+  BaseFloat sparsity_;  // the target, for Info() and further pruning.
+
+  int32 num_blocks_;
+  int32 num_zero_blocks_;
+  CuMatrix<BaseFloat> mask_;
+
+  // The nonzero blocks of linearity_, for PropagateFnc() on the CPU; empty
+  // until needed.
+  BlockSparseMatrix<BaseFloat> sparse_linearity_;
+};
+
+} // namespace nnet0
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,96 @@
+// nnet0/nnet-spec-augment-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet0/nnet-spec-augment.h"
+
+using namespace kaldi;
+using namespace kaldi::nnet0;
+
+// every column of row t holds the value t, so interpolation is easy to check.
+static void InitRamp(int32 num_rows, int32 num_cols, Matrix<BaseFloat> *mat) {
+  mat->Resize(num_rows, num_cols);
+  for (int32 r = 0; r < num_rows; r++)
+    mat->Row(r).Set(r);
+}
+
+void UnitTestSpeedPerturb() {
+  Matrix<BaseFloat> mat;
+  InitRamp(100, 13, &mat);
+  SpecAugmenter::SpeedPerturb(0.5, &mat);  // slower: twice as many frames.
+  KALDI_ASSERT(mat.NumRows() == 200 && mat.NumCols() == 13);
+  for (int32 t = 0; t < 198; t++)
+    KALDI_ASSERT(ApproxEqual(mat(t, 5), 0.5 * t));
+
+  InitRamp(100, 13, &mat);
+  SpecAugmenter::SpeedPerturb(1.25, &mat);
+  KALDI_ASSERT(mat.NumRows() == 80);
+  for (int32 t = 0; t < 80; t++)
+    KALDI_ASSERT(ApproxEqual(mat(t, 0), 1.25 * t));
+}
+
+void UnitTestTimeWarp() {
+  int32 num_rows = 50 + Rand() % 50;
+  Matrix<BaseFloat> mat;
+  InitRamp(num_rows, 5, &mat);
+  int32 center = num_rows / 2, warped_center = center + 7;
+  SpecAugmenter::TimeWarp(center, warped_center, &mat);
+  KALDI_ASSERT(mat.NumRows() == num_rows);
+  // end points stay, the center moves, and time stays monotonic.
+  KALDI_ASSERT(ApproxEqual(mat(0, 0), 0.0));
+  KALDI_ASSERT(ApproxEqual(mat(num_rows - 1, 0), num_rows - 1));
+  KALDI_ASSERT(ApproxEqual(mat(warped_center, 0), center));
+  for (int32 t = 1; t < num_rows; t++)
+    KALDI_ASSERT(mat(t, 0) > mat(t - 1, 0));
+}
+
+void UnitTestApply() {
+  SpecAugOptions opts;
+  opts.max_time_warp = 5;
+  opts.speed_factors = "0.9:1.1";
+  opts.seed = 17;
+
+  Matrix<BaseFloat> feats(200, 40);
+  feats.SetRandn();
+
+  // the same seed gives the same augmentation.
+  Matrix<BaseFloat> a(feats), b(feats);
+  SpecAugmenter aug_a(opts), aug_b(opts);
+  aug_a.Apply(&a, true);
+  aug_b.Apply(&b, true);
+  KALDI_ASSERT(a.NumRows() == b.NumRows() && a.ApproxEqual(b, 0.0));
+  KALDI_ASSERT(a.NumRows() == 182 || a.NumRows() == 222);
+
+  // without a length change only masks and warping are applied.
+  Matrix<BaseFloat> c(feats);
+  aug_a.Apply(&c, false);
+  KALDI_ASSERT(c.NumRows() == feats.NumRows() && c.NumCols() == feats.NumCols());
+  KALDI_ASSERT(!c.ApproxEqual(feats, 1.0e-05));
+
+  opts.aug_prob = 0.0;
+  SpecAugmenter never(opts);
+  for (int32 i = 0; i < 10; i++)
+    KALDI_ASSERT(!never.Select());
+}
+
+int main() {
+  UnitTestSpeedPerturb();
+  for (int32 i = 0; i < 10; i++)
+    UnitTestTimeWarp();
+  UnitTestApply();
+
+  std::cout << "Tests succeeded.\n";
+}
@@ -0,0 +1,137 @@
+// nnet0/nnet-spec-augment.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <ctime>
+
+#include "util/text-utils.h"
+#include "nnet0/nnet-spec-augment.h"
+
+namespace kaldi {
+namespace nnet0 {
+
+SpecAugmenter::SpecAugmenter(const SpecAugOptions &opts): opts_(opts) {
+	if (opts_.speed_factors != "" &&
+		!SplitStringToFloats(opts_.speed_factors, ":", false, &speed_factors_))
+		KALDI_ERR << "Invalid speed-factors string " << opts_.speed_factors;
+	for (size_t i = 0; i < speed_factors_.size(); i++) {
+		if (speed_factors_[i] <= 0.0)
+			KALDI_ERR << "Invalid speed factor " << speed_factors_[i];
+	}
+	KALDI_ASSERT(opts_.aug_prob >= 0.0 && opts_.aug_prob <= 1.0);
+	rand_state_.seed = opts_.seed >= 0 ? static_cast<unsigned>(opts_.seed) :
+						static_cast<unsigned>(time(NULL));
+}
+
+bool SpecAugmenter::Select() {
+	return WithProb(opts_.aug_prob, &rand_state_);
+}
+
+void SpecAugmenter::InterpolateRows(const MatrixBase<BaseFloat> &src,
+		const std::vector<BaseFloat> &positions, MatrixBase<BaseFloat> *dst) {
+	KALDI_ASSERT(dst->NumRows() == positions.size() &&
+				 dst->NumCols() == src.NumCols());
+	int32 last = src.NumRows() - 1;
+	for (int32 t = 0; t < dst->NumRows(); t++) {
+		BaseFloat pos = std::min<BaseFloat>(std::max<BaseFloat>(positions[t], 0.0), last);
+		int32 i = static_cast<int32>(pos);
+		BaseFloat a = pos - i;
+		SubVector<BaseFloat> row(*dst, t);
+		row.CopyFromVec(src.Row(i));
+		if (a > 1.0e-04 && i < last) {
+			row.Scale(1.0 - a);
+			row.AddVec(a, src.Row(i + 1));
+		}
+	}
+}
+
+void SpecAugmenter::SpeedPerturb(BaseFloat factor, Matrix<BaseFloat> *feats) {
+	int32 num_rows = feats->NumRows();
+	int32 new_rows = static_cast<int32>(num_rows / factor + 0.5);
+	if (num_rows < 2 || new_rows < 1 || new_rows == num_rows)
+		return;
+	std::vector<BaseFloat> positions(new_rows);
+	for (int32 t = 0; t < new_rows; t++)
+		positions[t] = t * factor;
+	Matrix<BaseFloat> out(new_rows, feats->NumCols(), kUndefined);
+	InterpolateRows(*feats, positions, &out);
+	feats->Swap(&out);
+}
+
+void SpecAugmenter::TimeWarp(int32 center, int32 warped_center,
+		Matrix<BaseFloat> *feats) {
+	int32 num_rows = feats->NumRows(), last = num_rows - 1;
+	KALDI_ASSERT(center > 0 && center < last &&
+				 warped_center > 0 && warped_center < last);
+	if (center == warped_center)
+		return;
+	// [0, warped_center] maps onto [0, center], the rest onto [center, last].
+	std::vector<BaseFloat> positions(num_rows);
+	BaseFloat left_scale = static_cast<BaseFloat>(center) / warped_center,
+			right_scale = static_cast<BaseFloat>(last - center) / (last - warped_center);
+	for (int32 t = 0; t < num_rows; t++) {
+		if (t <= warped_center)
+			positions[t] = t * left_scale;
+		else
+			positions[t] = center + (t - warped_center) * right_scale;
+	}
+	Matrix<BaseFloat> out(num_rows, feats->NumCols(), kUndefined);
+	InterpolateRows(*feats, positions, &out);
+	feats->Swap(&out);
+}
+
+void SpecAugmenter::Mask(MatrixBase<BaseFloat> *feats) {
+	int32 num_rows = feats->NumRows(), num_cols = feats->NumCols();
+	Vector<BaseFloat> mean(num_cols);
+	mean.AddRowSumMat(1.0 / num_rows, *feats);
+
+	int32 max_freq_mask = std::min(opts_.max_freq_mask, num_cols);
+	for (int32 n = 0; n < opts_.num_freq_mask && max_freq_mask > 0; n++) {
+		int32 len = RandInt(1, max_freq_mask, &rand_state_),
+			start = RandInt(0, num_cols - len, &rand_state_);
+		feats->ColRange(start, len).CopyRowsFromVec(mean.Range(start, len));
+	}
+
+	int32 max_time_mask = std::min<int32>(opts_.max_time_mask,
+						opts_.time_mask_ratio * num_rows);
+	for (int32 n = 0; n < opts_.num_time_mask && max_time_mask > 0; n++) {
+		int32 len = RandInt(1, max_time_mask, &rand_state_),
+			start = RandInt(0, num_rows - len, &rand_state_);
+		feats->RowRange(start, len).CopyRowsFromVec(mean);
+	}
+}
+
+void SpecAugmenter::Apply(Matrix<BaseFloat> *feats, bool allow_length_change) {
+	if (feats->NumRows() == 0)
+		return;
+
+	if (allow_length_change && !speed_factors_.empty()) {
+		int32 k = RandInt(0, speed_factors_.size() - 1, &rand_state_);
+		SpeedPerturb(speed_factors_[k], feats);
+	}
+
+	int32 num_rows = feats->NumRows(), warp = opts_.max_time_warp;
+	if (warp > 0 && num_rows > 2 * warp + 2) {
+		int32 center = RandInt(warp + 1, num_rows - warp - 2, &rand_state_),
+			warped_center = center + RandInt(-warp, warp, &rand_state_);
+		TimeWarp(center, warped_center, feats);
+	}
+
+	Mask(feats);
+}
+
+} // namespace nnet0
+} // namespace kaldi
@@ -0,0 +1,117 @@
+// nnet0/nnet-spec-augment.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET_NNET_SPEC_AUGMENT_H_
+#define KALDI_NNET_NNET_SPEC_AUGMENT_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-math.h"
+#include "itf/options-itf.h"
+#include "matrix/kaldi-matrix.h"
+
+namespace kaldi {
+namespace nnet0 {
+
+struct SpecAugOptions {
+	int32 num_time_mask;
+	int32 max_time_mask;
+	BaseFloat time_mask_ratio;
+	int32 num_freq_mask;
+	int32 max_freq_mask;
+	int32 max_time_warp;
+	std::string speed_factors;
+	BaseFloat aug_prob;
+	int32 seed;
+
+	// default values
+	SpecAugOptions() : num_time_mask(2),
+					   max_time_mask(20),
+					   time_mask_ratio(0.2),
+					   num_freq_mask(2),
+					   max_freq_mask(7),
+					   max_time_warp(0),
+					   speed_factors(""),
+					   aug_prob(1.0),
+					   seed(-1) { }
+
+	void Register(OptionsItf *po) {
+	  po->Register("num-time-mask", &num_time_mask, "Number of mask in time domain.");
+	  po->Register("max-time-mask", &max_time_mask, "Maximum mask frames in time domain.");
+	  po->Register("time-mask-ratio", &time_mask_ratio, "Maximum mask frames ration of utterance in time domain.");
+	  po->Register("num-freq-mask", &num_freq_mask, "Number of mask in frequency domain.");
+	  po->Register("max-freq-mask", &max_freq_mask, "Maximum mask frames in frequency domain.");
+	  po->Register("max-time-warp", &max_time_warp, "Maximum time warping distance in frames (0 == disabled).");
+	  po->Register("speed-factors", &speed_factors, "Colon separated feature-domain speed perturbation factors, "
+			  "one is picked per utterance, e.g. 0.9:1.0:1.1 (empty == disabled; only applied to sequence targets).");
+	  po->Register("spec-aug-prob", &aug_prob, "Probability that an utterance gets an augmented copy.");
+	  po->Register("spec-aug-seed", &seed, "Seed of the augmentation random generator; use a different value "
+			  "per epoch for reproducible runs (-1 == seed from the clock).");
+	}
+};
+
+
+/**
+ * SpecAugmenter applies SpecAugment style augmentation to the feature
+ * matrix of one utterance on the fly, in the data-reading thread of the
+ * trainers: feature-domain speed perturbation, time warping, and time and
+ * frequency masking (masked regions are set to the utterance mean).
+ *
+ * All random decisions come from a private RandomState, so one augmenter
+ * must only be used by one thread.  The resampling and masking are done
+ * with whole-row vector operations.
+ */
+class SpecAugmenter {
+ public:
+	SpecAugmenter(const SpecAugOptions &opts);
+
+	/// Randomly decides whether to augment the next utterance,
+	/// true with probability --spec-aug-prob.
+	bool Select();
+
+	/// Augments 'feats' in place.  Speed perturbation changes the number of
+	/// frames, so it is only done if 'allow_length_change' is true (i.e. the
+	/// targets are label sequences rather than per-frame alignments).
+	void Apply(Matrix<BaseFloat> *feats, bool allow_length_change);
+
+	/// Resamples the rows of 'feats' by 'factor' with linear interpolation;
+	/// the output has round(num-rows / factor) rows.
+	static void SpeedPerturb(BaseFloat factor, Matrix<BaseFloat> *feats);
+
+	/// Piecewise-linearly warps the time axis so that frame 'center' of the
+	/// input ends up at frame 'warped_center' of the output; the number of
+	/// rows is unchanged.
+	static void TimeWarp(int32 center, int32 warped_center,
+			Matrix<BaseFloat> *feats);
+
+ private:
+	/// Sets row t of 'dst' to 'src' linearly interpolated at positions[t].
+	static void InterpolateRows(const MatrixBase<BaseFloat> &src,
+			const std::vector<BaseFloat> &positions, MatrixBase<BaseFloat> *dst);
+
+	void Mask(MatrixBase<BaseFloat> *feats);
+
+	SpecAugOptions opts_;
+	std::vector<BaseFloat> speed_factors_;
+	RandomState rand_state_;
+};
+
+} // namespace nnet0
+} // namespace kaldi
+
+#endif // KALDI_NNET_NNET_SPEC_AUGMENT_H_
@@ -57,6 +57,8 @@ int main(int argc, char *argv[]) {
     CuAllocatorOptions cuallocator_opts;
     cuallocator_opts.cache_memory = false;
     cuallocator_opts.Register(&po);
+    g_host_allocator_options.cache_memory = true;
+    RegisterHostAllocatorOptions(&po);
 
     using namespace kaldi;
     using namespace kaldi::nnet0;
@@ -66,6 +68,7 @@ int main(int argc, char *argv[]) {
     po.Register("time-shift", &time_shift, "LSTM : repeat last input frame N-times, discrad N initial output frames."); 
 
     po.Read(argc, argv);
+    ApplyHostAllocatorOptions();
 
     if (po.NumArgs() != 3) {
       po.PrintUsage();
@@ -221,6 +224,8 @@ int main(int argc, char *argv[]) {
               << " in " << time.Elapsed()/60 << "min," 
               << " (fps " << tot_t/time.Elapsed() << ")"; 
 
+    if (kaldi::g_kaldi_verbose_level >= 1)
+      HostMemoryAllocator::Instance().PrintMemoryUsage();
 #if HAVE_CUDA==1
     if (kaldi::g_kaldi_verbose_level >= 1) {
       CuDevice::Instantiate().PrintProfile();
@@ -0,0 +1,123 @@
+// nnet0bin/nnet-sparsify.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "nnet0/nnet-nnet.h"
+#include "nnet0/nnet-affine-transform.h"
+#include "nnet0/nnet-sparse-affine-transform.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet0;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Prune the weights of the affine layers of a neural network by magnitude,\n"
+        "converting <AffineTransform> to <SparseAffineTransform>; layers that are\n"
+        "already sparse are pruned further (fine-tune between the steps).\n"
+        "Usage:  nnet-sparsify [options] <model-in> <model-out>\n"
+        "e.g.:\n"
+        " nnet-sparsify --sparsity=0.8 nnet.in nnet.out\n"
+        " nnet-sparsify --block-rows=4 --block-cols=4 --sparsity-layers=0:0.5:0.5:0.9 nnet.in nnet.out\n";
+
+    bool binary_write = true;
+    BaseFloat sparsity = 0.8;
+    std::string sparsity_layers = "";
+    int32 block_rows = 8, block_cols = 1;
+
+    ParseOptions po(usage);
+    po.Register("binary", &binary_write, "Write output in binary mode");
+    po.Register("sparsity", &sparsity, "Fraction of the blocks of weights to "
+                "zero, in each affine layer");
+    po.Register("sparsity-layers", &sparsity_layers, "Colon-separated sparsity "
+                "of each affine layer, from the input; 0 leaves a layer as it is, "
+                "missing ones get --sparsity");
+    po.Register("block-rows", &block_rows, "Rows of weights per block (outputs); "
+                "8 or 4 have fast CPU kernels");
+    po.Register("block-cols", &block_cols, "Columns of weights per block (inputs)");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        model_out_filename = po.GetArg(2);
+
+    std::vector<BaseFloat> sparsities;
+    if (!SplitStringToFloats(sparsity_layers, ":", true, &sparsities))
+      KALDI_ERR << "Bad --sparsity-layers option " << sparsity_layers;
+
+    // load the network
+    Nnet nnet;
+    {
+      bool binary_read;
+      Input ki(model_in_filename, &binary_read);
+      nnet.Read(ki.Stream(), binary_read);
+    }
+
+    Nnet nnet_out;
+    int32 num_affine = 0;
+    for (int32 i = 0; i < nnet.NumComponents(); i++) {
+      Component &comp = nnet.GetComponent(i);
+      Component::ComponentType type = comp.GetType();
+      if (type != Component::kAffineTransform &&
+          type != Component::kSparseAffineTransform) {
+        nnet_out.AppendComponent(comp.Copy());
+        continue;
+      }
+      BaseFloat s = (num_affine < static_cast<int32>(sparsities.size()) ?
+                     sparsities[num_affine] : sparsity);
+      num_affine++;
+      if (s <= 0.0) {
+        nnet_out.AppendComponent(comp.Copy());
+        continue;
+      }
+      SparseAffineTransform *sparse;
+      if (type == Component::kAffineTransform) {
+        sparse = new SparseAffineTransform(dynamic_cast<AffineTransform&>(comp),
+                                           block_rows, block_cols, s);
+      } else {
+        sparse = dynamic_cast<SparseAffineTransform*>(comp.Copy());
+        sparse->Prune(s);
+      }
+      KALDI_LOG << "Component " << i + 1 << ", sparsity " << s << ":"
+                << sparse->Info();
+      nnet_out.AppendComponent(sparse);
+    }
+    if (num_affine < static_cast<int32>(sparsities.size()))
+      KALDI_WARN << "--sparsity-layers has " << sparsities.size()
+                 << " values but there are only " << num_affine
+                 << " affine layers";
+
+    // store the network
+    {
+      Output ko(model_out_filename, binary_write);
+      nnet_out.Write(ko.Stream(), binary_write);
+    }
+
+    KALDI_LOG << "Written model to " << model_out_filename;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
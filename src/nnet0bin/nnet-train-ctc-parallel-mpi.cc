@@ -161,6 +161,7 @@ int main(int argc, char *argv[]) {
     time_now = time.Elapsed();
 
     stats->Print(&opts, time_now);
+    stats->PrintProfile(&opts);
 
 #if HAVE_CUDA==1
     CuDevice::Instantiate().PrintProfile();
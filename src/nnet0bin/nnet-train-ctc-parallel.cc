@@ -124,6 +124,7 @@ int main(int argc, char *argv[]) {
 
 
     stats->Print(&opts, time_now);
+    stats->PrintProfile(&opts);
 
 #if HAVE_CUDA==1
     CuDevice::Instantiate().PrintProfile();
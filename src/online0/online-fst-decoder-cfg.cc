@@ -79,7 +79,8 @@ void OnlineFstDecoderCfg::Initialize() {
 	}
 
 	// HCLG fst graph
-	decode_fst_ = fst::ReadFstKaldiGeneric(decoding_opts_->fst_rspecifier);
+	decode_fst_ = fst::ReadFstKaldiGeneric(decoding_opts_->fst_rspecifier, true,
+											decoding_opts_->fst_mmap);
 	if (!(word_syms_ = fst::SymbolTable::ReadText(decoding_opts_->word_syms_filename)))
 		KALDI_ERR << "Could not read symbol table from file " << decoding_opts_->word_syms_filename;
 }
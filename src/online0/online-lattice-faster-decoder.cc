@@ -33,7 +33,8 @@ template <typename FST>
 void OnlineLatticeFasterDecoderTpl<FST>::ResetDecoder(bool full) {
   this->InitDecoding();
 
-  //prev_immortal_tok_ = immortal_tok_ = dummy_token;
+  prev_immortal_tok_ = immortal_tok_ = NULL;
+  immortal_frame_ = 0;
   utt_frames_ = 0;
   if (full)
     frame_ = 0;
@@ -42,7 +43,79 @@ void OnlineLatticeFasterDecoderTpl<FST>::ResetDecoder(bool full) {
 
 template <typename FST>
 void OnlineLatticeFasterDecoderTpl<FST>::FinalizeDecoding() {
-  this->FinalizeDecoding();
+  LatticeFasterOnlineDecoderTpl<FST>::FinalizeDecoding();
+}
+
+template <typename FST>
+void OnlineLatticeFasterDecoderTpl<FST>::MakeLattice(BestPathIterator iter,
+		const Token *end, BaseFloat final_cost,
+		fst::MutableFst<LatticeArc> *out_fst) const {
+  out_fst->DeleteStates();
+  StateId state = out_fst->AddState();
+  out_fst->SetFinal(state, LatticeWeight(final_cost, 0.0));
+  while (!iter.Done() && iter.tok != end) {
+    LatticeArc arc;
+    iter = this->TraceBackBestPath(iter, &arc);
+    arc.nextstate = state;
+    StateId new_state = out_fst->AddState();
+    out_fst->AddArc(new_state, arc);
+    state = new_state;
+  }
+  out_fst->SetStart(state);
+}
+
+template <typename FST>
+void OnlineLatticeFasterDecoderTpl<FST>::UpdateImmortalToken() {
+  // The best paths of all active tokens (through the backpointers) pass
+  // through immortal_tok_, so they meet again at the latest there.  Going
+  // back a frame at a time, find the tokens by which they enter each frame.
+  int32 f = this->NumFramesDecoded();
+  if (f <= immortal_frame_ && immortal_tok_ != NULL)
+    return;
+  std::vector<Token*> entry;
+  for (Token *tok = this->active_toks_[f].toks; tok != NULL; tok = tok->next)
+    entry.push_back(tok);
+  unordered_set<Token*> frame_toks, prev_entry;
+  while (entry.size() > 1 && f > immortal_frame_) {
+    frame_toks.clear();
+    for (Token *tok = this->active_toks_[f].toks; tok != NULL; tok = tok->next)
+      frame_toks.insert(tok);
+    prev_entry.clear();
+    for (size_t i = 0; i < entry.size(); i++) {
+      Token *tok = entry[i];
+      while (tok != NULL && frame_toks.count(tok) != 0)
+        tok = tok->backpointer;
+      if (tok != NULL)
+        prev_entry.insert(tok);
+    }
+    entry.assign(prev_entry.begin(), prev_entry.end());
+    f--;
+  }
+  if (entry.size() == 1 && entry[0] != immortal_tok_) {
+    prev_immortal_tok_ = immortal_tok_;
+    immortal_tok_ = entry[0];
+    immortal_frame_ = f;
+  }
+}
+
+template <typename FST>
+bool OnlineLatticeFasterDecoderTpl<FST>::PartialTraceback(
+		fst::MutableFst<LatticeArc> *out_fst) {
+  const Token *prev_immortal_tok = immortal_tok_;
+  UpdateImmortalToken();
+  if (immortal_tok_ == prev_immortal_tok)
+    return false; // no partial traceback at that point of time
+  MakeLattice(BestPathIterator(immortal_tok_, immortal_frame_ - 1),
+              prev_immortal_tok, 0.0, out_fst);
+  return true;
+}
+
+template <typename FST>
+void OnlineLatticeFasterDecoderTpl<FST>::FinishTraceBack(bool use_final_probs,
+		fst::MutableFst<LatticeArc> *out_fst) {
+  BaseFloat final_cost;
+  BestPathIterator iter = this->BestPathEnd(use_final_probs, &final_cost);
+  MakeLattice(iter, immortal_tok_, final_cost, out_fst);
 }
 
 template <typename FST>
@@ -85,16 +85,34 @@ public:
     using Weight = typename Arc::Weight;
     //using Token = decoder::BackpointerToken;
     using Token = typename kaldi::LatticeFasterOnlineDecoderTpl<FST>::Token;
+    using BestPathIterator =
+        typename kaldi::LatticeFasterOnlineDecoderTpl<FST>::BestPathIterator;
 
 	OnlineLatticeFasterDecoderTpl(const FST &fst, const OnlineLatticeFasterDecoderOptions &opts):
 								LatticeFasterOnlineDecoderTpl<FST>(fst, opts),
 								opts_(opts), 
 								state_(kStartFeats), frame_(0), utt_frames_(0),
-								immortal_tok_(NULL), prev_immortal_tok_(NULL) {
+								immortal_tok_(NULL), prev_immortal_tok_(NULL),
+								immortal_frame_(0) {
 								}
 
 	DecodeState Decode(DecodableInterface *decodable);
 
+	// Makes a linear graph, by tracing back the best path from the last
+	// "immortal" token to the previous one.  That part of the best path can
+	// no longer change, so the results of successive calls can be appended
+	// to each other; the time taken depends only on the frames decoded since
+	// the previous call, not on the length of the utterance.  Returns false
+	// if the immortal token did not move.
+	bool PartialTraceback(fst::MutableFst<LatticeArc> *out_fst);
+
+	// Makes a linear graph, by tracing back from the best currently active
+	// token to the last immortal token, i.e. the part of the best path that
+	// PartialTraceback() has not output yet.  At the end of an utterance
+	// call FinalizeDecoding() first, and set "use_final_probs".
+	void FinishTraceBack(bool use_final_probs,
+			fst::MutableFst<LatticeArc> *out_fst);
+
 	/// Finalizes the decoding. Cleans up and prunes remaining tokens, so the
 	/// GetLattice() call will return faster.  You must not call this before
 	/// calling (TerminateDecoding() or InputIsFinished()) and then Wait().
@@ -114,7 +132,14 @@ public:
 
 private:
 
+	// Makes a linear "lattice" by tracing back the best path from "iter" to
+	// the token "end" (to the start if NULL), with final cost "final_cost".
+	void MakeLattice(BestPathIterator iter, const Token *end,
+			BaseFloat final_cost, fst::MutableFst<LatticeArc> *out_fst) const;
 
+	// Searches for the last token that is an ancestor of all currently active
+	// tokens, going back no further than the current immortal token.
+	void UpdateImmortalToken();
 
 	const OnlineLatticeFasterDecoderOptions &opts_;
 	DecodeState state_; // the current state of the decoder
@@ -122,6 +147,7 @@ private:
 	int32 utt_frames_; // # frames processed from the current utterance
 	Token *immortal_tok_;      // "immortal" token means it's an ancestor of ...
 	Token *prev_immortal_tok_; // ... all currently active tokens
+	int32 immortal_frame_; // the index of immortal_tok_'s frame in active_toks_
 	KALDI_DISALLOW_COPY_AND_ASSIGN(OnlineLatticeFasterDecoderTpl);
 };
 
@@ -65,6 +65,7 @@ struct OnlineNnetDecodingOptions {
 
 	std::string word_syms_filename;
 	std::string fst_rspecifier;
+	bool fst_mmap;
 	std::string model_rspecifier;
 	std::string words_wspecifier;
 	std::string alignment_wspecifier;
@@ -74,7 +75,7 @@ struct OnlineNnetDecodingOptions {
 	OnlineNnetDecodingOptions(): decoder_cfg(""), forward_cfg(""), am_vad_cfg(""),
 							acoustic_scale(0.1), allow_partial(true), chunk_length_secs(0.05), batch_size(18), out_dim(0),
 							skip_frames(1), copy_posterior(true), skip_inner(false), use_ipc(false), use_lat(false), use_am_vad(false),
-							socket_path(""), silence_phones_str(""), word_syms_filename(""), fst_rspecifier(""), model_rspecifier(""),
+							socket_path(""), silence_phones_str(""), word_syms_filename(""), fst_rspecifier(""), fst_mmap(false), model_rspecifier(""),
                             words_wspecifier(""), alignment_wspecifier(""), model_type("hybrid")
     { }
 
@@ -106,6 +107,8 @@ struct OnlineNnetDecodingOptions {
 
 		po->Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
 	    po->Register("fst-rspecifier", &fst_rspecifier, "fst filename");
+	    po->Register("fst-mmap", &fst_mmap, "Memory-map the fst if it is a const fst, "
+	    		"the decoder processes of a host then share it");
 	    po->Register("model-rspecifier", &model_rspecifier, "transition model filename");
 	    po->Register("words-wspecifier", &words_wspecifier, "transcript wspecifier");
 	    po->Register("clat_wspecifier", &clat_wspecifier, "compact lattice wspecifier");
@@ -62,6 +62,7 @@ public:
 		std::vector<int> tids;
 		LatticeWeight weight;
 		DecodeState state;
+		bool new_partial = false;
 
 		OnlineDecodableBlock *block = NULL;
 		// ipc decodable
@@ -112,21 +113,29 @@ public:
 			// decoding
 			while (decoder_->frame() < decodable_->NumFramesReady()) {
 				state = decoder_->Decode(decodable_);
+				// only the settled part of the best path is appended during the
+				// utterance; the rest at its end, once decoding is finalized.
 				if (state != DecodeState::kEndFeats) {
-					decoder_->GetBestPath(&out_fst, false);
+					new_partial = decoder_->PartialTraceback(&out_fst);
 				} else {
-					decoder_->GetBestPath(&out_fst, true);
+					decoder_->FinalizeDecoding();
+					decoder_->FinishTraceBack(true, &out_fst);
 				}
 
-				word_ids.clear();
-				tids.clear();
-				fst::GetLinearSymbolSequence(out_fst, &tids, &word_ids, &weight);
-				result_->word_ids_ = word_ids;
-				result_->tids_ = tids;
+                if (new_partial || state == DecodeState::kEndFeats) {
+                    word_ids.clear();
+                    tids.clear();
+                    fst::GetLinearSymbolSequence(out_fst, &tids, &word_ids, &weight);
 
-                if (state == DecodeState::kEndFeats) {
+                    for (int i = 0; i < word_ids.size(); i++)
+                        result_->word_ids_.push_back(word_ids[i]);
+                    for (int i = 0; i < tids.size(); i++)
+                        result_->tids_.push_back(tids[i]);
+                    result_->score_ += (-weight.Value1() - weight.Value2());
                     result_->post_frames = decoder_->frame();
-                    result_->score_ = (-weight.Value1() - weight.Value2());
+                }
+
+                if (state == DecodeState::kEndFeats) {
                     result_->score_ /= result_->post_frames;
 
                     if (opts_.clat_wspecifier != "") {
@@ -134,6 +143,7 @@ public:
                     	ScaleLattice(AcousticLatticeScale(1.0/opts_.acoustic_scale), &result_->clat);
                     }
                     result_->isend = true;
+                    result_->isuttend = true;
                 }
 			}
 
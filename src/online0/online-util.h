@@ -29,6 +29,7 @@
 #include "fstext/fstext-lib.h"
 #include "util/kaldi-mutex.h"
 #include "util/kaldi-semaphore.h"
+#include "util/mpmc-queue.h"
 
 // This file hosts the declarations of various auxiliary functions, used by
 // the binaries in "onlinebin" directory. These functions are not part of the
@@ -52,6 +53,7 @@ void PrintPartialResult(const std::vector<int32>& words,
 class Repository {
  public:
   /// The following function is called by the code that reads in the examples.
+  /// It is an error to call it after Done().
   void Accept(void *example);
 
   bool TryAccept(void *example);
@@ -71,17 +73,9 @@ class Repository {
 
   int Size();
 
-  Repository(int32 buffer_size = 128): buffer_size_(buffer_size),
-                                      empty_semaphore_(buffer_size_),
-                                      done_(false) { }
+  Repository(int32 buffer_size = 128): examples_(buffer_size) { }
  private:
-  int32 buffer_size_;
-  Semaphore full_semaphore_;
-  Semaphore empty_semaphore_;
-  Mutex examples_mutex_; // mutex we lock to modify examples_.
-
-  std::deque<void*> examples_;
-  bool done_;
+  MpmcQueue<void*> examples_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(Repository);
 };
 
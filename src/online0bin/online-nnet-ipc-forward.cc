@@ -50,8 +50,11 @@ int main(int argc, char *argv[]) {
 
     OnlineNnetIpcForwardOptions opts(&prior_opts);
     opts.Register(&po);
+    g_host_allocator_options.cache_memory = true;
+    RegisterHostAllocatorOptions(&po);
 
     po.Read(argc, argv);
+    ApplyHostAllocatorOptions();
     
     if (argc < 2) {
         po.PrintUsage();
@@ -151,6 +154,8 @@ int main(int argc, char *argv[]) {
 
     KALDI_LOG << "Nnet Forward FINISHED; ";
 
+    if (kaldi::g_kaldi_verbose_level >= 1)
+      HostMemoryAllocator::Instance().PrintMemoryUsage();
 
 #if HAVE_CUDA==1
     if (kaldi::g_kaldi_verbose_level >= 1) {
@@ -271,6 +271,14 @@ bool ExtractRangeSpecifier(const std::string &rxfilename_with_range,
                            std::string *data_rxfilename,
                            std::string *range);
 
+// Parses a matrix range specifier of the form r1:r2,c1:c2 (e.g. "0:39,:" or
+// ":,5:10") for a matrix with "rows" rows and "cols" columns, into the first
+// and last row and column.  See kaldi-holder.cc for details.
+bool ParseMatrixRangeSpecifier(const std::string &range,
+                               const int rows, const int cols,
+                               std::vector<int32> *row_range,
+                               std::vector<int32> *col_range);
+
 
 /// @} end "addtogroup holders"
 
@@ -0,0 +1,166 @@
+// util/kaldi-mmap-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <thread>
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+#include "base/timer.h"
+#include "util/kaldi-mmap.h"
+#include "util/table-types.h"
+
+namespace kaldi {
+
+// Writes "num_mats" random matrices to tmpf_mm.ark, listed in tmpf_mm.scp,
+// with keys in sorted order; every third one is compressed.
+static void WriteMatrices(int32 num_mats, int32 max_rows, int32 cols,
+                          std::vector<std::string> *keys,
+                          std::vector<Matrix<BaseFloat> > *mats) {
+  keys->resize(num_mats);
+  mats->resize(num_mats);
+  Output ko("tmpf_mm.ark", true, false);
+  std::vector<std::pair<std::string, std::string> > script;
+  for (int32 i = 0; i < num_mats; i++) {
+    std::ostringstream key;
+    key << "utt" << (10000 + i);
+    (*keys)[i] = key.str();
+    Matrix<BaseFloat> &mat = (*mats)[i];
+    int32 rows = RandInt(0, max_rows);
+    mat.Resize(rows, rows == 0 ? 0 : cols);
+    mat.SetRandn();
+    ko.Stream() << key.str() << ' ';
+    std::ostringstream rxfilename;
+    rxfilename << "tmpf_mm.ark:" << ko.Stream().tellp();
+    script.push_back(std::make_pair(key.str(), rxfilename.str()));
+    if (i % 3 == 2) {
+      CompressedMatrix cmat(mat);
+      cmat.CopyToMat(&mat);
+      ko.Stream().write("\0B", 2);
+      cmat.Write(ko.Stream(), true);
+    } else {
+      ko.Stream().write("\0B", 2);
+      mat.Write(ko.Stream(), true);
+    }
+  }
+  KALDI_ASSERT(ko.Close());
+  KALDI_ASSERT(WriteScriptFile("tmpf_mm.scp", script));
+}
+
+void UnitTestMemoryStreamBuf() {
+  std::string data = "0123456789";
+  MemoryStreamBuf buf;
+  buf.Reset(data.data(), data.data() + data.size(), 3);
+  std::istream is(&buf);
+  KALDI_ASSERT(is.tellg() == std::streampos(3) && is.get() == '3');
+  is.seekg(-2, std::ios_base::end);
+  KALDI_ASSERT(is.get() == '8' && is.get() == '9' && is.get() == EOF);
+  is.clear();
+  is.seekg(1);
+  char c[4];
+  KALDI_ASSERT(is.read(c, 4) && std::string(c, 4) == "1234");
+  is.seekg(100);
+  KALDI_ASSERT(is.fail());
+}
+
+void UnitTestMappedFile() {
+  std::vector<std::string> keys;
+  std::vector<Matrix<BaseFloat> > mats;
+  WriteMatrices(50, 20, 7, &keys, &mats);
+  // The mapping of a file is shared while it is used.
+  std::shared_ptr<const MappedFile> a = MappedFile::Get("tmpf_mm.ark"),
+      b = MappedFile::Get("tmpf_mm.ark");
+  KALDI_ASSERT(a != NULL && a == b);
+
+  MappedInput input;
+  KALDI_ASSERT(!input.Open("tmpf_mm.ark:100000000"));
+  KALDI_ASSERT(!input.Open("tmpf_mm_nonexistent.ark:0"));
+  KALDI_ASSERT(MappedFile::Get("tmpf_mm_nonexistent.ark") == NULL);
+}
+
+// Looks up random keys with a reader per thread, as the nnet0 training tools
+// do, and checks the values.
+static void LookUpRandomKeys(const std::string &rspecifier,
+                             const std::vector<std::string> *keys,
+                             const std::vector<Matrix<BaseFloat> > *mats,
+                             int32 num_lookups) {
+  RandomAccessBaseFloatMatrixReader reader(rspecifier);
+  for (int32 n = 0; n < num_lookups; n++) {
+    int32 i = RandInt(0, keys->size() - 1);
+    KALDI_ASSERT(reader.HasKey((*keys)[i]));
+    KALDI_ASSERT(reader.Value((*keys)[i]).ApproxEqual((*mats)[i], 1.0e-05));
+  }
+}
+
+void UnitTestMappedTableReaderThreads() {
+  std::vector<std::string> keys;
+  std::vector<Matrix<BaseFloat> > mats;
+  WriteMatrices(100, 30, 13, &keys, &mats);
+  std::vector<std::thread> threads;
+  for (int32 t = 0; t < 4; t++)
+    threads.push_back(std::thread(LookUpRandomKeys, "scp,mm:tmpf_mm.scp",
+                                  &keys, &mats, 200));
+  for (size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+
+  // In permissive mode, entries with bad offsets are not there.
+  {
+    Output ko("tmpf_mm_bad.scp", false);
+    ko.Stream() << keys[0] << " tmpf_mm.ark:100000000\n"
+                << keys[1] << " tmpf_mm_nonexistent.ark:0\n";
+  }
+  RandomAccessBaseFloatMatrixReader reader("scp,mm,p:tmpf_mm_bad.scp");
+  KALDI_ASSERT(!reader.HasKey(keys[0]) && !reader.HasKey(keys[1]));
+  unlink("tmpf_mm_bad.scp");
+}
+
+// Compares the time of random lookups of feature matrices with and without
+// the "mm" option.
+void MappedTableReaderBenchmark() {
+  std::vector<std::string> keys;
+  std::vector<Matrix<BaseFloat> > mats;
+  WriteMatrices(2000, 200, 40, &keys, &mats);
+  std::vector<int32> order(keys.size() * 5);
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = RandInt(0, keys.size() - 1);
+  const char *rspecifiers[] = { "scp:tmpf_mm.scp", "scp,mm:tmpf_mm.scp" };
+  for (int32 r = 0; r < 2; r++) {
+    RandomAccessBaseFloatMatrixReader reader(rspecifiers[r]);
+    Timer timer;
+    double sum = 0.0;
+    for (size_t i = 0; i < order.size(); i++)
+      sum += reader.Value(keys[order[i]]).NumRows();
+    KALDI_LOG << order.size() << " random lookups with " << rspecifiers[r]
+              << " took " << timer.Elapsed() << " seconds (" << sum
+              << " frames).";
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestMemoryStreamBuf();
+  UnitTestMappedFile();
+  UnitTestMappedTableReaderThreads();
+  MappedTableReaderBenchmark();
+  unlink("tmpf_mm.ark");
+  unlink("tmpf_mm.scp");
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
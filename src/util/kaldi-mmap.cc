@@ -0,0 +1,175 @@
+// util/kaldi-mmap.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "util/kaldi-mmap.h"
+#include "util/kaldi-io.h"
+#include "util/text-utils.h"
+
+namespace kaldi {
+
+std::shared_ptr<const MappedFile> MappedFile::Get(const std::string &filename) {
+  // The files mapped so far; the entries of those no longer used have expired.
+  static std::mutex mutex;
+  static std::map<std::string, std::weak_ptr<const MappedFile> > *files =
+      new std::map<std::string, std::weak_ptr<const MappedFile> >();
+  std::lock_guard<std::mutex> lock(mutex);
+  std::weak_ptr<const MappedFile> &entry = (*files)[filename];
+  std::shared_ptr<const MappedFile> ans = entry.lock();
+  if (ans != NULL) return ans;
+#ifdef _MSC_VER
+  KALDI_WARN << "Memory-mapping files is not supported on Windows: "
+             << filename;
+  files->erase(filename);
+  return ans;
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    KALDI_WARN << "Cannot map file " << filename << " into memory: "
+               << strerror(errno);
+    if (fd >= 0) close(fd);
+    files->erase(filename);
+    return ans;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    KALDI_WARN << "Cannot map file " << filename << " into memory: it is not "
+               << "a regular file.";
+    close(fd);
+    files->erase(filename);
+    return ans;
+  }
+  size_t size = st.st_size;
+  void *data = NULL;
+  if (size > 0) {
+    data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      KALDI_WARN << "Cannot map file " << filename << " into memory: "
+                 << strerror(errno);
+      close(fd);
+      files->erase(filename);
+      return ans;
+    }
+  }
+  close(fd);  // the mapping stays valid.
+  ans.reset(new MappedFile(filename, static_cast<const char*>(data), size));
+  entry = ans;
+  // Forget the files that are no longer mapped.
+  for (std::map<std::string, std::weak_ptr<const MappedFile> >::iterator
+           iter = files->begin(); iter != files->end();) {
+    if (iter->second.expired()) files->erase(iter++);
+    else ++iter;
+  }
+  return ans;
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _MSC_VER
+  if (data_ != NULL)
+    munmap(const_cast<char*>(data_), size_);
+#endif
+}
+
+
+void MemoryStreamBuf::Reset(const char *begin, const char *end,
+                            size_t offset) {
+  KALDI_ASSERT(begin + offset <= end);
+  char *b = const_cast<char*>(begin);
+  setg(b, b + offset, const_cast<char*>(end));
+}
+
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekoff(
+    off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+  if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+  off_type pos = off;
+  if (dir == std::ios_base::cur) pos += gptr() - eback();
+  else if (dir == std::ios_base::end) pos += egptr() - eback();
+  if (pos < 0 || pos > egptr() - eback()) return pos_type(off_type(-1));
+  setg(eback(), eback() + pos, egptr());
+  return pos_type(pos);
+}
+
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekpos(
+    pos_type pos, std::ios_base::openmode which) {
+  return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+// Splits an rxfilename like /my/file:123 into /my/file and 123, or, for a
+// plain filename, sets the offset to zero.  Returns false if it is neither.
+static bool SplitMappedRxfilename(const std::string &rxfilename,
+                                  std::string *filename, size_t *offset) {
+  InputType type = ClassifyRxfilename(rxfilename);
+  if (type == kFileInput) {
+    *filename = rxfilename;
+    *offset = 0;
+    return true;
+  }
+  if (type != kOffsetFileInput) return false;
+  size_t pos = rxfilename.find_last_of(':');
+  *filename = std::string(rxfilename, 0, pos);
+  return ConvertStringToInteger(std::string(rxfilename, pos + 1), offset);
+}
+
+bool MappedInput::Open(const std::string &rxfilename) {
+  std::string filename;
+  size_t offset = 0;
+  if (!SplitMappedRxfilename(rxfilename, &filename, &offset)) {
+    KALDI_WARN << "Cannot read " << PrintableRxfilename(rxfilename)
+               << " from a memory-mapped file.";
+    Close();
+    return false;
+  }
+  if (file_ == NULL || file_->Filename() != filename) {
+    Close();
+    if ((file_ = MappedFile::Get(filename)) == NULL)
+      return false;
+  }
+  if (offset > file_->Size()) {
+    KALDI_WARN << "Offset " << offset << " is beyond the end of file "
+               << filename << " (" << file_->Size() << " bytes).";
+    Close();
+    return false;
+  }
+  buf_.Reset(file_->Data(), file_->Data() + file_->Size(), offset);
+  is_.clear();
+  return true;
+}
+
+std::istream &MappedInput::Stream() {
+  if (!IsOpen()) KALDI_ERR << "MappedInput::Stream(), not open.";
+  return is_;
+}
+
+void MappedInput::Close() {
+  file_.reset();
+  buf_.Reset(NULL, NULL, 0);
+}
+
+}  // namespace kaldi
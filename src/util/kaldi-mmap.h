@@ -0,0 +1,120 @@
+// util/kaldi-mmap.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_MMAP_H_
+#define KALDI_UTIL_KALDI_MMAP_H_
+
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// @addtogroup table_impl_types
+/// @{
+
+/**
+   A file mapped read-only into memory.  The mappings are shared: Get() returns
+   the existing mapping of a file if some object still holds one, so that the
+   readers of all threads that look up items in the same archive use one copy
+   of it (in the page cache), and the file is unmapped when the last holder
+   releases it.  This is what the "mm" option of RandomAccessTableReader uses
+   for scp files whose entries are of the form foo.ark:1234.
+*/
+class MappedFile {
+ public:
+  /// Returns the mapping of "filename" (a plain filename, not an rxfilename
+  /// with an offset), mapping it if needed; thread-safe.  Returns an empty
+  /// pointer and prints a warning if the file cannot be mapped (e.g. it is
+  /// not a regular file, or on Windows, where this is not implemented).
+  static std::shared_ptr<const MappedFile> Get(const std::string &filename);
+
+  const char *Data() const { return data_; }
+  size_t Size() const { return size_; }
+  const std::string &Filename() const { return filename_; }
+
+  ~MappedFile();
+
+ private:
+  MappedFile(const std::string &filename, const char *data, size_t size):
+      filename_(filename), data_(data), size_(size) { }
+
+  std::string filename_;
+  const char *data_;  // NULL if the file is empty.
+  size_t size_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+
+/// A stream buffer that reads from memory (e.g. from a MappedFile), which
+/// supports seeking.  The positions are relative to "begin".
+class MemoryStreamBuf: public std::streambuf {
+ public:
+  MemoryStreamBuf() { }
+
+  /// Makes the buffer read the data from "begin" to "end", starting at
+  /// "begin + offset".
+  void Reset(const char *begin, const char *end, size_t offset);
+
+ protected:
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                           std::ios_base::openmode which);
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+};
+
+
+/**
+   Reads objects from memory-mapped files given by rxfilenames of the form
+   foo.ark:1234, like Input does for them, but without a system call per
+   object: the holder reads directly from the mapped file.  One object may be
+   opened many times, for files in any order.
+*/
+class MappedInput {
+ public:
+  MappedInput(): is_(&buf_) { }
+
+  /// "rxfilename" must be of the form foo.ark:1234 (i.e. ClassifyRxfilename()
+  /// returns kOffsetFileInput).  Returns false, after printing a warning, if
+  /// the file could not be mapped or the offset is beyond its end.
+  bool Open(const std::string &rxfilename);
+
+  bool IsOpen() const { return file_ != NULL; }
+
+  /// The file we read from.
+  std::shared_ptr<const MappedFile> File() const { return file_; }
+
+  /// The stream, positioned at the offset given to Open().
+  std::istream &Stream();
+
+  void Close();
+
+ private:
+  std::shared_ptr<const MappedFile> file_;
+  MemoryStreamBuf buf_;
+  std::istream is_;
+};
+
+
+/// @} end "addtogroup table_impl_types"
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_MMAP_H_
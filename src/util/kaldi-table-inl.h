@@ -24,6 +24,9 @@
 #define KALDI_UTIL_KALDI_TABLE_INL_H_
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <utility>
@@ -31,6 +34,7 @@
 #include <errno.h>
 #include "util/kaldi-io.h"
 #include "util/kaldi-holder.h"
+#include "util/kaldi-mmap.h"
 #include "util/text-utils.h"
 #include "util/stl-utils.h"  // for StringHasher.
 #include "util/kaldi-semaphore.h"
@@ -696,6 +700,193 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
   } state_;
 };
 
+// This is the implementation for SequentialTableReader when it's a sharded
+// archive ("sark:prefix").  It reads the shards in order (with the "part=K/N"
+// option, only every N'th one), and the objects of each shard in the order of
+// its index, i.e. in the order they were written in.  The objects are found
+// from their offsets, so in permissive mode an object that cannot be read, or
+// a shard with no index, is simply skipped.
+template<class Holder>  class SequentialTableReaderShardedArchiveImpl:
+      public SequentialTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  SequentialTableReaderShardedArchiveImpl(): shard_(-1), pos_(0),
+                                             state_(kUninitialized) { }
+
+  virtual bool Open(const std::string &rspecifier) {
+    if (state_ != kUninitialized && !Close())
+      KALDI_ERR << "Error closing previous input.";
+    rspecifier_ = rspecifier;
+    RspecifierType rs = ClassifyRspecifier(rspecifier, &prefix_, &opts_);
+    KALDI_ASSERT(rs == kShardedArchiveRspecifier);
+    std::vector<std::string> shards;
+    if (!ListShards(prefix_, &shards))
+      return false;
+    shards_.clear();
+    for (size_t i = opts_.part; i < shards.size(); i += opts_.num_parts)
+      shards_.push_back(shards[i]);
+    shard_ = -1;
+    index_.clear();
+    pos_ = 0;
+    state_ = kFileStart;
+    Next();
+    if (state_ == kError) {
+      KALDI_WARN << "Error beginning to read sharded archive " << prefix_;
+      if (input_.IsOpen()) input_.Close();
+      state_ = kUninitialized;
+      return false;
+    }
+    KALDI_ASSERT(state_ == kHaveObject || state_ == kEof);
+    return true;
+  }
+
+  virtual void Next() {
+    switch (state_) {
+      case kHaveObject:
+        holder_.Clear();
+        pos_++;
+        break;
+      case kFreedObject:
+        pos_++;
+        break;
+      case kFileStart:
+        break;
+      default:
+        KALDI_ERR << "Next() called wrongly.";
+    }
+    while (true) {
+      while (pos_ >= index_.size()) {  // Go to the next shard.
+        if (shard_ + 1 >= static_cast<int32>(shards_.size())) {
+          state_ = kEof;
+          return;
+        }
+        shard_++;
+        pos_ = 0;
+        if (!ReadShardIndex(shards_[shard_], &index_) && !opts_.permissive) {
+          state_ = kError;
+          return;
+        }
+      }
+      std::ostringstream rxfilename;
+      rxfilename << shards_[shard_] << ':' << index_[pos_].second;
+      bool ans = (Holder::IsReadInBinary() ? input_.Open(rxfilename.str()) :
+                  input_.OpenTextMode(rxfilename.str()));
+      if (ans && holder_.Read(input_.Stream())) {
+        key_ = index_[pos_].first;
+        state_ = kHaveObject;
+        return;
+      }
+      KALDI_WARN << "Object read failed, reading " << rxfilename.str();
+      if (!opts_.permissive) {
+        state_ = kError;
+        return;
+      }
+      pos_++;
+    }
+  }
+
+  virtual bool IsOpen() const {
+    switch (state_) {
+      case kEof: case kError: case kHaveObject: case kFreedObject: return true;
+      case kUninitialized: return false;
+      default: KALDI_ERR << "IsOpen() called on invalid object.";
+        return false;
+    }
+  }
+
+  virtual bool Done() const {
+    switch (state_) {
+      case kHaveObject:
+        return false;
+      case kEof: case kError:
+        return true;  // Error-state counts as Done(), but destructor
+        // will fail (unless you check the status with Close()).
+      default:
+        KALDI_ERR << "Done() called on TableReader object at the wrong time.";
+        return false;
+    }
+  }
+
+  virtual std::string Key() {
+    if (state_ != kHaveObject)
+      KALDI_ERR << "Key() called on TableReader object at the wrong time.";
+    return key_;
+  }
+
+  T &Value() {
+    if (state_ != kHaveObject)
+      KALDI_ERR << "Value() called on TableReader object at the wrong time.";
+    return holder_.Value();
+  }
+
+  virtual void FreeCurrent() {
+    if (state_ == kHaveObject) {
+      holder_.Clear();
+      state_ = kFreedObject;
+    } else {
+      KALDI_WARN << "FreeCurrent called at the wrong time.";
+    }
+  }
+
+  void SwapHolder(Holder *other_holder) {
+    if (state_ == kHaveObject) {
+      holder_.Swap(other_holder);
+      state_ = kFreedObject;
+    } else {
+      KALDI_ERR << "SwapHolder called at the wrong time "
+                   "(error related to ',bg' modifier).";
+    }
+  }
+
+  virtual bool Close() {
+    if (!this->IsOpen())
+      KALDI_ERR << "Close() called on TableReader twice or otherwise wrongly.";
+    if (input_.IsOpen())
+      input_.Close();
+    if (state_ == kHaveObject)
+      holder_.Clear();
+    StateType old_state = state_;
+    state_ = kUninitialized;
+    if (old_state == kError) {
+      if (opts_.permissive) {
+        KALDI_WARN << "Error detected closing TableReader for sharded archive "
+                   << prefix_ << " but ignoring it as permissive mode "
+                   << "specified.";
+        return true;
+      }
+      return false;
+    }
+    return true;
+  }
+
+  virtual ~SequentialTableReaderShardedArchiveImpl() {
+    if (this->IsOpen() && !Close())
+      KALDI_ERR << "TableReader: error detected closing sharded archive "
+                << prefix_;
+  }
+ private:
+  Input input_;  // Reused for all the objects, so that it can keep the
+                 // current shard open.
+  Holder holder_;
+  std::string key_;
+  std::string rspecifier_;
+  std::string prefix_;
+  RspecifierOptions opts_;
+  std::vector<std::string> shards_;  // The shards we read, in order.
+  int32 shard_;  // The current shard, or -1 before the first one.
+  std::vector<std::pair<std::string, size_t> > index_;  // The current shard's.
+  size_t pos_;  // Position in index_ of the current object.
+  enum StateType {
+    kUninitialized,  // Uninitialized or closed.
+    kFileStart,      // [state we use internally: just opened.]
+    kEof,            // We read all the shards.
+    kError,          // Some error (not in permissive mode).
+    kHaveObject,     // holder_ has the object for key_.
+    kFreedObject,    // The user called FreeCurrent() or SwapHolder().
+  } state_;
+};
+
 // this is for when someone adds the 'th' modifier; it wraps around the basic
 // implementation and allows it to do the reading in a background thread.
 template<class Holder>
@@ -853,6 +1044,346 @@ class SequentialTableReaderBackgroundImpl:
 
 };
 
+// This is for when someone adds the 'pf' modifier (see RspecifierOptions).  It
+// keeps up to "queue_depth" objects ahead of the one the user is at.  For
+// script files, the objects are read (and, e.g. for compressed matrices,
+// uncompressed) by "num_threads" threads in parallel, each from its own
+// rxfilename, and handed to the user in the order of the script file; for
+// archives, in which an object can only be found by reading the ones before
+// it, and for sharded archives, they are read by one thread.
+template<class Holder>
+class SequentialTableReaderPrefetchImpl:
+      public SequentialTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  SequentialTableReaderPrefetchImpl(int32 queue_depth, int32 num_threads):
+      queue_depth_(queue_depth), num_threads_(num_threads),
+      archive_reader_(NULL), current_(NULL), is_open_(false),
+      input_done_(false), error_(false), stop_(false) {
+    KALDI_ASSERT(queue_depth > 0 && num_threads > 0);
+  }
+
+  virtual bool Open(const std::string &rspecifier) {
+    std::string rxfilename;
+    RspecifierType rs = ClassifyRspecifier(rspecifier, &rxfilename, &opts_);
+    if (rs == kArchiveRspecifier || rs == kShardedArchiveRspecifier) {
+      if (rs == kArchiveRspecifier)
+        archive_reader_ = new SequentialTableReaderArchiveImpl<Holder>();
+      else
+        archive_reader_ = new SequentialTableReaderShardedArchiveImpl<Holder>();
+      if (!archive_reader_->Open(rspecifier)) {
+        delete archive_reader_;
+        archive_reader_ = NULL;
+        return false;
+      }
+      threads_.push_back(std::thread(
+          &SequentialTableReaderPrefetchImpl<Holder>::ReadArchive, this));
+    } else {
+      KALDI_ASSERT(rs == kScriptRspecifier);
+      bool binary;
+      script_rxfilename_ = rxfilename;
+      if (!script_input_.Open(rxfilename, &binary)) {
+        KALDI_WARN << "Failed to open script file "
+                   << PrintableRxfilename(rxfilename);
+        return false;
+      }
+      if (binary) {
+        KALDI_WARN << "Script file should not be binary file.";
+        script_input_.Close();
+        return false;
+      }
+      for (int32 i = 0; i < num_threads_; i++)
+        threads_.push_back(std::thread(
+            &SequentialTableReaderPrefetchImpl<Holder>::ReadScpEntries, this));
+    }
+    is_open_ = true;
+    Next();
+    return true;
+  }
+
+  virtual bool IsOpen() const { return is_open_; }
+
+  virtual bool Done() const {
+    if (!is_open_)
+      KALDI_ERR << "Done() called on TableReader object at the wrong time.";
+    return current_ == NULL;
+  }
+
+  virtual std::string Key() {
+    if (current_ == NULL)
+      KALDI_ERR << "Calling Key() at the wrong time.";
+    return current_->key;
+  }
+
+  virtual T &Value() {
+    if (current_ == NULL)
+      KALDI_ERR << "Calling Value() at the wrong time.";
+    if (current_->state != Item::kLoaded)
+      KALDI_ERR << "Failed to load object from "
+                << PrintableRxfilename(current_->rxfilename)
+                << " (to suppress this error, add the permissive "
+                << "(p, ) option to the rspecifier.";
+    return current_->holder.Value();
+  }
+
+  virtual void FreeCurrent() {
+    if (current_ == NULL)
+      KALDI_ERR << "Calling FreeCurrent() at the wrong time.";
+    current_->holder.Clear();
+  }
+
+  void SwapHolder(Holder *other_holder) {
+    KALDI_ERR << "SwapHolder() should not be called on this class.";
+  }
+
+  virtual void Next() {
+    if (!is_open_)
+      KALDI_ERR << "Next() called on TableReader object at the wrong time.";
+    delete current_;
+    current_ = NULL;
+    while (true) {
+      if (archive_reader_ == NULL)
+        ReadScpLines();
+      std::unique_lock<std::mutex> lock(mutex_);
+      // wait for the next object in order.
+      while (!(items_.empty() ? input_done_ :
+               items_.front()->state != Item::kPending))
+        consumer_cond_.wait(lock);
+      if (items_.empty())
+        return;
+      Item *item = items_.front();
+      items_.pop_front();
+      producer_cond_.notify_all();  // there is room for one more.
+      if (item->state == Item::kFailed && opts_.permissive) {
+        delete item;  // treat it as if it was not there.
+      } else {
+        current_ = item;
+        return;
+      }
+    }
+  }
+
+  // Returns false if there was an error in the script file or the archive,
+  // like the other implementations.
+  virtual bool Close() {
+    if (!is_open_)
+      KALDI_ERR << "Close() called on input that was not open.";
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    producer_cond_.notify_all();
+    for (size_t i = 0; i < threads_.size(); i++)
+      threads_[i].join();
+    threads_.clear();
+    delete current_;
+    current_ = NULL;
+    for (size_t i = 0; i < items_.size(); i++)
+      delete items_[i];
+    items_.clear();
+    todo_.clear();
+    is_open_ = false;
+    bool ans = !error_;
+    if (archive_reader_ != NULL) {
+      try {
+        ans = archive_reader_->Close() && ans;
+      } catch (...) {
+        ans = false;
+      }
+      delete archive_reader_;
+      archive_reader_ = NULL;
+    } else if (script_input_.IsOpen()) {
+      // the status of a pipe only tells us something if we read it all.
+      int32 status = script_input_.Close();
+      if (input_done_ && status != 0) ans = false;
+    }
+    if (!ans && opts_.permissive) {
+      KALDI_WARN << "Close() called on input with read error, ignoring the "
+          "error because permissive mode specified.";
+      ans = true;
+    }
+    return ans;
+  }
+
+  virtual ~SequentialTableReaderPrefetchImpl() {
+    if (is_open_ && !Close())
+      KALDI_ERR << "TableReader: error detected closing reader "
+                << "(relates to ',pf' modifier)";
+  }
+
+ private:
+  struct Item {
+    enum { kPending, kLoaded, kFailed } state;
+    std::string key;
+    std::string rxfilename;  // for script files.
+    std::string range;  // for script files, if the line had a range.
+    Holder holder;
+    Item(): state(kPending) { }
+  };
+
+  // Called in the consumer thread, with mutex_ not locked: reads lines of the
+  // script file until there are queue_depth_ objects ahead of the user.  Only
+  // this thread reads the script file, adds to items_ and, for script files,
+  // sets input_done_, so the lock is only taken around the queue updates and
+  // the threads are not held up by a slow script file (e.g. a pipe).
+  void ReadScpLines() {
+    if (input_done_)
+      return;
+    size_t num_queued;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      num_queued = items_.size();
+    }
+    std::vector<Item*> new_items;
+    bool done = false, error = false;
+    std::string line, rest;
+    while (num_queued + new_items.size() <
+           static_cast<size_t>(queue_depth_)) {
+      if (!std::getline(script_input_.Stream(), line)) {
+        done = true;
+        break;
+      }
+      Item *item = new Item();
+      SplitStringOnFirstSpace(line, &(item->key), &rest);
+      bool ok = !item->key.empty() && !rest.empty();
+      if (ok && rest[rest.size() - 1] == ']')
+        ok = ExtractRangeSpecifier(rest, &(item->rxfilename), &(item->range));
+      else
+        item->rxfilename = rest;
+      if (!ok) {
+        KALDI_WARN << "We got an invalid line in the scp file. "
+                   << "It should look like: some_key 1.ark:10, got: "
+                   << line;
+        delete item;
+        error = done = true;
+        break;
+      }
+      new_items.push_back(item);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      items_.insert(items_.end(), new_items.begin(), new_items.end());
+      todo_.insert(todo_.end(), new_items.begin(), new_items.end());
+      if (error) error_ = true;
+      if (done) input_done_ = true;
+    }
+    producer_cond_.notify_all();
+  }
+
+  // The work of the threads for script files.
+  void ReadScpEntries() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      while (todo_.empty() && !stop_)
+        producer_cond_.wait(lock);
+      if (stop_) return;
+      Item *item = todo_.front();
+      todo_.pop_front();
+      lock.unlock();
+      bool ok = LoadItem(item);
+      lock.lock();
+      item->state = (ok ? Item::kLoaded : Item::kFailed);
+      consumer_cond_.notify_all();
+    }
+  }
+
+  // Reads the object of a line of the script file, like
+  // SequentialTableReaderScriptImpl::EnsureObjectLoaded().
+  static bool LoadItem(Item *item) {
+    try {
+      Input input;
+      bool ans = (Holder::IsReadInBinary() ?
+                  input.Open(item->rxfilename, NULL) :
+                  input.OpenTextMode(item->rxfilename));
+      if (!ans) {
+        KALDI_WARN << "Failed to open file "
+                   << PrintableRxfilename(item->rxfilename);
+        return false;
+      }
+      Holder whole_holder;
+      Holder *holder = (item->range.empty() ? &(item->holder) : &whole_holder);
+      if (!holder->Read(input.Stream())) {
+        KALDI_WARN << "Failed to load object from "
+                   << PrintableRxfilename(item->rxfilename);
+        return false;
+      }
+      if (!item->range.empty() &&
+          !item->holder.ExtractRange(whole_holder, item->range)) {
+        KALDI_WARN << "Failed to load object from "
+                   << PrintableRxfilename(item->rxfilename)
+                   << "[" << item->range << "]";
+        return false;
+      }
+      return true;
+    } catch (...) {
+      // e.g. a holder that does not support ranges; Value() will report it.
+      return false;
+    }
+  }
+
+  // The work of the thread for archives.
+  void ReadArchive() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      while (items_.size() >= static_cast<size_t>(queue_depth_) && !stop_)
+        producer_cond_.wait(lock);
+      if (stop_) return;
+      lock.unlock();
+      Item *item = NULL;
+      try {
+        if (!archive_reader_->Done()) {
+          item = new Item();
+          item->key = archive_reader_->Key();
+          archive_reader_->SwapHolder(&(item->holder));
+          item->state = Item::kLoaded;
+          archive_reader_->Next();
+        }
+      } catch (...) {
+        // SwapHolder() only fails on code error; Close() reports the error.
+        delete item;
+        item = NULL;
+        lock.lock();
+        error_ = true;
+        input_done_ = true;
+        consumer_cond_.notify_all();
+        return;
+      }
+      lock.lock();
+      if (item == NULL) {
+        input_done_ = true;
+        consumer_cond_.notify_all();
+        return;
+      }
+      items_.push_back(item);
+      consumer_cond_.notify_all();
+    }
+  }
+
+  int32 queue_depth_;
+  int32 num_threads_;
+  RspecifierOptions opts_;
+  std::string script_rxfilename_;
+  Input script_input_;  // for script files; only used by the consumer.
+  SequentialTableReaderImplBase<Holder> *archive_reader_;  // for archives.
+
+  Item *current_;  // the object the user is at, or NULL if Done().
+  bool is_open_;
+
+  // The following are guarded by mutex_.
+  std::mutex mutex_;
+  // The threads wait on producer_cond_ for work or room; the user waits on
+  // consumer_cond_ for the next object.
+  std::condition_variable producer_cond_;
+  std::condition_variable consumer_cond_;
+  std::deque<Item*> items_;  // the objects after current_, in order.
+  std::deque<Item*> todo_;  // the items_ no thread has started to read.
+  bool input_done_;  // true if we reached the end of the input.
+  bool error_;  // true if the script file was invalid or reading failed.
+  bool stop_;  // set by Close() to stop the threads.
+  std::vector<std::thread> threads_;
+};
+
 template<class Holder>
 SequentialTableReader<Holder>::SequentialTableReader(const std::string
                                                      &rspecifier): impl_(NULL) {
@@ -869,6 +1400,16 @@ bool SequentialTableReader<Holder>::Open(const std::string &rspecifier) {
 
   RspecifierOptions opts;
   RspecifierType wt = ClassifyRspecifier(rspecifier, NULL, &opts);
+  if (opts.prefetch_depth > 0 && wt != kNoRspecifier) {
+    impl_ = new SequentialTableReaderPrefetchImpl<Holder>(
+        opts.prefetch_depth, opts.prefetch_threads);
+    if (!impl_->Open(rspecifier)) {
+      delete impl_;
+      impl_ = NULL;
+      return false;
+    }
+    return true;
+  }
   switch (wt) {
     case kArchiveRspecifier:
       impl_ = new SequentialTableReaderArchiveImpl<Holder>();
@@ -876,6 +1417,9 @@ bool SequentialTableReader<Holder>::Open(const std::string &rspecifier) {
     case kScriptRspecifier:
       impl_ = new SequentialTableReaderScriptImpl<Holder>();
       break;
+    case kShardedArchiveRspecifier:
+      impl_ = new SequentialTableReaderShardedArchiveImpl<Holder>();
+      break;
     case kNoRspecifier: default:
       KALDI_WARN << "Invalid rspecifier " << rspecifier;
       return false;
@@ -1463,6 +2007,142 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
 };
 
 
+// The implementation of TableWriter we use when writing a shard of a sharded
+// archive ("sark:prefix").  It writes an archive, remembering the offsets of
+// the objects, and Close() writes the index of the shard after them.
+template<class Holder>
+class TableWriterShardedArchiveImpl: public TableWriterImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  virtual bool Open(const std::string &wspecifier) {
+    switch (state_) {
+      case kUninitialized:
+        break;
+      case kWriteError:
+        KALDI_ERR << "Opening stream, already open with write error.";
+      case kOpen: default:
+        if (!Close())
+          KALDI_ERR << "Opening stream, error closing previously open stream.";
+    }
+    wspecifier_ = wspecifier;
+    std::string prefix;
+    WspecifierType ws = ClassifyWspecifier(wspecifier, &prefix, NULL, &opts_);
+    KALDI_ASSERT(ws == kShardedArchiveWspecifier);  // or wrongly called.
+    if (ClassifyWxfilename(prefix) != kFileOutput) {
+      KALDI_WARN << "Sharded archives must be written to files: "
+                 << wspecifier;
+      return false;
+    }
+    int32 shard = (opts_.shard >= 0 ? opts_.shard : CreateShard(prefix));
+    if (shard < 0)
+      return false;
+    shard_wxfilename_ = ShardFilename(prefix, shard);
+    index_.clear();
+    // The offsets must be exact, so always open the file in binary mode.
+    if (output_.Open(shard_wxfilename_, true, false)) {
+      state_ = kOpen;
+      return true;
+    } else {
+      state_ = kUninitialized;
+      return false;
+    }
+  }
+
+  virtual bool IsOpen() const {
+    switch (state_) {
+      case kUninitialized: return false;
+      case kOpen: case kWriteError: return true;
+      default: KALDI_ERR << "IsOpen() called on TableWriter in invalid state.";
+    }
+    return false;
+  }
+
+  virtual bool Write(const std::string &key, const T &value) {
+    switch (state_) {
+      case kOpen: break;
+      case kWriteError:
+        KALDI_WARN << "Attempting to write to invalid stream.";
+        return false;
+      case kUninitialized: default:
+        KALDI_ERR << "Write called on invalid stream";
+    }
+    if (!IsToken(key))  // e.g. empty string or has spaces...
+      KALDI_ERR << "Using invalid key " << key;
+    std::ostream &os = output_.Stream();
+    os << key << ' ';
+    size_t offset = os.tellp();
+    if (!Holder::Write(os, opts_.binary, value) || os.fail()) {
+      KALDI_WARN << "Write failure to "
+                 << PrintableWxfilename(shard_wxfilename_);
+      state_ = kWriteError;
+      return false;
+    }
+    index_.push_back(std::make_pair(key, offset));
+    if (opts_.flush)
+      Flush();
+    return true;
+  }
+
+  virtual void Flush() {
+    switch (state_) {
+      case kWriteError: case kOpen:
+        output_.Stream().flush();  // Don't check error status.
+        return;
+      default:
+        KALDI_WARN << "Flush called on not-open writer.";
+    }
+  }
+
+  virtual bool Close() {
+    if (!this->IsOpen() || !output_.IsOpen())
+      KALDI_ERR << "Close called on a stream that was not open.";
+    std::ostream &os = output_.Stream();
+    size_t index_offset = os.tellp();
+    bool index_success = WriteShardIndex(os, index_offset, index_);
+    index_.clear();
+    bool close_success = output_.Close();
+    bool write_error = (state_ == kWriteError);
+    state_ = kUninitialized;
+    if (!index_success || !close_success) {
+      KALDI_WARN << "Error closing shard "
+                 << PrintableWxfilename(shard_wxfilename_)
+                 << ": wspecifier is " << wspecifier_;
+      return false;
+    }
+    if (write_error) {
+      KALDI_WARN << "Closing writer in error state: wspecifier is "
+                 << wspecifier_;
+      return false;
+    }
+    return true;
+  }
+
+  TableWriterShardedArchiveImpl(): state_(kUninitialized) {}
+
+  // May throw on write error if Close was not called.
+  virtual ~TableWriterShardedArchiveImpl() {
+    if (!IsOpen()) return;
+    else if (!Close())
+      KALDI_ERR << "At TableWriter destructor: Write failed or stream close "
+                << "failed: wspecifier is " << wspecifier_;
+  }
+
+ private:
+  Output output_;
+  WspecifierOptions opts_;
+  std::string wspecifier_;
+  std::string shard_wxfilename_;  // e.g. prefix.3
+  // The keys and offsets of the objects written so far.
+  std::vector<std::pair<std::string, size_t> > index_;
+  enum {               // is stream open?
+    kUninitialized,    // no
+    kOpen,             // yes
+    kWriteError,       // yes
+  } state_;
+};
+
+
 template<class Holder>
 TableWriter<Holder>::TableWriter(const std::string &wspecifier): impl_(NULL) {
   if (wspecifier != "" && !Open(wspecifier))
@@ -1494,6 +2174,9 @@ bool TableWriter<Holder>::Open(const std::string &wspecifier) {
     case kScriptWspecifier:
       impl_ = new TableWriterScriptImpl<Holder>();
       break;
+    case kShardedArchiveWspecifier:
+      impl_ = new TableWriterShardedArchiveImpl<Holder>();
+      break;
     case kNoWspecifier: default:
       KALDI_WARN << "ClassifyWspecifier: invalid wspecifier " << wspecifier;
       return false;
@@ -1655,6 +2338,7 @@ class RandomAccessTableReaderScriptImpl:
                    " open.";
     holder_.Clear();
     range_holder_.Clear();
+    mapped_input_.Close();
     state_ = kUninitialized;
     last_found_ = 0;
     script_.clear();
@@ -1764,13 +2448,18 @@ class RandomAccessTableReaderScriptImpl:
         data_rxfilename_ = data_rxfilename;
         range_ = range;
         if (state_ == kNotHaveObject) {
-          // we need to read the object.
-          if (!input_.Open(data_rxfilename)) {
+          // we need to read the object.  With the "mm" option we read
+          // objects in archives from the memory-mapped archive.
+          bool mapped = opts_.mmap &&
+              ClassifyRxfilename(data_rxfilename) == kOffsetFileInput;
+          if (!(mapped ? mapped_input_.Open(data_rxfilename) :
+                input_.Open(data_rxfilename))) {
             KALDI_WARN << "Error opening stream "
                        << PrintableRxfilename(data_rxfilename);
             return false;
           } else {
-            if (holder_.Read(input_.Stream())) {
+            if (holder_.Read(mapped ? mapped_input_.Stream() :
+                             input_.Stream())) {
               state_ = kHaveObject;
             } else {
               KALDI_WARN << "Error reading object from "
@@ -1831,6 +2520,8 @@ class RandomAccessTableReaderScriptImpl:
   Input input_;  // Use the same input_ object for reading each file, in case
                  // the scp specifies offsets in an archive so we can keep the
                  // same file open.
+  MappedInput mapped_input_;  // Used instead of input_ for offsets in archives
+                              // if opts_.mmap.
   RspecifierOptions opts_;
   std::string rspecifier_;  // rspecifier used to open this object; used in
                             // debug messages
@@ -1883,6 +2574,140 @@ class RandomAccessTableReaderScriptImpl:
 
 
 
+// Implementation of RandomAccessTableReader for a sharded archive
+// ("sark:prefix").  Open() reads the indexes of all the shards into a hash
+// table, so looking up a key takes constant time, and the object is read from
+// its offset in its shard (from a memory-mapped shard with the "mm" option).
+template<class Holder>
+class RandomAccessTableReaderShardedArchiveImpl:
+      public RandomAccessTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  RandomAccessTableReaderShardedArchiveImpl(): is_open_(false),
+                                               have_object_(false) { }
+
+  virtual bool Open(const std::string &rspecifier) {
+    if (is_open_)
+      KALDI_ERR << "Opening already open RandomAccessTableReader:"
+                   " call Close first.";
+    rspecifier_ = rspecifier;
+    std::string prefix;
+    RspecifierType rs = ClassifyRspecifier(rspecifier, &prefix, &opts_);
+    KALDI_ASSERT(rs == kShardedArchiveRspecifier);  // or wrongly called.
+    if (!ListShards(prefix, &shards_))
+      return false;
+    std::vector<std::pair<std::string, size_t> > index;
+    for (size_t i = 0; i < shards_.size(); i++) {
+      if (!ReadShardIndex(shards_[i], &index)) {
+        if (opts_.permissive) continue;
+        Clear();
+        return false;
+      }
+      for (size_t j = 0; j < index.size(); j++) {
+        std::pair<int32, size_t> &location = index_[index[j].first];
+        if (location.second != 0) {  // an offset is never 0 (a key precedes).
+          KALDI_WARN << "Sharded archive " << prefix
+                     << " contains duplicate key " << index[j].first;
+          Clear();
+          return false;
+        }
+        location = std::make_pair(static_cast<int32>(i), index[j].second);
+      }
+    }
+    is_open_ = true;
+    return true;
+  }
+
+  virtual bool HasKey(const std::string &key) {
+    if (!is_open_)
+      KALDI_ERR << "HasKey called on RandomAccessTableReader object that is"
+                   " not open.";
+    // In permissive mode, we have to check that we can read the object.
+    if (opts_.permissive)
+      return LoadObject(key);
+    return index_.count(key) != 0;
+  }
+
+  virtual const T &Value(const std::string &key) {
+    if (!is_open_)
+      KALDI_ERR << "Value called on RandomAccessTableReader object that is"
+                   " not open.";
+    if (!LoadObject(key))
+      KALDI_ERR << "Could not get item for key " << key
+                << ", rspecifier is " << rspecifier_ << " [to ignore this, "
+                << "add the p, (permissive) option to the rspecifier.";
+    return holder_.Value();
+  }
+
+  virtual bool Close() {
+    if (!is_open_)
+      KALDI_ERR << "Close() called on RandomAccessTableReader that was not"
+                   " open.";
+    Clear();
+    return true;
+  }
+
+  virtual ~RandomAccessTableReaderShardedArchiveImpl() { }
+
+ private:
+  // Makes holder_ contain the object for "key", if it is in the archive;
+  // returns false if it is not or cannot be read.
+  bool LoadObject(const std::string &key) {
+    if (have_object_ && key == key_)
+      return true;
+    typename IndexType::const_iterator iter = index_.find(key);
+    if (iter == index_.end())
+      return false;
+    have_object_ = false;
+    holder_.Clear();
+    std::ostringstream rxfilename;
+    rxfilename << shards_[iter->second.first] << ':' << iter->second.second;
+    // Only objects read in binary are mapped; the others are opened in text
+    // mode, as in the sequential reader.
+    bool mmap = opts_.mmap && Holder::IsReadInBinary();
+    bool ans = (mmap ? mapped_input_.Open(rxfilename.str()) :
+                Holder::IsReadInBinary() ? input_.Open(rxfilename.str()) :
+                input_.OpenTextMode(rxfilename.str()));
+    if (!ans || !holder_.Read(mmap ? mapped_input_.Stream() :
+                              input_.Stream())) {
+      KALDI_WARN << "Error reading object from " << rxfilename.str();
+      return false;
+    }
+    key_ = key;
+    have_object_ = true;
+    return true;
+  }
+
+  void Clear() {
+    holder_.Clear();
+    have_object_ = false;
+    key_ = "";
+    IndexType().swap(index_);
+    shards_.clear();
+    if (input_.IsOpen()) input_.Close();
+    mapped_input_.Close();
+    is_open_ = false;
+  }
+
+  // Maps each key to its shard (the position in shards_) and the offset of
+  // its object.
+  typedef unordered_map<std::string, std::pair<int32, size_t>,
+                        StringHasher> IndexType;
+
+  Input input_;  // Reused for all the objects, as it can keep a shard open.
+  MappedInput mapped_input_;  // Used instead of input_ if opts_.mmap.
+  RspecifierOptions opts_;
+  std::string rspecifier_;
+  std::vector<std::string> shards_;
+  IndexType index_;
+  bool is_open_;
+  Holder holder_;
+  bool have_object_;  // true if holder_ has the object for key_.
+  std::string key_;
+};
+
+
 // This is the base-class (with some implemented functions) for the
 // implementations of RandomAccessTableReader when it's an archive.  This
 // base-class handles opening the files, storing the state of the reading
@@ -2523,6 +3348,9 @@ bool RandomAccessTableReader<Holder>::Open(const std::string &rspecifier) {
     case kScriptRspecifier:
       impl_ = new RandomAccessTableReaderScriptImpl<Holder>();
       break;
+    case kShardedArchiveRspecifier:
+      impl_ = new RandomAccessTableReaderShardedArchiveImpl<Holder>();
+      break;
     case kArchiveRspecifier:
       if (opts.sorted) {
         if (opts.called_sorted)  // "doubly" sorted case.
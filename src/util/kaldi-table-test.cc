@@ -22,6 +22,8 @@
 #include "util/kaldi-table.h"
 #include "util/kaldi-holder.h"
 #include "util/table-types.h"
+#include "base/timer.h"
+#include <thread>
 
 namespace kaldi {
 
@@ -89,6 +91,19 @@ void UnitTestReadScriptFile() {
 
 
 void UnitTestClassifyWspecifier() {
+  {
+    std::string a = "sark,shard=3:foo", ark;
+    WspecifierOptions opts;
+    WspecifierType ans = ClassifyWspecifier(a, &ark, NULL, &opts);
+    KALDI_ASSERT(ans == kShardedArchiveWspecifier && ark == "foo" &&
+                 opts.shard == 3);
+    KALDI_ASSERT(ClassifyWspecifier("sark:foo", NULL, NULL, &opts) ==
+                 kShardedArchiveWspecifier && opts.shard == -1);
+    KALDI_ASSERT(ClassifyWspecifier("sark,scp:foo,bar", NULL, NULL, NULL) ==
+                 kNoWspecifier);
+    KALDI_ASSERT(ClassifyWspecifier("sark,shard=x:foo", NULL, NULL, NULL) ==
+                 kNoWspecifier);
+  }
   {
     std::string a = "b,ark:foo|";
     std::string ark = "x", scp = "y";
@@ -303,6 +318,59 @@ void UnitTestClassifyRspecifier() {
     KALDI_ASSERT(ans == kNoRspecifier);
   }
 
+  {
+    std::string a = "ark,pf:foo|", b;
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &b, &opts);
+    KALDI_ASSERT(ans == kArchiveRspecifier && b == "foo|" &&
+                 opts.prefetch_depth == 16 && opts.prefetch_threads == 4);
+  }
+  {
+    std::string a = "scp,pfj=8,p:foo", b;
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &b, &opts);
+    KALDI_ASSERT(ans == kScriptRspecifier && b == "foo" && opts.permissive &&
+                 opts.prefetch_depth == 16 && opts.prefetch_threads == 8);
+  }
+  {
+    std::string a = "scp,pf=32,pfj=2:foo", b;
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &b, &opts);
+    KALDI_ASSERT(ans == kScriptRspecifier && opts.prefetch_depth == 32 &&
+                 opts.prefetch_threads == 2);
+  }
+  {
+    RspecifierOptions opts;
+    KALDI_ASSERT(ClassifyRspecifier("ark:foo", NULL, &opts) ==
+                 kArchiveRspecifier && opts.prefetch_depth == 0);
+    KALDI_ASSERT(ClassifyRspecifier("ark,pf=0:foo", NULL, NULL) ==
+                 kNoRspecifier);
+    KALDI_ASSERT(ClassifyRspecifier("ark,pf=x:foo", NULL, NULL) ==
+                 kNoRspecifier);
+    KALDI_ASSERT(ClassifyRspecifier("ark,pfj=-1:foo", NULL, NULL) ==
+                 kNoRspecifier);
+  }
+  {
+    std::string a = "sark,part=1/4:foo", b;
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &b, &opts);
+    KALDI_ASSERT(ans == kShardedArchiveRspecifier && b == "foo" &&
+                 opts.part == 1 && opts.num_parts == 4);
+    KALDI_ASSERT(ClassifyRspecifier("sark,part=4/4:foo", NULL, NULL) ==
+                 kNoRspecifier);
+    KALDI_ASSERT(ClassifyRspecifier("ark,sark:foo", NULL, NULL) ==
+                 kNoRspecifier);
+  }
+  {
+    std::string a = "scp,mm,p:foo", b;
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &b, &opts);
+    KALDI_ASSERT(ans == kScriptRspecifier && b == "foo" && opts.mmap &&
+                 opts.permissive);
+    KALDI_ASSERT(ClassifyRspecifier("scp:foo", NULL, &opts) ==
+                 kScriptRspecifier && !opts.mmap);
+  }
+
   // Testing it accepts the meaningless t, and b, prefixes.
   {
     std::string a = "b,scp:a", b;
@@ -636,8 +704,9 @@ void UnitTestTableSequentialInt32Script(bool binary) {
   ans = bw.Close();
   KALDI_ASSERT(ans);
 
-  SequentialInt32Reader sbr(RandInt(0, 1) == 0 ?
-                            "scp:tmp.scp" : "scp,bg:tmp.scp");
+  const char *rspecifiers[] = { "scp:tmp.scp", "scp,bg:tmp.scp",
+                                "scp,pf:tmp.scp", "scp,pf=1:tmp.scp" };
+  SequentialInt32Reader sbr(rspecifiers[RandInt(0, 3)]);
   std::vector<std::string> k2;
   std::vector<int32> v2;
   for (; !sbr.Done(); sbr.Next()) {
@@ -731,10 +800,10 @@ void UnitTestTableSequentialBaseFloatVectorBoth(bool binary, bool read_scp) {
   ans = bw.Close();
   KALDI_ASSERT(ans);
 
+  const char *options[] = { "", ",bg", ",pf", ",pf=2,pfj=3" };
   SequentialBaseFloatVectorReader sbr(
-      RandInt(0, 1) == 0 ?
-      (read_scp ? "scp:tmpf.scp" : "ark:tmpf") :
-      (read_scp ? "scp,bg:tmpf.scp" : "ark,bg:tmpf"));
+      (read_scp ? "scp" : "ark") + std::string(options[RandInt(0, 3)]) +
+      (read_scp ? ":tmpf.scp" : ":tmpf"));
   std::vector<std::string> k2;
   std::vector<Vector<BaseFloat>* > v2;
   for (; !sbr.Done(); sbr.Next()) {
@@ -808,6 +877,7 @@ void UnitTestTableRandomBothDouble(bool binary, bool read_scp,
   else if (Rand()%2 == 0) name += "ncs,";
   if (once) name += "o,";
   else if (Rand()%2 == 0) name += "no,";
+  if (Rand()%2 == 0) name += "mm,";
   name += std::string(read_scp ? "scp:tmpf.scp" : "ark:tmpf");
 
   RandomAccessDoubleReader sbr(name);
@@ -935,9 +1005,9 @@ void UnitTestRangesMatrix(bool binary) {
 
   {  // test random-access reading.
     bool permissive = (RandInt(0, 1) == 0);
-    RandomAccessDoubleMatrixReader reader(permissive ?
-                                          "scp,p:tmpf_ranges.scp" :
-                                          "scp:tmpf_ranges.scp");
+    std::string mmap = (RandInt(0, 1) == 0 ? "" : ",mm");
+    RandomAccessDoubleMatrixReader reader(
+        (permissive ? "scp,p" : "scp") + mmap + ":tmpf_ranges.scp");
 
     int32 num_queries = RandInt(0, 10);
     for (int32 n = 0; n < num_queries; n++) {
@@ -957,9 +1027,9 @@ void UnitTestRangesMatrix(bool binary) {
 
   {  // test sequential reading.
     bool permissive = (RandInt(0, 1) == 0);
-    SequentialBaseFloatMatrixReader reader(permissive ?
-                                           "scp,p:tmpf_ranges.scp" :
-                                           "scp:tmpf_ranges.scp");
+    std::string prefetch = (RandInt(0, 1) == 0 ? "" : ",pf=3,pfj=2");
+    SequentialBaseFloatMatrixReader reader(
+        (permissive ? "scp,p" : "scp") + prefetch + ":tmpf_ranges.scp");
 
     int32 i = 0;
     for (; !reader.Done(); reader.Next(), i++) {
@@ -1016,6 +1086,7 @@ void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
   else if (Rand()%2 == 0) name += "ncs,";
   if (once) name += "o,";
   else if (Rand()%2 == 0) name += "no,";
+  if (Rand()%2 == 0) name += "mm,";
   name += std::string(read_scp ? "scp:tmpf.scp" : "ark:tmpf");
   RandomAccessDoubleMatrixReader sbr(name);
 
@@ -1051,6 +1122,187 @@ void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
 }
 
 
+// Reads compressed matrices as matrices with the "pf" option, from the
+// archive, from the scp file, and from an scp file with missing entries.
+void UnitTestTablePrefetchCompressedMatrix() {
+  int32 num_mats = RandInt(0, 50);
+  std::vector<std::string> keys;
+  std::vector<Matrix<BaseFloat> > mats(num_mats);
+  {
+    CompressedMatrixWriter writer("ark,scp:tmpf,tmpf.scp");
+    for (int32 i = 0; i < num_mats; i++) {
+      keys.push_back("utt" + std::to_string(1000 + i));
+      Matrix<BaseFloat> mat(RandInt(1, 20), RandInt(1, 20));
+      mat.SetRandn();
+      CompressedMatrix cmat(mat);
+      mats[i].Resize(mat.NumRows(), mat.NumCols());
+      cmat.CopyToMat(&(mats[i]));
+      writer.Write(keys[i], cmat);
+    }
+  }
+  {
+    // every third entry does not exist.
+    Output output("tmpf_missing.scp", false);
+    bool binary;
+    Input input("tmpf.scp", &binary);
+    std::string line;
+    for (int32 i = 0; getline(input.Stream(), line); i++) {
+      output.Stream() << line << "\n";
+      if (i % 3 == 0)
+        output.Stream() << "missing" << i << " tmpf_nonexistent:0\n";
+    }
+  }
+
+  const char *rspecifiers[] = { "ark,pf=4:tmpf", "scp,pf=5,pfj=3:tmpf.scp",
+                                "scp,p,pf:tmpf_missing.scp" };
+  for (int32 r = 0; r < 3; r++) {
+    SequentialBaseFloatMatrixReader reader(rspecifiers[r]);
+    int32 i = 0;
+    for (; !reader.Done(); reader.Next(), i++) {
+      KALDI_ASSERT(reader.Key() == keys[i]);
+      if (RandInt(0, 2) == 0) {
+        reader.FreeCurrent();
+      } else {
+        KALDI_ASSERT(reader.Value().ApproxEqual(mats[i], 1.0e-10));
+      }
+      if (i == 10 && RandInt(0, 1) == 0)
+        break;  // closing the reader before the end.
+    }
+    KALDI_ASSERT((i == num_mats || i == 10) && reader.Close());
+  }
+  {
+    // Without the permissive option, Value() fails for the missing entries.
+    SequentialBaseFloatMatrixReader reader("scp,pf=2:tmpf_missing.scp");
+    if (num_mats > 0) {
+      reader.Next();
+      KALDI_ASSERT(reader.Key() == "missing0");
+      bool threw = false;
+      try {
+        reader.Value();
+      } catch (...) {
+        threw = true;
+      }
+      KALDI_ASSERT(threw);
+    }
+  }
+  unlink("tmpf");
+  unlink("tmpf.scp");
+  unlink("tmpf_missing.scp");
+}
+
+static void WriteShard(int32 first_key, int32 num_keys) {
+  BaseFloatVectorWriter writer("sark:tmpf_sark");
+  for (int32 i = first_key; i < first_key + num_keys; i++)
+    writer.Write("key" + std::to_string(i), Vector<BaseFloat>(i % 7));
+}
+
+// Writes a sharded archive from several threads, and reads it back with random
+// access and sequentially, by parts.
+void UnitTestTableShardedArchive() {
+  int32 num_threads = RandInt(1, 4), num_keys = 0;
+  std::vector<std::thread> threads;
+  for (int32 t = 0; t < num_threads; t++) {
+    threads.push_back(std::thread(WriteShard, num_keys, 10 * (t + 1)));
+    num_keys += 10 * (t + 1);
+  }
+  for (int32 t = 0; t < num_threads; t++)
+    threads[t].join();
+  {
+    // A shard written with the "shard" option, with an object in text mode.
+    BaseFloatVectorWriter writer("t,sark,shard=" + std::to_string(num_threads)
+                                 + ":tmpf_sark");
+    writer.Write("key" + std::to_string(num_keys),
+                 Vector<BaseFloat>(num_keys % 7));
+    num_keys++;
+  }
+
+  {
+    std::string rspecifier = (RandInt(0, 1) == 0 ? "sark:tmpf_sark" :
+                              "sark,mm:tmpf_sark");
+    RandomAccessBaseFloatVectorReader reader(rspecifier);
+    for (int32 n = 0; n < 50; n++) {
+      int32 i = RandInt(0, num_keys);
+      std::string key = "key" + std::to_string(i);
+      KALDI_ASSERT(reader.HasKey(key) == (i < num_keys));
+      if (i < num_keys)
+        KALDI_ASSERT(reader.Value(key).Dim() == i % 7);
+    }
+  }
+
+  // Reading by parts gives each key once.
+  int32 num_parts = RandInt(1, 3);
+  const char *options[] = { "", ",bg", ",pf=2" };
+  std::vector<std::string> keys;
+  for (int32 part = 0; part < num_parts; part++) {
+    SequentialBaseFloatVectorReader reader(
+        "sark,part=" + std::to_string(part) + "/" + std::to_string(num_parts) +
+        options[RandInt(0, 2)] + ":tmpf_sark");
+    for (; !reader.Done(); reader.Next())
+      keys.push_back(reader.Key());
+    KALDI_ASSERT(reader.Close());
+  }
+  KALDI_ASSERT(static_cast<int32>(keys.size()) == num_keys);
+  std::sort(keys.begin(), keys.end());
+  KALDI_ASSERT(std::adjacent_find(keys.begin(), keys.end()) == keys.end());
+
+  // A shard with no index (as if its writer was killed) can be skipped in
+  // permissive mode.
+  {
+    Output ko(ShardFilename("tmpf_sark", num_threads + 1), true, false);
+    ko.Stream() << "bad ";
+  }
+  {
+    RandomAccessBaseFloatVectorReader reader;
+    KALDI_ASSERT(!reader.Open("sark:tmpf_sark"));
+    KALDI_ASSERT(reader.Open("sark,p:tmpf_sark") && reader.HasKey("key0"));
+    SequentialBaseFloatVectorReader seq_reader("sark,p:tmpf_sark");
+    int32 n = 0;
+    for (; !seq_reader.Done(); seq_reader.Next())
+      n++;
+    KALDI_ASSERT(n == num_keys);
+  }
+  // A missing shard is an error, even in permissive mode.
+  unlink(ShardFilename("tmpf_sark", num_threads + 1).c_str());
+  {
+    Output ko(ShardFilename("tmpf_sark", num_threads + 2), true, false);
+    ko.Stream() << "bad ";
+  }
+  {
+    RandomAccessBaseFloatVectorReader reader;
+    KALDI_ASSERT(!reader.Open("sark,p:tmpf_sark"));
+    SequentialBaseFloatVectorReader seq_reader;
+    KALDI_ASSERT(!seq_reader.Open("sark,p:tmpf_sark"));
+  }
+  for (int32 t = 0; t <= num_threads + 2; t++)
+    unlink(ShardFilename("tmpf_sark", t).c_str());
+}
+
+// Compares the time to read and uncompress compressed matrices, with and
+// without "bg" and "pf".
+void TablePrefetchBenchmark() {
+  {
+    CompressedMatrixWriter writer("ark,scp:tmpf,tmpf.scp");
+    Matrix<BaseFloat> mat(1000, 40);
+    for (int32 i = 0; i < 500; i++) {
+      mat.SetRandn();
+      writer.Write("utt" + std::to_string(i), CompressedMatrix(mat));
+    }
+  }
+  const char *rspecifiers[] = { "ark:tmpf", "ark,bg:tmpf", "ark,pf:tmpf",
+                                "scp:tmpf.scp", "scp,pf:tmpf.scp" };
+  for (int32 r = 0; r < 5; r++) {
+    Timer timer;
+    double sum = 0.0;
+    SequentialBaseFloatMatrixReader reader(rspecifiers[r]);
+    for (; !reader.Done(); reader.Next())
+      sum += reader.Value().Sum();  // the "work" of the program.
+    KALDI_LOG << rspecifiers[r] << ": " << timer.Elapsed() << " seconds "
+              << "(sum " << sum << ")";
+  }
+  unlink("tmpf");
+  unlink("tmpf.scp");
+}
+
 
 }  // end namespace kaldi.
 
@@ -1087,6 +1339,11 @@ int main() {
       }
     }
   }
+  for (int i = 0; i < 10; i++)
+    UnitTestTablePrefetchCompressedMatrix();
+  for (int i = 0; i < 10; i++)
+    UnitTestTableShardedArchive();
+  TablePrefetchBenchmark();
   std::cout << "Test OK.\n";
   return 0;
 }
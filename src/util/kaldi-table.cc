@@ -17,6 +17,21 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _MSC_VER
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+#include <fcntl.h>
+
 #include "util/kaldi-table.h"
 #include "util/text-utils.h"
 
@@ -183,6 +198,15 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
       if (opts) opts->binary = false;
     } else if (!strcmp(c, "p")) {
       if (opts) opts->permissive = true;
+    } else if (!strncmp(c, "shard=", 6)) {
+      int32 n;
+      if (!ConvertStringToInteger(str.substr(6), &n) || n < 0)
+        return kNoWspecifier;
+      if (opts) opts->shard = n;
+    } else if (!strcmp(c, "sark")) {
+      if (ws == kNoWspecifier) ws = kShardedArchiveWspecifier;
+      else
+        return kNoWspecifier;
     } else if (!strcmp(c, "ark")) {
       if (ws == kNoWspecifier) ws = kArchiveWspecifier;
       else
@@ -199,7 +223,7 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
   }
 
   switch (ws) {
-    case kArchiveWspecifier:
+    case kArchiveWspecifier: case kShardedArchiveWspecifier:
       if (archive_wxfilename)
         *archive_wxfilename = after_colon;
       break;
@@ -221,6 +245,8 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
 }
 
 
+// The number of objects read ahead with the "pf" option.
+static const int32 kDefaultPrefetchDepth = 16;
 
 RspecifierType ClassifyRspecifier(const std::string &rspecifier,
                                   std::string *wxfilename,
@@ -293,6 +319,37 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
       if (opts) opts->called_sorted = false;
     } else if (!strcmp(c, "bg")) {
       if (opts) opts->background = true;
+    } else if (!strcmp(c, "pf")) {
+      if (opts) opts->prefetch_depth = kDefaultPrefetchDepth;
+    } else if (!strncmp(c, "pf=", 3) || !strncmp(c, "pfj=", 4)) {
+      bool depth = (c[2] == '=');
+      int32 n;
+      if (!ConvertStringToInteger(str.substr(depth ? 3 : 4), &n) || n <= 0)
+        return kNoRspecifier;
+      if (opts) {
+        if (depth) {
+          opts->prefetch_depth = n;
+        } else {
+          opts->prefetch_threads = n;
+          if (opts->prefetch_depth == 0)
+            opts->prefetch_depth = kDefaultPrefetchDepth;
+        }
+      }
+    } else if (!strcmp(c, "mm")) {
+      if (opts) opts->mmap = true;
+    } else if (!strncmp(c, "part=", 5)) {
+      std::vector<int32> part;
+      if (!SplitStringToIntegers(str.substr(5), "/", false, &part) ||
+          part.size() != 2 || part[0] < 0 || part[0] >= part[1])
+        return kNoRspecifier;
+      if (opts) {
+        opts->part = part[0];
+        opts->num_parts = part[1];
+      }
+    } else if (!strcmp(c, "sark")) {
+      if (rs == kNoRspecifier) rs = kShardedArchiveRspecifier;
+      else
+        return kNoRspecifier;
     } else if (!strcmp(c, "ark")) {
       if (rs == kNoRspecifier) rs = kArchiveRspecifier;
       else
@@ -307,13 +364,176 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
       return kNoRspecifier;  // Could not interpret this option.
     }
   }
-  if ((rs == kArchiveRspecifier || rs == kScriptRspecifier)
-     && wxfilename != NULL)
+  if ((rs == kArchiveRspecifier || rs == kScriptRspecifier ||
+       rs == kShardedArchiveRspecifier) && wxfilename != NULL)
     *wxfilename = after_colon;
   return rs;
 }
 
 
+std::string ShardFilename(const std::string &prefix, int32 shard) {
+  std::ostringstream filename;
+  filename << prefix << '.' << shard;
+  return filename.str();
+}
+
+int32 CreateShard(const std::string &prefix) {
+  if (ClassifyWxfilename(prefix) != kFileOutput) {
+    KALDI_WARN << "Sharded archives must be written to files: "
+               << PrintableWxfilename(prefix);
+    return -1;
+  }
+  for (int32 shard = 0; ; shard++) {
+    std::string filename = ShardFilename(prefix, shard);
+#ifdef _MSC_VER
+    int fd = _open(filename.c_str(), _O_WRONLY | _O_CREAT | _O_EXCL,
+                   _S_IREAD | _S_IWRITE);
+#else
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+#endif
+    if (fd >= 0) {
+#ifdef _MSC_VER
+      _close(fd);
+#else
+      close(fd);
+#endif
+      return shard;
+    }
+    if (errno != EEXIST) {
+      KALDI_WARN << "Cannot create " << filename << ": " << strerror(errno);
+      return -1;
+    }
+  }
+}
+
+bool ListShards(const std::string &prefix,
+                std::vector<std::string> *filenames) {
+  filenames->clear();
+  // The shards are numbered from 0, or from 1 (e.g. when written by a job
+  // array with the "shard=JOB" option).
+  std::vector<int32> shards;
+#ifdef _MSC_VER
+  for (int32 shard = 0; ; shard++) {
+    std::ifstream is(ShardFilename(prefix, shard).c_str());
+    if (is.is_open())
+      shards.push_back(shard);
+    else if (shard > 0)
+      break;
+  }
+#else
+  // List the directory, so that a missing shard is not taken for the end of
+  // the archive.
+  std::string::size_type pos = prefix.find_last_of('/');
+  std::string dir = (pos == std::string::npos ? "." :
+                     pos == 0 ? "/" : prefix.substr(0, pos)),
+      base = (pos == std::string::npos ? prefix : prefix.substr(pos + 1)) + ".";
+  DIR *d = opendir(dir.c_str());
+  if (d == NULL) {
+    KALDI_WARN << "Cannot list directory " << dir << " of sharded archive "
+               << prefix << ": " << strerror(errno);
+    return false;
+  }
+  while (struct dirent *entry = readdir(d)) {
+    std::string name(entry->d_name);
+    int32 shard;
+    if (name.compare(0, base.size(), base) == 0 &&
+        ConvertStringToInteger(name.substr(base.size()), &shard) &&
+        shard >= 0 && name == base + std::to_string(shard))
+      shards.push_back(shard);
+  }
+  closedir(d);
+  std::sort(shards.begin(), shards.end());
+#endif
+  if (shards.empty()) {
+    KALDI_WARN << "Sharded archive " << prefix << " has no shards (no file "
+               << ShardFilename(prefix, 0) << " or " << ShardFilename(prefix, 1)
+               << ").";
+    return false;
+  }
+  for (size_t i = 0; i < shards.size(); i++) {
+    int32 expected = (i == 0 ? std::min(shards[0], 1) : shards[i - 1] + 1);
+    if (shards[i] != expected) {
+      KALDI_WARN << "Sharded archive " << prefix << " is missing shard "
+                 << ShardFilename(prefix, expected) << " (found "
+                 << ShardFilename(prefix, shards[i]) << ").";
+      return false;
+    }
+    filenames->push_back(ShardFilename(prefix, shards[i]));
+  }
+  return true;
+}
+
+// Marks the end of the index of a shard, after the position of the index.
+static const char kShardIndexMagic[] = "SarkIdx1";
+static const size_t kShardTrailerSize = 16;
+
+bool WriteShardIndex(std::ostream &os, size_t index_offset,
+                     const std::vector<std::pair<std::string, size_t> >
+                     &index) {
+  WriteBasicType(os, true, static_cast<int64>(index.size()));
+  for (size_t i = 0; i < index.size(); i++) {
+    WriteToken(os, true, index[i].first);
+    WriteBasicType(os, true, static_cast<int64>(index[i].second));
+  }
+  uint64 offset = index_offset;
+  os.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+  os.write(kShardIndexMagic, kShardTrailerSize - sizeof(offset));
+  return os.good();
+}
+
+bool ReadShardIndex(const std::string &filename,
+                    std::vector<std::pair<std::string, size_t> > *index) {
+  index->clear();
+  Input input;
+  if (!input.Open(filename)) {
+    KALDI_WARN << "Cannot open shard " << filename;
+    return false;
+  }
+  std::istream &is = input.Stream();
+  is.seekg(0, std::ios_base::end);
+  int64 size = is.tellg();
+  char trailer[kShardTrailerSize];
+  uint64 index_offset = 0;
+  if (size >= static_cast<int64>(kShardTrailerSize)) {
+    is.seekg(size - kShardTrailerSize, std::ios_base::beg);
+    is.read(trailer, kShardTrailerSize);
+    memcpy(&index_offset, trailer, sizeof(index_offset));
+  }
+  if (!is.good() || size < static_cast<int64>(kShardTrailerSize) ||
+      memcmp(trailer + sizeof(index_offset), kShardIndexMagic,
+             kShardTrailerSize - sizeof(index_offset)) != 0 ||
+      index_offset > static_cast<uint64>(size - kShardTrailerSize)) {
+    KALDI_WARN << "Shard " << filename << " has no index (perhaps its writer "
+               << "did not finish?)";
+    return false;
+  }
+  try {
+    is.seekg(index_offset, std::ios_base::beg);
+    int64 num_objects;
+    ReadBasicType(is, true, &num_objects);
+    if (num_objects < 0 || num_objects > size)
+      KALDI_ERR << "Invalid number of objects " << num_objects;
+    index->resize(num_objects);
+    for (int64 i = 0; i < num_objects; i++) {
+      int64 offset;
+      ReadToken(is, true, &((*index)[i].first));
+      ReadBasicType(is, true, &offset);
+      if (offset < 0 || static_cast<uint64>(offset) > index_offset)
+        KALDI_ERR << "Invalid offset " << offset;
+      (*index)[i].second = offset;
+    }
+    if (is.tellg() != size - static_cast<int64>(kShardTrailerSize))
+      KALDI_ERR << "Unexpected data after the index.";
+  } catch(const std::exception &e) {
+    KALDI_WARN << "Error reading the index of shard " << filename << ": "
+               << e.what();
+    index->clear();
+    return false;
+  }
+  return true;
+}
+
+
 
 
 
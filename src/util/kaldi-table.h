@@ -102,19 +102,34 @@ typedef std::vector<std::string> KeyList;
 //  In this case we restrict the archive-filename to be an actual filename,
 //  as we can't see a situtation where an extended filename would make sense
 //  for this (we can't fseek() in pipes).
+//
+//  The type sark:prefix means a "sharded archive": the objects are written to
+//  one of the files prefix.0, prefix.1, and so on (the "shards"), each of
+//  which is an archive followed by an index of the keys and their offsets.
+//  Each TableWriter writes its own shard: by default the first one that does
+//  not exist yet (which it creates atomically, so any number of threads or
+//  processes may write to the same sharded archive at the same time), or,
+//  with the option shard=N, prefix.N (e.g. "sark,shard=JOB:feats" in a job
+//  array).  The index is written by Close(), so a shard whose writer was
+//  killed cannot be read.  Remove the shards of previous runs before writing
+//  a sharded archive again without the shard option.
 
 enum WspecifierType  {
   kNoWspecifier,
   kArchiveWspecifier,
   kScriptWspecifier,
-  kBothWspecifier
+  kBothWspecifier,
+  kShardedArchiveWspecifier
 };
 
 struct WspecifierOptions {
   bool binary;
   bool flush;
   bool permissive;  // will ignore absent scp entries.
-  WspecifierOptions(): binary(true), flush(false), permissive(false) { }
+  int32 shard;  // For sharded archives, the shard to write ("shard=N"
+                // option), or -1 for the first one that does not exist.
+  WspecifierOptions(): binary(true), flush(false), permissive(false),
+                       shard(-1) { }
 };
 
 // ClassifyWspecifier returns the type of the wspecifier string,
@@ -167,6 +182,13 @@ bool WriteScriptFile(std::ostream &os,
 //
 // ark:rxfilename
 // scp:rxfilename
+// sark:prefix
+//
+// where sark:prefix is a sharded archive written as described above for
+// wspecifiers: the shards prefix.0 (or prefix.1 if that does not exist),
+// prefix.1, ... up to the first one that does not exist.  Random-access
+// readers look up keys in the shards' indexes, and sequential readers read
+// the shards in order.
 //
 // We also allow various modifiers:
 //   o   means the program will only ask for each key once, which enables
@@ -189,6 +211,23 @@ bool WriteScriptFile(std::ostream &os,
 //       value, in a background thread.  Recommended when reading larger objects
 //       such as neural-net training examples, especially when you want to
 //       maximize GPU usage.
+//   pf means "prefetch", a generalization of bg for sequential readers (and,
+//       like bg, ignored by random-access readers): it keeps up to 16 objects
+//       read ahead (pf=N: up to N objects).  For scp files the objects are
+//       read, and e.g. compressed matrices uncompressed, by 4 threads in
+//       parallel (pfj=M: by M threads; this implies pf), and given to the
+//       program in the order of the scp file.  For archives, which can only
+//       be read in order, they are read by one thread.
+//   mm  means "memory-map", and only affects random-access readers of scp
+//       files whose entries are of the form foo.ark:1234: each archive is
+//       mapped into memory once, and the mapping shared by all the readers in
+//       the program (e.g. by the threads of nnet-train-*-parallel), and the
+//       objects are read from it rather than with a seek and a read each.
+//
+//   part=K/N  for sequential readers of sharded archives, means only read the
+//       shards with numbers i (counting from 0 among the shards that exist)
+//       such that i % N == K, so that N threads or processes may read a
+//       sharded archive in parallel.
 //
 //   b   is ignored [for scripting convenience]
 //   t   is ignored [for scripting convenience]
@@ -197,6 +236,10 @@ bool WriteScriptFile(std::ostream &os,
 //  So for instance the following would be a valid rspecifier:
 //
 //   "o, s, p, ark:gunzip -c foo.gz|"
+//
+//  and "scp,pf=32,pfj=8:feats.scp" would read the features listed in
+//  feats.scp with 8 threads, and "scp,mm:feats.scp" given to a
+//  RandomAccessTableReader would look them up in the memory-mapped archives.
 
 struct  RspecifierOptions {
   // These options only make a difference for the RandomAccessTableReader class.
@@ -211,21 +254,59 @@ struct  RspecifierOptions {
   bool background;  // For sequential readers, if the background option ("bg")
                     // is provided, it will read ahead to the next object in a
                     // background thread.
+  int32 prefetch_depth;  // For sequential readers, if nonzero (the "pf"
+                         // option), the number of objects read ahead.
+  int32 prefetch_threads;  // The number of threads that read them, for scp
+                           // files ("pfj" option).
+  bool mmap;  // For random-access readers of scp files, if the "mm" option is
+              // provided, reads the objects from memory-mapped archives.
+  int32 part;  // For sequential readers of sharded archives, the "part=K/N"
+  int32 num_parts;  // option: read the shards i with i % num_parts == part.
   RspecifierOptions(): once(false), sorted(false),
                        called_sorted(false), permissive(false),
-                       background(false) { }
+                       background(false), prefetch_depth(0),
+                       prefetch_threads(4), mmap(false), part(0),
+                       num_parts(1) { }
 };
 
 enum RspecifierType  {
   kNoRspecifier,
   kArchiveRspecifier,
-  kScriptRspecifier
+  kScriptRspecifier,
+  kShardedArchiveRspecifier
 };
 
 RspecifierType ClassifyRspecifier(const std::string &rspecifier,
                                   std::string *rxfilename,
                                   RspecifierOptions *opts);
 
+// The following functions are used in the implementation of sharded archives
+// ("sark:prefix"; see above).
+
+// Returns the filename of shard number "shard" of "prefix", i.e. prefix.shard.
+std::string ShardFilename(const std::string &prefix, int32 shard);
+
+// Creates the first shard of "prefix" that does not exist, atomically (so
+// that concurrent writers get different shards).  Returns its number, or -1,
+// after printing a warning, on error.
+int32 CreateShard(const std::string &prefix);
+
+// Outputs the filenames of the shards of "prefix", in order.  Returns false,
+// after printing a warning, if there are none or if one is missing (the
+// shards must be numbered consecutively from 0 or 1).
+bool ListShards(const std::string &prefix, std::vector<std::string> *filenames);
+
+// Writes the index of a shard, which follows its last object: the keys and
+// byte offsets of the objects, and "index_offset", the position in the file
+// of the index itself.
+bool WriteShardIndex(std::ostream &os, size_t index_offset,
+                     const std::vector<std::pair<std::string, size_t> > &index);
+
+// Reads the index of the shard "filename".  Returns false, after printing a
+// warning, if it cannot (e.g. because the shard's writer did not finish).
+bool ReadShardIndex(const std::string &filename,
+                    std::vector<std::pair<std::string, size_t> > *index);
+
 
 /// Allows random access to a collection
 /// of objects in an archive or script file; see \ref io_sec_tables.
@@ -22,9 +22,11 @@
 #ifndef KALDI_THREAD_KALDI_THREAD_H_
 #define KALDI_THREAD_KALDI_THREAD_H_ 1
 
+#include <future>
 #include <thread>
 #include "itf/options-itf.h"
 #include "util/kaldi-semaphore.h"
+#include "util/thread-pool.h"
 
 // This header provides convenient mechanisms for parallelization.
 //
@@ -52,6 +54,11 @@
 // destructor to have side effects such as outputting data.
 // Note: the destructor of TaskSequencer will wait for any remaining jobs that
 // are still running and will call the destructors.
+//
+// Both run their jobs in threads of ThreadPool::Instance() (see
+// thread-pool.h), which are reused, rather than creating a thread per job.
+// That class can also be used directly, for tasks with futures and for
+// parallel loops.
 
 
 namespace kaldi {
@@ -116,7 +123,6 @@ template<class C>
 class MultiThreader {
  public:
   MultiThreader(int32 num_threads, const C &c_in) :
-    threads_(std::max<int32>(1, num_threads)),
     cvec_(std::max<int32>(1, num_threads), c_in) {
     if (num_threads == 0) {
       // This is a special case with num_threads == 0, which behaves like with
@@ -126,20 +132,28 @@ class MultiThreader {
       cvec_[0].num_threads_ = 1;
       (cvec_[0])();
     } else {
-      for (int32 i = 0; i < threads_.size(); i++) {
+      // The jobs all start at once, as they may wait for each other or for
+      // the caller.
+      int32 num_jobs = cvec_.size();
+      futures_.resize(num_jobs);
+      for (int32 i = 0; i < num_jobs; i++) {
         cvec_[i].thread_id_ = i;
-        cvec_[i].num_threads_ = threads_.size();
-        threads_[i] = std::thread(std::ref(cvec_[i]));
+        cvec_[i].num_threads_ = num_jobs;
+        futures_[i] =
+            ThreadPool::Instance().RunInThread(std::ref(cvec_[i]));
       }
     }
   }
   ~MultiThreader() {
-    for (size_t i = 0; i < threads_.size(); i++)
-      if (threads_[i].joinable())
-        threads_[i].join();
+    for (size_t i = 0; i < futures_.size(); i++)
+      futures_[i].wait();
+    // As with std::thread, an exception in a job terminates the program
+    // (get() rethrows it, in a destructor).
+    for (size_t i = 0; i < futures_.size(); i++)
+      futures_[i].get();
   }
  private:
-  std::vector<std::thread> threads_;
+  std::vector<std::future<void> > futures_;
   std::vector<C> cvec_;
 };
 
@@ -177,8 +191,7 @@ class TaskSequencer {
       num_threads_(config.num_threads),
       threads_avail_(config.num_threads),
       tot_threads_avail_(config.num_threads_total > 0 ? config.num_threads_total :
-                         config.num_threads + 20),
-      thread_list_(NULL) {
+                         config.num_threads + 20) {
     KALDI_ASSERT((config.num_threads_total <= 0 ||
                   config.num_threads_total >= config.num_threads) &&
                  "num-threads-total, if specified, must be >= num-threads");
@@ -198,74 +211,59 @@ class TaskSequencer {
     tot_threads_avail_.Wait(); // this ensures we don't have too many threads
     // waiting on I/O, and consume too much memory.
 
-    // put the new RunTaskArgsList object at head of the singly
-    // linked list thread_list_.
-    thread_list_ = new RunTaskArgsList(this, c, thread_list_);
-    thread_list_->thread = std::thread(TaskSequencer<C>::RunTask,
-                                       thread_list_);
+    // The task waits for the previous one, "last_task_", before deleting
+    // "c", and becomes the last one.
+    last_task_ = ThreadPool::Instance().RunInThread(
+        std::bind(TaskSequencer<C>::RunTask, this, c, last_task_)).share();
   }
 
   void Wait() { // You call this at the end if it's more convenient
     // than waiting for the destructor.  It waits for all tasks to finish.
-    if (thread_list_ != NULL) {
-      thread_list_->thread.join();
-      KALDI_ASSERT(thread_list_->tail == NULL); // thread would not
-      // have exited without setting tail to NULL.
-      delete thread_list_;
-      thread_list_ = NULL;
+    if (last_task_.valid()) {
+      last_task_.get();
+      last_task_ = std::shared_future<void>();
     }
   }
 
-  /// The destructor waits for the last thread to exit.
+  /// The destructor waits for the last task to finish.
   ~TaskSequencer() {
     Wait();
   }
  private:
-  struct RunTaskArgsList {
-    TaskSequencer *me; // Think of this as a "this" pointer.
-    C *c; // Clist element of the task we're expected
-    std::thread thread;
-    RunTaskArgsList *tail;
-    RunTaskArgsList(TaskSequencer *me, C *c, RunTaskArgsList *tail):
-        me(me), c(c), tail(tail) {}
-  };
-  // This static function gets run in the threads that we create.
-  static void RunTask(RunTaskArgsList *args) {
-    // (1) run the job.
-    (*(args->c))(); // call operator () on args->c, which does the computation.
-    args->me->threads_avail_.Signal(); // Signal that the compute-intensive
-    // part of the thread is done (we want to run no more than
+  // This static function gets run in the threads of the pool.  "previous" is
+  // the previous task (if any), whose object we wait to be deleted.
+  static void RunTask(TaskSequencer *me, C *c,
+                      std::shared_future<void> previous) {
+    // (1) run the job: call operator () on c, which does the computation.
+    try {
+      (*c)();
+    } catch(...) {
+      // As with std::thread, an exception in a job terminates the program
+      // (otherwise the tasks waiting for this one would wait forever).
+      std::terminate();
+    }
+    me->threads_avail_.Signal(); // Signal that the compute-intensive
+    // part of the task is done (we want to run no more than
     // config_.num_threads of these.)
 
     // (2) we want to destroy the object "c" now, by deleting it.  But for
     //     correct sequencing (this is the whole point of this class, it
     //     is intended to ensure the output of the program is in correct order),
-    //     we first wait till the previous thread, whose details will be in "tail",
-    //     is finished.
-    if (args->tail != NULL) {
-      args->tail->thread.join();
-    }
+    //     we first wait till the previous task is finished.
+    if (previous.valid())
+      previous.wait();
 
-    delete args->c; // delete the object "c".  This may cause some output,
+    delete c; // delete the object "c".  This may cause some output,
     // e.g. to a stream.  We don't need to worry about concurrent access to
-    // the output stream, because each thread waits for the previous thread
+    // the output stream, because each task waits for the previous task
     // to be done, before doing this.  So there is no risk of concurrent
     // access.
-    args->c = NULL;
-
-    if (args->tail != NULL) {
-      KALDI_ASSERT(args->tail->tail == NULL); // Because we already
-      // did join on args->tail->thread, which means that
-      // thread was done, and before it exited, it would have
-      // deleted and set to NULL its tail (which is the next line of code).
-      delete args->tail;
-      args->tail = NULL;
-    }
-    // At this point we are exiting from the thread.  Signal the
-    // "tot_threads_avail_" semaphore which is used to limit the total number of threads that are alive, including
-    // not onlhy those that are in active computation in c->operator (), but those
-    // that are waiting on I/O or other threads.
-    args->me->tot_threads_avail_.Signal();
+
+    // Signal the "tot_threads_avail_" semaphore which is used to limit the
+    // total number of tasks that are not finished, including not only those
+    // that are in active computation in c->operator (), but those that are
+    // waiting on I/O or other tasks.
+    me->tot_threads_avail_.Signal();
   }
 
   int32 num_threads_; // copy of config.num_threads (since Semaphore doesn't store original count)
@@ -275,7 +273,7 @@ class TaskSequencer {
 
   Semaphore tot_threads_avail_; // We use this semaphore to ensure we don't
   // consume too much memory...
-  RunTaskArgsList *thread_list_;
+  std::shared_future<void> last_task_;  // the task that was started last.
 
 };
 
@@ -0,0 +1,231 @@
+// util/mpmc-queue-inl.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_MPMC_QUEUE_INL_H_
+#define KALDI_UTIL_MPMC_QUEUE_INL_H_
+
+#include <algorithm>
+#include <thread>
+
+namespace kaldi {
+
+template<class T>
+MpmcQueue<T>::MpmcQueue(int32 capacity, QueueWaitPolicy policy):
+    capacity_(capacity), policy_(policy), slots_(capacity), head_(0),
+    tail_(0), closed_(false), num_pushing_(0), num_waiting_push_(0),
+    num_waiting_pop_(0) {
+  KALDI_ASSERT(capacity > 0);
+}
+
+template<class T>
+bool MpmcQueue<T>::DoPush(const T &value) {
+  size_t head = head_.load(std::memory_order_acquire);
+  while (true) {
+    Slot &slot = slots_[head % capacity_];
+    size_t turn = 2 * (head / capacity_);
+    if (slot.turn.load(std::memory_order_acquire) == turn) {
+      // The slot is free in this lap; take the position, unless another
+      // producer did (then "head" is set to the new head).
+      if (head_.compare_exchange_strong(head, head + 1)) {
+        slot.value = value;
+        slot.turn.store(turn + 1, std::memory_order_release);
+        return true;
+      }
+    } else {
+      // The slot still holds an element of the previous lap, unless another
+      // producer has taken this position meanwhile.
+      size_t prev_head = head;
+      head = head_.load(std::memory_order_acquire);
+      if (head == prev_head)
+        return false;  // full.
+    }
+  }
+}
+
+template<class T>
+bool MpmcQueue<T>::PushIfOpen(const T &value) {
+  // Close() waits for num_pushing_ to be zero after setting closed_, so
+  // either we see that the queue is closed, or the element is in it before
+  // Close() returns and before the consumers' last try.
+  num_pushing_++;
+  bool ans = !closed_ && DoPush(value);
+  num_pushing_--;
+  return ans;
+}
+
+template<class T>
+void MpmcQueue<T>::WaitForPushes() {
+  while (num_pushing_ > 0)
+    std::this_thread::yield();
+}
+
+template<class T>
+template<class F>
+bool MpmcQueue<T>::LastPop(F try_op) {
+  WaitForPushes();
+  return try_op();
+}
+
+template<class T>
+bool MpmcQueue<T>::DoPop(T *value) {
+  size_t tail = tail_.load(std::memory_order_acquire);
+  while (true) {
+    Slot &slot = slots_[tail % capacity_];
+    size_t turn = 2 * (tail / capacity_) + 1;
+    if (slot.turn.load(std::memory_order_acquire) == turn) {
+      if (tail_.compare_exchange_strong(tail, tail + 1)) {
+        *value = slot.value;
+        slot.value = T();
+        slot.turn.store(turn + 1, std::memory_order_release);
+        return true;
+      }
+    } else {
+      size_t prev_tail = tail;
+      tail = tail_.load(std::memory_order_acquire);
+      if (tail == prev_tail)
+        return false;  // empty.
+    }
+  }
+}
+
+template<class T>
+void MpmcQueue<T>::Notify(std::atomic<int32> *waiters,
+                          std::condition_variable *condition) {
+  // Pairs with the fence in WaitFor(): either the waiting thread sees what we
+  // pushed or popped when it tries again, or we see that it waits.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiters->load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    condition->notify_one();
+  }
+}
+
+template<class T>
+template<class F>
+bool MpmcQueue<T>::WaitFor(F try_op, bool is_pop,
+                           std::atomic<int32> *waiters,
+                           std::condition_variable *condition,
+                           const Clock::time_point *deadline) {
+  const int32 num_tries = 64;  // before yielding or sleeping.
+  for (int32 i = 0; ; i++) {
+    if (!is_pop && closed_)
+      return false;
+    if (try_op())
+      return true;
+    if (closed_)
+      return is_pop && LastPop(try_op);
+    if (deadline != NULL && Clock::now() >= *deadline)
+      return false;
+    if (i < num_tries)
+      continue;
+    if (policy_ == kQueueSpin) {
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    (*waiters)++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool done, timed_out = false;
+    while (!(done = try_op()) && !closed_ && !timed_out) {
+      if (deadline == NULL)
+        condition->wait(lock);
+      else
+        timed_out = (condition->wait_until(lock, *deadline) ==
+                     std::cv_status::timeout);
+    }
+    (*waiters)--;
+    if (done)
+      return true;
+    lock.unlock();
+    return closed_ && is_pop && LastPop(try_op);
+  }
+}
+
+template<class T>
+bool MpmcQueue<T>::TryPush(const T &value) {
+  if (!PushIfOpen(value))
+    return false;
+  Notify(&num_waiting_pop_, &not_empty_);
+  return true;
+}
+
+template<class T>
+bool MpmcQueue<T>::TryPop(T *value) {
+  if (!DoPop(value))
+    return false;
+  Notify(&num_waiting_push_, &not_full_);
+  return true;
+}
+
+template<class T>
+bool MpmcQueue<T>::Push(const T &value) {
+  if (!WaitFor([this, &value]() { return PushIfOpen(value); }, false,
+               &num_waiting_push_, &not_full_, NULL))
+    return false;
+  Notify(&num_waiting_pop_, &not_empty_);
+  return true;
+}
+
+template<class T>
+bool MpmcQueue<T>::Pop(T *value) {
+  if (!WaitFor([this, value]() { return DoPop(value); }, true,
+               &num_waiting_pop_, &not_empty_, NULL))
+    return false;
+  Notify(&num_waiting_push_, &not_full_);
+  return true;
+}
+
+template<class T>
+bool MpmcQueue<T>::PushFor(const T &value, int32 timeout_ms) {
+  Clock::time_point deadline = Clock::now() +
+      std::chrono::milliseconds(timeout_ms);
+  if (!WaitFor([this, &value]() { return PushIfOpen(value); }, false,
+               &num_waiting_push_, &not_full_, &deadline))
+    return false;
+  Notify(&num_waiting_pop_, &not_empty_);
+  return true;
+}
+
+template<class T>
+bool MpmcQueue<T>::PopFor(T *value, int32 timeout_ms) {
+  Clock::time_point deadline = Clock::now() +
+      std::chrono::milliseconds(timeout_ms);
+  if (!WaitFor([this, value]() { return DoPop(value); }, true,
+               &num_waiting_pop_, &not_empty_, &deadline))
+    return false;
+  Notify(&num_waiting_push_, &not_full_);
+  return true;
+}
+
+template<class T>
+void MpmcQueue<T>::Close() {
+  closed_ = true;
+  WaitForPushes();
+  std::lock_guard<std::mutex> lock(mutex_);
+  not_full_.notify_all();
+  not_empty_.notify_all();
+}
+
+template<class T>
+int32 MpmcQueue<T>::Size() const {
+  size_t tail = tail_.load(), head = head_.load();
+  return head > tail ? std::min(head - tail, capacity_) : 0;
+}
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_MPMC_QUEUE_INL_H_
@@ -0,0 +1,255 @@
+// util/mpmc-queue-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <deque>
+#include <thread>
+
+#include "base/timer.h"
+#include "util/kaldi-mutex.h"
+#include "util/kaldi-semaphore.h"
+#include "util/mpmc-queue.h"
+
+namespace kaldi {
+
+void UnitTestMpmcQueueSingleThread() {
+  for (int32 capacity = 1; capacity < 10; capacity++) {
+    MpmcQueue<int32> queue(capacity);
+    int32 next_in = 0, next_out = 0;
+    for (int32 n = 0; n < 1000; n++) {
+      if (RandInt(0, 1) == 0) {
+        bool full = (next_in - next_out == capacity);
+        KALDI_ASSERT(queue.TryPush(next_in) == !full);
+        if (!full) next_in++;
+      } else {
+        int32 value;
+        bool empty = (next_in == next_out);
+        KALDI_ASSERT(queue.TryPop(&value) == !empty);
+        if (!empty) KALDI_ASSERT(value == next_out++);
+      }
+      KALDI_ASSERT(queue.Size() == next_in - next_out);
+    }
+    queue.Close();
+    KALDI_ASSERT(!queue.TryPush(0) && !queue.Push(0));
+    int32 value;
+    while (next_out < next_in) {
+      KALDI_ASSERT(queue.Pop(&value) && value == next_out);
+      next_out++;
+    }
+    KALDI_ASSERT(!queue.Pop(&value));
+  }
+}
+
+// Producers push (producer, index) pairs and consumers pop them until the queue
+// is closed; each pair must arrive once, and each consumer must see the pairs
+// of a producer in order.
+void UnitTestMpmcQueueThreads(QueueWaitPolicy policy) {
+  typedef std::pair<int32, int32> Item;
+  int32 num_producers = RandInt(1, 4), num_consumers = RandInt(1, 4),
+      num_items = 20000;
+  MpmcQueue<Item> queue(RandInt(1, 64), policy);
+  std::vector<std::vector<Item> > received(num_consumers);
+  std::vector<std::thread> producers, consumers;
+  for (int32 c = 0; c < num_consumers; c++) {
+    consumers.push_back(std::thread([&queue, &received, c]() {
+          Item item;
+          while (queue.Pop(&item))
+            received[c].push_back(item);
+        }));
+  }
+  for (int32 p = 0; p < num_producers; p++) {
+    producers.push_back(std::thread([&queue, p, num_items]() {
+          for (int32 i = 0; i < num_items; i++) {
+            // also exercise the other ways of pushing.
+            if (i % 3 == 1) {
+              while (!queue.TryPush(Item(p, i))) std::this_thread::yield();
+            } else if (i % 3 == 2) {
+              while (!queue.PushFor(Item(p, i), 1)) { }
+            } else {
+              KALDI_ASSERT(queue.Push(Item(p, i)));
+            }
+          }
+        }));
+  }
+  for (int32 p = 0; p < num_producers; p++)
+    producers[p].join();
+  queue.Close();
+  for (int32 c = 0; c < num_consumers; c++)
+    consumers[c].join();
+
+  std::vector<int32> count(num_producers * num_items, 0);
+  for (int32 c = 0; c < num_consumers; c++) {
+    std::vector<int32> last(num_producers, -1);
+    for (size_t i = 0; i < received[c].size(); i++) {
+      const Item &item = received[c][i];
+      KALDI_ASSERT(item.second > last[item.first]);
+      last[item.first] = item.second;
+      count[item.first * num_items + item.second]++;
+    }
+  }
+  for (size_t i = 0; i < count.size(); i++)
+    KALDI_ASSERT(count[i] == 1);
+}
+
+void UnitTestMpmcQueueTimeout() {
+  MpmcQueue<int32> queue(2);
+  int32 value;
+  Timer timer;
+  KALDI_ASSERT(!queue.PopFor(&value, 20));
+  KALDI_ASSERT(timer.Elapsed() >= 0.019);
+  KALDI_ASSERT(queue.PushFor(1, 20) && queue.PushFor(2, 20));
+  timer.Reset();
+  KALDI_ASSERT(!queue.PushFor(3, 20));
+  KALDI_ASSERT(timer.Elapsed() >= 0.019);
+
+  // Close() wakes a thread that waits.
+  KALDI_ASSERT(queue.Pop(&value) && queue.Pop(&value) && value == 2);
+  std::thread t([&queue]() { queue.Close(); });
+  KALDI_ASSERT(!queue.Pop(&value));
+  t.join();
+}
+
+// Close() called while producers push: every element whose Push() succeeded
+// is popped.
+void UnitTestMpmcQueueCloseWhilePushing(QueueWaitPolicy policy) {
+  MpmcQueue<int32> queue(RandInt(1, 8), policy);
+  int32 num_producers = RandInt(1, 4);
+  std::vector<int32> num_pushed(num_producers, 0);
+  std::vector<std::thread> producers;
+  for (int32 p = 0; p < num_producers; p++)
+    producers.push_back(std::thread([&queue, &num_pushed, p]() {
+          while (queue.Push(p))
+            num_pushed[p]++;
+        }));
+  std::vector<int32> num_popped(num_producers, 0);
+  int32 value, n = RandInt(0, 1000);
+  for (int32 i = 0; i < n && queue.Pop(&value); i++)
+    num_popped[value]++;
+  queue.Close();
+  while (queue.Pop(&value))
+    num_popped[value]++;
+  for (int32 p = 0; p < num_producers; p++) {
+    producers[p].join();
+    KALDI_ASSERT(num_popped[p] == num_pushed[p]);
+  }
+}
+
+// A channel built from semaphores and a mutex, as ExamplesRepository and
+// online0's Repository were, for comparison.
+class SemaphoreChannel {
+ public:
+  explicit SemaphoreChannel(int32 capacity): empty_semaphore_(capacity) { }
+  void Push(int32 value) {
+    empty_semaphore_.Wait();
+    mutex_.Lock();
+    items_.push_back(value);
+    mutex_.Unlock();
+    full_semaphore_.Signal();
+  }
+  int32 Pop() {
+    full_semaphore_.Wait();
+    mutex_.Lock();
+    int32 ans = items_.front();
+    items_.pop_front();
+    mutex_.Unlock();
+    empty_semaphore_.Signal();
+    return ans;
+  }
+ private:
+  Semaphore full_semaphore_;
+  Semaphore empty_semaphore_;
+  Mutex mutex_;
+  std::deque<int32> items_;
+};
+
+// Passes "num_items" integers through the channel from "num_threads"
+// producers to as many consumers, and returns the handoffs per second.
+template<class Channel>
+double ChannelThroughput(Channel *channel, int32 num_threads,
+                         int32 num_items) {
+  Timer timer;
+  std::vector<std::thread> threads;
+  int32 items_per_thread = num_items / num_threads;
+  std::atomic<int64> sum(0);
+  for (int32 t = 0; t < num_threads; t++) {
+    threads.push_back(std::thread([channel, items_per_thread]() {
+          for (int32 i = 0; i < items_per_thread; i++)
+            channel->Push(i);
+        }));
+    threads.push_back(std::thread([channel, items_per_thread, &sum]() {
+          int64 my_sum = 0;
+          for (int32 i = 0; i < items_per_thread; i++)
+            my_sum += channel->Pop();
+          sum += my_sum;
+        }));
+  }
+  for (size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+  KALDI_ASSERT(sum == static_cast<int64>(num_threads) * items_per_thread *
+               (items_per_thread - 1) / 2);
+  return items_per_thread * num_threads / timer.Elapsed();
+}
+
+// MpmcQueue with the interface of SemaphoreChannel.
+class QueueChannel {
+ public:
+  QueueChannel(int32 capacity, QueueWaitPolicy policy):
+      queue_(capacity, policy) { }
+  void Push(int32 value) { queue_.Push(value); }
+  int32 Pop() {
+    int32 ans;
+    queue_.Pop(&ans);
+    return ans;
+  }
+ private:
+  MpmcQueue<int32> queue_;
+};
+
+void MpmcQueueBenchmark() {
+  int32 num_items = 200000, capacity = 128;
+  int32 num_cpus = std::thread::hardware_concurrency();
+  for (int32 num_threads = 1; num_threads <= 4; num_threads *= 2) {
+    SemaphoreChannel semaphore_channel(capacity);
+    QueueChannel blocking_queue(capacity, kQueueBlock),
+        spinning_queue(capacity, kQueueSpin);
+    KALDI_LOG << num_threads << " producer(s) and consumer(s), on "
+              << num_cpus << " CPU(s): handoffs per second with semaphores "
+              << ChannelThroughput(&semaphore_channel, num_threads, num_items)
+              << ", with MpmcQueue (kQueueBlock) "
+              << ChannelThroughput(&blocking_queue, num_threads, num_items)
+              << ", (kQueueSpin) "
+              << ChannelThroughput(&spinning_queue, num_threads, num_items);
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestMpmcQueueSingleThread();
+  for (int32 i = 0; i < 5; i++) {
+    UnitTestMpmcQueueThreads(kQueueBlock);
+    UnitTestMpmcQueueThreads(kQueueSpin);
+  }
+  UnitTestMpmcQueueTimeout();
+  for (int32 i = 0; i < 50; i++) {
+    UnitTestMpmcQueueCloseWhilePushing(kQueueBlock);
+    UnitTestMpmcQueueCloseWhilePushing(kQueueSpin);
+  }
+  MpmcQueueBenchmark();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,170 @@
+// util/mpmc-queue.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_MPMC_QUEUE_H_
+#define KALDI_UTIL_MPMC_QUEUE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// How the waiting functions of MpmcQueue (Push(), Pop(), PushFor(),
+/// PopFor()) wait when the queue is full or empty.
+enum QueueWaitPolicy {
+  kQueueBlock,  ///< Retry a few times, then sleep until woken by the other side
+                ///  (the default).
+  kQueueSpin    ///< Keep retrying, yielding the CPU in between: the lowest
+                ///  latency, for when each side has a core of its own.
+};
+
+/**
+   A bounded queue for any number of producer and consumer threads, used as the
+   channel between threads that read examples and threads that train on them,
+   and similar.  Pushing and popping are lock-free: each slot has a "turn"
+   counter that tells whether it is ready to be written or read in the current
+   lap round the buffer, and threads take positions by incrementing the head
+   or tail with compare-and-swap.  A mutex is only locked when a thread waits
+   with kQueueBlock, or to wake such threads.
+
+   Close() tells the consumers that nothing more will come: Pop() then returns
+   the remaining elements and after that false, like the "Done" calls of the
+   semaphore-based repositories.
+
+   T must be default-constructible and copy-assignable; typically it is a
+   pointer.
+*/
+template<class T>
+class MpmcQueue {
+ public:
+  /// "capacity" is the maximum number of elements (at least 1).
+  explicit MpmcQueue(int32 capacity, QueueWaitPolicy policy = kQueueBlock);
+
+  /// Adds "value" if there is room, and returns true; returns false if the
+  /// queue is full or closed.  Never waits.
+  bool TryPush(const T &value);
+
+  /// Removes the oldest element into *value and returns true, or returns
+  /// false if the queue is empty.  Never waits.
+  bool TryPop(T *value);
+
+  /// Adds "value", waiting for room if needed.  Returns false (without adding
+  /// it) if the queue is or becomes closed.
+  bool Push(const T &value);
+
+  /// Removes the oldest element into *value, waiting for one if needed.
+  /// Returns false once the queue is closed and empty.
+  bool Pop(T *value);
+
+  /// As Push() and Pop(), but return false if they would have to wait longer
+  /// than "timeout_ms" milliseconds.
+  bool PushFor(const T &value, int32 timeout_ms);
+  bool PopFor(T *value, int32 timeout_ms);
+
+  /// Makes Push() fail from now on and Pop() return false when the queue is
+  /// empty, and wakes the threads that wait.  A push that is under way when
+  /// Close() is called either fails or is done (and its element will be
+  /// popped) before Close() returns.
+  void Close();
+
+  bool IsClosed() const { return closed_; }
+
+  /// The number of elements; only approximate while other threads use the
+  /// queue.
+  int32 Size() const;
+
+  int32 Capacity() const { return capacity_; }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Slot {
+    // 2 * lap if the slot is free to be written in lap "lap", 2 * lap + 1 if
+    // it holds the element written in that lap.
+    std::atomic<size_t> turn;
+    T value;
+    Slot(): turn(0) { }
+  };
+
+  // Push or pop without waiting or waking anybody; return false if the queue
+  // is full or empty.
+  bool DoPush(const T &value);
+  bool DoPop(T *value);
+
+  // DoPush() unless the queue is closed; counted in num_pushing_ while it
+  // runs.
+  bool PushIfOpen(const T &value);
+
+  // Waits until no PushIfOpen() is running; once the queue is closed, no new
+  // one can succeed.
+  void WaitForPushes();
+
+  // The last try of a pop, once the queue is closed: waits for the pushes
+  // under way, which may still add elements, and calls try_op().
+  template<class F>
+  bool LastPop(F try_op);
+
+  // Calls try_op() (a DoPush() or DoPop()) until it succeeds, following
+  // policy_; "waiters" and "condition" are those of the threads waiting to do
+  // the same.  Gives up when the queue is closed (for pops, after a last try)
+  // or at "deadline" if it is not NULL.
+  template<class F>
+  bool WaitFor(F try_op, bool is_pop, std::atomic<int32> *waiters,
+               std::condition_variable *condition,
+               const Clock::time_point *deadline);
+
+  // Wakes a thread waiting in WaitFor() on "condition", if there is one;
+  // called after pushing or popping.
+  void Notify(std::atomic<int32> *waiters,
+              std::condition_variable *condition);
+
+  const size_t capacity_;
+  const QueueWaitPolicy policy_;
+  std::vector<Slot> slots_;
+
+  // The head (next position to write) and tail (next position to read) are
+  // kept on separate cache lines, since producers and consumers modify them.
+  char padding1_[64];
+  std::atomic<size_t> head_;
+  char padding2_[64];
+  std::atomic<size_t> tail_;
+  char padding3_[64];
+
+  std::atomic<bool> closed_;
+  // The number of threads in PushIfOpen().
+  std::atomic<int32> num_pushing_;
+
+  // For waiting with kQueueBlock.
+  std::mutex mutex_;
+  std::atomic<int32> num_waiting_push_;
+  std::atomic<int32> num_waiting_pop_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MpmcQueue);
+};
+
+}  // namespace kaldi
+
+#include "util/mpmc-queue-inl.h"
+
+#endif  // KALDI_UTIL_MPMC_QUEUE_H_
@@ -0,0 +1,160 @@
+// util/open-hash-list-inl.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_UTIL_OPEN_HASH_LIST_INL_H_
+#define KALDI_UTIL_OPEN_HASH_LIST_INL_H_
+
+// Do not include this file directly.  It is included by open-hash-list.h
+
+
+namespace kaldi {
+
+template<class I, class T> OpenHashList<I, T>::OpenHashList():
+    list_head_(NULL), list_tail_(NULL), mask_(0), shift_(64),
+    freed_head_(NULL) {
+  Rehash(16);
+}
+
+template<class I, class T> void OpenHashList<I, T>::SetSize(size_t size) {
+  KALDI_ASSERT(list_head_ == NULL && used_.empty());  // make sure empty.
+  size_t new_size = slots_.size();
+  while (new_size < size)
+    new_size *= 2;
+  if (new_size != slots_.size())
+    Rehash(new_size);
+}
+
+template<class I, class T> void OpenHashList<I, T>::Rehash(size_t size) {
+  std::vector<Slot> old_slots(size);
+  old_slots.swap(slots_);
+  for (size_t i = 0; i < size; i++)
+    slots_[i].elem = NULL;
+  mask_ = size - 1;
+  KALDI_ASSERT((size & mask_) == 0);  // power of two.
+  shift_ = 64;
+  for (size_t s = size; s > 1; s >>= 1)
+    shift_--;
+
+  std::vector<size_t> old_used;
+  old_used.swap(used_);
+  used_.reserve(size / 2);
+  for (size_t i = 0; i < old_used.size(); i++) {
+    const Slot &old_slot = old_slots[old_used[i]];
+    size_t index = FirstSlot(old_slot.key);
+    while (slots_[index].elem != NULL)
+      index = (index + 1) & mask_;
+    slots_[index] = old_slot;
+    used_.push_back(index);
+  }
+}
+
+template<class I, class T>
+typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::Clear() {
+  // Clears the table and gives ownership of the currently contained list
+  // to the user.
+  for (size_t i = 0; i < used_.size(); i++)
+    slots_[used_[i]].elem = NULL;
+  used_.clear();
+  Elem *ans = list_head_;
+  list_head_ = list_tail_ = NULL;
+  return ans;
+}
+
+template<class I, class T>
+inline void OpenHashList<I, T>::Delete(Elem *e) {
+  e->tail = freed_head_;
+  freed_head_ = e;
+}
+
+template<class I, class T>
+inline typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::Find(I key) {
+  for (size_t index = FirstSlot(key); ; index = (index + 1) & mask_) {
+    const Slot &slot = slots_[index];
+    if (slot.elem == NULL)
+      return NULL;  // Not found.
+    if (slot.key == key)
+      return slot.elem;
+  }
+}
+
+template<class I, class T>
+inline typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::New() {
+  if (freed_head_) {
+    Elem *ans = freed_head_;
+    freed_head_ = freed_head_->tail;
+    return ans;
+  } else {
+    Elem *tmp = new Elem[allocate_block_size_];
+    for (size_t i = 0; i+1 < allocate_block_size_; i++)
+      tmp[i].tail = tmp+i+1;
+    tmp[allocate_block_size_-1].tail = NULL;
+    freed_head_ = tmp;
+    allocated_.push_back(tmp);
+    return this->New();
+  }
+}
+
+template<class I, class T>
+inline void OpenHashList<I, T>::Insert(I key, T val) {
+  // keep the load factor at most 1/2, so the probe sequences stay short.
+  if (2 * (used_.size() + 1) > slots_.size())
+    Rehash(2 * slots_.size());
+
+  Elem *elem = New();
+  elem->key = key;
+  elem->val = val;
+  elem->tail = NULL;
+  if (list_tail_ == NULL)
+    list_head_ = elem;
+  else
+    list_tail_->tail = elem;
+  list_tail_ = elem;
+
+  size_t index = FirstSlot(key);
+  while (slots_[index].elem != NULL)
+    index = (index + 1) & mask_;
+  slots_[index].key = key;
+  slots_[index].elem = elem;
+  used_.push_back(index);
+}
+
+template<class I, class T>
+OpenHashList<I, T>::~OpenHashList() {
+  // First test whether we had any memory leak, i.e. things for which the user
+  // did not call Delete().
+  size_t num_in_list = 0, num_allocated = 0;
+  for (Elem *e = freed_head_; e != NULL; e = e->tail)
+    num_in_list++;
+  for (Elem *e = list_head_; e != NULL; e = e->tail)
+    num_in_list++;  // still owned by us.
+  for (size_t i = 0; i < allocated_.size(); i++) {
+    num_allocated += allocate_block_size_;
+    delete[] allocated_[i];
+  }
+  if (num_in_list != num_allocated) {
+    KALDI_WARN << "Possible memory leak: " << num_in_list
+               << " != " << num_allocated
+               << ": you might have forgotten to call Delete on "
+               << "some Elems";
+  }
+}
+
+
+}  // end namespace kaldi
+
+#endif  // KALDI_UTIL_OPEN_HASH_LIST_INL_H_
@@ -0,0 +1,135 @@
+// util/open-hash-list-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/open-hash-list.h"
+#include <map>  // for baseline.
+#include <cstdlib>
+#include <iostream>
+
+namespace kaldi {
+
+template<class Int, class T> void TestOpenHashList() {
+  typedef typename OpenHashList<Int, T>::Elem Elem;
+
+  OpenHashList<Int, T> hash;
+  hash.SetSize(200);
+  std::map<Int, T> m1;
+  for (size_t j = 0; j < 50; j++) {
+    Int key = Rand() % 200;
+    T val = Rand() % 50;
+    m1[key] = val;
+    Elem *e = hash.Find(key);
+    if (e) e->val = val;
+    else  hash.Insert(key, val);
+  }
+
+  std::map<Int, T> m2;
+
+  for (int i = 0; i < 100; i++) {
+    m2.clear();
+    for (typename std::map<Int, T>::const_iterator iter = m1.begin();
+        iter != m1.end();
+        iter++) {
+      m2[iter->first + 1] = iter->second;
+    }
+    std::swap(m1, m2);
+
+    Elem *h = hash.Clear(), *tmp;
+
+    // the size is only a hint; the table grows when it needs to.
+    hash.SetSize(Rand() % 100);
+
+    std::vector<Int> order;
+    for (; h != NULL; h = tmp) {
+      hash.Insert(h->key + 1, h->val);
+      order.push_back(h->key + 1);
+      tmp = h->tail;
+      hash.Delete(h);  // think of this like calling delete.
+    }
+
+    // Now make sure h and m2 are the same, and that the list is in the order
+    // of insertion.
+    const Elem *list = hash.GetList();
+    size_t count = 0;
+    for (; list != NULL; list = list->tail, count++) {
+      KALDI_ASSERT(m1[list->key] == list->val);
+      KALDI_ASSERT(order[count] == list->key);
+    }
+
+    for (size_t j = 0; j < 10; j++) {
+      Int key = Rand() % 200;
+      bool found_m1 = (m1.find(key) != m1.end());
+      Elem *e = hash.Find(key);
+      KALDI_ASSERT((e != NULL) == found_m1);
+      if (found_m1)
+        KALDI_ASSERT(m1[key] == e->val);
+    }
+
+    KALDI_ASSERT(m1.size() == count);
+  }
+  KALDI_ASSERT(2 * m1.size() <= hash.Size());
+}
+
+// Many more keys than the initial size, so the table grows while in use.
+void TestOpenHashListGrow() {
+  typedef OpenHashList<int32, int32>::Elem Elem;
+  OpenHashList<int32, int32> hash;
+  hash.SetSize(10);
+  std::map<int32, int32> m;
+  for (int32 i = 0; i < 10000; i++) {
+    int32 key = Rand() % 100000 - 50000;
+    Elem *e = hash.Find(key);
+    KALDI_ASSERT((e != NULL) == (m.count(key) != 0));
+    if (e == NULL) {
+      hash.Insert(key, i);
+      m[key] = i;
+    }
+  }
+  for (std::map<int32, int32>::iterator iter = m.begin(); iter != m.end();
+       ++iter)
+    KALDI_ASSERT(hash.Find(iter->first)->val == iter->second);
+
+  Elem *h = hash.Clear(), *tmp;
+  size_t count = 0;
+  for (; h != NULL; h = tmp, count++) {
+    tmp = h->tail;
+    hash.Delete(h);
+  }
+  KALDI_ASSERT(count == m.size() && hash.GetList() == NULL);
+  for (std::map<int32, int32>::iterator iter = m.begin(); iter != m.end();
+       ++iter)
+    KALDI_ASSERT(hash.Find(iter->first) == NULL);
+}
+
+
+}  // end namespace kaldi
+
+
+
+int main() {
+  using namespace kaldi;
+  for (size_t i = 0;i < 3;i++) {
+    TestOpenHashList<int, unsigned int>();
+    TestOpenHashList<unsigned int, int>();
+    TestOpenHashList<int16, int32>();
+    TestOpenHashList<char, unsigned char>();
+    TestOpenHashList<unsigned char, int>();
+    TestOpenHashListGrow();
+  }
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,129 @@
+// util/open-hash-list.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_UTIL_OPEN_HASH_LIST_H_
+#define KALDI_UTIL_OPEN_HASH_LIST_H_
+#include <vector>
+#include "base/kaldi-common.h"
+
+
+/* OpenHashList has the same interface and the same semantics as HashList (see
+   hash-list.h), and can be used in its place in the decoders, but the hash
+   part is an open-addressing table (linear probing) of (key, Elem*) pairs
+   instead of chained buckets.  A Find() for a key that is present usually
+   touches one slot of the table and then the Elem; a Find() for a key that is
+   absent usually touches only the table, whereas HashList has to walk the
+   Elems of the bucket.  The list keeps the order of insertion, and the Elems
+   come from blocks that are reused, so successive Elems tend to be adjacent
+   in memory.
+
+   Elements are never removed from the hash individually (only all at once, by
+   Clear()), so the table needs no tombstones; it grows by itself if it gets
+   more than half full, so SetSize() is only a hint.
+*/
+
+
+namespace kaldi {
+
+template<class I, class T> class OpenHashList {
+ public:
+  struct Elem {
+    I key;
+    T val;
+    Elem *tail;
+  };
+
+  /// Constructor takes no arguments.
+  /// Call SetSize to inform it of the likely size.
+  OpenHashList();
+
+  /// Clears the hash and gives the head of the current list to the user;
+  /// ownership is transferred to the user (the user must call Delete()
+  /// for each element in the list, at his/her leisure).
+  Elem *Clear();
+
+  /// Gives the head of the current list to the user.  Ownership retained in
+  /// the class.
+  const Elem *GetList() const { return list_head_; }
+
+  /// Think of this like delete().  It is to be called for each Elem in turn
+  /// after you "obtained ownership" by doing Clear().
+  inline void Delete(Elem *e);
+
+  /// Think of it as opposite to Delete().
+  inline Elem *New();
+
+  /// Find tries to find this element in the current list using the hashtable.
+  /// It returns NULL if not present.  The user is free to modify the "val"
+  /// element of the Elem it returns.
+  inline Elem *Find(I key);
+
+  /// Inserts a new element at the end of the list.  By calling this, the user
+  /// asserts that it is not already present (e.g. Find was called and returned
+  /// NULL).
+  inline void Insert(I key, T val);
+
+  /// Makes the table big enough for 'sz' slots (it is rounded up to a power of
+  /// two, and it never shrinks).  It must be called while the hash is empty.
+  void SetSize(size_t sz);
+
+  /// Returns current number of slots in the table.
+  inline size_t Size() { return slots_.size(); }
+
+  ~OpenHashList();
+ private:
+  struct Slot {
+    I key;
+    Elem *elem;  // NULL if the slot is empty.
+  };
+
+  inline size_t FirstSlot(I key) const {
+    // Fibonacci hashing: the top bits of the product are the index.
+    return static_cast<size_t>((static_cast<uint64>(key) *
+                                UINT64_C(11400714819323198485)) >> shift_);
+  }
+
+  // Resizes the table to 'size' slots (a power of two) and re-inserts the
+  // elements that are in it.
+  void Rehash(size_t size);
+
+  Elem *list_head_;  // head of currently stored list.
+  Elem *list_tail_;  // tail of currently stored list.
+
+  std::vector<Slot> slots_;
+  size_t mask_;  // slots_.size() - 1.
+  int32 shift_;  // 64 - log2(slots_.size()).
+  std::vector<size_t> used_;  // indexes of the occupied slots.
+
+  Elem *freed_head_;  // head of list of currently freed elements. [ready for
+  // allocation]
+
+  std::vector<Elem*> allocated_;  // list of allocated blocks.
+
+  static const size_t allocate_block_size_ = 1024;  // Number of Elements to
+  // allocate in one block.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(OpenHashList);
+};
+
+
+}  // end namespace kaldi
+
+#include "util/open-hash-list-inl.h"
+
+#endif  // KALDI_UTIL_OPEN_HASH_LIST_H_
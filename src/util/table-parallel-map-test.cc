@@ -0,0 +1,135 @@
+// util/table-parallel-map-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <sstream>
+
+#include "base/kaldi-common.h"
+#include "util/table-parallel-map.h"
+#include "util/table-types.h"
+
+namespace kaldi {
+
+// Squares the vectors, slowly; skips the keys that end in '3' and fails on
+// 'fail_key'.
+class SquareMapper {
+ public:
+  struct Item {
+    std::vector<int32> value;
+  };
+
+  SquareMapper(Int32VectorWriter *writer, const std::string &fail_key):
+      writer_(writer), fail_key_(fail_key), num_written_(0) { }
+
+  bool Read(const std::string &key, std::vector<int32> &value, Item *item) {
+    if (key[key.size() - 1] == '3')
+      return false;
+    item->value.swap(value);
+    return true;
+  }
+
+  void Map(const std::string &key, Item *item) const {
+    if (key == fail_key_)
+      KALDI_ERR << "Failing on purpose.";
+    int32 spin = 1000 * (Rand() % 100);
+    for (int32 i = 0; i < spin; i++);
+    for (size_t i = 0; i < item->value.size(); i++)
+      item->value[i] *= item->value[i];
+  }
+
+  void Write(const std::string &key, Item *item) {
+    writer_->Write(key, item->value);
+    num_written_++;
+  }
+
+  int32 NumWritten() const { return num_written_; }
+
+ private:
+  Int32VectorWriter *writer_;
+  std::string fail_key_;
+  int32 num_written_;
+};
+
+void UnitTestParallelTableMap(int32 num_threads) {
+  std::string in_filename = "tmp-table-parallel-map-test.in.ark",
+      out_filename = "tmp-table-parallel-map-test.out.ark";
+  int32 num_items = Rand() % 50;
+  {
+    Int32VectorWriter writer("ark,t:" + in_filename);
+    for (int32 i = 0; i < num_items; i++) {
+      std::ostringstream key;
+      key << "utt" << i;
+      writer.Write(key.str(), std::vector<int32>(1 + i % 5, i));
+    }
+  }
+
+  TaskSequencerConfig config;
+  config.num_threads = num_threads;
+  int64 num_read;
+  int32 num_written;
+  {
+    SequentialInt32VectorReader reader("ark:" + in_filename);
+    Int32VectorWriter writer("ark,t:" + out_filename);
+    SquareMapper mapper(&writer, "");
+    num_read = ParallelTableMap(config, &reader, &mapper);
+    num_written = mapper.NumWritten();
+  }
+  KALDI_ASSERT(num_read == num_written);
+
+  // the output is in the input order, without the skipped keys.
+  SequentialInt32VectorReader reader("ark:" + out_filename);
+  int32 i = 0, num_checked = 0;
+  for (; !reader.Done(); reader.Next(), i++, num_checked++) {
+    if (i % 10 == 3) i++;
+    std::ostringstream key;
+    key << "utt" << i;
+    KALDI_ASSERT(reader.Key() == key.str());
+    KALDI_ASSERT(reader.Value() == std::vector<int32>(1 + i % 5, i * i));
+  }
+  KALDI_ASSERT(num_checked == num_written);
+  KALDI_ASSERT(num_written == num_items - (num_items + 6) / 10);
+
+  // an error in one of the threads is thrown from the main thread; it stops
+  // the reading, and only the 15 items before utt17 are written.
+  if (num_items > 20) {
+    SequentialInt32VectorReader reader("ark:" + in_filename);
+    Int32VectorWriter writer("ark,t:" + out_filename);
+    SquareMapper mapper(&writer, "utt17");
+    bool threw = false;
+    try {
+      ParallelTableMap(config, &reader, &mapper);
+    } catch (const std::exception &e) {
+      threw = true;
+    }
+    KALDI_ASSERT(threw && mapper.NumWritten() == 15);
+    KALDI_ASSERT(num_threads != 0 ||
+                 (!reader.Done() && reader.Key() == "utt18"));
+  }
+
+  std::remove(in_filename.c_str());
+  std::remove(out_filename.c_str());
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    UnitTestParallelTableMap(i % 5);
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,134 @@
+// util/table-parallel-map.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_TABLE_PARALLEL_MAP_H_
+#define KALDI_UTIL_TABLE_PARALLEL_MAP_H_
+
+#include <atomic>
+#include <string>
+
+#include "util/kaldi-table.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+/// \addtogroup table_group
+/// @{
+
+// ParallelTableMap() runs the usual loop of a table-processing program,
+//   for (; !reader.Done(); reader.Next()) { compute; write; }
+// with the "compute" part in up to --num-threads threads, and the "write" part
+// in the order of the input, via a TaskSequencer.  The work is given by an
+// object of some class M ("mapper"), which looks like
+//
+// class MyMapper {
+//  public:
+//   struct Item { ... };  // one unit of work, default-constructible.
+//   // Called in the main thread, in order.  Takes what it needs from 'value'
+//   // (it may swap it out) and from e.g. RandomAccessTableReaders, which are
+//   // not thread-safe; returns false to skip this key.
+//   bool Read(const std::string &key, T &value, Item *item);
+//   // Does the computation.  Called from several threads at once, so it is
+//   // const: models and LMs the mapper holds are shared read-only, anything
+//   // with a cache (e.g. a DeterministicOnDemandFst) has to be created here.
+//   void Map(const std::string &key, Item *item) const;
+//   // Called in the order of the input, one call at a time; writes the
+//   // output and accumulates statistics.
+//   void Write(const std::string &key, Item *item);
+// };
+//
+// With --num-threads=1 (the default) the computation runs in one worker
+// thread, overlapped with the reading and writing; --num-threads=0 runs
+// everything in the calling thread.  An exception thrown by Map() stops the
+// reading; the items before the one that failed are written, as they would
+// be by the sequential program, the others are not, and ParallelTableMap()
+// throws once the items already queued are done.
+
+template<class M>
+class TableMapTask {
+ public:
+  TableMapTask(M *mapper, const std::string &key, std::atomic<bool> *any_failed,
+               std::string *error):
+      mapper_(mapper), key_(key), any_failed_(any_failed), error_(error),
+      failed_(false) { }
+  typename M::Item *GetItem() { return &item_; }
+  // For an item that is skipped: it will not be written.
+  void Cancel() { mapper_ = NULL; }
+  void operator () () {
+    const M &mapper = *mapper_;
+    try {
+      mapper.Map(key_, &item_);
+    } catch (const std::exception &e) {
+      failed_ = true;
+      what_ = e.what();
+      *any_failed_ = true;  // tells the main thread to stop reading.
+    }
+  }
+  ~TableMapTask() {
+    // the destructors run one at a time, in order, so nothing after the first
+    // item that failed is written.
+    if (mapper_ == NULL || !error_->empty())
+      return;
+    if (failed_)
+      *error_ = key_ + ": " + what_;
+    else
+      mapper_->Write(key_, &item_);
+  }
+ private:
+  M *mapper_;
+  std::string key_;
+  std::atomic<bool> *any_failed_;  // set as soon as any Map() fails
+  std::string *error_;  // the first key that failed, and why
+  bool failed_;
+  std::string what_;
+  typename M::Item item_;
+};
+
+/// Processes all of 'reader' with 'mapper' as described above, and returns
+/// the number of items that were read (for which Read() returned true).
+template<class M, class Holder>
+int64 ParallelTableMap(const TaskSequencerConfig &config,
+                       SequentialTableReader<Holder> *reader, M *mapper) {
+  std::atomic<bool> any_failed(false);
+  std::string error;
+  int64 num_read = 0;
+  {
+    TaskSequencer<TableMapTask<M> > sequencer(config);
+    for (; !reader->Done() && !any_failed; reader->Next()) {
+      std::string key = reader->Key();
+      TableMapTask<M> *task = new TableMapTask<M>(mapper, key, &any_failed,
+                                                  &error);
+      if (!mapper->Read(key, reader->Value(), task->GetItem())) {
+        task->Cancel();
+        delete task;
+        continue;
+      }
+      reader->FreeCurrent();
+      sequencer.Run(task);
+      num_read++;
+    }
+  }  // waits for the last tasks.
+  if (!error.empty())
+    KALDI_ERR << "Processing failed for key " << error;
+  return num_read;
+}
+
+/// @} end "addtogroup table_group"
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_TABLE_PARALLEL_MAP_H_
@@ -0,0 +1,173 @@
+// util/thread-pool-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/timer.h"
+#include "util/kaldi-barrier.h"
+#include "util/kaldi-thread.h"
+#include "util/thread-pool.h"
+
+namespace kaldi {
+
+void UnitTestSubmit() {
+  ThreadPool pool(RandInt(1, 4));
+  std::vector<std::future<int32> > futures;
+  for (int32 i = 0; i < 100; i++)
+    futures.push_back(pool.Submit([i]() { return i * i; }));
+  for (int32 i = 0; i < 100; i++)
+    KALDI_ASSERT(futures[i].get() == i * i);
+
+  // Exceptions are passed on by the future.
+  std::future<void> f = pool.Submit([]() {
+      KALDI_ERR << "Expected error (this is a test)."; });
+  bool caught = false;
+  try {
+    f.get();
+  } catch(const std::exception &e) {
+    caught = true;
+  }
+  KALDI_ASSERT(caught);
+
+  // Tasks submitted by tasks; the pool is destroyed with tasks queued.
+  std::atomic<int32> count(0);
+  for (int32 i = 0; i < 20; i++) {
+    pool.Submit([&pool, &count]() {
+        for (int32 j = 0; j < 10; j++)
+          pool.Submit([&count]() { count++; });
+      });
+  }
+  // (the destructor of "pool" would wait, but "count" would be gone.)
+  while (count < 200)
+    std::this_thread::yield();
+}
+
+void UnitTestParallelFor() {
+  ThreadPool pool(RandInt(1, 4));
+  for (int32 n = 0; n < 10; n++) {
+    int32 begin = RandInt(-10, 10), end = begin + RandInt(0, 1000),
+        grain = RandInt(1, 50);
+    std::vector<int32> count(std::max(0, end - begin), 0);
+    pool.ParallelFor(begin, end, [&count, begin](int32 i) {
+        count[i - begin]++; }, grain);
+    for (size_t i = 0; i < count.size(); i++)
+      KALDI_ASSERT(count[i] == 1);
+  }
+
+  // Nested loops, run by workers that are all busy with the outer one.
+  std::vector<std::atomic<int32> > sums(50);
+  for (size_t i = 0; i < sums.size(); i++)
+    sums[i] = 0;
+  pool.ParallelFor(0, sums.size(), [&pool, &sums](int32 i) {
+      pool.ParallelFor(0, 100, [&sums, i](int32 j) { sums[i] += j; }, 7);
+    });
+  for (size_t i = 0; i < sums.size(); i++)
+    KALDI_ASSERT(sums[i] == 4950);
+
+  bool caught = false;
+  try {
+    pool.ParallelFor(0, 100, [](int32 i) {
+        if (i == 37) KALDI_ERR << "Expected error (this is a test)."; });
+  } catch(const std::exception &e) {
+    caught = true;
+  }
+  KALDI_ASSERT(caught);
+}
+
+void UnitTestRunInThread() {
+  ThreadPool pool(1);
+  // The tasks wait for each other, so they must all run at the same time,
+  // whatever the number of workers.
+  for (int32 n = 0; n < 3; n++) {
+    int32 num_tasks = RandInt(1, 10);
+    Barrier barrier(num_tasks);
+    std::vector<std::future<void> > futures;
+    for (int32 i = 0; i < num_tasks; i++)
+      futures.push_back(pool.RunInThread([&barrier]() { barrier.Wait(); }));
+    for (int32 i = 0; i < num_tasks; i++)
+      futures[i].get();
+  }
+}
+
+// Sums the integers below max_to_count, with part of them per job.
+class SumClass: public MultiThreadable {
+ public:
+  SumClass(int32 max_to_count, int64 *sum):
+      max_to_count_(max_to_count), sum_(sum), my_sum_(0) { }
+  SumClass(const SumClass &other):
+      MultiThreadable(other), max_to_count_(other.max_to_count_),
+      sum_(other.sum_), my_sum_(0) { }
+  void operator() () {
+    for (int32 i = thread_id_; i < max_to_count_; i += num_threads_)
+      my_sum_ += i;
+  }
+  ~SumClass() { *sum_ += my_sum_; }
+ private:
+  int32 max_to_count_;
+  int64 *sum_;
+  int64 my_sum_;
+};
+
+// Compares the time of many small parallel regions run with
+// RunMultiThreaded() (on the pool) and with a thread created per job, as
+// RunMultiThreaded() did before.
+void ThreadPoolBenchmark() {
+  int32 num_regions = 2000, num_threads = 4, max_to_count = 1000;
+  Timer timer;
+  for (int32 r = 0; r < num_regions; r++) {
+    int64 sum = 0;
+    MultiThreader<SumClass> m(num_threads, SumClass(max_to_count, &sum));
+  }
+  double pool_time = timer.Elapsed();
+  timer.Reset();
+  for (int32 r = 0; r < num_regions; r++) {
+    int64 sum = 0;
+    std::vector<SumClass> jobs(num_threads, SumClass(max_to_count, &sum));
+    std::vector<std::thread> threads;
+    for (int32 i = 0; i < num_threads; i++) {
+      jobs[i].thread_id_ = i;
+      jobs[i].num_threads_ = num_threads;
+      threads.push_back(std::thread(std::ref(jobs[i])));
+    }
+    for (int32 i = 0; i < num_threads; i++)
+      threads[i].join();
+  }
+  double thread_time = timer.Elapsed();
+  timer.Reset();
+  ThreadPool &pool = ThreadPool::Instance();
+  for (int32 r = 0; r < num_regions; r++) {
+    std::atomic<int64> sum(0);
+    pool.ParallelFor(0, max_to_count, [&sum](int32 i) { sum += i; }, 250);
+  }
+  double parallel_for_time = timer.Elapsed();
+  KALDI_LOG << num_regions << " parallel regions of " << num_threads
+            << " jobs took " << pool_time << " seconds with the pool, "
+            << thread_time << " seconds creating threads, and "
+            << parallel_for_time << " seconds with ParallelFor().";
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 5; i++) {
+    UnitTestSubmit();
+    UnitTestParallelFor();
+    UnitTestRunInThread();
+  }
+  ThreadPoolBenchmark();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
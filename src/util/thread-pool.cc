@@ -0,0 +1,260 @@
+// util/thread-pool.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+
+#include "util/thread-pool.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+namespace {
+
+// The pool whose worker the current thread is (if any), and its index.
+thread_local ThreadPool *current_pool = NULL;
+thread_local int32 current_worker = -1;
+
+// The state of a call to ParallelFor(), shared with the tasks that help it,
+// which may start after it has returned (they then find nothing to do).
+struct ParallelForState {
+  std::atomic<int64> next;  // the first index not yet taken.
+  int64 end;
+  int32 grain;
+  const std::function<void(int32)> *f;  // only used for indexes < end.
+  std::atomic<int32> num_helpers_active;
+  std::mutex mutex;
+  std::condition_variable done;
+  std::exception_ptr error;
+};
+
+// Runs pieces of the loop until there are none left.
+void RunPieces(ParallelForState *state) {
+  int64 begin;
+  while ((begin = state->next.fetch_add(state->grain)) < state->end) {
+    int32 end = std::min(begin + state->grain, state->end);
+    try {
+      for (int32 i = begin; i < end; i++)
+        (*state->f)(i);
+    } catch(...) {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (!state->error)
+        state->error = std::current_exception();
+      state->next = state->end;  // skip the rest.
+    }
+  }
+}
+
+}  // namespace
+
+
+struct ThreadPool::Worker {
+  std::mutex mutex;  // protects "tasks".
+  std::deque<std::function<void()> > tasks;
+  std::thread thread;
+};
+
+struct ThreadPool::SpareThread {
+  std::thread thread;
+  // The following are protected by spare_mutex_.
+  std::function<void()> task;  // empty while the thread is idle.
+  std::condition_variable condition_variable;
+  bool stop;
+  SpareThread(): stop(false) { }
+};
+
+
+ThreadPool &ThreadPool::Instance() {
+  static ThreadPool *pool = new ThreadPool(std::max<int32>(1, g_num_threads));
+  return *pool;
+}
+
+ThreadPool::ThreadPool(int32 num_threads):
+    num_queued_(0), next_queue_(0), stop_(false) {
+  num_threads = std::max<int32>(1, num_threads);
+  for (int32 w = 0; w < num_threads; w++)
+    workers_.push_back(new Worker());
+}
+
+void ThreadPool::StartWorkers() {
+  // The workers may steal from each other, so all must exist before they
+  // start; they do, since the constructor creates them.
+  for (size_t w = 0; w < workers_.size(); w++)
+    workers_[w]->thread = std::thread(&ThreadPool::WorkerLoop, this, w);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_variable_.notify_all();
+  for (size_t w = 0; w < workers_.size(); w++)
+    if (workers_[w]->thread.joinable())
+      workers_[w]->thread.join();
+  {
+    std::lock_guard<std::mutex> lock(spare_mutex_);
+    for (size_t i = 0; i < spare_threads_.size(); i++) {
+      spare_threads_[i]->stop = true;
+      spare_threads_[i]->condition_variable.notify_one();
+    }
+  }
+  for (size_t i = 0; i < spare_threads_.size(); i++) {
+    spare_threads_[i]->thread.join();
+    delete spare_threads_[i];
+  }
+  for (size_t w = 0; w < workers_.size(); w++)
+    delete workers_[w];
+}
+
+void ThreadPool::Push(const std::function<void()> &task) {
+  std::call_once(start_workers_, &ThreadPool::StartWorkers, this);
+  int32 w = (current_pool == this ? current_worker :
+             static_cast<int32>(next_queue_++ % workers_.size()));
+  {
+    std::lock_guard<std::mutex> lock(workers_[w]->mutex);
+    workers_[w]->tasks.push_back(task);
+  }
+  num_queued_++;
+  // Locking the mutex ensures that a worker that has just seen
+  // num_queued_ == 0 is waiting by the time we notify it.
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  condition_variable_.notify_one();
+}
+
+bool ThreadPool::TryPop(int32 w, std::function<void()> *task) {
+  int32 num_workers = workers_.size();
+  if (w >= 0) {
+    Worker *worker = workers_[w];
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    if (!worker->tasks.empty()) {
+      task->swap(worker->tasks.back());
+      worker->tasks.pop_back();
+      num_queued_--;
+      return true;
+    }
+  }
+  for (int32 i = 1; i <= num_workers; i++) {
+    Worker *victim = workers_[(w + i + num_workers) % num_workers];
+    std::lock_guard<std::mutex> lock(victim->mutex);
+    if (!victim->tasks.empty()) {
+      task->swap(victim->tasks.front());
+      victim->tasks.pop_front();
+      num_queued_--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::WorkerLoop(int32 w) {
+  current_pool = this;
+  current_worker = w;
+  std::function<void()> task;
+  while (true) {
+    if (TryPop(w, &task)) {
+      task();  // the tasks catch their exceptions.
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_variable_.wait(lock, [this]() {
+        return num_queued_ > 0 || stop_; });
+    if (stop_ && num_queued_ == 0)
+      return;
+  }
+}
+
+std::future<void> ThreadPool::RunInThread(const std::function<void()> &task) {
+  std::shared_ptr<std::packaged_task<void()> > packaged_task =
+      std::make_shared<std::packaged_task<void()> >(task);
+  std::future<void> ans = packaged_task->get_future();
+  std::lock_guard<std::mutex> lock(spare_mutex_);
+  SpareThread *thread;
+  if (idle_spare_threads_.empty()) {
+    thread = new SpareThread();
+    spare_threads_.push_back(thread);
+    thread->task = [packaged_task]() { (*packaged_task)(); };
+    thread->thread = std::thread(&ThreadPool::SpareThreadLoop, this, thread);
+  } else {
+    thread = idle_spare_threads_.back();
+    idle_spare_threads_.pop_back();
+    thread->task = [packaged_task]() { (*packaged_task)(); };
+    thread->condition_variable.notify_one();
+  }
+  return ans;
+}
+
+void ThreadPool::SpareThreadLoop(SpareThread *thread) {
+  std::unique_lock<std::mutex> lock(spare_mutex_);
+  while (true) {
+    thread->condition_variable.wait(lock, [thread]() {
+        return thread->task || thread->stop; });
+    if (!thread->task)
+      return;
+    std::function<void()> task;
+    task.swap(thread->task);
+    lock.unlock();
+    task();
+    task = nullptr;
+    lock.lock();
+    idle_spare_threads_.push_back(thread);
+  }
+}
+
+void ThreadPool::ParallelFor(int32 begin, int32 end,
+                             const std::function<void(int32)> &f,
+                             int32 grain) {
+  KALDI_ASSERT(grain > 0);
+  if (begin >= end) return;
+  int64 num_pieces = (static_cast<int64>(end) - begin + grain - 1) / grain;
+  // The calling thread takes pieces too.
+  int32 num_helpers = std::min<int64>(num_pieces - 1, NumThreads());
+  if (num_helpers == 0) {
+    for (int32 i = begin; i < end; i++)
+      f(i);
+    return;
+  }
+  std::shared_ptr<ParallelForState> state =
+      std::make_shared<ParallelForState>();
+  state->next = begin;
+  state->end = end;
+  state->grain = grain;
+  state->f = &f;
+  state->num_helpers_active = 0;
+  for (int32 h = 0; h < num_helpers; h++) {
+    Push([state]() {
+        state->num_helpers_active++;
+        RunPieces(state.get());
+        if (--state->num_helpers_active == 0) {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          state->done.notify_all();
+        }
+      });
+  }
+  RunPieces(state.get());
+  // All the pieces have been taken; wait for the helpers that are running
+  // them.  Those that start later find nothing to do.
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->done.wait(lock, [&state]() {
+      return state->num_helpers_active == 0; });
+  if (state->error)
+    std::rethrow_exception(state->error);
+}
+
+}  // namespace kaldi
@@ -0,0 +1,145 @@
+// util/thread-pool.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_THREAD_POOL_H_
+#define KALDI_UTIL_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/**
+   A pool of threads that stay alive between parallel regions, so that code that
+   runs small pieces of work in parallel many times (e.g. once per minibatch or
+   per utterance) does not pay for creating and joining threads each time.
+
+   It has two kinds of threads:
+    - a fixed number of workers, which run the tasks given to Submit() and
+      ParallelFor().  Each worker has its own queue of tasks; tasks submitted
+      by a worker go to its own queue, which it runs last-in-first-out, and
+      workers with nothing to do steal the oldest tasks of the others.  These
+      tasks should not wait for each other (except via ParallelFor(), which
+      is safe), since they may end up queued behind each other.
+    - threads for RunInThread(), which starts each task at once in an idle
+      thread, creating one if all are busy.  These tasks may wait for each
+      other or for the caller; this is what MultiThreader and TaskSequencer
+      (see kaldi-thread.h) use.
+
+   ThreadPool::Instance() is the pool shared by the program; its number of
+   workers is g_num_threads when it is first used.  The workers are only
+   started when the first task is queued for them, so programs that just use
+   RunInThread() (or nothing) do not have idle workers.
+*/
+class ThreadPool {
+ public:
+  /// Returns the pool shared by the program, creating it on the first call
+  /// with max(1, g_num_threads) workers.  It is never destroyed.
+  static ThreadPool &Instance();
+
+  /// Creates a pool of "num_threads" workers (at least one), which are
+  /// started by the first call to Submit() or ParallelFor() that queues a
+  /// task.
+  explicit ThreadPool(int32 num_threads);
+
+  /// Waits for the queued tasks and those given to RunInThread() to finish,
+  /// and stops the threads.
+  ~ThreadPool();
+
+  int32 NumThreads() const { return workers_.size(); }
+
+  /// Queues "task" (a function object taking no arguments) to be run by a
+  /// worker, and returns a future for its result; an exception thrown by the
+  /// task is rethrown by the future's get().
+  template<class F>
+  std::future<typename std::result_of<F()>::type> Submit(F task);
+
+  /// Runs "task" in a thread of its own (reusing an idle one if there is
+  /// one), starting it right away; see the class comment.  The future is
+  /// ready when the task has finished.
+  std::future<void> RunInThread(const std::function<void()> &task);
+
+  /// Calls f(i) for begin <= i < end, in parallel on the calling thread and
+  /// the workers, and returns when all the calls are done.  The indexes are
+  /// taken "grain" at a time, so "grain" should be large enough that each
+  /// piece is worth a task.  This may be called from tasks of the pool
+  /// (the calling thread does part of the work, so nested loops cannot wait
+  /// forever for busy workers).  If a call throws, the remaining pieces are
+  /// skipped and the exception is rethrown here.
+  void ParallelFor(int32 begin, int32 end,
+                   const std::function<void(int32)> &f, int32 grain = 1);
+
+ private:
+  struct Worker;
+  struct SpareThread;
+
+  // Queues a task for the workers, starting them if this is the first one.
+  void Push(const std::function<void()> &task);
+
+  void StartWorkers();
+
+  // Removes a task from the queue of worker "w" (newest first), or if that is
+  // empty, steals the oldest task of another worker; returns false if there
+  // is none.  "w" may be -1 (for threads that are not workers).
+  bool TryPop(int32 w, std::function<void()> *task);
+
+  void WorkerLoop(int32 w);
+  void SpareThreadLoop(SpareThread *thread);
+
+  std::vector<Worker*> workers_;
+  std::once_flag start_workers_;
+
+  // The number of tasks in the workers' queues; workers sleep on
+  // "condition_variable_" when it is zero.
+  std::atomic<int32> num_queued_;
+  std::atomic<uint32> next_queue_;  // for tasks from other threads.
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+  bool stop_;
+
+  // The threads for RunInThread().
+  std::mutex spare_mutex_;
+  std::vector<SpareThread*> spare_threads_;
+  std::vector<SpareThread*> idle_spare_threads_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+
+template<class F>
+std::future<typename std::result_of<F()>::type> ThreadPool::Submit(F task) {
+  typedef typename std::result_of<F()>::type R;
+  // std::function needs a copyable object, which std::packaged_task is not.
+  std::shared_ptr<std::packaged_task<R()> > packaged_task =
+      std::make_shared<std::packaged_task<R()> >(task);
+  std::future<R> ans = packaged_task->get_future();
+  Push([packaged_task]() { (*packaged_task)(); });
+  return ans;
+}
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_THREAD_POOL_H_